@@ -9,6 +9,11 @@ LOCAL_SRC_FILES := \
         QCameraMem.cpp \
         ../util/QCameraQueue.cpp \
         ../util/QCameraCmdThread.cpp \
+        ../util/QCameraTunables.cpp \
+        ../util/QCameraFormatConvert.cpp \
+        ../util/QCameraRawUnpack.cpp \
+        ../util/QCameraDngWriter.cpp \
+        ../util/QCameraScaler.cpp \
         QCameraStateMachine.cpp \
         QCameraChannel.cpp \
         QCameraStream.cpp \
@@ -32,6 +37,7 @@ LOCAL_C_INCLUDES := \
         system/media/camera/include \
         $(LOCAL_PATH)/../../mm-image-codec/qexif \
         $(LOCAL_PATH)/../../mm-image-codec/qomx_core \
+        $(LOCAL_PATH)/../../hdr/include \
         $(LOCAL_PATH)/../util
 
 LOCAL_C_INCLUDES += \
@@ -43,6 +49,7 @@ LOCAL_ADDITIONAL_DEPENDENCIES := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
 
 LOCAL_SHARED_LIBRARIES := libcamera_client liblog libhardware libutils libcutils libdl
 LOCAL_SHARED_LIBRARIES += libmmcamera_interface libmmjpeg_interface
+LOCAL_SHARED_LIBRARIES += libcamera_noise_reduction
 
 LOCAL_MODULE_RELATIVE_PATH := hw
 LOCAL_MODULE := camera.$(TARGET_BOARD_PLATFORM)
@@ -31,6 +31,7 @@
 
 #include <cutils/properties.h>
 #include <hardware/camera.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <utils/Errors.h>
 #include <gralloc_priv.h>
@@ -932,6 +933,7 @@ QCamera2HardwareInterface::QCamera2HardwareInterface(int cameraId)
       m_currentFocusState(CAM_AF_NOT_FOCUSED),
       m_bStartZSLSnapshotCalled(false),
       m_pPowerModule(NULL),
+      m_nMfnrFrames(1),
       mDumpFrmCnt(0),
       mDumpSkipCnt(0)
 {
@@ -1033,9 +1035,13 @@ int QCamera2HardwareInterface::openCamera()
                                               camEvtHandle,
                                               (void *) this);
 
+    // take a fresh snapshot of debug/perf properties for this session
+    QCameraTunables::getInstance()->start();
+
     int32_t rc = m_postprocessor.init(jpegEvtHandle, this);
     if (rc != 0) {
         ALOGE("Init Postprocessor failed");
+        QCameraTunables::getInstance()->stop();
         return UNKNOWN_ERROR;
     }
 
@@ -1059,6 +1065,7 @@ int QCamera2HardwareInterface::openCamera()
         ALOGE("Init thermal adapter failed");
     }
 
+    QCameraMemoryPool::getInstance()->addUser();
     mCameraOpened = true;
 
     return NO_ERROR;
@@ -1100,8 +1107,15 @@ int QCamera2HardwareInterface::closeCamera()
 
     rc = mCameraHandle->ops->close_camera(mCameraHandle->camera_handle);
     mCameraHandle = NULL;
+
+    // return cached ion buffers to the system once the last camera is closed
+    if (mCameraOpened) {
+        QCameraMemoryPool::getInstance()->removeUser();
+    }
     mCameraOpened = false;
 
+    QCameraTunables::getInstance()->stop();
+
     return rc;
 }
 
@@ -1240,7 +1254,7 @@ int QCamera2HardwareInterface::getCapabilities(int cameraId,
 uint8_t QCamera2HardwareInterface::getBufNumRequired(cam_stream_type_t stream_type)
 {
     int bufferCnt = 0;
-    int minCaptureBuffers = mParameters.getNumOfSnapshots();
+    int minCaptureBuffers = mParameters.getNumOfSnapshots() * m_nMfnrFrames;
 
     int zslQBuffers = mParameters.getZSLQueueDepth() +
                       mParameters.getMaxUnmatchedFramesInQueue();
@@ -1298,6 +1312,8 @@ uint8_t QCamera2HardwareInterface::getBufNumRequired(cam_stream_type_t stream_ty
             bufferCnt = CAMERA_MIN_VIDEO_BUFFERS +
                         mParameters.getMaxUnmatchedFramesInQueue() +
                         CAMERA_MIN_STREAMING_BUFFERS;
+            // a batch being collected and one being returned to kernel
+            bufferCnt += 2 * (mParameters.getVideoBatchSize() - 1);
         }
         break;
     case CAM_STREAM_TYPE_METADATA:
@@ -1393,9 +1409,8 @@ QCameraMemory *QCamera2HardwareInterface::allocateStreamBuf(cam_stream_type_t st
         break;
     case CAM_STREAM_TYPE_VIDEO:
         {
-            char value[PROPERTY_VALUE_MAX];
-            property_get("persist.camera.mem.usecache", value, "1");
-            if (atoi(value) == 0) {
+            if (QCameraTunables::getInstance()->get(
+                    QCAMERA_TUNABLE_MEM_USE_CACHE) == 0) {
                 bCachedMem = QCAMERA_ION_USE_NOCACHE;
             }
             ALOGD("%s: vidoe buf using cached memory = %d", __func__, bCachedMem);
@@ -1466,12 +1481,14 @@ QCameraHeapMemory *QCamera2HardwareInterface::allocateStreamInfoBuf(
             streamInfo->streaming_mode = CAM_STREAMING_MODE_CONTINUOUS;
         } else {
             streamInfo->streaming_mode = CAM_STREAMING_MODE_BURST;
-            streamInfo->num_of_burst = mParameters.getNumOfSnapshots();
+            streamInfo->num_of_burst =
+                (uint8_t)(mParameters.getNumOfSnapshots() * m_nMfnrFrames);
         }
         break;
     case CAM_STREAM_TYPE_POSTVIEW:
         streamInfo->streaming_mode = CAM_STREAMING_MODE_BURST;
-        streamInfo->num_of_burst = mParameters.getNumOfSnapshots();
+        streamInfo->num_of_burst =
+            (uint8_t)(mParameters.getNumOfSnapshots() * m_nMfnrFrames);
         break;
     default:
         break;
@@ -1487,6 +1504,25 @@ QCameraHeapMemory *QCamera2HardwareInterface::allocateStreamInfoBuf(
     return streamInfoBuf;
 }
 
+/*===========================================================================
+ * FUNCTION   : getStreamBatchSize
+ *
+ * DESCRIPTION: get number of frames delivered per data callback of a stream.
+ *              Video in high frame rate modes is delivered in batches.
+ *
+ * PARAMETERS :
+ *   @stream_type  : type of stream
+ *
+ * RETURN     : frames per data callback
+ *==========================================================================*/
+uint8_t QCamera2HardwareInterface::getStreamBatchSize(cam_stream_type_t stream_type)
+{
+    if (stream_type == CAM_STREAM_TYPE_VIDEO) {
+        return mParameters.getVideoBatchSize();
+    }
+    return 1;
+}
+
 /*===========================================================================
  * FUNCTION   : setPreviewWindow
  *
@@ -1533,6 +1569,14 @@ int QCamera2HardwareInterface::setCallBacks(camera_notify_callback notify_cb,
     mDataCbTimestamp = data_cb_timestamp;
     mGetMemory       = get_memory;
     mCallbackCookie  = user;
+
+    QCameraTunables *tunables = QCameraTunables::getInstance();
+    if (tunables->isSet(QCAMERA_TUNABLE_CB_MAX_PENDING)) {
+        uint32_t maxPending = (uint32_t)tunables->get(QCAMERA_TUNABLE_CB_MAX_PENDING);
+        m_cbNotifier.setMaxPending(QCAMERA_CB_DROP_PREVIEW, maxPending);
+        m_cbNotifier.setMaxPending(QCAMERA_CB_DROP_METADATA, maxPending);
+    }
+
     m_cbNotifier.setCallbacks(notify_cb, data_cb, data_cb_timestamp, user);
     return NO_ERROR;
 }
@@ -1657,6 +1701,8 @@ int QCamera2HardwareInterface::stopPreview()
 
     // delete all channels from preparePreview
     unpreparePreview();
+    // callbacks still queued keep their buffers until delivered
+    m_cbBufPool.flush();
     ALOGD("%s: X", __func__);
     return NO_ERROR;
 }
@@ -1907,6 +1953,15 @@ int QCamera2HardwareInterface::takePicture()
     int rc = NO_ERROR;
     uint8_t numSnapshots = mParameters.getNumOfSnapshots();
     ALOGD("%s: E", __func__);
+
+    // low light snapshots capture several frames per picture, merged by
+    // the noise reduction stage of the postprocessor
+    m_nMfnrFrames = needReprocess() ? 1 : mParameters.getNumOfMfnrFrames();
+    if (m_nMfnrFrames > 1) {
+        ALOGD("%s: %d frames per snapshot for noise reduction",
+              __func__, m_nMfnrFrames);
+    }
+
     if (mParameters.isZSLMode()) {
         QCameraPicChannel *pZSLChannel =
             (QCameraPicChannel *)m_channels[QCAMERA_CH_TYPE_ZSL];
@@ -2253,10 +2308,43 @@ int QCamera2HardwareInterface::release()
  *              NO_ERROR  -- success
  *              none-zero failure code
  *==========================================================================*/
-int QCamera2HardwareInterface::dump(int /*fd*/)
+int QCamera2HardwareInterface::dump(int fd)
 {
-    ALOGE("%s: not supported yet", __func__);
-    return INVALID_OPERATION;
+    qcamera_cb_drop_policy_t stats[QCAMERA_CB_DROP_MAX];
+
+    m_cbNotifier.getDropStats(stats);
+    dprintf(fd, "\n Camera HAL callback queues:\n");
+    for (int i = 0; i < QCAMERA_CB_DROP_MAX; i++) {
+        dprintf(fd, "  msg type 0x%x: pending %u, max pending %u, dropped %u\n",
+                stats[i].msg_type,
+                stats[i].pending,
+                stats[i].maxPending,
+                stats[i].dropped);
+    }
+
+    static const char *stageNames[QCAMERA_PP_STAGE_MAX] = {
+        "reprocess", "jpeg submit", "jpeg notify"
+    };
+    qcamera_pp_stage_stats_t ppStats[QCAMERA_PP_STAGE_MAX];
+    m_postprocessor.getStageStats(ppStats);
+    dprintf(fd, "\n Camera HAL postprocessor stages:\n");
+    for (int i = 0; i < QCAMERA_PP_STAGE_MAX; i++) {
+        dprintf(fd, "  %s: pending %u (peak %u), inflight %u/%u, processed %u\n",
+                stageNames[i],
+                ppStats[i].pending,
+                ppStats[i].peakPending,
+                ppStats[i].inflight,
+                ppStats[i].maxInflight,
+                ppStats[i].processed);
+    }
+
+    uint32_t cachedBytes, budget, hits, misses;
+    QCameraMemoryPool::getInstance()->getStats(cachedBytes, budget, hits, misses);
+    dprintf(fd, "\n Camera HAL ion buffer pool:\n");
+    dprintf(fd, "  cached %u bytes, budget %u bytes, hits %u, misses %u\n",
+            cachedBytes, budget, hits, misses);
+
+    return NO_ERROR;
 }
 
 /*===========================================================================
@@ -3074,13 +3162,18 @@ int32_t QCamera2HardwareInterface::addCaptureChannel()
         return rc;
     }
 
-    rc = addStreamToChannel(pChannel, CAM_STREAM_TYPE_POSTVIEW,
-                            postview_stream_cb_routine, this);
+    // with software thumbnails the jpeg thumbnail is scaled from the
+    // snapshot, so the postview stream and its bufs are left out. Ask the
+    // postprocessor, the tunable may have been refreshed since it latched it.
+    if (!m_postprocessor.isSwThumbnailEnabled()) {
+        rc = addStreamToChannel(pChannel, CAM_STREAM_TYPE_POSTVIEW,
+                                postview_stream_cb_routine, this);
 
-    if (rc != NO_ERROR) {
-        ALOGE("%s: add postview stream failed, ret = %d", __func__, rc);
-        delete pChannel;
-        return rc;
+        if (rc != NO_ERROR) {
+            ALOGE("%s: add postview stream failed, ret = %d", __func__, rc);
+            delete pChannel;
+            return rc;
+        }
     }
 
     rc = addStreamToChannel(pChannel, CAM_STREAM_TYPE_NON_ZSL_SNAPSHOT,
@@ -3801,6 +3894,8 @@ int QCamera2HardwareInterface::updateThermalLevel(
                 adjustedRange.max_fps = 1;
             }
             skipPattern = EVERY_4FRAME;
+            // release idle cached buffers under heavy thermal pressure
+            QCameraMemoryPool::getInstance()->trim(0);
         }
         break;
     case QCAMERA_THERMAL_SHUTDOWN:
@@ -3816,6 +3911,7 @@ int QCamera2HardwareInterface::updateThermalLevel(
                 }
             }
             skipPattern = MAX_SKIP;
+            QCameraMemoryPool::getInstance()->trim(0);
         }
         break;
     default:
@@ -3861,6 +3957,8 @@ int QCamera2HardwareInterface::updateParameters(const char *parms, bool &needRes
 {
     String8 str = String8(parms);
     QCameraParameters param(str);
+    // parameters reading tunables pick up property changes made since open
+    QCameraTunables::getInstance()->refresh();
     return mParameters.updateParameters(param, needRestart);
 }
 
@@ -3914,10 +4012,7 @@ bool QCamera2HardwareInterface::needDebugFps()
  *==========================================================================*/
 bool QCamera2HardwareInterface::isCACEnabled()
 {
-    char prop[PROPERTY_VALUE_MAX];
-    memset(prop, 0, sizeof(prop));
-    property_get("persist.camera.feature.cac", prop, "0");
-    int enableCAC = atoi(prop);
+    int enableCAC = QCameraTunables::getInstance()->get(QCAMERA_TUNABLE_FEATURE_CAC);
     return enableCAC == 1;
 }
 
@@ -4020,7 +4115,9 @@ int QCamera2HardwareInterface::getJpegRotation() {
 /*===========================================================================
  * FUNCTION   : getExifData
  *
- * DESCRIPTION: get exif data to be passed into jpeg encoding
+ * DESCRIPTION: get exif data to be passed into jpeg encoding. The result is
+ *              kept as template of the jpeg session; values that change per
+ *              shot are refreshed by updateExifData.
  *
  * PARAMETERS : none
  *
@@ -4035,22 +4132,8 @@ QCameraExif *QCamera2HardwareInterface::getExifData()
     }
 
     int32_t rc = NO_ERROR;
-    uint32_t count = 0;
-
-    // add exif entries
-    char dateTime[20];
-    memset(dateTime, 0, sizeof(dateTime));
-    count = 20;
-    rc = mParameters.getExifDateTime(dateTime, count);
-    if(rc == NO_ERROR) {
-        exif->addEntry(EXIFTAGID_EXIF_DATE_TIME_ORIGINAL,
-                       EXIF_ASCII,
-                       count,
-                       (void *)dateTime);
-    } else {
-        ALOGE("%s: getExifDateTime failed", __func__);
-    }
 
+    // add exif entries fixed for the session
     rat_t focalLength;
     rc = mParameters.getExifFocalLength(&focalLength);
     if (rc == NO_ERROR) {
@@ -4062,21 +4145,81 @@ QCameraExif *QCamera2HardwareInterface::getExifData()
         ALOGE("%s: getExifFocalLength failed", __func__);
     }
 
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("ro.product.manufacturer", value, "QCOM-AA") > 0) {
+        exif->addEntry(EXIFTAGID_MAKE,
+                       EXIF_ASCII,
+                       strlen(value) + 1,
+                       (void *)value);
+    } else {
+        ALOGE("%s: getExifMaker failed", __func__);
+    }
+
+    if (property_get("ro.product.model", value, "QCAM-AA") > 0) {
+        exif->addEntry(EXIFTAGID_MODEL,
+                       EXIF_ASCII,
+                       strlen(value) + 1,
+                       (void *)value);
+    } else {
+        ALOGE("%s: getExifModel failed", __func__);
+    }
+
+    updateExifData(exif);
+    return exif;
+}
+
+/*===========================================================================
+ * FUNCTION   : updateExifData
+ *
+ * DESCRIPTION: refresh exif entries that change from shot to shot, such as
+ *              date time, ISO and GPS. Entries are patched in place, GPS
+ *              entries are dropped when no GPS info is set.
+ *
+ * PARAMETERS :
+ *   @exif    : exif data to be updated
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCamera2HardwareInterface::updateExifData(QCameraExif *exif)
+{
+    int32_t rc = NO_ERROR;
+    uint32_t count = 0;
+
+    if (exif == NULL) {
+        return BAD_VALUE;
+    }
+
+    char dateTime[20];
+    memset(dateTime, 0, sizeof(dateTime));
+    count = 20;
+    rc = mParameters.getExifDateTime(dateTime, count);
+    if(rc == NO_ERROR) {
+        exif->updateEntry(EXIFTAGID_EXIF_DATE_TIME_ORIGINAL,
+                          EXIF_ASCII,
+                          count,
+                          (void *)dateTime);
+    } else {
+        ALOGE("%s: getExifDateTime failed", __func__);
+    }
+
     uint16_t isoSpeed = mParameters.getExifIsoSpeed();
-    exif->addEntry(EXIFTAGID_ISO_SPEED_RATING,
-                   EXIF_SHORT,
-                   1,
-                   (void *)&(isoSpeed));
+    exif->updateEntry(EXIFTAGID_ISO_SPEED_RATING,
+                      EXIF_SHORT,
+                      1,
+                      (void *)&(isoSpeed));
 
     char gpsProcessingMethod[EXIF_ASCII_PREFIX_SIZE + GPS_PROCESSING_METHOD_SIZE];
     count = 0;
     rc = mParameters.getExifGpsProcessingMethod(gpsProcessingMethod, count);
     if(rc == NO_ERROR) {
-        exif->addEntry(EXIFTAGID_GPS_PROCESSINGMETHOD,
-                       EXIF_ASCII,
-                       count,
-                       (void *)gpsProcessingMethod);
+        exif->updateEntry(EXIFTAGID_GPS_PROCESSINGMETHOD,
+                          EXIF_ASCII,
+                          count,
+                          (void *)gpsProcessingMethod);
     } else {
+        exif->removeEntry(EXIFTAGID_GPS_PROCESSINGMETHOD);
         ALOGE("%s: getExifGpsProcessingMethod failed", __func__);
     }
 
@@ -4084,15 +4227,17 @@ QCameraExif *QCamera2HardwareInterface::getExifData()
     char latRef[2];
     rc = mParameters.getExifLatitude(latitude, latRef);
     if(rc == NO_ERROR) {
-        exif->addEntry(EXIFTAGID_GPS_LATITUDE,
-                       EXIF_RATIONAL,
-                       3,
-                       (void *)latitude);
-        exif->addEntry(EXIFTAGID_GPS_LATITUDE_REF,
-                       EXIF_ASCII,
-                       2,
-                       (void *)latRef);
+        exif->updateEntry(EXIFTAGID_GPS_LATITUDE,
+                          EXIF_RATIONAL,
+                          3,
+                          (void *)latitude);
+        exif->updateEntry(EXIFTAGID_GPS_LATITUDE_REF,
+                          EXIF_ASCII,
+                          2,
+                          (void *)latRef);
     } else {
+        exif->removeEntry(EXIFTAGID_GPS_LATITUDE);
+        exif->removeEntry(EXIFTAGID_GPS_LATITUDE_REF);
         ALOGE("%s: getExifLatitude failed", __func__);
     }
 
@@ -4100,16 +4245,18 @@ QCameraExif *QCamera2HardwareInterface::getExifData()
     char lonRef[2];
     rc = mParameters.getExifLongitude(longitude, lonRef);
     if(rc == NO_ERROR) {
-        exif->addEntry(EXIFTAGID_GPS_LONGITUDE,
-                       EXIF_RATIONAL,
-                       3,
-                       (void *)longitude);
-
-        exif->addEntry(EXIFTAGID_GPS_LONGITUDE_REF,
-                       EXIF_ASCII,
-                       2,
-                       (void *)lonRef);
+        exif->updateEntry(EXIFTAGID_GPS_LONGITUDE,
+                          EXIF_RATIONAL,
+                          3,
+                          (void *)longitude);
+
+        exif->updateEntry(EXIFTAGID_GPS_LONGITUDE_REF,
+                          EXIF_ASCII,
+                          2,
+                          (void *)lonRef);
     } else {
+        exif->removeEntry(EXIFTAGID_GPS_LONGITUDE);
+        exif->removeEntry(EXIFTAGID_GPS_LONGITUDE_REF);
         ALOGE("%s: getExifLongitude failed", __func__);
     }
 
@@ -4117,16 +4264,18 @@ QCameraExif *QCamera2HardwareInterface::getExifData()
     char altRef;
     rc = mParameters.getExifAltitude(&altitude, &altRef);
     if(rc == NO_ERROR) {
-        exif->addEntry(EXIFTAGID_GPS_ALTITUDE,
-                       EXIF_RATIONAL,
-                       1,
-                       (void *)&(altitude));
-
-        exif->addEntry(EXIFTAGID_GPS_ALTITUDE_REF,
-                       EXIF_BYTE,
-                       1,
-                       (void *)&altRef);
+        exif->updateEntry(EXIFTAGID_GPS_ALTITUDE,
+                          EXIF_RATIONAL,
+                          1,
+                          (void *)&(altitude));
+
+        exif->updateEntry(EXIFTAGID_GPS_ALTITUDE_REF,
+                          EXIF_BYTE,
+                          1,
+                          (void *)&altRef);
     } else {
+        exif->removeEntry(EXIFTAGID_GPS_ALTITUDE);
+        exif->removeEntry(EXIFTAGID_GPS_ALTITUDE_REF);
         ALOGE("%s: getExifAltitude failed", __func__);
     }
 
@@ -4134,39 +4283,92 @@ QCameraExif *QCamera2HardwareInterface::getExifData()
     rat_t gpsTimeStamp[3];
     rc = mParameters.getExifGpsDateTimeStamp(gpsDateStamp, 20, gpsTimeStamp);
     if(rc == NO_ERROR) {
-        exif->addEntry(EXIFTAGID_GPS_DATESTAMP,
-                       EXIF_ASCII,
-                       strlen(gpsDateStamp) + 1,
-                       (void *)gpsDateStamp);
-
-        exif->addEntry(EXIFTAGID_GPS_TIMESTAMP,
-                       EXIF_RATIONAL,
-                       3,
-                       (void *)gpsTimeStamp);
+        exif->updateEntry(EXIFTAGID_GPS_DATESTAMP,
+                          EXIF_ASCII,
+                          strlen(gpsDateStamp) + 1,
+                          (void *)gpsDateStamp);
+
+        exif->updateEntry(EXIFTAGID_GPS_TIMESTAMP,
+                          EXIF_RATIONAL,
+                          3,
+                          (void *)gpsTimeStamp);
     } else {
+        exif->removeEntry(EXIFTAGID_GPS_DATESTAMP);
+        exif->removeEntry(EXIFTAGID_GPS_TIMESTAMP);
         ALOGE("%s: getExifGpsDataTimeStamp failed", __func__);
     }
 
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : getDngInfo
+ *
+ * DESCRIPTION: get tag values of a DNG file for the current snapshot, from
+ *              sensor capabilities and user settings
+ *
+ * PARAMETERS :
+ *   @info    : [output] DNG tag values
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCamera2HardwareInterface::getDngInfo(qcamera_dng_info_t &info)
+{
+    cam_capability_t *caps = gCamCapability[mCameraId];
+    uint32_t count = 0;
+
+    QCameraDngWriter::initInfo(info);
     char value[PROPERTY_VALUE_MAX];
-    if (property_get("ro.product.manufacturer", value, "QCOM-AA") > 0) {
-        exif->addEntry(EXIFTAGID_MAKE,
-                       EXIF_ASCII,
-                       strlen(value) + 1,
-                       (void *)value);
-    } else {
-        ALOGE("%s: getExifMaker failed", __func__);
+    property_get("ro.product.manufacturer", value, "QCOM-AA");
+    snprintf(info.make, sizeof(info.make), "%s", value);
+    property_get("ro.product.model", value, "QCAM-AA");
+    snprintf(info.model, sizeof(info.model), "%s", value);
+    snprintf(info.software, sizeof(info.software), "QCamera2 HAL");
+
+    count = sizeof(info.datetime);
+    if (mParameters.getExifDateTime(info.datetime, count) != NO_ERROR) {
+        info.datetime[0] = '\0';
     }
 
-    if (property_get("ro.product.model", value, "QCAM-AA") > 0) {
-        exif->addEntry(EXIFTAGID_MODEL,
-                       EXIF_ASCII,
-                       strlen(value) + 1,
-                       (void *)value);
-    } else {
-        ALOGE("%s: getExifModel failed", __func__);
+    switch (mParameters.getJpegRotation()) {
+    case 90:
+        info.orientation = 6;
+        break;
+    case 180:
+        info.orientation = 3;
+        break;
+    case 270:
+        info.orientation = 8;
+        break;
+    default:
+        info.orientation = 1;
+        break;
     }
 
-    return exif;
+    // values below 100 are auto and deblur modes, not a sensitivity
+    uint16_t isoSpeed = mParameters.getExifIsoSpeed();
+    if (isoSpeed >= 100) {
+        info.iso = isoSpeed;
+    }
+
+    if (caps != NULL) {
+        if (caps->white_level > 0) {
+            info.white_level = (uint32_t)caps->white_level;
+        }
+        for (int i = 0; i < 4; i++) {
+            if (caps->black_level_pattern[i] > 0) {
+                info.black_level[i] = (uint32_t)caps->black_level_pattern[i];
+            }
+        }
+        info.focal_length = caps->focal_length;
+        if (caps->apertures_count > 0) {
+            info.f_number = caps->apertures[0];
+        }
+    }
+
+    return NO_ERROR;
 }
 
 /*===========================================================================
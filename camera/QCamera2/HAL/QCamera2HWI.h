@@ -37,6 +37,8 @@
 
 #include "QCameraQueue.h"
 #include "QCameraCmdThread.h"
+#include "QCameraTunables.h"
+#include "QCameraDngWriter.h"
 #include "QCameraChannel.h"
 #include "QCameraStream.h"
 #include "QCameraStateMachine.h"
@@ -127,6 +129,23 @@ typedef struct {
     camera_release_callback  release_cb; // release callback
 } qcamera_callback_argm_t;
 
+// max number of pending preview data callbacks before older ones are dropped
+#define QCAMERA_CB_MAX_PENDING_PREVIEW   2
+#define QCAMERA_CB_MAX_PENDING_METADATA  2
+
+typedef enum {
+    QCAMERA_CB_DROP_PREVIEW,   // CAMERA_MSG_PREVIEW_FRAME data callbacks
+    QCAMERA_CB_DROP_METADATA,  // CAMERA_MSG_PREVIEW_METADATA data callbacks
+    QCAMERA_CB_DROP_MAX
+} qcamera_cb_drop_type_t;
+
+typedef struct {
+    int32_t  msg_type;    // droppable msg type
+    uint32_t maxPending;  // queue bound, 0 means unbounded
+    uint32_t pending;     // callbacks currently queued
+    uint32_t dropped;     // callbacks superseded by newer ones
+} qcamera_cb_drop_policy_t;
+
 class QCameraCbNotifier {
 public:
     QCameraCbNotifier(QCamera2HardwareInterface *parent) :
@@ -135,7 +154,16 @@ public:
                           mDataCbTimestamp (NULL),
                           mCallbackCookie (NULL),
                           mParent (parent),
-                          mDataQ(releaseNotifications, this) {}
+                          mDataQ(releaseNotifications, this) {
+        pthread_mutex_init(&mDropLock, NULL);
+        memset(mDropPolicy, 0, sizeof(mDropPolicy));
+        mDropPolicy[QCAMERA_CB_DROP_PREVIEW].msg_type = CAMERA_MSG_PREVIEW_FRAME;
+        mDropPolicy[QCAMERA_CB_DROP_PREVIEW].maxPending =
+            QCAMERA_CB_MAX_PENDING_PREVIEW;
+        mDropPolicy[QCAMERA_CB_DROP_METADATA].msg_type = CAMERA_MSG_PREVIEW_METADATA;
+        mDropPolicy[QCAMERA_CB_DROP_METADATA].maxPending =
+            QCAMERA_CB_MAX_PENDING_METADATA;
+    }
 
     virtual ~QCameraCbNotifier();
 
@@ -146,10 +174,17 @@ public:
                               void *callbackCookie);
     virtual int32_t startSnapshots();
     virtual void stopSnapshots();
+    virtual void setMaxPending(qcamera_cb_drop_type_t type, uint32_t maxPending);
+    virtual void getDropStats(qcamera_cb_drop_policy_t *stats);
+    virtual void resetDropStats();
     static void * cbNotifyRoutine(void * data);
     static void releaseNotifications(void *data, void *user_data);
     static bool matchSnapshotNotifications(void *data, void *user_data);
+    static bool matchDroppableNotifications(void *data, void *user_data,
+                                            void *match_data);
 private:
+    int getDropType(qcamera_callback_argm_t *cb);
+    void updatePending(qcamera_callback_argm_t *cb, bool enqueued);
 
     camera_notify_callback         mNotifyCb;
     camera_data_callback           mDataCb;
@@ -157,9 +192,37 @@ private:
     void                          *mCallbackCookie;
     QCamera2HardwareInterface     *mParent;
 
+    pthread_mutex_t          mDropLock;
+    qcamera_cb_drop_policy_t mDropPolicy[QCAMERA_CB_DROP_MAX];
+
     QCameraQueue     mDataQ;
     QCameraCmdThread mProcTh;
 };
+// converted preview callback buffers kept for reuse
+#define QCAMERA_CB_BUF_POOL_SIZE 4
+
+// Heap buffers carrying converted preview frames to the app. A buffer is
+// busy from get() until its callback is delivered or dropped, then it is
+// reused for the next frame of the same size.
+class QCameraCbBufferPool {
+public:
+    QCameraCbBufferPool();
+    virtual ~QCameraCbBufferPool();
+
+    camera_memory_t *get(camera_request_memory getMemory,
+                         void *callbackCookie,
+                         size_t size);
+    void put(camera_memory_t *mem);
+    void flush();
+    static void releaseBuffer(void *data, void *cookie);
+
+private:
+    pthread_mutex_t mLock;
+    camera_memory_t *mBufs[QCAMERA_CB_BUF_POOL_SIZE];
+    bool mBusy[QCAMERA_CB_BUF_POOL_SIZE];
+    size_t mSize;                    // size of pooled buffers
+};
+
 class QCamera2HardwareInterface : public QCameraAllocator,
                                     public QCameraThermalCallback
 {
@@ -215,6 +278,7 @@ public:
                                              int size,
                                              uint8_t &bufferCnt);
     virtual QCameraHeapMemory *allocateStreamInfoBuf(cam_stream_type_t stream_type);
+    virtual uint8_t getStreamBatchSize(cam_stream_type_t stream_type);
 
     // Implementation of QCameraThermalCallback
     virtual int thermalEvtHandle(qcamera_thermal_level_enum_t level,
@@ -290,6 +354,8 @@ private:
     int getJpegQuality();
     int getJpegRotation();
     QCameraExif *getExifData();
+    int32_t updateExifData(QCameraExif *exif);
+    int32_t getDngInfo(qcamera_dng_info_t &info);
 
     int32_t processAutoFocusEvent(cam_auto_focus_data_t &focus_data);
     int32_t processZoomEvent(cam_crop_data_t &crop_info);
@@ -332,10 +398,14 @@ private:
     int32_t setHistogram(bool histogram_en);
     int32_t setFaceDetection(bool enabled);
     int32_t prepareHardwareForSnapshot(int32_t afNeeded);
+    camera_memory_t *convertPreviewFrame(QCameraStream *stream,
+                                         mm_camera_buf_def_t *frame,
+                                         QCameraMemory *memory);
     bool needProcessPreviewFrame() {return m_stateMachine.isPreviewRunning();};
     bool isNoDisplayMode() {return mParameters.isNoDisplayMode();};
     bool isZSLMode() {return mParameters.isZSLMode();};
     uint8_t numOfSnapshotsExpected() {return mParameters.getNumOfSnapshots();};
+    uint8_t numOfMfnrFrames() {return m_nMfnrFrames;};
     uint8_t getBufNumRequired(cam_stream_type_t stream_type);
 
     static void camEvtHandle(uint32_t camera_handle,
@@ -403,6 +473,8 @@ private:
     QCameraStateMachine m_stateMachine;   // state machine
     QCameraPostProcessor m_postprocessor; // post processor
     QCameraThermalAdapter &m_thermalAdapter;
+    // declared before the notifier, which returns buffers while it exits
+    QCameraCbBufferPool m_cbBufPool;
     QCameraCbNotifier m_cbNotifier;
     pthread_mutex_t m_lock;
     pthread_cond_t m_cond;
@@ -427,6 +499,10 @@ private:
 
     power_module_t *m_pPowerModule;   // power module
 
+    // frames merged into each snapshot by the postprocessor noise reduction
+    // stage, latched when a picture is taken; 1 if the stage is not used
+    uint8_t m_nMfnrFrames;
+
     int mDumpFrmCnt;  // frame dump count
     int mDumpSkipCnt; // frame skip count
 };
@@ -33,6 +33,7 @@
 #include <utils/Errors.h>
 #include <utils/Timers.h>
 #include "QCamera2HWI.h"
+#include "QCameraFormatConvert.h"
 
 namespace qcamera {
 
@@ -300,6 +301,7 @@ void QCamera2HardwareInterface::preview_stream_cb_routine(mm_camera_super_buf_t
     // Handle preview data callback
     if (pme->mDataCb != NULL && pme->msgTypeEnabledWithLock(CAMERA_MSG_PREVIEW_FRAME) > 0) {
         camera_memory_t *previewMem = NULL;
+        camera_memory_t *convertedMem = NULL;
         camera_memory_t *data = NULL;
         int previewBufSize;
         cam_dimension_t preview_dim;
@@ -307,10 +309,19 @@ void QCamera2HardwareInterface::preview_stream_cb_routine(mm_camera_super_buf_t
         stream->getFrameDimension(preview_dim);
         stream->getFormat(previewFmt);
 
+        // The frame just sent to display can only be dequeued again by a
+        // later call of this routine, so it is safe to read it here.
+        if (QCameraTunables::getInstance()->get(
+                QCAMERA_TUNABLE_PREVIEW_CB_CONVERT) > 0) {
+            convertedMem = pme->convertPreviewFrame(stream, frame, memory);
+        }
+
         /* The preview buffer size in the callback should be (width*height*bytes_per_pixel)
          * As all preview formats we support, use 12 bits per pixel, buffer size = previewWidth * previewHeight * 3/2.
          * We need to put a check if some other formats are supported in future. */
-        if ((previewFmt == CAM_FORMAT_YUV_420_NV21) ||
+        if (convertedMem != NULL) {
+            data = convertedMem;
+        } else if ((previewFmt == CAM_FORMAT_YUV_420_NV21) ||
             (previewFmt == CAM_FORMAT_YUV_420_NV12) ||
             (previewFmt == CAM_FORMAT_YUV_420_YV12)) {
             if(previewFmt == CAM_FORMAT_YUV_420_YV12) {
@@ -338,11 +349,15 @@ void QCamera2HardwareInterface::preview_stream_cb_routine(mm_camera_super_buf_t
         cbArg.cb_type = QCAMERA_DATA_CALLBACK;
         cbArg.msg_type = CAMERA_MSG_PREVIEW_FRAME;
         cbArg.data = data;
-        if ( previewMem ) {
+        cbArg.cookie = pme;
+        if ( convertedMem ) {
+            cbArg.user_data = convertedMem;
+            cbArg.cookie = &pme->m_cbBufPool;
+            cbArg.release_cb = QCameraCbBufferPool::releaseBuffer;
+        } else if ( previewMem ) {
             cbArg.user_data = previewMem;
             cbArg.release_cb = releaseCameraMemory;
         }
-        cbArg.cookie = pme;
         pme->m_cbNotifier.notifyCallback(cbArg);
     }
 
@@ -351,6 +366,104 @@ void QCamera2HardwareInterface::preview_stream_cb_routine(mm_camera_super_buf_t
     return;
 }
 
+/*===========================================================================
+ * FUNCTION   : convertPreviewFrame
+ *
+ * DESCRIPTION: copy a preview frame into a pooled callback buffer, in the
+ *              layout apps expect, when the stream layout differs from it.
+ *              Stream padding is dropped, YV12 gets 16 byte aligned strides
+ *              and packed 4:2:2 previews are delivered as NV21, matching
+ *              the 12 bits per pixel callbacks of the other formats.
+ *
+ * PARAMETERS :
+ *   @stream  : preview stream
+ *   @frame   : preview frame
+ *   @memory  : memory object of the frame
+ *
+ * RETURN     : callback buffer holding the converted frame, to be returned
+ *              through QCameraCbBufferPool::releaseBuffer. NULL if the frame
+ *              can be passed as is or could not be converted.
+ *==========================================================================*/
+camera_memory_t *QCamera2HardwareInterface::convertPreviewFrame(
+        QCameraStream *stream,
+        mm_camera_buf_def_t *frame,
+        QCameraMemory *memory)
+{
+    cam_dimension_t dim;
+    cam_format_t fmt;
+    cam_frame_len_offset_t offset;
+    qcamera_pix_frame_t src, dst;
+    qcamera_pix_fmt_t cbFmt;
+    size_t size = 0;
+
+    memset(&src, 0, sizeof(src));
+    stream->getFrameDimension(dim);
+    stream->getFormat(fmt);
+    stream->getFrameOffset(offset);
+
+    switch (fmt) {
+    case CAM_FORMAT_YUV_420_NV21:
+        src.fmt = QCAMERA_PIX_FMT_NV21;
+        break;
+    case CAM_FORMAT_YUV_420_NV12:
+        src.fmt = QCAMERA_PIX_FMT_NV12;
+        break;
+    case CAM_FORMAT_YUV_420_YV12:
+        src.fmt = QCAMERA_PIX_FMT_YV12;
+        break;
+    case CAM_FORMAT_YUV_RAW_8BIT_YUYV:
+        src.fmt = QCAMERA_PIX_FMT_YUYV;
+        break;
+    case CAM_FORMAT_YUV_RAW_8BIT_YVYU:
+        src.fmt = QCAMERA_PIX_FMT_YVYU;
+        break;
+    case CAM_FORMAT_YUV_RAW_8BIT_UYVY:
+        src.fmt = QCAMERA_PIX_FMT_UYVY;
+        break;
+    case CAM_FORMAT_YUV_RAW_8BIT_VYUY:
+        src.fmt = QCAMERA_PIX_FMT_VYUY;
+        break;
+    default:
+        return NULL;
+    }
+    cbFmt = (src.fmt >= QCAMERA_PIX_FMT_YUYV) ? QCAMERA_PIX_FMT_NV21 : src.fmt;
+
+    src.width = dim.width;
+    src.height = dim.height;
+    for (int i = 0; i < frame->num_planes && i < 3; i++) {
+        src.plane[i] = (uint8_t *)frame->buffer +
+            frame->planes[i].reserved[0] + frame->planes[i].data_offset;
+        src.stride[i] = offset.mp[i].stride;
+    }
+    if (src.fmt >= QCAMERA_PIX_FMT_YUYV) {
+        // packed strides are in pixels
+        src.stride[0] *= 2;
+    }
+
+    if (QCameraFormatConvert::getPackedLayout(cbFmt, dim.width, dim.height,
+            (uint8_t *)frame->buffer, dst, size) != NO_ERROR ||
+        QCameraFormatConvert::isSameLayout(src, dst) ||
+        !QCameraFormatConvert::isConvertible(src.fmt, cbFmt)) {
+        return NULL;
+    }
+
+    camera_memory_t *mem = m_cbBufPool.get(mGetMemory, mCallbackCookie, size);
+    if (mem == NULL) {
+        ALOGE("%s: no callback buffer of %d bytes", __func__, (int)size);
+        return NULL;
+    }
+
+    memory->invalidateCache(frame->buf_idx);
+    QCameraFormatConvert::getPackedLayout(cbFmt, dim.width, dim.height,
+        (uint8_t *)mem->data, dst, size);
+    if (QCameraFormatConvert::convert(src, dst) != NO_ERROR) {
+        ALOGE("%s: conversion of format %d failed", __func__, fmt);
+        m_cbBufPool.put(mem);
+        return NULL;
+    }
+    return mem;
+}
+
 /*===========================================================================
  * FUNCTION   : nodisplay_preview_stream_cb_routine
  *
@@ -531,37 +644,40 @@ void QCamera2HardwareInterface::video_stream_cb_routine(mm_camera_super_buf_t *s
         free(super_frame);
         return;
     }
-    mm_camera_buf_def_t *frame = super_frame->bufs[0];
-
-    if (pme->needDebugFps()) {
-        pme->debugShowVideoFPS();
-    }
-
-    ALOGE("%s: Stream(%d), Timestamp: %ld %ld",
-          __func__,
-          frame->stream_id,
-          frame->ts.tv_sec,
-          frame->ts.tv_nsec);
+    // in high frame rate modes a batch of video frames arrives together,
+    // each one is sent to the encoder with its own timestamp
+    for (int i = 0; i < super_frame->num_bufs; i++) {
+        mm_camera_buf_def_t *frame = super_frame->bufs[i];
+        if (pme->needDebugFps()) {
+            pme->debugShowVideoFPS();
+        }
 
-    nsecs_t timeStamp = nsecs_t(frame->ts.tv_sec) * 1000000000LL + frame->ts.tv_nsec;
-    ALOGE("Send Video frame to services/encoder TimeStamp : %lld", timeStamp);
-    QCameraMemory *videoMemObj = (QCameraMemory *)frame->mem_info;
-    camera_memory_t *video_mem = NULL;
-    if (NULL != videoMemObj) {
-        video_mem = videoMemObj->getMemory(frame->buf_idx, (pme->mStoreMetaDataInFrame > 0)? true : false);
-    }
-    if (NULL != videoMemObj && NULL != video_mem) {
-        pme->dumpFrameToFile(frame->buffer, frame->frame_len,
-                             frame->frame_idx, QCAMERA_DUMP_FRM_VIDEO);
-        if ((pme->mDataCbTimestamp != NULL) &&
-            pme->msgTypeEnabledWithLock(CAMERA_MSG_VIDEO_FRAME) > 0) {
-            qcamera_callback_argm_t cbArg;
-            memset(&cbArg, 0, sizeof(qcamera_callback_argm_t));
-            cbArg.cb_type = QCAMERA_DATA_TIMESTAMP_CALLBACK;
-            cbArg.msg_type = CAMERA_MSG_VIDEO_FRAME;
-            cbArg.data = video_mem;
-            cbArg.timestamp = timeStamp;
-            pme->m_cbNotifier.notifyCallback(cbArg);
+        ALOGE("%s: Stream(%d), Timestamp: %ld %ld",
+              __func__,
+              frame->stream_id,
+              frame->ts.tv_sec,
+              frame->ts.tv_nsec);
+
+        nsecs_t timeStamp = nsecs_t(frame->ts.tv_sec) * 1000000000LL + frame->ts.tv_nsec;
+        ALOGE("Send Video frame to services/encoder TimeStamp : %lld", timeStamp);
+        QCameraMemory *videoMemObj = (QCameraMemory *)frame->mem_info;
+        camera_memory_t *video_mem = NULL;
+        if (NULL != videoMemObj) {
+            video_mem = videoMemObj->getMemory(frame->buf_idx, (pme->mStoreMetaDataInFrame > 0)? true : false);
+        }
+        if (NULL != videoMemObj && NULL != video_mem) {
+            pme->dumpFrameToFile(frame->buffer, frame->frame_len,
+                                 frame->frame_idx, QCAMERA_DUMP_FRM_VIDEO);
+            if ((pme->mDataCbTimestamp != NULL) &&
+                pme->msgTypeEnabledWithLock(CAMERA_MSG_VIDEO_FRAME) > 0) {
+                qcamera_callback_argm_t cbArg;
+                memset(&cbArg, 0, sizeof(qcamera_callback_argm_t));
+                cbArg.cb_type = QCAMERA_DATA_TIMESTAMP_CALLBACK;
+                cbArg.msg_type = CAMERA_MSG_VIDEO_FRAME;
+                cbArg.data = video_mem;
+                cbArg.timestamp = timeStamp;
+                pme->m_cbNotifier.notifyCallback(cbArg);
+            }
         }
     }
     free(super_frame);
@@ -808,9 +924,7 @@ void QCamera2HardwareInterface::dumpFrameToFile(const void *data,
                                                 int index,
                                                 int dump_type)
 {
-    char value[PROPERTY_VALUE_MAX];
-    property_get("persist.camera.dumpimg", value, "0");
-    int32_t enabled = atoi(value);
+    int32_t enabled = QCameraTunables::getInstance()->get(QCAMERA_TUNABLE_DUMP_IMG);
     int frm_num = 0;
     uint32_t skip_mode = 0;
 
@@ -977,6 +1091,9 @@ void QCamera2HardwareInterface::debugShowPreviewFPS()
 QCameraCbNotifier::~QCameraCbNotifier()
 {
     mProcTh.exit();
+    // release anything still queued while the drop lock is valid
+    mDataQ.flush();
+    pthread_mutex_destroy(&mDropLock);
 }
 
 /*===========================================================================
@@ -995,6 +1112,8 @@ void QCameraCbNotifier::releaseNotifications(void *data, void *user_data)
     qcamera_callback_argm_t *arg = ( qcamera_callback_argm_t * ) data;
 
     if ( ( NULL != arg ) && ( NULL != user_data ) ) {
+        QCameraCbNotifier *pme = ( QCameraCbNotifier * ) user_data;
+        pme->updatePending(arg, false);
         if ( arg->release_cb ) {
             arg->release_cb(arg->user_data, arg->cookie);
         }
@@ -1027,6 +1146,90 @@ bool QCameraCbNotifier::matchSnapshotNotifications(void *data,
     return false;
 }
 
+/*===========================================================================
+ * FUNCTION   : matchDroppableNotifications
+ *
+ * DESCRIPTION: matches queued data callbacks of a droppable msg type
+ *
+ * PARAMETERS :
+ *   @data       : data to match
+ *   @user_data  : context data
+ *   @match_data : ptr to msg type to be matched
+ *
+ * RETURN     : bool match
+ *              true - match found
+ *              false- match not found
+ *==========================================================================*/
+bool QCameraCbNotifier::matchDroppableNotifications(void *data,
+                                                    void */*user_data*/,
+                                                    void *match_data)
+{
+    qcamera_callback_argm_t *arg = ( qcamera_callback_argm_t * ) data;
+    int32_t *msg_type = ( int32_t * ) match_data;
+    if ( ( NULL != arg ) && ( NULL != msg_type ) ) {
+        if ( ( QCAMERA_DATA_CALLBACK == arg->cb_type ) &&
+             ( *msg_type == arg->msg_type ) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*===========================================================================
+ * FUNCTION   : getDropType
+ *
+ * DESCRIPTION: looks up the drop policy a callback is subject to. Only plain
+ *              data callbacks are droppable, notifications, timestamped and
+ *              snapshot data callbacks are always delivered.
+ *
+ * PARAMETERS :
+ *   @cb      : callback arguments
+ *
+ * RETURN     : index into drop policy table, -1 if not droppable
+ *==========================================================================*/
+int QCameraCbNotifier::getDropType(qcamera_callback_argm_t *cb)
+{
+    if ( ( NULL == cb ) || ( QCAMERA_DATA_CALLBACK != cb->cb_type ) ) {
+        return -1;
+    }
+
+    for (int i = 0; i < QCAMERA_CB_DROP_MAX; i++) {
+        if (mDropPolicy[i].msg_type == cb->msg_type) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/*===========================================================================
+ * FUNCTION   : updatePending
+ *
+ * DESCRIPTION: keeps track of the number of queued droppable callbacks
+ *
+ * PARAMETERS :
+ *   @cb       : callback arguments
+ *   @enqueued : true if cb was added to the queue, false if removed
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbNotifier::updatePending(qcamera_callback_argm_t *cb, bool enqueued)
+{
+    int type = getDropType(cb);
+    if (type < 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&mDropLock);
+    if (enqueued) {
+        mDropPolicy[type].pending++;
+    } else if (mDropPolicy[type].pending > 0) {
+        mDropPolicy[type].pending--;
+    }
+    pthread_mutex_unlock(&mDropLock);
+}
+
 /*===========================================================================
  * FUNCTION   : cbNotifyRoutine
  *
@@ -1164,6 +1367,7 @@ void * QCameraCbNotifier::cbNotifyRoutine(void * data)
                               __func__,
                               cb->msg_type);
                     }
+                    pme->updatePending(cb, false);
                     if ( cb->release_cb ) {
                         cb->release_cb(cb->user_data, cb->cookie);
                     }
@@ -1210,10 +1414,35 @@ int32_t QCameraCbNotifier::notifyCallback(qcamera_callback_argm_t &cbArgs)
     memset(cbArg, 0, sizeof(qcamera_callback_argm_t));
     *cbArg = cbArgs;
 
+    int type = getDropType(cbArg);
+    if (type >= 0) {
+        bool overflow = false;
+        pthread_mutex_lock(&mDropLock);
+        if ( ( 0 < mDropPolicy[type].maxPending ) &&
+             ( mDropPolicy[type].pending >= mDropPolicy[type].maxPending ) ) {
+            overflow = true;
+        }
+        pthread_mutex_unlock(&mDropLock);
+
+        if (overflow) {
+            // latest wins, superseded frames go back to their owner
+            int32_t msg_type = cbArg->msg_type;
+            int dropped = mDataQ.flushNodes(matchDroppableNotifications,
+                                            &msg_type);
+            pthread_mutex_lock(&mDropLock);
+            mDropPolicy[type].dropped += dropped;
+            pthread_mutex_unlock(&mDropLock);
+            ALOGV("%s: dropped %d pending callbacks of msg type %d",
+                  __func__, dropped, msg_type);
+        }
+        updatePending(cbArg, true);
+    }
+
     if (mDataQ.enqueue((void *)cbArg)) {
         mProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
     } else {
         ALOGE("%s: Error adding cb data into queue", __func__);
+        updatePending(cbArg, false);
         delete cbArg;
         return UNKNOWN_ERROR;
     }
@@ -1286,4 +1515,251 @@ void QCameraCbNotifier::stopSnapshots()
     mProcTh.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, FALSE, TRUE);
 }
 
+/*===========================================================================
+ * FUNCTION   : setMaxPending
+ *
+ * DESCRIPTION: sets the bound of queued callbacks for a droppable msg type.
+ *              Once reached, older queued callbacks of the same type are
+ *              released in favour of the newest one.
+ *
+ * PARAMETERS :
+ *   @type       : drop policy type
+ *   @maxPending : max number of queued callbacks, 0 for unbounded
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbNotifier::setMaxPending(qcamera_cb_drop_type_t type,
+                                      uint32_t maxPending)
+{
+    if (type >= QCAMERA_CB_DROP_MAX) {
+        ALOGE("%s: invalid drop type %d", __func__, type);
+        return;
+    }
+
+    pthread_mutex_lock(&mDropLock);
+    mDropPolicy[type].maxPending = maxPending;
+    pthread_mutex_unlock(&mDropLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : getDropStats
+ *
+ * DESCRIPTION: returns a snapshot of the drop policy table
+ *
+ * PARAMETERS :
+ *   @stats   : array of QCAMERA_CB_DROP_MAX entries to be filled in
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbNotifier::getDropStats(qcamera_cb_drop_policy_t *stats)
+{
+    if (NULL == stats) {
+        return;
+    }
+
+    pthread_mutex_lock(&mDropLock);
+    memcpy(stats, mDropPolicy, sizeof(mDropPolicy));
+    pthread_mutex_unlock(&mDropLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : resetDropStats
+ *
+ * DESCRIPTION: clears the drop counters
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbNotifier::resetDropStats()
+{
+    pthread_mutex_lock(&mDropLock);
+    for (int i = 0; i < QCAMERA_CB_DROP_MAX; i++) {
+        mDropPolicy[i].dropped = 0;
+    }
+    pthread_mutex_unlock(&mDropLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : QCameraCbBufferPool
+ *
+ * DESCRIPTION: constructor of QCameraCbBufferPool
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraCbBufferPool::QCameraCbBufferPool()
+    : mSize(0)
+{
+    pthread_mutex_init(&mLock, NULL);
+    memset(mBufs, 0, sizeof(mBufs));
+    memset(mBusy, 0, sizeof(mBusy));
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraCbBufferPool
+ *
+ * DESCRIPTION: deconstructor of QCameraCbBufferPool. The callback notifier
+ *              has exited by now, so no buffer can still be returned.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraCbBufferPool::~QCameraCbBufferPool()
+{
+    for (int i = 0; i < QCAMERA_CB_BUF_POOL_SIZE; i++) {
+        if (mBufs[i] != NULL) {
+            mBufs[i]->release(mBufs[i]);
+            mBufs[i] = NULL;
+        }
+    }
+    pthread_mutex_destroy(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : get
+ *
+ * DESCRIPTION: get a free callback buffer, allocating one if needed. Free
+ *              buffers of another size are released.
+ *
+ * PARAMETERS :
+ *   @getMemory      : memory request function of the camera service
+ *   @callbackCookie : cookie of the camera service
+ *   @size           : buffer size in bytes
+ *
+ * RETURN     : callback buffer, NULL if allocation failed
+ *==========================================================================*/
+camera_memory_t *QCameraCbBufferPool::get(camera_request_memory getMemory,
+                                          void *callbackCookie,
+                                          size_t size)
+{
+    camera_memory_t *mem = NULL;
+    int slot = -1;
+
+    if (getMemory == NULL || size == 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&mLock);
+    if (size != mSize) {
+        // busy buffers of the old size are released when they come back
+        for (int i = 0; i < QCAMERA_CB_BUF_POOL_SIZE; i++) {
+            if (mBufs[i] != NULL && !mBusy[i]) {
+                mBufs[i]->release(mBufs[i]);
+            }
+            mBufs[i] = NULL;
+            mBusy[i] = false;
+        }
+        mSize = size;
+    }
+    for (int i = 0; i < QCAMERA_CB_BUF_POOL_SIZE; i++) {
+        if (mBufs[i] != NULL && !mBusy[i]) {
+            mBusy[i] = true;
+            mem = mBufs[i];
+            break;
+        }
+        if (mBufs[i] == NULL && slot < 0) {
+            slot = i;
+        }
+    }
+    if (mem == NULL) {
+        mem = getMemory(-1, size, 1, callbackCookie);
+        if (mem != NULL && mem->data == NULL) {
+            mem->release(mem);
+            mem = NULL;
+        }
+        // without a free slot the buffer is released when it comes back
+        if (mem != NULL && slot >= 0) {
+            mBufs[slot] = mem;
+            mBusy[slot] = true;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+
+    return mem;
+}
+
+/*===========================================================================
+ * FUNCTION   : put
+ *
+ * DESCRIPTION: return a callback buffer. Buffers the pool does not track
+ *              any more are released.
+ *
+ * PARAMETERS :
+ *   @mem     : buffer from get()
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbBufferPool::put(camera_memory_t *mem)
+{
+    bool pooled = false;
+
+    if (mem == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&mLock);
+    for (int i = 0; i < QCAMERA_CB_BUF_POOL_SIZE; i++) {
+        if (mBufs[i] == mem) {
+            mBusy[i] = false;
+            pooled = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+
+    if (!pooled) {
+        mem->release(mem);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : flush
+ *
+ * DESCRIPTION: release free buffers and stop tracking busy ones, which are
+ *              released when they come back
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbBufferPool::flush()
+{
+    pthread_mutex_lock(&mLock);
+    for (int i = 0; i < QCAMERA_CB_BUF_POOL_SIZE; i++) {
+        if (mBufs[i] != NULL && !mBusy[i]) {
+            mBufs[i]->release(mBufs[i]);
+        }
+        mBufs[i] = NULL;
+        mBusy[i] = false;
+    }
+    mSize = 0;
+    pthread_mutex_unlock(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseBuffer
+ *
+ * DESCRIPTION: release callback of converted preview callbacks
+ *
+ * PARAMETERS :
+ *   @data    : buffer from get()
+ *   @cookie  : pool the buffer belongs to
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCbBufferPool::releaseBuffer(void *data, void *cookie)
+{
+    QCameraCbBufferPool *pool = (QCameraCbBufferPool *)cookie;
+    camera_memory_t *mem = (camera_memory_t *)data;
+
+    if (pool != NULL) {
+        pool->put(mem);
+    } else if (mem != NULL) {
+        mem->release(mem);
+    }
+}
+
 }; // namespace qcamera
@@ -45,6 +45,8 @@ public:
                                              int size,
                                              uint8_t &bufferCnt) = 0;
     virtual QCameraHeapMemory *allocateStreamInfoBuf(cam_stream_type_t stream_type) = 0;
+    // frames delivered per data callback of the stream
+    virtual uint8_t getStreamBatchSize(cam_stream_type_t stream_type) = 0;
     virtual ~QCameraAllocator() {}
 };
 
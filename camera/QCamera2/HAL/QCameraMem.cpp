@@ -30,6 +30,7 @@
 #define LOG_TAG "QCameraHWI_Mem"
 
 #include <string.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <utils/Errors.h>
@@ -67,6 +68,8 @@ QCameraMemory::QCameraMemory(bool cached)
         mMemInfo[i].main_ion_fd = 0;
         mMemInfo[i].handle = NULL;
         mMemInfo[i].size = 0;
+        mMemInfo[i].heap_id = 0;
+        mMemInfo[i].cached = cached;
     }
 }
 
@@ -281,7 +284,9 @@ void QCameraMemory::dealloc()
 /*===========================================================================
  * FUNCTION   : allocOneBuffer
  *
- * DESCRIPTION: impl of allocating one buffers of certain size
+ * DESCRIPTION: impl of allocating one buffers of certain size. A matching
+ *              buffer cached by the memory pool is reused if available, it
+ *              is cleared first so that no data of its previous user leaks.
  *
  * PARAMETERS :
  *   @memInfo : [output] reference to struct to store additional memory allocation info
@@ -293,6 +298,55 @@ void QCameraMemory::dealloc()
  *              none-zero failure code
  *==========================================================================*/
 int QCameraMemory::allocOneBuffer(QCameraMemInfo &memInfo, int heap_id, int size)
+{
+    if (QCameraMemoryPool::getInstance()->acquire(memInfo, heap_id,
+                                                  size, m_bCached)) {
+        if (clearIonBuffer(memInfo) == OK) {
+            return OK;
+        }
+        freeIonBuffer(memInfo);
+    }
+
+    return allocIonBuffer(memInfo, heap_id, size, m_bCached);
+}
+
+/*===========================================================================
+ * FUNCTION   : deallocOneBuffer
+ *
+ * DESCRIPTION: impl of deallocating one buffers. The buffer is handed to the
+ *              memory pool, which either caches or frees it.
+ *
+ * PARAMETERS :
+ *   @memInfo : reference to struct that stores additional memory allocation info
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMemory::deallocOneBuffer(QCameraMemInfo &memInfo)
+{
+    if (memInfo.fd > 0) {
+        QCameraMemoryPool::getInstance()->release(memInfo);
+    } else {
+        freeIonBuffer(memInfo);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : allocIonBuffer
+ *
+ * DESCRIPTION: allocate one buffer of certain size from /dev/ion
+ *
+ * PARAMETERS :
+ *   @memInfo : [output] reference to struct to store additional memory allocation info
+ *   @heap    : [input] heap id to indicate where the buffers will be allocated from
+ *   @size    : [input] lenght of the buffer to be allocated
+ *   @cached  : [input] flag indicates if using cached memory
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int QCameraMemory::allocIonBuffer(QCameraMemInfo &memInfo, int heap_id,
+                                  int size, bool cached)
 {
     int rc = OK;
     struct ion_handle_data handle_data;
@@ -311,7 +365,7 @@ int QCameraMemory::allocOneBuffer(QCameraMemInfo &memInfo, int heap_id, int size
     /* to make it page size aligned */
     alloc.len = (alloc.len + 4095) & (~4095);
     alloc.align = 4096;
-    if (m_bCached) {
+    if (cached) {
         alloc.flags = ION_FLAG_CACHED;
     }
     alloc.heap_id_mask = heap_id;
@@ -333,6 +387,8 @@ int QCameraMemory::allocOneBuffer(QCameraMemInfo &memInfo, int heap_id, int size
     memInfo.fd = ion_info_fd.fd;
     memInfo.handle = ion_info_fd.handle;
     memInfo.size = alloc.len;
+    memInfo.heap_id = heap_id;
+    memInfo.cached = cached;
     return OK;
 
 ION_MAP_FAILED:
@@ -346,16 +402,62 @@ ION_OPEN_FAILED:
 }
 
 /*===========================================================================
- * FUNCTION   : deallocOneBuffer
+ * FUNCTION   : clearIonBuffer
  *
- * DESCRIPTION: impl of deallocating one buffers
+ * DESCRIPTION: zero one ion buffer, as a fresh allocation from /dev/ion is
+ *
+ * PARAMETERS :
+ *   @memInfo : reference to struct that stores buffer info
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int QCameraMemory::clearIonBuffer(QCameraMemInfo &memInfo)
+{
+    struct ion_flush_data cache_data;
+    struct ion_custom_data custom_data;
+    int rc = OK;
+
+    void *vaddr = mmap(NULL, memInfo.size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, memInfo.fd, 0);
+    if (vaddr == MAP_FAILED) {
+        ALOGE("%s: mmap failed: %s", __func__, strerror(errno));
+        return NO_MEMORY;
+    }
+    memset(vaddr, 0, memInfo.size);
+
+    if (memInfo.cached) {
+        // make the zeroes visible to the hardware
+        memset(&cache_data, 0, sizeof(cache_data));
+        memset(&custom_data, 0, sizeof(custom_data));
+        cache_data.vaddr = vaddr;
+        cache_data.fd = memInfo.fd;
+        cache_data.handle = memInfo.handle;
+        cache_data.length = memInfo.size;
+        custom_data.cmd = ION_IOC_CLEAN_CACHES;
+        custom_data.arg = (unsigned long)&cache_data;
+        if (ioctl(memInfo.main_ion_fd, ION_IOC_CUSTOM, &custom_data) < 0) {
+            ALOGE("%s: Cache clean failed: %s", __func__, strerror(errno));
+            rc = UNKNOWN_ERROR;
+        }
+    }
+
+    munmap(vaddr, memInfo.size);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : freeIonBuffer
+ *
+ * DESCRIPTION: free one buffer back to /dev/ion
  *
  * PARAMETERS :
  *   @memInfo : reference to struct that stores additional memory allocation info
  *
  * RETURN     : none
  *==========================================================================*/
-void QCameraMemory::deallocOneBuffer(QCameraMemInfo &memInfo)
+void QCameraMemory::freeIonBuffer(QCameraMemInfo &memInfo)
 {
     struct ion_handle_data handle_data;
 
@@ -375,6 +477,288 @@ void QCameraMemory::deallocOneBuffer(QCameraMemInfo &memInfo)
     memInfo.size = 0;
 }
 
+/*===========================================================================
+ * FUNCTION   : getInstance
+ *
+ * DESCRIPTION: get the process wide memory pool
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : ptr to memory pool
+ *==========================================================================*/
+QCameraMemoryPool *QCameraMemoryPool::getInstance()
+{
+    static QCameraMemoryPool instance;
+    return &instance;
+}
+
+/*===========================================================================
+ * FUNCTION   : QCameraMemoryPool
+ *
+ * DESCRIPTION: constructor of QCameraMemoryPool. Budget can be overridden
+ *              in MB by persist.camera.mem.pool.budget, 0 disables caching.
+ *              It is re-read from the tunables registry on every acquire
+ *              and release, so that a refreshed value takes effect.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+QCameraMemoryPool::QCameraMemoryPool()
+    : mCachedBytes(0),
+      mBudget(QCAMERA_MEM_POOL_DEFAULT_BUDGET),
+      mSeq(0),
+      mHits(0),
+      mMisses(0),
+      mUsers(0)
+{
+    pthread_mutex_init(&mLock, NULL);
+    memset(mEntries, 0, sizeof(mEntries));
+
+    updateBudgetLocked();
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraMemoryPool
+ *
+ * DESCRIPTION: deconstructor of QCameraMemoryPool
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+QCameraMemoryPool::~QCameraMemoryPool()
+{
+    trim(0);
+    pthread_mutex_destroy(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : acquire
+ *
+ * DESCRIPTION: take a cached buffer of the same size class out of the pool
+ *
+ * PARAMETERS :
+ *   @memInfo : [output] reference to struct to store buffer info
+ *   @heap_id : [input] heap id the buffer needs to come from
+ *   @size    : [input] requested buffer length
+ *   @cached  : [input] flag indicates if using cached memory
+ *
+ * RETURN     : true if a cached buffer is returned, false otherwise
+ *==========================================================================*/
+bool QCameraMemoryPool::acquire(QCameraMemory::QCameraMemInfo &memInfo,
+                                int heap_id, uint32_t size, bool cached)
+{
+    bool found = false;
+    // same rounding as ion allocation
+    uint32_t len = (size + 4095) & (~4095);
+
+    pthread_mutex_lock(&mLock);
+    updateBudgetLocked();
+    for (int i = 0; i < QCAMERA_MEM_POOL_MAX_ENTRIES; i++) {
+        QCameraPoolEntry &entry = mEntries[i];
+        if (entry.valid &&
+            entry.memInfo.size == len &&
+            entry.memInfo.heap_id == heap_id &&
+            entry.memInfo.cached == cached) {
+            memInfo = entry.memInfo;
+            entry.valid = false;
+            mCachedBytes -= len;
+            found = true;
+            break;
+        }
+    }
+    if (found) {
+        mHits++;
+    } else {
+        mMisses++;
+    }
+    pthread_mutex_unlock(&mLock);
+
+    return found;
+}
+
+/*===========================================================================
+ * FUNCTION   : release
+ *
+ * DESCRIPTION: hand a buffer back to the pool. It is cached if it fits the
+ *              budget after evicting least recently released buffers,
+ *              otherwise it is freed.
+ *
+ * PARAMETERS :
+ *   @memInfo : reference to struct that stores buffer info, cleared on return
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMemoryPool::release(QCameraMemory::QCameraMemInfo &memInfo)
+{
+    bool cachedBuf = false;
+
+    pthread_mutex_lock(&mLock);
+    updateBudgetLocked();
+    if (memInfo.size <= mBudget) {
+        trimLocked(mBudget - memInfo.size);
+        for (int i = 0; i < QCAMERA_MEM_POOL_MAX_ENTRIES; i++) {
+            if (!mEntries[i].valid) {
+                mEntries[i].memInfo = memInfo;
+                mEntries[i].lastUsed = ++mSeq;
+                mEntries[i].valid = true;
+                mCachedBytes += memInfo.size;
+                cachedBuf = true;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+
+    if (cachedBuf) {
+        memInfo.fd = 0;
+        memInfo.main_ion_fd = 0;
+        memInfo.handle = NULL;
+        memInfo.size = 0;
+    } else {
+        QCameraMemory::freeIonBuffer(memInfo);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : trim
+ *
+ * DESCRIPTION: free least recently released buffers until cached bytes fit
+ *              the given limit. Used on memory pressure and thermal events.
+ *
+ * PARAMETERS :
+ *   @budget  : max bytes to keep cached, 0 frees all cached buffers
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMemoryPool::trim(uint32_t budget)
+{
+    pthread_mutex_lock(&mLock);
+    trimLocked(budget);
+    pthread_mutex_unlock(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : addUser
+ *
+ * DESCRIPTION: account for an opened camera. Called when a camera is opened.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMemoryPool::addUser()
+{
+    pthread_mutex_lock(&mLock);
+    mUsers++;
+    pthread_mutex_unlock(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : removeUser
+ *
+ * DESCRIPTION: free all cached buffers once the last camera is closed. Other
+ *              opened cameras keep reusing them. Called when a camera is
+ *              closed.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMemoryPool::removeUser()
+{
+    pthread_mutex_lock(&mLock);
+    if (mUsers > 0 && --mUsers == 0) {
+        trimLocked(0);
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : trimLocked
+ *
+ * DESCRIPTION: impl of trim, caller needs to hold mLock
+ *
+ * PARAMETERS :
+ *   @budget  : max bytes to keep cached
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMemoryPool::trimLocked(uint32_t budget)
+{
+    while (mCachedBytes > budget) {
+        int lru = -1;
+        for (int i = 0; i < QCAMERA_MEM_POOL_MAX_ENTRIES; i++) {
+            if (mEntries[i].valid &&
+                (lru < 0 || mEntries[i].lastUsed < mEntries[lru].lastUsed)) {
+                lru = i;
+            }
+        }
+        if (lru < 0) {
+            break;
+        }
+        mCachedBytes -= mEntries[lru].memInfo.size;
+        mEntries[lru].valid = false;
+        QCameraMemory::freeIonBuffer(mEntries[lru].memInfo);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : updateBudgetLocked
+ *
+ * DESCRIPTION: pick up the current budget from the tunables registry and
+ *              free cached buffers beyond it if it shrank. Caller needs to
+ *              hold mLock.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMemoryPool::updateBudgetLocked()
+{
+    int32_t budgetMB =
+        QCameraTunables::getInstance()->get(QCAMERA_TUNABLE_MEM_POOL_BUDGET);
+    uint32_t budget = QCAMERA_MEM_POOL_DEFAULT_BUDGET;
+
+    if (budgetMB >= 0) {
+        // byte counts are 32 bit, clamp budgets of 4GB and above
+        if (budgetMB > QCAMERA_MEM_POOL_MAX_BUDGET_MB) {
+            budgetMB = QCAMERA_MEM_POOL_MAX_BUDGET_MB;
+        }
+        budget = (uint32_t)budgetMB * 1024 * 1024;
+    }
+    if (budget != mBudget) {
+        ALOGD("%s: pool budget %u -> %u bytes", __func__, mBudget, budget);
+        mBudget = budget;
+        trimLocked(mBudget);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : getStats
+ *
+ * DESCRIPTION: query memory pool usage
+ *
+ * PARAMETERS :
+ *   @cachedBytes : [output] bytes held by cached buffers
+ *   @budget      : [output] max bytes held by cached buffers
+ *   @hits        : [output] number of allocations served from pool
+ *   @misses      : [output] number of allocations that went to ion
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraMemoryPool::getStats(uint32_t &cachedBytes, uint32_t &budget,
+                                 uint32_t &hits, uint32_t &misses)
+{
+    pthread_mutex_lock(&mLock);
+    cachedBytes = mCachedBytes;
+    budget = mBudget;
+    hits = mHits;
+    misses = mMisses;
+    pthread_mutex_unlock(&mLock);
+}
+
 /*===========================================================================
  * FUNCTION   : QCameraHeapMemory
  *
@@ -32,6 +32,7 @@
 
 #include <hardware/camera.h>
 #include <utils/Mutex.h>
+#include <pthread.h>
 
 extern "C" {
 #include <sys/types.h>
@@ -41,8 +42,11 @@ extern "C" {
 
 namespace qcamera {
 
+class QCameraMemoryPool;
+
 // Base class for all memory types. Abstract.
 class QCameraMemory {
+    friend class QCameraMemoryPool;
 
 public:
     int cleanCache(int index) {return cacheOps(index, ION_IOC_CLEAN_CACHES);}
@@ -72,12 +76,18 @@ protected:
         int main_ion_fd;
         struct ion_handle *handle;
         uint32_t size;
+        int heap_id;
+        bool cached;
     };
 
     int alloc(int count, int size, int heap_id);
     void dealloc();
     int allocOneBuffer(struct QCameraMemInfo &memInfo, int heap_id, int size);
     void deallocOneBuffer(struct QCameraMemInfo &memInfo);
+    static int allocIonBuffer(struct QCameraMemInfo &memInfo, int heap_id,
+                              int size, bool cached);
+    static int clearIonBuffer(struct QCameraMemInfo &memInfo);
+    static void freeIonBuffer(struct QCameraMemInfo &memInfo);
     int cacheOpsInternal(int index, unsigned int cmd, void *vaddr);
 
     bool m_bCached;
@@ -85,6 +95,50 @@ protected:
     struct QCameraMemInfo mMemInfo[MM_CAMERA_MAX_NUM_FRAMES];
 };
 
+#define QCAMERA_MEM_POOL_MAX_ENTRIES   32
+#define QCAMERA_MEM_POOL_DEFAULT_BUDGET (64 * 1024 * 1024)
+#define QCAMERA_MEM_POOL_MAX_BUDGET_MB 4095
+
+// Process wide cache of ion buffers released by QCameraMemory objects.
+// Buffers are keyed by page aligned size, heap and cache flag, so that
+// stream restarts and mode switches reuse them instead of going back to
+// /dev/ion. Cached buffers are kept within a memory budget, least recently
+// released ones are freed first. A reused buffer is zeroed, like a fresh one.
+class QCameraMemoryPool {
+public:
+    static QCameraMemoryPool *getInstance();
+
+    bool acquire(QCameraMemory::QCameraMemInfo &memInfo,
+                 int heap_id, uint32_t size, bool cached);
+    void release(QCameraMemory::QCameraMemInfo &memInfo);
+    void trim(uint32_t budget);
+    void addUser();
+    void removeUser();
+    void getStats(uint32_t &cachedBytes, uint32_t &budget,
+                  uint32_t &hits, uint32_t &misses);
+
+private:
+    QCameraMemoryPool();
+    virtual ~QCameraMemoryPool();
+    void trimLocked(uint32_t budget);
+    void updateBudgetLocked();
+
+    struct QCameraPoolEntry {
+        QCameraMemory::QCameraMemInfo memInfo;
+        uint64_t lastUsed;           // release sequence number, for LRU
+        bool valid;
+    };
+
+    pthread_mutex_t mLock;
+    QCameraPoolEntry mEntries[QCAMERA_MEM_POOL_MAX_ENTRIES];
+    uint32_t mCachedBytes;           // bytes held by free entries
+    uint32_t mBudget;                // max bytes held by free entries
+    uint64_t mSeq;
+    uint32_t mHits;
+    uint32_t mMisses;
+    int32_t mUsers;                  // number of opened cameras
+};
+
 // Internal heap memory is used for memories used internally
 // They are allocated from /dev/ion.
 class QCameraHeapMemory : public QCameraMemory {
@@ -559,8 +559,7 @@ QCameraParameters::QCameraParameters()
 {
     char value[PROPERTY_VALUE_MAX];
     // TODO: may move to parameter instead of sysprop
-    property_get("persist.debug.sf.showfps", value, "0");
-    m_bDebugFps = atoi(value) > 0 ? true : false;
+    m_bDebugFps = QCameraTunables::getInstance()->get(QCAMERA_TUNABLE_SHOW_FPS) > 0 ? true : false;
 
     // For thermal mode, it should be set as system property
     // because system property applies to all applications, while
@@ -1111,9 +1110,8 @@ int32_t QCameraParameters::setVideoSize(const QCameraParameters& params)
  *==========================================================================*/
 int32_t QCameraParameters::setLiveSnapshotSize(const QCameraParameters& params)
 {
-    char value[PROPERTY_VALUE_MAX];
-    property_get("persist.camera.opt.livepic", value, "1");
-    bool useOptimal = atoi(value) > 0 ? true : false;
+    bool useOptimal =
+        QCameraTunables::getInstance()->get(QCAMERA_TUNABLE_OPT_LIVEPIC) > 0 ? true : false;
 
     // use picture size from user setting
     params.getPictureSize(&m_LiveSnapshotSize.width, &m_LiveSnapshotSize.height);
@@ -2622,33 +2620,27 @@ int32_t QCameraParameters::setCameraMode(const QCameraParameters& params)
 int32_t QCameraParameters::setZslAttributes(const QCameraParameters& params)
 {
     // TODO: may switch to pure param instead of sysprop
-    char prop[PROPERTY_VALUE_MAX];
+    QCameraTunables *tunables = QCameraTunables::getInstance();
 
     const char *str = params.get(KEY_QC_ZSL_BURST_INTERVAL);
     if (str != NULL) {
         set(KEY_QC_ZSL_BURST_INTERVAL, str);
     } else {
-        memset(prop, 0, sizeof(prop));
-        property_get("persist.camera.zsl.interval", prop, "1");
-        set(KEY_QC_ZSL_BURST_INTERVAL, prop);
+        set(KEY_QC_ZSL_BURST_INTERVAL, tunables->get(QCAMERA_TUNABLE_ZSL_INTERVAL));
     }
 
     str = params.get(KEY_QC_ZSL_BURST_LOOKBACK);
     if (str != NULL) {
         set(KEY_QC_ZSL_BURST_LOOKBACK, str);
     } else {
-        memset(prop, 0, sizeof(prop));
-        property_get("persist.camera.zsl.backlookcnt", prop, "2");
-        set(KEY_QC_ZSL_BURST_LOOKBACK, prop);
+        set(KEY_QC_ZSL_BURST_LOOKBACK, tunables->get(QCAMERA_TUNABLE_ZSL_BACKLOOKCNT));
     }
 
     str = params.get(KEY_QC_ZSL_QUEUE_DEPTH);
     if (str != NULL) {
         set(KEY_QC_ZSL_QUEUE_DEPTH, str);
     } else {
-        memset(prop, 0, sizeof(prop));
-        property_get("persist.camera.zsl.queuedepth", prop, "2");
-        set(KEY_QC_ZSL_QUEUE_DEPTH, prop);
+        set(KEY_QC_ZSL_QUEUE_DEPTH, tunables->get(QCAMERA_TUNABLE_ZSL_QUEUEDEPTH));
     }
 
     return NO_ERROR;
@@ -4571,10 +4563,8 @@ int32_t QCameraParameters::setRedeyeReduction(const char *redeyeStr)
  *==========================================================================*/
 cam_denoise_process_type_t QCameraParameters::getWaveletDenoiseProcessPlate()
 {
-    char prop[PROPERTY_VALUE_MAX];
-    memset(prop, 0, sizeof(prop));
-    property_get("persist.denoise.process.plates", prop, "0");
-    int processPlate = atoi(prop);
+    int processPlate =
+        QCameraTunables::getInstance()->get(QCAMERA_TUNABLE_DENOISE_PLATES);
     switch(processPlate) {
     case 0:
         return CAM_WAVELET_DENOISE_YCBCR_PLANE;
@@ -4775,11 +4765,8 @@ int32_t QCameraParameters::getStreamFormat(cam_stream_type_t streamType,
         if ( mPictureFormat == CAM_FORMAT_YUV_422_NV16 ) {
             format = CAM_FORMAT_YUV_422_NV16;
         } else {
-            char prop[PROPERTY_VALUE_MAX];
-            int snapshotFormat;
-            memset(prop, 0, sizeof(prop));
-            property_get("persist.camera.snap.format", prop, "0");
-            snapshotFormat = atoi(prop);
+            int snapshotFormat =
+                QCameraTunables::getInstance()->get(QCAMERA_TUNABLE_SNAP_FORMAT);
             if(snapshotFormat == 1) {
                 format = CAM_FORMAT_YUV_422_NV61;
             } else {
@@ -5032,6 +5019,54 @@ int QCameraParameters::getMaxUnmatchedFramesInQueue()
     return m_pCapability->min_num_pp_bufs;
 }
 
+/*===========================================================================
+ * FUNCTION   : getVideoBatchSize
+ *
+ * DESCRIPTION: get number of video frames delivered per callback. In high
+ *              frame rate modes frames are batched so the callback path
+ *              runs at about 30 times a second.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : video frames per callback, 1 if not batched
+ *==========================================================================*/
+uint8_t QCameraParameters::getVideoBatchSize()
+{
+    if (QCameraTunables::getInstance()->get(QCAMERA_TUNABLE_HFR_BATCH) <= 0) {
+        return 1;
+    }
+
+    int32_t value = CAM_HFR_MODE_OFF;
+    const char *hfrStr = get(KEY_QC_VIDEO_HIGH_FRAME_RATE);
+    if (hfrStr != NULL) {
+        value = lookupAttr(HFR_MODES_MAP,
+                           sizeof(HFR_MODES_MAP)/sizeof(QCameraMap),
+                           hfrStr);
+    }
+
+    uint8_t batch = 1;
+    switch (value) {
+    case CAM_HFR_MODE_60FPS:
+        batch = 2;
+        break;
+    case CAM_HFR_MODE_90FPS:
+        batch = 3;
+        break;
+    case CAM_HFR_MODE_120FPS:
+        batch = 4;
+        break;
+    case CAM_HFR_MODE_150FPS:
+        batch = 5;
+        break;
+    default:
+        break;
+    }
+    if (batch > MM_CAMERA_MAX_BATCH_SIZE) {
+        batch = MM_CAMERA_MAX_BATCH_SIZE;
+    }
+    return batch;
+}
+
 /*===========================================================================
  * FUNCTION   : setRecordingHintValue
  *
@@ -5126,6 +5161,53 @@ uint8_t QCameraParameters::getNumOfHDRBufsIfNeeded()
     return numOfBufs;
 }
 
+/*===========================================================================
+ * FUNCTION   : getNumOfMfnrFrames
+ *
+ * DESCRIPTION: get number of frames to be merged into each snapshot by
+ *              multi frame noise reduction. It is used for low light non-ZSL
+ *              jpeg snapshots, that is night scene modes or a manual ISO at
+ *              or above persist.camera.mfnr.iso, when persist.camera.mfnr.frames
+ *              is set to 2 or more.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : number of frames per snapshot; 1 if noise reduction is not used
+ *==========================================================================*/
+uint8_t QCameraParameters::getNumOfMfnrFrames()
+{
+    QCameraTunables *tunables = QCameraTunables::getInstance();
+    int numOfFrames = tunables->get(QCAMERA_TUNABLE_MFNR_FRAMES);
+    if (numOfFrames < 2 || isZSLMode() || !isJpegPictureFormat()) {
+        return 1;
+    }
+
+    const char *scene_mode = get(KEY_SCENE_MODE);
+    bool lowLight = false;
+    if (scene_mode != NULL &&
+        (strcmp(scene_mode, SCENE_MODE_NIGHT) == 0 ||
+         strcmp(scene_mode, SCENE_MODE_NIGHT_PORTRAIT) == 0)) {
+        lowLight = true;
+    } else if (scene_mode == NULL || strcmp(scene_mode, SCENE_MODE_HDR) != 0) {
+        // auto ISO reports 0 and is not taken as low light
+        int iso = getExifIsoSpeed();
+        lowLight = (iso > 1 && iso >= tunables->get(QCAMERA_TUNABLE_MFNR_ISO));
+    }
+    if (!lowLight) {
+        return 1;
+    }
+
+    if (numOfFrames > QCAMERA_MFNR_FRAMES_MAX) {
+        numOfFrames = QCAMERA_MFNR_FRAMES_MAX;
+    }
+    // total number of captured frames has to fit in the 8 bit burst count
+    int maxFrames = 255 / getNumOfSnapshots();
+    if (numOfFrames > maxFrames) {
+        numOfFrames = maxFrames;
+    }
+    return (uint8_t)numOfFrames;
+}
+
 /*===========================================================================
  * FUNCTION   : getBurstNum
  *
@@ -5137,10 +5219,8 @@ uint8_t QCameraParameters::getNumOfHDRBufsIfNeeded()
  *==========================================================================*/
 int QCameraParameters::getBurstNum()
 {
-    char prop[PROPERTY_VALUE_MAX];
-    memset(prop, 0, sizeof(prop));
-    property_get("persist.camera.snapshot.number", prop, "0");
-    int nBurstNum = atoi(prop);
+    int nBurstNum =
+        QCameraTunables::getInstance()->get(QCAMERA_TUNABLE_SNAPSHOT_NUMBER);
     if (nBurstNum > 0) {
         ALOGD("%s: Reading burst number = %d from properties",
               __func__, nBurstNum);
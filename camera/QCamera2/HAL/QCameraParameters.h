@@ -44,6 +44,7 @@ static const char ExifUndefinedPrefix[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 #define GPS_PROCESSING_METHOD_SIZE       101
 #define EXIF_ASCII_PREFIX_SIZE           8   //(sizeof(ExifAsciiPrefix))
 #define FOCAL_LENGTH_DECIMAL_PRECISION   100
+#define QCAMERA_MFNR_FRAMES_MAX          8   // frames merged into one snapshot
 
 class QCameraParameters: public CameraParameters
 {
@@ -370,12 +371,14 @@ public:
     int getZSLQueueDepth();
     int getZSLBackLookCount();
     int getMaxUnmatchedFramesInQueue();
+    uint8_t getVideoBatchSize();
     bool isZSLMode() {return m_bZslMode;};
     bool isNoDisplayMode() {return m_bNoDisplayMode;};
     bool isWNREnabled() {return m_bWNROn;};
     uint8_t getNumOfSnapshots();
     uint8_t getNumOfExtraHDRBufsIfNeeded();
     uint8_t getNumOfHDRBufsIfNeeded();
+    uint8_t getNumOfMfnrFrames();
     int getBurstNum();
     bool getRecordingHintValue() {return m_bRecordingHint;}; // return local copy of video hint
     int setRecordingHintValue(int32_t value); // set local copy of video hint and send to server
@@ -29,11 +29,14 @@
 
 #define LOG_TAG "QCameraPostProc"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <cutils/properties.h>
 #include <utils/Errors.h>
 
 #include "QCamera2HWI.h"
 #include "QCameraPostProc.h"
+#include "QCameraScaler.h"
 
 namespace qcamera {
 
@@ -56,14 +59,45 @@ QCameraPostProcessor::QCameraPostProcessor(QCamera2HardwareInterface *cam_ctrl)
       m_pJpegOutputMem(NULL),
       m_pJpegExifObj(NULL),
       m_bThumbnailNeeded(TRUE),
+      m_bSwThumbnail(FALSE),
+      m_pThumbMem(NULL),
       m_pReprocChannel(NULL),
       m_inputPPQ(releasePPInputData, this),
+      m_inputNRQ(releasePPInputData, this),
       m_ongoingPPQ(releaseOngoingPPData, this),
       m_inputJpegQ(releaseJpegData, this),
       m_ongoingJpegQ(releaseJpegData, this),
-      m_inputRawQ(releasePPInputData, this)
+      m_inputRawQ(releasePPInputData, this),
+      m_jpegEvtQ(),
+      m_bDngEnabled(FALSE),
+      m_inputDngQ(releaseDngData, this),
+      m_nDngSeqNext(0),
+      m_nDngSeqNotify(0),
+      m_nJpegJobsSubmitting(0),
+      m_bJpegSessionNeeded(TRUE),
+      m_nJpegJobsInflight(QCAMERA_JPEG_JOBS_INFLIGHT_DEFAULT),
+      m_nJpegOutBufCnt(QCAMERA_JPEG_JOBS_INFLIGHT_DEFAULT + QCAMERA_JPEG_OUT_BUF_DELIVERY),
+      m_nJpegOutBufGen(0),
+      m_nJpegOutBufNext(0),
+      m_nNRFrames(1),
+      m_nNRCollected(0),
+      m_pNRBuf(NULL),
+      m_nNRBufSize(0)
 {
     memset(&mJpegHandle, 0, sizeof(mJpegHandle));
+    memset(m_bJpegOutBufUsed, 0, sizeof(m_bJpegOutBufUsed));
+    memset(m_jpegOutBufGen, 0, sizeof(m_jpegOutBufGen));
+    memset(m_stageStats, 0, sizeof(m_stageStats));
+    memset(m_pNRFrames, 0, sizeof(m_pNRFrames));
+    memset(&m_thumbOffset, 0, sizeof(m_thumbOffset));
+    for (int i = 0; i < QCAMERA_DNG_WORKERS; i++) {
+        m_dngWorkers[i].pme = this;
+        m_dngWorkers[i].cmdThread = &m_dngTh[i];
+    }
+    pthread_mutex_init(&m_jpegLock, NULL);
+    pthread_cond_init(&m_jpegSubmitCond, NULL);
+    pthread_mutex_init(&m_dngLock, NULL);
+    pthread_cond_init(&m_dngCond, NULL);
 }
 
 /*===========================================================================
@@ -82,6 +116,7 @@ QCameraPostProcessor::~QCameraPostProcessor()
         delete m_pJpegOutputMem;
         m_pJpegOutputMem = NULL;
     }
+    releaseSwThumbBufs();
     if (m_pJpegExifObj != NULL) {
         delete m_pJpegExifObj;
         m_pJpegExifObj = NULL;
@@ -91,6 +126,14 @@ QCameraPostProcessor::~QCameraPostProcessor()
         delete m_pReprocChannel;
         m_pReprocChannel = NULL;
     }
+    if (m_pNRBuf != NULL) {
+        free(m_pNRBuf);
+        m_pNRBuf = NULL;
+    }
+    pthread_cond_destroy(&m_dngCond);
+    pthread_mutex_destroy(&m_dngLock);
+    pthread_cond_destroy(&m_jpegSubmitCond);
+    pthread_mutex_destroy(&m_jpegLock);
 }
 
 /*===========================================================================
@@ -117,7 +160,31 @@ int32_t QCameraPostProcessor::init(jpeg_encode_callback_t jpeg_cb, void *user_da
         return UNKNOWN_ERROR;
     }
 
+    QCameraTunables *tunables = QCameraTunables::getInstance();
+    if (tunables->isSet(QCAMERA_TUNABLE_JPEG_INFLIGHT)) {
+        int inflight = tunables->get(QCAMERA_TUNABLE_JPEG_INFLIGHT);
+        if (inflight < 1) {
+            inflight = 1;
+        } else if (inflight > QCAMERA_JPEG_JOBS_INFLIGHT_MAX) {
+            inflight = QCAMERA_JPEG_JOBS_INFLIGHT_MAX;
+        }
+        m_nJpegJobsInflight = (uint32_t)inflight;
+    }
+    m_nJpegOutBufCnt = m_nJpegJobsInflight + QCAMERA_JPEG_OUT_BUF_DELIVERY;
+    m_nJpegOutBufNext = 0;
+    m_stageStats[QCAMERA_PP_STAGE_JPEG_SUBMIT].maxInflight = m_nJpegJobsInflight;
+
     m_dataProcTh.launch(dataProcessRoutine, this);
+    m_jpegSubmitTh.launch(jpegSubmitRoutine, this);
+    m_jpegNotifyTh.launch(jpegNotifyRoutine, this);
+
+    m_bSwThumbnail = (tunables->get(QCAMERA_TUNABLE_THUMB_SW) > 0);
+    m_bDngEnabled = (tunables->get(QCAMERA_TUNABLE_RAW_DNG) > 0);
+    if (m_bDngEnabled) {
+        for (int i = 0; i < QCAMERA_DNG_WORKERS; i++) {
+            m_dngTh[i].launch(dngEncodeRoutine, &m_dngWorkers[i]);
+        }
+    }
 
     return NO_ERROR;
 }
@@ -136,6 +203,13 @@ int32_t QCameraPostProcessor::init(jpeg_encode_callback_t jpeg_cb, void *user_da
 int32_t QCameraPostProcessor::deinit()
 {
     m_dataProcTh.exit();
+    m_jpegNotifyTh.exit();
+    m_jpegSubmitTh.exit();
+    if (m_bDngEnabled) {
+        for (int i = 0; i < QCAMERA_DNG_WORKERS; i++) {
+            m_dngTh[i].exit();
+        }
+    }
 
     if(mJpegClientHandle > 0) {
         int rc = mJpegHandle.close(mJpegClientHandle);
@@ -151,8 +225,8 @@ int32_t QCameraPostProcessor::deinit()
 /*===========================================================================
  * FUNCTION   : start
  *
- * DESCRIPTION: start postprocessor. Data process thread and data notify thread
- *              will be launched.
+ * DESCRIPTION: start postprocessor. Reprocess, jpeg submit and jpeg notify
+ *              stages will be activated.
  *
  * PARAMETERS :
  *   @pSrcChannel : source channel obj ptr that possibly needs reprocess
@@ -162,11 +236,13 @@ int32_t QCameraPostProcessor::deinit()
  *              none-zero failure code
  *
  * NOTE       : if any reprocess is needed, a reprocess channel/stream
- *              will be started.
+ *              will be started. Noise reduction is used when the HWI
+ *              captures several frames per snapshot.
  *==========================================================================*/
 int32_t QCameraPostProcessor::start(QCameraChannel *pSrcChannel)
 {
     int32_t rc = NO_ERROR;
+    m_nNRFrames = m_parent->numOfMfnrFrames();
     if (m_parent->needReprocess()) {
         if (m_pReprocChannel != NULL) {
             delete m_pReprocChannel;
@@ -188,6 +264,13 @@ int32_t QCameraPostProcessor::start(QCameraChannel *pSrcChannel)
         }
     }
 
+    if (m_bDngEnabled) {
+        for (int i = 0; i < QCAMERA_DNG_WORKERS; i++) {
+            m_dngTh[i].sendCmd(CAMERA_CMD_TYPE_START_DATA_PROC, FALSE, FALSE);
+        }
+    }
+    m_jpegNotifyTh.sendCmd(CAMERA_CMD_TYPE_START_DATA_PROC, FALSE, FALSE);
+    m_jpegSubmitTh.sendCmd(CAMERA_CMD_TYPE_START_DATA_PROC, FALSE, FALSE);
     m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_START_DATA_PROC, FALSE, FALSE);
     m_parent->m_cbNotifier.startSnapshots();
 
@@ -197,7 +280,9 @@ int32_t QCameraPostProcessor::start(QCameraChannel *pSrcChannel)
 /*===========================================================================
  * FUNCTION   : stop
  *
- * DESCRIPTION: stop postprocessor. Data process and notify thread will be stopped.
+ * DESCRIPTION: stop postprocessor. All processing stages will be stopped,
+ *              starting from the jpeg completion stage so that no encoded
+ *              output is accessed after its session is destroyed.
  *
  * PARAMETERS : None
  *
@@ -210,7 +295,16 @@ int32_t QCameraPostProcessor::start(QCameraChannel *pSrcChannel)
 int32_t QCameraPostProcessor::stop()
 {
     m_parent->m_cbNotifier.stopSnapshots();
-    // dataProc Thread need to process "stop" as sync call because abort jpeg job should be a sync call
+    // stages need to process "stop" as sync call because abort jpeg job should be a sync call
+    m_jpegNotifyTh.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, TRUE);
+    m_jpegSubmitTh.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, TRUE);
+    // dng jobs come from jpeg submit stage; a worker acknowledges stop
+    // once the job it is encoding has been handed up
+    if (m_bDngEnabled) {
+        for (int i = 0; i < QCAMERA_DNG_WORKERS; i++) {
+            m_dngTh[i].sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, TRUE);
+        }
+    }
     m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, TRUE);
 
     return NO_ERROR;
@@ -254,6 +348,9 @@ int32_t QCameraPostProcessor::getJpegEncodingConfig(mm_jpeg_encode_params_t& enc
     main_stream->getFormat(img_fmt);
     encode_parm.color_format = getColorfmtFromImgFmt(img_fmt);
 
+    encode_parm.use_sw_encoder =
+        (QCameraTunables::getInstance()->get(QCAMERA_TUNABLE_JPEG_SWENC) > 0);
+
     // get jpeg quality
     encode_parm.quality = m_parent->getJpegQuality();
     if (encode_parm.quality <= 0) {
@@ -295,7 +392,15 @@ int32_t QCameraPostProcessor::getJpegEncodingConfig(mm_jpeg_encode_params_t& enc
         }
     }
 
-    if (m_bThumbnailNeeded == TRUE) {
+    releaseSwThumbBufs();
+    if (m_bThumbnailNeeded == TRUE && m_bSwThumbnail &&
+        (img_fmt == CAM_FORMAT_YUV_420_NV21 || img_fmt == CAM_FORMAT_YUV_420_NV12)) {
+        // thumbnails are scaled from the main image, one buf per jpeg job
+        ret = allocSwThumbBufs(encode_parm, thumbnailSize);
+        if (ret != NO_ERROR) {
+            goto on_error;
+        }
+    } else if (m_bThumbnailNeeded == TRUE) {
         if (thumb_stream == NULL) {
             thumb_stream = main_stream;
         }
@@ -335,25 +440,29 @@ int32_t QCameraPostProcessor::getJpegEncodingConfig(mm_jpeg_encode_params_t& enc
         ALOGE("%s : No memory for m_pJpegOutputMem", __func__);
         goto on_error;
     }
-    ret = m_pJpegOutputMem->allocate(1, main_offset.frame_len);
+    ret = m_pJpegOutputMem->allocate(m_nJpegOutBufCnt, main_offset.frame_len);
     if(ret != OK) {
         ret = NO_MEMORY;
         ALOGE("%s : No memory for m_pJpegOutputMem", __func__);
         goto on_error;
     }
-    jpeg_mem = m_pJpegOutputMem->getMemory(0, false);
-    if (NULL == jpeg_mem) {
-        ret = NO_MEMORY;
-        ALOGE("%s : initHeapMem for jpeg, ret = NO_MEMORY", __func__);
-        goto on_error;
+    // one output buf per jpeg job that can be in flight, plus the ones
+    // handed up to upper layer without copy
+    encode_parm.num_dst_bufs = m_nJpegOutBufCnt;
+    for (uint32_t i = 0; i < encode_parm.num_dst_bufs; i++) {
+        jpeg_mem = m_pJpegOutputMem->getMemory(i, false);
+        if (NULL == jpeg_mem) {
+            ret = NO_MEMORY;
+            ALOGE("%s : initHeapMem for jpeg, ret = NO_MEMORY", __func__);
+            goto on_error;
+        }
+        encode_parm.dest_buf[i].index = i;
+        encode_parm.dest_buf[i].buf_size = jpeg_mem->size;
+        encode_parm.dest_buf[i].buf_vaddr = (uint8_t *)jpeg_mem->data;
+        encode_parm.dest_buf[i].fd = m_pJpegOutputMem->getFd(i);
+        encode_parm.dest_buf[i].format = MM_JPEG_FMT_YUV;
+        encode_parm.dest_buf[i].offset = main_offset;
     }
-    encode_parm.num_dst_bufs = 1;
-    encode_parm.dest_buf[0].index = 0;
-    encode_parm.dest_buf[0].buf_size = jpeg_mem->size;
-    encode_parm.dest_buf[0].buf_vaddr = (uint8_t *)jpeg_mem->data;
-    encode_parm.dest_buf[0].fd = m_pJpegOutputMem->getFd(0);
-    encode_parm.dest_buf[0].format = MM_JPEG_FMT_YUV;
-    encode_parm.dest_buf[0].offset = main_offset;
 
     ALOGV("%s : X", __func__);
     return NO_ERROR;
@@ -364,6 +473,7 @@ on_error:
         delete m_pJpegOutputMem;
         m_pJpegOutputMem = NULL;
     }
+    releaseSwThumbBufs();
     if (m_pJpegExifObj != NULL) {
         delete m_pJpegExifObj;
         m_pJpegExifObj = NULL;
@@ -372,6 +482,186 @@ on_error:
     return ret;
 }
 
+/*===========================================================================
+ * FUNCTION   : allocSwThumbBufs
+ *
+ * DESCRIPTION: allocate the bufs software thumbnails are scaled into, one
+ *              per jpeg output buf, and set them as thumbnail source of the
+ *              jpeg session. Bufs are square so either orientation fits.
+ *
+ * PARAMETERS :
+ *   @encode_parm : param to be filled with thumbnail bufs
+ *   @thumb_size  : thumbnail size
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraPostProcessor::allocSwThumbBufs(mm_jpeg_encode_params_t& encode_parm,
+                                               cam_dimension_t &thumb_size)
+{
+    int32_t side = (thumb_size.width > thumb_size.height) ?
+        thumb_size.width : thumb_size.height;
+    side = PAD_TO_SIZE(side, CAM_PAD_TO_16);
+
+    memset(&m_thumbOffset, 0, sizeof(cam_frame_len_offset_t));
+    m_thumbOffset.num_planes = 2;
+    m_thumbOffset.mp[0].len = side * side;
+    m_thumbOffset.mp[0].stride = side;
+    m_thumbOffset.mp[0].scanline = side;
+    m_thumbOffset.mp[1].len = side * side / 2;
+    m_thumbOffset.mp[1].stride = side;
+    m_thumbOffset.mp[1].scanline = side / 2;
+    m_thumbOffset.frame_len = PAD_TO_SIZE(m_thumbOffset.mp[0].len +
+                                          m_thumbOffset.mp[1].len,
+                                          CAM_PAD_TO_4K);
+
+    m_pThumbMem = new QCameraStreamMemory(m_parent->mGetMemory,
+                                          m_parent->mCallbackCookie,
+                                          QCAMERA_ION_USE_CACHE);
+    if (NULL == m_pThumbMem) {
+        ALOGE("%s : No memory for m_pThumbMem", __func__);
+        return NO_MEMORY;
+    }
+    if (m_pThumbMem->allocate(m_nJpegOutBufCnt, m_thumbOffset.frame_len) != OK) {
+        ALOGE("%s : No memory for m_pThumbMem", __func__);
+        delete m_pThumbMem;
+        m_pThumbMem = NULL;
+        return NO_MEMORY;
+    }
+
+    encode_parm.num_tmb_bufs = m_nJpegOutBufCnt;
+    for (uint32_t i = 0; i < m_nJpegOutBufCnt; i++) {
+        camera_memory_t *thumb_mem = m_pThumbMem->getMemory(i, false);
+        if (NULL == thumb_mem) {
+            ALOGE("%s : no thumbnail buf %d", __func__, i);
+            releaseSwThumbBufs();
+            return NO_MEMORY;
+        }
+        encode_parm.src_thumb_buf[i].index = i;
+        encode_parm.src_thumb_buf[i].buf_size = thumb_mem->size;
+        encode_parm.src_thumb_buf[i].buf_vaddr = (uint8_t *)thumb_mem->data;
+        encode_parm.src_thumb_buf[i].fd = m_pThumbMem->getFd(i);
+        encode_parm.src_thumb_buf[i].format = MM_JPEG_FMT_YUV;
+        encode_parm.src_thumb_buf[i].offset = m_thumbOffset;
+    }
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseSwThumbBufs
+ *
+ * DESCRIPTION: free the software thumbnail bufs of the jpeg session
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::releaseSwThumbBufs()
+{
+    if (m_pThumbMem != NULL) {
+        m_pThumbMem->deallocate();
+        delete m_pThumbMem;
+        m_pThumbMem = NULL;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : makeSwThumbnail
+ *
+ * DESCRIPTION: scale the crop window of the main frame into a software
+ *              thumbnail buf. Runs on the jpeg submit thread, so it
+ *              overlaps with the encoding of earlier shots in mm-jpeg.
+ *
+ * PARAMETERS :
+ *   @main_stream : main stream
+ *   @main_frame  : main frame
+ *   @index       : thumbnail buf, same as the jpeg output buf of the job
+ *   @thumb_dim   : thumbnail size, as given to the encoder
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraPostProcessor::makeSwThumbnail(QCameraStream *main_stream,
+                                              mm_camera_buf_def_t *main_frame,
+                                              int32_t index,
+                                              cam_dimension_t &thumb_dim)
+{
+    if (m_pThumbMem == NULL || index < 0 || index >= m_pThumbMem->getCnt()) {
+        return BAD_VALUE;
+    }
+    camera_memory_t *thumb_mem = m_pThumbMem->getMemory(index, false);
+    if (thumb_mem == NULL) {
+        return NO_MEMORY;
+    }
+
+    cam_format_t fmt = CAM_FORMAT_YUV_420_NV21;
+    cam_dimension_t dim;
+    cam_rect_t crop;
+    cam_frame_len_offset_t offset;
+    memset(&dim, 0, sizeof(dim));
+    memset(&crop, 0, sizeof(crop));
+    memset(&offset, 0, sizeof(offset));
+    main_stream->getFormat(fmt);
+    main_stream->getFrameDimension(dim);
+    main_stream->getCropInfo(crop);
+    main_stream->getFrameOffset(offset);
+
+    // scaler works on whole chroma samples
+    if (crop.width <= 0 || crop.height <= 0 ||
+        crop.left < 0 || crop.top < 0 ||
+        crop.left + crop.width > dim.width ||
+        crop.top + crop.height > dim.height) {
+        crop.left = 0;
+        crop.top = 0;
+        crop.width = dim.width;
+        crop.height = dim.height;
+    }
+    crop.left &= ~1;
+    crop.top &= ~1;
+    crop.width &= ~1;
+    crop.height &= ~1;
+
+    qcamera_pix_frame_t src, dst;
+    memset(&src, 0, sizeof(src));
+    memset(&dst, 0, sizeof(dst));
+    src.fmt = (fmt == CAM_FORMAT_YUV_420_NV12) ?
+        QCAMERA_PIX_FMT_NV12 : QCAMERA_PIX_FMT_NV21;
+    src.width = dim.width;
+    src.height = dim.height;
+    src.plane[0] = (uint8_t *)main_frame->buffer + offset.mp[0].offset;
+    src.plane[1] = (uint8_t *)main_frame->buffer + offset.mp[0].len +
+        offset.mp[1].offset;
+    src.stride[0] = offset.mp[0].stride;
+    src.stride[1] = offset.mp[1].stride;
+
+    dst.fmt = src.fmt;
+    dst.width = thumb_dim.width & ~1;
+    dst.height = thumb_dim.height & ~1;
+    dst.plane[0] = (uint8_t *)thumb_mem->data;
+    dst.plane[1] = (uint8_t *)thumb_mem->data + m_thumbOffset.mp[0].len;
+    dst.stride[0] = m_thumbOffset.mp[0].stride;
+    dst.stride[1] = m_thumbOffset.mp[1].stride;
+
+    QCameraMemory *memObj = (QCameraMemory *)main_frame->mem_info;
+    if (memObj != NULL) {
+        memObj->invalidateCache(main_frame->buf_idx);
+    }
+    int32_t rc = QCameraScaler::downscale(src, crop.left, crop.top,
+                                          crop.width, crop.height, dst);
+    if (rc != NO_ERROR) {
+        ALOGE("%s: scaling %dx%d to %dx%d failed %d", __func__,
+              crop.width, crop.height, dst.width, dst.height, rc);
+        return rc;
+    }
+    m_pThumbMem->cleanCache(index);
+
+    thumb_dim.width = dst.width;
+    thumb_dim.height = dst.height;
+    return NO_ERROR;
+}
+
 /*===========================================================================
  * FUNCTION   : sendEvtNotify
  *
@@ -466,10 +756,18 @@ int32_t QCameraPostProcessor::sendDataNotify(int32_t msg_type,
  *==========================================================================*/
 int32_t QCameraPostProcessor::processData(mm_camera_super_buf_t *frame)
 {
-    if (m_parent->needReprocess()) {
+    if (m_nNRFrames > 1) {
+        ALOGD("%s: need noise reduction", __func__);
+        // enqueue to noise reduction input queue
+        m_inputNRQ.enqueue((void *)frame);
+        updatePeakPending(QCAMERA_PP_STAGE_REPROCESS, m_inputNRQ);
+        m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+    } else if (m_parent->needReprocess()) {
         ALOGD("%s: need reprocess", __func__);
         // enqueu to post proc input queue
         m_inputPPQ.enqueue((void *)frame);
+        updatePeakPending(QCAMERA_PP_STAGE_REPROCESS, m_inputPPQ);
+        m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
     } else if (m_parent->mParameters.isNV16PictureFormat()) {
         processRawData(frame);
     } else {
@@ -483,11 +781,13 @@ int32_t QCameraPostProcessor::processData(mm_camera_super_buf_t *frame)
 
         memset(jpeg_job, 0, sizeof(qcamera_jpeg_data_t));
         jpeg_job->src_frame = frame;
+        jpeg_job->dst_idx = -1;
 
         // enqueu to jpeg input queue
         m_inputJpegQ.enqueue((void *)jpeg_job);
+        updatePeakPending(QCAMERA_PP_STAGE_JPEG_SUBMIT, m_inputJpegQ);
+        m_jpegSubmitTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
     }
-    m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
 
     return NO_ERROR;
 }
@@ -508,14 +808,47 @@ int32_t QCameraPostProcessor::processRawData(mm_camera_super_buf_t *frame)
 {
     // enqueu to raw input queue
     m_inputRawQ.enqueue((void *)frame);
-    m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+    m_jpegSubmitTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
     return NO_ERROR;
 }
 
 /*===========================================================================
  * FUNCTION   : processJpegEvt
  *
- * DESCRIPTION: process jpeg event from mm-jpeg-interface.
+ * DESCRIPTION: enqueue jpeg event from mm-jpeg-interface into the jpeg
+ *              notify stage.
+ *
+ * PARAMETERS :
+ *   @evt     : payload of jpeg event, including information about jpeg encoding
+ *              status, jpeg size and so on.
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *
+ * NOTE       : evt is owned by the caller, a copy is queued
+ *==========================================================================*/
+int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
+{
+    qcamera_jpeg_evt_payload_t *jpeg_evt =
+        (qcamera_jpeg_evt_payload_t *)malloc(sizeof(qcamera_jpeg_evt_payload_t));
+    if (NULL == jpeg_evt) {
+        ALOGE("%s: no mem for qcamera_jpeg_evt_payload_t", __func__);
+        return NO_MEMORY;
+    }
+    *jpeg_evt = *evt;
+
+    m_jpegEvtQ.enqueue((void *)jpeg_evt);
+    updatePeakPending(QCAMERA_PP_STAGE_JPEG_NOTIFY, m_jpegEvtQ);
+    m_jpegNotifyTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : processJpegEvtImpl
+ *
+ * DESCRIPTION: process jpeg event from mm-jpeg-interface in jpeg notify stage.
  *
  * PARAMETERS :
  *   @evt     : payload of jpeg event, including information about jpeg encoding
@@ -525,14 +858,15 @@ int32_t QCameraPostProcessor::processRawData(mm_camera_super_buf_t *frame)
  *              NO_ERROR  -- success
  *              none-zero failure code
  *
- * NOTE       : This event will also trigger DataProc thread to move to next job
+ * NOTE       : This event will also trigger jpeg submit stage to move to next job
  *              processing (i.e., send a new jpeg encoding job to mm-jpeg-interface
  *              if there is any pending job in jpeg input queue)
  *==========================================================================*/
-int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
+int32_t QCameraPostProcessor::processJpegEvtImpl(qcamera_jpeg_evt_payload_t *evt)
 {
     int32_t rc = NO_ERROR;
     camera_memory_t *jpeg_mem = NULL;
+    bool jpegBufHandedUp = false;
 
     // find job by jobId
     qcamera_jpeg_data_t *job = findJpegJobByJobId(evt->jobId);
@@ -543,6 +877,12 @@ int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
         goto end;
     }
 
+    pthread_mutex_lock(&m_jpegLock);
+    if (m_stageStats[QCAMERA_PP_STAGE_JPEG_SUBMIT].inflight > 0) {
+        m_stageStats[QCAMERA_PP_STAGE_JPEG_SUBMIT].inflight--;
+    }
+    pthread_mutex_unlock(&m_jpegLock);
+
     ALOGD("[KPI Perf] %s : jpeg job %d", __func__, evt->jobId);
 
     if (m_parent->mDataCb == NULL ||
@@ -566,24 +906,41 @@ int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
                               QCAMERA_DUMP_FRM_JPEG);
     ALOGD("%s: Dump jpeg_size=%d", __func__, evt->out_data.buf_filled_len);
 
-    // alloc jpeg memory to pass to upper layer
-    jpeg_mem = m_parent->mGetMemory(-1, evt->out_data.buf_filled_len, 1, m_parent->mCallbackCookie);
-    if (NULL == jpeg_mem) {
+    // map the jpeg output buf the encoder wrote into for upper layer,
+    // limited to the encoded length so that no copy is needed
+    if ((NULL == m_pJpegOutputMem) ||
+        (job->dst_idx < 0) ||
+        (job->dst_idx >= m_pJpegOutputMem->getCnt())) {
+        rc = BAD_VALUE;
+        ALOGE("%s : invalid jpeg output buf %d", __func__, job->dst_idx);
+        goto end;
+    }
+    jpeg_mem = m_parent->mGetMemory(m_pJpegOutputMem->getFd(job->dst_idx),
+                                    evt->out_data.buf_filled_len,
+                                    1,
+                                    m_parent->mCallbackCookie);
+    if (NULL == jpeg_mem || NULL == jpeg_mem->data) {
         rc = NO_MEMORY;
         ALOGE("%s : getMemory for jpeg, ret = NO_MEMORY", __func__);
         goto end;
     }
-    memcpy(jpeg_mem->data, evt->out_data.buf_vaddr, evt->out_data.buf_filled_len);
 
     ALOGE("%s : Calling upperlayer callback to store JPEG image", __func__);
     qcamera_release_data_t release_data;
     memset(&release_data, 0, sizeof(qcamera_release_data_t));
     release_data.data = jpeg_mem;
+    // output buf goes back to the pool once upper layer is done with it
+    release_data.release_jpeg_buf = TRUE;
+    release_data.jpeg_buf_idx = job->dst_idx;
+    release_data.jpeg_buf_gen = job->dst_gen;
     rc = sendDataNotify(CAMERA_MSG_COMPRESSED_IMAGE,
                         jpeg_mem,
                         0,
                         NULL,
                         &release_data);
+    if (NO_ERROR == rc) {
+        jpegBufHandedUp = true;
+    }
 
 end:
     if (rc != NO_ERROR) {
@@ -600,13 +957,16 @@ end:
 
     // release internal data for jpeg job
     if (job != NULL) {
+        if (!jpegBufHandedUp) {
+            releaseJpegOutBuf(job->dst_idx, job->dst_gen);
+        }
         releaseJpegJobData(job);
         free(job);
     }
 
-    // wait up data proc thread to do next job,
-    // if previous request is blocked due to ongoing jpeg job
-    m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+    // wake up jpeg submit stage to do next job,
+    // if previous request is blocked due to max jobs in flight
+    m_jpegSubmitTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
 
     return rc;
 }
@@ -651,15 +1011,21 @@ int32_t QCameraPostProcessor::processPPData(mm_camera_super_buf_t *frame)
     memset(jpeg_job, 0, sizeof(qcamera_jpeg_data_t));
     jpeg_job->src_frame = frame;
     jpeg_job->src_reproc_frame = job->src_frame;
+    jpeg_job->dst_idx = -1;
 
     // free pp job buf
     free(job);
 
+    pthread_mutex_lock(&m_jpegLock);
+    m_stageStats[QCAMERA_PP_STAGE_REPROCESS].processed++;
+    pthread_mutex_unlock(&m_jpegLock);
+
     // enqueu reprocessed frame to jpeg input queue
     m_inputJpegQ.enqueue((void *)jpeg_job);
+    updatePeakPending(QCAMERA_PP_STAGE_JPEG_SUBMIT, m_inputJpegQ);
 
-    // wait up data proc thread
-    m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+    // wake up jpeg submit stage
+    m_jpegSubmitTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
 
     return NO_ERROR;
 }
@@ -674,9 +1040,9 @@ int32_t QCameraPostProcessor::processPPData(mm_camera_super_buf_t *frame)
  *
  * RETURN     : ptr to a jpeg job struct. NULL if not found.
  *
- * NOTE       : Currently only one job is sending to mm-jpeg-interface for jpeg
- *              encoding. Therefore simply dequeue from the ongoing Jpeg Queue
- *              will serve the purpose to find the jpeg job.
+ * NOTE       : A job is only added to the ongoing queue once mm-jpeg-interface
+ *              returned its job ID, and its completion can be processed
+ *              before that. The lookup waits for the jobs being submitted.
  *==========================================================================*/
 qcamera_jpeg_data_t *QCameraPostProcessor::findJpegJobByJobId(uint32_t jobId)
 {
@@ -686,11 +1052,212 @@ qcamera_jpeg_data_t *QCameraPostProcessor::findJpegJobByJobId(uint32_t jobId)
         return NULL;
     }
 
-    // currely only one jpeg job ongoing, so simply dequeue the head
-    job = (qcamera_jpeg_data_t *)m_ongoingJpegQ.dequeue();
+    pthread_mutex_lock(&m_jpegLock);
+    job = (qcamera_jpeg_data_t *)m_ongoingJpegQ.dequeue(matchJpegJobId, &jobId);
+    while ((NULL == job) && (m_nJpegJobsSubmitting > 0)) {
+        pthread_cond_wait(&m_jpegSubmitCond, &m_jpegLock);
+        job = (qcamera_jpeg_data_t *)m_ongoingJpegQ.dequeue(matchJpegJobId, &jobId);
+    }
+    pthread_mutex_unlock(&m_jpegLock);
     return job;
 }
 
+/*===========================================================================
+ * FUNCTION   : matchJpegJobId
+ *
+ * DESCRIPTION: matches an ongoing jpeg job by its job ID
+ *
+ * PARAMETERS :
+ *   @data       : ptr to ongoing jpeg job
+ *   @user_data  : user data ptr (QCameraPostProcessor)
+ *   @match_data : ptr to job ID to be matched
+ *
+ * RETURN     : bool match
+ *              true - match found
+ *              false- match not found
+ *==========================================================================*/
+bool QCameraPostProcessor::matchJpegJobId(void *data,
+                                          void */*user_data*/,
+                                          void *match_data)
+{
+    qcamera_jpeg_data_t *job = (qcamera_jpeg_data_t *)data;
+    uint32_t *jobId = (uint32_t *)match_data;
+    if ((NULL != job) && (NULL != jobId)) {
+        return job->jobId == *jobId;
+    }
+    return false;
+}
+
+/*===========================================================================
+ * FUNCTION   : getFreeJpegOutBuf
+ *
+ * DESCRIPTION: find a jpeg output buf neither used by an ongoing jpeg job nor
+ *              referenced by upper layer. Caller needs to hold m_jpegLock.
+ *              Bufs are handed out round robin, starting after the last one
+ *              taken, so a just released buf is the last to be reused.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : index of free output buf, -1 if all bufs are in use or max
+ *              number of jobs is in flight already
+ *==========================================================================*/
+int32_t QCameraPostProcessor::getFreeJpegOutBuf()
+{
+    if (m_stageStats[QCAMERA_PP_STAGE_JPEG_SUBMIT].inflight >= m_nJpegJobsInflight) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < m_nJpegOutBufCnt; i++) {
+        uint32_t idx = (m_nJpegOutBufNext + i) % m_nJpegOutBufCnt;
+        if (!m_bJpegOutBufUsed[idx]) {
+            m_nJpegOutBufNext = (idx + 1) % m_nJpegOutBufCnt;
+            return (int32_t)idx;
+        }
+    }
+    return -1;
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseJpegOutBuf
+ *
+ * DESCRIPTION: mark a jpeg output buf as free after its job is done and the
+ *              encoded image is no longer referenced by upper layer.
+ *              For delivered images this is called from releaseNotifyData()
+ *              once the jpeg data callback has returned. Upper layer
+ *              may still be copying out of the buf then, e.g. across a oneway
+ *              binder call, so the buf must not be overwritten right away.
+ *              getFreeJpegOutBuf() reuses bufs round robin, so with the
+ *              pipeline flowing a released buf is not taken again until
+ *              the other m_nJpegOutBufCnt - 1 bufs have been used.
+ *
+ * PARAMETERS :
+ *   @index   : index of output buf, ignored if negative
+ *   @gen     : jpeg session generation the buf was taken in. The release
+ *              is ignored if the buf has been taken again since.
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::releaseJpegOutBuf(int32_t index, uint32_t gen)
+{
+    if ((index < 0) || (index >= QCAMERA_JPEG_OUT_BUF_MAX)) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_jpegLock);
+    if (m_bJpegOutBufUsed[index] && (m_jpegOutBufGen[index] == gen)) {
+        m_bJpegOutBufUsed[index] = FALSE;
+    } else {
+        ALOGD("%s: stale release of jpeg output buf %d, gen %u",
+              __func__, index, gen);
+    }
+    pthread_mutex_unlock(&m_jpegLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : updatePeakPending
+ *
+ * DESCRIPTION: record the input queue depth high-water mark of a stage
+ *
+ * PARAMETERS :
+ *   @stage   : processing stage
+ *   @queue   : input queue of the stage
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::updatePeakPending(qcamera_pp_stage_t stage,
+                                             QCameraQueue &queue)
+{
+    uint32_t pending = (uint32_t)queue.getCurrentSize();
+
+    pthread_mutex_lock(&m_jpegLock);
+    if (pending > m_stageStats[stage].peakPending) {
+        m_stageStats[stage].peakPending = pending;
+    }
+    pthread_mutex_unlock(&m_jpegLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : getStageStats
+ *
+ * DESCRIPTION: returns occupancy of each processing stage
+ *
+ * PARAMETERS :
+ *   @stats   : array of QCAMERA_PP_STAGE_MAX entries to be filled in
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::getStageStats(qcamera_pp_stage_stats_t *stats)
+{
+    if (NULL == stats) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_jpegLock);
+    memcpy(stats, m_stageStats, sizeof(m_stageStats));
+    pthread_mutex_unlock(&m_jpegLock);
+
+    stats[QCAMERA_PP_STAGE_REPROCESS].pending =
+        m_inputPPQ.getCurrentSize() + m_inputNRQ.getCurrentSize();
+    stats[QCAMERA_PP_STAGE_REPROCESS].inflight = m_ongoingPPQ.getCurrentSize();
+    stats[QCAMERA_PP_STAGE_JPEG_SUBMIT].pending =
+        m_inputJpegQ.getCurrentSize() + m_inputRawQ.getCurrentSize() +
+        m_inputDngQ.getCurrentSize();
+    stats[QCAMERA_PP_STAGE_JPEG_NOTIFY].pending = m_jpegEvtQ.getCurrentSize();
+}
+
+/*===========================================================================
+ * FUNCTION   : abortOngoingJpegJobs
+ *
+ * DESCRIPTION: abort all jpeg jobs handed to mm-jpeg-interface and release
+ *              the jpeg session together with its output bufs
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *
+ * NOTE       : Output bufs whose image is still held by upper layer stay in
+ *              use until their release arrives, the generation is bumped so
+ *              that releases of older jobs never free a buf taken again.
+ *==========================================================================*/
+void QCameraPostProcessor::abortOngoingJpegJobs()
+{
+    // cancel all ongoing jpeg jobs
+    qcamera_jpeg_data_t *jpeg_job =
+        (qcamera_jpeg_data_t *)m_ongoingJpegQ.dequeue();
+    while (jpeg_job != NULL) {
+        mJpegHandle.abort_job(jpeg_job->jobId);
+
+        releaseJpegOutBuf(jpeg_job->dst_idx, jpeg_job->dst_gen);
+        releaseJpegJobData(jpeg_job);
+        free(jpeg_job);
+
+        jpeg_job = (qcamera_jpeg_data_t *)m_ongoingJpegQ.dequeue();
+    }
+
+    // destroy jpeg encoding session
+    if ( 0 < mJpegSessionId ) {
+        mJpegHandle.destroy_session(mJpegSessionId);
+        mJpegSessionId = 0;
+    }
+
+    // free jpeg out buf and exif obj
+    if (m_pJpegOutputMem != NULL) {
+        m_pJpegOutputMem->deallocate();
+        delete m_pJpegOutputMem;
+        m_pJpegOutputMem = NULL;
+    }
+    if (m_pJpegExifObj != NULL) {
+        delete m_pJpegExifObj;
+        m_pJpegExifObj = NULL;
+    }
+
+    pthread_mutex_lock(&m_jpegLock);
+    m_nJpegOutBufGen++;
+    m_stageStats[QCAMERA_PP_STAGE_JPEG_SUBMIT].inflight = 0;
+    m_bJpegSessionNeeded = TRUE;
+    pthread_mutex_unlock(&m_jpegLock);
+}
+
 /*===========================================================================
  * FUNCTION   : releasePPInputData
  *
@@ -753,6 +1320,28 @@ void QCameraPostProcessor::releaseOngoingPPData(void *data, void *user_data)
     }
 }
 
+/*===========================================================================
+ * FUNCTION   : releaseDngData
+ *
+ * DESCRIPTION: callback function to release dng encode job node
+ *
+ * PARAMETERS :
+ *   @data      : ptr to dng encode job
+ *   @user_data : user data ptr (QCameraReprocessor)
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::releaseDngData(void *data, void *user_data)
+{
+    QCameraPostProcessor *pme = (QCameraPostProcessor *)user_data;
+    qcamera_dng_job_t *job = (qcamera_dng_job_t *)data;
+    if (NULL != pme && NULL != job && NULL != job->src_frame) {
+        pme->releaseSuperBuf(job->src_frame);
+        free(job->src_frame);
+        job->src_frame = NULL;
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : releaseNotifyData
  *
@@ -764,7 +1353,8 @@ void QCameraPostProcessor::releaseOngoingPPData(void *data, void *user_data)
  *
  * RETURN     : None
  *
- * NOTE       : deallocate jpeg heap memory if it's not NULL
+ * NOTE       : deallocate jpeg heap memory if it's not NULL, and return
+ *              jpeg output buf to the pool if it was handed up
  *==========================================================================*/
 void QCameraPostProcessor::releaseNotifyData(void *user_data, void *cookie)
 {
@@ -780,6 +1370,13 @@ void QCameraPostProcessor::releaseNotifyData(void *user_data, void *cookie)
             free(app_cb->release_data.frame);
             app_cb->release_data.frame = NULL;
         }
+        if (app_cb->release_data.release_jpeg_buf) {
+            postProc->releaseJpegOutBuf(app_cb->release_data.jpeg_buf_idx,
+                                        app_cb->release_data.jpeg_buf_gen);
+            app_cb->release_data.release_jpeg_buf = FALSE;
+            // a free output buf may unblock a pending jpeg job
+            postProc->m_jpegSubmitTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+        }
         free(app_cb);
     }
 }
@@ -1019,6 +1616,7 @@ int32_t QCameraPostProcessor::encodeData(qcamera_jpeg_data_t *jpeg_job_data,
         return UNKNOWN_ERROR;
     }
 
+    bool sessCreated = false;
     if (needNewSess) {
         // create jpeg encoding session
         mm_jpeg_encode_params_t encodeParam;
@@ -1031,6 +1629,7 @@ int32_t QCameraPostProcessor::encodeData(qcamera_jpeg_data_t *jpeg_job_data,
             return ret;
         }
         needNewSess = FALSE;
+        sessCreated = true;
     }
 
     // Fill in new job
@@ -1038,7 +1637,20 @@ int32_t QCameraPostProcessor::encodeData(qcamera_jpeg_data_t *jpeg_job_data,
     jpg_job.job_type = JPEG_JOB_TYPE_ENCODE;
     jpg_job.encode_job.session_id = mJpegSessionId;
     jpg_job.encode_job.src_index = main_frame->buf_idx;
-    jpg_job.encode_job.dst_index = 0;
+    jpg_job.encode_job.dst_index = jpeg_job_data->dst_idx;
+
+    // A new session already carries fresh exif. Later shots of the session
+    // patch per shot values into a copy of the session template, held by
+    // the jpeg output buf slot so it stays valid while the job is in flight.
+    if (!sessCreated && m_pJpegExifObj != NULL &&
+        jpeg_job_data->dst_idx >= 0 &&
+        jpeg_job_data->dst_idx < QCAMERA_JPEG_OUT_BUF_MAX) {
+        QCameraExif *jobExif = &m_jobExif[jpeg_job_data->dst_idx];
+        jobExif->copyFrom(*m_pJpegExifObj);
+        m_parent->updateExifData(jobExif);
+        jpg_job.encode_job.exif_info.exif_data = jobExif->getEntries();
+        jpg_job.encode_job.exif_info.numOfEntries = jobExif->getNumOfEntries();
+    }
 
     cam_rect_t crop;
     memset(&crop, 0, sizeof(cam_rect_t));
@@ -1054,7 +1666,32 @@ int32_t QCameraPostProcessor::encodeData(qcamera_jpeg_data_t *jpeg_job_data,
     jpg_job.encode_job.main_dim.crop = crop;
 
     // thumbnail dim
-    if (m_bThumbnailNeeded == TRUE) {
+    if (m_bThumbnailNeeded == TRUE && m_pThumbMem != NULL) {
+        // scale the thumbnail from the main frame at its final size, the
+        // encoder then takes it as is
+        cam_dimension_t thumb_size;
+        memset(&thumb_size, 0, sizeof(cam_dimension_t));
+        m_parent->getThumbnailSize(thumb_size);
+        int rotation = m_parent->getJpegRotation();
+        if (rotation == 90 || rotation ==270) {
+            // swap dimension if rotation is 90 or 270
+            int32_t temp = thumb_size.height;
+            thumb_size.height = thumb_size.width;
+            thumb_size.width = temp;
+        }
+        ret = makeSwThumbnail(main_stream, main_frame,
+                              jpeg_job_data->dst_idx, thumb_size);
+        if (ret != NO_ERROR) {
+            return ret;
+        }
+        jpg_job.encode_job.thumb_dim.src_dim = thumb_size;
+        jpg_job.encode_job.thumb_dim.dst_dim = thumb_size;
+        memset(&crop, 0, sizeof(cam_rect_t));
+        crop.width = thumb_size.width;
+        crop.height = thumb_size.height;
+        jpg_job.encode_job.thumb_dim.crop = crop;
+        jpg_job.encode_job.thumb_index = jpeg_job_data->dst_idx;
+    } else if (m_bThumbnailNeeded == TRUE) {
         if (thumb_stream == NULL) {
             // need jpeg thumbnail, but no postview/preview stream exists
             // we use the main stream/frame to encode thumbnail
@@ -1184,6 +1821,27 @@ int32_t QCameraPostProcessor::processRawImageImpl(mm_camera_super_buf_t *recvd_f
 
         if ((m_parent->mDataCb != NULL) &&
             m_parent->msgTypeEnabledWithLock(CAMERA_MSG_COMPRESSED_IMAGE) > 0) {
+            // hand bayer frames to dng workers so that encoding does not
+            // hold up jpeg and raw jobs queued behind this one
+            qcamera_dng_job_t *dng_job = NULL;
+            if (m_bDngEnabled) {
+                dng_job = (qcamera_dng_job_t *)malloc(sizeof(qcamera_dng_job_t));
+            }
+            if (NULL != dng_job) {
+                memset(dng_job, 0, sizeof(qcamera_dng_job_t));
+                if (getRawFrame(recvd_frame, frame, dng_job->raw) == NO_ERROR) {
+                    m_parent->getDngInfo(dng_job->info);
+                    dng_job->src_frame = recvd_frame;
+                    m_inputDngQ.enqueue((void *)dng_job);
+                    for (int i = 0; i < QCAMERA_DNG_WORKERS; i++) {
+                        m_dngTh[i].sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+                    }
+                    return NO_ERROR;
+                }
+                ALOGE("%s: no dng support for raw format, sending raw buf", __func__);
+                free(dng_job);
+            }
+
             qcamera_release_data_t release_data;
             memset(&release_data, 0, sizeof(qcamera_release_data_t));
             release_data.frame = recvd_frame;
@@ -1202,98 +1860,830 @@ int32_t QCameraPostProcessor::processRawImageImpl(mm_camera_super_buf_t *recvd_f
 }
 
 /*===========================================================================
- * FUNCTION   : dataProcessRoutine
+ * FUNCTION   : getRawFrame
  *
- * DESCRIPTION: data process routine that handles input data either from input
- *              Jpeg Queue to do jpeg encoding, or from input PP Queue to do
- *              reprocess.
+ * DESCRIPTION: describe the bayer layout of a raw buffer for dng encoding
  *
  * PARAMETERS :
- *   @data    : user data ptr (QCameraPostProcessor)
+ *   @recvd_frame : superbuf frame the raw buffer belongs to
+ *   @frame       : raw buffer
+ *   @raw         : [output] bayer frame layout
  *
- * RETURN     : None
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code, also if the format is not bayer
  *==========================================================================*/
-void *QCameraPostProcessor::dataProcessRoutine(void *data)
+int32_t QCameraPostProcessor::getRawFrame(mm_camera_super_buf_t *recvd_frame,
+                                          mm_camera_buf_def_t *frame,
+                                          qcamera_raw_frame_t &raw)
 {
-    int running = 1;
-    int ret;
-    uint8_t is_active = FALSE;
-    uint8_t needNewSess = TRUE;
-    QCameraPostProcessor *pme = (QCameraPostProcessor *)data;
-    QCameraCmdThread *cmdThread = &pme->m_dataProcTh;
-
-    ALOGD("%s: E", __func__);
-    do {
-        do {
-            ret = cam_sem_wait(&cmdThread->cmd_sem);
-            if (ret != 0 && errno != EINVAL) {
-                ALOGE("%s: cam_sem_wait error (%s)",
-                           __func__, strerror(errno));
-                return NULL;
-            }
-        } while (ret != 0);
+    // packed bayer formats come in groups of four color orders, starting
+    // with GBRG; stride of the stream is converted to bytes per row
+    static const struct {
+        cam_format_t first;
+        qcamera_raw_packing_t packing;
+        uint32_t bits;
+    } rawFormats[] = {
+        { CAM_FORMAT_BAYER_QCOM_RAW_8BPP_GBRG,          QCAMERA_RAW_PACK_PLAIN8,  8  },
+        { CAM_FORMAT_BAYER_QCOM_RAW_10BPP_GBRG,         QCAMERA_RAW_PACK_QCOM10,  10 },
+        { CAM_FORMAT_BAYER_QCOM_RAW_12BPP_GBRG,         QCAMERA_RAW_PACK_QCOM12,  12 },
+        { CAM_FORMAT_BAYER_MIPI_RAW_8BPP_GBRG,          QCAMERA_RAW_PACK_PLAIN8,  8  },
+        { CAM_FORMAT_BAYER_MIPI_RAW_10BPP_GBRG,         QCAMERA_RAW_PACK_MIPI10,  10 },
+        { CAM_FORMAT_BAYER_MIPI_RAW_12BPP_GBRG,         QCAMERA_RAW_PACK_MIPI12,  12 },
+        { CAM_FORMAT_BAYER_IDEAL_RAW_QCOM_8BPP_GBRG,    QCAMERA_RAW_PACK_PLAIN8,  8  },
+        { CAM_FORMAT_BAYER_IDEAL_RAW_QCOM_10BPP_GBRG,   QCAMERA_RAW_PACK_QCOM10,  10 },
+        { CAM_FORMAT_BAYER_IDEAL_RAW_QCOM_12BPP_GBRG,   QCAMERA_RAW_PACK_QCOM12,  12 },
+        { CAM_FORMAT_BAYER_IDEAL_RAW_MIPI_8BPP_GBRG,    QCAMERA_RAW_PACK_PLAIN8,  8  },
+        { CAM_FORMAT_BAYER_IDEAL_RAW_MIPI_10BPP_GBRG,   QCAMERA_RAW_PACK_MIPI10,  10 },
+        { CAM_FORMAT_BAYER_IDEAL_RAW_MIPI_12BPP_GBRG,   QCAMERA_RAW_PACK_MIPI12,  12 },
+        { CAM_FORMAT_BAYER_IDEAL_RAW_PLAIN8_8BPP_GBRG,  QCAMERA_RAW_PACK_PLAIN8,  8  },
+        { CAM_FORMAT_BAYER_IDEAL_RAW_PLAIN16_8BPP_GBRG, QCAMERA_RAW_PACK_PLAIN16, 8  },
+        { CAM_FORMAT_BAYER_IDEAL_RAW_PLAIN16_10BPP_GBRG, QCAMERA_RAW_PACK_PLAIN16, 10 },
+        { CAM_FORMAT_BAYER_IDEAL_RAW_PLAIN16_12BPP_GBRG, QCAMERA_RAW_PACK_PLAIN16, 12 },
+    };
+    static const qcamera_raw_cfa_t cfaOrder[4] = {
+        QCAMERA_RAW_CFA_GBRG,
+        QCAMERA_RAW_CFA_GRBG,
+        QCAMERA_RAW_CFA_RGGB,
+        QCAMERA_RAW_CFA_BGGR,
+    };
 
-        // we got notified about new cmd avail in cmd queue
-        camera_cmd_type_t cmd = cmdThread->getCmd();
-        switch (cmd) {
-        case CAMERA_CMD_TYPE_START_DATA_PROC:
+    QCameraChannel *pChannel = m_parent->getChannelByHandle(recvd_frame->ch_id);
+    if (pChannel == NULL) {
+        return BAD_VALUE;
+    }
+    QCameraStream *pStream = pChannel->getStreamByHandle(frame->stream_id);
+    if (pStream == NULL) {
+        return BAD_VALUE;
+    }
+
+    cam_format_t fmt;
+    cam_dimension_t dim;
+    cam_frame_len_offset_t offset;
+    pStream->getFormat(fmt);
+    pStream->getFrameDimension(dim);
+    pStream->getFrameOffset(offset);
+
+    memset(&raw, 0, sizeof(qcamera_raw_frame_t));
+    raw.packing = QCAMERA_RAW_PACK_MAX;
+    for (size_t i = 0; i < sizeof(rawFormats) / sizeof(rawFormats[0]); i++) {
+        if (fmt >= rawFormats[i].first && fmt < rawFormats[i].first + 4) {
+            raw.packing = rawFormats[i].packing;
+            raw.bits = rawFormats[i].bits;
+            raw.cfa = cfaOrder[fmt - rawFormats[i].first];
+            break;
+        }
+    }
+
+    int32_t stride = offset.mp[0].stride;
+    switch (raw.packing) {
+    case QCAMERA_RAW_PACK_PLAIN8:
+    case QCAMERA_RAW_PACK_MIPI10:
+        raw.stride = stride;
+        break;
+    case QCAMERA_RAW_PACK_MIPI12:
+        raw.stride = stride * 3 / 2;
+        break;
+    case QCAMERA_RAW_PACK_QCOM10:
+        raw.stride = stride * 8 / 6;
+        break;
+    case QCAMERA_RAW_PACK_QCOM12:
+        raw.stride = stride * 8 / 5;
+        break;
+    case QCAMERA_RAW_PACK_PLAIN16:
+        raw.stride = stride * 2;
+        break;
+    default:
+        return BAD_VALUE;
+    }
+
+    raw.width = dim.width;
+    raw.height = dim.height;
+    raw.data = (const uint8_t *)frame->buffer + offset.mp[0].offset;
+    if (offset.mp[0].scanline < dim.height ||
+        (uint32_t)raw.stride < QCameraRawUnpack::getRowBytes(raw.packing, dim.width)) {
+        ALOGE("%s: raw layout %dx%d stride %d too small", __func__,
+              dim.width, dim.height, stride);
+        return BAD_VALUE;
+    }
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : encodeDngData
+ *
+ * DESCRIPTION: encode a raw frame to DNG and send it to upper layer as
+ *              compressed image, after all jobs dequeued before this one
+ *
+ * PARAMETERS :
+ *   @job     : dng encode job, source frame is returned to kernel here
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraPostProcessor::encodeDngData(qcamera_dng_job_t *job)
+{
+    int32_t rc = NO_ERROR;
+    camera_memory_t *dng_mem = NULL;
+    size_t written = 0;
+
+    size_t size = QCameraDngWriter::getSize(job->raw, job->info);
+    if (size == 0) {
+        rc = BAD_VALUE;
+    } else {
+        dng_mem = m_parent->mGetMemory(-1, size, 1, m_parent->mCallbackCookie);
+        if (NULL == dng_mem || NULL == dng_mem->data) {
+            ALOGE("%s : getMemory for dng, ret = NO_MEMORY", __func__);
+            rc = NO_MEMORY;
+        } else {
+            rc = QCameraDngWriter::writeToMemory(job->raw, job->info,
+                (uint8_t *)dng_mem->data, size, written);
+        }
+    }
+
+    // raw buffer is not needed anymore, return it to kernel before waiting
+    // for the notify turn
+    releaseDngData(job, this);
+
+    pthread_mutex_lock(&m_dngLock);
+    while (m_nDngSeqNotify != job->seq) {
+        pthread_cond_wait(&m_dngCond, &m_dngLock);
+    }
+    if (NO_ERROR == rc) {
+        qcamera_release_data_t release_data;
+        memset(&release_data, 0, sizeof(qcamera_release_data_t));
+        release_data.data = dng_mem;
+        rc = sendDataNotify(CAMERA_MSG_COMPRESSED_IMAGE,
+                            dng_mem,
+                            0,
+                            NULL,
+                            &release_data);
+    }
+    m_nDngSeqNotify++;
+    pthread_cond_broadcast(&m_dngCond);
+    pthread_mutex_unlock(&m_dngLock);
+
+    if (NO_ERROR != rc) {
+        ALOGE("%s: dng encoding failed (%d)", __func__, rc);
+        if (NULL != dng_mem) {
+            dng_mem->release(dng_mem);
+        }
+        sendEvtNotify(CAMERA_MSG_ERROR, UNKNOWN_ERROR, 0);
+    }
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : getMainFrame
+ *
+ * DESCRIPTION: find the snapshot buffer of a superbuf frame
+ *
+ * PARAMETERS :
+ *   @frame   : superbuf frame
+ *   @stream  : returns the snapshot stream of the buffer
+ *
+ * RETURN     : ptr to the snapshot buffer, NULL if not found
+ *==========================================================================*/
+mm_camera_buf_def_t *QCameraPostProcessor::getMainFrame(mm_camera_super_buf_t *frame,
+                                                        QCameraStream **stream)
+{
+    QCameraChannel *pChannel = m_parent->getChannelByHandle(frame->ch_id);
+    if (pChannel == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; i < frame->num_bufs; i++) {
+        QCameraStream *pStream =
+            pChannel->getStreamByHandle(frame->bufs[i]->stream_id);
+        if (pStream != NULL &&
+            (pStream->isTypeOf(CAM_STREAM_TYPE_SNAPSHOT) ||
+             pStream->isTypeOf(CAM_STREAM_TYPE_NON_ZSL_SNAPSHOT))) {
+            *stream = pStream;
+            return frame->bufs[i];
+        }
+    }
+    return NULL;
+}
+
+/*===========================================================================
+ * FUNCTION   : reduceNoise
+ *
+ * DESCRIPTION: merge the snapshot buffers of a burst into the snapshot
+ *              buffer of its first frame with temporal noise reduction
+ *
+ * PARAMETERS :
+ *   @frames  : superbuf frames of one snapshot, in capture order
+ *   @num     : number of frames
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *
+ * NOTE       : rows are processed with the stride of the buffers as width,
+ *              so padding is reduced along with the image.
+ *==========================================================================*/
+int32_t QCameraPostProcessor::reduceNoise(mm_camera_super_buf_t **frames, uint8_t num)
+{
+    morpho_ImageData img[QCAMERA_MFNR_FRAMES_MAX];
+    QCameraStream *main_stream = NULL;
+    cam_frame_len_offset_t offset;
+    cam_format_t fmt = CAM_FORMAT_MAX;
+    const char *format = NULL;
+    morpho_NoiseReduction nr;
+    int32_t rc = NO_ERROR;
+    int width, height;
+
+    memset(img, 0, sizeof(img));
+    memset(&offset, 0, sizeof(offset));
+    mm_camera_buf_def_t *main_frame = getMainFrame(frames[0], &main_stream);
+    if (main_frame == NULL) {
+        ALOGE("%s: no snapshot buffer in first frame", __func__);
+        return BAD_VALUE;
+    }
+    main_stream->getFormat(fmt);
+    main_stream->getFrameOffset(offset);
+    if (fmt == CAM_FORMAT_YUV_420_NV21) {
+        format = "YVU420_SEMIPLANAR";
+    } else if (fmt == CAM_FORMAT_YUV_420_NV12) {
+        format = "YUV420_SEMIPLANAR";
+    } else {
+        ALOGE("%s: snapshot format %d not supported", __func__, fmt);
+        return BAD_VALUE;
+    }
+    width = offset.mp[0].stride;
+    height = offset.mp[0].scanline;
+    if (offset.num_planes != 2 ||
+        offset.mp[1].stride != width ||
+        offset.mp[1].len < (uint32_t)(width * height / 2)) {
+        ALOGE("%s: unexpected snapshot plane layout", __func__);
+        return BAD_VALUE;
+    }
+
+    for (uint8_t i = 0; i < num; i++) {
+        QCameraStream *pStream = NULL;
+        mm_camera_buf_def_t *buf = getMainFrame(frames[i], &pStream);
+        if (buf == NULL || pStream != main_stream) {
+            ALOGE("%s: no snapshot buffer in frame %d", __func__, i);
+            return BAD_VALUE;
+        }
+        uint8_t *base = (uint8_t *)buf->buffer;
+        img[i].width = width;
+        img[i].height = height;
+        img[i].dat.semi_planar.y = base + offset.mp[0].offset;
+        img[i].dat.semi_planar.uv = base + offset.mp[0].len + offset.mp[1].offset;
+        QCameraMemory *memObj = (QCameraMemory *)buf->mem_info;
+        if (memObj != NULL) {
+            memObj->invalidateCache(buf->buf_idx);
+        }
+    }
+
+    int size = morpho_NoiseReduction_getBufferSize(width, height, format);
+    if (size <= 0) {
+        ALOGE("%s: size %dx%d not supported", __func__, width, height);
+        return BAD_VALUE;
+    }
+    if (m_pNRBuf == NULL || m_nNRBufSize < size) {
+        if (m_pNRBuf != NULL) {
+            free(m_pNRBuf);
+        }
+        m_nNRBufSize = 0;
+        m_pNRBuf = malloc(size);
+        if (m_pNRBuf == NULL) {
+            ALOGE("%s: no mem for noise reduction", __func__);
+            return NO_MEMORY;
+        }
+        m_nNRBufSize = size;
+    }
+
+    // output goes to the first frame, which is the reference
+    int ret = morpho_NoiseReduction_initialize(&nr, m_pNRBuf, m_nNRBufSize);
+    if (ret == MORPHO_OK) {
+        ret = morpho_NoiseReduction_setImageFormat(&nr, format);
+        if (ret == MORPHO_OK) {
+            ret = morpho_NoiseReduction_start(&nr, &img[0]);
+        }
+        for (uint8_t i = 0; i < num && ret == MORPHO_OK; i++) {
+            ret = morpho_NoiseReduction_reduceNoise(&nr, &img[i]);
+        }
+        morpho_NoiseReduction_finalize(&nr);
+    }
+    if (ret != MORPHO_OK) {
+        ALOGE("%s: noise reduction failed 0x%x", __func__, ret);
+        rc = UNKNOWN_ERROR;
+    }
+
+    QCameraMemory *memObj = (QCameraMemory *)main_frame->mem_info;
+    if (memObj != NULL) {
+        memObj->cleanInvalidateCache(main_frame->buf_idx);
+    }
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : processNRFrame
+ *
+ * DESCRIPTION: collect the frames of a snapshot, and once all are received
+ *              merge them and send the result to jpeg encoding
+ *
+ * PARAMETERS :
+ *   @frame   : superbuf frame received from capture channel
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *
+ * NOTE       : if noise reduction fails the first frame is encoded as is
+ *==========================================================================*/
+int32_t QCameraPostProcessor::processNRFrame(mm_camera_super_buf_t *frame)
+{
+    m_pNRFrames[m_nNRCollected++] = frame;
+    if (m_nNRCollected < m_nNRFrames) {
+        return NO_ERROR;
+    }
+
+    if (reduceNoise(m_pNRFrames, m_nNRCollected) != NO_ERROR) {
+        ALOGE("%s: encoding first frame without noise reduction", __func__);
+    }
+
+    // keep the merged frame, return the others to kernel
+    mm_camera_super_buf_t *merged = m_pNRFrames[0];
+    m_pNRFrames[0] = NULL;
+    releaseNRFrames();
+
+    qcamera_jpeg_data_t *jpeg_job =
+        (qcamera_jpeg_data_t *)malloc(sizeof(qcamera_jpeg_data_t));
+    if (jpeg_job == NULL) {
+        ALOGE("%s: No memory for jpeg job", __func__);
+        releaseSuperBuf(merged);
+        free(merged);
+        sendEvtNotify(CAMERA_MSG_ERROR, UNKNOWN_ERROR, 0);
+        return NO_MEMORY;
+    }
+
+    memset(jpeg_job, 0, sizeof(qcamera_jpeg_data_t));
+    jpeg_job->src_frame = merged;
+    jpeg_job->dst_idx = -1;
+
+    pthread_mutex_lock(&m_jpegLock);
+    m_stageStats[QCAMERA_PP_STAGE_REPROCESS].processed++;
+    pthread_mutex_unlock(&m_jpegLock);
+
+    // enqueu merged frame to jpeg input queue
+    m_inputJpegQ.enqueue((void *)jpeg_job);
+    updatePeakPending(QCAMERA_PP_STAGE_JPEG_SUBMIT, m_inputJpegQ);
+    m_jpegSubmitTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseNRFrames
+ *
+ * DESCRIPTION: return the frames collected for noise reduction to kernel
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::releaseNRFrames()
+{
+    for (uint8_t i = 0; i < m_nNRCollected; i++) {
+        if (m_pNRFrames[i] != NULL) {
+            releaseSuperBuf(m_pNRFrames[i]);
+            free(m_pNRFrames[i]);
+            m_pNRFrames[i] = NULL;
+        }
+    }
+    m_nNRCollected = 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : dataProcessRoutine
+ *
+ * DESCRIPTION: reprocess stage routine that handles input data from input
+ *              PP Queue to do reprocess. Reprocessed frames are handed to
+ *              the jpeg submit stage through processPPData.
+ *
+ * PARAMETERS :
+ *   @data    : user data ptr (QCameraPostProcessor)
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void *QCameraPostProcessor::dataProcessRoutine(void *data)
+{
+    int running = 1;
+    int ret;
+    uint8_t is_active = FALSE;
+    QCameraPostProcessor *pme = (QCameraPostProcessor *)data;
+    QCameraCmdThread *cmdThread = &pme->m_dataProcTh;
+
+    ALOGD("%s: E", __func__);
+    do {
+        do {
+            ret = cam_sem_wait(&cmdThread->cmd_sem);
+            if (ret != 0 && errno != EINVAL) {
+                ALOGE("%s: cam_sem_wait error (%s)",
+                           __func__, strerror(errno));
+                return NULL;
+            }
+        } while (ret != 0);
+
+        // we got notified about new cmd avail in cmd queue
+        camera_cmd_type_t cmd = cmdThread->getCmd();
+        switch (cmd) {
+        case CAMERA_CMD_TYPE_START_DATA_PROC:
             ALOGD("%s: start data proc", __func__);
             is_active = TRUE;
-            needNewSess = TRUE;
             break;
         case CAMERA_CMD_TYPE_STOP_DATA_PROC:
             {
                 ALOGD("%s: stop data proc", __func__);
                 is_active = FALSE;
 
-                // cancel all ongoing jpeg jobs
-                qcamera_jpeg_data_t *jpeg_job =
-                    (qcamera_jpeg_data_t *)pme->m_ongoingJpegQ.dequeue();
-                while (jpeg_job != NULL) {
-                    pme->mJpegHandle.abort_job(jpeg_job->jobId);
+                // stop reproc channel if exists
+                if (pme->m_pReprocChannel != NULL) {
+                    pme->m_pReprocChannel->stop();
+                    delete pme->m_pReprocChannel;
+                    pme->m_pReprocChannel = NULL;
+                }
+
+                // flush ongoing postproc Queue
+                pme->m_ongoingPPQ.flush();
 
-                    pme->releaseJpegJobData(jpeg_job);
-                    free(jpeg_job);
+                // flush input Postproc Queue
+                pme->m_inputPPQ.flush();
 
-                    jpeg_job = (qcamera_jpeg_data_t *)pme->m_ongoingJpegQ.dequeue();
+                // drop frames of an incomplete noise reduction snapshot
+                pme->m_inputNRQ.flush();
+                pme->releaseNRFrames();
+                if (pme->m_pNRBuf != NULL) {
+                    free(pme->m_pNRBuf);
+                    pme->m_pNRBuf = NULL;
+                    pme->m_nNRBufSize = 0;
                 }
 
-                // destroy jpeg encoding session
-                if ( 0 < pme->mJpegSessionId ) {
-                    pme->mJpegHandle.destroy_session(pme->mJpegSessionId);
-                    pme->mJpegSessionId = 0;
-                }
+                // flush jpeg jobs reprocessed while jpeg stage was stopping
+                pme->m_inputJpegQ.flush();
 
-                // free jpeg out buf and exif obj
-                if (pme->m_pJpegOutputMem != NULL) {
-                    pme->m_pJpegOutputMem->deallocate();
-                    delete pme->m_pJpegOutputMem;
-                    pme->m_pJpegOutputMem = NULL;
+                // signal cmd is completed
+                cam_sem_post(&cmdThread->sync_sem);
+            }
+            break;
+        case CAMERA_CMD_TYPE_DO_NEXT_JOB:
+            {
+                ALOGD("%s: Do next job, active is %d", __func__, is_active);
+                mm_camera_super_buf_t *nr_frame =
+                    (mm_camera_super_buf_t *)pme->m_inputNRQ.dequeue();
+                if (NULL != nr_frame) {
+                    if (is_active == TRUE) {
+                        pme->processNRFrame(nr_frame);
+                    } else {
+                        // not active, simply return buf and do no op
+                        pme->releaseSuperBuf(nr_frame);
+                        free(nr_frame);
+                    }
+                    break;
                 }
-                if (pme->m_pJpegExifObj != NULL) {
-                    delete pme->m_pJpegExifObj;
-                    pme->m_pJpegExifObj = NULL;
+
+                mm_camera_super_buf_t *pp_frame =
+                    (mm_camera_super_buf_t *)pme->m_inputPPQ.dequeue();
+                if (NULL == pp_frame) {
+                    break;
                 }
-                needNewSess = TRUE;
 
-                // stop reproc channel if exists
-                if (pme->m_pReprocChannel != NULL) {
-                    pme->m_pReprocChannel->stop();
-                    delete pme->m_pReprocChannel;
-                    pme->m_pReprocChannel = NULL;
+                if (is_active == TRUE) {
+                    qcamera_pp_data_t *pp_job =
+                        (qcamera_pp_data_t *)malloc(sizeof(qcamera_pp_data_t));
+                    if (pp_job != NULL) {
+                        memset(pp_job, 0, sizeof(qcamera_pp_data_t));
+                        if (pme->m_pReprocChannel != NULL) {
+                            // add into ongoing PP job Q
+                            pp_job->src_frame = pp_frame;
+                            pme->m_ongoingPPQ.enqueue((void *)pp_job);
+                            ret = pme->m_pReprocChannel->doReprocess(pp_frame);
+                            if (NO_ERROR != ret) {
+                                // remove from ongoing PP job Q
+                                pme->m_ongoingPPQ.dequeue(false);
+                            }
+                        } else {
+                            ALOGE("%s: Reprocess channel is NULL", __func__);
+                            ret = -1;
+                        }
+                    } else {
+                        ALOGE("%s: no mem for qcamera_pp_data_t", __func__);
+                        ret = -1;
+                    }
+
+                    if (0 != ret) {
+                        // free pp_job
+                        if (pp_job != NULL) {
+                            free(pp_job);
+                        }
+                        // free frame
+                        if (pp_frame != NULL) {
+                            pme->releaseSuperBuf(pp_frame);
+                            free(pp_frame);
+                        }
+                        // send error notify
+                        pme->sendEvtNotify(CAMERA_MSG_ERROR, UNKNOWN_ERROR, 0);
+                    }
+                } else {
+                    // not active, simply return buf and do no op
+                    pme->releaseSuperBuf(pp_frame);
+                    free(pp_frame);
                 }
+            }
+            break;
+        case CAMERA_CMD_TYPE_EXIT:
+            running = 0;
+            break;
+        default:
+            break;
+        }
+    } while (running);
+    ALOGD("%s: X", __func__);
+    return NULL;
+}
 
-                // flush ongoing postproc Queue
-                pme->m_ongoingPPQ.flush();
+/*===========================================================================
+ * FUNCTION   : jpegSubmitRoutine
+ *
+ * DESCRIPTION: jpeg submit stage routine that hands jobs from input Jpeg
+ *              Queue to mm-jpeg-interface as long as a jpeg output buf is
+ *              free, and sends raw images to upper layer.
+ *
+ * PARAMETERS :
+ *   @data    : user data ptr (QCameraPostProcessor)
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void *QCameraPostProcessor::jpegSubmitRoutine(void *data)
+{
+    int running = 1;
+    int ret;
+    uint8_t is_active = FALSE;
+    QCameraPostProcessor *pme = (QCameraPostProcessor *)data;
+    QCameraCmdThread *cmdThread = &pme->m_jpegSubmitTh;
+
+    ALOGD("%s: E", __func__);
+    do {
+        do {
+            ret = cam_sem_wait(&cmdThread->cmd_sem);
+            if (ret != 0 && errno != EINVAL) {
+                ALOGE("%s: cam_sem_wait error (%s)",
+                           __func__, strerror(errno));
+                return NULL;
+            }
+        } while (ret != 0);
+
+        // we got notified about new cmd avail in cmd queue
+        camera_cmd_type_t cmd = cmdThread->getCmd();
+        switch (cmd) {
+        case CAMERA_CMD_TYPE_START_DATA_PROC:
+            ALOGD("%s: start data proc", __func__);
+            is_active = TRUE;
+            pthread_mutex_lock(&pme->m_jpegLock);
+            pme->m_bJpegSessionNeeded = TRUE;
+            pthread_mutex_unlock(&pme->m_jpegLock);
+            break;
+        case CAMERA_CMD_TYPE_STOP_DATA_PROC:
+            {
+                ALOGD("%s: stop data proc", __func__);
+                is_active = FALSE;
+
+                pme->abortOngoingJpegJobs();
 
                 // flush input jpeg Queue
                 pme->m_inputJpegQ.flush();
 
-                // flush input Postproc Queue
-                pme->m_inputPPQ.flush();
+                // flush input raw Queue
+                pme->m_inputRawQ.flush();
+
+                // signal cmd is completed
+                cam_sem_post(&cmdThread->sync_sem);
+            }
+            break;
+        case CAMERA_CMD_TYPE_DO_NEXT_JOB:
+            {
+                ALOGD("%s: Do next job, active is %d", __func__, is_active);
+                if (is_active == TRUE) {
+                    // hand over as many jobs as there are free output bufs
+                    while (TRUE) {
+                        // only pick the output buf under m_jpegLock, the job
+                        // setup is done unlocked so that the jpeg callback and
+                        // the other stages are not blocked behind it
+                        pthread_mutex_lock(&pme->m_jpegLock);
+                        qcamera_jpeg_data_t *jpeg_job = NULL;
+                        int32_t dst_idx = pme->getFreeJpegOutBuf();
+                        if (dst_idx >= 0) {
+                            jpeg_job = (qcamera_jpeg_data_t *)pme->m_inputJpegQ.dequeue();
+                        }
+                        if (NULL == jpeg_job) {
+                            pthread_mutex_unlock(&pme->m_jpegLock);
+                            break;
+                        }
+                        jpeg_job->dst_idx = dst_idx;
+                        jpeg_job->dst_gen = pme->m_nJpegOutBufGen;
+                        pme->m_bJpegOutBufUsed[dst_idx] = TRUE;
+                        pme->m_jpegOutBufGen[dst_idx] = pme->m_nJpegOutBufGen;
+                        pme->m_stageStats[QCAMERA_PP_STAGE_JPEG_SUBMIT].inflight++;
+                        pme->m_nJpegJobsSubmitting++;
+                        uint8_t needNewSess = pme->m_bJpegSessionNeeded;
+                        pthread_mutex_unlock(&pme->m_jpegLock);
+
+                        //play shutter sound
+                        pme->m_parent->playShutter();
+
+                        ret = pme->encodeData(jpeg_job, needNewSess);
+
+                        // publish the job with its job ID to the jpeg notify stage
+                        pthread_mutex_lock(&pme->m_jpegLock);
+                        pme->m_bJpegSessionNeeded = needNewSess;
+                        if (NO_ERROR == ret) {
+                            pme->m_ongoingJpegQ.enqueue((void *)jpeg_job);
+                            pme->m_stageStats[QCAMERA_PP_STAGE_JPEG_SUBMIT].processed++;
+                        } else if (pme->m_stageStats[QCAMERA_PP_STAGE_JPEG_SUBMIT].inflight > 0) {
+                            pme->m_stageStats[QCAMERA_PP_STAGE_JPEG_SUBMIT].inflight--;
+                        }
+                        pme->m_nJpegJobsSubmitting--;
+                        pthread_cond_broadcast(&pme->m_jpegSubmitCond);
+                        pthread_mutex_unlock(&pme->m_jpegLock);
+
+                        if (NO_ERROR != ret) {
+                            pme->releaseJpegOutBuf(dst_idx, jpeg_job->dst_gen);
+                            pme->releaseJpegJobData(jpeg_job);
+                            free(jpeg_job);
+                            pme->sendEvtNotify(CAMERA_MSG_ERROR, UNKNOWN_ERROR, 0);
+                        }
+                    }
+
+                    // process raw data if any
+                    mm_camera_super_buf_t *super_buf =
+                        (mm_camera_super_buf_t *)pme->m_inputRawQ.dequeue();
+
+                    if (NULL != super_buf) {
+                        //play shutter sound
+                        pme->m_parent->playShutter();
+                        ret = pme->processRawImageImpl(super_buf);
+                        if (NO_ERROR != ret) {
+                            pme->releaseSuperBuf(super_buf);
+                            free(super_buf);
+                            pme->sendEvtNotify(CAMERA_MSG_ERROR, UNKNOWN_ERROR, 0);
+                        }
+                    }
+                } else {
+                    // not active, simply return buf and do no op
+                    qcamera_jpeg_data_t *jpeg_data =
+                        (qcamera_jpeg_data_t *)pme->m_inputJpegQ.dequeue();
+                    if (NULL != jpeg_data) {
+                        pme->releaseJpegJobData(jpeg_data);
+                        free(jpeg_data);
+                    }
+                    mm_camera_super_buf_t *super_buf =
+                        (mm_camera_super_buf_t *)pme->m_inputRawQ.dequeue();
+                    if (NULL != super_buf) {
+                        pme->releaseSuperBuf(super_buf);
+                        free(super_buf);
+                    }
+                }
+            }
+            break;
+        case CAMERA_CMD_TYPE_EXIT:
+            running = 0;
+            break;
+        default:
+            break;
+        }
+    } while (running);
+    ALOGD("%s: X", __func__);
+    return NULL;
+}
+
+/*===========================================================================
+ * FUNCTION   : jpegNotifyRoutine
+ *
+ * DESCRIPTION: jpeg notify stage routine that handles jpeg completion events
+ *              and sends the encoded images to upper layer.
+ *
+ * PARAMETERS :
+ *   @data    : user data ptr (QCameraPostProcessor)
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void *QCameraPostProcessor::jpegNotifyRoutine(void *data)
+{
+    int running = 1;
+    int ret;
+    uint8_t is_active = FALSE;
+    QCameraPostProcessor *pme = (QCameraPostProcessor *)data;
+    QCameraCmdThread *cmdThread = &pme->m_jpegNotifyTh;
+
+    ALOGD("%s: E", __func__);
+    do {
+        do {
+            ret = cam_sem_wait(&cmdThread->cmd_sem);
+            if (ret != 0 && errno != EINVAL) {
+                ALOGE("%s: cam_sem_wait error (%s)",
+                           __func__, strerror(errno));
+                return NULL;
+            }
+        } while (ret != 0);
+
+        // we got notified about new cmd avail in cmd queue
+        camera_cmd_type_t cmd = cmdThread->getCmd();
+        switch (cmd) {
+        case CAMERA_CMD_TYPE_START_DATA_PROC:
+            ALOGD("%s: start data proc", __func__);
+            is_active = TRUE;
+            break;
+        case CAMERA_CMD_TYPE_STOP_DATA_PROC:
+            {
+                ALOGD("%s: stop data proc", __func__);
+                is_active = FALSE;
+
+                // pending events belong to jobs aborted by jpeg submit stage
+                pme->m_jpegEvtQ.flush();
+
+                // signal cmd is completed
+                cam_sem_post(&cmdThread->sync_sem);
+            }
+            break;
+        case CAMERA_CMD_TYPE_DO_NEXT_JOB:
+            {
+                qcamera_jpeg_evt_payload_t *jpeg_evt =
+                    (qcamera_jpeg_evt_payload_t *)pme->m_jpegEvtQ.dequeue();
+                if (NULL == jpeg_evt) {
+                    break;
+                }
+
+                ALOGD("%s: Do next job, active is %d", __func__, is_active);
+                if (is_active == TRUE) {
+                    pme->processJpegEvtImpl(jpeg_evt);
+                    pthread_mutex_lock(&pme->m_jpegLock);
+                    pme->m_stageStats[QCAMERA_PP_STAGE_JPEG_NOTIFY].processed++;
+                    pthread_mutex_unlock(&pme->m_jpegLock);
+                }
+                free(jpeg_evt);
+            }
+            break;
+        case CAMERA_CMD_TYPE_EXIT:
+            running = 0;
+            break;
+        default:
+            break;
+        }
+    } while (running);
+    ALOGD("%s: X", __func__);
+    return NULL;
+}
+
+/*===========================================================================
+ * FUNCTION   : dngEncodeRoutine
+ *
+ * DESCRIPTION: dng encode stage routine, one per worker thread. Workers
+ *              share the dng input queue; each job gets its notify order
+ *              when it is dequeued.
+ *
+ * PARAMETERS :
+ *   @data    : worker ptr (qcamera_dng_worker_t)
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void *QCameraPostProcessor::dngEncodeRoutine(void *data)
+{
+    int running = 1;
+    int ret;
+    uint8_t is_active = FALSE;
+    qcamera_dng_worker_t *worker = (qcamera_dng_worker_t *)data;
+    QCameraPostProcessor *pme = worker->pme;
+    QCameraCmdThread *cmdThread = worker->cmdThread;
+
+    ALOGD("%s: E", __func__);
+    do {
+        do {
+            ret = cam_sem_wait(&cmdThread->cmd_sem);
+            if (ret != 0 && errno != EINVAL) {
+                ALOGE("%s: cam_sem_wait error (%s)",
+                           __func__, strerror(errno));
+                return NULL;
+            }
+        } while (ret != 0);
+
+        // we got notified about new cmd avail in cmd queue
+        camera_cmd_type_t cmd = cmdThread->getCmd();
+        switch (cmd) {
+        case CAMERA_CMD_TYPE_START_DATA_PROC:
+            ALOGD("%s: start data proc", __func__);
+            is_active = TRUE;
+            break;
+        case CAMERA_CMD_TYPE_STOP_DATA_PROC:
+            {
+                ALOGD("%s: stop data proc", __func__);
+                is_active = FALSE;
 
-                // flush input raw Queue
-                pme->m_inputRawQ.flush();
+                // flush input dng Queue
+                pme->m_inputDngQ.flush();
 
                 // signal cmd is completed
                 cam_sem_post(&cmdThread->sync_sem);
@@ -1301,105 +2691,27 @@ void *QCameraPostProcessor::dataProcessRoutine(void *data)
             break;
         case CAMERA_CMD_TYPE_DO_NEXT_JOB:
             {
-                ALOGD("%s: Do next job, active is %d", __func__, is_active);
-                if (is_active == TRUE) {
-                    // check if there is any ongoing jpeg jobs
-                    if (pme->m_ongoingJpegQ.isEmpty()) {
-                        // no ongoing jpeg job, we are fine to send jpeg encoding job
-                        qcamera_jpeg_data_t *jpeg_job =
-                            (qcamera_jpeg_data_t *)pme->m_inputJpegQ.dequeue();
-
-                        if (NULL != jpeg_job) {
-                            //play shutter sound
-                            pme->m_parent->playShutter();
-
-                            // add into ongoing jpeg job Q
-                            pme->m_ongoingJpegQ.enqueue((void *)jpeg_job);
-                            ret = pme->encodeData(jpeg_job, needNewSess);
-                            if (NO_ERROR != ret) {
-                                // dequeue the last one
-                                pme->m_ongoingJpegQ.dequeue(false);
-
-                                pme->releaseJpegJobData(jpeg_job);
-                                free(jpeg_job);
-                                pme->sendEvtNotify(CAMERA_MSG_ERROR, UNKNOWN_ERROR, 0);
-                            }
-                        }
+                // drain the queue, other workers pick up jobs queued
+                // while this one is encoding
+                while (TRUE) {
+                    pthread_mutex_lock(&pme->m_dngLock);
+                    qcamera_dng_job_t *dng_job =
+                        (qcamera_dng_job_t *)pme->m_inputDngQ.dequeue();
+                    if (NULL != dng_job && is_active == TRUE) {
+                        dng_job->seq = pme->m_nDngSeqNext++;
                     }
-
-                    // process raw data if any
-                    mm_camera_super_buf_t *super_buf =
-                        (mm_camera_super_buf_t *)pme->m_inputRawQ.dequeue();
-
-                    if (NULL != super_buf) {
-                        //play shutter sound
-                        pme->m_parent->playShutter();
-                        ret = pme->processRawImageImpl(super_buf);
-                        if (NO_ERROR != ret) {
-                            pme->releaseSuperBuf(super_buf);
-                            free(super_buf);
-                            pme->sendEvtNotify(CAMERA_MSG_ERROR, UNKNOWN_ERROR, 0);
-                        }
+                    pthread_mutex_unlock(&pme->m_dngLock);
+                    if (NULL == dng_job) {
+                        break;
                     }
 
-                    mm_camera_super_buf_t *pp_frame =
-                        (mm_camera_super_buf_t *)pme->m_inputPPQ.dequeue();
-                    if (NULL != pp_frame) {
-                        qcamera_pp_data_t *pp_job =
-                            (qcamera_pp_data_t *)malloc(sizeof(qcamera_pp_data_t));
-                        if (pp_job != NULL) {
-                            memset(pp_job, 0, sizeof(qcamera_pp_data_t));
-                            if (pme->m_pReprocChannel != NULL) {
-                                // add into ongoing PP job Q
-                                pp_job->src_frame = pp_frame;
-                                pme->m_ongoingPPQ.enqueue((void *)pp_job);
-                                ret = pme->m_pReprocChannel->doReprocess(pp_frame);
-                                if (NO_ERROR != ret) {
-                                    // remove from ongoing PP job Q
-                                    pme->m_ongoingPPQ.dequeue(false);
-                                }
-                            } else {
-                                ALOGE("%s: Reprocess channel is NULL", __func__);
-                                ret = -1;
-                            }
-                        } else {
-                            ALOGE("%s: no mem for qcamera_pp_data_t", __func__);
-                            ret = -1;
-                        }
-
-                        if (0 != ret) {
-                            // free pp_job
-                            if (pp_job != NULL) {
-                                free(pp_job);
-                            }
-                            // free frame
-                            if (pp_frame != NULL) {
-                                pme->releaseSuperBuf(pp_frame);
-                                free(pp_frame);
-                            }
-                            // send error notify
-                            pme->sendEvtNotify(CAMERA_MSG_ERROR, UNKNOWN_ERROR, 0);
-                        }
-                    }
-                } else {
-                    // not active, simply return buf and do no op
-                    qcamera_jpeg_data_t *jpeg_data =
-                        (qcamera_jpeg_data_t *)pme->m_inputJpegQ.dequeue();
-                    if (NULL != jpeg_data) {
-                        pme->releaseJpegJobData(jpeg_data);
-                        free(jpeg_data);
-                    }
-                    mm_camera_super_buf_t *super_buf =
-                        (mm_camera_super_buf_t *)pme->m_inputRawQ.dequeue();
-                    if (NULL != super_buf) {
-                        pme->releaseSuperBuf(super_buf);
-                        free(super_buf);
-                    }
-                    super_buf = (mm_camera_super_buf_t *)pme->m_inputPPQ.dequeue();
-                    if (NULL != super_buf) {
-                        pme->releaseSuperBuf(super_buf);
-                        free(super_buf);
+                    if (is_active == TRUE) {
+                        pme->encodeDngData(dng_job);
+                    } else {
+                        // not active, simply return buf and do no op
+                        releaseDngData(dng_job, pme);
                     }
+                    free(dng_job);
                 }
             }
             break;
@@ -1445,15 +2757,19 @@ int32_t QCameraPostProcessor::getJpegPaddingReq(cam_padding_info_t &padding_info
  * RETURN     : None
  *==========================================================================*/
 QCameraExif::QCameraExif()
-    : m_nNumEntries(0)
+    : m_nNumEntries(0),
+      m_nArenaUsed(0)
 {
     memset(m_Entries, 0, sizeof(m_Entries));
+    memset(m_nPayloadOffset, 0, sizeof(m_nPayloadOffset));
+    memset(m_nPayloadSize, 0, sizeof(m_nPayloadSize));
 }
 
 /*===========================================================================
  * FUNCTION   : ~QCameraExif
  *
- * DESCRIPTION: deconstructor of QCameraExif. Will release internal memory ptr.
+ * DESCRIPTION: deconstructor of QCameraExif. Entry payloads live in the
+ *              internal arena, so there is nothing to release.
  *
  * PARAMETERS : None
  *
@@ -1461,80 +2777,166 @@ QCameraExif::QCameraExif()
  *==========================================================================*/
 QCameraExif::~QCameraExif()
 {
-    for (uint32_t i = 0; i < m_nNumEntries; i++) {
-        switch (m_Entries[i].tag_entry.type) {
+}
+
+/*===========================================================================
+ * FUNCTION   : getPayloadSize
+ *
+ * DESCRIPTION: get number of arena bytes needed by an entry. Single values
+ *              other than strings are kept inside the entry itself.
+ *
+ * PARAMETERS :
+ *   @type    : data type
+ *   @count   : number of data in uint of its type
+ *
+ * RETURN     : payload size in bytes, 0 if payload is kept in the entry
+ *==========================================================================*/
+uint32_t QCameraExif::getPayloadSize(exif_tag_type_t type, uint32_t count)
+{
+    switch (type) {
+    case EXIF_ASCII:
+        return count + 1;
+    case EXIF_UNDEFINED:
+        return count;
+    case EXIF_BYTE:
+        return (count > 1) ? count : 0;
+    case EXIF_SHORT:
+        return (count > 1) ? count * sizeof(uint16_t) : 0;
+    case EXIF_LONG:
+        return (count > 1) ? count * sizeof(uint32_t) : 0;
+    case EXIF_RATIONAL:
+        return (count > 1) ? count * sizeof(rat_t) : 0;
+    case EXIF_SLONG:
+        return (count > 1) ? count * sizeof(int32_t) : 0;
+    case EXIF_SRATIONAL:
+        return (count > 1) ? count * sizeof(srat_t) : 0;
+    default:
+        return 0;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : bindPayload
+ *
+ * DESCRIPTION: point the data of an entry to its payload in the arena
+ *
+ * PARAMETERS :
+ *   @idx     : index of the entry
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraExif::bindPayload(uint32_t idx)
+{
+    if (m_nPayloadSize[idx] == 0) {
+        return;
+    }
+
+    uint8_t *payload = (uint8_t *)m_Arena + m_nPayloadOffset[idx];
+    exif_tag_entry_t &entry = m_Entries[idx].tag_entry;
+    switch (entry.type) {
+    case EXIF_BYTE:
+        entry.data._bytes = payload;
+        break;
+    case EXIF_ASCII:
+        entry.data._ascii = (char *)payload;
+        break;
+    case EXIF_SHORT:
+        entry.data._shorts = (uint16_t *)payload;
+        break;
+    case EXIF_LONG:
+        entry.data._longs = (uint32_t *)payload;
+        break;
+    case EXIF_RATIONAL:
+        entry.data._rats = (rat_t *)payload;
+        break;
+    case EXIF_UNDEFINED:
+        entry.data._undefined = payload;
+        break;
+    case EXIF_SLONG:
+        entry.data._slongs = (int32_t *)payload;
+        break;
+    case EXIF_SRATIONAL:
+        entry.data._srats = (srat_t *)payload;
+        break;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : setEntry
+ *
+ * DESCRIPTION: fill an entry with new data. The payload is written in place
+ *              if it fits the space already reserved for the entry, otherwise
+ *              new space is taken from the arena.
+ *
+ * PARAMETERS :
+ *   @idx     : index of the entry
+ *   @type    : data type
+ *   @count   : number of data in uint of its type
+ *   @data    : input data ptr
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraExif::setEntry(uint32_t idx,
+                              exif_tag_type_t type,
+                              uint32_t count,
+                              void *data)
+{
+    uint32_t size = getPayloadSize(type, count);
+    if (size > m_nPayloadSize[idx]) {
+        // keep payloads 8 byte aligned for rational arrays
+        uint32_t reserve = (size + 7) & ~7U;
+        if (reserve > sizeof(m_Arena) - m_nArenaUsed) {
+            ALOGE("%s: No space in exif arena for tag 0x%x", __func__,
+                  m_Entries[idx].tag_id);
+            return NO_MEMORY;
+        }
+        m_nPayloadOffset[idx] = m_nArenaUsed;
+        m_nPayloadSize[idx] = reserve;
+        m_nArenaUsed += reserve;
+    }
+
+    exif_tag_entry_t &entry = m_Entries[idx].tag_entry;
+    entry.type = type;
+    entry.count = count;
+    entry.copy = 1;
+    if (size == 0) {
+        switch (type) {
         case EXIF_BYTE:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._bytes != NULL) {
-                    free(m_Entries[i].tag_entry.data._bytes);
-                    m_Entries[i].tag_entry.data._bytes = NULL;
-                }
-            }
-            break;
-        case EXIF_ASCII:
-            {
-                if (m_Entries[i].tag_entry.data._ascii != NULL) {
-                    free(m_Entries[i].tag_entry.data._ascii);
-                    m_Entries[i].tag_entry.data._ascii = NULL;
-                }
-            }
+            entry.data._byte = *(uint8_t *)data;
             break;
         case EXIF_SHORT:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._shorts != NULL) {
-                    free(m_Entries[i].tag_entry.data._shorts);
-                    m_Entries[i].tag_entry.data._shorts = NULL;
-                }
-            }
+            entry.data._short = *(uint16_t *)data;
             break;
         case EXIF_LONG:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._longs != NULL) {
-                    free(m_Entries[i].tag_entry.data._longs);
-                    m_Entries[i].tag_entry.data._longs = NULL;
-                }
-            }
+            entry.data._long = *(uint32_t *)data;
             break;
         case EXIF_RATIONAL:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._rats != NULL) {
-                    free(m_Entries[i].tag_entry.data._rats);
-                    m_Entries[i].tag_entry.data._rats = NULL;
-                }
-            }
-            break;
-        case EXIF_UNDEFINED:
-            {
-                if (m_Entries[i].tag_entry.data._undefined != NULL) {
-                    free(m_Entries[i].tag_entry.data._undefined);
-                    m_Entries[i].tag_entry.data._undefined = NULL;
-                }
-            }
+            entry.data._rat = *(rat_t *)data;
             break;
         case EXIF_SLONG:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._slongs != NULL) {
-                    free(m_Entries[i].tag_entry.data._slongs);
-                    m_Entries[i].tag_entry.data._slongs = NULL;
-                }
-            }
+            entry.data._slong = *(int32_t *)data;
             break;
         case EXIF_SRATIONAL:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._srats != NULL) {
-                    free(m_Entries[i].tag_entry.data._srats);
-                    m_Entries[i].tag_entry.data._srats = NULL;
-                }
-            }
+            entry.data._srat = *(srat_t *)data;
+            break;
+        default:
             break;
         }
+        return NO_ERROR;
+    }
+
+    bindPayload(idx);
+    uint8_t *payload = (uint8_t *)m_Arena + m_nPayloadOffset[idx];
+    if (type == EXIF_ASCII) {
+        // ascii strings are always NULL terminated
+        memcpy(payload, data, count);
+        payload[count] = 0;
+    } else {
+        memcpy(payload, data, size);
     }
+    return NO_ERROR;
 }
 
 /*===========================================================================
@@ -1557,144 +2959,105 @@ int32_t QCameraExif::addEntry(exif_tag_id_t tagid,
                               uint32_t count,
                               void *data)
 {
-    int32_t rc = NO_ERROR;
     if(m_nNumEntries >= MAX_EXIF_TABLE_ENTRIES) {
         ALOGE("%s: Number of entries exceeded limit", __func__);
         return NO_MEMORY;
     }
 
-    m_Entries[m_nNumEntries].tag_id = tagid;
-    m_Entries[m_nNumEntries].tag_entry.type = type;
-    m_Entries[m_nNumEntries].tag_entry.count = count;
-    m_Entries[m_nNumEntries].tag_entry.copy = 1;
-    switch (type) {
-    case EXIF_BYTE:
-        {
-            if (count > 1) {
-                uint8_t *values = (uint8_t *)malloc(count);
-                if (values == NULL) {
-                    ALOGE("%s: No memory for byte array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count);
-                    m_Entries[m_nNumEntries].tag_entry.data._bytes = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._byte = *(uint8_t *)data;
-            }
-        }
-        break;
-    case EXIF_ASCII:
-        {
-            char *str = NULL;
-            str = (char *)malloc(count + 1);
-            if (str == NULL) {
-                ALOGE("%s: No memory for ascii string", __func__);
-                rc = NO_MEMORY;
-            } else {
-                memset(str, 0, count + 1);
-                memcpy(str, data, count);
-                m_Entries[m_nNumEntries].tag_entry.data._ascii = str;
-            }
-        }
-        break;
-    case EXIF_SHORT:
-        {
-            if (count > 1) {
-                uint16_t *values = (uint16_t *)malloc(count * sizeof(uint16_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for short array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(uint16_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._shorts = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._short = *(uint16_t *)data;
-            }
-        }
-        break;
-    case EXIF_LONG:
-        {
-            if (count > 1) {
-                uint32_t *values = (uint32_t *)malloc(count * sizeof(uint32_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for long array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(uint32_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._longs = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._long = *(uint32_t *)data;
-            }
-        }
-        break;
-    case EXIF_RATIONAL:
-        {
-            if (count > 1) {
-                rat_t *values = (rat_t *)malloc(count * sizeof(rat_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for rational array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(rat_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._rats = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._rat = *(rat_t *)data;
-            }
-        }
-        break;
-    case EXIF_UNDEFINED:
-        {
-            uint8_t *values = (uint8_t *)malloc(count);
-            if (values == NULL) {
-                ALOGE("%s: No memory for undefined array", __func__);
-                rc = NO_MEMORY;
-            } else {
-                memcpy(values, data, count);
-                m_Entries[m_nNumEntries].tag_entry.data._undefined = values;
-            }
-        }
-        break;
-    case EXIF_SLONG:
-        {
-            if (count > 1) {
-                int32_t *values = (int32_t *)malloc(count * sizeof(int32_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for signed long array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(int32_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._slongs = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._slong = *(int32_t *)data;
-            }
+    uint32_t idx = m_nNumEntries;
+    m_Entries[idx].tag_id = tagid;
+    m_nPayloadOffset[idx] = 0;
+    m_nPayloadSize[idx] = 0;
+    int32_t rc = setEntry(idx, type, count, data);
+    if (rc == NO_ERROR) {
+        // Increase number of entries
+        m_nNumEntries++;
+    }
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : updateEntry
+ *
+ * DESCRIPTION: function to change the data of an exif entry in place. The
+ *              entry is added if it does not exist yet.
+ *
+ * PARAMETERS :
+ *   @tagid   : exif tag ID
+ *   @type    : data type
+ *   @count   : number of data in uint of its type
+ *   @data    : input data ptr
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraExif::updateEntry(exif_tag_id_t tagid,
+                                 exif_tag_type_t type,
+                                 uint32_t count,
+                                 void *data)
+{
+    for (uint32_t i = 0; i < m_nNumEntries; i++) {
+        if (m_Entries[i].tag_id == tagid) {
+            return setEntry(i, type, count, data);
         }
-        break;
-    case EXIF_SRATIONAL:
-        {
-            if (count > 1) {
-                srat_t *values = (srat_t *)malloc(count * sizeof(srat_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for signed rational array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(srat_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._srats = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._srat = *(srat_t *)data;
+    }
+    return addEntry(tagid, type, count, data);
+}
+
+/*===========================================================================
+ * FUNCTION   : removeEntry
+ *
+ * DESCRIPTION: function to remove an entry from exif data. Its arena space
+ *              is not reused until the object is rebuilt from a template.
+ *
+ * PARAMETERS :
+ *   @tagid   : exif tag ID
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraExif::removeEntry(exif_tag_id_t tagid)
+{
+    for (uint32_t i = 0; i < m_nNumEntries; i++) {
+        if (m_Entries[i].tag_id == tagid) {
+            for (uint32_t j = i + 1; j < m_nNumEntries; j++) {
+                m_Entries[j - 1] = m_Entries[j];
+                m_nPayloadOffset[j - 1] = m_nPayloadOffset[j];
+                m_nPayloadSize[j - 1] = m_nPayloadSize[j];
             }
+            m_nNumEntries--;
+            return;
         }
-        break;
     }
+}
 
-    // Increase number of entries
-    m_nNumEntries++;
-    return rc;
+/*===========================================================================
+ * FUNCTION   : copyFrom
+ *
+ * DESCRIPTION: function to make this exif data a copy of a template. Entries
+ *              keep the payload layout of the template, so per shot values
+ *              can be patched in place afterwards.
+ *
+ * PARAMETERS :
+ *   @tmpl    : exif data to copy from
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraExif::copyFrom(const QCameraExif &tmpl)
+{
+    if (&tmpl == this) {
+        return;
+    }
+
+    m_nNumEntries = tmpl.m_nNumEntries;
+    m_nArenaUsed = tmpl.m_nArenaUsed;
+    memcpy(m_Entries, tmpl.m_Entries, sizeof(QEXIF_INFO_DATA) * m_nNumEntries);
+    memcpy(m_nPayloadOffset, tmpl.m_nPayloadOffset, sizeof(uint32_t) * m_nNumEntries);
+    memcpy(m_nPayloadSize, tmpl.m_nPayloadSize, sizeof(uint32_t) * m_nNumEntries);
+    memcpy(m_Arena, tmpl.m_Arena, m_nArenaUsed);
+    for (uint32_t i = 0; i < m_nNumEntries; i++) {
+        bindPayload(i);
+    }
 }
 
 }; // namespace qcamera
@@ -33,8 +33,10 @@
 extern "C" {
 #include <mm_camera_interface.h>
 #include <mm_jpeg_interface.h>
+#include <morpho_noise_reduction.h>
 }
 #include "QCamera2HWI.h"
+#include "QCameraDngWriter.h"
 
 namespace qcamera {
 
@@ -43,6 +45,8 @@ class QCameraExif;
 typedef struct {
     uint32_t jobId;                  // job ID
     uint32_t client_hdl;             // handle of jpeg client (obtained when open jpeg)
+    int32_t dst_idx;                 // index of jpeg output buf used by the job, -1 if none
+    uint32_t dst_gen;                // jpeg session generation the output buf was taken in
     mm_camera_super_buf_t *src_frame;// source frame (need to be returned back to kernel after done)
     mm_camera_super_buf_t *src_reproc_frame; // original source frame for reproc if not NULL
 } qcamera_jpeg_data_t;
@@ -65,6 +69,9 @@ typedef struct {
 typedef struct {
     camera_memory_t *        data;     // ptr to data memory struct
     mm_camera_super_buf_t *  frame;    // ptr to frame
+    uint8_t                  release_jpeg_buf; // jpeg output buf to be returned to pool
+    int32_t                  jpeg_buf_idx;     // index of jpeg output buf
+    uint32_t                 jpeg_buf_gen;     // jpeg session generation of the output buf
 } qcamera_release_data_t;
 
 typedef struct {
@@ -75,7 +82,49 @@ typedef struct {
     qcamera_release_data_t   release_data; // any data needs to be release after notify
 } qcamera_data_argm_t;
 
+// default and max number of jpeg jobs handed to mm-jpeg-interface at a time
+#define QCAMERA_JPEG_JOBS_INFLIGHT_DEFAULT 2
+#define QCAMERA_JPEG_JOBS_INFLIGHT_MAX     4
+// extra jpeg output bufs to cover encoded images held by upper layer
+#define QCAMERA_JPEG_OUT_BUF_DELIVERY      2
+#define QCAMERA_JPEG_OUT_BUF_MAX \
+    (QCAMERA_JPEG_JOBS_INFLIGHT_MAX + QCAMERA_JPEG_OUT_BUF_DELIVERY)
+
+typedef enum {
+    QCAMERA_PP_STAGE_REPROCESS,      // reprocess submission
+    QCAMERA_PP_STAGE_JPEG_SUBMIT,    // jpeg/raw job submission
+    QCAMERA_PP_STAGE_JPEG_NOTIFY,    // jpeg completion and app notify
+    QCAMERA_PP_STAGE_MAX
+} qcamera_pp_stage_t;
+
+typedef struct {
+    uint32_t pending;                // jobs waiting in the stage input queue
+    uint32_t inflight;               // jobs handed off and not completed yet
+    uint32_t maxInflight;            // bound of inflight jobs, 0 means no bound
+    uint32_t peakPending;            // highest input queue depth seen
+    uint32_t processed;              // jobs completed by the stage
+} qcamera_pp_stage_stats_t;
+
+// threads encoding raw captures to DNG
+#define QCAMERA_DNG_WORKERS 2
+
+typedef struct {
+    mm_camera_super_buf_t *src_frame;// raw frame (need to be returned back to kernel after done)
+    qcamera_raw_frame_t raw;         // bayer layout of the raw buffer
+    qcamera_dng_info_t info;         // tag values taken when the job is queued
+    uint32_t seq;                    // notify order, assigned when dequeued
+} qcamera_dng_job_t;
+
+class QCameraPostProcessor;
+
+typedef struct {
+    QCameraPostProcessor *pme;       // owner of the worker
+    QCameraCmdThread *cmdThread;     // cmd thread running the worker
+} qcamera_dng_worker_t;
+
 #define MAX_EXIF_TABLE_ENTRIES 17
+// bytes of payload storage shared by all exif entries of one object
+#define QCAMERA_EXIF_ARENA_SIZE 1024
 class QCameraExif
 {
 public:
@@ -86,12 +135,29 @@ public:
                      exif_tag_type_t type,
                      uint32_t count,
                      void *data);
+    int32_t updateEntry(exif_tag_id_t tagid,
+                        exif_tag_type_t type,
+                        uint32_t count,
+                        void *data);
+    void removeEntry(exif_tag_id_t tagid);
+    void copyFrom(const QCameraExif &tmpl);
     uint32_t getNumOfEntries() {return m_nNumEntries;};
     QEXIF_INFO_DATA *getEntries() {return m_Entries;};
 
 private:
+    static uint32_t getPayloadSize(exif_tag_type_t type, uint32_t count);
+    void bindPayload(uint32_t idx);
+    int32_t setEntry(uint32_t idx,
+                     exif_tag_type_t type,
+                     uint32_t count,
+                     void *data);
+
     QEXIF_INFO_DATA m_Entries[MAX_EXIF_TABLE_ENTRIES];  // exif tags for JPEG encoder
     uint32_t  m_nNumEntries;                            // number of valid entries
+    uint32_t  m_nPayloadOffset[MAX_EXIF_TABLE_ENTRIES]; // arena offset of entry payload
+    uint32_t  m_nPayloadSize[MAX_EXIF_TABLE_ENTRIES];   // arena bytes reserved for entry
+    uint32_t  m_nArenaUsed;                             // arena bytes handed out
+    uint64_t  m_Arena[QCAMERA_EXIF_ARENA_SIZE / sizeof(uint64_t)]; // payload storage
 };
 
 class QCameraPostProcessor
@@ -109,6 +175,9 @@ public:
     int32_t processPPData(mm_camera_super_buf_t *frame);
     int32_t processJpegEvt(qcamera_jpeg_evt_payload_t *evt);
     int32_t getJpegPaddingReq(cam_padding_info_t &padding_info);
+    void getStageStats(qcamera_pp_stage_stats_t *stats);
+    // thumbnail scaled from main image, latched by init()
+    bool isSwThumbnailEnabled() {return m_bSwThumbnail != FALSE;};
 
 private:
     int32_t sendDataNotify(int32_t msg_type,
@@ -118,6 +187,11 @@ private:
                            qcamera_release_data_t *release_data);
     int32_t sendEvtNotify(int32_t msg_type, int32_t ext1, int32_t ext2);
     qcamera_jpeg_data_t *findJpegJobByJobId(uint32_t jobId);
+    int32_t processJpegEvtImpl(qcamera_jpeg_evt_payload_t *evt);
+    int32_t getFreeJpegOutBuf();
+    void releaseJpegOutBuf(int32_t index, uint32_t gen);
+    void updatePeakPending(qcamera_pp_stage_t stage, QCameraQueue &queue);
+    void abortOngoingJpegJobs();
     mm_jpeg_color_format getColorfmtFromImgFmt(cam_format_t img_fmt);
     mm_jpeg_format_t getJpegImgTypeFromImgFmt(cam_format_t img_fmt);
     int32_t getJpegEncodingConfig(mm_jpeg_encode_params_t& encode_parm,
@@ -125,16 +199,37 @@ private:
                                   QCameraStream *thumb_stream);
     int32_t encodeData(qcamera_jpeg_data_t *jpeg_job_data,
                        uint8_t &needNewSess);
+    int32_t allocSwThumbBufs(mm_jpeg_encode_params_t& encode_parm,
+                             cam_dimension_t &thumb_size);
+    void releaseSwThumbBufs();
+    int32_t makeSwThumbnail(QCameraStream *main_stream,
+                            mm_camera_buf_def_t *main_frame,
+                            int32_t index,
+                            cam_dimension_t &thumb_dim);
     void releaseSuperBuf(mm_camera_super_buf_t *super_buf);
     static void releaseNotifyData(void *user_data, void *cookie);
     void releaseJpegJobData(qcamera_jpeg_data_t *job);
     int32_t processRawImageImpl(mm_camera_super_buf_t *recvd_frame);
+    int32_t processNRFrame(mm_camera_super_buf_t *frame);
+    int32_t reduceNoise(mm_camera_super_buf_t **frames, uint8_t num);
+    mm_camera_buf_def_t *getMainFrame(mm_camera_super_buf_t *frame,
+                                      QCameraStream **stream);
+    void releaseNRFrames();
+    int32_t getRawFrame(mm_camera_super_buf_t *recvd_frame,
+                        mm_camera_buf_def_t *frame,
+                        qcamera_raw_frame_t &raw);
+    int32_t encodeDngData(qcamera_dng_job_t *job);
 
     static void releaseJpegData(void *data, void *user_data);
     static void releasePPInputData(void *data, void *user_data);
     static void releaseOngoingPPData(void *data, void *user_data);
+    static bool matchJpegJobId(void *data, void *user_data, void *match_data);
+    static void releaseDngData(void *data, void *user_data);
 
     static void *dataProcessRoutine(void *data);
+    static void *jpegSubmitRoutine(void *data);
+    static void *jpegNotifyRoutine(void *data);
+    static void *dngEncodeRoutine(void *data);
 
 private:
     QCamera2HardwareInterface *m_parent;
@@ -145,16 +240,54 @@ private:
     uint32_t                   mJpegSessionId;
 
     QCameraStreamMemory *      m_pJpegOutputMem;
-    QCameraExif *              m_pJpegExifObj;
+    QCameraExif *              m_pJpegExifObj;     // exif template of jpeg session
     int8_t                     m_bThumbnailNeeded;
+    uint8_t                    m_bSwThumbnail;     // thumbnail scaled from main image
+    QCameraStreamMemory *      m_pThumbMem;        // sw thumbnails, by jpeg output buf
+    cam_frame_len_offset_t     m_thumbOffset;      // layout of a sw thumbnail buf
     QCameraReprocessChannel *  m_pReprocChannel;
 
     QCameraQueue m_inputPPQ;            // input queue for postproc
+    QCameraQueue m_inputNRQ;            // input queue for noise reduction
     QCameraQueue m_ongoingPPQ;          // ongoing postproc queue
     QCameraQueue m_inputJpegQ;          // input jpeg job queue
     QCameraQueue m_ongoingJpegQ;        // ongoing jpeg job queue
     QCameraQueue m_inputRawQ;           // input raw job queue
-    QCameraCmdThread m_dataProcTh;      // thread for data processing
+    QCameraQueue m_jpegEvtQ;            // jpeg completion event queue
+    QCameraCmdThread m_dataProcTh;      // thread for reprocess submission
+    QCameraCmdThread m_jpegSubmitTh;    // thread for jpeg/raw job submission
+    QCameraCmdThread m_jpegNotifyTh;    // thread for jpeg completion handling
+
+    // raw captures encoded to DNG off the jpeg submit thread; completed
+    // files are sent to upper layer in the order the raw frames arrived
+    uint8_t m_bDngEnabled;              // raw images are delivered as DNG
+    QCameraQueue m_inputDngQ;           // input dng encode job queue
+    QCameraCmdThread m_dngTh[QCAMERA_DNG_WORKERS]; // dng encode threads
+    qcamera_dng_worker_t m_dngWorkers[QCAMERA_DNG_WORKERS];
+    pthread_mutex_t m_dngLock;          // protects dng sequence numbers
+    pthread_cond_t m_dngCond;           // signals a change of m_nDngSeqNotify
+    uint32_t m_nDngSeqNext;             // sequence of the next dequeued job
+    uint32_t m_nDngSeqNotify;           // sequence allowed to notify next
+
+    pthread_mutex_t m_jpegLock;         // protects jpeg output bufs and stats
+    pthread_cond_t m_jpegSubmitCond;    // signals a change of m_nJpegJobsSubmitting
+    uint32_t m_nJpegJobsSubmitting;     // jobs being set up, not in m_ongoingJpegQ yet
+    uint8_t m_bJpegSessionNeeded;       // new jpeg session needed for next job
+    uint32_t m_nJpegJobsInflight;       // max number of jpeg jobs in mm-jpeg
+    uint32_t m_nJpegOutBufCnt;          // number of pooled jpeg output bufs
+    uint8_t m_bJpegOutBufUsed[QCAMERA_JPEG_OUT_BUF_MAX];
+    uint32_t m_nJpegOutBufGen;          // jpeg session generation, bumped on abort
+    uint32_t m_jpegOutBufGen[QCAMERA_JPEG_OUT_BUF_MAX]; // generation each used buf was taken in
+    uint32_t m_nJpegOutBufNext;         // next jpeg output buf to try, for round robin
+    QCameraExif m_jobExif[QCAMERA_JPEG_OUT_BUF_MAX]; // per shot exif, by jpeg output buf
+    qcamera_pp_stage_stats_t m_stageStats[QCAMERA_PP_STAGE_MAX];
+
+    // multi frame noise reduction, only accessed by dataProcessRoutine
+    uint8_t m_nNRFrames;                // frames merged per snapshot, 1 if off
+    uint8_t m_nNRCollected;             // frames of current snapshot received
+    mm_camera_super_buf_t *m_pNRFrames[QCAMERA_MFNR_FRAMES_MAX];
+    void *m_pNRBuf;                     // work memory of noise reduction
+    int m_nNRBufSize;                   // size of m_pNRBuf
 };
 
 }; // namespace qcamera
@@ -261,6 +261,7 @@ int32_t QCameraStream::init(QCameraHeapMemory *streamInfoBuf,
     stream_config.stream_cb = dataNotifyCB;
     stream_config.padding_info = mPaddingInfo;
     stream_config.userdata = this;
+    stream_config.batch_size = mAllocator.getStreamBatchSize(mStreamInfo->stream_type);
     rc = mCamOps->config_stream(mCamHandle,
                 mChannelHandle, mHandle, &stream_config);
     if (rc < 0) {
@@ -411,7 +412,9 @@ void QCameraStream::dataNotifyCB(mm_camera_super_buf_t *recvd_frame,
         (mm_camera_super_buf_t *)malloc(sizeof(mm_camera_super_buf_t));
     if (frame == NULL) {
         ALOGE("%s: No mem for mm_camera_buf_def_t", __func__);
-        stream->bufDone(recvd_frame->bufs[0]->buf_idx);
+        for (int i = 0; i < recvd_frame->num_bufs; i++) {
+            stream->bufDone(recvd_frame->bufs[i]->buf_idx);
+        }
         return;
     }
     *frame = *recvd_frame;
@@ -459,8 +462,10 @@ void *QCameraStream::dataProcRoutine(void *data)
                     if (pme->mDataCB != NULL) {
                         pme->mDataCB(frame, pme, pme->mUserData);
                     } else {
-                        // no data cb routine, return buf here
-                        pme->bufDone(frame->bufs[0]->buf_idx);
+                        // no data cb routine, return bufs here
+                        for (int i = 0; i < frame->num_bufs; i++) {
+                            pme->bufDone(frame->bufs[i]->buf_idx);
+                        }
                         free(frame);
                     }
                 }
@@ -11,7 +11,8 @@ LOCAL_SRC_FILES := \
         QCamera3Channel.cpp \
         QCamera3PostProc.cpp \
         ../util/QCameraCmdThread.cpp \
-        ../util/QCameraQueue.cpp
+        ../util/QCameraQueue.cpp \
+        ../util/QCameraTunables.cpp
 
 LOCAL_CFLAGS := -Wall -Werror
 LOCAL_CFLAGS += -DHAS_MULTIMEDIA_HINTS
@@ -41,6 +41,7 @@
 #include "QCamera3Mem.h"
 #include "QCamera3Channel.h"
 #include "QCamera3PostProc.h"
+#include "QCameraTunables.h"
 
 using namespace android;
 
@@ -52,6 +53,9 @@ namespace qcamera {
 cam_capability_t *gCamCapability[MM_CAMERA_MAX_NUM_SENSORS];
 parm_buffer_t *prevSettings;
 const camera_metadata_t *gStaticMetadata[MM_CAMERA_MAX_NUM_SENSORS];
+/* lens shading map size advertised in static metadata, may be downsampled
+ * from the capability size */
+cam_dimension_t gShadingMapSize[MM_CAMERA_MAX_NUM_SENSORS];
 
 pthread_mutex_t QCamera3HardwareInterface::mCameraSessionLock =
     PTHREAD_MUTEX_INITIALIZER;
@@ -190,7 +194,9 @@ QCamera3HardwareInterface::QCamera3HardwareInterface(int cameraId)
       mSensorFrameDuration(0),
       mEffectMode(0),
       mSceneMode(0),
-      mTonemapMode(0)
+      mTonemapMode(0),
+      mSharpnessMapMode(ANDROID_STATISTICS_SHARPNESS_MAP_MODE_OFF),
+      mLensShadingMapMode(ANDROID_STATISTICS_LENS_SHADING_MAP_MODE_OFF)
 {
     mCameraDevice.common.tag = HARDWARE_DEVICE_TAG;
     mCameraDevice.common.version = CAMERA_DEVICE_API_VERSION_3_2;
@@ -362,6 +368,7 @@ int QCamera3HardwareInterface::openCamera()
         return UNKNOWN_ERROR;
     }
 
+    QCameraTunables::getInstance()->start();
     mCameraOpened = true;
 
     return NO_ERROR;
@@ -386,6 +393,8 @@ int QCamera3HardwareInterface::closeCamera()
     mCameraHandle = NULL;
     mCameraOpened = false;
 
+    QCameraTunables::getInstance()->stop();
+
 #ifdef HAS_MULTIMEDIA_HINTS
     if (rc == NO_ERROR) {
         if (m_pPowerModule) {
@@ -873,7 +882,8 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
         } else {
             result.result = translateCbMetadataToResultMetadata(metadata,
                     current_capture_time, i->request_id, i->ae_trigger,
-                    i->pipeline_depth);
+                    i->pipeline_depth, i->sharpness_map_mode,
+                    i->lens_shading_map_mode);
             if (mIsZslMode) {
                 int found_metadata = 0;
                 //for ZSL case store the metadata buffer and corresp. ZSL handle ptr
@@ -1266,6 +1276,17 @@ int QCamera3HardwareInterface::processCaptureRequest(
     pendingRequest.pipeline_depth = 0;
     pendingRequest.ae_trigger.trigger_id = mPrecaptureId;
     pendingRequest.ae_trigger.trigger = CAM_AEC_TRIGGER_IDLE;
+    // map modes persist across requests that do not carry settings
+    if (meta.exists(ANDROID_STATISTICS_SHARPNESS_MAP_MODE)) {
+        mSharpnessMapMode =
+            meta.find(ANDROID_STATISTICS_SHARPNESS_MAP_MODE).data.u8[0];
+    }
+    if (meta.exists(ANDROID_STATISTICS_LENS_SHADING_MAP_MODE)) {
+        mLensShadingMapMode =
+            meta.find(ANDROID_STATISTICS_LENS_SHADING_MAP_MODE).data.u8[0];
+    }
+    pendingRequest.sharpness_map_mode = mSharpnessMapMode;
+    pendingRequest.lens_shading_map_mode = mLensShadingMapMode;
 
     rc = setFrameParameters(request->frame_number, request->settings,
             streamTypeMask, pendingRequest.ae_trigger);
@@ -1654,6 +1675,10 @@ void QCamera3HardwareInterface::captureResultCb(mm_camera_super_buf_t *metadata_
  *
  * PARAMETERS :
  *   @metadata : metadata information from callback
+ *   @sharpness_map_mode    : requested sharpness map mode, map is only
+ *                            reported when ON
+ *   @lens_shading_map_mode : requested lens shading map mode, map is only
+ *                            reported when ON
  *
  * RETURN     : camera_metadata_t*
  *              metadata in a format specified by fwk
@@ -1662,7 +1687,9 @@ camera_metadata_t*
 QCamera3HardwareInterface::translateCbMetadataToResultMetadata
                                 (metadata_buffer_t *metadata, nsecs_t timestamp,
                                  int32_t request_id, const cam_trigger_t &aeTrigger,
-                                 uint8_t pipeline_depth)
+                                 uint8_t pipeline_depth,
+                                 uint8_t sharpness_map_mode,
+                                 uint8_t lens_shading_map_mode)
 {
     CameraMetadata camMetadata;
     camera_metadata_t* resultMetadata;
@@ -1927,19 +1954,33 @@ QCamera3HardwareInterface::translateCbMetadataToResultMetadata
             sharpnessMapMode, 1);
 
     /*CAM_INTF_META_STATS_SHARPNESS_MAP - check size*/
-    cam_sharpness_map_t  *sharpnessMap = (cam_sharpness_map_t *)
-        POINTER_OF(CAM_INTF_META_STATS_SHARPNESS_MAP, metadata);
-    camMetadata.update(ANDROID_STATISTICS_SHARPNESS_MAP,
-            (int32_t*)sharpnessMap->sharpness,
-            CAM_MAX_MAP_WIDTH*CAM_MAX_MAP_HEIGHT);
-
-    cam_lens_shading_map_t *lensShadingMap = (cam_lens_shading_map_t *)
-        POINTER_OF(CAM_INTF_META_LENS_SHADING_MAP, metadata);
-    int map_height = gCamCapability[mCameraId]->lens_shading_map_size.height;
-    int map_width  = gCamCapability[mCameraId]->lens_shading_map_size.width;
-    camMetadata.update(ANDROID_STATISTICS_LENS_SHADING_MAP,
-                       (float*)lensShadingMap->lens_shading,
-                       4*map_width*map_height);
+    if (sharpness_map_mode == ANDROID_STATISTICS_SHARPNESS_MAP_MODE_ON) {
+        cam_sharpness_map_t  *sharpnessMap = (cam_sharpness_map_t *)
+            POINTER_OF(CAM_INTF_META_STATS_SHARPNESS_MAP, metadata);
+        camMetadata.update(ANDROID_STATISTICS_SHARPNESS_MAP,
+                (int32_t*)sharpnessMap->sharpness,
+                CAM_MAX_MAP_WIDTH*CAM_MAX_MAP_HEIGHT);
+    }
+
+    if (lens_shading_map_mode == ANDROID_STATISTICS_LENS_SHADING_MAP_MODE_ON) {
+        cam_lens_shading_map_t *lensShadingMap = (cam_lens_shading_map_t *)
+            POINTER_OF(CAM_INTF_META_LENS_SHADING_MAP, metadata);
+        const cam_dimension_t &srcSize =
+            gCamCapability[mCameraId]->lens_shading_map_size;
+        const cam_dimension_t &dstSize = gShadingMapSize[mCameraId];
+        if (dstSize.width == srcSize.width && dstSize.height == srcSize.height) {
+            camMetadata.update(ANDROID_STATISTICS_LENS_SHADING_MAP,
+                               (float*)lensShadingMap->lens_shading,
+                               4*srcSize.width*srcSize.height);
+        } else {
+            float shadingMap[4*CAM_MAX_SHADING_MAP_HEIGHT*CAM_MAX_SHADING_MAP_WIDTH];
+            downsampleShadingMap(lensShadingMap->lens_shading, srcSize,
+                                 shadingMap, dstSize);
+            camMetadata.update(ANDROID_STATISTICS_LENS_SHADING_MAP,
+                               shadingMap,
+                               4*dstSize.width*dstSize.height);
+        }
+    }
 
     //cam_color_correct_gains_t *colorCorrectionGains = (cam_color_correct_gains_t*)
     //    POINTER_OF(CAM_INTF_META_COLOR_CORRECT_GAINS, metadata);
@@ -2140,6 +2181,36 @@ void QCamera3HardwareInterface::convertLandmarks(cam_face_detection_info_t face,
     landmarks[5] = face.mouth_center.y;
 }
 
+/*===========================================================================
+ * FUNCTION   : downsampleShadingMap
+ *
+ * DESCRIPTION: decimate a 4 channel lens shading map. Output points are
+ *              taken every (src-1)/(dst-1) input points so the corners of
+ *              the map are kept.
+ *
+ * PARAMETERS :
+ *   @src     : source map, 4 gains per point, row major
+ *   @srcSize : source map size in points
+ *   @dst     : destination map
+ *   @dstSize : destination map size in points
+ *
+ *==========================================================================*/
+void QCamera3HardwareInterface::downsampleShadingMap(const float *src,
+        const cam_dimension_t &srcSize, float *dst, const cam_dimension_t &dstSize)
+{
+    for (int y = 0; y < dstSize.height; y++) {
+        int sy = (dstSize.height > 1) ?
+            y * (srcSize.height - 1) / (dstSize.height - 1) : 0;
+        for (int x = 0; x < dstSize.width; x++) {
+            int sx = (dstSize.width > 1) ?
+                x * (srcSize.width - 1) / (dstSize.width - 1) : 0;
+            memcpy(dst + 4 * (y * dstSize.width + x),
+                   src + 4 * (sy * srcSize.width + sx),
+                   4 * sizeof(float));
+        }
+    }
+}
+
 #define DATA_PTR(MEM_OBJ,INDEX) MEM_OBJ->getPtr( INDEX )
 /*===========================================================================
  * FUNCTION   : initCapabilities
@@ -2365,8 +2436,24 @@ int QCamera3HardwareInterface::initStaticMetadata(int cameraId)
                       (uint8_t*)gCamCapability[cameraId]->optical_stab_modes,
                       gCamCapability[cameraId]->optical_stab_modes_count);
 
-    int32_t lens_shading_map_size[] = {gCamCapability[cameraId]->lens_shading_map_size.width,
-                                       gCamCapability[cameraId]->lens_shading_map_size.height};
+    /* lens shading map is a smooth gain field, apps polling it at preview
+     * rate can get it decimated. The size is fixed here so results always
+     * match the advertised size. */
+    int32_t lscDs = QCameraTunables::getInstance()->get(QCAMERA_TUNABLE_LSC_MAP_DS);
+    if (lscDs < 1) {
+        lscDs = 1;
+    }
+    gShadingMapSize[cameraId] = gCamCapability[cameraId]->lens_shading_map_size;
+    if (gShadingMapSize[cameraId].width > 1) {
+        gShadingMapSize[cameraId].width =
+            (gShadingMapSize[cameraId].width - 1 + lscDs - 1) / lscDs + 1;
+    }
+    if (gShadingMapSize[cameraId].height > 1) {
+        gShadingMapSize[cameraId].height =
+            (gShadingMapSize[cameraId].height - 1 + lscDs - 1) / lscDs + 1;
+    }
+    int32_t lens_shading_map_size[] = {gShadingMapSize[cameraId].width,
+                                       gShadingMapSize[cameraId].height};
     staticInfo.update(ANDROID_LENS_INFO_SHADING_MAP_SIZE,
                       lens_shading_map_size,
                       sizeof(lens_shading_map_size)/sizeof(int32_t));
@@ -4624,10 +4711,8 @@ int QCamera3HardwareInterface::close_camera_device(struct hw_device_t* device)
  *==========================================================================*/
 cam_denoise_process_type_t QCamera3HardwareInterface::getWaveletDenoiseProcessPlate()
 {
-    char prop[PROPERTY_VALUE_MAX];
-    memset(prop, 0, sizeof(prop));
-    property_get("persist.denoise.process.plates", prop, "0");
-    int processPlate = atoi(prop);
+    int processPlate =
+        QCameraTunables::getInstance()->get(QCAMERA_TUNABLE_DENOISE_PLATES);
     switch(processPlate) {
     case 0:
         return CAM_WAVELET_DENOISE_YCBCR_PLANE;
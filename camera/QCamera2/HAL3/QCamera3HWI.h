@@ -107,6 +107,8 @@ public:
                                    uint32_t tag);
     static bool resetIfNeededROI(cam_area_t* roi, const cam_crop_region_t* scalerCropRegion);
     static void convertLandmarks(cam_face_detection_info_t face, int32_t* landmarks);
+    static void downsampleShadingMap(const float *src, const cam_dimension_t &srcSize,
+                                     float *dst, const cam_dimension_t &dstSize);
     static void postproc_channel_cb_routine(mm_camera_super_buf_t *recvd_frame,
                                             void *userdata);
     static int32_t getScalarFormat(int32_t format);
@@ -130,7 +132,9 @@ public:
     camera_metadata_t* translateCbMetadataToResultMetadata(metadata_buffer_t *metadata,
                             nsecs_t timestamp, int32_t request_id,
                             const cam_trigger_t &aeTrigger,
-                            uint8_t pipeline_depth);
+                            uint8_t pipeline_depth,
+                            uint8_t sharpness_map_mode,
+                            uint8_t lens_shading_map_mode);
     int getJpegSettings(const camera_metadata_t *settings);
     int initParameters();
     void deinitParameters();
@@ -212,6 +216,9 @@ private:
         int input_buffer_present;
         cam_trigger_t ae_trigger;
         uint8_t pipeline_depth;
+        // statistics maps are only reported when requested
+        uint8_t sharpness_map_mode;
+        uint8_t lens_shading_map_mode;
     } PendingRequestInfo;
     /*Data structure to store metadata information*/
     typedef struct {
@@ -273,6 +280,8 @@ private:
     uint8_t mNoiseReductionMode;
     uint8_t mSceneMode;
     uint8_t mTonemapMode;
+    uint8_t mSharpnessMapMode;
+    uint8_t mLensShadingMapMode;
 
     static const QCameraMap EFFECT_MODES_MAP[];
     static const QCameraMap WHITE_BALANCE_MODES_MAP[];
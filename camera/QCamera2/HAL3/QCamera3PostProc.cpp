@@ -1203,7 +1203,8 @@ void *QCamera3PostProcessor::dataProcessRoutine(void *data)
  * RETURN     : None
  *==========================================================================*/
 QCamera3Exif::QCamera3Exif()
-    : m_nNumEntries(0)
+    : m_nNumEntries(0),
+      m_nArenaUsed(0)
 {
     memset(m_Entries, 0, sizeof(m_Entries));
 }
@@ -1211,7 +1212,8 @@ QCamera3Exif::QCamera3Exif()
 /*===========================================================================
  * FUNCTION   : ~QCamera3Exif
  *
- * DESCRIPTION: deconstructor of QCamera3Exif. Will release internal memory ptr.
+ * DESCRIPTION: deconstructor of QCamera3Exif. Entry payloads live in the
+ *              internal arena, so there is nothing to release.
  *
  * PARAMETERS : None
  *
@@ -1219,89 +1221,49 @@ QCamera3Exif::QCamera3Exif()
  *==========================================================================*/
 QCamera3Exif::~QCamera3Exif()
 {
-    for (uint32_t i = 0; i < m_nNumEntries; i++) {
-        switch (m_Entries[i].tag_entry.type) {
-            case EXIF_BYTE:
-                {
-                    if (m_Entries[i].tag_entry.count > 1 &&
-                            m_Entries[i].tag_entry.data._bytes != NULL) {
-                        free(m_Entries[i].tag_entry.data._bytes);
-                        m_Entries[i].tag_entry.data._bytes = NULL;
-                    }
-                }
-                break;
-            case EXIF_ASCII:
-                {
-                    if (m_Entries[i].tag_entry.data._ascii != NULL) {
-                        free(m_Entries[i].tag_entry.data._ascii);
-                        m_Entries[i].tag_entry.data._ascii = NULL;
-                    }
-                }
-                break;
-            case EXIF_SHORT:
-                {
-                    if (m_Entries[i].tag_entry.count > 1 &&
-                            m_Entries[i].tag_entry.data._shorts != NULL) {
-                        free(m_Entries[i].tag_entry.data._shorts);
-                        m_Entries[i].tag_entry.data._shorts = NULL;
-                    }
-                }
-                break;
-            case EXIF_LONG:
-                {
-                    if (m_Entries[i].tag_entry.count > 1 &&
-                            m_Entries[i].tag_entry.data._longs != NULL) {
-                        free(m_Entries[i].tag_entry.data._longs);
-                        m_Entries[i].tag_entry.data._longs = NULL;
-                    }
-                }
-                break;
-            case EXIF_RATIONAL:
-                {
-                    if (m_Entries[i].tag_entry.count > 1 &&
-                            m_Entries[i].tag_entry.data._rats != NULL) {
-                        free(m_Entries[i].tag_entry.data._rats);
-                        m_Entries[i].tag_entry.data._rats = NULL;
-                    }
-                }
-                break;
-            case EXIF_UNDEFINED:
-                {
-                    if (m_Entries[i].tag_entry.data._undefined != NULL) {
-                        free(m_Entries[i].tag_entry.data._undefined);
-                        m_Entries[i].tag_entry.data._undefined = NULL;
-                    }
-                }
-                break;
-            case EXIF_SLONG:
-                {
-                    if (m_Entries[i].tag_entry.count > 1 &&
-                            m_Entries[i].tag_entry.data._slongs != NULL) {
-                        free(m_Entries[i].tag_entry.data._slongs);
-                        m_Entries[i].tag_entry.data._slongs = NULL;
-                    }
-                }
-                break;
-            case EXIF_SRATIONAL:
-                {
-                    if (m_Entries[i].tag_entry.count > 1 &&
-                            m_Entries[i].tag_entry.data._srats != NULL) {
-                        free(m_Entries[i].tag_entry.data._srats);
-                        m_Entries[i].tag_entry.data._srats = NULL;
-                    }
-                }
-                break;
-            default:
-                ALOGE("%s: Error, Unknown type",__func__);
-                break;
-        }
+}
+
+/*===========================================================================
+ * FUNCTION   : getPayloadSize
+ *
+ * DESCRIPTION: get number of arena bytes needed by an entry. Single values
+ *              other than strings are kept inside the entry itself.
+ *
+ * PARAMETERS :
+ *   @type    : data type
+ *   @count   : number of data in uint of its type
+ *
+ * RETURN     : payload size in bytes, 0 if payload is kept in the entry
+ *==========================================================================*/
+uint32_t QCamera3Exif::getPayloadSize(exif_tag_type_t type, uint32_t count)
+{
+    switch (type) {
+    case EXIF_ASCII:
+        return count + 1;
+    case EXIF_UNDEFINED:
+        return count;
+    case EXIF_BYTE:
+        return (count > 1) ? count : 0;
+    case EXIF_SHORT:
+        return (count > 1) ? count * sizeof(uint16_t) : 0;
+    case EXIF_LONG:
+        return (count > 1) ? count * sizeof(uint32_t) : 0;
+    case EXIF_RATIONAL:
+        return (count > 1) ? count * sizeof(rat_t) : 0;
+    case EXIF_SLONG:
+        return (count > 1) ? count * sizeof(int32_t) : 0;
+    case EXIF_SRATIONAL:
+        return (count > 1) ? count * sizeof(srat_t) : 0;
+    default:
+        return 0;
     }
 }
 
 /*===========================================================================
  * FUNCTION   : addEntry
  *
- * DESCRIPTION: function to add an entry to exif data
+ * DESCRIPTION: function to add an entry to exif data. Array and string
+ *              payloads are copied into the internal arena.
  *
  * PARAMETERS :
  *   @tagid   : exif tag ID
@@ -1318,156 +1280,89 @@ int32_t QCamera3Exif::addEntry(exif_tag_id_t tagid,
                               uint32_t count,
                               void *data)
 {
-    int32_t rc = NO_ERROR;
     if(m_nNumEntries >= MAX_EXIF_TABLE_ENTRIES) {
         ALOGE("%s: Number of entries exceeded limit", __func__);
         return NO_MEMORY;
     }
 
+    uint32_t size = getPayloadSize(type, count);
+    // keep payloads 8 byte aligned for rational arrays
+    uint32_t reserve = (size + 7) & ~7U;
+    if (reserve > sizeof(m_Arena) - m_nArenaUsed) {
+        ALOGE("%s: No space in exif arena for tag 0x%x", __func__, tagid);
+        return NO_MEMORY;
+    }
+    uint8_t *payload = (uint8_t *)m_Arena + m_nArenaUsed;
+
+    exif_tag_entry_t &entry = m_Entries[m_nNumEntries].tag_entry;
     m_Entries[m_nNumEntries].tag_id = tagid;
-    m_Entries[m_nNumEntries].tag_entry.type = type;
-    m_Entries[m_nNumEntries].tag_entry.count = count;
-    m_Entries[m_nNumEntries].tag_entry.copy = 1;
+    entry.type = type;
+    entry.count = count;
+    entry.copy = 1;
     switch (type) {
-        case EXIF_BYTE:
-            {
-                if (count > 1) {
-                    uint8_t *values = (uint8_t *)malloc(count);
-                    if (values == NULL) {
-                        ALOGE("%s: No memory for byte array", __func__);
-                        rc = NO_MEMORY;
-                    } else {
-                        memcpy(values, data, count);
-                        m_Entries[m_nNumEntries].tag_entry.data._bytes = values;
-                    }
-                } else {
-                    m_Entries[m_nNumEntries].tag_entry.data._byte =
-                        *(uint8_t *)data;
-                }
-            }
-            break;
-        case EXIF_ASCII:
-            {
-                char *str = NULL;
-                str = (char *)malloc(count + 1);
-                if (str == NULL) {
-                    ALOGE("%s: No memory for ascii string", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memset(str, 0, count + 1);
-                    memcpy(str, data, count);
-                    m_Entries[m_nNumEntries].tag_entry.data._ascii = str;
-                }
-            }
-            break;
-        case EXIF_SHORT:
-            {
-                if (count > 1) {
-                    uint16_t *values =
-                        (uint16_t *)malloc(count * sizeof(uint16_t));
-                    if (values == NULL) {
-                        ALOGE("%s: No memory for short array", __func__);
-                        rc = NO_MEMORY;
-                    } else {
-                        memcpy(values, data, count * sizeof(uint16_t));
-                        m_Entries[m_nNumEntries].tag_entry.data._shorts =values;
-                    }
-                } else {
-                    m_Entries[m_nNumEntries].tag_entry.data._short =
-                        *(uint16_t *)data;
-                }
-            }
-            break;
-        case EXIF_LONG:
-            {
-                if (count > 1) {
-                    uint32_t *values =
-                        (uint32_t *)malloc(count * sizeof(uint32_t));
-                    if (values == NULL) {
-                        ALOGE("%s: No memory for long array", __func__);
-                        rc = NO_MEMORY;
-                    } else {
-                        memcpy(values, data, count * sizeof(uint32_t));
-                        m_Entries[m_nNumEntries].tag_entry.data._longs = values;
-                    }
-                } else {
-                    m_Entries[m_nNumEntries].tag_entry.data._long =
-                        *(uint32_t *)data;
-                }
-            }
-            break;
-        case EXIF_RATIONAL:
-            {
-                if (count > 1) {
-                    rat_t *values = (rat_t *)malloc(count * sizeof(rat_t));
-                    if (values == NULL) {
-                        ALOGE("%s: No memory for rational array", __func__);
-                        rc = NO_MEMORY;
-                    } else {
-                        memcpy(values, data, count * sizeof(rat_t));
-                        m_Entries[m_nNumEntries].tag_entry.data._rats = values;
-                    }
-                } else {
-                    m_Entries[m_nNumEntries].tag_entry.data._rat =
-                        *(rat_t *)data;
-                }
-            }
-            break;
-        case EXIF_UNDEFINED:
-            {
-                uint8_t *values = (uint8_t *)malloc(count);
-                if (values == NULL) {
-                    ALOGE("%s: No memory for undefined array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count);
-                    m_Entries[m_nNumEntries].tag_entry.data._undefined = values;
-                }
-            }
-            break;
-        case EXIF_SLONG:
-            {
-                if (count > 1) {
-                    int32_t *values =
-                        (int32_t *)malloc(count * sizeof(int32_t));
-                    if (values == NULL) {
-                        ALOGE("%s: No memory for signed long array", __func__);
-                        rc = NO_MEMORY;
-                    } else {
-                        memcpy(values, data, count * sizeof(int32_t));
-                        m_Entries[m_nNumEntries].tag_entry.data._slongs =values;
-                    }
-                } else {
-                    m_Entries[m_nNumEntries].tag_entry.data._slong =
-                        *(int32_t *)data;
-                }
-            }
-            break;
-        case EXIF_SRATIONAL:
-            {
-                if (count > 1) {
-                    srat_t *values = (srat_t *)malloc(count * sizeof(srat_t));
-                    if (values == NULL) {
-                        ALOGE("%s: No memory for sign rational array",__func__);
-                        rc = NO_MEMORY;
-                    } else {
-                        memcpy(values, data, count * sizeof(srat_t));
-                        m_Entries[m_nNumEntries].tag_entry.data._srats = values;
-                    }
-                } else {
-                    m_Entries[m_nNumEntries].tag_entry.data._srat =
-                        *(srat_t *)data;
-                }
-            }
-            break;
-        default:
-            ALOGE("%s: Error, Unknown type",__func__);
-            break;
+    case EXIF_BYTE:
+        if (count > 1) {
+            memcpy(payload, data, size);
+            entry.data._bytes = payload;
+        } else {
+            entry.data._byte = *(uint8_t *)data;
+        }
+        break;
+    case EXIF_ASCII:
+        memcpy(payload, data, count);
+        payload[count] = 0;
+        entry.data._ascii = (char *)payload;
+        break;
+    case EXIF_SHORT:
+        if (count > 1) {
+            memcpy(payload, data, size);
+            entry.data._shorts = (uint16_t *)payload;
+        } else {
+            entry.data._short = *(uint16_t *)data;
+        }
+        break;
+    case EXIF_LONG:
+        if (count > 1) {
+            memcpy(payload, data, size);
+            entry.data._longs = (uint32_t *)payload;
+        } else {
+            entry.data._long = *(uint32_t *)data;
+        }
+        break;
+    case EXIF_RATIONAL:
+        if (count > 1) {
+            memcpy(payload, data, size);
+            entry.data._rats = (rat_t *)payload;
+        } else {
+            entry.data._rat = *(rat_t *)data;
+        }
+        break;
+    case EXIF_UNDEFINED:
+        memcpy(payload, data, size);
+        entry.data._undefined = payload;
+        break;
+    case EXIF_SLONG:
+        if (count > 1) {
+            memcpy(payload, data, size);
+            entry.data._slongs = (int32_t *)payload;
+        } else {
+            entry.data._slong = *(int32_t *)data;
+        }
+        break;
+    case EXIF_SRATIONAL:
+        if (count > 1) {
+            memcpy(payload, data, size);
+            entry.data._srats = (srat_t *)payload;
+        } else {
+            entry.data._srat = *(srat_t *)data;
+        }
+        break;
     }
 
     // Increase number of entries
+    m_nArenaUsed += reserve;
     m_nNumEntries++;
-    return rc;
+    return NO_ERROR;
 }
 
 }; // namespace qcamera
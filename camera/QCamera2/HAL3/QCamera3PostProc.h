@@ -72,6 +72,8 @@ typedef struct {
 } qcamera_jpeg_evt_payload_t;
 
 #define MAX_EXIF_TABLE_ENTRIES 24
+// bytes of payload storage shared by all exif entries of one object
+#define QCAMERA3_EXIF_ARENA_SIZE 1024
 class QCamera3Exif
 {
 public:
@@ -86,8 +88,12 @@ public:
     QEXIF_INFO_DATA *getEntries() {return m_Entries;};
 
 private:
+    static uint32_t getPayloadSize(exif_tag_type_t type, uint32_t count);
+
     QEXIF_INFO_DATA m_Entries[MAX_EXIF_TABLE_ENTRIES];  // exif tags for JPEG encoder
     uint32_t  m_nNumEntries;                            // number of valid entries
+    uint32_t  m_nArenaUsed;                             // arena bytes handed out
+    uint64_t  m_Arena[QCAMERA3_EXIF_ARENA_SIZE / sizeof(uint64_t)]; // payload storage
 };
 
 class QCamera3PostProcessor
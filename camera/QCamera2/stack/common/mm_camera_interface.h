@@ -39,6 +39,12 @@
 #define MM_CAMERA_MAX_NUM_FRAMES CAM_MAX_NUM_BUFS_PER_STREAM
 /* num of channels allowed in a camera obj */
 #define MM_CAMERA_CHANNEL_MAX 16
+/* max num of frames of one stream delivered in a single data cb */
+#define MM_CAMERA_MAX_BATCH_SIZE 5
+/* max num of bufs in a super buf, bundled streams or a stream batch */
+#define MM_CAMERA_SUPER_BUF_MAX \
+    ((MAX_STREAM_NUM_IN_BUNDLE > MM_CAMERA_MAX_BATCH_SIZE) ? \
+     MAX_STREAM_NUM_IN_BUNDLE : MM_CAMERA_MAX_BATCH_SIZE)
 
 #define PAD_TO_SIZE(size, padding) ((size + padding - 1) & ~(padding - 1))
 
@@ -83,14 +89,15 @@ typedef struct {
 *    @ch_id : channel handler to uniquely ideentify a channel
 *           object
 *    @num_bufs : number of buffers in the super buf, should not
-*              exceeds MAX_STREAM_NUM_IN_BUNDLE
+*              exceeds MAX_STREAM_NUM_IN_BUNDLE, or the batch size
+*              for a batch of frames from a single stream
 *    @bufs : array of buffers in the bundle
 **/
 typedef struct {
     uint32_t camera_handle;
     uint32_t ch_id;
     uint8_t num_bufs;
-    mm_camera_buf_def_t* bufs[MAX_STREAM_NUM_IN_BUNDLE];
+    mm_camera_buf_def_t* bufs[MM_CAMERA_SUPER_BUF_MAX];
 } mm_camera_super_buf_t;
 
 /** mm_camera_event_t: structure for event
@@ -194,6 +201,10 @@ typedef struct {
 *              allocating/deallocating stream buffers
 *    @stream_cb : callback handling stream frame notify
 *    @userdata : user data pointer
+*    @batch_size : frames per stream_cb call, up to
+*              MM_CAMERA_MAX_BATCH_SIZE. 0 or 1 delivers every
+*              frame on its own. Batching is only done for streams
+*              that are not bundled.
 **/
 typedef struct {
     cam_stream_info_t *stream_info;
@@ -201,6 +212,7 @@ typedef struct {
     mm_camera_stream_mem_vtbl_t mem_vtbl;
     mm_camera_buf_notify_t stream_cb;
     void *userdata;
+    uint8_t batch_size;
 } mm_camera_stream_config_t;
 
 /** mm_camera_super_buf_notify_mode_t: enum for super uffer
@@ -106,6 +106,9 @@ typedef struct {
 
   int8_t encode_thumbnail;
 
+  /* encode with the software encoder even if the hardware one is available */
+  int8_t use_sw_encoder;
+
   /* src img bufs */
   mm_jpeg_buf_t src_main_buf[MM_JPEG_MAX_BUF];
 
@@ -149,6 +152,11 @@ typedef struct {
   /*Metadata stream*/
   cam_metadata_info_t *p_metadata;
 
+  /* per job exif entries, replacing the session ones when
+   * numOfEntries is non zero. Caller keeps the memory valid
+   * until the job is done */
+  QOMX_EXIF_INFO exif_info;
+
 } mm_jpeg_encode_job_t;
 
 typedef enum {
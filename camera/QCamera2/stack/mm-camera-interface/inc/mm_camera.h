@@ -228,6 +228,16 @@ typedef struct mm_stream {
     mm_camera_map_unmap_ops_tbl_t map_ops;
 
     int8_t queued_buffer_count;
+
+    /* batched delivery, for high frame rate video. Frames are collected
+     * and sent to the data cb batch_size at a time, bufs released by
+     * upper layer are queued back to kernel in groups of the same size.
+     * Protected by buf_lock. */
+    uint8_t batch_size; /* frames per data cb, 0 or 1 if not batched */
+    uint8_t batch_num; /* frames collected for the next data cb */
+    mm_camera_buf_def_t *batch_bufs[MM_CAMERA_MAX_BATCH_SIZE];
+    uint8_t ret_num; /* released bufs not yet queued to kernel */
+    mm_camera_buf_def_t *ret_bufs[MM_CAMERA_MAX_BATCH_SIZE];
 } mm_stream_t;
 
 /* mm_channel */
@@ -71,6 +71,10 @@ int32_t mm_stream_config(mm_stream_t *my_obj,
 int32_t mm_stream_reg_buf(mm_stream_t * my_obj);
 int32_t mm_stream_buf_done(mm_stream_t * my_obj,
                            mm_camera_buf_def_t *frame);
+int32_t mm_stream_buf_done_locked(mm_stream_t * my_obj,
+                                  mm_camera_buf_def_t *frame);
+void mm_stream_send_batch(mm_stream_t *my_obj);
+void mm_stream_flush_ret_bufs(mm_stream_t *my_obj);
 int32_t mm_stream_calc_offset(mm_stream_t *my_obj);
 int32_t mm_stream_calc_offset_preview(cam_format_t fmt,
                                       cam_dimension_t *dim,
@@ -196,6 +200,8 @@ static void mm_stream_data_notify(void* user_data)
     mm_stream_t *my_obj = (mm_stream_t*)user_data;
     int32_t idx = -1, i, rc;
     uint8_t has_cb = 0;
+    uint8_t batched = 0;
+    int8_t queued = 0;
     mm_camera_buf_info_t buf_info;
 
     if (NULL == my_obj) {
@@ -212,13 +218,6 @@ static void mm_stream_data_notify(void* user_data)
         return;
     }
 
-    memset(&buf_info, 0, sizeof(mm_camera_buf_info_t));
-    rc = mm_stream_read_msm_frame(my_obj, &buf_info, my_obj->frame_offset.num_planes);
-    if (rc != 0) {
-        return;
-    }
-    idx = buf_info.buf->buf_idx;
-
     pthread_mutex_lock(&my_obj->cb_lock);
     for (i = 0; i < MM_CAMERA_STREAM_BUF_CB_MAX; i++) {
         if(NULL != my_obj->buf_cb[i].cb) {
@@ -229,19 +228,90 @@ static void mm_stream_data_notify(void* user_data)
     }
     pthread_mutex_unlock(&my_obj->cb_lock);
 
-    pthread_mutex_lock(&my_obj->buf_lock);
-    /* update buffer location */
-    my_obj->buf_status[idx].in_kernel = 0;
+    /* a batched stream takes every frame that is ready in one wakeup,
+     * others take one frame per wakeup */
+    do {
+        memset(&buf_info, 0, sizeof(mm_camera_buf_info_t));
+        rc = mm_stream_read_msm_frame(my_obj, &buf_info,
+                                      my_obj->frame_offset.num_planes);
+        if (rc != 0) {
+            return;
+        }
+        idx = buf_info.buf->buf_idx;
 
-    /* update buf ref count */
-    if (my_obj->is_bundled) {
-        /* need to add into super buf since bundled, add ref count */
-        my_obj->buf_status[idx].buf_refcnt++;
+        pthread_mutex_lock(&my_obj->buf_lock);
+        /* update buffer location */
+        my_obj->buf_status[idx].in_kernel = 0;
+
+        /* update buf ref count */
+        if (my_obj->is_bundled) {
+            /* need to add into super buf since bundled, add ref count */
+            my_obj->buf_status[idx].buf_refcnt++;
+        }
+        my_obj->buf_status[idx].buf_refcnt += has_cb;
+
+        batched = (my_obj->batch_size > 1 && has_cb && !my_obj->is_bundled);
+        queued = my_obj->queued_buffer_count;
+        if (batched) {
+            my_obj->batch_bufs[my_obj->batch_num++] = buf_info.buf;
+            /* send early when kernel is about to run out of bufs, upper
+             * layer may be holding the rest */
+            if (my_obj->batch_num >= my_obj->batch_size || queued <= 1) {
+                mm_stream_send_batch(my_obj);
+            }
+        }
+        pthread_mutex_unlock(&my_obj->buf_lock);
+
+        if (!batched) {
+            mm_stream_handle_rcvd_buf(my_obj, &buf_info, has_cb);
+        }
+    } while (batched && queued > 0);
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_stream_send_batch
+ *
+ * DESCRIPTION: send the collected frames of a batched stream to its cmd
+ *              thread as one super buf. Caller holds buf_lock.
+ *
+ * PARAMETERS :
+ *   @my_obj  : stream object
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void mm_stream_send_batch(mm_stream_t *my_obj)
+{
+    mm_camera_cmdcb_t* node = NULL;
+    uint8_t i;
+
+    if (0 == my_obj->batch_num) {
+        return;
     }
-    my_obj->buf_status[idx].buf_refcnt += has_cb;
-    pthread_mutex_unlock(&my_obj->buf_lock);
 
-    mm_stream_handle_rcvd_buf(my_obj, &buf_info, has_cb);
+    node = (mm_camera_cmdcb_t *)malloc(sizeof(mm_camera_cmdcb_t));
+    if (NULL != node) {
+        memset(node, 0, sizeof(mm_camera_cmdcb_t));
+        node->cmd_type = MM_CAMERA_CMD_TYPE_SUPER_BUF_DATA_CB;
+        node->u.superbuf.camera_handle = my_obj->ch_obj->cam_obj->my_hdl;
+        node->u.superbuf.ch_id = my_obj->ch_obj->my_hdl;
+        node->u.superbuf.num_bufs = my_obj->batch_num;
+        for (i = 0; i < my_obj->batch_num; i++) {
+            node->u.superbuf.bufs[i] = my_obj->batch_bufs[i];
+        }
+
+        /* enqueue to cmd thread */
+        cam_queue_enq(&(my_obj->cmd_thread.cmd_queue), node);
+
+        /* wake up cmd thread */
+        cam_sem_post(&(my_obj->cmd_thread.cmd_sem));
+    } else {
+        CDBG_ERROR("%s: No memory for mm_camera_node_t", __func__);
+        /* drop the ref taken for the data cb */
+        for (i = 0; i < my_obj->batch_num; i++) {
+            mm_stream_buf_done_locked(my_obj, my_obj->batch_bufs[i]);
+        }
+    }
+    my_obj->batch_num = 0;
 }
 
 /*===========================================================================
@@ -258,7 +328,7 @@ static void mm_stream_data_notify(void* user_data)
 static void mm_stream_dispatch_app_data(mm_camera_cmdcb_t *cmd_cb,
                                         void* user_data)
 {
-    int i;
+    int i, j;
     mm_stream_t * my_obj = (mm_stream_t *)user_data;
     mm_camera_buf_info_t* buf_info = NULL;
     mm_camera_super_buf_t super_buf;
@@ -270,19 +340,22 @@ static void mm_stream_dispatch_app_data(mm_camera_cmdcb_t *cmd_cb,
     CDBG("%s: E, my_handle = 0x%x, fd = %d, state = %d",
          __func__, my_obj->my_hdl, my_obj->fd, my_obj->state);
 
-    if (MM_CAMERA_CMD_TYPE_DATA_CB != cmd_cb->cmd_type) {
+    if (MM_CAMERA_CMD_TYPE_DATA_CB == cmd_cb->cmd_type) {
+        buf_info = &cmd_cb->u.buf;
+        memset(&super_buf, 0, sizeof(mm_camera_super_buf_t));
+        super_buf.num_bufs = 1;
+        super_buf.bufs[0] = buf_info->buf;
+        super_buf.camera_handle = my_obj->ch_obj->cam_obj->my_hdl;
+        super_buf.ch_id = my_obj->ch_obj->my_hdl;
+    } else if (MM_CAMERA_CMD_TYPE_SUPER_BUF_DATA_CB == cmd_cb->cmd_type) {
+        /* batch of frames of this stream */
+        super_buf = cmd_cb->u.superbuf;
+    } else {
         CDBG_ERROR("%s: Wrong cmd_type (%d) for dataCB",
                    __func__, cmd_cb->cmd_type);
         return;
     }
 
-    buf_info = &cmd_cb->u.buf;
-    memset(&super_buf, 0, sizeof(mm_camera_super_buf_t));
-    super_buf.num_bufs = 1;
-    super_buf.bufs[0] = buf_info->buf;
-    super_buf.camera_handle = my_obj->ch_obj->cam_obj->my_hdl;
-    super_buf.ch_id = my_obj->ch_obj->my_hdl;
-
     pthread_mutex_lock(&my_obj->cb_lock);
     for(i = 0; i < MM_CAMERA_STREAM_BUF_CB_MAX; i++) {
         if(NULL != my_obj->buf_cb[i].cb) {
@@ -293,7 +366,9 @@ static void mm_stream_dispatch_app_data(mm_camera_cmdcb_t *cmd_cb,
 
                 /* increase buf ref cnt */
                 pthread_mutex_lock(&my_obj->buf_lock);
-                my_obj->buf_status[buf_info->buf->buf_idx].buf_refcnt++;
+                for (j = 0; j < super_buf.num_bufs; j++) {
+                    my_obj->buf_status[super_buf.bufs[j]->buf_idx].buf_refcnt++;
+                }
                 pthread_mutex_unlock(&my_obj->buf_lock);
 
                 /* callback */
@@ -315,7 +390,11 @@ static void mm_stream_dispatch_app_data(mm_camera_cmdcb_t *cmd_cb,
     pthread_mutex_unlock(&my_obj->cb_lock);
 
     /* do buf_done since we increased refcnt by one when has_cb */
-    mm_stream_buf_done(my_obj, buf_info->buf);
+    pthread_mutex_lock(&my_obj->buf_lock);
+    for (j = 0; j < super_buf.num_bufs; j++) {
+        mm_stream_buf_done_locked(my_obj, super_buf.bufs[j]);
+    }
+    pthread_mutex_unlock(&my_obj->buf_lock);
 }
 
 /*===========================================================================
@@ -752,6 +831,14 @@ int32_t mm_stream_fsm_active(mm_stream_t * my_obj,
             uint8_t i;
             rc = mm_stream_streamoff(my_obj);
 
+            /* hand collected frames to the cmd thread before it is
+             * released. Released bufs left unqueued are queued again
+             * when bufs are registered next time. */
+            pthread_mutex_lock(&my_obj->buf_lock);
+            mm_stream_send_batch(my_obj);
+            my_obj->ret_num = 0;
+            pthread_mutex_unlock(&my_obj->buf_lock);
+
             pthread_mutex_lock(&my_obj->cb_lock);
             for (i = 0; i < MM_CAMERA_STREAM_BUF_CB_MAX; i++) {
                 if(NULL != my_obj->buf_cb[i].cb) {
@@ -819,6 +906,10 @@ int32_t mm_stream_config(mm_stream_t *my_obj,
     my_obj->buf_cb[0].cb = config->stream_cb;
     my_obj->buf_cb[0].user_data = config->userdata;
     my_obj->buf_cb[0].cb_count = -1; /* infinite by default */
+    my_obj->batch_size = config->batch_size;
+    if (my_obj->batch_size > MM_CAMERA_MAX_BATCH_SIZE) {
+        my_obj->batch_size = MM_CAMERA_MAX_BATCH_SIZE;
+    }
 
     rc = mm_stream_sync_info(my_obj);
     if (rc == 0) {
@@ -966,8 +1057,13 @@ int32_t mm_stream_read_msm_frame(mm_stream_t * my_obj,
 
     rc = ioctl(my_obj->fd, VIDIOC_DQBUF, &vb);
     if (rc < 0) {
-        CDBG_ERROR("%s: VIDIOC_DQBUF ioctl call failed (rc=%d)\n",
-                   __func__, rc);
+        if (EAGAIN == errno) {
+            /* no more frames ready, expected when draining a batch */
+            CDBG("%s: VIDIOC_DQBUF no frame ready\n", __func__);
+        } else {
+            CDBG_ERROR("%s: VIDIOC_DQBUF ioctl call failed (rc=%d)\n",
+                       __func__, rc);
+        }
     } else {
         pthread_mutex_lock(&my_obj->buf_lock);
         my_obj->queued_buffer_count--;
@@ -1530,6 +1626,8 @@ int32_t mm_stream_reg_buf(mm_stream_t * my_obj)
 
     pthread_mutex_lock(&my_obj->buf_lock);
     my_obj->queued_buffer_count = 0;
+    my_obj->batch_num = 0;
+    my_obj->ret_num = 0;
     for(i = 0; i < my_obj->buf_num; i++){
         /* check if need to qbuf initially */
         if (my_obj->buf_status[i].initial_reg_flag) {
@@ -1797,6 +1895,25 @@ int32_t mm_stream_calc_offset_preview(cam_format_t fmt,
                         buf_planes->plane_info.mp[1].len,
                         CAM_PAD_TO_4K);
         break;
+    case CAM_FORMAT_YUV_RAW_8BIT_YUYV:
+    case CAM_FORMAT_YUV_RAW_8BIT_YVYU:
+    case CAM_FORMAT_YUV_RAW_8BIT_UYVY:
+    case CAM_FORMAT_YUV_RAW_8BIT_VYUY:
+        /* 1 plane, 2 bytes per pixel, stride in pixels */
+        buf_planes->plane_info.num_planes = 1;
+
+        stride = PAD_TO_SIZE(dim->width, CAM_PAD_TO_16);
+        scanline = dim->height;
+        buf_planes->plane_info.mp[0].offset = 0;
+        buf_planes->plane_info.mp[0].len = stride * scanline * 2;
+        buf_planes->plane_info.mp[0].offset_x = 0;
+        buf_planes->plane_info.mp[0].offset_y = 0;
+        buf_planes->plane_info.mp[0].stride = stride;
+        buf_planes->plane_info.mp[0].scanline = scanline;
+
+        buf_planes->plane_info.frame_len =
+            PAD_TO_SIZE(buf_planes->plane_info.mp[0].len, CAM_PAD_TO_4K);
+        break;
     default:
         CDBG_ERROR("%s: Invalid cam_format for preview %d",
                    __func__, fmt);
@@ -2517,6 +2634,32 @@ int32_t mm_stream_buf_done(mm_stream_t * my_obj,
          __func__, my_obj->my_hdl, my_obj->fd, my_obj->state);
 
     pthread_mutex_lock(&my_obj->buf_lock);
+    rc = mm_stream_buf_done_locked(my_obj, frame);
+    pthread_mutex_unlock(&my_obj->buf_lock);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_stream_buf_done_locked
+ *
+ * DESCRIPTION: drop a reference of a buffer and enqueue it back to kernel
+ *              once unused. A batched stream keeps released buffers until
+ *              a batch worth is collected, or kernel runs low on buffers.
+ *              Caller holds buf_lock.
+ *
+ * PARAMETERS :
+ *   @my_obj       : stream object
+ *   @frame        : frame to be enqueued back to kernel
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+int32_t mm_stream_buf_done_locked(mm_stream_t * my_obj,
+                                  mm_camera_buf_def_t *frame)
+{
+    int32_t rc = 0;
+
     if(my_obj->buf_status[frame->buf_idx].buf_refcnt == 0) {
         CDBG("%s: Error Trying to free second time?(idx=%d) count=%d\n",
                    __func__, frame->buf_idx,
@@ -2526,6 +2669,15 @@ int32_t mm_stream_buf_done(mm_stream_t * my_obj,
         my_obj->buf_status[frame->buf_idx].buf_refcnt--;
         if (0 == my_obj->buf_status[frame->buf_idx].buf_refcnt) {
             CDBG("<DEBUG> : Buf done for buffer:%d, stream:%d", frame->buf_idx, frame->stream_type);
+            if (my_obj->batch_size > 1 && !my_obj->is_bundled &&
+                MM_STREAM_STATE_ACTIVE == my_obj->state) {
+                my_obj->ret_bufs[my_obj->ret_num++] = frame;
+                if (my_obj->ret_num >= my_obj->batch_size ||
+                    my_obj->queued_buffer_count < my_obj->batch_size) {
+                    mm_stream_flush_ret_bufs(my_obj);
+                }
+                return rc;
+            }
             rc = mm_stream_qbuf(my_obj, frame);
             if(rc < 0) {
                 CDBG_ERROR("%s: mm_camera_stream_qbuf(idx=%d) errno=%d, %s\n",
@@ -2540,10 +2692,38 @@ int32_t mm_stream_buf_done(mm_stream_t * my_obj,
                  my_obj, frame->buf_idx);
         }
     }
-    pthread_mutex_unlock(&my_obj->buf_lock);
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : mm_stream_flush_ret_bufs
+ *
+ * DESCRIPTION: enqueue the released buffers of a batched stream back to
+ *              kernel. Caller holds buf_lock.
+ *
+ * PARAMETERS :
+ *   @my_obj       : stream object
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void mm_stream_flush_ret_bufs(mm_stream_t *my_obj)
+{
+    uint8_t i;
+    int32_t rc;
+
+    for (i = 0; i < my_obj->ret_num; i++) {
+        mm_camera_buf_def_t *frame = my_obj->ret_bufs[i];
+        rc = mm_stream_qbuf(my_obj, frame);
+        if(rc < 0) {
+            CDBG_ERROR("%s: mm_camera_stream_qbuf(idx=%d) errno=%d, %s\n",
+                       __func__, frame->buf_idx, errno, strerror(errno));
+        } else {
+            my_obj->buf_status[frame->buf_idx].in_kernel = 1;
+        }
+    }
+    my_obj->ret_num = 0;
+}
+
 /*===========================================================================
  * FUNCTION   : mm_stream_reg_buf_cb
  *
@@ -696,6 +696,9 @@ mm_camera_stream_t * mm_app_add_stream(mm_camera_test_obj_t *test_obj,
         return NULL;
     }
 
+    /* test app streams are delivered one frame per callback */
+    stream->s_config.batch_size = 0;
+
     return stream;
 }
 
@@ -431,6 +431,7 @@ OMX_ERRORTYPE mm_jpeg_session_change_state(mm_jpeg_job_session_t* p_session,
  *
  *  Arguments:
  *    @p_session: job session
+ *    @p_params: encode params of the session
  *
  *  Return:
  *       OMX error types
@@ -439,7 +440,8 @@ OMX_ERRORTYPE mm_jpeg_session_change_state(mm_jpeg_job_session_t* p_session,
  *       Create a jpeg encode session
  *
  **/
-OMX_ERRORTYPE mm_jpeg_session_create(mm_jpeg_job_session_t* p_session)
+OMX_ERRORTYPE mm_jpeg_session_create(mm_jpeg_job_session_t* p_session,
+  mm_jpeg_encode_params_t *p_params)
 {
   OMX_ERRORTYPE rc = OMX_ErrorNone;
 
@@ -457,10 +459,23 @@ OMX_ERRORTYPE mm_jpeg_session_create(mm_jpeg_job_session_t* p_session)
   p_session->omx_callbacks.EmptyBufferDone = mm_jpeg_ebd;
   p_session->omx_callbacks.FillBufferDone = mm_jpeg_fbd;
   p_session->omx_callbacks.EventHandler = mm_jpeg_event_handler;
-  rc = OMX_GetHandle(&p_session->omx_handle,
-    "OMX.qcom.image.jpeg.encoder",
-    (void *)p_session,
-    &p_session->omx_callbacks);
+
+  rc = OMX_ErrorComponentNotFound;
+  if (!p_params->use_sw_encoder) {
+    rc = OMX_GetHandle(&p_session->omx_handle,
+      "OMX.qcom.image.jpeg.encoder",
+      (void *)p_session,
+      &p_session->omx_callbacks);
+  }
+
+  /* hardware encoder is missing or out of instances, encode in software */
+  if (OMX_ErrorNone != rc) {
+    CDBG_HIGH("%s:%d] Using software encoder (%d)", __func__, __LINE__, rc);
+    rc = OMX_GetHandle(&p_session->omx_handle,
+      "OMX.qcom.image.jpeg.encoder.sw",
+      (void *)p_session,
+      &p_session->omx_callbacks);
+  }
 
   if (OMX_ErrorNone != rc) {
     CDBG_ERROR("%s:%d] OMX_GetHandle failed (%d)", __func__, __LINE__, rc);
@@ -508,10 +523,6 @@ void mm_jpeg_session_destroy(mm_jpeg_job_session_t* p_session)
   }
   p_session->omx_handle = NULL;
 
-  rc = releaseExifEntry(&p_session->params.exif_info);
-  if (rc) {
-    CDBG_ERROR("%s:%d] Exif release failed (%d)", __func__, __LINE__, rc);
-  }
   pthread_mutex_destroy(&p_session->lock);
   pthread_cond_destroy(&p_session->cond);
   CDBG("%s:%d] X", __func__, __LINE__);
@@ -1042,7 +1053,7 @@ OMX_ERRORTYPE mm_jpeg_session_config_main(mm_jpeg_job_session_t *p_session)
   return rc;
 }
 
-/** mm_jpeg_session_config_common:
+/** mm_jpeg_session_config_exif:
  *
  *  Arguments:
  *    @p_session: job session
@@ -1051,42 +1062,38 @@ OMX_ERRORTYPE mm_jpeg_session_config_main(mm_jpeg_job_session_t *p_session)
  *       OMX error values
  *
  *  Description:
- *       Configure common parameters
+ *       Set the exif tags of the current job, falling back to
+ *       the session ones if the job does not carry any
  *
  **/
-OMX_ERRORTYPE mm_jpeg_session_config_common(mm_jpeg_job_session_t *p_session)
+OMX_ERRORTYPE mm_jpeg_session_config_exif(mm_jpeg_job_session_t *p_session)
 {
   OMX_ERRORTYPE rc = OMX_ErrorNone;
   OMX_INDEXTYPE exif_idx;
-  OMX_CONFIG_ROTATIONTYPE rotate;
-  mm_jpeg_encode_params_t *p_params = &p_session->params;
-  mm_jpeg_encode_job_t *p_jobparams = &p_session->encode_job;
+  QOMX_EXIF_INFO *p_src = &p_session->encode_job.exif_info;
   QOMX_EXIF_INFO exif_info;
 
-  /* set rotation */
-  memset(&rotate, 0, sizeof(rotate));
-  rotate.nPortIndex = 1;
-  rotate.nRotation = p_jobparams->rotation;
-  rc = OMX_SetConfig(p_session->omx_handle, OMX_IndexConfigCommonRotate,
-    &rotate);
-  if (OMX_ErrorNone != rc) {
-      CDBG_ERROR("%s:%d] Error %d", __func__, __LINE__, rc);
-      return rc;
+  if (0 == p_src->numOfEntries) {
+    p_src = &p_session->params.exif_info;
+  }
+
+  if (p_src->numOfEntries > MAX_EXIF_TABLE_ENTRIES) {
+    CDBG_ERROR("%s:%d] Too many exif entries %d", __func__, __LINE__,
+      (int)p_src->numOfEntries);
+    return OMX_ErrorBadParameter;
   }
-  CDBG("%s:%d] Set rotation to %d at port_idx = %d", __func__, __LINE__,
-    (int)p_jobparams->rotation, (int)rotate.nPortIndex);
 
   /* Set Exif data*/
   memset(&p_session->exif_info_all[0],  0,  sizeof(p_session->exif_info_all));
 
-  exif_info.numOfEntries = p_params->exif_info.numOfEntries;
+  exif_info.numOfEntries = p_src->numOfEntries;
   exif_info.exif_data = &p_session->exif_info_all[0];
   /*If Exif data has been passed copy it*/
-  if (p_params->exif_info.numOfEntries > 0) {
+  if (p_src->numOfEntries > 0) {
     CDBG("%s:%d] Num of exif entries passed from HAL: %d", __func__, __LINE__,
-      p_params->exif_info.numOfEntries);
-    memcpy(exif_info.exif_data, p_params->exif_info.exif_data,
-      sizeof(QEXIF_INFO_DATA) * p_params->exif_info.numOfEntries);
+      p_src->numOfEntries);
+    memcpy(exif_info.exif_data, p_src->exif_data,
+      sizeof(QEXIF_INFO_DATA) * p_src->numOfEntries);
   }
 
   if (exif_info.numOfEntries > 0) {
@@ -1111,6 +1118,41 @@ OMX_ERRORTYPE mm_jpeg_session_config_common(mm_jpeg_job_session_t *p_session)
   return rc;
 }
 
+/** mm_jpeg_session_config_common:
+ *
+ *  Arguments:
+ *    @p_session: job session
+ *
+ *  Return:
+ *       OMX error values
+ *
+ *  Description:
+ *       Configure common parameters
+ *
+ **/
+OMX_ERRORTYPE mm_jpeg_session_config_common(mm_jpeg_job_session_t *p_session)
+{
+  OMX_ERRORTYPE rc = OMX_ErrorNone;
+  OMX_CONFIG_ROTATIONTYPE rotate;
+  mm_jpeg_encode_job_t *p_jobparams = &p_session->encode_job;
+
+  /* set rotation */
+  memset(&rotate, 0, sizeof(rotate));
+  rotate.nPortIndex = 1;
+  rotate.nRotation = p_jobparams->rotation;
+  rc = OMX_SetConfig(p_session->omx_handle, OMX_IndexConfigCommonRotate,
+    &rotate);
+  if (OMX_ErrorNone != rc) {
+      CDBG_ERROR("%s:%d] Error %d", __func__, __LINE__, rc);
+      return rc;
+  }
+  CDBG("%s:%d] Set rotation to %d at port_idx = %d", __func__, __LINE__,
+    (int)p_jobparams->rotation, (int)rotate.nPortIndex);
+
+  rc = mm_jpeg_session_config_exif(p_session);
+  return rc;
+}
+
 /** mm_jpeg_session_abort:
  *
  *  Arguments:
@@ -1375,6 +1417,13 @@ static OMX_ERRORTYPE mm_jpeg_session_encode(mm_jpeg_job_session_t *p_session)
       goto error;
     }
     p_session->config = OMX_TRUE;
+  } else if (p_jobparams->exif_info.numOfEntries > 0) {
+    /* session is reused, refresh the per shot exif tags */
+    ret = mm_jpeg_session_config_exif(p_session);
+    if (ret) {
+      CDBG_ERROR("%s:%d] Error", __func__, __LINE__);
+      goto error;
+    }
   }
 
   pthread_mutex_lock(&p_session->lock);
@@ -1927,7 +1976,7 @@ int32_t mm_jpeg_create_session(mm_jpeg_obj *my_obj,
     return -1;
   }
 
-  ret = mm_jpeg_session_create(p_session);
+  ret = mm_jpeg_session_create(p_session, p_params);
   if (OMX_ErrorNone != ret) {
     p_session->active = OMX_FALSE;
     CDBG_ERROR("%s:%d] jpeg session create failed", __func__, __LINE__);
@@ -33,4 +33,27 @@ LOCAL_SHARED_LIBRARIES := liblog libcutils libdl libmmjpeg_interface
 
 include $(BUILD_EXECUTABLE)
 
+# jpeg interface benchmark, memfd/heap buffers, no ION needed
+include $(CLEAR_VARS)
+LOCAL_PATH := $(MM_JPEG_TEST_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := -Werror -Wno-unused-parameter
+LOCAL_CFLAGS += -D_ANDROID_
+LOCAL_CFLAGS += -include mm_jpeg_dbg.h
+
+LOCAL_C_INCLUDES := $(MM_JPEG_TEST_PATH)
+LOCAL_C_INCLUDES += $(MM_JPEG_TEST_PATH)/../inc
+LOCAL_C_INCLUDES += $(MM_JPEG_TEST_PATH)/../../common
+LOCAL_C_INCLUDES += $(OMX_HEADER_DIR)
+LOCAL_C_INCLUDES += $(OMX_CORE_DIR)/qexif
+LOCAL_C_INCLUDES += $(OMX_CORE_DIR)/qomx_core
+
+LOCAL_SRC_FILES := mm_jpeg_bench.c
+
+LOCAL_MODULE           := mm-jpeg-interface-bench
+LOCAL_SHARED_LIBRARIES := liblog libcutils libdl libmmjpeg_interface
+
+include $(BUILD_EXECUTABLE)
+
 LOCAL_PATH := $(OLD_LOCAL_PATH)
@@ -0,0 +1,635 @@
+/* Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Throughput benchmark of the jpeg interface. For every combination of
+ * resolution, quality, thumbnail and number of concurrent sessions it
+ * opens a client, creates the sessions and has one thread per session
+ * submit jobs back to back. Buffers come from memfd or the heap so no
+ * ION device is needed. One CSV row is printed per combination. */
+
+#include "mm_jpeg_interface.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define BENCH_MAX_SESSIONS 8
+#define BENCH_MAX_VALUES 16
+#define BENCH_THUMB_WIDTH 512
+#define BENCH_THUMB_HEIGHT 384
+
+typedef enum {
+  BENCH_MEM_MEMFD,
+  BENCH_MEM_MALLOC,
+} bench_mem_type_t;
+
+typedef struct {
+  uint8_t *addr;
+  size_t size;
+  int fd;
+} bench_buf_t;
+
+typedef struct {
+  int width;
+  int height;
+  int quality;
+  int thumbnail;
+  int sessions;
+} bench_config_t;
+
+typedef struct {
+  pthread_t tid;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  mm_jpeg_ops_t *ops;
+  mm_jpeg_encode_params_t params;
+  mm_jpeg_job_t job;
+  bench_buf_t input;
+  bench_buf_t output;
+  int done;
+  jpeg_job_status_t status;
+  uint32_t filled_len;
+  int warmup;
+  int jobs;
+  double *latency_ms;   /* jobs entries */
+  double first_ms;      /* start of the first measured job */
+  double last_ms;       /* completion of the last measured job */
+  int errors;
+  uint64_t bytes;
+} bench_session_t;
+
+static bench_mem_type_t g_mem_type = BENCH_MEM_MEMFD;
+
+/** bench_now_ms:
+ *
+ *  Return:
+ *       monotonic time in milliseconds
+ **/
+static double bench_now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/** bench_buf_alloc:
+ *
+ *  Arguments:
+ *    @p_buf: buffer to allocate
+ *    @size: buffer size
+ *
+ *  Return:
+ *       0 or -1 on failure
+ *
+ *  Description:
+ *       allocates a buffer backed by a memfd so it has an fd like the
+ *       camera buffers, or by the heap with fd -1
+ **/
+static int bench_buf_alloc(bench_buf_t *p_buf, size_t size)
+{
+  p_buf->size = size;
+  p_buf->fd = -1;
+#ifdef __NR_memfd_create
+  if (g_mem_type == BENCH_MEM_MEMFD) {
+    int fd = syscall(__NR_memfd_create, "mm-jpeg-bench", 0);
+    if (fd >= 0 && ftruncate(fd, size) == 0) {
+      void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (addr != MAP_FAILED) {
+        p_buf->addr = (uint8_t *)addr;
+        p_buf->fd = fd;
+        return 0;
+      }
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    CDBG_ERROR("%s:%d] memfd failed, using heap", __func__, __LINE__);
+  }
+#endif
+  p_buf->addr = (uint8_t *)malloc(size);
+  return (p_buf->addr == NULL) ? -1 : 0;
+}
+
+/** bench_buf_free:
+ *
+ *  Arguments:
+ *    @p_buf: buffer to free
+ **/
+static void bench_buf_free(bench_buf_t *p_buf)
+{
+  if (p_buf->addr == NULL) {
+    return;
+  }
+  if (p_buf->fd >= 0) {
+    munmap(p_buf->addr, p_buf->size);
+    close(p_buf->fd);
+  } else {
+    free(p_buf->addr);
+  }
+  memset(p_buf, 0x0, sizeof(bench_buf_t));
+}
+
+/** bench_fill_nv21:
+ *
+ *  Arguments:
+ *    @addr: frame
+ *    @width: frame width
+ *    @height: frame height
+ *
+ *  Description:
+ *       fills a frame with gradients and noise, so the encoder sees
+ *       content of a realistic entropy rather than a flat frame
+ **/
+static void bench_fill_nv21(uint8_t *addr, int width, int height)
+{
+  uint32_t seed = 0x12345678;
+  int x, y;
+
+  for (y = 0; y < height; y++) {
+    uint8_t *row = addr + (size_t)y * width;
+    for (x = 0; x < width; x++) {
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      row[x] = (uint8_t)(((x * 255 / width + y * 255 / height) >> 1) +
+        (seed & 0x1F));
+    }
+  }
+  for (y = 0; y < height / 2; y++) {
+    uint8_t *row = addr + (size_t)width * height + (size_t)y * width;
+    for (x = 0; x < width; x += 2) {
+      row[x] = (uint8_t)(96 + x * 64 / width);
+      row[x + 1] = (uint8_t)(160 - y * 128 / height);
+    }
+  }
+}
+
+/** bench_encode_callback:
+ *
+ *  Description:
+ *       jpeg completion, wakes up the session thread
+ **/
+static void bench_encode_callback(jpeg_job_status_t status,
+  uint32_t client_hdl,
+  uint32_t jobId,
+  mm_jpeg_output_t *p_output,
+  void *userData)
+{
+  bench_session_t *p_sess = (bench_session_t *)userData;
+
+  pthread_mutex_lock(&p_sess->lock);
+  p_sess->status = status;
+  p_sess->filled_len = (p_output != NULL) ? p_output->buf_filled_len : 0;
+  p_sess->done = 1;
+  pthread_cond_signal(&p_sess->cond);
+  pthread_mutex_unlock(&p_sess->lock);
+}
+
+/** bench_session_init:
+ *
+ *  Arguments:
+ *    @p_sess: session
+ *    @p_cfg: benchmark configuration
+ *
+ *  Return:
+ *       0 or -1 on failure
+ *
+ *  Description:
+ *       allocates the buffers and fills the session and job parameters
+ **/
+static int bench_session_init(bench_session_t *p_sess, bench_config_t *p_cfg)
+{
+  int size = p_cfg->width * p_cfg->height;
+  mm_jpeg_encode_params_t *p_params = &p_sess->params;
+  mm_jpeg_encode_job_t *p_job_params = &p_sess->job.encode_job;
+
+  pthread_mutex_init(&p_sess->lock, NULL);
+  pthread_cond_init(&p_sess->cond, NULL);
+
+  if (bench_buf_alloc(&p_sess->input, size * 3 / 2) ||
+    bench_buf_alloc(&p_sess->output, size * 3 / 2)) {
+    CDBG_ERROR("%s:%d] Error",__func__, __LINE__);
+    return -1;
+  }
+  bench_fill_nv21(p_sess->input.addr, p_cfg->width, p_cfg->height);
+
+  p_params->jpeg_cb = bench_encode_callback;
+  p_params->userdata = p_sess;
+  p_params->color_format = MM_JPEG_COLOR_FORMAT_YCRCBLP_H2V2;
+
+  p_params->dest_buf[0].buf_size = p_sess->output.size;
+  p_params->dest_buf[0].buf_vaddr = p_sess->output.addr;
+  p_params->dest_buf[0].fd = p_sess->output.fd;
+  p_params->dest_buf[0].index = 0;
+  p_params->num_dst_bufs = 1;
+
+  p_params->src_main_buf[0].buf_size = p_sess->input.size;
+  p_params->src_main_buf[0].buf_vaddr = p_sess->input.addr;
+  p_params->src_main_buf[0].fd = p_sess->input.fd;
+  p_params->src_main_buf[0].index = 0;
+  p_params->src_main_buf[0].format = MM_JPEG_FMT_YUV;
+  p_params->src_main_buf[0].offset.num_planes = 2;
+  p_params->src_main_buf[0].offset.mp[0].len = size;
+  p_params->src_main_buf[0].offset.mp[0].stride = p_cfg->width;
+  p_params->src_main_buf[0].offset.mp[0].scanline = p_cfg->height;
+  p_params->src_main_buf[0].offset.mp[1].len = size >> 1;
+  p_params->src_main_buf[0].offset.mp[1].stride = p_cfg->width;
+  p_params->src_main_buf[0].offset.mp[1].scanline = p_cfg->height >> 1;
+  p_params->src_main_buf[0].offset.frame_len = size * 3 / 2;
+  p_params->num_src_bufs = 1;
+
+  /* thumbnail is scaled from the main image, as the HAL does */
+  p_params->encode_thumbnail = p_cfg->thumbnail;
+  if (p_cfg->thumbnail) {
+    p_params->src_thumb_buf[0] = p_params->src_main_buf[0];
+    p_params->num_tmb_bufs = 1;
+  }
+  p_params->exif_info.numOfEntries = 0;
+  p_params->quality = p_cfg->quality;
+
+  p_sess->job.job_type = JPEG_JOB_TYPE_ENCODE;
+  p_job_params->dst_index = 0;
+  p_job_params->src_index = 0;
+  p_job_params->thumb_index = 0;
+  p_job_params->rotation = 0;
+
+  p_job_params->main_dim.src_dim.width = p_cfg->width;
+  p_job_params->main_dim.src_dim.height = p_cfg->height;
+  p_job_params->main_dim.dst_dim.width = p_cfg->width;
+  p_job_params->main_dim.dst_dim.height = p_cfg->height;
+  p_job_params->main_dim.crop.width = p_cfg->width;
+  p_job_params->main_dim.crop.height = p_cfg->height;
+
+  p_job_params->thumb_dim.src_dim.width = p_cfg->width;
+  p_job_params->thumb_dim.src_dim.height = p_cfg->height;
+  p_job_params->thumb_dim.dst_dim.width = BENCH_THUMB_WIDTH;
+  p_job_params->thumb_dim.dst_dim.height = BENCH_THUMB_HEIGHT;
+  p_job_params->thumb_dim.crop.width = p_cfg->width;
+  p_job_params->thumb_dim.crop.height = p_cfg->height;
+  return 0;
+}
+
+/** bench_session_deinit:
+ *
+ *  Arguments:
+ *    @p_sess: session
+ **/
+static void bench_session_deinit(bench_session_t *p_sess)
+{
+  bench_buf_free(&p_sess->input);
+  bench_buf_free(&p_sess->output);
+  pthread_mutex_destroy(&p_sess->lock);
+  pthread_cond_destroy(&p_sess->cond);
+}
+
+/** bench_session_thread:
+ *
+ *  Description:
+ *       submits the jobs of one session one after the other and records
+ *       the latency from start_job to the completion callback
+ **/
+static void *bench_session_thread(void *data)
+{
+  bench_session_t *p_sess = (bench_session_t *)data;
+  uint32_t job_id = 0;
+  int i;
+
+  for (i = -p_sess->warmup; i < p_sess->jobs; i++) {
+    double start;
+    int rc;
+
+    pthread_mutex_lock(&p_sess->lock);
+    p_sess->done = 0;
+    pthread_mutex_unlock(&p_sess->lock);
+
+    start = bench_now_ms();
+    rc = p_sess->ops->start_job(&p_sess->job, &job_id);
+    if (rc) {
+      CDBG_ERROR("%s:%d] start_job failed %d", __func__, __LINE__, rc);
+      p_sess->errors++;
+      continue;
+    }
+
+    pthread_mutex_lock(&p_sess->lock);
+    while (!p_sess->done) {
+      pthread_cond_wait(&p_sess->cond, &p_sess->lock);
+    }
+    pthread_mutex_unlock(&p_sess->lock);
+
+    if (i < 0) {
+      continue;
+    }
+    if (i == 0) {
+      p_sess->first_ms = start;
+    }
+    p_sess->last_ms = bench_now_ms();
+    p_sess->latency_ms[i] = p_sess->last_ms - start;
+    if (p_sess->status == JPEG_JOB_STATUS_ERROR) {
+      p_sess->errors++;
+    } else {
+      p_sess->bytes += p_sess->filled_len;
+    }
+  }
+  return NULL;
+}
+
+static int bench_cmp_double(const void *a, const void *b)
+{
+  double da = *(const double *)a;
+  double db = *(const double *)b;
+  return (da > db) - (da < db);
+}
+
+/** bench_percentile:
+ *
+ *  Arguments:
+ *    @sorted: sorted samples
+ *    @count: number of samples
+ *    @pct: percentile
+ *
+ *  Return:
+ *       nearest rank percentile
+ **/
+static double bench_percentile(double *sorted, int count, int pct)
+{
+  int rank = (count * pct + 99) / 100;
+  if (count == 0) {
+    return 0;
+  }
+  if (rank < 1) {
+    rank = 1;
+  }
+  return sorted[rank - 1];
+}
+
+/** bench_run:
+ *
+ *  Arguments:
+ *    @p_cfg: benchmark configuration
+ *    @jobs: measured jobs per session
+ *    @warmup: unmeasured jobs per session
+ *    @out: CSV output
+ *
+ *  Return:
+ *       0 or -1 on failure
+ **/
+static int bench_run(bench_config_t *p_cfg, int jobs, int warmup, FILE *out)
+{
+  bench_session_t sess[BENCH_MAX_SESSIONS];
+  mm_jpeg_ops_t ops;
+  uint32_t handle;
+  double *latency = NULL;
+  double first = 0, last = 0;
+  int total = p_cfg->sessions * jobs;
+  int errors = 0;
+  uint64_t bytes = 0;
+  int created = 0;
+  int rc = 0;
+  int i;
+
+  memset(sess, 0x0, sizeof(sess));
+  memset(&ops, 0x0, sizeof(ops));
+  latency = (double *)calloc(total, sizeof(double));
+  if (latency == NULL) {
+    return -1;
+  }
+
+  handle = jpeg_open(&ops);
+  if (handle == 0) {
+    CDBG_ERROR("%s:%d] jpeg_open failed", __func__, __LINE__);
+    free(latency);
+    return -1;
+  }
+
+  for (created = 0; created < p_cfg->sessions; created++) {
+    bench_session_t *p_sess = &sess[created];
+    if (bench_session_init(p_sess, p_cfg)) {
+      bench_session_deinit(p_sess);
+      rc = -1;
+      break;
+    }
+    rc = ops.create_session(handle, &p_sess->params,
+      &p_sess->job.encode_job.session_id);
+    if (rc || p_sess->job.encode_job.session_id == 0) {
+      CDBG_ERROR("%s:%d] create_session failed", __func__, __LINE__);
+      bench_session_deinit(p_sess);
+      rc = -1;
+      break;
+    }
+    p_sess->ops = &ops;
+    p_sess->jobs = jobs;
+    p_sess->warmup = warmup;
+    p_sess->latency_ms = latency + created * jobs;
+  }
+
+  if (rc == 0) {
+    for (i = 0; i < created; i++) {
+      pthread_create(&sess[i].tid, NULL, bench_session_thread, &sess[i]);
+    }
+    for (i = 0; i < created; i++) {
+      pthread_join(sess[i].tid, NULL);
+      errors += sess[i].errors;
+      bytes += sess[i].bytes;
+      if (i == 0 || sess[i].first_ms < first) {
+        first = sess[i].first_ms;
+      }
+      if (sess[i].last_ms > last) {
+        last = sess[i].last_ms;
+      }
+    }
+
+    qsort(latency, total, sizeof(double), bench_cmp_double);
+    fprintf(out, "%d,%d,%d,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.2f,%llu\n",
+      p_cfg->width, p_cfg->height, p_cfg->quality, p_cfg->thumbnail,
+      p_cfg->sessions, total, errors,
+      bench_percentile(latency, total, 50),
+      bench_percentile(latency, total, 90),
+      bench_percentile(latency, total, 99),
+      latency[total - 1],
+      (last > first) ? total * 1000.0 / (last - first) : 0,
+      (total > errors) ? (unsigned long long)(bytes / (total - errors)) : 0ULL);
+    fflush(out);
+  }
+
+  for (i = 0; i < created; i++) {
+    ops.destroy_session(sess[i].job.encode_job.session_id);
+    bench_session_deinit(&sess[i]);
+  }
+  ops.close(handle);
+  free(latency);
+  return (rc || errors) ? -1 : 0;
+}
+
+/** bench_parse_list:
+ *
+ *  Arguments:
+ *    @str: comma separated list, entries are "n" or "WxH"
+ *    @a: first values
+ *    @b: second values of "WxH" entries, can be NULL
+ *    @min: smallest valid value
+ *
+ *  Return:
+ *       number of entries, -1 on a malformed list
+ **/
+static int bench_parse_list(const char *str, int *a, int *b, int min)
+{
+  int count = 0;
+  char *end;
+
+  while (*str != '\0' && count < BENCH_MAX_VALUES) {
+    a[count] = strtol(str, &end, 10);
+    if (end == str || a[count] < min) {
+      return -1;
+    }
+    str = end;
+    if (b != NULL) {
+      if (*str != 'x') {
+        return -1;
+      }
+      str++;
+      b[count] = strtol(str, &end, 10);
+      if (end == str || b[count] < min) {
+        return -1;
+      }
+      str = end;
+    }
+    count++;
+    if (*str == ',') {
+      str++;
+    } else if (*str != '\0') {
+      return -1;
+    }
+  }
+  return count;
+}
+
+static void bench_usage(const char *name)
+{
+  fprintf(stderr,
+    "usage: %s [-r WxH,..] [-q quality,..] [-t 0|1,..] [-s sessions,..]\n"
+    "       [-n jobs] [-w warmup jobs] [-m memfd|malloc] [-o csv file]\n",
+    name);
+}
+
+/** main:
+ *
+ *  Arguments:
+ *    @argc
+ *    @argv
+ *
+ *  Return:
+ *       0, or 1 if any job failed
+ *
+ *  Description:
+ *       runs the sweep and prints one CSV row per configuration
+ **/
+int main(int argc, char* argv[])
+{
+  int widths[BENCH_MAX_VALUES] = {640, 1920, 4160};
+  int heights[BENCH_MAX_VALUES] = {480, 1080, 3120};
+  int qualities[BENCH_MAX_VALUES] = {80, 95};
+  int thumbs[BENCH_MAX_VALUES] = {0, 1};
+  int sessions[BENCH_MAX_VALUES] = {1, 2};
+  int num_res = 3, num_q = 2, num_t = 2, num_s = 2;
+  int jobs = 10;
+  int warmup = 1;
+  FILE *out = stdout;
+  int failed = 0;
+  int r, q, t, s, c;
+
+  while ((c = getopt(argc, argv, "r:q:t:s:n:w:m:o:")) != -1) {
+    switch (c) {
+    case 'r': num_res = bench_parse_list(optarg, widths, heights, 16); break;
+    case 'q': num_q = bench_parse_list(optarg, qualities, NULL, 1); break;
+    case 't': num_t = bench_parse_list(optarg, thumbs, NULL, 0); break;
+    case 's': num_s = bench_parse_list(optarg, sessions, NULL, 1); break;
+    case 'n': jobs = atoi(optarg); break;
+    case 'w': warmup = atoi(optarg); break;
+    case 'm':
+      if (!strcmp(optarg, "memfd")) {
+        g_mem_type = BENCH_MEM_MEMFD;
+      } else if (!strcmp(optarg, "malloc")) {
+        g_mem_type = BENCH_MEM_MALLOC;
+      } else {
+        bench_usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'o':
+      out = fopen(optarg, "w");
+      if (out == NULL) {
+        CDBG_ERROR("%s:%d] cannot open %s", __func__, __LINE__, optarg);
+        return 1;
+      }
+      break;
+    default:
+      bench_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (num_res <= 0 || num_q <= 0 || num_t <= 0 || num_s <= 0 ||
+    jobs <= 0 || warmup < 0) {
+    bench_usage(argv[0]);
+    return 1;
+  }
+  for (s = 0; s < num_s; s++) {
+    if (sessions[s] > BENCH_MAX_SESSIONS) {
+      sessions[s] = BENCH_MAX_SESSIONS;
+    }
+  }
+
+  fprintf(out, "width,height,quality,thumbnail,sessions,jobs,errors,"
+    "p50_ms,p90_ms,p99_ms,max_ms,images_per_s,avg_bytes\n");
+  for (r = 0; r < num_res; r++) {
+    for (q = 0; q < num_q; q++) {
+      for (t = 0; t < num_t; t++) {
+        for (s = 0; s < num_s; s++) {
+          bench_config_t cfg;
+          cfg.width = widths[r];
+          cfg.height = heights[r];
+          cfg.quality = qualities[q];
+          cfg.thumbnail = thumbs[t];
+          cfg.sessions = sessions[s];
+          if (bench_run(&cfg, jobs, warmup, out)) {
+            failed = 1;
+          }
+        }
+      }
+    }
+  }
+
+  if (out != stdout) {
+    fclose(out);
+  }
+  return failed;
+}
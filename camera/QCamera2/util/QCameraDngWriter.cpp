@@ -0,0 +1,716 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <utils/Errors.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "QCameraDngWriter.h"
+
+using namespace android;
+
+namespace qcamera {
+
+// header, IFD and out of line tag values; the image follows 16 byte aligned
+#define QCAMERA_DNG_HEADER_MAX   2048
+#define QCAMERA_DNG_ENTRIES_MAX  40
+// bytes of unpacked rows handed to each write() by writeToFd
+#define QCAMERA_DNG_WRITE_CHUNK  (64 * 1024)
+
+enum {
+    TIFF_BYTE      = 1,
+    TIFF_ASCII     = 2,
+    TIFF_SHORT     = 3,
+    TIFF_LONG      = 4,
+    TIFF_RATIONAL  = 5,
+    TIFF_SRATIONAL = 10,
+};
+
+enum {
+    TAG_NEW_SUBFILE_TYPE         = 254,
+    TAG_IMAGE_WIDTH              = 256,
+    TAG_IMAGE_LENGTH             = 257,
+    TAG_BITS_PER_SAMPLE          = 258,
+    TAG_COMPRESSION              = 259,
+    TAG_PHOTOMETRIC              = 262,
+    TAG_MAKE                     = 271,
+    TAG_MODEL                    = 272,
+    TAG_STRIP_OFFSETS            = 273,
+    TAG_ORIENTATION              = 274,
+    TAG_SAMPLES_PER_PIXEL        = 277,
+    TAG_ROWS_PER_STRIP           = 278,
+    TAG_STRIP_BYTE_COUNTS        = 279,
+    TAG_PLANAR_CONFIG            = 284,
+    TAG_SOFTWARE                 = 305,
+    TAG_DATETIME                 = 306,
+    TAG_CFA_REPEAT_PATTERN_DIM   = 33421,
+    TAG_CFA_PATTERN              = 33422,
+    TAG_EXPOSURE_TIME            = 33434,
+    TAG_FNUMBER                  = 33437,
+    TAG_ISO_SPEED_RATINGS        = 34855,
+    TAG_FOCAL_LENGTH             = 37386,
+    TAG_DNG_VERSION              = 50706,
+    TAG_DNG_BACKWARD_VERSION     = 50707,
+    TAG_UNIQUE_CAMERA_MODEL      = 50708,
+    TAG_BLACK_LEVEL_REPEAT_DIM   = 50713,
+    TAG_BLACK_LEVEL              = 50714,
+    TAG_WHITE_LEVEL              = 50717,
+    TAG_COLOR_MATRIX1            = 50721,
+    TAG_AS_SHOT_NEUTRAL          = 50728,
+    TAG_CALIBRATION_ILLUMINANT1  = 50778,
+};
+
+#define PHOTOMETRIC_CFA     32803
+#define ILLUMINANT_D65      21
+
+// XYZ (D65) to linear sRGB, used as ColorMatrix1 when the caller has no
+// sensor calibration; close enough for the tuned pipelines of phone sensors
+static const float g_defaultColorMatrix[9] = {
+     3.2406f, -1.5372f, -0.4986f,
+    -0.9689f,  1.8758f,  0.0415f,
+     0.0557f, -0.2040f,  1.0570f,
+};
+
+// CFA colors (0 red, 1 green, 2 blue) of the top left 2x2 block
+static const uint8_t g_cfaPattern[QCAMERA_RAW_CFA_MAX][4] = {
+    { 0, 1, 1, 2 }, // RGGB
+    { 1, 0, 2, 1 }, // GRBG
+    { 1, 2, 0, 1 }, // GBRG
+    { 2, 1, 1, 0 }, // BGGR
+};
+
+static inline void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+// Collects the entries of one IFD. Tags are added in ascending order as
+// TIFF requires; values over 4 bytes go to a side area that is placed
+// right after the IFD when serialized.
+class QCameraDngIfd {
+public:
+    QCameraDngIfd() : mCount(0), mValLen(0), mError(false) {}
+
+    int32_t addBytes(uint16_t tag, uint16_t type, uint32_t count,
+                     const uint8_t *data, uint32_t len);
+    int32_t addByte(uint16_t tag, const uint8_t *v, uint32_t n)
+    {
+        return addBytes(tag, TIFF_BYTE, n, v, n);
+    }
+    int32_t addAscii(uint16_t tag, const char *str);
+    int32_t addShort(uint16_t tag, const uint16_t *v, uint32_t n);
+    int32_t addShort(uint16_t tag, uint16_t v) { return addShort(tag, &v, 1); }
+    int32_t addLong(uint16_t tag, const uint32_t *v, uint32_t n);
+    int32_t addLong(uint16_t tag, uint32_t v) { return addLong(tag, &v, 1); }
+    int32_t addRational(uint16_t tag, const float *v, uint32_t n,
+                        uint32_t den, bool sign);
+    void setLong(uint16_t tag, uint32_t v);
+    uint32_t getSize() const { return 2 + mCount * 12 + 4 + mValLen; }
+    int32_t serialize(uint8_t *out, uint32_t offset) const;
+
+private:
+    typedef struct {
+        uint16_t tag;
+        uint16_t type;
+        uint32_t count;
+        uint32_t len;
+        uint8_t inl[4];       // value when len <= 4
+        uint32_t valOffset;   // offset into mVals otherwise
+    } entry_t;
+
+    entry_t mEntries[QCAMERA_DNG_ENTRIES_MAX];
+    uint32_t mCount;
+    uint8_t mVals[QCAMERA_DNG_HEADER_MAX];
+    uint32_t mValLen;
+    bool mError;
+};
+
+/*===========================================================================
+ * FUNCTION   : addBytes
+ *
+ * DESCRIPTION: add an entry whose value is already serialized
+ *
+ * PARAMETERS :
+ *   @tag     : TIFF tag, greater than the previous one
+ *   @type    : TIFF field type
+ *   @count   : number of values
+ *   @data    : little endian value bytes
+ *   @len     : byte length of data
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraDngIfd::addBytes(uint16_t tag, uint16_t type, uint32_t count,
+                                const uint8_t *data, uint32_t len)
+{
+    if (mCount >= QCAMERA_DNG_ENTRIES_MAX ||
+        (mCount > 0 && mEntries[mCount - 1].tag >= tag)) {
+        mError = true;
+        return BAD_VALUE;
+    }
+
+    entry_t &e = mEntries[mCount];
+    memset(&e, 0, sizeof(e));
+    e.tag = tag;
+    e.type = type;
+    e.count = count;
+    e.len = len;
+    if (len <= sizeof(e.inl)) {
+        memcpy(e.inl, data, len);
+    } else {
+        // TIFF wants out of line values on word boundaries
+        uint32_t off = (mValLen + 3) & ~3U;
+        if (off + len > sizeof(mVals)) {
+            mError = true;
+            return NO_MEMORY;
+        }
+        memset(mVals + mValLen, 0, off - mValLen);
+        memcpy(mVals + off, data, len);
+        e.valOffset = off;
+        mValLen = off + len;
+    }
+    mCount++;
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : addAscii
+ *
+ * DESCRIPTION: add a NUL terminated string entry
+ *
+ * PARAMETERS :
+ *   @tag     : TIFF tag
+ *   @str     : string value
+ *
+ * RETURN     : int32_t type of status
+ *==========================================================================*/
+int32_t QCameraDngIfd::addAscii(uint16_t tag, const char *str)
+{
+    uint32_t len = (uint32_t)strlen(str) + 1;
+    return addBytes(tag, TIFF_ASCII, len, (const uint8_t *)str, len);
+}
+
+/*===========================================================================
+ * FUNCTION   : addShort
+ *
+ * DESCRIPTION: add an entry of 16 bit values
+ *
+ * PARAMETERS :
+ *   @tag     : TIFF tag
+ *   @v       : values
+ *   @n       : number of values, at most 8
+ *
+ * RETURN     : int32_t type of status
+ *==========================================================================*/
+int32_t QCameraDngIfd::addShort(uint16_t tag, const uint16_t *v, uint32_t n)
+{
+    uint8_t buf[16];
+    if (n > sizeof(buf) / 2) {
+        return BAD_VALUE;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        put16(buf + i * 2, v[i]);
+    }
+    return addBytes(tag, TIFF_SHORT, n, buf, n * 2);
+}
+
+/*===========================================================================
+ * FUNCTION   : addLong
+ *
+ * DESCRIPTION: add an entry of 32 bit values
+ *
+ * PARAMETERS :
+ *   @tag     : TIFF tag
+ *   @v       : values
+ *   @n       : number of values, at most 8
+ *
+ * RETURN     : int32_t type of status
+ *==========================================================================*/
+int32_t QCameraDngIfd::addLong(uint16_t tag, const uint32_t *v, uint32_t n)
+{
+    uint8_t buf[32];
+    if (n > sizeof(buf) / 4) {
+        return BAD_VALUE;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        put32(buf + i * 4, v[i]);
+    }
+    return addBytes(tag, TIFF_LONG, n, buf, n * 4);
+}
+
+/*===========================================================================
+ * FUNCTION   : addRational
+ *
+ * DESCRIPTION: add an entry of rationals with a fixed denominator
+ *
+ * PARAMETERS :
+ *   @tag     : TIFF tag
+ *   @v       : values
+ *   @n       : number of values, at most 9
+ *   @den     : denominator, sets the precision
+ *   @sign    : true for SRATIONAL
+ *
+ * RETURN     : int32_t type of status
+ *==========================================================================*/
+int32_t QCameraDngIfd::addRational(uint16_t tag, const float *v, uint32_t n,
+                                   uint32_t den, bool sign)
+{
+    uint8_t buf[72];
+    if (n > sizeof(buf) / 8) {
+        return BAD_VALUE;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        double num = floor((double)v[i] * den + 0.5);
+        if (sign) {
+            put32(buf + i * 8, (uint32_t)(int32_t)num);
+        } else {
+            put32(buf + i * 8, (num > 0) ? (uint32_t)num : 0);
+        }
+        put32(buf + i * 8 + 4, den);
+    }
+    return addBytes(tag, sign ? TIFF_SRATIONAL : TIFF_RATIONAL, n, buf, n * 8);
+}
+
+/*===========================================================================
+ * FUNCTION   : setLong
+ *
+ * DESCRIPTION: update the value of a single LONG entry added earlier
+ *
+ * PARAMETERS :
+ *   @tag     : TIFF tag
+ *   @v       : new value
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraDngIfd::setLong(uint16_t tag, uint32_t v)
+{
+    for (uint32_t i = 0; i < mCount; i++) {
+        if (mEntries[i].tag == tag && mEntries[i].len == 4) {
+            put32(mEntries[i].inl, v);
+            return;
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : serialize
+ *
+ * DESCRIPTION: write the IFD followed by its out of line values
+ *
+ * PARAMETERS :
+ *   @out     : destination, getSize() bytes
+ *   @offset  : file offset out will be stored at
+ *
+ * RETURN     : int32_t type of status
+ *==========================================================================*/
+int32_t QCameraDngIfd::serialize(uint8_t *out, uint32_t offset) const
+{
+    if (mError) {
+        return BAD_VALUE;
+    }
+
+    uint32_t valBase = offset + 2 + mCount * 12 + 4;
+    uint8_t *p = out;
+
+    put16(p, (uint16_t)mCount);
+    p += 2;
+    for (uint32_t i = 0; i < mCount; i++) {
+        const entry_t &e = mEntries[i];
+        put16(p, e.tag);
+        put16(p + 2, e.type);
+        put32(p + 4, e.count);
+        if (e.len <= sizeof(e.inl)) {
+            memset(p + 8, 0, 4);
+            memcpy(p + 8, e.inl, e.len);
+        } else {
+            put32(p + 8, valBase + e.valOffset);
+        }
+        p += 12;
+    }
+    // single IFD
+    put32(p, 0);
+    p += 4;
+    memcpy(p, mVals, mValLen);
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : initInfo
+ *
+ * DESCRIPTION: reset DNG info to defaults
+ *
+ * PARAMETERS :
+ *   @info    : info to reset
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraDngWriter::initInfo(qcamera_dng_info_t &info)
+{
+    memset(&info, 0, sizeof(info));
+    info.orientation = 1;
+}
+
+/*===========================================================================
+ * FUNCTION   : buildHeader
+ *
+ * DESCRIPTION: build TIFF header and IFD0 of a DNG file
+ *
+ * PARAMETERS :
+ *   @raw     : raw frame
+ *   @info    : tag values
+ *   @hdr     : destination, QCAMERA_DNG_HEADER_MAX bytes
+ *   @hdrSize : [output] header size, which is the offset of the image
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraDngWriter::buildHeader(const qcamera_raw_frame_t &raw,
+                                      const qcamera_dng_info_t &info,
+                                      uint8_t *hdr,
+                                      uint32_t &hdrSize)
+{
+    if (raw.data == NULL || raw.width <= 0 || raw.height <= 0 ||
+        raw.packing >= QCAMERA_RAW_PACK_MAX || raw.cfa >= QCAMERA_RAW_CFA_MAX ||
+        raw.bits < 8 || raw.bits > 16 || raw.stride < 0 ||
+        (uint32_t)raw.stride < QCameraRawUnpack::getRowBytes(raw.packing,
+                                                             raw.width)) {
+        return BAD_VALUE;
+    }
+
+    // the IFD is large, keep it off the caller's stack
+    QCameraDngIfd *ifd = new QCameraDngIfd();
+    if (ifd == NULL) {
+        return NO_MEMORY;
+    }
+
+    uint32_t imageBytes = (uint32_t)raw.width * raw.height * 2;
+    uint32_t whiteLevel = info.white_level;
+    if (whiteLevel == 0 || whiteLevel >= (1U << raw.bits)) {
+        whiteLevel = (1U << raw.bits) - 1;
+    }
+    char make[QCAMERA_DNG_STR_MAX];
+    char model[QCAMERA_DNG_STR_MAX];
+    char unique[QCAMERA_DNG_STR_MAX * 2];
+    snprintf(make, sizeof(make), "%.*s", (int)sizeof(make) - 1,
+             info.make[0] ? info.make : "Unknown");
+    snprintf(model, sizeof(model), "%.*s", (int)sizeof(model) - 1,
+             info.model[0] ? info.model : "Unknown");
+    snprintf(unique, sizeof(unique), "%s %s", make, model);
+
+    static const uint16_t two[2] = { 2, 2 };
+    static const uint8_t dngVersion[4] = { 1, 4, 0, 0 };
+    static const uint8_t dngBackward[4] = { 1, 1, 0, 0 };
+    const float *colorMatrix = g_defaultColorMatrix;
+    for (int i = 0; i < 9; i++) {
+        if (info.color_matrix[i] != 0.0f) {
+            colorMatrix = info.color_matrix;
+            break;
+        }
+    }
+
+    ifd->addLong(TAG_NEW_SUBFILE_TYPE, 0);
+    ifd->addLong(TAG_IMAGE_WIDTH, (uint32_t)raw.width);
+    ifd->addLong(TAG_IMAGE_LENGTH, (uint32_t)raw.height);
+    ifd->addShort(TAG_BITS_PER_SAMPLE, 16);
+    ifd->addShort(TAG_COMPRESSION, 1);
+    ifd->addShort(TAG_PHOTOMETRIC, PHOTOMETRIC_CFA);
+    ifd->addAscii(TAG_MAKE, make);
+    ifd->addAscii(TAG_MODEL, model);
+    ifd->addLong(TAG_STRIP_OFFSETS, 0);
+    ifd->addShort(TAG_ORIENTATION,
+        (info.orientation >= 1 && info.orientation <= 8) ? info.orientation : 1);
+    ifd->addShort(TAG_SAMPLES_PER_PIXEL, 1);
+    ifd->addLong(TAG_ROWS_PER_STRIP, (uint32_t)raw.height);
+    ifd->addLong(TAG_STRIP_BYTE_COUNTS, imageBytes);
+    ifd->addShort(TAG_PLANAR_CONFIG, 1);
+    if (info.software[0]) {
+        char software[QCAMERA_DNG_STR_MAX];
+        snprintf(software, sizeof(software), "%.*s", (int)sizeof(software) - 1,
+                 info.software);
+        ifd->addAscii(TAG_SOFTWARE, software);
+    }
+    if (info.datetime[0]) {
+        char dt[sizeof(info.datetime)];
+        snprintf(dt, sizeof(dt), "%.*s", (int)sizeof(dt) - 1, info.datetime);
+        ifd->addAscii(TAG_DATETIME, dt);
+    }
+    ifd->addShort(TAG_CFA_REPEAT_PATTERN_DIM, two, 2);
+    ifd->addByte(TAG_CFA_PATTERN, g_cfaPattern[raw.cfa], 4);
+    if (info.exposure_time > 0.0f) {
+        ifd->addRational(TAG_EXPOSURE_TIME, &info.exposure_time, 1,
+                         1000000, false);
+    }
+    if (info.f_number > 0.0f) {
+        ifd->addRational(TAG_FNUMBER, &info.f_number, 1, 100, false);
+    }
+    if (info.iso > 0) {
+        ifd->addShort(TAG_ISO_SPEED_RATINGS,
+                      (uint16_t)((info.iso > 0xFFFF) ? 0xFFFF : info.iso));
+    }
+    if (info.focal_length > 0.0f) {
+        ifd->addRational(TAG_FOCAL_LENGTH, &info.focal_length, 1, 1000, false);
+    }
+    ifd->addByte(TAG_DNG_VERSION, dngVersion, 4);
+    ifd->addByte(TAG_DNG_BACKWARD_VERSION, dngBackward, 4);
+    ifd->addAscii(TAG_UNIQUE_CAMERA_MODEL, unique);
+    ifd->addShort(TAG_BLACK_LEVEL_REPEAT_DIM, two, 2);
+    ifd->addLong(TAG_BLACK_LEVEL, info.black_level, 4);
+    ifd->addLong(TAG_WHITE_LEVEL, whiteLevel);
+    ifd->addRational(TAG_COLOR_MATRIX1, colorMatrix, 9, 10000, true);
+    if (info.as_shot_neutral[0] > 0.0f && info.as_shot_neutral[1] > 0.0f &&
+        info.as_shot_neutral[2] > 0.0f) {
+        ifd->addRational(TAG_AS_SHOT_NEUTRAL, info.as_shot_neutral, 3,
+                         1000000, false);
+    }
+    ifd->addShort(TAG_CALIBRATION_ILLUMINANT1, ILLUMINANT_D65);
+
+    uint32_t size = (8 + ifd->getSize() + 15) & ~15U;
+    if (size > QCAMERA_DNG_HEADER_MAX) {
+        delete ifd;
+        return NO_MEMORY;
+    }
+    ifd->setLong(TAG_STRIP_OFFSETS, size);
+
+    // little endian TIFF, IFD0 right after the header
+    memset(hdr, 0, size);
+    hdr[0] = 'I';
+    hdr[1] = 'I';
+    put16(hdr + 2, 42);
+    put32(hdr + 4, 8);
+    int32_t rc = ifd->serialize(hdr + 8, 8);
+    delete ifd;
+    if (rc != NO_ERROR) {
+        return rc;
+    }
+
+    hdrSize = size;
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : getSize
+ *
+ * DESCRIPTION: size of the DNG file for a raw frame
+ *
+ * PARAMETERS :
+ *   @raw     : raw frame
+ *   @info    : tag values
+ *
+ * RETURN     : file size in bytes, 0 if the frame can't be written
+ *==========================================================================*/
+size_t QCameraDngWriter::getSize(const qcamera_raw_frame_t &raw,
+                                 const qcamera_dng_info_t &info)
+{
+    uint8_t hdr[QCAMERA_DNG_HEADER_MAX];
+    uint32_t hdrSize = 0;
+
+    if (buildHeader(raw, info, hdr, hdrSize) != NO_ERROR) {
+        return 0;
+    }
+    return hdrSize + (size_t)raw.width * raw.height * 2;
+}
+
+/*===========================================================================
+ * FUNCTION   : writeToMemory
+ *
+ * DESCRIPTION: encode a raw frame as DNG into a buffer
+ *
+ * PARAMETERS :
+ *   @raw     : raw frame
+ *   @info    : tag values
+ *   @buf     : destination
+ *   @bufSize : size of buf, at least getSize()
+ *   @written : [output] bytes written
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraDngWriter::writeToMemory(const qcamera_raw_frame_t &raw,
+                                        const qcamera_dng_info_t &info,
+                                        uint8_t *buf,
+                                        size_t bufSize,
+                                        size_t &written)
+{
+    uint8_t hdr[QCAMERA_DNG_HEADER_MAX];
+    uint32_t hdrSize = 0;
+    int32_t rc;
+
+    written = 0;
+    if (buf == NULL) {
+        return BAD_VALUE;
+    }
+    rc = buildHeader(raw, info, hdr, hdrSize);
+    if (rc != NO_ERROR) {
+        return rc;
+    }
+    size_t rowBytes = (size_t)raw.width * 2;
+    size_t size = hdrSize + rowBytes * raw.height;
+    if (bufSize < size) {
+        return NO_MEMORY;
+    }
+
+    memcpy(buf, hdr, hdrSize);
+
+    // samples are stored in host order, all targets are little endian
+    uint8_t *dst = buf + hdrSize;
+    uint16_t *row = NULL;
+    if ((uintptr_t)dst & 1) {
+        row = (uint16_t *)malloc(rowBytes);
+        if (row == NULL) {
+            return NO_MEMORY;
+        }
+    }
+    const uint8_t *src = raw.data;
+    for (int32_t y = 0; y < raw.height; y++) {
+        if (row != NULL) {
+            QCameraRawUnpack::unpackRow(raw.packing, src, row, raw.width);
+            memcpy(dst, row, rowBytes);
+        } else {
+            QCameraRawUnpack::unpackRow(raw.packing, src, (uint16_t *)dst,
+                                        raw.width);
+        }
+        src += raw.stride;
+        dst += rowBytes;
+    }
+    free(row);
+
+    written = size;
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : writeAll
+ *
+ * DESCRIPTION: write a buffer to a file descriptor, retrying short writes
+ *
+ * PARAMETERS :
+ *   @fd      : file descriptor
+ *   @data    : bytes to write
+ *   @len     : number of bytes
+ *
+ * RETURN     : int32_t type of status
+ *==========================================================================*/
+static int32_t writeAll(int fd, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return UNKNOWN_ERROR;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : writeToFd
+ *
+ * DESCRIPTION: encode a raw frame as DNG into a file. Rows are unpacked
+ *              into a small chunk buffer that is flushed as it fills.
+ *
+ * PARAMETERS :
+ *   @raw     : raw frame
+ *   @info    : tag values
+ *   @fd      : file descriptor open for writing
+ *   @written : [output] bytes written
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraDngWriter::writeToFd(const qcamera_raw_frame_t &raw,
+                                    const qcamera_dng_info_t &info,
+                                    int fd,
+                                    size_t &written)
+{
+    uint8_t hdr[QCAMERA_DNG_HEADER_MAX];
+    uint32_t hdrSize = 0;
+    int32_t rc;
+
+    written = 0;
+    if (fd < 0) {
+        return BAD_VALUE;
+    }
+    rc = buildHeader(raw, info, hdr, hdrSize);
+    if (rc != NO_ERROR) {
+        return rc;
+    }
+
+    size_t rowBytes = (size_t)raw.width * 2;
+    int32_t chunkRows = (int32_t)(QCAMERA_DNG_WRITE_CHUNK / rowBytes);
+    if (chunkRows < 1) {
+        chunkRows = 1;
+    }
+    uint8_t *chunk = (uint8_t *)malloc(rowBytes * chunkRows);
+    if (chunk == NULL) {
+        return NO_MEMORY;
+    }
+
+    rc = writeAll(fd, hdr, hdrSize);
+    const uint8_t *src = raw.data;
+    for (int32_t y = 0; y < raw.height && rc == NO_ERROR; y += chunkRows) {
+        int32_t rows = raw.height - y;
+        if (rows > chunkRows) {
+            rows = chunkRows;
+        }
+        for (int32_t r = 0; r < rows; r++) {
+            QCameraRawUnpack::unpackRow(raw.packing, src,
+                (uint16_t *)(chunk + r * rowBytes), raw.width);
+            src += raw.stride;
+        }
+        rc = writeAll(fd, chunk, rowBytes * rows);
+    }
+    free(chunk);
+
+    if (rc == NO_ERROR) {
+        written = hdrSize + rowBytes * raw.height;
+    }
+    return rc;
+}
+
+}; // namespace qcamera
@@ -0,0 +1,86 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_DNG_WRITER_H__
+#define __QCAMERA_DNG_WRITER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "QCameraRawUnpack.h"
+
+namespace qcamera {
+
+#define QCAMERA_DNG_STR_MAX 64
+
+// Tag values of a DNG file. Zero valued optional fields are left out of
+// the file.
+typedef struct {
+    char make[QCAMERA_DNG_STR_MAX];
+    char model[QCAMERA_DNG_STR_MAX];
+    char software[QCAMERA_DNG_STR_MAX];
+    char datetime[20];        // "YYYY:MM:DD HH:MM:SS"
+    uint16_t orientation;     // TIFF orientation, 1 is upright
+    uint32_t white_level;     // 0 uses the full range of the sample bits
+    uint32_t black_level[4];  // per CFA position, row major
+    float color_matrix[9];    // XYZ to camera, all zero for the default
+    float as_shot_neutral[3]; // optional
+    float exposure_time;      // seconds, optional
+    float f_number;           // optional
+    float focal_length;       // mm, optional
+    uint32_t iso;             // optional
+} qcamera_dng_info_t;
+
+// Writes a single IFD, uncompressed, 16 bit CFA DNG. The header and tags
+// are built in a small local buffer and the image is unpacked row by row
+// straight into the output, so the packed frame is read only once.
+class QCameraDngWriter {
+public:
+    static void initInfo(qcamera_dng_info_t &info);
+    static size_t getSize(const qcamera_raw_frame_t &raw,
+                          const qcamera_dng_info_t &info);
+    static int32_t writeToMemory(const qcamera_raw_frame_t &raw,
+                                 const qcamera_dng_info_t &info,
+                                 uint8_t *buf,
+                                 size_t bufSize,
+                                 size_t &written);
+    static int32_t writeToFd(const qcamera_raw_frame_t &raw,
+                             const qcamera_dng_info_t &info,
+                             int fd,
+                             size_t &written);
+
+private:
+    static int32_t buildHeader(const qcamera_raw_frame_t &raw,
+                               const qcamera_dng_info_t &info,
+                               uint8_t *hdr,
+                               uint32_t &hdrSize);
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_DNG_WRITER_H__ */
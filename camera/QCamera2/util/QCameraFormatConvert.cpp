@@ -0,0 +1,488 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <utils/Errors.h>
+#include <string.h>
+#include "QCameraFormatConvert.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define QCAMERA_CONVERT_SSE2
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define QCAMERA_CONVERT_NEON
+#endif
+
+using namespace android;
+
+namespace qcamera {
+
+#define QCAMERA_ALIGN16(x) (((x) + 15) & ~15)
+
+/*===========================================================================
+ * FUNCTION   : isPacked
+ *
+ * DESCRIPTION: check if a format is packed 4:2:2
+ *
+ * PARAMETERS :
+ *   @fmt     : pixel format
+ *
+ * RETURN     : true if fmt is one of the packed 4:2:2 formats
+ *==========================================================================*/
+static inline bool isPacked(qcamera_pix_fmt_t fmt)
+{
+    return fmt >= QCAMERA_PIX_FMT_YUYV && fmt <= QCAMERA_PIX_FMT_VYUY;
+}
+
+/*===========================================================================
+ * FUNCTION   : getPackedLayout
+ *
+ * DESCRIPTION: lay out a tightly packed frame, as delivered to apps
+ *
+ * PARAMETERS :
+ *   @fmt     : pixel format
+ *   @width   : width in pixels, even
+ *   @height  : height in pixels, even
+ *   @base    : start of the frame memory, may be NULL
+ *   @frame   : [output] frame layout
+ *   @size    : [output] bytes needed for the frame
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraFormatConvert::getPackedLayout(qcamera_pix_fmt_t fmt,
+                                              int32_t width,
+                                              int32_t height,
+                                              uint8_t *base,
+                                              qcamera_pix_frame_t &frame,
+                                              size_t &size)
+{
+    if (width <= 0 || height <= 0 || (width & 1) || (height & 1)) {
+        return BAD_VALUE;
+    }
+
+    memset(&frame, 0, sizeof(frame));
+    frame.fmt = fmt;
+    frame.width = width;
+    frame.height = height;
+    frame.plane[0] = base;
+
+    switch (fmt) {
+    case QCAMERA_PIX_FMT_NV21:
+    case QCAMERA_PIX_FMT_NV12:
+        frame.stride[0] = width;
+        frame.stride[1] = width;
+        size = (size_t)width * height * 3 / 2;
+        if (base != NULL) {
+            frame.plane[1] = base + width * height;
+        }
+        break;
+    case QCAMERA_PIX_FMT_YV12:
+        frame.stride[0] = QCAMERA_ALIGN16(width);
+        frame.stride[1] = QCAMERA_ALIGN16(frame.stride[0] / 2);
+        frame.stride[2] = frame.stride[1];
+        size = (size_t)frame.stride[0] * height +
+            (size_t)frame.stride[1] * height;
+        if (base != NULL) {
+            frame.plane[1] = base + frame.stride[0] * height;
+            frame.plane[2] = frame.plane[1] + frame.stride[1] * height / 2;
+        }
+        break;
+    case QCAMERA_PIX_FMT_YUYV:
+    case QCAMERA_PIX_FMT_YVYU:
+    case QCAMERA_PIX_FMT_UYVY:
+    case QCAMERA_PIX_FMT_VYUY:
+        frame.stride[0] = width * 2;
+        size = (size_t)width * height * 2;
+        break;
+    default:
+        return BAD_VALUE;
+    }
+
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : isConvertible
+ *
+ * DESCRIPTION: check if convert() supports a pair of formats
+ *
+ * PARAMETERS :
+ *   @src     : source pixel format
+ *   @dst     : destination pixel format
+ *
+ * RETURN     : true if src can be converted to dst
+ *==========================================================================*/
+bool QCameraFormatConvert::isConvertible(qcamera_pix_fmt_t src,
+                                         qcamera_pix_fmt_t dst)
+{
+    if (src >= QCAMERA_PIX_FMT_MAX || dst >= QCAMERA_PIX_FMT_MAX) {
+        return false;
+    }
+    if (src == dst) {
+        return true;
+    }
+    switch (src) {
+    case QCAMERA_PIX_FMT_NV21:
+    case QCAMERA_PIX_FMT_NV12:
+        return dst == QCAMERA_PIX_FMT_NV21 ||
+            dst == QCAMERA_PIX_FMT_NV12 ||
+            dst == QCAMERA_PIX_FMT_YV12;
+    case QCAMERA_PIX_FMT_YUYV:
+    case QCAMERA_PIX_FMT_YVYU:
+    case QCAMERA_PIX_FMT_UYVY:
+    case QCAMERA_PIX_FMT_VYUY:
+        return dst == QCAMERA_PIX_FMT_NV21 || dst == QCAMERA_PIX_FMT_NV12;
+    default:
+        return false;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : isSameLayout
+ *
+ * DESCRIPTION: compare the memory layout of two frames
+ *
+ * PARAMETERS :
+ *   @a       : first frame
+ *   @b       : second frame
+ *
+ * RETURN     : true if format, size, plane offsets and strides match
+ *==========================================================================*/
+bool QCameraFormatConvert::isSameLayout(const qcamera_pix_frame_t &a,
+                                        const qcamera_pix_frame_t &b)
+{
+    int planes;
+
+    if (a.fmt != b.fmt || a.width != b.width || a.height != b.height) {
+        return false;
+    }
+    if (a.fmt == QCAMERA_PIX_FMT_YV12) {
+        planes = 3;
+    } else if (isPacked(a.fmt)) {
+        planes = 1;
+    } else {
+        planes = 2;
+    }
+    for (int i = 0; i < planes; i++) {
+        if (a.stride[i] != b.stride[i] ||
+            a.plane[i] - a.plane[0] != b.plane[i] - b.plane[0]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : copyPlane
+ *
+ * DESCRIPTION: copy the rows of a plane, dropping stride padding
+ *
+ * PARAMETERS :
+ *   @dst       : destination plane
+ *   @dstStride : destination stride in bytes
+ *   @src       : source plane
+ *   @srcStride : source stride in bytes
+ *   @width     : bytes per row to copy
+ *   @height    : number of rows
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFormatConvert::copyPlane(uint8_t *dst, int32_t dstStride,
+                                     const uint8_t *src, int32_t srcStride,
+                                     int32_t width, int32_t height)
+{
+    if (dstStride == width && srcStride == width) {
+        memcpy(dst, src, (size_t)width * height);
+        return;
+    }
+    for (int32_t y = 0; y < height; y++) {
+        memcpy(dst, src, width);
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : swapChroma
+ *
+ * DESCRIPTION: swap the samples of an interleaved chroma plane, converting
+ *              CrCb to CbCr and back
+ *
+ * PARAMETERS :
+ *   @dst       : destination plane
+ *   @dstStride : destination stride in bytes
+ *   @src       : source plane
+ *   @srcStride : source stride in bytes
+ *   @width     : chroma pairs per row
+ *   @height    : number of rows
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFormatConvert::swapChroma(uint8_t *dst, int32_t dstStride,
+                                      const uint8_t *src, int32_t srcStride,
+                                      int32_t width, int32_t height)
+{
+    for (int32_t y = 0; y < height; y++) {
+        const uint8_t *s = src + y * srcStride;
+        uint8_t *d = dst + y * dstStride;
+        int32_t x = 0;
+#if defined(QCAMERA_CONVERT_SSE2)
+        for (; x + 8 <= width; x += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(s + 2 * x));
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            _mm_storeu_si128((__m128i *)(d + 2 * x), v);
+        }
+#elif defined(QCAMERA_CONVERT_NEON)
+        for (; x + 8 <= width; x += 8) {
+            vst1q_u8(d + 2 * x, vrev16q_u8(vld1q_u8(s + 2 * x)));
+        }
+#endif
+        for (; x < width; x++) {
+            uint8_t c = s[2 * x];
+            d[2 * x] = s[2 * x + 1];
+            d[2 * x + 1] = c;
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : splitChroma
+ *
+ * DESCRIPTION: split an interleaved chroma plane into two planes
+ *
+ * PARAMETERS :
+ *   @dst0       : plane receiving the first sample of each pair
+ *   @dst0Stride : stride of dst0 in bytes
+ *   @dst1       : plane receiving the second sample of each pair
+ *   @dst1Stride : stride of dst1 in bytes
+ *   @src        : interleaved chroma plane
+ *   @srcStride  : source stride in bytes
+ *   @width      : chroma pairs per row
+ *   @height     : number of rows
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFormatConvert::splitChroma(uint8_t *dst0, int32_t dst0Stride,
+                                       uint8_t *dst1, int32_t dst1Stride,
+                                       const uint8_t *src, int32_t srcStride,
+                                       int32_t width, int32_t height)
+{
+    for (int32_t y = 0; y < height; y++) {
+        const uint8_t *s = src + y * srcStride;
+        uint8_t *d0 = dst0 + y * dst0Stride;
+        uint8_t *d1 = dst1 + y * dst1Stride;
+        int32_t x = 0;
+#if defined(QCAMERA_CONVERT_SSE2)
+        const __m128i lo = _mm_set1_epi16(0x00ff);
+        for (; x + 16 <= width; x += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(s + 2 * x));
+            __m128i b = _mm_loadu_si128((const __m128i *)(s + 2 * x + 16));
+            _mm_storeu_si128((__m128i *)(d0 + x),
+                _mm_packus_epi16(_mm_and_si128(a, lo), _mm_and_si128(b, lo)));
+            _mm_storeu_si128((__m128i *)(d1 + x),
+                _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+        }
+#elif defined(QCAMERA_CONVERT_NEON)
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x2_t v = vld2q_u8(s + 2 * x);
+            vst1q_u8(d0 + x, v.val[0]);
+            vst1q_u8(d1 + x, v.val[1]);
+        }
+#endif
+        for (; x < width; x++) {
+            d0[x] = s[2 * x];
+            d1[x] = s[2 * x + 1];
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : packedToSemiPlanar
+ *
+ * DESCRIPTION: convert packed 4:2:2 to 4:2:0 semi-planar. Chroma of each
+ *              pair of rows is averaged.
+ *
+ * PARAMETERS :
+ *   @dstY       : destination luma plane
+ *   @dstYStride : luma stride in bytes
+ *   @dstC       : destination interleaved chroma plane
+ *   @dstCStride : chroma stride in bytes
+ *   @src        : packed source
+ *   @srcStride  : source stride in bytes
+ *   @width      : width in pixels, even
+ *   @height     : height in pixels, even
+ *   @srcFmt     : one of the packed 4:2:2 formats
+ *   @crFirst    : true for CrCb (NV21) output, false for CbCr (NV12)
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFormatConvert::packedToSemiPlanar(uint8_t *dstY, int32_t dstYStride,
+                                              uint8_t *dstC, int32_t dstCStride,
+                                              const uint8_t *src, int32_t srcStride,
+                                              int32_t width, int32_t height,
+                                              qcamera_pix_fmt_t srcFmt, bool crFirst)
+{
+    // luma is at odd bytes for UYVY/VYUY, chroma fills the other bytes
+    // and is already interleaved in source order
+    const int yOff = (srcFmt == QCAMERA_PIX_FMT_UYVY ||
+        srcFmt == QCAMERA_PIX_FMT_VYUY) ? 1 : 0;
+    const bool srcCrFirst = (srcFmt == QCAMERA_PIX_FMT_YVYU ||
+        srcFmt == QCAMERA_PIX_FMT_VYUY);
+    const bool swap = (srcCrFirst != crFirst);
+    const int32_t pairs = width / 2;
+
+    for (int32_t y = 0; y < height; y += 2) {
+        const uint8_t *s0 = src + y * srcStride;
+        const uint8_t *s1 = s0 + srcStride;
+        uint8_t *y0 = dstY + y * dstYStride;
+        uint8_t *y1 = y0 + dstYStride;
+        uint8_t *c = dstC + (y / 2) * dstCStride;
+        int32_t x = 0;
+#if defined(QCAMERA_CONVERT_SSE2)
+        const __m128i lo = _mm_set1_epi16(0x00ff);
+        for (; x + 16 <= width; x += 16) {
+            __m128i a0 = _mm_loadu_si128((const __m128i *)(s0 + 2 * x));
+            __m128i b0 = _mm_loadu_si128((const __m128i *)(s0 + 2 * x + 16));
+            __m128i a1 = _mm_loadu_si128((const __m128i *)(s1 + 2 * x));
+            __m128i b1 = _mm_loadu_si128((const __m128i *)(s1 + 2 * x + 16));
+            __m128i l0, l1, c0, c1;
+            if (yOff == 0) {
+                l0 = _mm_packus_epi16(_mm_and_si128(a0, lo), _mm_and_si128(b0, lo));
+                l1 = _mm_packus_epi16(_mm_and_si128(a1, lo), _mm_and_si128(b1, lo));
+                c0 = _mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(b0, 8));
+                c1 = _mm_packus_epi16(_mm_srli_epi16(a1, 8), _mm_srli_epi16(b1, 8));
+            } else {
+                l0 = _mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(b0, 8));
+                l1 = _mm_packus_epi16(_mm_srli_epi16(a1, 8), _mm_srli_epi16(b1, 8));
+                c0 = _mm_packus_epi16(_mm_and_si128(a0, lo), _mm_and_si128(b0, lo));
+                c1 = _mm_packus_epi16(_mm_and_si128(a1, lo), _mm_and_si128(b1, lo));
+            }
+            c0 = _mm_avg_epu8(c0, c1);
+            if (swap) {
+                c0 = _mm_or_si128(_mm_slli_epi16(c0, 8), _mm_srli_epi16(c0, 8));
+            }
+            _mm_storeu_si128((__m128i *)(y0 + x), l0);
+            _mm_storeu_si128((__m128i *)(y1 + x), l1);
+            _mm_storeu_si128((__m128i *)(c + x), c0);
+        }
+#elif defined(QCAMERA_CONVERT_NEON)
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x2_t v0 = vld2q_u8(s0 + 2 * x);
+            uint8x16x2_t v1 = vld2q_u8(s1 + 2 * x);
+            uint8x16_t cv = vrhaddq_u8(v0.val[1 - yOff], v1.val[1 - yOff]);
+            if (swap) {
+                cv = vrev16q_u8(cv);
+            }
+            vst1q_u8(y0 + x, v0.val[yOff]);
+            vst1q_u8(y1 + x, v1.val[yOff]);
+            vst1q_u8(c + x, cv);
+        }
+#endif
+        for (int32_t p = x / 2; p < pairs; p++) {
+            const uint8_t *g0 = s0 + 4 * p;
+            const uint8_t *g1 = s1 + 4 * p;
+            uint8_t first = (uint8_t)((g0[1 - yOff] + g1[1 - yOff] + 1) >> 1);
+            uint8_t second = (uint8_t)((g0[3 - yOff] + g1[3 - yOff] + 1) >> 1);
+            y0[2 * p] = g0[yOff];
+            y0[2 * p + 1] = g0[2 + yOff];
+            y1[2 * p] = g1[yOff];
+            y1[2 * p + 1] = g1[2 + yOff];
+            c[2 * p] = swap ? second : first;
+            c[2 * p + 1] = swap ? first : second;
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : convert
+ *
+ * DESCRIPTION: convert a frame to another format and layout
+ *
+ * PARAMETERS :
+ *   @src     : source frame
+ *   @dst     : destination frame, same size as src
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraFormatConvert::convert(const qcamera_pix_frame_t &src,
+                                      const qcamera_pix_frame_t &dst)
+{
+    const int32_t w = src.width;
+    const int32_t h = src.height;
+
+    if (w <= 0 || h <= 0 || (w & 1) || (h & 1) ||
+        w != dst.width || h != dst.height ||
+        !isConvertible(src.fmt, dst.fmt)) {
+        return BAD_VALUE;
+    }
+
+    if (isPacked(src.fmt)) {
+        if (src.fmt == dst.fmt) {
+            copyPlane(dst.plane[0], dst.stride[0],
+                      src.plane[0], src.stride[0], w * 2, h);
+        } else {
+            packedToSemiPlanar(dst.plane[0], dst.stride[0],
+                               dst.plane[1], dst.stride[1],
+                               src.plane[0], src.stride[0], w, h,
+                               src.fmt, dst.fmt == QCAMERA_PIX_FMT_NV21);
+        }
+        return NO_ERROR;
+    }
+
+    copyPlane(dst.plane[0], dst.stride[0], src.plane[0], src.stride[0], w, h);
+
+    if (src.fmt == QCAMERA_PIX_FMT_YV12) {
+        copyPlane(dst.plane[1], dst.stride[1],
+                  src.plane[1], src.stride[1], w / 2, h / 2);
+        copyPlane(dst.plane[2], dst.stride[2],
+                  src.plane[2], src.stride[2], w / 2, h / 2);
+    } else if (dst.fmt == QCAMERA_PIX_FMT_YV12) {
+        // YV12 keeps Cr in its first chroma plane
+        bool crFirst = (src.fmt == QCAMERA_PIX_FMT_NV21);
+        splitChroma(crFirst ? dst.plane[1] : dst.plane[2],
+                    crFirst ? dst.stride[1] : dst.stride[2],
+                    crFirst ? dst.plane[2] : dst.plane[1],
+                    crFirst ? dst.stride[2] : dst.stride[1],
+                    src.plane[1], src.stride[1], w / 2, h / 2);
+    } else if (src.fmt != dst.fmt) {
+        swapChroma(dst.plane[1], dst.stride[1],
+                   src.plane[1], src.stride[1], w / 2, h / 2);
+    } else {
+        copyPlane(dst.plane[1], dst.stride[1],
+                  src.plane[1], src.stride[1], w, h / 2);
+    }
+
+    return NO_ERROR;
+}
+
+}; // namespace qcamera
@@ -0,0 +1,104 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_FORMAT_CONVERT_H__
+#define __QCAMERA_FORMAT_CONVERT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace qcamera {
+
+typedef enum {
+    QCAMERA_PIX_FMT_NV21,     // Y plane, interleaved CrCb plane
+    QCAMERA_PIX_FMT_NV12,     // Y plane, interleaved CbCr plane
+    QCAMERA_PIX_FMT_YV12,     // Y plane, Cr plane, Cb plane
+    QCAMERA_PIX_FMT_YUYV,     // packed 4:2:2, one plane
+    QCAMERA_PIX_FMT_YVYU,
+    QCAMERA_PIX_FMT_UYVY,
+    QCAMERA_PIX_FMT_VYUY,
+    QCAMERA_PIX_FMT_MAX
+} qcamera_pix_fmt_t;
+
+// Layout of an 8 bit YUV image in memory. Strides are in bytes, planes
+// the format does not use are ignored.
+typedef struct {
+    qcamera_pix_fmt_t fmt;
+    int32_t width;
+    int32_t height;
+    uint8_t *plane[3];
+    int32_t stride[3];
+} qcamera_pix_frame_t;
+
+// Pixel format conversion and de-padding between the layouts produced by
+// the preview stream and the ones expected in app callbacks. Kernels use
+// NEON or SSE2 when available and plain C otherwise, rows are processed
+// independently so any stride is accepted.
+class QCameraFormatConvert {
+public:
+    // lays out a tightly packed frame of fmt at base, as apps expect it:
+    // strides equal to the width, except YV12 which uses a 16 byte aligned
+    // luma stride and a 16 byte aligned chroma stride of half of it.
+    // base may be NULL to only query the size.
+    static int32_t getPackedLayout(qcamera_pix_fmt_t fmt,
+                                   int32_t width,
+                                   int32_t height,
+                                   uint8_t *base,
+                                   qcamera_pix_frame_t &frame,
+                                   size_t &size);
+    static bool isConvertible(qcamera_pix_fmt_t src, qcamera_pix_fmt_t dst);
+    // true if both frames describe the same memory layout
+    static bool isSameLayout(const qcamera_pix_frame_t &a,
+                             const qcamera_pix_frame_t &b);
+    static int32_t convert(const qcamera_pix_frame_t &src,
+                           const qcamera_pix_frame_t &dst);
+
+    // kernels. copyPlane takes a width in bytes, the chroma kernels a
+    // number of interleaved pairs per row and packedToSemiPlanar the
+    // size of the image in pixels, both even.
+    static void copyPlane(uint8_t *dst, int32_t dstStride,
+                          const uint8_t *src, int32_t srcStride,
+                          int32_t width, int32_t height);
+    static void swapChroma(uint8_t *dst, int32_t dstStride,
+                           const uint8_t *src, int32_t srcStride,
+                           int32_t width, int32_t height);
+    static void splitChroma(uint8_t *dst0, int32_t dst0Stride,
+                            uint8_t *dst1, int32_t dst1Stride,
+                            const uint8_t *src, int32_t srcStride,
+                            int32_t width, int32_t height);
+    static void packedToSemiPlanar(uint8_t *dstY, int32_t dstYStride,
+                                   uint8_t *dstC, int32_t dstCStride,
+                                   const uint8_t *src, int32_t srcStride,
+                                   int32_t width, int32_t height,
+                                   qcamera_pix_fmt_t srcFmt, bool crFirst);
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_FORMAT_CONVERT_H__ */
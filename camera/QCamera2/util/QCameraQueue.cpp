@@ -108,6 +108,24 @@ bool QCameraQueue::isEmpty()
     return flag;
 }
 
+/*===========================================================================
+ * FUNCTION   : getCurrentSize
+ *
+ * DESCRIPTION: return the current number of nodes in the queue
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : number of nodes in the queue
+ *==========================================================================*/
+int QCameraQueue::getCurrentSize()
+{
+    int size;
+    pthread_mutex_lock(&m_lock);
+    size = m_size;
+    pthread_mutex_unlock(&m_lock);
+    return size;
+}
+
 /*===========================================================================
  * FUNCTION   : enqueue
  *
@@ -213,6 +231,51 @@ void* QCameraQueue::dequeue(bool bFromHead)
     return data;
 }
 
+/*===========================================================================
+ * FUNCTION   : dequeue
+ *
+ * DESCRIPTION: dequeue the first node matching the given function
+ *
+ * PARAMETERS :
+ *   @match      : matching function
+ *   @match_data : data passed to the matching function
+ *
+ * RETURN     : data ptr. NULL if no matching data in the queue.
+ *==========================================================================*/
+void* QCameraQueue::dequeue(match_fn_data match, void *match_data)
+{
+    camera_q_node* node = NULL;
+    void* data = NULL;
+    struct cam_list *head = NULL;
+    struct cam_list *pos = NULL;
+
+    if ( NULL == match ) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    head = &m_head.list;
+    pos = head->next;
+    while (pos != head) {
+        node = member_of(pos, camera_q_node, list);
+        if ( match(node->data, m_userData, match_data) ) {
+            cam_list_del_node(&node->list);
+            m_size--;
+            break;
+        }
+        node = NULL;
+        pos = pos->next;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (NULL != node) {
+        data = node->data;
+        free(node);
+    }
+
+    return data;
+}
+
 /*===========================================================================
  * FUNCTION   : flush
  *
@@ -294,4 +357,52 @@ void QCameraQueue::flushNodes(match_fn match){
     pthread_mutex_unlock(&m_lock);
 }
 
+/*===========================================================================
+ * FUNCTION   : flushNodes
+ *
+ * DESCRIPTION: flush only specific nodes, depending on the given matching
+ *              function and the extra data passed to it.
+ *
+ * PARAMETERS :
+ *   @match      : matching function
+ *   @match_data : data passed to the matching function
+ *
+ * RETURN     : number of nodes flushed
+ *==========================================================================*/
+int QCameraQueue::flushNodes(match_fn_data match, void *match_data){
+    camera_q_node* node = NULL;
+    struct cam_list *head = NULL;
+    struct cam_list *pos = NULL;
+    int flushed = 0;
+
+    if ( NULL == match ) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    head = &m_head.list;
+    pos = head->next;
+
+    while(pos != head) {
+        node = member_of(pos, camera_q_node, list);
+        pos = pos->next;
+        if ( match(node->data, m_userData, match_data) ) {
+            cam_list_del_node(&node->list);
+            m_size--;
+            flushed++;
+
+            if (NULL != node->data) {
+                if (m_dataFn) {
+                    m_dataFn(node->data, m_userData);
+                }
+                free(node->data);
+            }
+            free(node);
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    return flushed;
+}
+
 }; // namespace qcamera
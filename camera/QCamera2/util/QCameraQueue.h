@@ -37,6 +37,7 @@ namespace qcamera {
 
 typedef void (*release_data_fn)(void* data, void *user_data);
 typedef bool (*match_fn)(void *data, void *user_data);
+typedef bool (*match_fn_data)(void *data, void *user_data, void *match_data);
 
 class QCameraQueue {
 public:
@@ -47,8 +48,11 @@ public:
     bool enqueueWithPriority(void *data);
     void flush();
     void flushNodes(match_fn match);
+    int flushNodes(match_fn_data match, void *match_data);
     void* dequeue(bool bFromHead = true);
+    void* dequeue(match_fn_data match, void *match_data);
     bool isEmpty();
+    int getCurrentSize();
 private:
     typedef struct {
         struct cam_list list;
@@ -0,0 +1,398 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <string.h>
+#include "QCameraRawUnpack.h"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define QCAMERA_UNPACK_SSSE3
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define QCAMERA_UNPACK_NEON
+#endif
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : load64
+ *
+ * DESCRIPTION: read a little endian 64 bit word from any alignment
+ *
+ * PARAMETERS :
+ *   @p       : first byte of the word
+ *
+ * RETURN     : word value
+ *==========================================================================*/
+static inline uint64_t load64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/*===========================================================================
+ * FUNCTION   : getRowBytes
+ *
+ * DESCRIPTION: number of bytes a packed row of samples occupies
+ *
+ * PARAMETERS :
+ *   @packing : raw packing
+ *   @width   : samples in the row
+ *
+ * RETURN     : bytes read by unpackRow for this width, 0 if unsupported
+ *==========================================================================*/
+uint32_t QCameraRawUnpack::getRowBytes(qcamera_raw_packing_t packing,
+                                       int32_t width)
+{
+    uint32_t w = (width > 0) ? (uint32_t)width : 0;
+
+    switch (packing) {
+    case QCAMERA_RAW_PACK_PLAIN8:
+        return w;
+    case QCAMERA_RAW_PACK_MIPI10:
+        return (w + 3) / 4 * 5;
+    case QCAMERA_RAW_PACK_MIPI12:
+        return (w + 1) / 2 * 3;
+    case QCAMERA_RAW_PACK_QCOM10:
+        return (w + 5) / 6 * 8;
+    case QCAMERA_RAW_PACK_QCOM12:
+        return (w + 4) / 5 * 8;
+    case QCAMERA_RAW_PACK_PLAIN16:
+        return w * 2;
+    default:
+        return 0;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackRow
+ *
+ * DESCRIPTION: unpack one row of raw samples to 16 bits per sample
+ *
+ * PARAMETERS :
+ *   @packing : raw packing of src
+ *   @src     : packed row, getRowBytes(packing, width) bytes
+ *   @dst     : destination, width samples
+ *   @width   : samples in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraRawUnpack::unpackRow(qcamera_raw_packing_t packing,
+                                 const uint8_t *src,
+                                 uint16_t *dst,
+                                 int32_t width)
+{
+    switch (packing) {
+    case QCAMERA_RAW_PACK_PLAIN8:
+        unpackPlain8(src, dst, width);
+        break;
+    case QCAMERA_RAW_PACK_MIPI10:
+        unpackMipi10(src, dst, width);
+        break;
+    case QCAMERA_RAW_PACK_MIPI12:
+        unpackMipi12(src, dst, width);
+        break;
+    case QCAMERA_RAW_PACK_QCOM10:
+        unpackQcom10(src, dst, width);
+        break;
+    case QCAMERA_RAW_PACK_QCOM12:
+        unpackQcom12(src, dst, width);
+        break;
+    case QCAMERA_RAW_PACK_PLAIN16:
+        unpackPlain16(src, dst, width);
+        break;
+    default:
+        break;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackPlain8
+ *
+ * DESCRIPTION: widen a row of 8 bit samples
+ *
+ * PARAMETERS :
+ *   @src     : source row
+ *   @dst     : destination row
+ *   @width   : samples in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraRawUnpack::unpackPlain8(const uint8_t *src,
+                                    uint16_t *dst,
+                                    int32_t width)
+{
+    int32_t x = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= width; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + x));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128((__m128i *)(dst + x + 8), _mm_unpackhi_epi8(v, zero));
+    }
+#elif defined(QCAMERA_UNPACK_NEON)
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t v = vld1q_u8(src + x);
+        vst1q_u16(dst + x, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(dst + x + 8, vmovl_u8(vget_high_u8(v)));
+    }
+#endif
+    for (; x < width; x++) {
+        dst[x] = src[x];
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackMipi10
+ *
+ * DESCRIPTION: unpack a row of MIPI RAW10 samples. Every 5 bytes hold the
+ *              high 8 bits of 4 samples followed by a byte with their low
+ *              2 bits, first sample in the least significant pair.
+ *
+ * PARAMETERS :
+ *   @src     : source row
+ *   @dst     : destination row
+ *   @width   : samples in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraRawUnpack::unpackMipi10(const uint8_t *src,
+                                    uint16_t *dst,
+                                    int32_t width)
+{
+    int32_t x = 0;
+    const uint8_t *s = src;
+
+    // vector loops load 16 bytes for 8 samples (10 bytes), stop while the
+    // load still lies within the packed row
+#if defined(QCAMERA_UNPACK_SSSE3)
+    const __m128i hiIdx = _mm_setr_epi8(0, -1, 1, -1, 2, -1, 3, -1,
+                                        5, -1, 6, -1, 7, -1, 8, -1);
+    const __m128i loIdx = _mm_setr_epi8(4, -1, 4, -1, 4, -1, 4, -1,
+                                        9, -1, 9, -1, 9, -1, 9, -1);
+    // move the pair of sample i to bits 6..7 of its lane
+    const __m128i loMul = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+    const __m128i loMask = _mm_set1_epi16(3);
+    for (; (x + 8) / 4 * 5 + 6 <= (width + 3) / 4 * 5; x += 8, s += 10) {
+        __m128i v = _mm_loadu_si128((const __m128i *)s);
+        __m128i hi = _mm_slli_epi16(_mm_shuffle_epi8(v, hiIdx), 2);
+        __m128i lo = _mm_mullo_epi16(_mm_shuffle_epi8(v, loIdx), loMul);
+        lo = _mm_and_si128(_mm_srli_epi16(lo, 6), loMask);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(hi, lo));
+    }
+#elif defined(QCAMERA_UNPACK_NEON)
+    static const uint8_t hiIdxTbl[8] = { 0, 1, 2, 3, 5, 6, 7, 8 };
+    static const uint8_t loIdxTbl[8] = { 4, 4, 4, 4, 9, 9, 9, 9 };
+    static const int8_t loShiftTbl[8] = { 0, -2, -4, -6, 0, -2, -4, -6 };
+    const uint8x8_t hiIdx = vld1_u8(hiIdxTbl);
+    const uint8x8_t loIdx = vld1_u8(loIdxTbl);
+    const int8x8_t loShift = vld1_s8(loShiftTbl);
+    const uint8x8_t loMask = vdup_n_u8(3);
+    for (; (x + 8) / 4 * 5 + 6 <= (width + 3) / 4 * 5; x += 8, s += 10) {
+        uint8x8x2_t v;
+        v.val[0] = vld1_u8(s);
+        v.val[1] = vld1_u8(s + 8);
+        uint8x8_t hi = vtbl2_u8(v, hiIdx);
+        uint8x8_t lo = vand_u8(vshl_u8(vtbl2_u8(v, loIdx), loShift), loMask);
+        vst1q_u16(dst + x, vorrq_u16(vshll_n_u8(hi, 2), vmovl_u8(lo)));
+    }
+#endif
+    for (; x + 4 <= width; x += 4, s += 5) {
+        uint8_t lo = s[4];
+        dst[x]     = (uint16_t)((s[0] << 2) | (lo & 3));
+        dst[x + 1] = (uint16_t)((s[1] << 2) | ((lo >> 2) & 3));
+        dst[x + 2] = (uint16_t)((s[2] << 2) | ((lo >> 4) & 3));
+        dst[x + 3] = (uint16_t)((s[3] << 2) | (lo >> 6));
+    }
+    for (int32_t i = 0; x < width; x++, i++) {
+        dst[x] = (uint16_t)((s[i] << 2) | ((s[4] >> (2 * i)) & 3));
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackMipi12
+ *
+ * DESCRIPTION: unpack a row of MIPI RAW12 samples. Every 3 bytes hold the
+ *              high 8 bits of 2 samples followed by a byte with their low
+ *              nibbles, first sample in the low nibble.
+ *
+ * PARAMETERS :
+ *   @src     : source row
+ *   @dst     : destination row
+ *   @width   : samples in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraRawUnpack::unpackMipi12(const uint8_t *src,
+                                    uint16_t *dst,
+                                    int32_t width)
+{
+    int32_t x = 0;
+    const uint8_t *s = src;
+
+    // vector loops load 16 bytes for 8 samples (12 bytes)
+#if defined(QCAMERA_UNPACK_SSSE3)
+    const __m128i hiIdx = _mm_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1,
+                                        6, -1, 7, -1, 9, -1, 10, -1);
+    const __m128i loIdx = _mm_setr_epi8(2, -1, 2, -1, 5, -1, 5, -1,
+                                        8, -1, 8, -1, 11, -1, 11, -1);
+    const __m128i loMul = _mm_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1);
+    const __m128i loMask = _mm_set1_epi16(0xF);
+    for (; (x + 8) / 2 * 3 + 4 <= (width + 1) / 2 * 3; x += 8, s += 12) {
+        __m128i v = _mm_loadu_si128((const __m128i *)s);
+        __m128i hi = _mm_slli_epi16(_mm_shuffle_epi8(v, hiIdx), 4);
+        __m128i lo = _mm_mullo_epi16(_mm_shuffle_epi8(v, loIdx), loMul);
+        lo = _mm_and_si128(_mm_srli_epi16(lo, 4), loMask);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(hi, lo));
+    }
+#elif defined(QCAMERA_UNPACK_NEON)
+    static const uint8_t hiIdxTbl[8] = { 0, 1, 3, 4, 6, 7, 9, 10 };
+    static const uint8_t loIdxTbl[8] = { 2, 2, 5, 5, 8, 8, 11, 11 };
+    static const int8_t loShiftTbl[8] = { 0, -4, 0, -4, 0, -4, 0, -4 };
+    const uint8x8_t hiIdx = vld1_u8(hiIdxTbl);
+    const uint8x8_t loIdx = vld1_u8(loIdxTbl);
+    const int8x8_t loShift = vld1_s8(loShiftTbl);
+    const uint8x8_t loMask = vdup_n_u8(0xF);
+    for (; (x + 8) / 2 * 3 + 4 <= (width + 1) / 2 * 3; x += 8, s += 12) {
+        uint8x8x2_t v;
+        v.val[0] = vld1_u8(s);
+        v.val[1] = vld1_u8(s + 8);
+        uint8x8_t hi = vtbl2_u8(v, hiIdx);
+        uint8x8_t lo = vand_u8(vshl_u8(vtbl2_u8(v, loIdx), loShift), loMask);
+        vst1q_u16(dst + x, vorrq_u16(vshll_n_u8(hi, 4), vmovl_u8(lo)));
+    }
+#endif
+    for (; x + 2 <= width; x += 2, s += 3) {
+        dst[x]     = (uint16_t)((s[0] << 4) | (s[2] & 0xF));
+        dst[x + 1] = (uint16_t)((s[1] << 4) | (s[2] >> 4));
+    }
+    if (x < width) {
+        dst[x] = (uint16_t)((s[0] << 4) | (s[2] & 0xF));
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackQcom10
+ *
+ * DESCRIPTION: unpack a row of QCOM packed 10 bit samples, 6 per 64 bit
+ *              little endian word starting at the least significant bits
+ *
+ * PARAMETERS :
+ *   @src     : source row
+ *   @dst     : destination row
+ *   @width   : samples in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraRawUnpack::unpackQcom10(const uint8_t *src,
+                                    uint16_t *dst,
+                                    int32_t width)
+{
+    int32_t x = 0;
+    const uint8_t *s = src;
+
+    for (; x + 6 <= width; x += 6, s += 8) {
+        uint64_t w = load64(s);
+        dst[x]     = (uint16_t)(w & 0x3FF);
+        dst[x + 1] = (uint16_t)((w >> 10) & 0x3FF);
+        dst[x + 2] = (uint16_t)((w >> 20) & 0x3FF);
+        dst[x + 3] = (uint16_t)((w >> 30) & 0x3FF);
+        dst[x + 4] = (uint16_t)((w >> 40) & 0x3FF);
+        dst[x + 5] = (uint16_t)((w >> 50) & 0x3FF);
+    }
+    if (x < width) {
+        uint64_t w = load64(s);
+        for (; x < width; x++, w >>= 10) {
+            dst[x] = (uint16_t)(w & 0x3FF);
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackQcom12
+ *
+ * DESCRIPTION: unpack a row of QCOM packed 12 bit samples, 5 per 64 bit
+ *              little endian word starting at the least significant bits
+ *
+ * PARAMETERS :
+ *   @src     : source row
+ *   @dst     : destination row
+ *   @width   : samples in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraRawUnpack::unpackQcom12(const uint8_t *src,
+                                    uint16_t *dst,
+                                    int32_t width)
+{
+    int32_t x = 0;
+    const uint8_t *s = src;
+
+    for (; x + 5 <= width; x += 5, s += 8) {
+        uint64_t w = load64(s);
+        dst[x]     = (uint16_t)(w & 0xFFF);
+        dst[x + 1] = (uint16_t)((w >> 12) & 0xFFF);
+        dst[x + 2] = (uint16_t)((w >> 24) & 0xFFF);
+        dst[x + 3] = (uint16_t)((w >> 36) & 0xFFF);
+        dst[x + 4] = (uint16_t)((w >> 48) & 0xFFF);
+    }
+    if (x < width) {
+        uint64_t w = load64(s);
+        for (; x < width; x++, w >>= 12) {
+            dst[x] = (uint16_t)(w & 0xFFF);
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : unpackPlain16
+ *
+ * DESCRIPTION: copy a row of 16 bit samples
+ *
+ * PARAMETERS :
+ *   @src     : source row, any alignment
+ *   @dst     : destination row
+ *   @width   : samples in the row
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraRawUnpack::unpackPlain16(const uint8_t *src,
+                                     uint16_t *dst,
+                                     int32_t width)
+{
+    if (width > 0) {
+        memcpy(dst, src, (size_t)width * 2);
+    }
+}
+
+}; // namespace qcamera
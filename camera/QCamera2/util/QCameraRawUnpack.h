@@ -0,0 +1,90 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_RAW_UNPACK_H__
+#define __QCAMERA_RAW_UNPACK_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace qcamera {
+
+typedef enum {
+    QCAMERA_RAW_PACK_PLAIN8,  // one byte per sample (MIPI and QCOM 8 bpp)
+    QCAMERA_RAW_PACK_MIPI10,  // 4 samples in 5 bytes, low bits in 5th byte
+    QCAMERA_RAW_PACK_MIPI12,  // 2 samples in 3 bytes, low bits in 3rd byte
+    QCAMERA_RAW_PACK_QCOM10,  // 6 samples per 64 bit word, first at LSB
+    QCAMERA_RAW_PACK_QCOM12,  // 5 samples per 64 bit word, first at LSB
+    QCAMERA_RAW_PACK_PLAIN16, // one little endian 16 bit word per sample
+    QCAMERA_RAW_PACK_MAX
+} qcamera_raw_packing_t;
+
+typedef enum {
+    QCAMERA_RAW_CFA_RGGB,
+    QCAMERA_RAW_CFA_GRBG,
+    QCAMERA_RAW_CFA_GBRG,
+    QCAMERA_RAW_CFA_BGGR,
+    QCAMERA_RAW_CFA_MAX
+} qcamera_raw_cfa_t;
+
+// Bayer frame as delivered by the raw or snapshot stream
+typedef struct {
+    qcamera_raw_packing_t packing;
+    qcamera_raw_cfa_t cfa;
+    uint32_t bits;            // significant bits per sample
+    int32_t width;
+    int32_t height;
+    const uint8_t *data;      // first row
+    int32_t stride;           // bytes per row
+} qcamera_raw_frame_t;
+
+// Unpacking of sensor raw rows to one right aligned 16 bit sample per
+// pixel. MIPI rows use NEON or SSSE3 table lookups when available, QCOM
+// rows are unpacked a 64 bit word at a time since each word holds whole
+// samples.
+class QCameraRawUnpack {
+public:
+    // bytes a row of width samples occupies
+    static uint32_t getRowBytes(qcamera_raw_packing_t packing, int32_t width);
+    static void unpackRow(qcamera_raw_packing_t packing,
+                          const uint8_t *src,
+                          uint16_t *dst,
+                          int32_t width);
+
+    static void unpackPlain8(const uint8_t *src, uint16_t *dst, int32_t width);
+    static void unpackMipi10(const uint8_t *src, uint16_t *dst, int32_t width);
+    static void unpackMipi12(const uint8_t *src, uint16_t *dst, int32_t width);
+    static void unpackQcom10(const uint8_t *src, uint16_t *dst, int32_t width);
+    static void unpackQcom12(const uint8_t *src, uint16_t *dst, int32_t width);
+    static void unpackPlain16(const uint8_t *src, uint16_t *dst, int32_t width);
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_RAW_UNPACK_H__ */
@@ -0,0 +1,484 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <utils/Errors.h>
+#include <stdlib.h>
+#include <string.h>
+#include "QCameraScaler.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define QCAMERA_SCALE_SSE2
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define QCAMERA_SCALE_NEON
+#endif
+
+using namespace android;
+
+namespace qcamera {
+
+#define QCAMERA_ALIGN16(x) (((x) + 15) & ~15)
+#define QCAMERA_SCALE_ONE  (1 << QCAMERA_SCALE_FRAC_BITS)
+
+/*===========================================================================
+ * FUNCTION   : getSamplePos
+ *
+ * DESCRIPTION: map a destination sample to the source sample on its left
+ *              (or above) and the bilinear weight of the next one, with
+ *              pixel centers aligned
+ *
+ * PARAMETERS :
+ *   @i       : destination index
+ *   @srcLen  : source length in samples
+ *   @dstLen  : destination length in samples
+ *   @pos     : [output] source index
+ *   @weight  : [output] weight of pos + 1, QCAMERA_SCALE_FRAC_BITS
+ *
+ * RETURN     : None
+ *==========================================================================*/
+static inline void getSamplePos(int32_t i, int32_t srcLen, int32_t dstLen,
+                                int32_t &pos, uint32_t &weight)
+{
+    // 16.16 source position of the destination center, minus half a pixel
+    int64_t p = (((int64_t)(2 * i + 1) * srcLen) << 16) / (2 * dstLen) - 32768;
+    if (p < 0) {
+        p = 0;
+    }
+    pos = (int32_t)(p >> 16);
+    weight = (uint32_t)(p >> (16 - QCAMERA_SCALE_FRAC_BITS)) &
+        (QCAMERA_SCALE_ONE - 1);
+    if (pos >= srcLen - 1) {
+        pos = srcLen - 1;
+        weight = 0;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : getBoxFactor
+ *
+ * DESCRIPTION: largest integer box factor that keeps the intermediate image
+ *              at least as large as the destination in both directions
+ *
+ * PARAMETERS :
+ *   @srcW    : source width in samples
+ *   @srcH    : source height in rows
+ *   @dstW    : destination width in samples
+ *   @dstH    : destination height in rows
+ *
+ * RETURN     : box factor, 1 when no box step is needed
+ *==========================================================================*/
+int32_t QCameraScaler::getBoxFactor(int32_t srcW, int32_t srcH,
+                                    int32_t dstW, int32_t dstH)
+{
+    if (dstW <= 0 || dstH <= 0) {
+        return 1;
+    }
+    int32_t fx = srcW / dstW;
+    int32_t fy = srcH / dstH;
+    int32_t factor = (fx < fy) ? fx : fy;
+    if (factor < 1) {
+        factor = 1;
+    } else if (factor > QCAMERA_SCALE_BOX_MAX) {
+        factor = QCAMERA_SCALE_BOX_MAX;
+    }
+    return factor;
+}
+
+/*===========================================================================
+ * FUNCTION   : accumulateRow
+ *
+ * DESCRIPTION: add a row of 8 bit samples to a row of 16 bit sums
+ *
+ * PARAMETERS :
+ *   @acc     : sums
+ *   @src     : samples
+ *   @len     : number of samples
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraScaler::accumulateRow(uint16_t *acc, const uint8_t *src, int32_t len)
+{
+    int32_t i = 0;
+#if defined(QCAMERA_SCALE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(acc + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(acc + i + 8));
+        a0 = _mm_add_epi16(a0, _mm_unpacklo_epi8(v, zero));
+        a1 = _mm_add_epi16(a1, _mm_unpackhi_epi8(v, zero));
+        _mm_storeu_si128((__m128i *)(acc + i), a0);
+        _mm_storeu_si128((__m128i *)(acc + i + 8), a1);
+    }
+#elif defined(QCAMERA_SCALE_NEON)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        vst1q_u16(acc + i, vaddw_u8(vld1q_u16(acc + i), vget_low_u8(v)));
+        vst1q_u16(acc + i + 8, vaddw_u8(vld1q_u16(acc + i + 8), vget_high_u8(v)));
+    }
+#endif
+    for (; i < len; i++) {
+        acc[i] = (uint16_t)(acc[i] + src[i]);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : blendRows
+ *
+ * DESCRIPTION: vertical bilinear step, weighted average of two rows
+ *
+ * PARAMETERS :
+ *   @dst     : output row
+ *   @a       : upper row
+ *   @b       : lower row
+ *   @len     : number of samples
+ *   @w       : weight of b, QCAMERA_SCALE_FRAC_BITS
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraScaler::blendRows(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                              int32_t len, uint32_t w)
+{
+    uint32_t wa = QCAMERA_SCALE_ONE - w;
+    int32_t i = 0;
+#if defined(QCAMERA_SCALE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i va = _mm_set1_epi16((short)wa);
+    const __m128i vb = _mm_set1_epi16((short)w);
+    const __m128i half = _mm_set1_epi16(QCAMERA_SCALE_ONE / 2);
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i lo = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), va),
+            _mm_mullo_epi16(_mm_unpacklo_epi8(y, zero), vb));
+        __m128i hi = _mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), va),
+            _mm_mullo_epi16(_mm_unpackhi_epi8(y, zero), vb));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, half), QCAMERA_SCALE_FRAC_BITS);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, half), QCAMERA_SCALE_FRAC_BITS);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(QCAMERA_SCALE_NEON)
+    const uint8x8_t va = vdup_n_u8((uint8_t)wa);
+    const uint8x8_t vb = vdup_n_u8((uint8_t)w);
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t x = vld1q_u8(a + i);
+        uint8x16_t y = vld1q_u8(b + i);
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(x), va), vget_low_u8(y), vb);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(x), va), vget_high_u8(y), vb);
+        vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, QCAMERA_SCALE_FRAC_BITS),
+                                      vrshrn_n_u16(hi, QCAMERA_SCALE_FRAC_BITS)));
+    }
+#endif
+    for (; i < len; i++) {
+        dst[i] = (uint8_t)((a[i] * wa + b[i] * w + QCAMERA_SCALE_ONE / 2) >>
+                           QCAMERA_SCALE_FRAC_BITS);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : boxRow
+ *
+ * DESCRIPTION: horizontal box step, averages factor adjacent column sums
+ *              of each channel into one sample
+ *
+ * PARAMETERS :
+ *   @acc      : column sums of factor source rows
+ *   @dst      : output row
+ *   @dstW     : output width in pixels
+ *   @channels : interleaved samples per pixel
+ *   @factor   : box factor
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraScaler::boxRow(const uint16_t *acc, uint8_t *dst, int32_t dstW,
+                           int32_t channels, int32_t factor)
+{
+    // sums stay below 2^20 and the error of the reciprocal below 2^12,
+    // so the multiply gives the exact rounded quotient
+    uint32_t area = (uint32_t)(factor * factor);
+    uint64_t recip = ((1ULL << 32) + area - 1) / area;
+    for (int32_t x = 0; x < dstW; x++) {
+        const uint16_t *s = acc + x * factor * channels;
+        for (int32_t c = 0; c < channels; c++) {
+            uint32_t sum = area / 2;
+            for (int32_t t = 0; t < factor; t++) {
+                sum += s[t * channels + c];
+            }
+            dst[x * channels + c] = (uint8_t)((sum * recip) >> 32);
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : getScratchSize
+ *
+ * DESCRIPTION: scratch memory needed by scalePlane
+ *
+ * PARAMETERS :
+ *   @srcW     : source width in pixels
+ *   @dstW     : destination width in pixels
+ *   @channels : interleaved samples per pixel
+ *
+ * RETURN     : size in bytes
+ *==========================================================================*/
+size_t QCameraScaler::getScratchSize(int32_t srcW, int32_t dstW, int32_t channels)
+{
+    size_t len = QCAMERA_ALIGN16((size_t)srcW * channels);
+    // column sums, two box filtered rows, the blended row and x positions
+    return len * sizeof(uint16_t) + len * 3 +
+        QCAMERA_ALIGN16((size_t)dstW * (sizeof(int32_t) * 2 + sizeof(uint32_t)));
+}
+
+// rows of the box filtered image kept for the bilinear step
+typedef struct {
+    const uint8_t *src;
+    int32_t srcStride;
+    uint16_t *acc;
+    int32_t accLen;
+    int32_t boxW;
+    int32_t channels;
+    int32_t factor;
+    uint8_t *slot[2];
+    const uint8_t *row[2];
+    int32_t idx[2];
+} qcamera_box_rows_t;
+
+/*===========================================================================
+ * FUNCTION   : getBoxRow
+ *
+ * DESCRIPTION: get a row of the box filtered image, making it if it is not
+ *              one of the two kept. Rows are asked for in increasing order,
+ *              so the lowest kept row other than keep is replaced.
+ *
+ * PARAMETERS :
+ *   @rows    : kept rows
+ *   @idx     : wanted row
+ *   @keep    : row that must stay kept, -1 for none
+ *
+ * RETURN     : the row
+ *==========================================================================*/
+static const uint8_t *getBoxRow(qcamera_box_rows_t &rows, int32_t idx,
+                                int32_t keep)
+{
+    for (int32_t k = 0; k < 2; k++) {
+        if (rows.idx[k] == idx) {
+            return rows.row[k];
+        }
+    }
+    int32_t s;
+    if (rows.idx[0] == keep) {
+        s = 1;
+    } else if (rows.idx[1] == keep) {
+        s = 0;
+    } else {
+        s = (rows.idx[0] <= rows.idx[1]) ? 0 : 1;
+    }
+
+    rows.idx[s] = idx;
+    if (rows.factor == 1) {
+        rows.row[s] = rows.src + (size_t)idx * rows.srcStride;
+        return rows.row[s];
+    }
+    memset(rows.acc, 0, rows.accLen * sizeof(uint16_t));
+    const uint8_t *src = rows.src + (size_t)idx * rows.factor * rows.srcStride;
+    for (int32_t t = 0; t < rows.factor; t++, src += rows.srcStride) {
+        QCameraScaler::accumulateRow(rows.acc, src, rows.accLen);
+    }
+    QCameraScaler::boxRow(rows.acc, rows.slot[s], rows.boxW,
+                          rows.channels, rows.factor);
+    rows.row[s] = rows.slot[s];
+    return rows.row[s];
+}
+
+/*===========================================================================
+ * FUNCTION   : scalePlane
+ *
+ * DESCRIPTION: scale one plane. Rows of the box filtered image are made on
+ *              demand while walking the output rows, and the two most
+ *              recent ones are kept for the bilinear step.
+ *
+ * PARAMETERS :
+ *   @src       : first sample of the source window
+ *   @srcStride : source stride in bytes
+ *   @srcW      : source width in pixels
+ *   @srcH      : source height in rows
+ *   @dst       : destination plane
+ *   @dstStride : destination stride in bytes
+ *   @dstW      : destination width in pixels
+ *   @dstH      : destination height in rows
+ *   @channels  : interleaved samples per pixel
+ *   @scratch   : getScratchSize bytes, 16 byte aligned
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraScaler::scalePlane(const uint8_t *src, int32_t srcStride,
+                               int32_t srcW, int32_t srcH,
+                               uint8_t *dst, int32_t dstStride,
+                               int32_t dstW, int32_t dstH,
+                               int32_t channels, uint8_t *scratch)
+{
+    int32_t factor = getBoxFactor(srcW, srcH, dstW, dstH);
+    int32_t boxW = srcW / factor;
+    int32_t boxH = srcH / factor;
+    int32_t boxLen = boxW * channels;
+    int32_t accLen = boxLen * factor;
+
+    // center the box filtered area when the window does not divide evenly
+    src += ((srcH - boxH * factor) / 2) * srcStride +
+        ((srcW - boxW * factor) / 2) * channels;
+
+    size_t len = QCAMERA_ALIGN16((size_t)srcW * channels);
+    uint16_t *acc = (uint16_t *)scratch;
+    uint8_t *slot[2];
+    slot[0] = scratch + len * sizeof(uint16_t);
+    slot[1] = slot[0] + len;
+    uint8_t *blend = slot[1] + len;
+    int32_t *x0 = (int32_t *)(blend + len);
+    int32_t *x1 = x0 + dstW;
+    uint32_t *wx = (uint32_t *)(x1 + dstW);
+
+    for (int32_t x = 0; x < dstW; x++) {
+        getSamplePos(x, boxW, dstW, x0[x], wx[x]);
+        x1[x] = (x0[x] + 1 < boxW) ? x0[x] + 1 : x0[x];
+        x0[x] *= channels;
+        x1[x] *= channels;
+    }
+
+    qcamera_box_rows_t rows;
+    rows.src = src;
+    rows.srcStride = srcStride;
+    rows.acc = acc;
+    rows.accLen = accLen;
+    rows.boxW = boxW;
+    rows.channels = channels;
+    rows.factor = factor;
+    for (int32_t k = 0; k < 2; k++) {
+        rows.slot[k] = slot[k];
+        rows.row[k] = NULL;
+        rows.idx[k] = -1;
+    }
+
+    for (int32_t y = 0; y < dstH; y++) {
+        int32_t y0;
+        uint32_t wy;
+        getSamplePos(y, boxH, dstH, y0, wy);
+        const uint8_t *line = getBoxRow(rows, y0, -1);
+        if (wy != 0) {
+            const uint8_t *next = getBoxRow(rows, y0 + 1, y0);
+            blendRows(blend, line, next, boxLen, wy);
+            line = blend;
+        }
+
+        uint8_t *d = dst + (size_t)y * dstStride;
+        if (channels == 1) {
+            for (int32_t x = 0; x < dstW; x++) {
+                uint32_t w = wx[x];
+                d[x] = (uint8_t)((line[x0[x]] * (QCAMERA_SCALE_ONE - w) +
+                                  line[x1[x]] * w + QCAMERA_SCALE_ONE / 2) >>
+                                 QCAMERA_SCALE_FRAC_BITS);
+            }
+        } else {
+            for (int32_t x = 0; x < dstW; x++) {
+                uint32_t w = wx[x];
+                uint32_t wa = QCAMERA_SCALE_ONE - w;
+                const uint8_t *a = line + x0[x];
+                const uint8_t *b = line + x1[x];
+                for (int32_t c = 0; c < channels; c++) {
+                    d[x * channels + c] = (uint8_t)((a[c] * wa + b[c] * w +
+                        QCAMERA_SCALE_ONE / 2) >> QCAMERA_SCALE_FRAC_BITS);
+                }
+            }
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : downscale
+ *
+ * DESCRIPTION: scale a crop window of a semi-planar 4:2:0 frame into
+ *              another frame of the same format
+ *
+ * PARAMETERS :
+ *   @src     : source frame
+ *   @cropX   : left of the window, even
+ *   @cropY   : top of the window, even
+ *   @cropW   : window width, even
+ *   @cropH   : window height, even
+ *   @dst     : destination frame, filled completely
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraScaler::downscale(const qcamera_pix_frame_t &src,
+                                 int32_t cropX, int32_t cropY,
+                                 int32_t cropW, int32_t cropH,
+                                 const qcamera_pix_frame_t &dst)
+{
+    if ((src.fmt != QCAMERA_PIX_FMT_NV21 && src.fmt != QCAMERA_PIX_FMT_NV12) ||
+        dst.fmt != src.fmt) {
+        return BAD_VALUE;
+    }
+    if (cropX < 0 || cropY < 0 || cropW < 2 || cropH < 2 ||
+        cropX + cropW > src.width || cropY + cropH > src.height ||
+        ((cropX | cropY | cropW | cropH) & 1) != 0 ||
+        dst.width < 2 || dst.height < 2 ||
+        ((dst.width | dst.height) & 1) != 0 ||
+        src.plane[0] == NULL || src.plane[1] == NULL ||
+        dst.plane[0] == NULL || dst.plane[1] == NULL) {
+        return BAD_VALUE;
+    }
+
+    size_t size = getScratchSize(cropW, dst.width, 1);
+    size_t chromaSize = getScratchSize(cropW / 2, dst.width / 2, 2);
+    if (chromaSize > size) {
+        size = chromaSize;
+    }
+    uint8_t *scratch = (uint8_t *)malloc(size);
+    if (scratch == NULL) {
+        return NO_MEMORY;
+    }
+
+    scalePlane(src.plane[0] + (size_t)cropY * src.stride[0] + cropX,
+               src.stride[0], cropW, cropH,
+               dst.plane[0], dst.stride[0], dst.width, dst.height,
+               1, scratch);
+    scalePlane(src.plane[1] + (size_t)(cropY / 2) * src.stride[1] + cropX,
+               src.stride[1], cropW / 2, cropH / 2,
+               dst.plane[1], dst.stride[1], dst.width / 2, dst.height / 2,
+               2, scratch);
+
+    free(scratch);
+    return NO_ERROR;
+}
+
+}; // namespace qcamera
@@ -0,0 +1,85 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_SCALER_H__
+#define __QCAMERA_SCALER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "QCameraFormatConvert.h"
+
+namespace qcamera {
+
+// fraction bits of the bilinear weights
+#define QCAMERA_SCALE_FRAC_BITS 7
+// largest box filter factor, keeps the column sums of a box in 16 bits
+#define QCAMERA_SCALE_BOX_MAX   64
+
+// Downscaler for 8 bit semi-planar 4:2:0 frames, used to derive small
+// images such as the jpeg thumbnail from a full size frame. Each plane is
+// reduced in two steps: an integer box filter brings the crop window down
+// to between one and two times the target size, then a bilinear pass
+// lands on the exact size. The box step streams the source once, a
+// source row at a time, so only a few rows of scratch memory are needed.
+// Row kernels use NEON or SSE2 when available and plain C otherwise.
+class QCameraScaler {
+public:
+    // scales the crop window of src into all of dst. Both frames must be
+    // NV21 or NV12 of the same kind, the crop origin and all sizes even.
+    static int32_t downscale(const qcamera_pix_frame_t &src,
+                             int32_t cropX, int32_t cropY,
+                             int32_t cropW, int32_t cropH,
+                             const qcamera_pix_frame_t &dst);
+    // box filter factor used for a plane of srcW x srcH scaled to dstW x dstH
+    static int32_t getBoxFactor(int32_t srcW, int32_t srcH,
+                                int32_t dstW, int32_t dstH);
+
+    // kernels. Lengths are in bytes, interleaved chroma counts twice.
+    // acc[i] += src[i]
+    static void accumulateRow(uint16_t *acc, const uint8_t *src, int32_t len);
+    // dst[i] = (a[i] * (1 - w) + b[i] * w), w in QCAMERA_SCALE_FRAC_BITS
+    static void blendRows(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                          int32_t len, uint32_t w);
+    // averages factor adjacent column sums of each channel of acc, the sums
+    // of factor rows, into dstW pixels of dst
+    static void boxRow(const uint16_t *acc, uint8_t *dst, int32_t dstW,
+                       int32_t channels, int32_t factor);
+
+private:
+    static void scalePlane(const uint8_t *src, int32_t srcStride,
+                           int32_t srcW, int32_t srcH,
+                           uint8_t *dst, int32_t dstStride,
+                           int32_t dstW, int32_t dstH,
+                           int32_t channels, uint8_t *scratch);
+    static size_t getScratchSize(int32_t srcW, int32_t dstW, int32_t channels);
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_SCALER_H__ */
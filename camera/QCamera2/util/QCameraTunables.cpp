@@ -0,0 +1,250 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#define LOG_TAG "QCameraTunables"
+
+#include <utils/Errors.h>
+#include <utils/Log.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cutils/properties.h>
+#include "QCameraTunables.h"
+
+namespace qcamera {
+
+typedef struct {
+    const char *name;       // system property name
+    int32_t defValue;       // value used if property is not set
+} qcamera_tunable_desc_t;
+
+static const qcamera_tunable_desc_t g_tunableDesc[QCAMERA_TUNABLE_MAX] = {
+    { "persist.camera.dumpimg",            0 },
+    { "persist.camera.mem.usecache",       1 },
+    { "persist.camera.mem.pool.budget",    QCAMERA_TUNABLE_UNSET },
+    { "persist.camera.cb.maxpending",      QCAMERA_TUNABLE_UNSET },
+    { "persist.camera.jpeg.inflight",      QCAMERA_TUNABLE_UNSET },
+    { "persist.camera.feature.cac",        0 },
+    { "persist.debug.sf.showfps",          0 },
+    { "persist.camera.opt.livepic",        1 },
+    { "persist.camera.zsl.interval",       1 },
+    { "persist.camera.zsl.backlookcnt",    2 },
+    { "persist.camera.zsl.queuedepth",     2 },
+    { "persist.denoise.process.plates",    0 },
+    { "persist.camera.snap.format",        0 },
+    { "persist.camera.snapshot.number",    0 },
+    { "persist.camera.tunables.refresh_ms", QCAMERA_TUNABLES_REFRESH_MS_DEFAULT },
+    { "persist.camera.mfnr.frames",        0 },
+    { "persist.camera.mfnr.iso",           800 },
+    { "persist.camera.preview.cbconvert",  1 },
+    { "persist.camera.raw.dng",            0 },
+    { "persist.camera.thumb.sw",           0 },
+    { "persist.camera.hfr.batch",          1 },
+    { "persist.camera.stats.lscmap.ds",    1 },
+    { "persist.camera.jpeg.swenc",         0 },
+};
+
+/*===========================================================================
+ * FUNCTION   : getInstance
+ *
+ * DESCRIPTION: get the process wide tunables registry
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : ptr to tunables registry
+ *==========================================================================*/
+QCameraTunables *QCameraTunables::getInstance()
+{
+    static QCameraTunables instance;
+    return &instance;
+}
+
+/*===========================================================================
+ * FUNCTION   : QCameraTunables
+ *
+ * DESCRIPTION: constructor of QCameraTunables, takes the first snapshot
+ *              of all tunable properties
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraTunables::QCameraTunables()
+    : mRefreshTid(0),
+      mUsers(0),
+      mRefreshExit(false)
+{
+    pthread_mutex_init(&mLock, NULL);
+    pthread_cond_init(&mCond, NULL);
+    refresh();
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraTunables
+ *
+ * DESCRIPTION: deconstructor of QCameraTunables
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraTunables::~QCameraTunables()
+{
+    pthread_cond_destroy(&mCond);
+    pthread_mutex_destroy(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : refresh
+ *
+ * DESCRIPTION: re-read all tunable properties
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraTunables::refresh()
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    for (int i = 0; i < QCAMERA_TUNABLE_MAX; i++) {
+        int32_t val = g_tunableDesc[i].defValue;
+        memset(value, 0, sizeof(value));
+        if (property_get(g_tunableDesc[i].name, value, "") > 0) {
+            val = atoi(value);
+        }
+        android_atomic_release_store(val, &mValues[i]);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : start
+ *
+ * DESCRIPTION: refresh tunables and launch the periodic refresh thread if
+ *              this is the first user. Called when a camera is opened.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraTunables::start()
+{
+    int32_t rc = NO_ERROR;
+
+    refresh();
+
+    pthread_mutex_lock(&mLock);
+    if (mUsers == 0 && get(QCAMERA_TUNABLE_REFRESH_MS) > 0) {
+        mRefreshExit = false;
+        if (pthread_create(&mRefreshTid, NULL, refreshRoutine, this) != 0) {
+            ALOGE("%s: failed to launch refresh thread", __func__);
+            mRefreshTid = 0;
+            rc = UNKNOWN_ERROR;
+        }
+    }
+    if (rc == NO_ERROR) {
+        mUsers++;
+    }
+    pthread_mutex_unlock(&mLock);
+
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : stop
+ *
+ * DESCRIPTION: stop the periodic refresh thread once the last user is gone.
+ *              Called when a camera is closed.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraTunables::stop()
+{
+    pthread_t tid = 0;
+
+    pthread_mutex_lock(&mLock);
+    if (mUsers > 0 && --mUsers == 0 && mRefreshTid != 0) {
+        mRefreshExit = true;
+        pthread_cond_signal(&mCond);
+        tid = mRefreshTid;
+        mRefreshTid = 0;
+    }
+    pthread_mutex_unlock(&mLock);
+
+    if (tid != 0) {
+        pthread_join(tid, NULL);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : refreshRoutine
+ *
+ * DESCRIPTION: thread routine re-reading tunables every refresh_ms until
+ *              stopped
+ *
+ * PARAMETERS :
+ *   @data    : user data ptr (QCameraTunables)
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void *QCameraTunables::refreshRoutine(void *data)
+{
+    QCameraTunables *pme = (QCameraTunables *)data;
+    struct timespec ts;
+
+    pthread_mutex_lock(&pme->mLock);
+    while (!pme->mRefreshExit) {
+        int32_t periodMs = pme->get(QCAMERA_TUNABLE_REFRESH_MS);
+        if (periodMs <= 0) {
+            periodMs = QCAMERA_TUNABLES_REFRESH_MS_DEFAULT;
+        }
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += periodMs / 1000;
+        ts.tv_nsec += (long)(periodMs % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&pme->mCond, &pme->mLock, &ts);
+        if (!pme->mRefreshExit) {
+            pthread_mutex_unlock(&pme->mLock);
+            pme->refresh();
+            pthread_mutex_lock(&pme->mLock);
+        }
+    }
+    pthread_mutex_unlock(&pme->mLock);
+
+    return NULL;
+}
+
+}; // namespace qcamera
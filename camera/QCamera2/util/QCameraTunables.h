@@ -0,0 +1,108 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_TUNABLES_H__
+#define __QCAMERA_TUNABLES_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <cutils/atomic.h>
+
+namespace qcamera {
+
+// value of a tunable whose property is not set and has no default
+#define QCAMERA_TUNABLE_UNSET (-1)
+
+// default period of re-reading tunable properties while camera is open
+#define QCAMERA_TUNABLES_REFRESH_MS_DEFAULT 1000
+
+typedef enum {
+    QCAMERA_TUNABLE_DUMP_IMG,           // persist.camera.dumpimg
+    QCAMERA_TUNABLE_MEM_USE_CACHE,      // persist.camera.mem.usecache
+    QCAMERA_TUNABLE_MEM_POOL_BUDGET,    // persist.camera.mem.pool.budget
+    QCAMERA_TUNABLE_CB_MAX_PENDING,     // persist.camera.cb.maxpending
+    QCAMERA_TUNABLE_JPEG_INFLIGHT,      // persist.camera.jpeg.inflight
+    QCAMERA_TUNABLE_FEATURE_CAC,        // persist.camera.feature.cac
+    QCAMERA_TUNABLE_SHOW_FPS,           // persist.debug.sf.showfps
+    QCAMERA_TUNABLE_OPT_LIVEPIC,        // persist.camera.opt.livepic
+    QCAMERA_TUNABLE_ZSL_INTERVAL,       // persist.camera.zsl.interval
+    QCAMERA_TUNABLE_ZSL_BACKLOOKCNT,    // persist.camera.zsl.backlookcnt
+    QCAMERA_TUNABLE_ZSL_QUEUEDEPTH,     // persist.camera.zsl.queuedepth
+    QCAMERA_TUNABLE_DENOISE_PLATES,     // persist.denoise.process.plates
+    QCAMERA_TUNABLE_SNAP_FORMAT,        // persist.camera.snap.format
+    QCAMERA_TUNABLE_SNAPSHOT_NUMBER,    // persist.camera.snapshot.number
+    QCAMERA_TUNABLE_REFRESH_MS,         // persist.camera.tunables.refresh_ms
+    QCAMERA_TUNABLE_MFNR_FRAMES,        // persist.camera.mfnr.frames
+    QCAMERA_TUNABLE_MFNR_ISO,           // persist.camera.mfnr.iso
+    QCAMERA_TUNABLE_PREVIEW_CB_CONVERT, // persist.camera.preview.cbconvert
+    QCAMERA_TUNABLE_RAW_DNG,            // persist.camera.raw.dng
+    QCAMERA_TUNABLE_THUMB_SW,           // persist.camera.thumb.sw
+    QCAMERA_TUNABLE_HFR_BATCH,          // persist.camera.hfr.batch
+    QCAMERA_TUNABLE_LSC_MAP_DS,         // persist.camera.stats.lscmap.ds
+    QCAMERA_TUNABLE_JPEG_SWENC,         // persist.camera.jpeg.swenc
+    QCAMERA_TUNABLE_MAX
+} qcamera_tunable_t;
+
+// Snapshot of camera debug/perf system properties. All properties are read
+// once when the registry is created and refreshed on request or by a low
+// rate timer while a camera is open, so that hot paths only do an atomic
+// load instead of a property lookup.
+class QCameraTunables {
+public:
+    static QCameraTunables *getInstance();
+
+    // cached value, its default if not set, or QCAMERA_TUNABLE_UNSET
+    inline int32_t get(qcamera_tunable_t id) {
+        return android_atomic_acquire_load(&mValues[id]);
+    };
+    inline bool isSet(qcamera_tunable_t id) {
+        return get(id) != QCAMERA_TUNABLE_UNSET;
+    };
+
+    void refresh();
+    int32_t start();
+    void stop();
+
+private:
+    QCameraTunables();
+    virtual ~QCameraTunables();
+    static void *refreshRoutine(void *data);
+
+    volatile int32_t mValues[QCAMERA_TUNABLE_MAX];
+
+    pthread_mutex_t mLock;
+    pthread_cond_t mCond;
+    pthread_t mRefreshTid;
+    int32_t mUsers;          // number of opened cameras using the timer
+    bool mRefreshExit;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_TUNABLES_H__ */
@@ -0,0 +1,113 @@
+LOCAL_PATH:= $(call my-dir)
+
+# ------------------------------------------------------------------------------
+#     Preview callback format conversion benchmark (target and host)
+# ------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_format_convert_bench.cpp \
+    ../QCameraFormatConvert.cpp
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_SHARED_LIBRARIES:= libutils
+
+LOCAL_MODULE:= qcamera-format-convert-bench
+LOCAL_MODULE_TAGS:= optional
+
+LOCAL_CFLAGS += -Wall -Werror -O2
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_format_convert_bench.cpp \
+    ../QCameraFormatConvert.cpp
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_MODULE:= qcamera-format-convert-bench
+LOCAL_MODULE_TAGS:= optional
+
+LOCAL_CFLAGS += -Wall -Werror -O2
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# ------------------------------------------------------------------------------
+#     Raw unpack and DNG writer benchmark (target and host)
+# ------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_raw_unpack_bench.cpp \
+    ../QCameraRawUnpack.cpp \
+    ../QCameraDngWriter.cpp
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_SHARED_LIBRARIES:= libutils
+
+LOCAL_MODULE:= qcamera-raw-unpack-bench
+LOCAL_MODULE_TAGS:= optional
+
+LOCAL_CFLAGS += -Wall -Werror -O2
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_raw_unpack_bench.cpp \
+    ../QCameraRawUnpack.cpp \
+    ../QCameraDngWriter.cpp
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_MODULE:= qcamera-raw-unpack-bench
+LOCAL_MODULE_TAGS:= optional
+
+LOCAL_CFLAGS += -Wall -Werror -O2
+LOCAL_CFLAGS_x86 += -mssse3
+LOCAL_CFLAGS_x86_64 += -mssse3
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# ------------------------------------------------------------------------------
+#     Thumbnail downscaler benchmark (target and host)
+# ------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_scaler_bench.cpp \
+    ../QCameraScaler.cpp
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_SHARED_LIBRARIES:= libutils
+
+LOCAL_MODULE:= qcamera-scaler-bench
+LOCAL_MODULE_TAGS:= optional
+
+LOCAL_CFLAGS += -Wall -Werror -O2
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_scaler_bench.cpp \
+    ../QCameraScaler.cpp
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+
+LOCAL_MODULE:= qcamera-scaler-bench
+LOCAL_MODULE_TAGS:= optional
+
+LOCAL_CFLAGS += -Wall -Werror -O2
+
+include $(BUILD_HOST_EXECUTABLE)
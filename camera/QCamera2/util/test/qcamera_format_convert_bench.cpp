@@ -0,0 +1,244 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+// Throughput of the preview callback conversions. Each case converts a
+// padded frame, as laid out by the preview stream, to the packed layout
+// delivered to apps, checks every sample against a plain C reference and
+// reports the time per frame.
+
+#include <utils/Errors.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "QCameraFormatConvert.h"
+
+using namespace qcamera;
+
+typedef struct {
+    const char *name;
+    qcamera_pix_fmt_t src;
+    qcamera_pix_fmt_t dst;
+} bench_case_t;
+
+static const bench_case_t g_cases[] = {
+    { "nv21 depad",   QCAMERA_PIX_FMT_NV21, QCAMERA_PIX_FMT_NV21 },
+    { "nv21->nv12",   QCAMERA_PIX_FMT_NV21, QCAMERA_PIX_FMT_NV12 },
+    { "nv12->nv21",   QCAMERA_PIX_FMT_NV12, QCAMERA_PIX_FMT_NV21 },
+    { "nv21->yv12",   QCAMERA_PIX_FMT_NV21, QCAMERA_PIX_FMT_YV12 },
+    { "nv12->yv12",   QCAMERA_PIX_FMT_NV12, QCAMERA_PIX_FMT_YV12 },
+    { "yv12 depad",   QCAMERA_PIX_FMT_YV12, QCAMERA_PIX_FMT_YV12 },
+    { "yuyv depad",   QCAMERA_PIX_FMT_YUYV, QCAMERA_PIX_FMT_YUYV },
+    { "yuyv->nv21",   QCAMERA_PIX_FMT_YUYV, QCAMERA_PIX_FMT_NV21 },
+    { "yvyu->nv21",   QCAMERA_PIX_FMT_YVYU, QCAMERA_PIX_FMT_NV21 },
+    { "uyvy->nv21",   QCAMERA_PIX_FMT_UYVY, QCAMERA_PIX_FMT_NV21 },
+    { "vyuy->nv12",   QCAMERA_PIX_FMT_VYUY, QCAMERA_PIX_FMT_NV12 },
+};
+
+static double nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// lays out a frame the way the preview stream does, with pad bytes added
+// to every stride and a few spare rows after each plane
+static uint8_t *allocPadded(qcamera_pix_fmt_t fmt, int w, int h, int pad,
+                            qcamera_pix_frame_t &frame)
+{
+    size_t size;
+    int rows = h + 8;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.fmt = fmt;
+    frame.width = w;
+    frame.height = h;
+    if (fmt == QCAMERA_PIX_FMT_NV21 || fmt == QCAMERA_PIX_FMT_NV12) {
+        frame.stride[0] = frame.stride[1] = w + pad;
+        size = (size_t)frame.stride[0] * rows * 2;
+    } else if (fmt == QCAMERA_PIX_FMT_YV12) {
+        frame.stride[0] = w + pad;
+        frame.stride[1] = frame.stride[2] = w / 2 + pad;
+        size = (size_t)frame.stride[0] * rows * 2;
+    } else {
+        frame.stride[0] = w * 2 + pad;
+        size = (size_t)frame.stride[0] * rows;
+    }
+
+    uint8_t *buf = (uint8_t *)malloc(size);
+    if (buf == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t)(rand() >> 7);
+    }
+    frame.plane[0] = buf;
+    frame.plane[1] = buf + frame.stride[0] * rows;
+    frame.plane[2] = frame.plane[1] + frame.stride[1] * (rows / 2);
+    return buf;
+}
+
+// sample of plane 0 (Y), 1 (Cb) or 2 (Cr) on the 4:2:0 grid. Chroma of
+// packed frames is the rounded mean of the two rows.
+static int sample(const qcamera_pix_frame_t &f, int x, int y, int plane)
+{
+    switch (f.fmt) {
+    case QCAMERA_PIX_FMT_NV21:
+    case QCAMERA_PIX_FMT_NV12:
+        if (plane == 0) {
+            return f.plane[0][y * f.stride[0] + x];
+        } else {
+            bool cr = (plane == 2);
+            int off = (cr == (f.fmt == QCAMERA_PIX_FMT_NV21)) ? 0 : 1;
+            return f.plane[1][y * f.stride[1] + 2 * x + off];
+        }
+    case QCAMERA_PIX_FMT_YV12:
+        if (plane == 0) {
+            return f.plane[0][y * f.stride[0] + x];
+        }
+        return (plane == 2) ? f.plane[1][y * f.stride[1] + x] :
+            f.plane[2][y * f.stride[2] + x];
+    default: {
+        // byte offsets of Y0, Cb and Cr in a 4 byte group
+        static const int offs[4][3] = {
+            { 0, 1, 3 }, { 0, 3, 1 }, { 1, 0, 2 }, { 1, 2, 0 } };
+        const int *o = offs[f.fmt - QCAMERA_PIX_FMT_YUYV];
+        if (plane == 0) {
+            return f.plane[0][y * f.stride[0] + (x / 2) * 4 + o[0] + 2 * (x & 1)];
+        }
+        const uint8_t *r0 = f.plane[0] + 2 * y * f.stride[0] + 4 * x;
+        const uint8_t *r1 = r0 + f.stride[0];
+        return (r0[o[plane]] + r1[o[plane]] + 1) >> 1;
+    }
+    }
+}
+
+static int check(const qcamera_pix_frame_t &src, const qcamera_pix_frame_t &dst)
+{
+    for (int y = 0; y < src.height; y++) {
+        for (int x = 0; x < src.width; x++) {
+            if (sample(src, x, y, 0) != sample(dst, x, y, 0)) {
+                printf("  luma mismatch at %d,%d\n", x, y);
+                return -1;
+            }
+        }
+    }
+    for (int y = 0; y < src.height / 2; y++) {
+        for (int x = 0; x < src.width / 2; x++) {
+            for (int p = 1; p <= 2; p++) {
+                if (sample(src, x, y, p) != sample(dst, x, y, p)) {
+                    printf("  chroma %d mismatch at %d,%d\n", p, x, y);
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-w width] [-h height] [-p stride pad] [-i iterations]\n",
+           name);
+}
+
+int main(int argc, char **argv)
+{
+    int width = 1920;
+    int height = 1080;
+    int pad = 64;
+    int iterations = 50;
+    int failed = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "w:h:p:i:")) != -1) {
+        switch (c) {
+        case 'w': width = atoi(optarg); break;
+        case 'h': height = atoi(optarg); break;
+        case 'p': pad = atoi(optarg); break;
+        case 'i': iterations = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || (width & 1) || (height & 1) ||
+        pad < 0 || iterations <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%dx%d, source stride pad %d, %d iterations\n",
+           width, height, pad, iterations);
+    printf("%-12s %10s %10s\n", "case", "ms/frame", "MB/s");
+
+    for (size_t i = 0; i < sizeof(g_cases) / sizeof(g_cases[0]); i++) {
+        const bench_case_t &bc = g_cases[i];
+        qcamera_pix_frame_t src, dst;
+        size_t size;
+
+        uint8_t *srcBuf = allocPadded(bc.src, width, height, pad, src);
+        if (srcBuf == NULL ||
+            QCameraFormatConvert::getPackedLayout(bc.dst, width, height,
+                NULL, dst, size) != android::NO_ERROR) {
+            printf("%-12s setup failed\n", bc.name);
+            free(srcBuf);
+            failed++;
+            continue;
+        }
+        uint8_t *dstBuf = (uint8_t *)malloc(size);
+        if (dstBuf == NULL) {
+            free(srcBuf);
+            failed++;
+            continue;
+        }
+        QCameraFormatConvert::getPackedLayout(bc.dst, width, height,
+            dstBuf, dst, size);
+
+        int32_t rc = QCameraFormatConvert::convert(src, dst);
+        if (rc != android::NO_ERROR || check(src, dst) != 0) {
+            printf("%-12s FAILED\n", bc.name);
+            failed++;
+        } else {
+            double t0 = nowUs();
+            for (int k = 0; k < iterations; k++) {
+                QCameraFormatConvert::convert(src, dst);
+            }
+            double ms = (nowUs() - t0) / 1e3 / iterations;
+            printf("%-12s %10.3f %10.1f\n", bc.name, ms,
+                   size / (ms * 1e3));
+        }
+        free(dstBuf);
+        free(srcBuf);
+    }
+
+    return failed ? 1 : 0;
+}
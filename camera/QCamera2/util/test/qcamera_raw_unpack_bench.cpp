@@ -0,0 +1,263 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+// Throughput of the raw unpackers and the DNG writer. Each packing is
+// filled from random samples with a plain C packer, unpacked row by row,
+// checked against the original samples and timed. The DNG case encodes
+// the frame to memory and checks the strip the header points at.
+
+#include <utils/Errors.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "QCameraRawUnpack.h"
+#include "QCameraDngWriter.h"
+
+using namespace qcamera;
+
+typedef struct {
+    const char *name;
+    qcamera_raw_packing_t packing;
+    uint32_t bits;
+} bench_case_t;
+
+static const bench_case_t g_cases[] = {
+    { "plain8",  QCAMERA_RAW_PACK_PLAIN8,  8  },
+    { "mipi10",  QCAMERA_RAW_PACK_MIPI10,  10 },
+    { "mipi12",  QCAMERA_RAW_PACK_MIPI12,  12 },
+    { "qcom10",  QCAMERA_RAW_PACK_QCOM10,  10 },
+    { "qcom12",  QCAMERA_RAW_PACK_QCOM12,  12 },
+    { "plain16", QCAMERA_RAW_PACK_PLAIN16, 10 },
+};
+
+static double nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// reference packer, one sample at a time
+static void packRow(qcamera_raw_packing_t packing, const uint16_t *src,
+                    uint8_t *dst, int w)
+{
+    for (int x = 0; x < w; x++) {
+        uint32_t v = src[x];
+        switch (packing) {
+        case QCAMERA_RAW_PACK_PLAIN8:
+            dst[x] = (uint8_t)v;
+            break;
+        case QCAMERA_RAW_PACK_MIPI10: {
+            uint8_t *g = dst + (x / 4) * 5;
+            g[x % 4] = (uint8_t)(v >> 2);
+            g[4] |= (uint8_t)((v & 3) << (2 * (x % 4)));
+            break;
+        }
+        case QCAMERA_RAW_PACK_MIPI12: {
+            uint8_t *g = dst + (x / 2) * 3;
+            g[x % 2] = (uint8_t)(v >> 4);
+            g[2] |= (uint8_t)((v & 0xF) << (4 * (x % 2)));
+            break;
+        }
+        case QCAMERA_RAW_PACK_QCOM10:
+        case QCAMERA_RAW_PACK_QCOM12: {
+            int per = (packing == QCAMERA_RAW_PACK_QCOM10) ? 6 : 5;
+            int bits = (packing == QCAMERA_RAW_PACK_QCOM10) ? 10 : 12;
+            int bit = (x % per) * bits;
+            uint8_t *g = dst + (x / per) * 8;
+            for (int b = 0; b < bits; b++, bit++) {
+                if (v & (1U << b)) {
+                    g[bit / 8] |= (uint8_t)(1U << (bit % 8));
+                }
+            }
+            break;
+        }
+        case QCAMERA_RAW_PACK_PLAIN16:
+            dst[2 * x] = (uint8_t)v;
+            dst[2 * x + 1] = (uint8_t)(v >> 8);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// finds StripOffsets in IFD0 of a DNG written by QCameraDngWriter
+static uint32_t getStripOffset(const uint8_t *dng)
+{
+    if (dng[0] != 'I' || dng[1] != 'I' || dng[2] != 42) {
+        return 0;
+    }
+    const uint8_t *ifd = dng + get32(dng + 4);
+    int n = ifd[0] | (ifd[1] << 8);
+    for (int i = 0; i < n; i++) {
+        const uint8_t *e = ifd + 2 + i * 12;
+        if ((e[0] | (e[1] << 8)) == 273) {
+            return get32(e + 8);
+        }
+    }
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-w width] [-h height] [-p stride pad] [-i iterations]"
+           " [-o dng file]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    int width = 4208;
+    int height = 3120;
+    int pad = 64;
+    int iterations = 10;
+    const char *dngPath = NULL;
+    int failed = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "w:h:p:i:o:")) != -1) {
+        switch (c) {
+        case 'w': width = atoi(optarg); break;
+        case 'h': height = atoi(optarg); break;
+        case 'p': pad = atoi(optarg); break;
+        case 'i': iterations = atoi(optarg); break;
+        case 'o': dngPath = optarg; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (width <= 0 || height <= 0 || pad < 0 || iterations <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    size_t samples = (size_t)width * height;
+    uint16_t *ref = (uint16_t *)malloc(samples * 2);
+    uint16_t *out = (uint16_t *)malloc(samples * 2);
+    if (ref == NULL || out == NULL) {
+        free(ref);
+        free(out);
+        return 1;
+    }
+
+    printf("%dx%d, source stride pad %d, %d iterations\n",
+           width, height, pad, iterations);
+    printf("%-8s %10s %10s %10s\n", "case", "ms/frame", "Mpix/s", "dng ms");
+
+    for (size_t i = 0; i < sizeof(g_cases) / sizeof(g_cases[0]); i++) {
+        const bench_case_t &bc = g_cases[i];
+        qcamera_raw_frame_t raw;
+
+        for (size_t k = 0; k < samples; k++) {
+            ref[k] = (uint16_t)((rand() >> 3) & ((1U << bc.bits) - 1));
+        }
+        memset(&raw, 0, sizeof(raw));
+        raw.packing = bc.packing;
+        raw.cfa = QCAMERA_RAW_CFA_RGGB;
+        raw.bits = bc.bits;
+        raw.width = width;
+        raw.height = height;
+        raw.stride = QCameraRawUnpack::getRowBytes(bc.packing, width) + pad;
+        uint8_t *packed = (uint8_t *)calloc((size_t)raw.stride, height);
+        if (packed == NULL) {
+            failed++;
+            continue;
+        }
+        for (int y = 0; y < height; y++) {
+            packRow(bc.packing, ref + (size_t)y * width,
+                    packed + (size_t)y * raw.stride, width);
+        }
+        raw.data = packed;
+
+        double t0 = nowUs();
+        for (int k = 0; k < iterations; k++) {
+            for (int y = 0; y < height; y++) {
+                QCameraRawUnpack::unpackRow(bc.packing,
+                    packed + (size_t)y * raw.stride,
+                    out + (size_t)y * width, width);
+            }
+        }
+        double ms = (nowUs() - t0) / 1e3 / iterations;
+        if (memcmp(ref, out, samples * 2) != 0) {
+            printf("%-8s FAILED unpack\n", bc.name);
+            failed++;
+            free(packed);
+            continue;
+        }
+
+        qcamera_dng_info_t info;
+        QCameraDngWriter::initInfo(info);
+        snprintf(info.make, sizeof(info.make), "bench");
+        snprintf(info.model, sizeof(info.model), "%s", bc.name);
+        size_t size = QCameraDngWriter::getSize(raw, info);
+        uint8_t *dng = (uint8_t *)malloc(size ? size : 1);
+        size_t written = 0;
+        double dngMs = 0;
+        int32_t rc = android::UNKNOWN_ERROR;
+        if (dng != NULL && size > 0) {
+            t0 = nowUs();
+            for (int k = 0; k < iterations; k++) {
+                rc = QCameraDngWriter::writeToMemory(raw, info, dng, size,
+                                                     written);
+            }
+            dngMs = (nowUs() - t0) / 1e3 / iterations;
+        }
+        uint32_t strip = (rc == android::NO_ERROR) ? getStripOffset(dng) : 0;
+        if (strip == 0 || written != size ||
+            strip + samples * 2 != size ||
+            memcmp(dng + strip, ref, samples * 2) != 0) {
+            printf("%-8s FAILED dng\n", bc.name);
+            failed++;
+        } else {
+            printf("%-8s %10.3f %10.1f %10.3f\n", bc.name, ms,
+                   samples / (ms * 1e3), dngMs);
+            if (dngPath != NULL && bc.packing == QCAMERA_RAW_PACK_MIPI10) {
+                FILE *f = fopen(dngPath, "wb");
+                if (f != NULL) {
+                    fwrite(dng, 1, written, f);
+                    fclose(f);
+                }
+            }
+        }
+        free(dng);
+        free(packed);
+    }
+
+    free(out);
+    free(ref);
+    return failed ? 1 : 0;
+}
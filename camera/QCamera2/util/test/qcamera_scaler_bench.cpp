@@ -0,0 +1,242 @@
+/* Copyright (c) 2012, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+// Throughput of the thumbnail downscaler. A random NV21 frame is scaled
+// from a few crop windows to thumbnail sizes, checked against a plain C
+// box plus bilinear reference working on whole planes and timed.
+
+#include <utils/Errors.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "QCameraScaler.h"
+
+using namespace qcamera;
+
+typedef struct {
+    int zoom;       // crop window is 1/zoom of the frame, centered
+    int width;
+    int height;
+} bench_case_t;
+
+static const bench_case_t g_cases[] = {
+    { 1, 512, 384 },
+    { 1, 320, 240 },
+    { 1, 176, 144 },
+    { 2, 512, 384 },
+    { 4, 512, 384 },
+    { 8, 512, 384 },
+};
+
+static double nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// same sample positions as the scaler
+static void samplePos(int i, int srcLen, int dstLen, int &pos, int &weight)
+{
+    long long p = (((long long)(2 * i + 1) * srcLen) << 16) / (2 * dstLen) - 32768;
+    if (p < 0) {
+        p = 0;
+    }
+    pos = (int)(p >> 16);
+    weight = (int)(p >> 9) & 127;
+    if (pos >= srcLen - 1) {
+        pos = srcLen - 1;
+        weight = 0;
+    }
+}
+
+// reference scaler for one plane: box filter the whole window, then
+// bilinear sample it
+static void refPlane(const uint8_t *src, int srcStride, int srcW, int srcH,
+                     uint8_t *dst, int dstStride, int dstW, int dstH, int ch)
+{
+    int k = QCameraScaler::getBoxFactor(srcW, srcH, dstW, dstH);
+    int bw = srcW / k;
+    int bh = srcH / k;
+    src += ((srcH - bh * k) / 2) * srcStride + ((srcW - bw * k) / 2) * ch;
+    uint8_t *box = (uint8_t *)malloc((size_t)bw * bh * ch);
+    if (box == NULL) {
+        return;
+    }
+    for (int y = 0; y < bh; y++) {
+        for (int x = 0; x < bw; x++) {
+            for (int c = 0; c < ch; c++) {
+                unsigned sum = 0;
+                for (int j = 0; j < k; j++) {
+                    for (int i = 0; i < k; i++) {
+                        sum += src[(y * k + j) * srcStride + (x * k + i) * ch + c];
+                    }
+                }
+                box[(y * bw + x) * ch + c] = (uint8_t)((sum + k * k / 2) / (k * k));
+            }
+        }
+    }
+    for (int y = 0; y < dstH; y++) {
+        int y0, wy;
+        samplePos(y, bh, dstH, y0, wy);
+        int y1 = (y0 + 1 < bh) ? y0 + 1 : y0;
+        for (int x = 0; x < dstW; x++) {
+            int x0, wx;
+            samplePos(x, bw, dstW, x0, wx);
+            int x1 = (x0 + 1 < bw) ? x0 + 1 : x0;
+            for (int c = 0; c < ch; c++) {
+                int a = box[(y0 * bw + x0) * ch + c];
+                int b = box[(y1 * bw + x0) * ch + c];
+                int v0 = (a * (128 - wy) + b * wy + 64) >> 7;
+                a = box[(y0 * bw + x1) * ch + c];
+                b = box[(y1 * bw + x1) * ch + c];
+                int v1 = (a * (128 - wy) + b * wy + 64) >> 7;
+                dst[y * dstStride + x * ch + c] =
+                    (uint8_t)((v0 * (128 - wx) + v1 * wx + 64) >> 7);
+            }
+        }
+    }
+    free(box);
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-w width] [-h height] [-p stride pad] [-i iterations]\n",
+           name);
+}
+
+int main(int argc, char **argv)
+{
+    int width = 4208;
+    int height = 3120;
+    int pad = 64;
+    int iterations = 20;
+    int failed = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "w:h:p:i:")) != -1) {
+        switch (c) {
+        case 'w': width = atoi(optarg); break;
+        case 'h': height = atoi(optarg); break;
+        case 'p': pad = atoi(optarg); break;
+        case 'i': iterations = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (width < 16 || height < 16 || (width | height) & 1 || pad < 0 ||
+        iterations <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    qcamera_pix_frame_t src;
+    memset(&src, 0, sizeof(src));
+    src.fmt = QCAMERA_PIX_FMT_NV21;
+    src.width = width;
+    src.height = height;
+    src.stride[0] = src.stride[1] = width + pad;
+    size_t lumaSize = (size_t)src.stride[0] * height;
+    uint8_t *frame = (uint8_t *)malloc(lumaSize * 3 / 2);
+    if (frame == NULL) {
+        return 1;
+    }
+    // smooth gradient plus noise, so filtering errors show up
+    for (size_t i = 0; i < lumaSize * 3 / 2; i++) {
+        frame[i] = (uint8_t)((i % src.stride[0]) / 16 + (rand() & 31));
+    }
+    src.plane[0] = frame;
+    src.plane[1] = frame + lumaSize;
+
+    printf("%dx%d, source stride pad %d, %d iterations\n",
+           width, height, pad, iterations);
+    printf("%-4s %-9s %4s %10s %10s\n", "zoom", "thumb", "box", "ms/frame",
+           "Mpix/s");
+
+    for (size_t i = 0; i < sizeof(g_cases) / sizeof(g_cases[0]); i++) {
+        const bench_case_t &bc = g_cases[i];
+        int cropW = (width / bc.zoom) & ~1;
+        int cropH = (height / bc.zoom) & ~1;
+        int cropX = ((width - cropW) / 2) & ~1;
+        int cropY = ((height - cropH) / 2) & ~1;
+
+        qcamera_pix_frame_t dst;
+        memset(&dst, 0, sizeof(dst));
+        dst.fmt = QCAMERA_PIX_FMT_NV21;
+        dst.width = bc.width;
+        dst.height = bc.height;
+        dst.stride[0] = dst.stride[1] = (bc.width + 15) & ~15;
+        size_t thumbSize = (size_t)dst.stride[0] * bc.height;
+        uint8_t *out = (uint8_t *)malloc(thumbSize * 3 / 2);
+        uint8_t *ref = (uint8_t *)calloc(thumbSize * 3 / 2, 1);
+        if (out == NULL || ref == NULL) {
+            free(out);
+            free(ref);
+            failed++;
+            continue;
+        }
+        memset(out, 0, thumbSize * 3 / 2);
+        dst.plane[0] = out;
+        dst.plane[1] = out + thumbSize;
+
+        refPlane(src.plane[0] + (size_t)cropY * src.stride[0] + cropX,
+                 src.stride[0], cropW, cropH,
+                 ref, dst.stride[0], bc.width, bc.height, 1);
+        refPlane(src.plane[1] + (size_t)(cropY / 2) * src.stride[1] + cropX,
+                 src.stride[1], cropW / 2, cropH / 2,
+                 ref + thumbSize, dst.stride[1], bc.width / 2, bc.height / 2, 2);
+
+        int32_t rc = android::NO_ERROR;
+        double t0 = nowUs();
+        for (int k = 0; k < iterations && rc == android::NO_ERROR; k++) {
+            rc = QCameraScaler::downscale(src, cropX, cropY, cropW, cropH, dst);
+        }
+        double ms = (nowUs() - t0) / 1e3 / iterations;
+
+        char thumb[16];
+        snprintf(thumb, sizeof(thumb), "%dx%d", bc.width, bc.height);
+        if (rc != android::NO_ERROR ||
+            memcmp(out, ref, thumbSize * 3 / 2) != 0) {
+            printf("%-4d %-9s FAILED\n", bc.zoom, thumb);
+            failed++;
+        } else {
+            printf("%-4d %-9s %4d %10.3f %10.1f\n", bc.zoom, thumb,
+                   QCameraScaler::getBoxFactor(cropW, cropH, bc.width, bc.height),
+                   ms, (double)cropW * cropH / (ms * 1e3));
+        }
+        free(out);
+        free(ref);
+    }
+
+    free(frame);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+EASY_HDR_PATH := $(call my-dir)
+
+easy_hdr_defines := -Wall -Werror -O3
+
+easy_hdr_includes := $(EASY_HDR_PATH)/include
+
+easy_hdr_src := src/easy_hdr.c \
+                src/easy_hdr_align.c \
+                src/easy_hdr_merge.c \
+                src/easy_hdr_pool.c
+
+# ------------------------------------------------------------------------------
+#                Make the shared library (libcamera_easy_hdr)
+# ------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(EASY_HDR_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := $(easy_hdr_defines)
+LOCAL_ARM_NEON := true
+
+LOCAL_C_INCLUDES := $(easy_hdr_includes)
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(easy_hdr_includes)
+
+LOCAL_SRC_FILES := $(easy_hdr_src)
+
+LOCAL_MODULE           := libcamera_easy_hdr
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_SHARED_LIBRARY)
+
+# ------------------------------------------------------------------------------
+#     Host build of the engine, used to run and benchmark merges off target
+# ------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(EASY_HDR_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := $(easy_hdr_defines) -msse2
+
+LOCAL_C_INCLUDES := $(easy_hdr_includes)
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(easy_hdr_includes)
+
+LOCAL_SRC_FILES := $(easy_hdr_src)
+
+LOCAL_MODULE           := libcamera_easy_hdr
+LOCAL_LDLIBS := -lpthread -lm
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# ------------------------------------------------------------------------------
+#        Make the shared library (libcamera_noise_reduction)
+# ------------------------------------------------------------------------------
+
+noise_reduction_src := src/noise_reduction.c \
+                       src/easy_hdr_pool.c
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(EASY_HDR_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := $(easy_hdr_defines)
+LOCAL_ARM_NEON := true
+
+LOCAL_C_INCLUDES := $(easy_hdr_includes)
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(easy_hdr_includes)
+
+LOCAL_SRC_FILES := $(noise_reduction_src)
+
+LOCAL_MODULE           := libcamera_noise_reduction
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(EASY_HDR_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := $(easy_hdr_defines) -msse2
+
+LOCAL_C_INCLUDES := $(easy_hdr_includes)
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(easy_hdr_includes)
+
+LOCAL_SRC_FILES := $(noise_reduction_src)
+
+LOCAL_MODULE           := libcamera_noise_reduction
+LOCAL_LDLIBS := -lpthread -lm
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+include $(EASY_HDR_PATH)/test/Android.mk
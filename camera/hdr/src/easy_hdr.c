@@ -0,0 +1,947 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+/* morpho_EasyHDR API on top of the HDR engine stages.
+ *
+ * A merge runs the stages of easy_hdr_align.c and easy_hdr_merge.c in
+ * order. Each stage splits its work in tiles: in batch mode (nthreads >= 1)
+ * the tiles are shared by the worker pool and the calling thread, and
+ * suspend() stops the pool between tiles; in step mode (nthreads <= 0)
+ * merge() and process() run a single tile per call. The engine state lives
+ * at the start of the buffer given to initialize(), the rest of the buffer
+ * is the work memory of the merges. Face detection is accepted for API
+ * compatibility but does not affect the merge. */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "easy_hdr_int.h"
+#include "morpho_easy_hdr_ext.h"
+
+#define HDR_MEM_ALIGN 16
+#define HDR_ENGINE_SIZE \
+  ((int)((sizeof(hdr_engine_t) + HDR_MEM_ALIGN - 1) & ~(HDR_MEM_ALIGN - 1)))
+
+static const hdr_stage_t *const hdr_stages[] = {
+  &hdr_stage_pyramid,
+  &hdr_stage_align_global,
+  &hdr_stage_align_local,
+  &hdr_stage_ghost,
+  &hdr_stage_merge,
+  &hdr_stage_scale,
+};
+
+#define HDR_NUM_STAGES ((int)(sizeof(hdr_stages) / sizeof(hdr_stages[0])))
+
+static const char *const hdr_formats[] = {
+  "YUV420_SEMIPLANAR",
+  "YVU420_SEMIPLANAR",
+  "YUV420_PLANAR",
+  "YVU420_PLANAR",
+};
+
+/*==============================================================================
+* Function : hdr_format_index
+* Parameters: format
+* Return Value : index in hdr_formats, -1 if not supported
+* Description: Look up an image format string
+==============================================================================*/
+static int hdr_format_index(const char *format)
+{
+  int i;
+
+  if (NULL == format)
+    return -1;
+  for (i = 0; i < (int)(sizeof(hdr_formats) / sizeof(hdr_formats[0])); i++)
+    if (!strcmp(format, hdr_formats[i]))
+      return i;
+  return -1;
+}
+
+/*==============================================================================
+* Function : hdr_format_planar
+* Parameters: index
+* Return Value : 1 for planar formats
+* Description: Chroma layout of a supported format. The order of the chroma
+* components does not matter to the merge.
+==============================================================================*/
+static int hdr_format_planar(int index)
+{
+  return index >= 2;
+}
+
+/*==============================================================================
+* Function : hdr_get
+* Parameters: p
+* Return Value : engine, NULL if p is not initialized
+* Description: Engine of an EasyHDR instance
+==============================================================================*/
+static hdr_engine_t *hdr_get(morpho_EasyHDR *p)
+{
+  return p ? (hdr_engine_t *)p->p : NULL;
+}
+
+/*==============================================================================
+* Function : hdr_get_idle
+* Parameters: p, e
+* Return Value : MORPHO_OK, MORPHO_ERROR_PARAM or MORPHO_ERROR_STATE
+* Description: Engine of an EasyHDR instance that is not merging, as needed
+* to change parameters
+==============================================================================*/
+static int hdr_get_idle(morpho_EasyHDR *p, hdr_engine_t **e)
+{
+  *e = hdr_get(p);
+  if (NULL == *e)
+    return MORPHO_ERROR_PARAM;
+  if (HDR_STATE_INITIALIZED != (*e)->state)
+    return MORPHO_ERROR_STATE;
+  return MORPHO_OK;
+}
+
+/*==============================================================================
+* Function : hdr_set_frame
+* Parameters: f, img, planar
+* Return Value : None
+* Description: Plane pointers of a morpho image
+==============================================================================*/
+static void hdr_set_frame(hdr_frame_t *f, const morpho_ImageData *img,
+  int planar)
+{
+  if (planar) {
+    f->y = img->dat.planar.y;
+    f->u = img->dat.planar.u;
+    f->v = img->dat.planar.v;
+  } else {
+    f->y = img->dat.semi_planar.y;
+    f->u = img->dat.semi_planar.uv;
+    f->v = NULL;
+  }
+}
+
+/*==============================================================================
+* Function : hdr_frame_valid
+* Parameters: img, planar
+* Return Value : 1 if all planes are set
+* Description: Check the plane pointers of a morpho image
+==============================================================================*/
+static int hdr_frame_valid(const morpho_ImageData *img, int planar)
+{
+  if (planar)
+    return img->dat.planar.y && img->dat.planar.u && img->dat.planar.v;
+  return img->dat.semi_planar.y && img->dat.semi_planar.uv;
+}
+
+/*==============================================================================
+* Function : hdr_stage_tile
+* Parameters: ctx, idx
+* Return Value : None
+* Description: Pool entry point, runs a tile of the current stage
+==============================================================================*/
+static void hdr_stage_tile(void *ctx, int idx)
+{
+  hdr_engine_t *e = (hdr_engine_t *)ctx;
+
+  hdr_stages[e->stage]->tile(e, idx);
+}
+
+/*==============================================================================
+* Function : hdr_run
+* Parameters: e
+* Return Value : MORPHO_OK when the merge is done, MORPHO_DOPROCESS after a
+* step in step mode, MORPHO_SUSPENDED if the pool was stopped, or an error
+* Description: Advance the merge through its stages
+==============================================================================*/
+static int hdr_run(hdr_engine_t *e)
+{
+  int n, rc;
+
+  while (e->stage < HDR_NUM_STAGES) {
+    const hdr_stage_t *s = hdr_stages[e->stage];
+
+    if (!e->stage_begun) {
+      e->ntiles = s->begin(e);
+      e->cursor = 0;
+      e->stage_begun = 1;
+    }
+    if (e->step_mode) {
+      if (e->cursor < e->ntiles) {
+        s->tile(e, e->cursor++);
+        return MORPHO_DOPROCESS;
+      }
+    } else if (e->cursor < e->ntiles) {
+      e->cursor = hdr_pool_run(&e->pool, e, hdr_stage_tile, e->cursor,
+        e->ntiles);
+      if (e->cursor < e->ntiles)
+        return MORPHO_SUSPENDED;
+    }
+    if (s->end) {
+      rc = s->end(e);
+      if (MORPHO_OK != rc) {
+        e->status |= MORPHO_EASY_HDR_ERROR_INTERNAL;
+        return rc;
+      }
+    }
+    e->stage++;
+    e->stage_begun = 0;
+  }
+
+  for (n = 0; n < e->nimages; n++)
+    e->status |= e->img[n].status;
+  return MORPHO_OK;
+}
+
+/*==============================================================================
+* Function : hdr_run_batch
+* Parameters: e
+* Return Value : result of hdr_run
+* Description: Run the merge in batch mode and update the state. A suspend
+* arriving after the last tile has no effect.
+==============================================================================*/
+static int hdr_run_batch(hdr_engine_t *e)
+{
+  int rc;
+
+  e->state = HDR_STATE_PROCESSING;
+  rc = hdr_run(e);
+  if (MORPHO_SUSPENDED == rc) {
+    e->state = HDR_STATE_SUSPENDED;
+  } else {
+    hdr_pool_set_stop(&e->pool, 0);
+    e->state = HDR_STATE_INITIALIZED;
+  }
+  return rc;
+}
+
+MORPHO_API(char const *)
+morpho_EasyHDR_getVersion(void)
+{
+  return MORPHO_EASY_HDR_VER;
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getBufferSize(
+    int max_width,
+    int max_height,
+    char const *format)
+{
+  if ((hdr_format_index(format) < 0) ||
+    (max_width < MORPHO_EASY_HDR_MIN_IMAGE_WIDTH) ||
+    (max_width > MORPHO_EASY_HDR_MAX_IMAGE_WIDTH) ||
+    (max_height < MORPHO_EASY_HDR_MIN_IMAGE_HEIGHT) ||
+    (max_height > MORPHO_EASY_HDR_MAX_IMAGE_HEIGHT))
+    return 0;
+  return HDR_ENGINE_SIZE + HDR_MEM_ALIGN +
+    hdr_work_size(max_width, max_height, MORPHO_EASY_HDR_MAX_NIMAGES);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_initialize(
+    morpho_EasyHDR *p,
+    void *buffer,
+    int buffer_size,
+    int nthreads,
+    morpho_EasyHDR_Callback const *callback)
+{
+  uintptr_t base = ((uintptr_t)buffer + HDR_MEM_ALIGN - 1) &
+    ~(uintptr_t)(HDR_MEM_ALIGN - 1);
+  int skew = (int)(base - (uintptr_t)buffer);
+  hdr_engine_t *e;
+  int rc;
+
+  if (!p || !buffer || (buffer_size < skew + HDR_ENGINE_SIZE))
+    return MORPHO_ERROR_PARAM;
+
+  e = (hdr_engine_t *)base;
+  memset(e, 0, sizeof(*e));
+  e->work = (uint8_t *)base + HDR_ENGINE_SIZE;
+  e->work_size = buffer_size - skew - HDR_ENGINE_SIZE;
+  e->step_mode = (nthreads <= 0);
+
+  rc = hdr_pool_init(&e->pool, e->step_mode ? 0 : nthreads - 1, callback);
+  if (MORPHO_OK != rc)
+    return rc;
+
+  e->alignment = MORPHO_EASY_HDR_IMAGE_ALIGNMENT_DEFAULT;
+  e->ghost_removal = MORPHO_EASY_HDR_GHOST_REMOVAL_DEFAULT;
+  e->auto_scaling = MORPHO_EASY_HDR_AUTO_SCALING_DEFAULT;
+  e->face_detection = MORPHO_EASY_HDR_FACE_DETECTION_DEFAULT;
+  e->fail_soft = MORPHO_EASY_HDR_FAIL_SOFT_MERGING_DEFAULT;
+  e->ghost_sensitivity =
+    MORPHO_EASY_HDR_GHOST_DETECTION_SENSITIVITY_LEVEL_DEFAULT;
+  e->smoothness = MORPHO_EASY_HDR_MERGE_SMOOTHNESS_LEVEL_DEFAULT;
+  e->merge_param[0] = MORPHO_EASY_HDR_MERGE_PARAM1_DEFAULT;
+  e->merge_param[1] = MORPHO_EASY_HDR_MERGE_PARAM2_DEFAULT;
+  e->merge_param[2] = MORPHO_EASY_HDR_MERGE_PARAM3_DEFAULT;
+  e->merge_param[3] = MORPHO_EASY_HDR_MERGE_PARAM4_DEFAULT;
+  e->reliable_rate = MORPHO_EASY_HDR_RELIABLE_RECT_RATE_THRESHOLD_DEFAULT;
+  e->ghost_rate = MORPHO_EASY_HDR_GHOST_RATE_THRESHOLD_DEFAULT;
+  e->cc[0] = MORPHO_EASY_HDR_CC_Y_OFFSET_DEFAULT;
+  e->cc[1] = MORPHO_EASY_HDR_CC_Y_GAIN_DEFAULT;
+  e->cc[2] = MORPHO_EASY_HDR_CC_Y_GAMMA_DEFAULT;
+  e->cc[3] = MORPHO_EASY_HDR_CC_C_OFFSET_DEFAULT;
+  e->cc[4] = MORPHO_EASY_HDR_CC_C_GAIN_DEFAULT;
+  e->cc[5] = MORPHO_EASY_HDR_CC_C_GAMMA_DEFAULT;
+  e->state = HDR_STATE_INITIALIZED;
+  p->p = e;
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_finalize(
+    morpho_EasyHDR *p)
+{
+  hdr_engine_t *e = hdr_get(p);
+
+  if (NULL == e)
+    return MORPHO_ERROR_PARAM;
+  hdr_pool_deinit(&e->pool);
+  memset(e, 0, sizeof(*e));
+  p->p = NULL;
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_merge(
+    morpho_EasyHDR *p,
+    morpho_ImageData *output_image,
+    morpho_ImageData *input_images[],
+    int nimages)
+{
+  hdr_engine_t *e;
+  int rc, n, w, h;
+
+  rc = hdr_get_idle(p, &e);
+  if (MORPHO_OK != rc)
+    return rc;
+  if (!e->format_set)
+    return MORPHO_ERROR_STATE;
+  if (!output_image || !input_images ||
+    (nimages < MORPHO_EASY_HDR_MIN_NIMAGES) ||
+    (nimages > MORPHO_EASY_HDR_MAX_NIMAGES))
+    return MORPHO_ERROR_PARAM;
+
+  w = output_image->width;
+  h = output_image->height;
+  if ((w < MORPHO_EASY_HDR_MIN_IMAGE_WIDTH) ||
+    (w > MORPHO_EASY_HDR_MAX_IMAGE_WIDTH) ||
+    (h < MORPHO_EASY_HDR_MIN_IMAGE_HEIGHT) ||
+    (h > MORPHO_EASY_HDR_MAX_IMAGE_HEIGHT) || ((w | h) & 1) ||
+    !hdr_frame_valid(output_image, e->planar))
+    return MORPHO_ERROR_PARAM;
+  for (n = 0; n < nimages; n++) {
+    if (!input_images[n] || (input_images[n]->width != w) ||
+      (input_images[n]->height != h) ||
+      !hdr_frame_valid(input_images[n], e->planar))
+      return MORPHO_ERROR_PARAM;
+  }
+
+  e->width = w;
+  e->height = h;
+  e->nimages = nimages;
+  rc = hdr_carve_work(e);
+  if (MORPHO_OK != rc)
+    return rc;
+  for (n = 0; n < nimages; n++)
+    hdr_set_frame(&e->in[n], input_images[n], e->planar);
+  hdr_set_frame(&e->out, output_image, e->planar);
+  hdr_setup_luts(e);
+
+  e->status = MORPHO_EASY_HDR_OK;
+  e->reliable.sx = 0;
+  e->reliable.sy = 0;
+  e->reliable.ex = w;
+  e->reliable.ey = h;
+  e->crop = e->reliable;
+  e->stage = 0;
+  e->stage_begun = 0;
+
+  if (e->step_mode) {
+    rc = hdr_run(e);
+    e->state = (MORPHO_DOPROCESS == rc) ?
+      HDR_STATE_PAUSED : HDR_STATE_INITIALIZED;
+    return rc;
+  }
+  hdr_pool_set_stop(&e->pool, 0);
+  return hdr_run_batch(e);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_process(
+    morpho_EasyHDR *p)
+{
+  hdr_engine_t *e = hdr_get(p);
+  int rc;
+
+  if (NULL == e)
+    return MORPHO_ERROR_PARAM;
+  if (HDR_STATE_PAUSED != e->state)
+    return MORPHO_ERROR_STATE;
+  rc = hdr_run(e);
+  if (MORPHO_DOPROCESS != rc)
+    e->state = HDR_STATE_INITIALIZED;
+  return rc;
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_suspend(
+    morpho_EasyHDR *p)
+{
+  hdr_engine_t *e = hdr_get(p);
+
+  if (NULL == e)
+    return MORPHO_ERROR_PARAM;
+  if (e->step_mode)
+    return MORPHO_ERROR_STATE;
+  /* the merging thread moves to SUSPENDED once the tiles in flight end */
+  hdr_pool_set_stop(&e->pool, 1);
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_resume(
+    morpho_EasyHDR *p)
+{
+  hdr_engine_t *e = hdr_get(p);
+
+  if (NULL == e)
+    return MORPHO_ERROR_PARAM;
+  if (HDR_STATE_SUSPENDED != e->state)
+    return MORPHO_ERROR_STATE;
+  hdr_pool_set_stop(&e->pool, 0);
+  return hdr_run_batch(e);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_setImageFormat(
+    morpho_EasyHDR *p,
+    char const *format)
+{
+  hdr_engine_t *e;
+  int rc = hdr_get_idle(p, &e), idx;
+
+  if (MORPHO_OK != rc)
+    return rc;
+  idx = hdr_format_index(format);
+  if (idx < 0)
+    return MORPHO_ERROR_UNSUPPORTED;
+  snprintf(e->format, sizeof(e->format), "%s", format);
+  e->planar = hdr_format_planar(idx);
+  e->format_set = 1;
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getImageFormat(
+    morpho_EasyHDR *p,
+    char *buffer,
+    int buffer_size)
+{
+  hdr_engine_t *e = hdr_get(p);
+
+  if (!e || !buffer)
+    return MORPHO_ERROR_PARAM;
+  if (!e->format_set)
+    return MORPHO_ERROR_STATE;
+  if (buffer_size <= (int)strlen(e->format))
+    return MORPHO_ERROR_PARAM;
+  snprintf(buffer, buffer_size, "%s", e->format);
+  return MORPHO_OK;
+}
+
+/*==============================================================================
+* Function : hdr_set_int
+* Parameters: p, field, value, min, max
+* Return Value : MORPHO_OK, MORPHO_ERROR_PARAM or MORPHO_ERROR_STATE
+* Description: Range checked update of an integer parameter. field is the
+* byte offset of the parameter in the engine.
+==============================================================================*/
+static int hdr_set_int(morpho_EasyHDR *p, size_t field, int value, int min,
+  int max)
+{
+  hdr_engine_t *e;
+  int rc = hdr_get_idle(p, &e);
+
+  if (MORPHO_OK != rc)
+    return rc;
+  if ((value < min) || (value > max))
+    return MORPHO_ERROR_PARAM;
+  *(int *)((uint8_t *)e + field) = value;
+  return MORPHO_OK;
+}
+
+/*==============================================================================
+* Function : hdr_get_int
+* Parameters: p, field, value
+* Return Value : MORPHO_OK or MORPHO_ERROR_PARAM
+* Description: Read an integer parameter, see hdr_set_int
+==============================================================================*/
+static int hdr_get_int(morpho_EasyHDR *p, size_t field, int *value)
+{
+  hdr_engine_t *e = hdr_get(p);
+
+  if (!e || !value)
+    return MORPHO_ERROR_PARAM;
+  *value = *(const int *)((const uint8_t *)e + field);
+  return MORPHO_OK;
+}
+
+#define HDR_FIELD(name) offsetof(hdr_engine_t, name)
+
+MORPHO_API(int)
+morpho_EasyHDR_setImageAlignmentStatus(
+    morpho_EasyHDR *p,
+    int value)
+{
+  return hdr_set_int(p, HDR_FIELD(alignment), value,
+    MORPHO_EASY_HDR_DISABLED, MORPHO_EASY_HDR_ENABLED);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getImageAlignmentStatus(
+    morpho_EasyHDR *p,
+    int *value)
+{
+  return hdr_get_int(p, HDR_FIELD(alignment), value);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_setGhostRemovalStatus(
+    morpho_EasyHDR *p,
+    int value)
+{
+  return hdr_set_int(p, HDR_FIELD(ghost_removal), value,
+    MORPHO_EASY_HDR_DISABLED, MORPHO_EASY_HDR_ENABLED);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getGhostRemovalStatus(
+    morpho_EasyHDR *p,
+    int *value)
+{
+  return hdr_get_int(p, HDR_FIELD(ghost_removal), value);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_setAutoScalingStatus(
+    morpho_EasyHDR *p,
+    int value)
+{
+  return hdr_set_int(p, HDR_FIELD(auto_scaling), value,
+    MORPHO_EASY_HDR_DISABLED, MORPHO_EASY_HDR_ENABLED);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getAutoScalingStatus(
+    morpho_EasyHDR *p,
+    int *value)
+{
+  return hdr_get_int(p, HDR_FIELD(auto_scaling), value);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_setFaceDetectionStatus(
+    morpho_EasyHDR *p,
+    int value)
+{
+  return hdr_set_int(p, HDR_FIELD(face_detection), value,
+    MORPHO_EASY_HDR_DISABLED, MORPHO_EASY_HDR_ENABLED);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getFaceDetectionStatus(
+    morpho_EasyHDR *p,
+    int *value)
+{
+  return hdr_get_int(p, HDR_FIELD(face_detection), value);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_setFailSoftMergingStatus(
+    morpho_EasyHDR *p,
+    int value)
+{
+  return hdr_set_int(p, HDR_FIELD(fail_soft), value,
+    MORPHO_EASY_HDR_DISABLED, MORPHO_EASY_HDR_ENABLED);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getFailSoftMergingStatus(
+    morpho_EasyHDR *p,
+    int *value)
+{
+  return hdr_get_int(p, HDR_FIELD(fail_soft), value);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_setGhostDetectionSensitivityLevel(
+    morpho_EasyHDR *p,
+    int value)
+{
+  return hdr_set_int(p, HDR_FIELD(ghost_sensitivity), value,
+    MORPHO_EASY_HDR_GHOST_DETECTION_SENSITIVITY_LEVEL_MIN,
+    MORPHO_EASY_HDR_GHOST_DETECTION_SENSITIVITY_LEVEL_MAX);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getGhostDetectionSensitivityLevel(
+    morpho_EasyHDR *p,
+    int *value)
+{
+  return hdr_get_int(p, HDR_FIELD(ghost_sensitivity), value);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_setMergeSmoothnessLevel(
+    morpho_EasyHDR *p,
+    int value)
+{
+  return hdr_set_int(p, HDR_FIELD(smoothness), value,
+    MORPHO_EASY_HDR_MERGE_SMOOTHNESS_LEVEL_MIN,
+    MORPHO_EASY_HDR_MERGE_SMOOTHNESS_LEVEL_MAX);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getMergeSmoothnessLevel(
+    morpho_EasyHDR *p,
+    int *value)
+{
+  return hdr_get_int(p, HDR_FIELD(smoothness), value);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_setMergeParameters(
+    morpho_EasyHDR *p,
+    int value1,
+    int value2,
+    int value3,
+    int value4)
+{
+  int values[4] = { value1, value2, value3, value4 };
+  hdr_engine_t *e;
+  int rc = hdr_get_idle(p, &e), i;
+
+  if (MORPHO_OK != rc)
+    return rc;
+  for (i = 0; i < 4; i++)
+    if ((values[i] < MORPHO_EASY_HDR_MERGE_PARAM_MIN) ||
+      (values[i] > MORPHO_EASY_HDR_MERGE_PARAM_MAX))
+      return MORPHO_ERROR_PARAM;
+  memcpy(e->merge_param, values, sizeof(values));
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getMergeParameters(
+    morpho_EasyHDR *p,
+    int *value1,
+    int *value2,
+    int *value3,
+    int *value4)
+{
+  hdr_engine_t *e = hdr_get(p);
+
+  if (!e || !value1 || !value2 || !value3 || !value4)
+    return MORPHO_ERROR_PARAM;
+  *value1 = e->merge_param[0];
+  *value2 = e->merge_param[1];
+  *value3 = e->merge_param[2];
+  *value4 = e->merge_param[3];
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_setReliableRectRateThreshold(
+    morpho_EasyHDR *p,
+    int rate)
+{
+  return hdr_set_int(p, HDR_FIELD(reliable_rate), rate,
+    MORPHO_EASY_HDR_RELIABLE_RECT_RATE_THRESHOLD_MIN,
+    MORPHO_EASY_HDR_RELIABLE_RECT_RATE_THRESHOLD_MAX);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getReliableRectRateThreshold(
+    morpho_EasyHDR *p,
+    int *rate)
+{
+  return hdr_get_int(p, HDR_FIELD(reliable_rate), rate);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getReliableRect(
+    morpho_EasyHDR *p,
+    morpho_RectInt *rect)
+{
+  hdr_engine_t *e = hdr_get(p);
+
+  if (!e || !rect)
+    return MORPHO_ERROR_PARAM;
+  if (HDR_STATE_INITIALIZED != e->state)
+    return MORPHO_ERROR_STATE;
+  *rect = e->reliable;
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_setGhostRateThreshold(
+    morpho_EasyHDR *p,
+    int rate)
+{
+  return hdr_set_int(p, HDR_FIELD(ghost_rate), rate,
+    MORPHO_EASY_HDR_GHOST_RATE_THRESHOLD_MIN,
+    MORPHO_EASY_HDR_GHOST_RATE_THRESHOLD_MAX);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getGhostRateThreshold(
+    morpho_EasyHDR *p,
+    int *rate)
+{
+  return hdr_get_int(p, HDR_FIELD(ghost_rate), rate);
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_setColorCorrectionParameters(
+    morpho_EasyHDR *p,
+    int y_offset,
+    int y_gain,
+    int y_gamma,
+    int c_offset,
+    int c_gain,
+    int c_gamma)
+{
+  hdr_engine_t *e;
+  int rc = hdr_get_idle(p, &e);
+
+  if (MORPHO_OK != rc)
+    return rc;
+  if ((y_offset < MORPHO_EASY_HDR_CC_OFFSET_MIN) ||
+    (y_offset > MORPHO_EASY_HDR_CC_OFFSET_MAX) ||
+    (c_offset < MORPHO_EASY_HDR_CC_OFFSET_MIN) ||
+    (c_offset > MORPHO_EASY_HDR_CC_OFFSET_MAX) ||
+    (y_gain < MORPHO_EASY_HDR_CC_GAIN_MIN) ||
+    (y_gain > MORPHO_EASY_HDR_CC_GAIN_MAX) ||
+    (c_gain < MORPHO_EASY_HDR_CC_GAIN_MIN) ||
+    (c_gain > MORPHO_EASY_HDR_CC_GAIN_MAX) ||
+    (y_gamma < MORPHO_EASY_HDR_CC_GAMMA_MIN) ||
+    (y_gamma > MORPHO_EASY_HDR_CC_GAMMA_MAX) ||
+    (c_gamma < MORPHO_EASY_HDR_CC_GAMMA_MIN) ||
+    (c_gamma > MORPHO_EASY_HDR_CC_GAMMA_MAX))
+    return MORPHO_ERROR_PARAM;
+  e->cc[0] = y_offset;
+  e->cc[1] = y_gain;
+  e->cc[2] = y_gamma;
+  e->cc[3] = c_offset;
+  e->cc[4] = c_gain;
+  e->cc[5] = c_gamma;
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getColorCorrectionParameters(
+    morpho_EasyHDR *p,
+    int *y_offset,
+    int *y_gain,
+    int *y_gamma,
+    int *c_offset,
+    int *c_gain,
+    int *c_gamma)
+{
+  hdr_engine_t *e = hdr_get(p);
+
+  if (!e || !y_offset || !y_gain || !y_gamma || !c_offset || !c_gain ||
+    !c_gamma)
+    return MORPHO_ERROR_PARAM;
+  *y_offset = e->cc[0];
+  *y_gain = e->cc[1];
+  *y_gamma = e->cc[2];
+  *c_offset = e->cc[3];
+  *c_gain = e->cc[4];
+  *c_gamma = e->cc[5];
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_getMergeStatus(
+    morpho_EasyHDR *p)
+{
+  hdr_engine_t *e = hdr_get(p);
+
+  if (NULL == e)
+    return MORPHO_EASY_HDR_ERROR_INTERNAL;
+  return e->status;
+}
+
+/*==============================================================================
+* Function : hdr_box_line
+* Parameters: src, sstride, step, sw, sh, dst, dw, dh, y
+* Return Value : None
+* Description: Area average of one output row of a plane, for reductions
+* of more than 2x where bilinear sampling would alias. Samples are step
+* bytes apart.
+==============================================================================*/
+static void hdr_box_line(const uint8_t *src, int sstride, int step, int sw,
+  int sh, uint8_t *dst, int dw, int dh, int y)
+{
+  int y0 = (int)((int64_t)y * sh / dh);
+  int y1 = (int)((int64_t)(y + 1) * sh / dh);
+  int x, i, j;
+
+  if (y1 <= y0)
+    y1 = y0 + 1;
+  for (x = 0; x < dw; x++) {
+    int x0 = (int)((int64_t)x * sw / dw);
+    int x1 = (int)((int64_t)(x + 1) * sw / dw);
+    uint32_t sum = 0, count;
+
+    if (x1 <= x0)
+      x1 = x0 + 1;
+    count = (x1 - x0) * (y1 - y0);
+    for (j = y0; j < y1; j++)
+      for (i = x0; i < x1; i++)
+        sum += src[j * sstride + i * step];
+    dst[x * step] = (uint8_t)((sum + count / 2) / count);
+  }
+}
+
+MORPHO_API(int)
+morpho_EasyHDR_makeThumbnail(
+    morpho_EasyHDR *p,
+    morpho_ImageData *thumbnail_image,
+    morpho_ImageData const *output_image)
+{
+  hdr_engine_t *e = hdr_get(p);
+  hdr_frame_t src, dst;
+  int sw, sh, dw, dh, y;
+
+  if (!e || !thumbnail_image || !output_image)
+    return MORPHO_ERROR_PARAM;
+  if (!e->format_set)
+    return MORPHO_ERROR_STATE;
+  sw = output_image->width;
+  sh = output_image->height;
+  dw = thumbnail_image->width;
+  dh = thumbnail_image->height;
+  if ((sw < 2) || (sh < 2) || (dw < 2) || (dh < 2) ||
+    ((sw | sh | dw | dh) & 1) || !hdr_frame_valid(output_image, e->planar) ||
+    !hdr_frame_valid(thumbnail_image, e->planar))
+    return MORPHO_ERROR_PARAM;
+  hdr_set_frame(&src, output_image, e->planar);
+  hdr_set_frame(&dst, thumbnail_image, e->planar);
+
+  if ((sw > 2 * dw) || (sh > 2 * dh)) {
+    for (y = 0; y < dh; y++)
+      hdr_box_line(src.y, sw, 1, sw, sh, dst.y + y * dw, dw, dh, y);
+    for (y = 0; y < dh / 2; y++) {
+      if (e->planar) {
+        hdr_box_line(src.u, sw / 2, 1, sw / 2, sh / 2,
+          dst.u + y * (dw / 2), dw / 2, dh / 2, y);
+        hdr_box_line(src.v, sw / 2, 1, sw / 2, sh / 2,
+          dst.v + y * (dw / 2), dw / 2, dh / 2, y);
+      } else {
+        hdr_box_line(src.u, sw, 2, sw / 2, sh / 2, dst.u + y * dw,
+          dw / 2, dh / 2, y);
+        hdr_box_line(src.u + 1, sw, 2, sw / 2, sh / 2, dst.u + y * dw + 1,
+          dw / 2, dh / 2, y);
+      }
+    }
+  } else {
+    morpho_RectInt full;
+    full.sx = 0;
+    full.sy = 0;
+    full.ex = sw;
+    full.ey = sh;
+    hdr_scale_rows(&src, sw, sh, &full, &dst, dw, dh, e->planar, 0, dh);
+  }
+  return MORPHO_OK;
+}
+
+/*==============================================================================
+* Function : LINK_mm_camera_HDR
+* Parameters: yuvInput01, yuvInput02, yuvInput03, pHDROutImage, width,
+*   height, indoor
+* Return Value : 0 on success, a MORPHO error code otherwise
+* Description: One call merge of three YVU420 semi-planar frames with
+* default parameters, the first frame is the reference. indoor is kept for
+* compatibility with the prebuilt library and is not used.
+==============================================================================*/
+MORPHO_API(int)
+LINK_mm_camera_HDR(
+    unsigned char* yuvInput01,
+    unsigned char* yuvInput02,
+    unsigned char* yuvInput03,
+    unsigned char* pHDROutImage,
+    int width,
+    int height,
+    int indoor)
+{
+  static const char format[] = "YVU420_SEMIPLANAR";
+  unsigned char *planes[3] = { yuvInput01, yuvInput02, yuvInput03 };
+  morpho_ImageData in[3], out;
+  morpho_ImageData *inputs[3];
+  morpho_EasyHDR hdr;
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  void *buffer;
+  int size, rc, i;
+
+  (void)indoor;
+  memset(in, 0, sizeof(in));
+  memset(&out, 0, sizeof(out));
+  if (!yuvInput01 || !yuvInput02 || !yuvInput03 || !pHDROutImage)
+    return MORPHO_ERROR_PARAM;
+  size = morpho_EasyHDR_getBufferSize(width, height, format);
+  if (size <= 0)
+    return MORPHO_ERROR_PARAM;
+  buffer = malloc(size);
+  if (NULL == buffer)
+    return MORPHO_ERROR_MALLOC;
+
+  for (i = 0; i < 3; i++) {
+    in[i].width = width;
+    in[i].height = height;
+    in[i].dat.semi_planar.y = planes[i];
+    in[i].dat.semi_planar.uv = planes[i] + width * height;
+    inputs[i] = &in[i];
+  }
+  out.width = width;
+  out.height = height;
+  out.dat.semi_planar.y = pHDROutImage;
+  out.dat.semi_planar.uv = pHDROutImage + width * height;
+
+  rc = morpho_EasyHDR_initialize(&hdr, buffer, size,
+    (ncpu > 0) ? (int)ncpu : 1, NULL);
+  if (MORPHO_OK == rc) {
+    rc = morpho_EasyHDR_setImageFormat(&hdr, format);
+    if (MORPHO_OK == rc)
+      rc = morpho_EasyHDR_merge(&hdr, &out, inputs, 3);
+    morpho_EasyHDR_finalize(&hdr);
+  }
+  free(buffer);
+  return rc;
+}
@@ -0,0 +1,458 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+/* Exposure analysis and alignment stages of the HDR engine.
+ *
+ * Inputs are compared through median threshold bitmaps (MTB): every luma
+ * sample is classified as above or below the median of its own image, which
+ * does not depend on the exposure. Samples close to the median are left
+ * out. The global displacement of each input is searched coarse to fine on
+ * a luma pyramid and refined at full resolution; local alignment then
+ * refines it per tile within one pixel. Input 0 is the reference. */
+
+#include <stdlib.h>
+#include <string.h>
+#include "easy_hdr_int.h"
+
+/* samples closer than this to the median are not classified */
+#define HDR_MTB_TOLERANCE 4
+/* minimum classified samples for a match to count */
+#define HDR_MTB_MIN_COUNT 64
+/* full resolution search radius and sampling of the global alignment */
+#define HDR_GLOBAL_RADIUS 2
+#define HDR_GLOBAL_STEP 4
+/* local alignment search radius and sampling */
+#define HDR_LOCAL_RADIUS 1
+#define HDR_LOCAL_STEP 2
+/* mismatch rate under which a tile counts as aligned */
+#define HDR_TILE_MAX_ERROR 0.25f
+/* a tile leaves the global displacement only for a clearly better match */
+#define HDR_TILE_GAIN 0.9f
+/* share of aligned tiles, in percent, under which alignment failed */
+#define HDR_MIN_ALIGNED_TILES 50
+/* share of clipped samples, in percent, for a failed exposure estimation */
+#define HDR_MAX_CLIPPED 95
+
+/** hdr_mtb_t: MTB match of two planes
+*    @a, @b: reference and moving plane, same size
+*    @ma, @mb: medians of the planes
+*    @x0, @y0, @x1, @y1: compared region of the reference plane
+*    @step: sampling step
+**/
+typedef struct {
+  const hdr_plane_t *a;
+  const hdr_plane_t *b;
+  int ma;
+  int mb;
+  int x0;
+  int y0;
+  int x1;
+  int y1;
+  int step;
+} hdr_mtb_t;
+
+static inline int hdr_min(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+static inline int hdr_max(int a, int b)
+{
+  return a > b ? a : b;
+}
+
+/*==============================================================================
+* Function : hdr_mtb_error
+* Parameters: m, sx, sy
+* Return Value : mismatch rate 0..1, or 2 if too few samples were classified
+* Description: Compare the MTB of the reference region with the moving plane
+* displaced by (sx, sy)
+==============================================================================*/
+static float hdr_mtb_error(const hdr_mtb_t *m, int sx, int sy)
+{
+  const hdr_plane_t *a = m->a, *b = m->b;
+  int x0 = hdr_max(m->x0, -sx), x1 = hdr_min(m->x1, b->w - sx);
+  int y0 = hdr_max(m->y0, -sy), y1 = hdr_min(m->y1, b->h - sy);
+  uint32_t count = 0, diff = 0;
+  int x, y;
+
+  for (y = y0; y < y1; y += m->step) {
+    const uint8_t *pa = a->data + y * a->w;
+    const uint8_t *pb = b->data + (y + sy) * b->w + sx;
+    for (x = x0; x < x1; x += m->step) {
+      int da = pa[x] - m->ma, db = pb[x] - m->mb;
+      int va = (da > HDR_MTB_TOLERANCE) || (da < -HDR_MTB_TOLERANCE);
+      int vb = (db > HDR_MTB_TOLERANCE) || (db < -HDR_MTB_TOLERANCE);
+      if (va & vb) {
+        count++;
+        diff += (da > 0) ^ (db > 0);
+      }
+    }
+  }
+  if (count < HDR_MTB_MIN_COUNT)
+    return 2.0f;
+  return (float)diff / (float)count;
+}
+
+/*==============================================================================
+* Function : hdr_mtb_search
+* Parameters: m, radius, sx, sy
+* Return Value : best mismatch rate
+* Description: Search the displacement within radius of (*sx, *sy) with the
+* lowest mismatch. Ties keep the displacement closest to the start.
+==============================================================================*/
+static float hdr_mtb_search(const hdr_mtb_t *m, int radius, int *sx, int *sy)
+{
+  int cx = *sx, cy = *sy, i, j;
+  float best = hdr_mtb_error(m, cx, cy);
+
+  for (j = -radius; j <= radius; j++) {
+    for (i = -radius; i <= radius; i++) {
+      float err;
+      if (!i && !j)
+        continue;
+      err = hdr_mtb_error(m, cx + i, cy + j);
+      if (err < best) {
+        best = err;
+        *sx = cx + i;
+        *sy = cy + j;
+      }
+    }
+  }
+  return best;
+}
+
+/*==============================================================================
+* Function : hdr_pyramid_begin
+* Parameters: e
+* Return Value : number of tiles, one per band of level 0 rows per input
+* Description: Setup of the pyramid stage
+==============================================================================*/
+static int hdr_pyramid_begin(hdr_engine_t *e)
+{
+  int bands = (e->img[0].lvl[0].h * 4 + HDR_BAND_ROWS - 1) / HDR_BAND_ROWS;
+  return bands * e->nimages;
+}
+
+/*==============================================================================
+* Function : hdr_pyramid_tile
+* Parameters: e, idx
+* Return Value : None
+* Description: Build a band of pyramid level 0 of an input by averaging 4x4
+* luma blocks
+==============================================================================*/
+static void hdr_pyramid_tile(hdr_engine_t *e, int idx)
+{
+  hdr_plane_t *l0 = &e->img[0].lvl[0];
+  int rows = HDR_BAND_ROWS >> HDR_SMALL_SHIFT;
+  int bands = (l0->h + rows - 1) / rows;
+  int n = idx / bands, band = idx % bands;
+  hdr_plane_t *dst = &e->img[n].lvl[0];
+  int y0 = band * rows, y1 = hdr_min(y0 + rows, dst->h);
+  int x, y;
+
+  for (y = y0; y < y1; y++) {
+    const uint8_t *s0 = e->in[n].y + (y << HDR_SMALL_SHIFT) * e->width;
+    const uint8_t *s1 = s0 + e->width;
+    const uint8_t *s2 = s1 + e->width;
+    const uint8_t *s3 = s2 + e->width;
+    uint8_t *d = dst->data + y * dst->w;
+    for (x = 0; x < dst->w; x++) {
+      int i = x << HDR_SMALL_SHIFT;
+      uint32_t sum = s0[i] + s0[i + 1] + s0[i + 2] + s0[i + 3] +
+        s1[i] + s1[i + 1] + s1[i + 2] + s1[i + 3] +
+        s2[i] + s2[i + 1] + s2[i + 2] + s2[i + 3] +
+        s3[i] + s3[i + 1] + s3[i + 2] + s3[i + 3];
+      d[x] = (uint8_t)((sum + 8) >> 4);
+    }
+  }
+}
+
+/*==============================================================================
+* Function : hdr_exposure_map
+* Parameters: e, n
+* Return Value : None
+* Description: Match the luma histogram of input n to the reference, giving
+* the luma the reference shows for each luma of input n
+==============================================================================*/
+static void hdr_exposure_map(hdr_engine_t *e, int n)
+{
+  const uint32_t *hr = e->img[0].hist, *hn = e->img[n].hist;
+  uint64_t cr = 0, cn = 0, tr = 0, tn = 0;
+  int u = 0, v;
+
+  for (v = 0; v < 256; v++) {
+    tr += hr[v];
+    tn += hn[v];
+  }
+  cr = hr[0];
+  for (v = 0; v < 256; v++) {
+    cn += hn[v];
+    /* smallest u with cdf_ref(u) >= cdf_n(v) */
+    while ((u < 255) && (cr * tn < cn * tr))
+      cr += hr[++u];
+    e->img[n].map[v] = (uint8_t)u;
+  }
+}
+
+/*==============================================================================
+* Function : hdr_pyramid_end
+* Parameters: e
+* Return Value : MORPHO_OK
+* Description: Build the coarser pyramid levels, the histograms and the
+* exposure maps, and check for inputs whose exposure cannot be estimated
+==============================================================================*/
+static int hdr_pyramid_end(hdr_engine_t *e)
+{
+  int n, l, x, y, v;
+
+  for (n = 0; n < e->nimages; n++) {
+    hdr_image_t *img = &e->img[n];
+    const hdr_plane_t *l0 = &img->lvl[0];
+    uint32_t total = l0->w * l0->h, acc = 0, clipped;
+
+    for (l = 1; l < HDR_MAX_LEVELS && img->lvl[l].data; l++) {
+      const hdr_plane_t *s = &img->lvl[l - 1];
+      hdr_plane_t *d = &img->lvl[l];
+      for (y = 0; y < d->h; y++) {
+        const uint8_t *s0 = s->data + 2 * y * s->w, *s1 = s0 + s->w;
+        uint8_t *p = d->data + y * d->w;
+        for (x = 0; x < d->w; x++)
+          p[x] = (uint8_t)((s0[2 * x] + s0[2 * x + 1] + s1[2 * x] +
+            s1[2 * x + 1] + 2) >> 2);
+      }
+    }
+
+    memset(img->hist, 0, sizeof(img->hist));
+    for (y = 0; y < l0->h; y++) {
+      const uint8_t *p = l0->data + y * l0->w;
+      for (x = 0; x < l0->w; x++)
+        img->hist[p[x]]++;
+    }
+    for (v = 0; v < 256; v++) {
+      acc += img->hist[v];
+      if (acc * 2 >= total)
+        break;
+    }
+    img->median = v;
+
+    clipped = 0;
+    for (v = 0; v <= 4; v++)
+      clipped += img->hist[v] + img->hist[255 - v];
+    if (n && (clipped * 100 > total * HDR_MAX_CLIPPED)) {
+      img->status |= MORPHO_EASY_HDR_ERROR_EXP_ESTIMATION_FAILURE;
+      if (e->fail_soft)
+        img->excluded = 1;
+    }
+  }
+  for (n = 1; n < e->nimages; n++)
+    hdr_exposure_map(e, n);
+  return MORPHO_OK;
+}
+
+const hdr_stage_t hdr_stage_pyramid = {
+  hdr_pyramid_begin,
+  hdr_pyramid_tile,
+  hdr_pyramid_end,
+};
+
+/*==============================================================================
+* Function : hdr_align_global_begin
+* Parameters: e
+* Return Value : number of tiles, one per input after the reference
+* Description: Setup of the global alignment stage
+==============================================================================*/
+static int hdr_align_global_begin(hdr_engine_t *e)
+{
+  return e->alignment ? e->nimages - 1 : 0;
+}
+
+/*==============================================================================
+* Function : hdr_align_global_tile
+* Parameters: e, idx
+* Return Value : None
+* Description: Find the global displacement of one input, coarse to fine on
+* the pyramid and then at full resolution
+==============================================================================*/
+static void hdr_align_global_tile(hdr_engine_t *e, int idx)
+{
+  hdr_image_t *ref = &e->img[0], *img = &e->img[idx + 1];
+  hdr_plane_t fa, fb;
+  hdr_mtb_t m;
+  int sx = 0, sy = 0, l = HDR_MAX_LEVELS - 1;
+
+  if (img->excluded)
+    return;
+
+  while ((l > 0) && !ref->lvl[l].data)
+    l--;
+  for (; l >= 0; l--) {
+    const hdr_plane_t *a = &ref->lvl[l];
+    m.a = a;
+    m.b = &img->lvl[l];
+    m.ma = ref->median;
+    m.mb = img->median;
+    m.x0 = 0;
+    m.y0 = 0;
+    m.x1 = a->w;
+    m.y1 = a->h;
+    m.step = 1;
+    sx *= 2;
+    sy *= 2;
+    hdr_mtb_search(&m, 1, &sx, &sy);
+  }
+
+  fa.data = e->in[0].y;
+  fb.data = e->in[idx + 1].y;
+  fa.w = fb.w = e->width;
+  fa.h = fb.h = e->height;
+  m.a = &fa;
+  m.b = &fb;
+  m.x0 = 0;
+  m.y0 = 0;
+  m.x1 = e->width;
+  m.y1 = e->height;
+  m.step = HDR_GLOBAL_STEP;
+  sx *= 1 << HDR_SMALL_SHIFT;
+  sy *= 1 << HDR_SMALL_SHIFT;
+  hdr_mtb_search(&m, HDR_GLOBAL_RADIUS, &sx, &sy);
+  img->dx = sx;
+  img->dy = sy;
+}
+
+const hdr_stage_t hdr_stage_align_global = {
+  hdr_align_global_begin,
+  hdr_align_global_tile,
+  NULL,
+};
+
+/*==============================================================================
+* Function : hdr_align_local_begin
+* Parameters: e
+* Return Value : number of tiles, one per alignment tile per input after the
+* reference
+* Description: Setup of the local alignment stage
+==============================================================================*/
+static int hdr_align_local_begin(hdr_engine_t *e)
+{
+  return e->alignment ? e->atiles_x * e->atiles_y * (e->nimages - 1) : 0;
+}
+
+/*==============================================================================
+* Function : hdr_align_local_tile
+* Parameters: e, idx
+* Return Value : None
+* Description: Refine the displacement of one tile of one input around the
+* global displacement
+==============================================================================*/
+static void hdr_align_local_tile(hdr_engine_t *e, int idx)
+{
+  int ntiles = e->atiles_x * e->atiles_y;
+  int t = idx % ntiles;
+  hdr_image_t *ref = &e->img[0], *img = &e->img[idx / ntiles + 1];
+  int tx = t % e->atiles_x, ty = t / e->atiles_x;
+  hdr_plane_t fa, fb;
+  hdr_mtb_t m;
+  int sx = img->dx, sy = img->dy;
+  float base, best;
+
+  if (img->excluded)
+    return;
+
+  fa.data = e->in[0].y;
+  fb.data = e->in[idx / ntiles + 1].y;
+  fa.w = fb.w = e->width;
+  fa.h = fb.h = e->height;
+  m.a = &fa;
+  m.b = &fb;
+  m.ma = ref->median;
+  m.mb = img->median;
+  m.x0 = tx * HDR_ALIGN_TILE;
+  m.y0 = ty * HDR_ALIGN_TILE;
+  m.x1 = hdr_min(m.x0 + HDR_ALIGN_TILE, e->width);
+  m.y1 = hdr_min(m.y0 + HDR_ALIGN_TILE, e->height);
+  m.step = HDR_LOCAL_STEP;
+
+  base = hdr_mtb_error(&m, sx, sy);
+  best = hdr_mtb_search(&m, HDR_LOCAL_RADIUS, &sx, &sy);
+  if (best > 1.0f) {
+    img->tile_ok[t] = -1;
+    sx = img->dx;
+    sy = img->dy;
+  } else {
+    img->tile_ok[t] = (best < HDR_TILE_MAX_ERROR) ? 1 : 0;
+    if ((img->tile_ok[t] != 1) || (best >= base * HDR_TILE_GAIN)) {
+      sx = img->dx;
+      sy = img->dy;
+    }
+  }
+  img->ldx[t] = (int8_t)(sx - img->dx);
+  img->ldy[t] = (int8_t)(sy - img->dy);
+}
+
+/*==============================================================================
+* Function : hdr_align_local_end
+* Parameters: e
+* Return Value : MORPHO_OK
+* Description: Judge the alignment of every input from its tiles and update
+* the reliable area of the merge
+==============================================================================*/
+static int hdr_align_local_end(hdr_engine_t *e)
+{
+  int ntiles = e->atiles_x * e->atiles_y;
+  int n, t;
+
+  if (!e->alignment)
+    return MORPHO_OK;
+
+  for (n = 1; n < e->nimages; n++) {
+    hdr_image_t *img = &e->img[n];
+    int ok = 0, judged = 0;
+
+    if (img->excluded)
+      continue;
+    for (t = 0; t < ntiles; t++) {
+      if (img->tile_ok[t] < 0)
+        continue;
+      judged++;
+      ok += img->tile_ok[t];
+    }
+    if (judged && (ok * 100 < judged * HDR_MIN_ALIGNED_TILES)) {
+      img->status |= MORPHO_EASY_HDR_ERROR_IMAGE_ALIGNMENT_FAILURE;
+      if (e->fail_soft)
+        img->excluded = 1;
+    }
+  }
+  hdr_update_reliable(e);
+  return MORPHO_OK;
+}
+
+const hdr_stage_t hdr_stage_align_local = {
+  hdr_align_local_begin,
+  hdr_align_local_tile,
+  hdr_align_local_end,
+};
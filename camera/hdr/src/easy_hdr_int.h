@@ -0,0 +1,246 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+#ifndef EASY_HDR_INT_H
+#define EASY_HDR_INT_H
+
+#include <stdint.h>
+#include "morpho_easy_hdr.h"
+
+/* luma pixels per side of a weight/ghost cell */
+#define HDR_CELL_SHIFT 4
+#define HDR_CELL (1 << HDR_CELL_SHIFT)
+/* the alignment pyramid starts at 1/4 of the full resolution */
+#define HDR_SMALL_SHIFT 2
+/* cells per side of a merge tile */
+#define HDR_MERGE_TILE_CELLS 4
+/* luma pixels per side of a local alignment tile */
+#define HDR_ALIGN_TILE 128
+/* luma rows per band of the pyramid and scaling stages */
+#define HDR_BAND_ROWS 64
+#define HDR_MAX_LEVELS 6
+#define HDR_MAX_THREADS 16
+#define HDR_FORMAT_LEN 32
+
+typedef enum {
+  HDR_STATE_INITIALIZED = 1,
+  HDR_STATE_PROCESSING,
+  HDR_STATE_SUSPENDED,
+  HDR_STATE_PAUSED,
+} hdr_state_t;
+
+/** hdr_plane_t: 8 bit plane, rows are packed
+*    @data: first sample
+*    @w: width in samples
+*    @h: height in rows
+**/
+typedef struct {
+  uint8_t *data;
+  int w;
+  int h;
+} hdr_plane_t;
+
+/** hdr_frame_t: YUV 4:2:0 frame
+*    @y: luma plane
+*    @u: interleaved chroma for semi-planar, first chroma plane
+*       otherwise
+*    @v: second chroma plane, NULL for semi-planar
+**/
+typedef struct {
+  uint8_t *y;
+  uint8_t *u;
+  uint8_t *v;
+} hdr_frame_t;
+
+/** hdr_image_t: per input state of a merge
+*    @lvl: luma pyramid, level 0 is 1/4 of the full resolution
+*    @hist: luma histogram of pyramid level 0
+*    @median: median luma, threshold of the MTB bitmaps
+*    @map: maps luma of this input to the reference exposure
+*    @dx, @dy: global displacement, input pixel = output pixel + d
+*    @ldx, @ldy: per alignment tile displacement, relative to dx/dy
+*    @tile_ok: per alignment tile match result, 1 aligned, 0 failed,
+*       -1 not enough texture to judge
+*    @ghost: per cell ghost flag
+*    @judged: per cell flag, 1 if the ghost test had enough samples
+*    @mean: per cell mean exposure weight
+*    @wa, @wb: weight grids on cell corners, see easy_hdr_merge.c
+*    @status: MORPHO_EASY_HDR_ERROR_* bits of this input
+*    @excluded: left out of the merge by fail-soft merging
+**/
+typedef struct {
+  hdr_plane_t lvl[HDR_MAX_LEVELS];
+  uint32_t hist[256];
+  int median;
+  uint8_t map[256];
+  int dx;
+  int dy;
+  int8_t *ldx;
+  int8_t *ldy;
+  int8_t *tile_ok;
+  uint8_t *ghost;
+  uint8_t *judged;
+  float *mean;
+  float *wa;
+  float *wb;
+  int status;
+  int excluded;
+} hdr_image_t;
+
+typedef struct hdr_engine hdr_engine_t;
+
+/** hdr_stage_t: one step of the merge
+*    @begin: serial setup, returns the number of tiles
+*    @tile: processes one tile, called in parallel
+*    @end: serial completion, returns a MORPHO error code
+**/
+typedef struct {
+  int (*begin)(hdr_engine_t *e);
+  void (*tile)(hdr_engine_t *e, int idx);
+  int (*end)(hdr_engine_t *e);
+} hdr_stage_t;
+
+/** hdr_pool_t: worker threads sharing the tiles of a stage
+*    @cb: thread and lock primitives
+*    @lock, @cond_work, @cond_done: pool synchronization
+*    @threads: worker threads
+*    @nworkers: number of workers, the caller thread also runs tiles
+*    @ctx: context handed to the tile function
+*    @tile: tile function of the running stage, NULL when idle
+*    @next: next tile to hand out
+*    @end: one past the last tile
+*    @busy: tiles being run
+*    @stop: no new tiles are handed out (suspend)
+*    @quit: workers exit
+**/
+typedef struct {
+  morpho_EasyHDR_Callback cb;
+  void *lock;
+  void *cond_work;
+  void *cond_done;
+  void *threads[HDR_MAX_THREADS];
+  int nworkers;
+  void *ctx;
+  void (*tile)(void *ctx, int idx);
+  int next;
+  int end;
+  int busy;
+  int stop;
+  int quit;
+} hdr_pool_t;
+
+struct hdr_engine {
+  /* parameters */
+  int alignment;
+  int ghost_removal;
+  int auto_scaling;
+  int face_detection;
+  int fail_soft;
+  int ghost_sensitivity;
+  int smoothness;
+  int merge_param[4];
+  int reliable_rate;
+  int ghost_rate;
+  int cc[6];
+  int format_set;
+  int planar;
+  char format[HDR_FORMAT_LEN];
+
+  /* memory and threads */
+  uint8_t *work;
+  int work_size;
+  int step_mode;
+  hdr_pool_t pool;
+
+  /* current merge */
+  hdr_state_t state;
+  int status;
+  int width;
+  int height;
+  int nimages;
+  hdr_frame_t in[MORPHO_EASY_HDR_MAX_NIMAGES];
+  hdr_frame_t out;
+  hdr_frame_t dst;
+  hdr_image_t img[MORPHO_EASY_HDR_MAX_NIMAGES];
+  int cells_x;
+  int cells_y;
+  int atiles_x;
+  int atiles_y;
+  uint8_t *tmp_u8;
+  float *tmp_f0;
+  float *tmp_f1;
+  hdr_frame_t scratch;
+  morpho_RectInt reliable;
+  morpho_RectInt crop;
+
+  /* exposure weight, see easy_hdr_merge.c */
+  float hat_mid;
+  float hat_irl;
+  float hat_irh;
+  float hat_floor;
+  float hat_lut[256];
+  uint8_t ylut[256];
+  uint8_t clut[256];
+  int cc_identity;
+
+  /* stage machine */
+  int stage;
+  int stage_begun;
+  int ntiles;
+  int cursor;
+};
+
+/* work memory and per merge setup, see easy_hdr_merge.c */
+int hdr_work_size(int width, int height, int nimages);
+int hdr_carve_work(hdr_engine_t *e);
+void hdr_setup_luts(hdr_engine_t *e);
+void hdr_update_reliable(hdr_engine_t *e);
+
+/* stages, in execution order */
+extern const hdr_stage_t hdr_stage_pyramid;
+extern const hdr_stage_t hdr_stage_align_global;
+extern const hdr_stage_t hdr_stage_align_local;
+extern const hdr_stage_t hdr_stage_ghost;
+extern const hdr_stage_t hdr_stage_merge;
+extern const hdr_stage_t hdr_stage_scale;
+
+/* thread pool, see easy_hdr_pool.c. Also used by the noise reduction
+ * engine, which does not depend on the rest of the HDR engine. */
+int hdr_pool_init(hdr_pool_t *pool, int nworkers,
+  const morpho_EasyHDR_Callback *cb);
+void hdr_pool_deinit(hdr_pool_t *pool);
+int hdr_pool_run(hdr_pool_t *pool, void *ctx,
+  void (*tile)(void *ctx, int idx), int start, int end);
+void hdr_pool_set_stop(hdr_pool_t *pool, int stop);
+int hdr_pool_get_stop(hdr_pool_t *pool);
+
+/* resampling shared with the thumbnail, see easy_hdr_merge.c */
+void hdr_scale_rows(const hdr_frame_t *src, int sw, int sh,
+  const morpho_RectInt *crop, const hdr_frame_t *dst, int dw, int dh,
+  int planar, int y0, int y1);
+
+#endif
@@ -0,0 +1,933 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+/* Ghost detection, exposure fusion and scaling stages of the HDR engine.
+ *
+ * Every output pixel is the weighted mean of the aligned inputs. The weight
+ * of an input is
+ *
+ *   W(x, y) = A(x, y) * hat(Y) + B(x, y)
+ *
+ * where hat() favours well exposed luma (merge parameters: value1 low end,
+ * value2 peak, value3 floor of the weight, value4 high end) and A, B are
+ * bilinear over the corners of 16x16 cells. Per cell, with g = 0 on ghost
+ * cells and 1 elsewhere, m the mean hat() of the cell and s the smoothness
+ * level / 10, A comes from (1 - s) * g and B from s * g * m, both box
+ * filtered over neighbouring cells: a smooth merge follows the cell means,
+ * a sharp one the per pixel exposure. Ghost cells are taken from the
+ * reference only. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "easy_hdr_int.h"
+#include "easy_hdr_simd.h"
+
+#define HDR_ALIGN(x) (((x) + 15) & ~15)
+/* coarsest pyramid level kept, in level pixels */
+#define HDR_MIN_LEVEL_SIZE 64
+/* ghost test: usable luma range, samples per judged cell */
+#define HDR_GHOST_LUMA_MIN 8
+#define HDR_GHOST_LUMA_MAX 247
+#define HDR_GHOST_MIN_SAMPLES 4
+/* keeps the reference weight above zero */
+#define HDR_REF_EPS 1e-4f
+
+static inline int hdr_min(int a, int b)
+{
+  return a < b ? a : b;
+}
+
+static inline int hdr_max(int a, int b)
+{
+  return a > b ? a : b;
+}
+
+static inline int hdr_clamp(int v, int lo, int hi)
+{
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+/*==============================================================================
+* Function : hdr_layout
+* Parameters: e, base, width, height, nimages
+* Return Value : bytes of work memory used
+* Description: Lay out the work memory of a merge. Only computes the size
+* when e is NULL, otherwise also points the engine buffers into base.
+==============================================================================*/
+static int hdr_layout(hdr_engine_t *e, uint8_t *base, int width, int height,
+  int nimages)
+{
+  int cells_x = (width + HDR_CELL - 1) >> HDR_CELL_SHIFT;
+  int cells_y = (height + HDR_CELL - 1) >> HDR_CELL_SHIFT;
+  int ncells = cells_x * cells_y;
+  int ncorners = (cells_x + 1) * (cells_y + 1);
+  int ntiles = ((width + HDR_ALIGN_TILE - 1) / HDR_ALIGN_TILE) *
+    ((height + HDR_ALIGN_TILE - 1) / HDR_ALIGN_TILE);
+  int w0 = width >> HDR_SMALL_SHIFT, h0 = height >> HDR_SMALL_SHIFT;
+  int off = 0, n, l;
+
+#define HDR_TAKE(ptr, type, count) \
+  do { \
+    if (e) \
+      (ptr) = (type *)(base + off); \
+    off += HDR_ALIGN((int)sizeof(type) * (count)); \
+  } while (0)
+
+  for (n = 0; n < nimages; n++) {
+    hdr_image_t *img = e ? &e->img[n] : NULL;
+    for (l = 0; l < HDR_MAX_LEVELS; l++) {
+      int lw = w0 >> l, lh = h0 >> l;
+      if (l && ((lw < HDR_MIN_LEVEL_SIZE) || (lh < HDR_MIN_LEVEL_SIZE)))
+        break;
+      if (img) {
+        img->lvl[l].w = lw;
+        img->lvl[l].h = lh;
+      }
+      HDR_TAKE(img->lvl[l].data, uint8_t, lw * lh);
+    }
+    HDR_TAKE(img->ldx, int8_t, ntiles);
+    HDR_TAKE(img->ldy, int8_t, ntiles);
+    HDR_TAKE(img->tile_ok, int8_t, ntiles);
+    HDR_TAKE(img->ghost, uint8_t, ncells);
+    HDR_TAKE(img->judged, uint8_t, ncells);
+    HDR_TAKE(img->mean, float, ncells);
+    HDR_TAKE(img->wa, float, ncorners);
+    HDR_TAKE(img->wb, float, ncorners);
+  }
+  HDR_TAKE(e->tmp_u8, uint8_t, ncells);
+  HDR_TAKE(e->tmp_f0, float, ncells);
+  HDR_TAKE(e->tmp_f1, float, ncells);
+  HDR_TAKE(e->scratch.y, uint8_t, width * height * 3 / 2);
+#undef HDR_TAKE
+
+  return off;
+}
+
+/*==============================================================================
+* Function : hdr_work_size
+* Parameters: width, height, nimages
+* Return Value : bytes of work memory
+* Description: Work memory needed to merge nimages inputs of the given size
+==============================================================================*/
+int hdr_work_size(int width, int height, int nimages)
+{
+  return hdr_layout(NULL, NULL, width, height, nimages);
+}
+
+/*==============================================================================
+* Function : hdr_carve_work
+* Parameters: e
+* Return Value : MORPHO_OK or MORPHO_ERROR_MALLOC
+* Description: Point the merge buffers into the work memory and reset the
+* per input state of the merge described by e
+==============================================================================*/
+int hdr_carve_work(hdr_engine_t *e)
+{
+  int n;
+
+  if (hdr_work_size(e->width, e->height, e->nimages) > e->work_size)
+    return MORPHO_ERROR_MALLOC;
+
+  memset(e->img, 0, sizeof(e->img));
+  hdr_layout(e, e->work, e->width, e->height, e->nimages);
+  e->cells_x = (e->width + HDR_CELL - 1) >> HDR_CELL_SHIFT;
+  e->cells_y = (e->height + HDR_CELL - 1) >> HDR_CELL_SHIFT;
+  e->atiles_x = (e->width + HDR_ALIGN_TILE - 1) / HDR_ALIGN_TILE;
+  e->atiles_y = (e->height + HDR_ALIGN_TILE - 1) / HDR_ALIGN_TILE;
+  e->scratch.u = e->scratch.y + e->width * e->height;
+  e->scratch.v = e->planar ?
+    e->scratch.u + (e->width / 2) * (e->height / 2) : NULL;
+
+  for (n = 0; n < e->nimages; n++) {
+    int ntiles = e->atiles_x * e->atiles_y;
+    memset(e->img[n].ldx, 0, ntiles);
+    memset(e->img[n].ldy, 0, ntiles);
+    memset(e->img[n].tile_ok, -1, ntiles);
+    memset(e->img[n].ghost, 0, e->cells_x * e->cells_y);
+    memset(e->img[n].judged, 0, e->cells_x * e->cells_y);
+  }
+  return MORPHO_OK;
+}
+
+/*==============================================================================
+* Function : hdr_setup_luts
+* Parameters: e
+* Return Value : None
+* Description: Derive the exposure weight and the color correction tables
+* from the parameters. Color correction maps luma as
+* offset + gain * 255 * (y / 255) ^ (1 / gamma) and scales the distance of
+* chroma from 128 the same way, gain and gamma in 1/1000 units.
+==============================================================================*/
+void hdr_setup_luts(hdr_engine_t *e)
+{
+  int lo = e->merge_param[0], mid = e->merge_param[1];
+  int hi = e->merge_param[3];
+  float ye, yg, ce, cg;
+  int v;
+
+  e->hat_mid = (float)mid;
+  e->hat_irl = 1.0f / (float)hdr_max(mid - lo, 1);
+  e->hat_irh = 1.0f / (float)hdr_max(hi - mid, 1);
+  e->hat_floor = (float)e->merge_param[2] / 255.0f;
+  for (v = 0; v < 256; v++) {
+    float d = (float)(v - mid);
+    float t = d * (d < 0.0f ? e->hat_irl : e->hat_irh);
+    float h = 1.0f - t * t;
+    e->hat_lut[v] = e->hat_floor +
+      (1.0f - e->hat_floor) * (h > 0.0f ? h : 0.0f);
+  }
+
+  e->cc_identity = !e->cc[0] && (1000 == e->cc[1]) && (1000 == e->cc[2]) &&
+    !e->cc[3] && (1000 == e->cc[4]) && (1000 == e->cc[5]);
+  yg = (float)e->cc[1] / 1000.0f;
+  ye = 1000.0f / (float)e->cc[2];
+  cg = (float)e->cc[4] / 1000.0f;
+  ce = 1000.0f / (float)e->cc[5];
+  for (v = 0; v < 256; v++) {
+    float y = (float)e->cc[0] + yg * 255.0f * powf(v / 255.0f, ye);
+    float d = (float)(v - 128);
+    float c = cg * 128.0f * powf(fabsf(d) / 128.0f, ce);
+    c = (float)e->cc[3] + 128.0f + (d < 0.0f ? -c : c);
+    e->ylut[v] = (uint8_t)hdr_clamp((int)(y + 0.5f), 0, 255);
+    e->clut[v] = (uint8_t)hdr_clamp((int)(c + 0.5f), 0, 255);
+  }
+}
+
+/*==============================================================================
+* Function : hdr_update_reliable
+* Parameters: e
+* Return Value : None
+* Description: Compute the area covered by every merged input after
+* alignment, fail inputs that do not cover the central reliable rect rate of
+* the frame, and choose the crop scaled back to the full frame
+==============================================================================*/
+void hdr_update_reliable(hdr_engine_t *e)
+{
+  int ntiles = e->atiles_x * e->atiles_y;
+  int cw = e->width * e->reliable_rate / 100;
+  int ch = e->height * e->reliable_rate / 100;
+  int csx = (e->width - cw) / 2, csy = (e->height - ch) / 2;
+  morpho_RectInt r;
+  int n, t;
+
+  r.sx = 0;
+  r.sy = 0;
+  r.ex = e->width;
+  r.ey = e->height;
+  for (n = 1; n < e->nimages; n++) {
+    hdr_image_t *img = &e->img[n];
+    int minx = 0, maxx = 0, miny = 0, maxy = 0;
+    int sx, sy, ex, ey;
+
+    if (img->excluded)
+      continue;
+    for (t = 0; t < ntiles; t++) {
+      minx = hdr_min(minx, img->ldx[t]);
+      maxx = hdr_max(maxx, img->ldx[t]);
+      miny = hdr_min(miny, img->ldy[t]);
+      maxy = hdr_max(maxy, img->ldy[t]);
+    }
+    /* output x reads input x + d, valid while 0 <= x + d < width */
+    sx = hdr_max(0, -(img->dx + minx));
+    sy = hdr_max(0, -(img->dy + miny));
+    ex = hdr_min(e->width, e->width - (img->dx + maxx));
+    ey = hdr_min(e->height, e->height - (img->dy + maxy));
+    if ((sx > csx) || (sy > csy) || (ex < csx + cw) || (ey < csy + ch)) {
+      img->status |= MORPHO_EASY_HDR_ERROR_IMAGE_ALIGNMENT_FAILURE;
+      if (e->fail_soft) {
+        img->excluded = 1;
+        continue;
+      }
+    }
+    r.sx = hdr_max(r.sx, sx);
+    r.sy = hdr_max(r.sy, sy);
+    r.ex = hdr_min(r.ex, ex);
+    r.ey = hdr_min(r.ey, ey);
+  }
+  r.sx = (r.sx + 1) & ~1;
+  r.sy = (r.sy + 1) & ~1;
+  r.ex &= ~1;
+  r.ey &= ~1;
+  if ((r.ex - r.sx < 2) || (r.ey - r.sy < 2)) {
+    r.sx = 0;
+    r.sy = 0;
+    r.ex = e->width;
+    r.ey = e->height;
+  }
+  e->reliable = r;
+
+  e->crop.sx = 0;
+  e->crop.sy = 0;
+  e->crop.ex = e->width;
+  e->crop.ey = e->height;
+  if (e->auto_scaling) {
+    int rw = r.ex - r.sx, rh = r.ey - r.sy, w, h;
+    if ((int64_t)rw * e->height >= (int64_t)rh * e->width) {
+      h = rh;
+      w = (int)((int64_t)rh * e->width / e->height) & ~1;
+    } else {
+      w = rw;
+      h = (int)((int64_t)rw * e->height / e->width) & ~1;
+    }
+    e->crop.sx = r.sx + (((rw - w) / 2) & ~1);
+    e->crop.sy = r.sy + (((rh - h) / 2) & ~1);
+    e->crop.ex = e->crop.sx + w;
+    e->crop.ey = e->crop.sy + h;
+  }
+}
+
+/*==============================================================================
+* Function : hdr_cell_shift
+* Parameters: e, img, cx, cy, dx, dy
+* Return Value : None
+* Description: Displacement of an input on a cell, global plus local
+==============================================================================*/
+static inline void hdr_cell_shift(const hdr_engine_t *e,
+  const hdr_image_t *img, int cx, int cy, int *dx, int *dy)
+{
+  int t = ((cy << HDR_CELL_SHIFT) / HDR_ALIGN_TILE) * e->atiles_x +
+    (cx << HDR_CELL_SHIFT) / HDR_ALIGN_TILE;
+
+  *dx = img->dx + img->ldx[t];
+  *dy = img->dy + img->ldy[t];
+}
+
+/*==============================================================================
+* Function : hdr_ghost_begin
+* Parameters: e
+* Return Value : number of tiles, one per row of cells
+* Description: Setup of the ghost detection stage
+==============================================================================*/
+static int hdr_ghost_begin(hdr_engine_t *e)
+{
+  return e->cells_y;
+}
+
+/*==============================================================================
+* Function : hdr_ghost_sample
+* Parameters: p, w
+* Return Value : mean of the 2x2 block at p
+* Description: Ghost test sample, averaged to be less sensitive to noise
+==============================================================================*/
+static inline int hdr_ghost_sample(const uint8_t *p, int w)
+{
+  return (p[0] + p[1] + p[w] + p[w + 1] + 2) >> 2;
+}
+
+/*==============================================================================
+* Function : hdr_ghost_tile
+* Parameters: e, idx
+* Return Value : None
+* Description: For one row of cells, compute the mean exposure weight of
+* every input and compare the non reference inputs, mapped to the reference
+* exposure, with the reference. Samples are 2x2 blocks at the exact
+* displacement of the input.
+==============================================================================*/
+static void hdr_ghost_tile(hdr_engine_t *e, int idx)
+{
+  const int w = e->width, h = e->height;
+  const uint8_t *ref = e->in[0].y;
+  int thr = 6 + (MORPHO_EASY_HDR_GHOST_DETECTION_SENSITIVITY_LEVEL_MAX -
+    e->ghost_sensitivity) * 3;
+  int cx, n, x, y;
+
+  for (cx = 0; cx < e->cells_x; cx++) {
+    int c = idx * e->cells_x + cx;
+    int x0 = cx << HDR_CELL_SHIFT, y0 = idx << HDR_CELL_SHIFT;
+    int x1 = hdr_min(x0 + HDR_CELL, w), y1 = hdr_min(y0 + HDR_CELL, h);
+
+    for (n = 0; n < e->nimages; n++) {
+      hdr_image_t *img = &e->img[n];
+      const uint8_t *src = e->in[n].y, *map = img->map;
+      int dx = 0, dy = 0, count = 0, diff = 0, total = 0;
+      float sum = 0.0f;
+
+      if (img->excluded)
+        continue;
+      if (n)
+        hdr_cell_shift(e, img, cx, idx, &dx, &dy);
+
+      for (y = y0; y < y1; y += 2) {
+        int iy = hdr_clamp(y + dy, 0, h - 2);
+        for (x = x0; x < x1; x += 2) {
+          int ix = hdr_clamp(x + dx, 0, w - 2);
+          int yi = hdr_ghost_sample(src + iy * w + ix, w);
+          int yr;
+
+          sum += e->hat_lut[yi];
+          total++;
+          if (!n || (iy != y + dy) || (ix != x + dx))
+            continue;
+          yr = hdr_ghost_sample(ref + y * w + x, w);
+          if ((yr < HDR_GHOST_LUMA_MIN) || (yr > HDR_GHOST_LUMA_MAX) ||
+            (yi < HDR_GHOST_LUMA_MIN) || (yi > HDR_GHOST_LUMA_MAX))
+            continue;
+          diff += abs(map[yi] - yr);
+          count++;
+        }
+      }
+      img->mean[c] = sum / (float)total;
+      if (n && e->ghost_removal && (count >= HDR_GHOST_MIN_SAMPLES)) {
+        img->judged[c] = 1;
+        img->ghost[c] = (diff > thr * count);
+      }
+    }
+  }
+}
+
+/*==============================================================================
+* Function : hdr_box_blur
+* Parameters: e, f, radius
+* Return Value : None
+* Description: Separable box filter of a cell field, in place
+==============================================================================*/
+static void hdr_box_blur(hdr_engine_t *e, float *f, int radius)
+{
+  int cx = e->cells_x, cy = e->cells_y;
+  float *t = e->tmp_f1;
+  int x, y, k;
+
+  if (radius <= 0)
+    return;
+  for (y = 0; y < cy; y++) {
+    for (x = 0; x < cx; x++) {
+      int a = hdr_max(x - radius, 0), b = hdr_min(x + radius, cx - 1);
+      float s = 0.0f;
+      for (k = a; k <= b; k++)
+        s += f[y * cx + k];
+      t[y * cx + x] = s / (float)(b - a + 1);
+    }
+  }
+  for (y = 0; y < cy; y++) {
+    int a = hdr_max(y - radius, 0), b = hdr_min(y + radius, cy - 1);
+    for (x = 0; x < cx; x++) {
+      float s = 0.0f;
+      for (k = a; k <= b; k++)
+        s += t[k * cx + x];
+      f[y * cx + x] = s / (float)(b - a + 1);
+    }
+  }
+}
+
+/*==============================================================================
+* Function : hdr_to_corners
+* Parameters: e, f, scale, corners
+* Return Value : None
+* Description: Sample a cell field on the cell corners, scaled
+==============================================================================*/
+static void hdr_to_corners(hdr_engine_t *e, const float *f, float scale,
+  float *corners)
+{
+  int cx = e->cells_x, cy = e->cells_y;
+  int x, y;
+
+  for (y = 0; y <= cy; y++) {
+    int y0 = hdr_max(y - 1, 0), y1 = hdr_min(y, cy - 1);
+    for (x = 0; x <= cx; x++) {
+      int x0 = hdr_max(x - 1, 0), x1 = hdr_min(x, cx - 1);
+      float s = f[y0 * cx + x0] + f[y0 * cx + x1] + f[y1 * cx + x0] +
+        f[y1 * cx + x1];
+      corners[y * (cx + 1) + x] = s * 0.25f * scale;
+    }
+  }
+}
+
+/*==============================================================================
+* Function : hdr_ghost_end
+* Parameters: e
+* Return Value : MORPHO_OK
+* Description: Judge the ghost rate of every input, grow the ghost areas by
+* a cell and build the weight grids of the merge
+==============================================================================*/
+static int hdr_ghost_end(hdr_engine_t *e)
+{
+  int ncells = e->cells_x * e->cells_y;
+  int radius = (e->smoothness + 1) / 2;
+  float s = (float)e->smoothness /
+    (float)MORPHO_EASY_HDR_MERGE_SMOOTHNESS_LEVEL_MAX;
+  int n, c, x, y;
+
+  for (n = 1; n < e->nimages && e->ghost_removal; n++) {
+    hdr_image_t *img = &e->img[n];
+    int ghosts = 0, judged = 0;
+
+    if (img->excluded)
+      continue;
+    for (c = 0; c < ncells; c++) {
+      judged += img->judged[c];
+      ghosts += img->ghost[c];
+    }
+    if (judged && (ghosts * 100 > judged * e->ghost_rate)) {
+      img->status |= MORPHO_EASY_HDR_ERROR_MOSTLY_GHOST;
+      if (e->fail_soft) {
+        img->excluded = 1;
+        continue;
+      }
+    }
+    for (y = 0; y < e->cells_y; y++) {
+      for (x = 0; x < e->cells_x; x++) {
+        int x0 = hdr_max(x - 1, 0), x1 = hdr_min(x + 1, e->cells_x - 1);
+        int y0 = hdr_max(y - 1, 0), y1 = hdr_min(y + 1, e->cells_y - 1);
+        int i, j, g = 0;
+        for (j = y0; j <= y1; j++)
+          for (i = x0; i <= x1; i++)
+            g |= img->ghost[j * e->cells_x + i];
+        e->tmp_u8[y * e->cells_x + x] = (uint8_t)g;
+      }
+    }
+    memcpy(img->ghost, e->tmp_u8, ncells);
+  }
+
+  for (n = 0; n < e->nimages; n++) {
+    hdr_image_t *img = &e->img[n];
+
+    if (img->excluded)
+      continue;
+    for (c = 0; c < ncells; c++)
+      e->tmp_f0[c] = img->ghost[c] ? 0.0f : 1.0f;
+    hdr_box_blur(e, e->tmp_f0, radius);
+    hdr_to_corners(e, e->tmp_f0, 1.0f - s, img->wa);
+    for (c = 0; c < ncells; c++)
+      e->tmp_f0[c] = img->ghost[c] ? 0.0f : img->mean[c];
+    hdr_box_blur(e, e->tmp_f0, radius);
+    hdr_to_corners(e, e->tmp_f0, s, img->wb);
+  }
+  return MORPHO_OK;
+}
+
+const hdr_stage_t hdr_stage_ghost = {
+  hdr_ghost_begin,
+  hdr_ghost_tile,
+  hdr_ghost_end,
+};
+
+/** hdr_src_t: an input taking part in the merge of a cell
+*    @img: input state
+*    @f: input frame
+*    @dx, @dy: displacement on the cell
+*    @wa, @wb: top left corner of the cell in the weight grids
+*    @eps: weight added to the reference
+**/
+typedef struct {
+  const hdr_image_t *img;
+  const hdr_frame_t *f;
+  int dx;
+  int dy;
+  const float *wa;
+  const float *wb;
+  float eps;
+} hdr_src_t;
+
+/*==============================================================================
+* Function : hdr_merge_sources
+* Parameters: e, cx, cy, src
+* Return Value : number of sources
+* Description: List the inputs merged on a cell
+==============================================================================*/
+static int hdr_merge_sources(hdr_engine_t *e, int cx, int cy, hdr_src_t *src)
+{
+  int corner = cy * (e->cells_x + 1) + cx;
+  int n, k = 0;
+
+  for (n = 0; n < e->nimages; n++) {
+    const hdr_image_t *img = &e->img[n];
+    if (img->excluded)
+      continue;
+    src[k].img = img;
+    src[k].f = &e->in[n];
+    src[k].dx = 0;
+    src[k].dy = 0;
+    if (n)
+      hdr_cell_shift(e, img, cx, cy, &src[k].dx, &src[k].dy);
+    src[k].wa = img->wa + corner;
+    src[k].wb = img->wb + corner;
+    src[k].eps = n ? 0.0f : HDR_REF_EPS;
+    k++;
+  }
+  return k;
+}
+
+/*==============================================================================
+* Function : hdr_merge_cell_simd
+* Parameters: e, src, k, x0, y0
+* Return Value : None
+* Description: Merge a full cell whose sources all lie inside the inputs,
+* four pixels per vector
+==============================================================================*/
+static void hdr_merge_cell_simd(hdr_engine_t *e, const hdr_src_t *src, int k,
+  int x0, int y0)
+{
+  const int w = e->width, stride = e->cells_x + 1;
+  const hdr_frame_t *dst = &e->dst;
+  const hv4f mid = hv_set1(e->hat_mid), irl = hv_set1(e->hat_irl);
+  const hv4f irh = hv_set1(e->hat_irh), fl = hv_set1(e->hat_floor);
+  const hv4f gain = hv_set1(1.0f - e->hat_floor);
+  const hv4f one = hv_set1(1.0f), zero = hv_set1(0.0f);
+  float cw[MORPHO_EASY_HDR_MAX_NIMAGES][HDR_CELL];
+  hv4f fx[HDR_CELL / 4];
+  int r, q, i, j;
+
+  for (q = 0; q < HDR_CELL / 4; q++)
+    fx[q] = hv_set4((4 * q + 0.5f) / HDR_CELL, (4 * q + 1.5f) / HDR_CELL,
+      (4 * q + 2.5f) / HDR_CELL, (4 * q + 3.5f) / HDR_CELL);
+
+  for (r = 0; r < HDR_CELL; r++) {
+    int y = y0 + r;
+    float fy = (r + 0.5f) / HDR_CELL;
+    hv4f num[HDR_CELL / 4], den[HDR_CELL / 4];
+    uint8_t *out = dst->y + y * w + x0;
+
+    for (q = 0; q < HDR_CELL / 4; q++) {
+      num[q] = zero;
+      den[q] = zero;
+    }
+    for (i = 0; i < k; i++) {
+      const hdr_src_t *s = &src[i];
+      const uint8_t *p = s->f->y + (y + s->dy) * w + x0 + s->dx;
+      float al = s->wa[0] + (s->wa[stride] - s->wa[0]) * fy;
+      float ar = s->wa[1] + (s->wa[stride + 1] - s->wa[1]) * fy;
+      float bl = s->wb[0] + (s->wb[stride] - s->wb[0]) * fy;
+      float br = s->wb[1] + (s->wb[stride + 1] - s->wb[1]) * fy;
+      hv4f va = hv_set1(al), vda = hv_set1(ar - al);
+      hv4f vb = hv_set1(bl + s->eps), vdb = hv_set1(br - bl);
+
+      for (q = 0; q < HDR_CELL / 4; q++) {
+        hv4f yv = hv_load_u8(p + 4 * q);
+        hv4f d = hv_sub(yv, mid);
+        hv4f t = hv_mul(d, hv_sel_neg(d, irl, irh));
+        hv4f h = hv_max(hv_sub(one, hv_mul(t, t)), zero);
+        hv4f a = hv_add(va, hv_mul(vda, fx[q]));
+        hv4f b = hv_add(vb, hv_mul(vdb, fx[q]));
+        hv4f wv = hv_add(hv_mul(a, hv_add(fl, hv_mul(gain, h))), b);
+        num[q] = hv_add(num[q], hv_mul(wv, yv));
+        den[q] = hv_add(den[q], wv);
+        if (!(r & 1))
+          hv_store(&cw[i][4 * q], wv);
+      }
+    }
+    for (q = 0; q < HDR_CELL / 4; q++)
+      hv_store_u8(out + 4 * q, hv_div(num[q], den[q]));
+    if (!e->cc_identity)
+      for (j = 0; j < HDR_CELL; j++)
+        out[j] = e->ylut[out[j]];
+    if (r & 1)
+      continue;
+
+    /* chroma, weighted as the top left luma of each 2x2 block */
+    if (!e->planar) {
+      int cy = y >> 1;
+      uint8_t *o = dst->u + cy * w + x0;
+      for (q = 0; q < HDR_CELL / 4; q++) {
+        hv4f cn = zero, cd = zero;
+        for (i = 0; i < k; i++) {
+          const hdr_src_t *s = &src[i];
+          const uint8_t *p = s->f->u + (cy + (s->dy >> 1)) * w + x0 +
+            2 * (s->dx >> 1) + 4 * q;
+          hv4f wv = hv_set4(cw[i][4 * q], cw[i][4 * q], cw[i][4 * q + 2],
+            cw[i][4 * q + 2]);
+          cn = hv_add(cn, hv_mul(wv, hv_load_u8(p)));
+          cd = hv_add(cd, wv);
+        }
+        hv_store_u8(o + 4 * q, hv_div(cn, cd));
+      }
+      if (!e->cc_identity)
+        for (j = 0; j < HDR_CELL; j++)
+          o[j] = e->clut[o[j]];
+    } else {
+      int cy = y >> 1, cs = w >> 1, plane;
+      for (plane = 0; plane < 2; plane++) {
+        uint8_t *o = (plane ? dst->v : dst->u) + cy * cs + (x0 >> 1);
+        for (q = 0; q < HDR_CELL / 8; q++) {
+          hv4f cn = zero, cd = zero;
+          for (i = 0; i < k; i++) {
+            const hdr_src_t *s = &src[i];
+            const uint8_t *p = (plane ? s->f->v : s->f->u) +
+              (cy + (s->dy >> 1)) * cs + (x0 >> 1) + (s->dx >> 1) + 4 * q;
+            hv4f wv = hv_set4(cw[i][8 * q], cw[i][8 * q + 2],
+              cw[i][8 * q + 4], cw[i][8 * q + 6]);
+            cn = hv_add(cn, hv_mul(wv, hv_load_u8(p)));
+            cd = hv_add(cd, wv);
+          }
+          hv_store_u8(o + 4 * q, hv_div(cn, cd));
+        }
+        if (!e->cc_identity)
+          for (j = 0; j < HDR_CELL / 2; j++)
+            o[j] = e->clut[o[j]];
+      }
+    }
+  }
+}
+
+/*==============================================================================
+* Function : hdr_merge_cell_c
+* Parameters: e, src, k, x0, y0
+* Return Value : None
+* Description: Merge a cell at the frame border or with sources partly
+* outside their input. Samples outside an input get no weight.
+==============================================================================*/
+static void hdr_merge_cell_c(hdr_engine_t *e, const hdr_src_t *src, int k,
+  int x0, int y0)
+{
+  const int w = e->width, h = e->height, stride = e->cells_x + 1;
+  const int cw2 = w >> 1, ch2 = h >> 1;
+  const hdr_frame_t *dst = &e->dst;
+  int x1 = hdr_min(x0 + HDR_CELL, w), y1 = hdr_min(y0 + HDR_CELL, h);
+  int x, y, i;
+
+  for (y = y0; y < y1; y++) {
+    float fy = (y - y0 + 0.5f) / HDR_CELL;
+    for (x = x0; x < x1; x++) {
+      float fx = (x - x0 + 0.5f) / HDR_CELL;
+      float num = 0.0f, den = 0.0f, cn[2] = { 0.0f, 0.0f }, cd = 0.0f;
+      int chroma = !((x | y) & 1), v;
+
+      for (i = 0; i < k; i++) {
+        const hdr_src_t *s = &src[i];
+        int sx = x + s->dx, sy = y + s->dy;
+        float a, b, wt;
+        int yv;
+
+        if ((sx < 0) || (sx >= w) || (sy < 0) || (sy >= h))
+          continue;
+        a = s->wa[0] + (s->wa[stride] - s->wa[0]) * fy;
+        a += (s->wa[1] + (s->wa[stride + 1] - s->wa[1]) * fy - a) * fx;
+        b = s->wb[0] + (s->wb[stride] - s->wb[0]) * fy;
+        b += (s->wb[1] + (s->wb[stride + 1] - s->wb[1]) * fy - b) * fx;
+        yv = s->f->y[sy * w + sx];
+        wt = a * e->hat_lut[yv] + b + s->eps;
+        num += wt * yv;
+        den += wt;
+        if (chroma) {
+          int px = hdr_clamp((x >> 1) + (s->dx >> 1), 0, cw2 - 1);
+          int py = hdr_clamp((y >> 1) + (s->dy >> 1), 0, ch2 - 1);
+          if (e->planar) {
+            cn[0] += wt * s->f->u[py * cw2 + px];
+            cn[1] += wt * s->f->v[py * cw2 + px];
+          } else {
+            cn[0] += wt * s->f->u[py * w + 2 * px];
+            cn[1] += wt * s->f->u[py * w + 2 * px + 1];
+          }
+          cd += wt;
+        }
+      }
+      v = hdr_clamp((int)(num / den + 0.5f), 0, 255);
+      dst->y[y * w + x] = e->cc_identity ? (uint8_t)v : e->ylut[v];
+      if (chroma) {
+        int c0 = hdr_clamp((int)(cn[0] / cd + 0.5f), 0, 255);
+        int c1 = hdr_clamp((int)(cn[1] / cd + 0.5f), 0, 255);
+        if (!e->cc_identity) {
+          c0 = e->clut[c0];
+          c1 = e->clut[c1];
+        }
+        if (e->planar) {
+          dst->u[(y >> 1) * cw2 + (x >> 1)] = (uint8_t)c0;
+          dst->v[(y >> 1) * cw2 + (x >> 1)] = (uint8_t)c1;
+        } else {
+          dst->u[(y >> 1) * w + x] = (uint8_t)c0;
+          dst->u[(y >> 1) * w + x + 1] = (uint8_t)c1;
+        }
+      }
+    }
+  }
+}
+
+/*==============================================================================
+* Function : hdr_merge_begin
+* Parameters: e
+* Return Value : number of tiles, one per square of merge cells
+* Description: Setup of the merge stage. The merge goes to the scratch frame
+* when the result is cropped and scaled afterwards.
+==============================================================================*/
+static int hdr_merge_begin(hdr_engine_t *e)
+{
+  int tiles_x = (e->cells_x + HDR_MERGE_TILE_CELLS - 1) /
+    HDR_MERGE_TILE_CELLS;
+  int tiles_y = (e->cells_y + HDR_MERGE_TILE_CELLS - 1) /
+    HDR_MERGE_TILE_CELLS;
+  int full = !e->crop.sx && !e->crop.sy && (e->crop.ex == e->width) &&
+    (e->crop.ey == e->height);
+
+  e->dst = full ? e->out : e->scratch;
+  return tiles_x * tiles_y;
+}
+
+/*==============================================================================
+* Function : hdr_merge_tile
+* Parameters: e, idx
+* Return Value : None
+* Description: Merge a square of cells
+==============================================================================*/
+static void hdr_merge_tile(hdr_engine_t *e, int idx)
+{
+  int tiles_x = (e->cells_x + HDR_MERGE_TILE_CELLS - 1) /
+    HDR_MERGE_TILE_CELLS;
+  int cx0 = (idx % tiles_x) * HDR_MERGE_TILE_CELLS;
+  int cy0 = (idx / tiles_x) * HDR_MERGE_TILE_CELLS;
+  int cx1 = hdr_min(cx0 + HDR_MERGE_TILE_CELLS, e->cells_x);
+  int cy1 = hdr_min(cy0 + HDR_MERGE_TILE_CELLS, e->cells_y);
+  hdr_src_t src[MORPHO_EASY_HDR_MAX_NIMAGES];
+  int cx, cy, i;
+
+  for (cy = cy0; cy < cy1; cy++) {
+    for (cx = cx0; cx < cx1; cx++) {
+      int x0 = cx << HDR_CELL_SHIFT, y0 = cy << HDR_CELL_SHIFT;
+      int k = hdr_merge_sources(e, cx, cy, src);
+      int inside = (x0 + HDR_CELL <= e->width) &&
+        (y0 + HDR_CELL <= e->height);
+
+      for (i = 0; (i < k) && inside; i++)
+        inside = (x0 + src[i].dx >= 0) && (y0 + src[i].dy >= 0) &&
+          (x0 + src[i].dx + HDR_CELL <= e->width) &&
+          (y0 + src[i].dy + HDR_CELL <= e->height);
+      if (inside)
+        hdr_merge_cell_simd(e, src, k, x0, y0);
+      else
+        hdr_merge_cell_c(e, src, k, x0, y0);
+    }
+  }
+}
+
+const hdr_stage_t hdr_stage_merge = {
+  hdr_merge_begin,
+  hdr_merge_tile,
+  NULL,
+};
+
+/*==============================================================================
+* Function : hdr_scale_line
+* Parameters: src, sstride, step, crop_sx, crop_sy, crop_ex, crop_ey, dst,
+*   dw, dh, y
+* Return Value : None
+* Description: Bilinear resampling of one output row of a plane from the
+* crop rect of the source plane. Samples are step bytes apart.
+==============================================================================*/
+static void hdr_scale_line(const uint8_t *src, int sstride, int step,
+  int crop_sx, int crop_sy, int crop_ex, int crop_ey, uint8_t *dst, int dw,
+  int dh, int y)
+{
+  int64_t xs = ((int64_t)(crop_ex - crop_sx) << 16) / dw;
+  int64_t ys = ((int64_t)(crop_ey - crop_sy) << 16) / dh;
+  int64_t fy = ((int64_t)crop_sy << 16) + ys * y + ys / 2 - 32768;
+  const uint8_t *r0, *r1;
+  int x, wy, iy;
+
+  fy = fy < ((int64_t)crop_sy << 16) ? ((int64_t)crop_sy << 16) : fy;
+  fy = fy > ((int64_t)(crop_ey - 1) << 16) ?
+    ((int64_t)(crop_ey - 1) << 16) : fy;
+  iy = (int)(fy >> 16);
+  wy = (int)(fy & 0xffff) >> 8;
+  r0 = src + iy * sstride;
+  r1 = src + hdr_min(iy + 1, crop_ey - 1) * sstride;
+
+  for (x = 0; x < dw; x++) {
+    int64_t fx = ((int64_t)crop_sx << 16) + xs * x + xs / 2 - 32768;
+    int ix, ix1, wx, top, bot;
+
+    fx = fx < ((int64_t)crop_sx << 16) ? ((int64_t)crop_sx << 16) : fx;
+    fx = fx > ((int64_t)(crop_ex - 1) << 16) ?
+      ((int64_t)(crop_ex - 1) << 16) : fx;
+    ix = (int)(fx >> 16);
+    wx = (int)(fx & 0xffff) >> 8;
+    ix1 = hdr_min(ix + 1, crop_ex - 1);
+    top = r0[ix * step] * (256 - wx) + r0[ix1 * step] * wx;
+    bot = r1[ix * step] * (256 - wx) + r1[ix1 * step] * wx;
+    dst[x * step] = (uint8_t)((top * (256 - wy) + bot * wy + 32768) >> 16);
+  }
+}
+
+/*==============================================================================
+* Function : hdr_scale_rows
+* Parameters: src, sw, sh, crop, dst, dw, dh, planar, y0, y1
+* Return Value : None
+* Description: Resample luma rows y0..y1-1 of dst, with the chroma rows
+* they cover, from the crop rect of src
+==============================================================================*/
+void hdr_scale_rows(const hdr_frame_t *src, int sw, int sh,
+  const morpho_RectInt *crop, const hdr_frame_t *dst, int dw, int dh,
+  int planar, int y0, int y1)
+{
+  int y;
+
+  (void)sh;
+  for (y = y0; y < y1; y++) {
+    hdr_scale_line(src->y, sw, 1, crop->sx, crop->sy, crop->ex, crop->ey,
+      dst->y + y * dw, dw, dh, y);
+    if (y & 1)
+      continue;
+    if (planar) {
+      hdr_scale_line(src->u, sw / 2, 1, crop->sx / 2, crop->sy / 2,
+        crop->ex / 2, crop->ey / 2, dst->u + (y / 2) * (dw / 2), dw / 2,
+        dh / 2, y / 2);
+      hdr_scale_line(src->v, sw / 2, 1, crop->sx / 2, crop->sy / 2,
+        crop->ex / 2, crop->ey / 2, dst->v + (y / 2) * (dw / 2), dw / 2,
+        dh / 2, y / 2);
+    } else {
+      hdr_scale_line(src->u, sw, 2, crop->sx / 2, crop->sy / 2,
+        crop->ex / 2, crop->ey / 2, dst->u + (y / 2) * dw, dw / 2, dh / 2,
+        y / 2);
+      hdr_scale_line(src->u + 1, sw, 2, crop->sx / 2, crop->sy / 2,
+        crop->ex / 2, crop->ey / 2, dst->u + (y / 2) * dw + 1, dw / 2,
+        dh / 2, y / 2);
+    }
+  }
+}
+
+/*==============================================================================
+* Function : hdr_scale_begin
+* Parameters: e
+* Return Value : number of tiles, one per band of output rows, 0 when the
+* merge was not cropped
+* Description: Setup of the scaling stage
+==============================================================================*/
+static int hdr_scale_begin(hdr_engine_t *e)
+{
+  if (e->dst.y == e->out.y)
+    return 0;
+  return (e->height + HDR_BAND_ROWS - 1) / HDR_BAND_ROWS;
+}
+
+/*==============================================================================
+* Function : hdr_scale_tile
+* Parameters: e, idx
+* Return Value : None
+* Description: Scale a band of the cropped merge to the output
+==============================================================================*/
+static void hdr_scale_tile(hdr_engine_t *e, int idx)
+{
+  int y0 = idx * HDR_BAND_ROWS;
+  int y1 = hdr_min(y0 + HDR_BAND_ROWS, e->height);
+
+  hdr_scale_rows(&e->scratch, e->width, e->height, &e->crop, &e->out,
+    e->width, e->height, e->planar, y0, y1);
+}
+
+const hdr_stage_t hdr_stage_scale = {
+  hdr_scale_begin,
+  hdr_scale_tile,
+  NULL,
+};
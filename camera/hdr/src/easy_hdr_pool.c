@@ -0,0 +1,333 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+/* Worker pool of the HDR engine. Workers live from initialize() to
+ * finalize() and pick the tiles of the running stage one by one; the thread
+ * calling merge() runs tiles as well. Threads and locks come from the
+ * application callbacks, or from pthreads when none are given. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "easy_hdr_int.h"
+
+static void *hdr_pt_thread_create(void *p __attribute__((unused)),
+  int index __attribute__((unused)), void *(*start_routine)(void *arg),
+  void *arg)
+{
+  pthread_t *thread = malloc(sizeof(pthread_t));
+  if (NULL == thread)
+    return NULL;
+  if (pthread_create(thread, NULL, start_routine, arg)) {
+    free(thread);
+    return NULL;
+  }
+  return thread;
+}
+
+static int hdr_pt_thread_destroy(void *p __attribute__((unused)),
+  void *thread)
+{
+  free(thread);
+  return 0;
+}
+
+static int hdr_pt_thread_join(void *p __attribute__((unused)), void *thread,
+  void **value_ptr)
+{
+  return pthread_join(*(pthread_t *)thread, value_ptr);
+}
+
+static void *hdr_pt_mutex_create(void *p __attribute__((unused)))
+{
+  pthread_mutex_t *mutex = malloc(sizeof(pthread_mutex_t));
+  if (NULL == mutex)
+    return NULL;
+  pthread_mutex_init(mutex, NULL);
+  return mutex;
+}
+
+static int hdr_pt_mutex_destroy(void *p __attribute__((unused)),
+  void *mutex)
+{
+  pthread_mutex_destroy(mutex);
+  free(mutex);
+  return 0;
+}
+
+static int hdr_pt_mutex_lock(void *p __attribute__((unused)), void *mutex)
+{
+  return pthread_mutex_lock(mutex);
+}
+
+static int hdr_pt_mutex_trylock(void *p __attribute__((unused)),
+  void *mutex)
+{
+  return pthread_mutex_trylock(mutex);
+}
+
+static int hdr_pt_mutex_unlock(void *p __attribute__((unused)), void *mutex)
+{
+  return pthread_mutex_unlock(mutex);
+}
+
+static void *hdr_pt_cond_create(void *p __attribute__((unused)))
+{
+  pthread_cond_t *cond = malloc(sizeof(pthread_cond_t));
+  if (NULL == cond)
+    return NULL;
+  pthread_cond_init(cond, NULL);
+  return cond;
+}
+
+static int hdr_pt_cond_destroy(void *p __attribute__((unused)), void *cond)
+{
+  pthread_cond_destroy(cond);
+  free(cond);
+  return 0;
+}
+
+static int hdr_pt_cond_wait(void *p __attribute__((unused)), void *cond,
+  void *lock)
+{
+  return pthread_cond_wait(cond, lock);
+}
+
+static int hdr_pt_cond_signal(void *p __attribute__((unused)), void *cond)
+{
+  return pthread_cond_signal(cond);
+}
+
+static int hdr_pt_cond_broadcast(void *p __attribute__((unused)),
+  void *cond)
+{
+  return pthread_cond_broadcast(cond);
+}
+
+static const morpho_EasyHDR_Callback hdr_pt_callback = {
+  NULL,
+  hdr_pt_thread_create,
+  hdr_pt_thread_destroy,
+  hdr_pt_thread_join,
+  hdr_pt_mutex_create,
+  hdr_pt_mutex_destroy,
+  hdr_pt_mutex_lock,
+  hdr_pt_mutex_trylock,
+  hdr_pt_mutex_unlock,
+  hdr_pt_cond_create,
+  hdr_pt_cond_destroy,
+  hdr_pt_cond_wait,
+  hdr_pt_cond_signal,
+  hdr_pt_cond_broadcast,
+};
+
+/*==============================================================================
+* Function : hdr_pool_work
+* Parameters: pool
+* Return Value : None
+* Description: Run tiles of the current stage until none is left or the
+* pool is stopped. Called and returns with the lock held.
+==============================================================================*/
+static void hdr_pool_work(hdr_pool_t *pool)
+{
+  const morpho_EasyHDR_Callback *cb = &pool->cb;
+
+  while (pool->tile && !pool->stop && (pool->next < pool->end)) {
+    void (*tile)(void *ctx, int idx) = pool->tile;
+    int idx = pool->next++;
+
+    pool->busy++;
+    cb->mutex_unlock(cb->p, pool->lock);
+    tile(pool->ctx, idx);
+    cb->mutex_lock(cb->p, pool->lock);
+    pool->busy--;
+  }
+  if ((0 == pool->busy) &&
+    (pool->stop || (pool->next >= pool->end)))
+    cb->cond_broadcast(cb->p, pool->cond_done);
+}
+
+/*==============================================================================
+* Function : hdr_pool_thread
+* Parameters: data
+* Return Value : NULL
+* Description: Worker thread main loop
+==============================================================================*/
+static void *hdr_pool_thread(void *data)
+{
+  hdr_pool_t *pool = (hdr_pool_t *)data;
+  const morpho_EasyHDR_Callback *cb = &pool->cb;
+
+  cb->mutex_lock(cb->p, pool->lock);
+  while (!pool->quit) {
+    if (pool->tile && !pool->stop && (pool->next < pool->end)) {
+      hdr_pool_work(pool);
+      continue;
+    }
+    cb->cond_wait(cb->p, pool->cond_work, pool->lock);
+  }
+  cb->mutex_unlock(cb->p, pool->lock);
+  return NULL;
+}
+
+/*==============================================================================
+* Function : hdr_pool_init
+* Parameters: pool, nworkers, cb
+* Return Value : MORPHO_OK, MORPHO_ERROR_PARAM or MORPHO_ERROR_MALLOC
+* Description: Create the pool locks and nworkers worker threads. The
+* pthread primitives are used when cb is NULL.
+==============================================================================*/
+int hdr_pool_init(hdr_pool_t *pool, int nworkers,
+  const morpho_EasyHDR_Callback *cb)
+{
+  int i;
+
+  memset(pool, 0, sizeof(*pool));
+  if (NULL == cb)
+    cb = &hdr_pt_callback;
+  if (!cb->mutex_create || !cb->mutex_destroy || !cb->mutex_lock ||
+    !cb->mutex_unlock || !cb->cond_create || !cb->cond_destroy ||
+    !cb->cond_wait || !cb->cond_broadcast)
+    return MORPHO_ERROR_PARAM;
+  if ((nworkers > 0) &&
+    (!cb->thread_create || !cb->thread_join || !cb->thread_destroy))
+    return MORPHO_ERROR_PARAM;
+  if (nworkers > HDR_MAX_THREADS)
+    nworkers = HDR_MAX_THREADS;
+
+  pool->cb = *cb;
+  pool->lock = cb->mutex_create(cb->p);
+  pool->cond_work = cb->cond_create(cb->p);
+  pool->cond_done = cb->cond_create(cb->p);
+  if (!pool->lock || !pool->cond_work || !pool->cond_done) {
+    hdr_pool_deinit(pool);
+    return MORPHO_ERROR_MALLOC;
+  }
+
+  for (i = 0; i < nworkers; i++) {
+    pool->threads[i] = cb->thread_create(cb->p, i + 1, hdr_pool_thread,
+      pool);
+    if (NULL == pool->threads[i])
+      break;
+    pool->nworkers++;
+  }
+  return MORPHO_OK;
+}
+
+/*==============================================================================
+* Function : hdr_pool_deinit
+* Parameters: pool
+* Return Value : None
+* Description: Stop the workers and release the pool
+==============================================================================*/
+void hdr_pool_deinit(hdr_pool_t *pool)
+{
+  const morpho_EasyHDR_Callback *cb = &pool->cb;
+  int i;
+
+  if (pool->lock) {
+    cb->mutex_lock(cb->p, pool->lock);
+    pool->quit = 1;
+    cb->cond_broadcast(cb->p, pool->cond_work);
+    cb->mutex_unlock(cb->p, pool->lock);
+  }
+  for (i = 0; i < pool->nworkers; i++) {
+    cb->thread_join(cb->p, pool->threads[i], NULL);
+    cb->thread_destroy(cb->p, pool->threads[i]);
+  }
+  if (pool->cond_done)
+    cb->cond_destroy(cb->p, pool->cond_done);
+  if (pool->cond_work)
+    cb->cond_destroy(cb->p, pool->cond_work);
+  if (pool->lock)
+    cb->mutex_destroy(cb->p, pool->lock);
+  memset(pool, 0, sizeof(*pool));
+}
+
+/*==============================================================================
+* Function : hdr_pool_run
+* Parameters: pool, ctx, tile, start, end
+* Return Value : index of the first tile not run
+* Description: Run tiles start..end-1 on the workers and the calling thread.
+* Returns early, after the tiles in flight are done, if the pool is stopped.
+==============================================================================*/
+int hdr_pool_run(hdr_pool_t *pool, void *ctx,
+  void (*tile)(void *ctx, int idx), int start, int end)
+{
+  const morpho_EasyHDR_Callback *cb = &pool->cb;
+  int next;
+
+  cb->mutex_lock(cb->p, pool->lock);
+  pool->ctx = ctx;
+  pool->tile = tile;
+  pool->next = start;
+  pool->end = end;
+  if (pool->nworkers && (end - start > 1))
+    cb->cond_broadcast(cb->p, pool->cond_work);
+
+  hdr_pool_work(pool);
+  while (pool->busy || (!pool->stop && (pool->next < pool->end)))
+    cb->cond_wait(cb->p, pool->cond_done, pool->lock);
+
+  next = pool->next;
+  pool->tile = NULL;
+  cb->mutex_unlock(cb->p, pool->lock);
+  return next;
+}
+
+/*==============================================================================
+* Function : hdr_pool_set_stop
+* Parameters: pool, stop
+* Return Value : None
+* Description: Stop or restart handing out tiles. Used by suspend/resume
+* from another thread.
+==============================================================================*/
+void hdr_pool_set_stop(hdr_pool_t *pool, int stop)
+{
+  const morpho_EasyHDR_Callback *cb = &pool->cb;
+
+  cb->mutex_lock(cb->p, pool->lock);
+  pool->stop = stop;
+  cb->mutex_unlock(cb->p, pool->lock);
+}
+
+/*==============================================================================
+* Function : hdr_pool_get_stop
+* Parameters: pool
+* Return Value : stop flag
+* Description: Check if the pool is stopped
+==============================================================================*/
+int hdr_pool_get_stop(hdr_pool_t *pool)
+{
+  const morpho_EasyHDR_Callback *cb = &pool->cb;
+  int stop;
+
+  cb->mutex_lock(cb->p, pool->lock);
+  stop = pool->stop;
+  cb->mutex_unlock(cb->p, pool->lock);
+  return stop;
+}
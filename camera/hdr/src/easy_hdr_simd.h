@@ -0,0 +1,249 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+/* Four lane float vectors for the HDR merge kernels, and the 16 byte sum
+ * of absolute differences used by the noise reduction block matching. SSE2
+ * and NEON map to native vectors, other targets fall back to plain C. */
+
+#ifndef EASY_HDR_SIMD_H
+#define EASY_HDR_SIMD_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define EASY_HDR_SSE2
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define EASY_HDR_NEON
+#endif
+
+#if defined(EASY_HDR_SSE2)
+
+typedef __m128 hv4f;
+
+#define hv_set1(a) _mm_set1_ps(a)
+#define hv_set4(a, b, c, d) _mm_setr_ps(a, b, c, d)
+#define hv_add(a, b) _mm_add_ps(a, b)
+#define hv_sub(a, b) _mm_sub_ps(a, b)
+#define hv_mul(a, b) _mm_mul_ps(a, b)
+#define hv_max(a, b) _mm_max_ps(a, b)
+#define hv_min(a, b) _mm_min_ps(a, b)
+#define hv_div(a, b) _mm_div_ps(a, b)
+#define hv_load(p) _mm_loadu_ps(p)
+#define hv_store(p, a) _mm_storeu_ps(p, a)
+
+/* d < 0 ? a : b, per lane */
+static inline hv4f hv_sel_neg(hv4f d, hv4f a, hv4f b)
+{
+  __m128 m = _mm_cmplt_ps(d, _mm_setzero_ps());
+  return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+
+static inline hv4f hv_load_u8(const uint8_t *p)
+{
+  int32_t v;
+  __m128i z = _mm_setzero_si128();
+  __m128i x;
+
+  memcpy(&v, p, sizeof(v));
+  x = _mm_cvtsi32_si128(v);
+  x = _mm_unpacklo_epi16(_mm_unpacklo_epi8(x, z), z);
+  return _mm_cvtepi32_ps(x);
+}
+
+static inline void hv_store_u8(uint8_t *p, hv4f a)
+{
+  __m128i x;
+  int32_t v;
+
+  a = _mm_min_ps(_mm_max_ps(a, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+  x = _mm_cvttps_epi32(_mm_add_ps(a, _mm_set1_ps(0.5f)));
+  x = _mm_packs_epi32(x, x);
+  x = _mm_packus_epi16(x, x);
+  v = _mm_cvtsi128_si32(x);
+  memcpy(p, &v, sizeof(v));
+}
+
+/* sum of |a[i] - b[i]| over 16 bytes */
+static inline uint32_t hv_sad16(const uint8_t *a, const uint8_t *b)
+{
+  __m128i s = _mm_sad_epu8(_mm_loadu_si128((const __m128i *)a),
+    _mm_loadu_si128((const __m128i *)b));
+  return (uint32_t)(_mm_cvtsi128_si32(s) +
+    _mm_cvtsi128_si32(_mm_srli_si128(s, 8)));
+}
+
+#elif defined(EASY_HDR_NEON)
+
+typedef float32x4_t hv4f;
+
+static inline hv4f hv_set4(float a, float b, float c, float d)
+{
+  float t[4] = { a, b, c, d };
+  return vld1q_f32(t);
+}
+
+#define hv_set1(a) vdupq_n_f32(a)
+#define hv_add(a, b) vaddq_f32(a, b)
+#define hv_sub(a, b) vsubq_f32(a, b)
+#define hv_mul(a, b) vmulq_f32(a, b)
+#define hv_max(a, b) vmaxq_f32(a, b)
+#define hv_min(a, b) vminq_f32(a, b)
+#define hv_load(p) vld1q_f32(p)
+#define hv_store(p, a) vst1q_f32(p, a)
+
+static inline hv4f hv_div(hv4f a, hv4f b)
+{
+#if defined(__aarch64__)
+  return vdivq_f32(a, b);
+#else
+  float32x4_t r = vrecpeq_f32(b);
+  r = vmulq_f32(vrecpsq_f32(b, r), r);
+  r = vmulq_f32(vrecpsq_f32(b, r), r);
+  return vmulq_f32(a, r);
+#endif
+}
+
+static inline hv4f hv_sel_neg(hv4f d, hv4f a, hv4f b)
+{
+  return vbslq_f32(vcltq_f32(d, vdupq_n_f32(0.0f)), a, b);
+}
+
+static inline hv4f hv_load_u8(const uint8_t *p)
+{
+  uint32_t v;
+  uint8x8_t x;
+
+  memcpy(&v, p, sizeof(v));
+  x = vreinterpret_u8_u32(vdup_n_u32(v));
+  return vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(x))));
+}
+
+static inline void hv_store_u8(uint8_t *p, hv4f a)
+{
+  uint32x4_t x;
+  uint16x4_t h;
+  uint8x8_t b;
+  uint32_t v;
+
+  a = vminq_f32(vmaxq_f32(a, vdupq_n_f32(0.0f)), vdupq_n_f32(255.0f));
+  x = vcvtq_u32_f32(vaddq_f32(a, vdupq_n_f32(0.5f)));
+  h = vmovn_u32(x);
+  b = vmovn_u16(vcombine_u16(h, h));
+  v = vget_lane_u32(vreinterpret_u32_u8(b), 0);
+  memcpy(p, &v, sizeof(v));
+}
+
+static inline uint32_t hv_sad16(const uint8_t *a, const uint8_t *b)
+{
+  uint8x16_t d = vabdq_u8(vld1q_u8(a), vld1q_u8(b));
+  uint64x2_t s = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(d)));
+  return (uint32_t)(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+}
+
+#else
+
+typedef struct {
+  float v[4];
+} hv4f;
+
+static inline hv4f hv_set4(float a, float b, float c, float d)
+{
+  hv4f r;
+  r.v[0] = a; r.v[1] = b; r.v[2] = c; r.v[3] = d;
+  return r;
+}
+
+static inline hv4f hv_set1(float a)
+{
+  return hv_set4(a, a, a, a);
+}
+
+#define HV_OP2(name, expr) \
+  static inline hv4f name(hv4f a, hv4f b) \
+  { \
+    hv4f r; \
+    int i; \
+    for (i = 0; i < 4; i++) \
+      r.v[i] = (expr); \
+    return r; \
+  }
+
+HV_OP2(hv_add, a.v[i] + b.v[i])
+HV_OP2(hv_sub, a.v[i] - b.v[i])
+HV_OP2(hv_mul, a.v[i] * b.v[i])
+HV_OP2(hv_max, a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+HV_OP2(hv_min, a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+HV_OP2(hv_div, a.v[i] / b.v[i])
+
+static inline hv4f hv_load(const float *p)
+{
+  return hv_set4(p[0], p[1], p[2], p[3]);
+}
+
+static inline void hv_store(float *p, hv4f a)
+{
+  memcpy(p, a.v, sizeof(a.v));
+}
+
+static inline hv4f hv_sel_neg(hv4f d, hv4f a, hv4f b)
+{
+  hv4f r;
+  int i;
+  for (i = 0; i < 4; i++)
+    r.v[i] = (d.v[i] < 0.0f) ? a.v[i] : b.v[i];
+  return r;
+}
+
+static inline hv4f hv_load_u8(const uint8_t *p)
+{
+  return hv_set4(p[0], p[1], p[2], p[3]);
+}
+
+static inline void hv_store_u8(uint8_t *p, hv4f a)
+{
+  int i;
+  for (i = 0; i < 4; i++) {
+    float f = a.v[i] < 0.0f ? 0.0f : (a.v[i] > 255.0f ? 255.0f : a.v[i]);
+    p[i] = (uint8_t)(f + 0.5f);
+  }
+}
+
+static inline uint32_t hv_sad16(const uint8_t *a, const uint8_t *b)
+{
+  uint32_t s = 0;
+  int i;
+  for (i = 0; i < 16; i++)
+    s += (a[i] > b[i]) ? (uint32_t)(a[i] - b[i]) : (uint32_t)(b[i] - a[i]);
+  return s;
+}
+
+#endif
+
+#endif
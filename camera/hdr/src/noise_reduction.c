@@ -0,0 +1,1001 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+/* morpho_NoiseReduction API: motion compensated temporal averaging of a
+ * burst of YUV 4:2:0 frames.
+ *
+ * start() names the output image, then each reduceNoise() call folds one
+ * frame into per sample weighted sums and rewrites the output with their
+ * mean, so the output holds the denoised result after every call. The
+ * first frame is the reference: later frames are registered to it by a
+ * global search on a luma pyramid followed by a block matching search at
+ * full resolution, and each sample is weighted by how well it matches the
+ * current mean. Blocks that do not match are left out of the average.
+ *
+ * The work is split in tiles run by the worker pool of the HDR engine, one
+ * worker per online core besides the calling thread. The engine state
+ * lives at the start of the buffer given to initialize(), the rest of the
+ * buffer holds the sums and the pyramids. */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "easy_hdr_int.h"
+#include "easy_hdr_simd.h"
+#include "morpho_noise_reduction_ext.h"
+
+#define NR_MEM_ALIGN 16
+#define NR_ENGINE_SIZE \
+  ((int)((sizeof(nr_engine_t) + NR_MEM_ALIGN - 1) & ~(NR_MEM_ALIGN - 1)))
+#define NR_ALIGN(n) (((n) + NR_MEM_ALIGN - 1) & ~(NR_MEM_ALIGN - 1))
+
+/* luma pixels per side of a matching block */
+#define NR_BLOCK 16
+/* blocks per side of a merge tile */
+#define NR_TILE_BLOCKS 4
+#define NR_TILE (NR_BLOCK * NR_TILE_BLOCKS)
+/* luma rows per band of the pyramid stage, a multiple of 4 */
+#define NR_BAND_ROWS 64
+/* motion pyramid levels, level 0 is 1/4 of the full resolution */
+#define NR_LEVELS 3
+#define NR_SMALL_SHIFT 2
+/* search range on the coarsest level, then per finer level */
+#define NR_COARSE_SEARCH 4
+#define NR_FINE_SEARCH 1
+/* block search range at full resolution around the global motion */
+#define NR_BLOCK_SEARCH 2
+/* weight of a sample that matches the mean, the first frame has it all */
+#define NR_FULL_WEIGHT 4
+/* keeps the weighted sums within 16 bits */
+#define NR_MAX_FRAMES 32
+#define NR_MIN_SIZE 64
+#define NR_MAX_SIZE 8192
+#define NR_MAX_LEVEL 7
+#define NR_LEVEL_DEFAULT 4
+#define NR_MAX_WORKERS (HDR_MAX_THREADS - 1)
+
+typedef enum {
+  NR_STATE_INITIALIZED = 1,
+  NR_STATE_STARTED,
+} nr_state_t;
+
+/** nr_engine_t: noise reduction instance
+*    @format: image format string
+*    @planar: chroma layout of the format
+*    @luma_level, @chroma_level: reduction levels, 0 disables averaging
+*    @work, @work_size: memory behind the engine state
+*    @pool: worker threads
+*    @state: NR_STATE_*
+*    @width, @height: size of the images of the current run
+*    @nframes: frames folded into the output so far
+*    @out: output image, holds the current mean
+*    @in: frame being folded in
+*    @acc_y, @acc_c: weighted sums of luma and interleaved chroma samples
+*    @wsum_y, @wsum_c: sum of the weights of each luma pixel and chroma pair
+*    @ref: luma pyramid of the first frame
+*    @cur: luma pyramid of the frame being folded in
+*    @dx, @dy: global displacement, input pixel = output pixel + d
+*    @tiles_x, @tiles_y: merge tile grid
+*    @bands: number of pyramid bands
+*    @ylut: luma weight by luma difference
+*    @glut: chroma weight by luma difference, rejects moving areas
+*    @clut: chroma weight by chroma difference
+*    @recip: 2^16 / weight sum
+*    @reject: block SAD above which a block is left out
+**/
+typedef struct {
+  char format[HDR_FORMAT_LEN];
+  int planar;
+  int luma_level;
+  int chroma_level;
+
+  uint8_t *work;
+  int work_size;
+  hdr_pool_t pool;
+
+  nr_state_t state;
+  int width;
+  int height;
+  int nframes;
+  hdr_frame_t out;
+  hdr_frame_t in;
+  uint16_t *acc_y;
+  uint16_t *acc_c;
+  uint8_t *wsum_y;
+  uint8_t *wsum_c;
+  hdr_plane_t ref[NR_LEVELS];
+  hdr_plane_t cur[NR_LEVELS];
+  int dx;
+  int dy;
+  int tiles_x;
+  int tiles_y;
+  int bands;
+
+  uint8_t ylut[256];
+  uint8_t glut[256];
+  uint8_t clut[256];
+  uint32_t recip[256];
+  uint32_t reject;
+} nr_engine_t;
+
+static const char *const nr_formats[] = {
+  "YUV420_SEMIPLANAR",
+  "YVU420_SEMIPLANAR",
+  "YUV420_PLANAR",
+  "YVU420_PLANAR",
+};
+
+/* matching threshold of each reduction level, in luma or chroma steps */
+static const int nr_level_threshold[NR_MAX_LEVEL + 1] = {
+  0, 4, 6, 9, 12, 16, 20, 26
+};
+
+/*==============================================================================
+* Function : nr_format_index
+* Parameters: format
+* Return Value : index in nr_formats, -1 if not supported
+* Description: Look up an image format string. Planar formats come last,
+* the order of the chroma components does not matter to the averaging.
+==============================================================================*/
+static int nr_format_index(const char *format)
+{
+  int i;
+
+  if (NULL == format)
+    return -1;
+  for (i = 0; i < (int)(sizeof(nr_formats) / sizeof(nr_formats[0])); i++)
+    if (!strcmp(format, nr_formats[i]))
+      return i;
+  return -1;
+}
+
+/*==============================================================================
+* Function : nr_get
+* Parameters: reducer
+* Return Value : engine, NULL if reducer is not initialized
+* Description: Engine of a NoiseReduction instance
+==============================================================================*/
+static nr_engine_t *nr_get(morpho_NoiseReduction *reducer)
+{
+  return reducer ? (nr_engine_t *)reducer->p : NULL;
+}
+
+/*==============================================================================
+* Function : nr_level_size
+* Parameters: width, height, level
+* Return Value : None
+* Description: Size of a motion pyramid level
+==============================================================================*/
+static void nr_level_size(int width, int height, int level, int *w, int *h)
+{
+  *w = width >> (NR_SMALL_SHIFT + level);
+  *h = height >> (NR_SMALL_SHIFT + level);
+}
+
+/*==============================================================================
+* Function : nr_work_size
+* Parameters: width, height, e
+* Return Value : bytes of work memory for the given image size
+* Description: Lay out the work memory. Sets the pointers of e when it is
+* not NULL, the caller has checked the memory is large enough.
+==============================================================================*/
+static int nr_work_size(int width, int height, nr_engine_t *e)
+{
+  int luma = width * height;
+  int size = 0;
+  int l, w, h;
+
+#define NR_TAKE(ptr, type, count) \
+  do { \
+    if (e) \
+      (ptr) = (type *)(e->work + size); \
+    size += NR_ALIGN((int)sizeof(type) * (count)); \
+  } while (0)
+
+  NR_TAKE(e->acc_y, uint16_t, luma);
+  NR_TAKE(e->acc_c, uint16_t, luma / 2);
+  NR_TAKE(e->wsum_y, uint8_t, luma);
+  NR_TAKE(e->wsum_c, uint8_t, luma / 4);
+  for (l = 0; l < NR_LEVELS; l++) {
+    nr_level_size(width, height, l, &w, &h);
+    if (e) {
+      e->ref[l].w = e->cur[l].w = w;
+      e->ref[l].h = e->cur[l].h = h;
+    }
+    NR_TAKE(e->ref[l].data, uint8_t, w * h);
+    NR_TAKE(e->cur[l].data, uint8_t, w * h);
+  }
+#undef NR_TAKE
+  return size;
+}
+
+/*==============================================================================
+* Function : nr_set_frame
+* Parameters: f, img, planar
+* Return Value : None
+* Description: Plane pointers of a morpho image
+==============================================================================*/
+static void nr_set_frame(hdr_frame_t *f, const morpho_ImageData *img,
+  int planar)
+{
+  if (planar) {
+    f->y = img->dat.planar.y;
+    f->u = img->dat.planar.u;
+    f->v = img->dat.planar.v;
+  } else {
+    f->y = img->dat.semi_planar.y;
+    f->u = img->dat.semi_planar.uv;
+    f->v = NULL;
+  }
+}
+
+/*==============================================================================
+* Function : nr_frame_valid
+* Parameters: img, planar
+* Return Value : 1 if all planes are set
+* Description: Check the plane pointers of a morpho image
+==============================================================================*/
+static int nr_frame_valid(const morpho_ImageData *img, int planar)
+{
+  if (planar)
+    return img->dat.planar.y && img->dat.planar.u && img->dat.planar.v;
+  return img->dat.semi_planar.y && img->dat.semi_planar.uv;
+}
+
+/*==============================================================================
+* Function : nr_weight_lut
+* Parameters: lut, threshold
+* Return Value : None
+* Description: Weight of a sample by its distance to the mean: full up to
+* the threshold, then halved at 2 and 3 thresholds, 0 beyond. A threshold
+* of 0 leaves every later frame out.
+==============================================================================*/
+static void nr_weight_lut(uint8_t *lut, int threshold)
+{
+  int d;
+
+  for (d = 0; d < 256; d++) {
+    if (0 == threshold)
+      lut[d] = 0;
+    else if (d <= threshold)
+      lut[d] = NR_FULL_WEIGHT;
+    else if (d <= 2 * threshold)
+      lut[d] = NR_FULL_WEIGHT / 2;
+    else if (d <= 3 * threshold)
+      lut[d] = NR_FULL_WEIGHT / 4;
+    else
+      lut[d] = 0;
+  }
+}
+
+/*==============================================================================
+* Function : nr_setup_luts
+* Parameters: e
+* Return Value : None
+* Description: Weight tables of a run, from the reduction levels. Chroma
+* averaging is gated by the luma difference as well, so moving areas stay
+* out of it even when only chroma reduction is on.
+==============================================================================*/
+static void nr_setup_luts(nr_engine_t *e)
+{
+  int gate = nr_level_threshold[e->luma_level ? e->luma_level :
+    NR_LEVEL_DEFAULT];
+  int i;
+
+  nr_weight_lut(e->ylut, nr_level_threshold[e->luma_level]);
+  nr_weight_lut(e->glut, gate);
+  nr_weight_lut(e->clut, nr_level_threshold[e->chroma_level]);
+  e->recip[0] = 0;
+  for (i = 1; i < 256; i++)
+    e->recip[i] = (65536 + i / 2) / i;
+  e->reject = (uint32_t)(NR_BLOCK * NR_BLOCK * 2 * gate);
+}
+
+/*==============================================================================
+* Function : nr_mean
+* Parameters: e, acc, wsum
+* Return Value : rounded weighted mean
+* Description: Output sample of a weighted sum
+==============================================================================*/
+static inline uint8_t nr_mean(const nr_engine_t *e, uint32_t acc, int wsum)
+{
+  uint32_t m = (acc * e->recip[wsum] + 32768) >> 16;
+  return (uint8_t)((m > 255) ? 255 : m);
+}
+
+/*==============================================================================
+* Function : nr_half
+* Parameters: v
+* Return Value : v / 2 rounded down
+* Description: Chroma displacement of a luma displacement
+==============================================================================*/
+static inline int nr_half(int v)
+{
+  return (v >= 0) ? v / 2 : -((1 - v) / 2);
+}
+
+/*==============================================================================
+* Function : nr_pyramid_band
+* Parameters: e, pyr, y, idx
+* Return Value : None
+* Description: Level 0 rows of a luma band, 4x4 box average
+==============================================================================*/
+static void nr_pyramid_band(nr_engine_t *e, hdr_plane_t *pyr,
+  const uint8_t *y, int idx)
+{
+  hdr_plane_t *dst = &pyr[0];
+  int r0 = idx * (NR_BAND_ROWS >> NR_SMALL_SHIFT);
+  int r1 = r0 + (NR_BAND_ROWS >> NR_SMALL_SHIFT);
+  int r, c, i;
+
+  if (r1 > dst->h)
+    r1 = dst->h;
+  for (r = r0; r < r1; r++) {
+    const uint8_t *s = y + (size_t)r * 4 * e->width;
+    uint8_t *d = dst->data + (size_t)r * dst->w;
+
+    for (c = 0; c < dst->w; c++) {
+      uint32_t sum = 0;
+      for (i = 0; i < 4; i++) {
+        const uint8_t *p = s + (size_t)i * e->width + c * 4;
+        sum += p[0] + p[1] + p[2] + p[3];
+      }
+      d[c] = (uint8_t)((sum + 8) >> 4);
+    }
+  }
+}
+
+/*==============================================================================
+* Function : nr_pyramid_finish
+* Parameters: pyr
+* Return Value : None
+* Description: Coarser pyramid levels, 2x2 box average of the level above
+==============================================================================*/
+static void nr_pyramid_finish(hdr_plane_t *pyr)
+{
+  int l, r, c;
+
+  for (l = 1; l < NR_LEVELS; l++) {
+    const hdr_plane_t *s = &pyr[l - 1];
+    hdr_plane_t *d = &pyr[l];
+
+    for (r = 0; r < d->h; r++) {
+      const uint8_t *a = s->data + (size_t)2 * r * s->w;
+      const uint8_t *b = a + s->w;
+      uint8_t *o = d->data + (size_t)r * d->w;
+
+      for (c = 0; c < d->w; c++)
+        o[c] = (uint8_t)((a[2 * c] + a[2 * c + 1] + b[2 * c] +
+          b[2 * c + 1] + 2) >> 2);
+    }
+  }
+}
+
+/*==============================================================================
+* Function : nr_first_tile
+* Parameters: ctx, idx
+* Return Value : None
+* Description: Band of the first frame: starts the weighted sums with full
+* weight, copies the frame to the output and builds the reference pyramid.
+==============================================================================*/
+static void nr_first_tile(void *ctx, int idx)
+{
+  nr_engine_t *e = (nr_engine_t *)ctx;
+  int cw = e->width / 2;
+  int r0 = idx * NR_BAND_ROWS;
+  int r1 = r0 + NR_BAND_ROWS;
+  int r, c;
+
+  if (r1 > e->height)
+    r1 = e->height;
+  for (r = r0; r < r1; r++) {
+    size_t o = (size_t)r * e->width;
+
+    if (e->out.y != e->in.y)
+      memcpy(e->out.y + o, e->in.y + o, e->width);
+    for (c = 0; c < e->width; c++)
+      e->acc_y[o + c] = (uint16_t)(e->in.y[o + c] * NR_FULL_WEIGHT);
+    memset(e->wsum_y + o, NR_FULL_WEIGHT, e->width);
+  }
+  for (r = r0 / 2; r < r1 / 2; r++) {
+    size_t o = (size_t)r * cw;
+
+    if (e->planar) {
+      if (e->out.u != e->in.u) {
+        memcpy(e->out.u + o, e->in.u + o, cw);
+        memcpy(e->out.v + o, e->in.v + o, cw);
+      }
+      for (c = 0; c < cw; c++) {
+        e->acc_c[2 * (o + c)] = (uint16_t)(e->in.u[o + c] * NR_FULL_WEIGHT);
+        e->acc_c[2 * (o + c) + 1] =
+          (uint16_t)(e->in.v[o + c] * NR_FULL_WEIGHT);
+      }
+    } else {
+      if (e->out.u != e->in.u)
+        memcpy(e->out.u + 2 * o, e->in.u + 2 * o, 2 * cw);
+      for (c = 0; c < 2 * cw; c++)
+        e->acc_c[2 * o + c] = (uint16_t)(e->in.u[2 * o + c] * NR_FULL_WEIGHT);
+    }
+    memset(e->wsum_c + o, NR_FULL_WEIGHT, cw);
+  }
+  nr_pyramid_band(e, e->ref, e->in.y, idx);
+}
+
+/*==============================================================================
+* Function : nr_pyramid_tile
+* Parameters: ctx, idx
+* Return Value : None
+* Description: Band of the pyramid of a later frame
+==============================================================================*/
+static void nr_pyramid_tile(void *ctx, int idx)
+{
+  nr_engine_t *e = (nr_engine_t *)ctx;
+
+  nr_pyramid_band(e, e->cur, e->in.y, idx);
+}
+
+/*==============================================================================
+* Function : nr_level_cost
+* Parameters: ref, cur, dx, dy
+* Return Value : mean absolute difference in 1/256 steps, UINT32_MAX when
+* the overlap is too small to judge
+* Description: Match cost of a displacement on a pyramid level
+==============================================================================*/
+static uint32_t nr_level_cost(const hdr_plane_t *ref, const hdr_plane_t *cur,
+  int dx, int dy)
+{
+  int x0 = (dx < 0) ? -dx : 0;
+  int x1 = (dx > 0) ? ref->w - dx : ref->w;
+  int y0 = (dy < 0) ? -dy : 0;
+  int y1 = (dy > 0) ? ref->h - dy : ref->h;
+  uint64_t sad = 0;
+  uint64_t count;
+  int r, c;
+
+  if ((x1 - x0) * 2 < ref->w || (y1 - y0) * 2 < ref->h)
+    return UINT32_MAX;
+  for (r = y0; r < y1; r++) {
+    const uint8_t *a = ref->data + (size_t)r * ref->w;
+    const uint8_t *b = cur->data + (size_t)(r + dy) * cur->w + dx;
+
+    for (c = x0; c + 16 <= x1; c += 16)
+      sad += hv_sad16(a + c, b + c);
+    for (; c < x1; c++)
+      sad += (a[c] > b[c]) ? a[c] - b[c] : b[c] - a[c];
+  }
+  count = (uint64_t)(x1 - x0) * (y1 - y0);
+  return (uint32_t)((sad * 256) / count);
+}
+
+/*==============================================================================
+* Function : nr_global_motion
+* Parameters: e
+* Return Value : None
+* Description: Coarse to fine search of the displacement of the current
+* frame. Ties keep the smaller displacement.
+==============================================================================*/
+static void nr_global_motion(nr_engine_t *e)
+{
+  int dx = 0, dy = 0;
+  int l;
+
+  for (l = NR_LEVELS - 1; l >= 0; l--) {
+    int range = (l == NR_LEVELS - 1) ? NR_COARSE_SEARCH : NR_FINE_SEARCH;
+    uint32_t best = nr_level_cost(&e->ref[l], &e->cur[l], dx, dy);
+    int bx = dx, by = dy;
+    int sx, sy;
+
+    for (sy = -range; sy <= range; sy++) {
+      for (sx = -range; sx <= range; sx++) {
+        uint32_t cost;
+
+        if (!sx && !sy)
+          continue;
+        cost = nr_level_cost(&e->ref[l], &e->cur[l], dx + sx, dy + sy);
+        if (cost < best) {
+          best = cost;
+          bx = dx + sx;
+          by = dy + sy;
+        }
+      }
+    }
+    dx = bx;
+    dy = by;
+    if (l > 0) {
+      dx *= 2;
+      dy *= 2;
+    }
+  }
+  e->dx = dx * (1 << NR_SMALL_SHIFT);
+  e->dy = dy * (1 << NR_SMALL_SHIFT);
+}
+
+/*==============================================================================
+* Function : nr_block_sad
+* Parameters: e, x0, y0, bw, bh, cx, cy, limit
+* Return Value : SAD of the block against the input at cx, cy, stops early
+* once above limit
+* Description: Match cost of a block candidate
+==============================================================================*/
+static uint32_t nr_block_sad(const nr_engine_t *e, int x0, int y0, int bw,
+  int bh, int cx, int cy, uint32_t limit)
+{
+  uint32_t sad = 0;
+  int r, c;
+
+  for (r = 0; (r < bh) && (sad <= limit); r++) {
+    const uint8_t *a = e->out.y + (size_t)(y0 + r) * e->width + x0;
+    const uint8_t *b = e->in.y + (size_t)(cy + r) * e->width + cx;
+
+    if (NR_BLOCK == bw) {
+      sad += hv_sad16(a, b);
+    } else {
+      for (c = 0; c < bw; c++)
+        sad += (a[c] > b[c]) ? a[c] - b[c] : b[c] - a[c];
+    }
+  }
+  return sad;
+}
+
+/*==============================================================================
+* Function : nr_block_search
+* Parameters: e, x0, y0, bw, bh, mvx, mvy
+* Return Value : 1 if the block takes part in the average
+* Description: Refine the global displacement of a block around itself,
+* against the current mean. Candidates reaching out of the frame are
+* skipped; when none is left the global displacement is kept.
+==============================================================================*/
+static int nr_block_search(nr_engine_t *e, int x0, int y0, int bw, int bh,
+  int *mvx, int *mvy)
+{
+  uint32_t best = UINT32_MAX;
+  int bx = 0, by = 0;
+  int sx, sy;
+
+  for (sy = -NR_BLOCK_SEARCH; sy <= NR_BLOCK_SEARCH; sy++) {
+    int cy = y0 + *mvy + sy;
+
+    if ((cy < 0) || (cy + bh > e->height))
+      continue;
+    for (sx = -NR_BLOCK_SEARCH; sx <= NR_BLOCK_SEARCH; sx++) {
+      int cx = x0 + *mvx + sx;
+      uint32_t sad;
+
+      if ((cx < 0) || (cx + bw > e->width))
+        continue;
+      sad = nr_block_sad(e, x0, y0, bw, bh, cx, cy, best);
+      /* prefer the smaller correction on ties */
+      if ((sad < best) || ((sad == best) &&
+        (abs(sx) + abs(sy) < abs(bx) + abs(by)))) {
+        best = sad;
+        bx = sx;
+        by = sy;
+      }
+    }
+  }
+  if (UINT32_MAX == best)
+    return 1;
+  *mvx += bx;
+  *mvy += by;
+  /* partial blocks are judged on the same mean difference */
+  return (uint64_t)best * NR_BLOCK * NR_BLOCK <=
+    (uint64_t)e->reject * bw * bh;
+}
+
+/*==============================================================================
+* Function : nr_fold_block
+* Parameters: e, x0, y0, bw, bh, mvx, mvy
+* Return Value : None
+* Description: Fold the displaced samples of a block into the weighted sums
+* and write the new mean to the output. Samples displaced out of the frame
+* are left out.
+==============================================================================*/
+static void nr_fold_block(nr_engine_t *e, int x0, int y0, int bw, int bh,
+  int mvx, int mvy)
+{
+  uint8_t gate[NR_BLOCK / 2][NR_BLOCK / 2];
+  int w = e->width, h = e->height;
+  int cw = w / 2, ch = h / 2;
+  int cmx = nr_half(mvx), cmy = nr_half(mvy);
+  /* columns of the block whose displaced samples are in the frame */
+  int c0 = (x0 + mvx < 0) ? -(x0 + mvx) : 0;
+  int c1 = (x0 + mvx + bw > w) ? w - x0 - mvx : bw;
+  int r, c;
+
+  memset(gate, 0, sizeof(gate));
+  for (r = 0; r < bh; r++) {
+    size_t o = (size_t)(y0 + r) * w + x0;
+    const uint8_t *cur = e->in.y + (ptrdiff_t)(y0 + r + mvy) * w + x0 + mvx;
+    uint8_t *ref = e->out.y + o;
+    uint16_t *acc = e->acc_y + o;
+    uint8_t *ws = e->wsum_y + o;
+
+    if ((y0 + r + mvy < 0) || (y0 + r + mvy >= h))
+      continue;
+    for (c = c0; c < c1; c++) {
+      int d = abs(cur[c] - ref[c]);
+      int wt = e->ylut[d];
+
+      if (!((r | c) & 1))
+        gate[r / 2][c / 2] = e->glut[d];
+      if (wt) {
+        acc[c] = (uint16_t)(acc[c] + wt * cur[c]);
+        ws[c] = (uint8_t)(ws[c] + wt);
+        ref[c] = nr_mean(e, acc[c], ws[c]);
+      }
+    }
+  }
+
+  for (r = 0; r < bh / 2; r++) {
+    int cy = y0 / 2 + r;
+    int sy = cy + cmy;
+    size_t o = (size_t)cy * cw + x0 / 2;
+
+    if ((sy < 0) || (sy >= ch))
+      continue;
+    for (c = 0; c < bw / 2; c++, o++) {
+      int sx = x0 / 2 + c + cmx;
+      size_t s = (size_t)sy * cw + sx;
+      uint8_t *ru, *rv;
+      int cu, cv, du, dv, wt;
+
+      if ((sx < 0) || (sx >= cw) || !gate[r][c])
+        continue;
+      if (e->planar) {
+        ru = e->out.u + o;
+        rv = e->out.v + o;
+        cu = e->in.u[s];
+        cv = e->in.v[s];
+      } else {
+        ru = e->out.u + 2 * o;
+        rv = ru + 1;
+        cu = e->in.u[2 * s];
+        cv = e->in.u[2 * s + 1];
+      }
+      du = abs(cu - *ru);
+      dv = abs(cv - *rv);
+      wt = e->clut[(du > dv) ? du : dv];
+      if (gate[r][c] < wt)
+        wt = gate[r][c];
+      if (wt) {
+        uint16_t *acc = e->acc_c + 2 * o;
+
+        acc[0] = (uint16_t)(acc[0] + wt * cu);
+        acc[1] = (uint16_t)(acc[1] + wt * cv);
+        e->wsum_c[o] = (uint8_t)(e->wsum_c[o] + wt);
+        *ru = nr_mean(e, acc[0], e->wsum_c[o]);
+        *rv = nr_mean(e, acc[1], e->wsum_c[o]);
+      }
+    }
+  }
+}
+
+/*==============================================================================
+* Function : nr_merge_tile
+* Parameters: ctx, idx
+* Return Value : None
+* Description: Match and fold the blocks of a tile. A block only reads the
+* output under itself, so tiles run in any order.
+==============================================================================*/
+static void nr_merge_tile(void *ctx, int idx)
+{
+  nr_engine_t *e = (nr_engine_t *)ctx;
+  int tx = idx % e->tiles_x;
+  int ty = idx / e->tiles_x;
+  int y0, x0;
+
+  for (y0 = ty * NR_TILE; (y0 < (ty + 1) * NR_TILE) && (y0 < e->height);
+    y0 += NR_BLOCK) {
+    int bh = (e->height - y0 < NR_BLOCK) ? e->height - y0 : NR_BLOCK;
+
+    for (x0 = tx * NR_TILE; (x0 < (tx + 1) * NR_TILE) && (x0 < e->width);
+      x0 += NR_BLOCK) {
+      int bw = (e->width - x0 < NR_BLOCK) ? e->width - x0 : NR_BLOCK;
+      int mvx = e->dx, mvy = e->dy;
+
+      if (!nr_block_search(e, x0, y0, bw, bh, &mvx, &mvy))
+        continue;
+      nr_fold_block(e, x0, y0, bw, bh, mvx, mvy);
+    }
+  }
+}
+
+MORPHO_API(const char *)
+morpho_NoiseReduction_getVersion(void)
+{
+  return MORPHO_NOISE_REDUCTION_VERSION;
+}
+
+MORPHO_API(int)
+morpho_NoiseReduction_getBufferSize(
+    int width,
+    int height,
+    const char *format)
+{
+  if ((nr_format_index(format) < 0) ||
+    (width < NR_MIN_SIZE) || (width > NR_MAX_SIZE) ||
+    (height < NR_MIN_SIZE) || (height > NR_MAX_SIZE))
+    return 0;
+  return NR_ENGINE_SIZE + NR_MEM_ALIGN + nr_work_size(width, height, NULL);
+}
+
+MORPHO_API(int)
+morpho_NoiseReduction_initialize(
+    morpho_NoiseReduction *reducer,
+    void *buffer,
+    int buffer_size)
+{
+  uintptr_t base = ((uintptr_t)buffer + NR_MEM_ALIGN - 1) &
+    ~(uintptr_t)(NR_MEM_ALIGN - 1);
+  int skew = (int)(base - (uintptr_t)buffer);
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  nr_engine_t *e;
+  int rc;
+
+  if (!reducer || !buffer || (buffer_size < skew + NR_ENGINE_SIZE))
+    return MORPHO_ERROR_PARAM;
+
+  e = (nr_engine_t *)base;
+  memset(e, 0, sizeof(*e));
+  e->work = (uint8_t *)base + NR_ENGINE_SIZE;
+  e->work_size = buffer_size - skew - NR_ENGINE_SIZE;
+
+  if (ncpu < 1)
+    ncpu = 1;
+  rc = hdr_pool_init(&e->pool,
+    (ncpu - 1 > NR_MAX_WORKERS) ? NR_MAX_WORKERS : (int)ncpu - 1, NULL);
+  if (MORPHO_OK != rc)
+    return rc;
+
+  snprintf(e->format, sizeof(e->format), "%s", nr_formats[0]);
+  e->luma_level = NR_LEVEL_DEFAULT;
+  e->chroma_level = NR_LEVEL_DEFAULT;
+  e->state = NR_STATE_INITIALIZED;
+  reducer->p = e;
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_NoiseReduction_finalize(
+    morpho_NoiseReduction *reducer)
+{
+  nr_engine_t *e = nr_get(reducer);
+
+  if (NULL == e)
+    return MORPHO_ERROR_PARAM;
+  hdr_pool_deinit(&e->pool);
+  memset(e, 0, sizeof(*e));
+  reducer->p = NULL;
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_NoiseReduction_start(
+    morpho_NoiseReduction *reducer,
+    morpho_ImageData *output_image)
+{
+  nr_engine_t *e = nr_get(reducer);
+  int w, h;
+
+  if (!e || !output_image || !nr_frame_valid(output_image, e->planar))
+    return MORPHO_ERROR_PARAM;
+  w = output_image->width;
+  h = output_image->height;
+  if ((w < NR_MIN_SIZE) || (w > NR_MAX_SIZE) || (w & 1) ||
+    (h < NR_MIN_SIZE) || (h > NR_MAX_SIZE) || (h & 1))
+    return MORPHO_ERROR_PARAM;
+  if (nr_work_size(w, h, NULL) > e->work_size)
+    return MORPHO_ERROR_MALLOC;
+
+  e->width = w;
+  e->height = h;
+  nr_work_size(w, h, e);
+  nr_set_frame(&e->out, output_image, e->planar);
+  e->tiles_x = (w + NR_TILE - 1) / NR_TILE;
+  e->tiles_y = (h + NR_TILE - 1) / NR_TILE;
+  e->bands = (h + NR_BAND_ROWS - 1) / NR_BAND_ROWS;
+  e->nframes = 0;
+  nr_setup_luts(e);
+  e->state = NR_STATE_STARTED;
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_NoiseReduction_reduceNoise(
+    morpho_NoiseReduction *reducer,
+    morpho_ImageData *input_image)
+{
+  nr_engine_t *e = nr_get(reducer);
+
+  if (!e || !input_image || !nr_frame_valid(input_image, e->planar))
+    return MORPHO_ERROR_PARAM;
+  if (NR_STATE_STARTED != e->state)
+    return MORPHO_ERROR_STATE;
+  if ((input_image->width != e->width) || (input_image->height != e->height))
+    return MORPHO_ERROR_PARAM;
+  if (e->nframes >= NR_MAX_FRAMES)
+    return MORPHO_ERROR_STATE;
+
+  nr_set_frame(&e->in, input_image, e->planar);
+  if (0 == e->nframes) {
+    hdr_pool_run(&e->pool, e, nr_first_tile, 0, e->bands);
+    nr_pyramid_finish(e->ref);
+  } else {
+    hdr_pool_run(&e->pool, e, nr_pyramid_tile, 0, e->bands);
+    nr_pyramid_finish(e->cur);
+    nr_global_motion(e);
+    hdr_pool_run(&e->pool, e, nr_merge_tile, 0, e->tiles_x * e->tiles_y);
+  }
+  e->nframes++;
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_NoiseReduction_getImageFormat(
+    morpho_NoiseReduction *reducer,
+    char *format,
+    const int buffer_size)
+{
+  nr_engine_t *e = nr_get(reducer);
+
+  if (!e || !format || (buffer_size < HDR_FORMAT_LEN))
+    return MORPHO_ERROR_PARAM;
+  snprintf(format, buffer_size, "%s", e->format);
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_NoiseReduction_getLumaNoiseReductionLevel(
+    morpho_NoiseReduction *reducer,
+    int *level)
+{
+  nr_engine_t *e = nr_get(reducer);
+
+  if (!e || !level)
+    return MORPHO_ERROR_PARAM;
+  *level = e->luma_level;
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_NoiseReduction_getChromaNoiseReductionLevel(
+    morpho_NoiseReduction *reducer,
+    int *level)
+{
+  nr_engine_t *e = nr_get(reducer);
+
+  if (!e || !level)
+    return MORPHO_ERROR_PARAM;
+  *level = e->chroma_level;
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_NoiseReduction_setImageFormat(
+    morpho_NoiseReduction *reducer,
+    const char *format)
+{
+  nr_engine_t *e = nr_get(reducer);
+  int idx;
+
+  if (NULL == e)
+    return MORPHO_ERROR_PARAM;
+  if (NR_STATE_INITIALIZED != e->state)
+    return MORPHO_ERROR_STATE;
+  idx = nr_format_index(format);
+  if (idx < 0)
+    return MORPHO_ERROR_UNSUPPORTED;
+  snprintf(e->format, sizeof(e->format), "%s", nr_formats[idx]);
+  e->planar = (idx >= 2);
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_NoiseReduction_setLumaNoiseReductionLevel(
+    morpho_NoiseReduction *reducer,
+    int level)
+{
+  nr_engine_t *e = nr_get(reducer);
+
+  if (!e || (level < 0) || (level > NR_MAX_LEVEL))
+    return MORPHO_ERROR_PARAM;
+  if (NR_STATE_INITIALIZED != e->state)
+    return MORPHO_ERROR_STATE;
+  e->luma_level = level;
+  return MORPHO_OK;
+}
+
+MORPHO_API(int)
+morpho_NoiseReduction_setChromaNoiseReductionLevel(
+    morpho_NoiseReduction *reducer,
+    int level)
+{
+  nr_engine_t *e = nr_get(reducer);
+
+  if (!e || (level < 0) || (level > NR_MAX_LEVEL))
+    return MORPHO_ERROR_PARAM;
+  if (NR_STATE_INITIALIZED != e->state)
+    return MORPHO_ERROR_STATE;
+  e->chroma_level = level;
+  return MORPHO_OK;
+}
+
+/*==============================================================================
+* Function : LINK_mm_camera_morpho_noise_reduction
+* Parameters: yuvImage, width, height, y_level, c_level
+* Return Value : 0 on success, a MORPHO error code otherwise
+* Description: One call reduction of a YVU420 semi-planar frame in place.
+* The averaging is temporal, so a single frame comes out unchanged; bursts
+* go through start() and reduceNoise().
+==============================================================================*/
+MORPHO_API(int)
+LINK_mm_camera_morpho_noise_reduction(
+    unsigned char* yuvImage,
+    int width,
+    int height,
+    int y_level,
+    int c_level)
+{
+  static const char format[] = "YVU420_SEMIPLANAR";
+  morpho_NoiseReduction nr;
+  morpho_ImageData img;
+  void *buffer;
+  int size, rc;
+
+  memset(&img, 0, sizeof(img));
+  if (NULL == yuvImage)
+    return MORPHO_ERROR_PARAM;
+  size = morpho_NoiseReduction_getBufferSize(width, height, format);
+  if (size <= 0)
+    return MORPHO_ERROR_PARAM;
+  buffer = malloc(size);
+  if (NULL == buffer)
+    return MORPHO_ERROR_MALLOC;
+
+  img.width = width;
+  img.height = height;
+  img.dat.semi_planar.y = yuvImage;
+  img.dat.semi_planar.uv = yuvImage + width * height;
+
+  rc = morpho_NoiseReduction_initialize(&nr, buffer, size);
+  if (MORPHO_OK == rc) {
+    rc = morpho_NoiseReduction_setImageFormat(&nr, format);
+    if (MORPHO_OK == rc)
+      rc = morpho_NoiseReduction_setLumaNoiseReductionLevel(&nr, y_level);
+    if (MORPHO_OK == rc)
+      rc = morpho_NoiseReduction_setChromaNoiseReductionLevel(&nr, c_level);
+    if (MORPHO_OK == rc)
+      rc = morpho_NoiseReduction_start(&nr, &img);
+    if (MORPHO_OK == rc)
+      rc = morpho_NoiseReduction_reduceNoise(&nr, &img);
+    morpho_NoiseReduction_finalize(&nr);
+  }
+  free(buffer);
+  return rc;
+}
@@ -0,0 +1,32 @@
+NR_BENCH_PATH := $(call my-dir)
+
+# ------------------------------------------------------------------------------
+#     Noise reduction benchmark on synthetic bursts (target and host)
+# ------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(NR_BENCH_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := -Wall -Werror -O2
+
+LOCAL_SRC_FILES := noise_reduction_bench.c
+
+LOCAL_MODULE           := noise-reduction-bench
+LOCAL_SHARED_LIBRARIES := libcamera_noise_reduction
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(NR_BENCH_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := -Wall -Werror -O2
+
+LOCAL_SRC_FILES := noise_reduction_bench.c
+
+LOCAL_MODULE           := noise-reduction-bench
+LOCAL_SHARED_LIBRARIES := libcamera_noise_reduction
+LOCAL_LDLIBS := -lm
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,311 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+/* Benchmark of the noise reduction engine on synthetic bursts.
+ *
+ * Renders a textured scene, then a burst of frames that see it through a
+ * known camera shake with a square moving across it, with gaussian noise
+ * on every sample. The burst is folded with the morpho_NoiseReduction API
+ * and the time of each call is reported along with the PSNR of the first
+ * frame and of the result against the clean scene. */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "morpho_noise_reduction.h"
+
+#define BENCH_MAX_FRAMES 32
+
+/** bench_params_t: benchmark settings
+*    @width, @height: frame size
+*    @nframes: frames per burst
+*    @sigma: standard deviation of the noise
+*    @luma_level, @chroma_level: reduction levels
+*    @iterations: bursts to time
+**/
+typedef struct {
+  int width;
+  int height;
+  int nframes;
+  double sigma;
+  int luma_level;
+  int chroma_level;
+  int iterations;
+} bench_params_t;
+
+static uint32_t g_seed = 0x12345678;
+
+/*==============================================================================
+* Function : bench_now_us
+* Parameters: None
+* Return Value : monotonic time in microseconds
+* Description: Time source of the benchmark
+==============================================================================*/
+static double bench_now_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/*==============================================================================
+* Function : bench_gauss
+* Parameters: None
+* Return Value : standard normal sample
+* Description: Box-Muller on a fixed seed LCG, so runs are repeatable
+==============================================================================*/
+static double bench_gauss(void)
+{
+  double u1, u2;
+
+  g_seed = g_seed * 1664525u + 1013904223u;
+  u1 = ((g_seed >> 8) + 1.0) / 16777217.0;
+  g_seed = g_seed * 1664525u + 1013904223u;
+  u2 = (g_seed >> 8) / 16777216.0;
+  return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/*==============================================================================
+* Function : bench_scene
+* Parameters: x, y, plane
+* Return Value : clean sample of the scene, plane 0 luma, 1 and 2 chroma
+* Description: Gradients, rings and a checker pattern, so both flat and
+* textured areas are covered
+==============================================================================*/
+static int bench_scene(int x, int y, int plane)
+{
+  double v;
+
+  if (0 == plane) {
+    v = 60.0 + 0.02 * x + 0.03 * y +
+      40.0 * sin(sqrt((double)(x - 700) * (x - 700) +
+        (double)(y - 500) * (y - 500)) * 0.05);
+    if ((((x >> 5) + (y >> 5)) & 1) && (x % 512 < 256))
+      v += 50.0;
+  } else if (1 == plane) {
+    v = 128.0 + 30.0 * sin(x * 0.004) + 10.0 * cos(y * 0.01);
+  } else {
+    v = 128.0 - 25.0 * cos(y * 0.003) + 10.0 * sin(x * 0.02);
+  }
+  return (v < 0.0) ? 0 : ((v > 255.0) ? 255 : (int)(v + 0.5));
+}
+
+/*==============================================================================
+* Function : bench_sample
+* Parameters: p, x, y, plane, k
+* Return Value : clean sample of frame k
+* Description: Frame k sees the scene displaced by the shake of the frame,
+* with a flat square moving over it
+==============================================================================*/
+static int bench_sample(const bench_params_t *p, int x, int y, int plane,
+  int k)
+{
+  int scale = plane ? 2 : 1;
+  int sx = (3 * k) / scale, sy = (-2 * k + (k & 1)) / scale;
+  int bx = (p->width / 4 + 24 * k) / scale, by = (p->height / 3) / scale;
+  int bs = 96 / scale;
+
+  if ((x >= bx) && (x < bx + bs) && (y >= by) && (y < by + bs))
+    return plane ? 90 : 200;
+  return bench_scene(x - sx, y - sy, plane);
+}
+
+/*==============================================================================
+* Function : bench_render
+* Parameters: p, dst, k, noisy
+* Return Value : None
+* Description: Render frame k as YUV420 semi-planar, with or without noise
+==============================================================================*/
+static void bench_render(const bench_params_t *p, uint8_t *dst, int k,
+  int noisy)
+{
+  int w = p->width, h = p->height;
+  uint8_t *uv = dst + w * h;
+  int x, y, c;
+
+  for (y = 0; y < h; y++)
+    for (x = 0; x < w; x++) {
+      double v = bench_sample(p, x, y, 0, k);
+      if (noisy)
+        v += p->sigma * bench_gauss();
+      dst[y * w + x] = (v < 0.0) ? 0 : ((v > 255.0) ? 255 : (uint8_t)(v + 0.5));
+    }
+  for (y = 0; y < h / 2; y++)
+    for (x = 0; x < w / 2; x++)
+      for (c = 0; c < 2; c++) {
+        double v = bench_sample(p, x, y, c + 1, k);
+        if (noisy)
+          v += p->sigma * bench_gauss();
+        uv[(y * (w / 2) + x) * 2 + c] =
+          (v < 0.0) ? 0 : ((v > 255.0) ? 255 : (uint8_t)(v + 0.5));
+      }
+}
+
+/*==============================================================================
+* Function : bench_psnr
+* Parameters: a, b, len
+* Return Value : PSNR in dB
+* Description: Peak signal to noise ratio of two sample runs
+==============================================================================*/
+static double bench_psnr(const uint8_t *a, const uint8_t *b, int len)
+{
+  double se = 0.0;
+  int i;
+
+  for (i = 0; i < len; i++)
+    se += (double)(a[i] - b[i]) * (a[i] - b[i]);
+  if (se == 0.0)
+    return 99.0;
+  return 10.0 * log10(255.0 * 255.0 * len / se);
+}
+
+/*==============================================================================
+* Function : bench_usage
+* Parameters: name
+* Return Value : None
+* Description: Print the command line options
+==============================================================================*/
+static void bench_usage(const char *name)
+{
+  printf("usage: %s [-w width] [-h height] [-n frames] [-s sigma]\n"
+    "          [-y luma_level] [-c chroma_level] [-i iterations]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+  bench_params_t p = { 4000, 3000, 6, 8.0, 4, 4, 3 };
+  uint8_t *frames[BENCH_MAX_FRAMES];
+  morpho_NoiseReduction nr;
+  morpho_ImageData img;
+  uint8_t *clean, *out, *buffer;
+  double t_first = 0.0, t_next = 0.0;
+  int size, frame_size, opt, it, k, rc = 0;
+
+  while ((opt = getopt(argc, argv, "w:h:n:s:y:c:i:")) != -1) {
+    switch (opt) {
+    case 'w': p.width = atoi(optarg); break;
+    case 'h': p.height = atoi(optarg); break;
+    case 'n': p.nframes = atoi(optarg); break;
+    case 's': p.sigma = atof(optarg); break;
+    case 'y': p.luma_level = atoi(optarg); break;
+    case 'c': p.chroma_level = atoi(optarg); break;
+    case 'i': p.iterations = atoi(optarg); break;
+    default:
+      bench_usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((p.nframes < 1) || (p.nframes > BENCH_MAX_FRAMES) ||
+    (p.iterations < 1)) {
+    bench_usage(argv[0]);
+    return 1;
+  }
+
+  size = morpho_NoiseReduction_getBufferSize(p.width, p.height,
+    "YUV420_SEMIPLANAR");
+  if (size <= 0) {
+    printf("unsupported size %dx%d\n", p.width, p.height);
+    return 1;
+  }
+  frame_size = p.width * p.height * 3 / 2;
+  buffer = malloc(size);
+  clean = malloc(frame_size);
+  out = malloc(frame_size);
+  if (!buffer || !clean || !out)
+    return 1;
+  for (k = 0; k < p.nframes; k++) {
+    frames[k] = malloc(frame_size);
+    if (NULL == frames[k])
+      return 1;
+    bench_render(&p, frames[k], k, 1);
+  }
+  bench_render(&p, clean, 0, 0);
+
+  printf("%s\n", morpho_NoiseReduction_getVersion());
+  printf("%dx%d, %d frames, sigma %.1f, levels %d/%d, %ld cores\n",
+    p.width, p.height, p.nframes, p.sigma, p.luma_level, p.chroma_level,
+    sysconf(_SC_NPROCESSORS_ONLN));
+
+  memset(&img, 0, sizeof(img));
+  img.width = p.width;
+  img.height = p.height;
+  for (it = 0; (it < p.iterations) && (MORPHO_OK == rc); it++) {
+    double t0;
+
+    rc = morpho_NoiseReduction_initialize(&nr, buffer, size);
+    if (MORPHO_OK == rc)
+      rc = morpho_NoiseReduction_setLumaNoiseReductionLevel(&nr,
+        p.luma_level);
+    if (MORPHO_OK == rc)
+      rc = morpho_NoiseReduction_setChromaNoiseReductionLevel(&nr,
+        p.chroma_level);
+    img.dat.semi_planar.y = out;
+    img.dat.semi_planar.uv = out + p.width * p.height;
+    if (MORPHO_OK == rc)
+      rc = morpho_NoiseReduction_start(&nr, &img);
+    for (k = 0; (k < p.nframes) && (MORPHO_OK == rc); k++) {
+      img.dat.semi_planar.y = frames[k];
+      img.dat.semi_planar.uv = frames[k] + p.width * p.height;
+      t0 = bench_now_us();
+      rc = morpho_NoiseReduction_reduceNoise(&nr, &img);
+      if (0 == k)
+        t_first += bench_now_us() - t0;
+      else
+        t_next += bench_now_us() - t0;
+    }
+    morpho_NoiseReduction_finalize(&nr);
+  }
+  if (MORPHO_OK != rc) {
+    printf("noise reduction failed: 0x%x\n", rc);
+    return 1;
+  }
+
+  printf("first frame: %.2f ms\n", t_first / p.iterations / 1000.0);
+  if (p.nframes > 1)
+    printf("next frames: %.2f ms per frame\n",
+      t_next / p.iterations / (p.nframes - 1) / 1000.0);
+  printf("luma PSNR: input %.2f dB, output %.2f dB\n",
+    bench_psnr(frames[0], clean, p.width * p.height),
+    bench_psnr(out, clean, p.width * p.height));
+  printf("chroma PSNR: input %.2f dB, output %.2f dB\n",
+    bench_psnr(frames[0] + p.width * p.height, clean + p.width * p.height,
+      frame_size - p.width * p.height),
+    bench_psnr(out + p.width * p.height, clean + p.width * p.height,
+      frame_size - p.width * p.height));
+
+  for (k = 0; k < p.nframes; k++)
+    free(frames[k]);
+  free(out);
+  free(clean);
+  free(buffer);
+  return 0;
+}
@@ -22,6 +22,8 @@ LOCAL_SRC_FILES := qomx_core.c
 
 LOCAL_MODULE           := libqomx_core
 LOCAL_SHARED_LIBRARIES := libcutils libdl liblog
+# components are dlopen()ed by name, install them with the core
+LOCAL_REQUIRED_MODULES := libqomx_jpegenc_sw
 LOCAL_PROPRIETARY_MODULE := true
 
 include $(BUILD_SHARED_LIBRARY)
@@ -0,0 +1,53 @@
+OMX_JPEGENC_SW_PATH := $(call my-dir)
+
+omx_jpegenc_sw_defines := -Wall -Werror -O3
+
+omx_jpegenc_sw_includes := frameworks/native/include/media/openmax \
+                           $(OMX_JPEGENC_SW_PATH)/../qexif \
+                           $(OMX_JPEGENC_SW_PATH)/../qomx_core
+
+omx_jpegenc_sw_src := qomx_jpegenc_sw.c \
+                      jpege_sw.c \
+                      jpege_sw_dct.c \
+                      jpege_sw_exif.c
+
+# ------------------------------------------------------------------------------
+#                Make the shared library (libqomx_jpegenc_sw)
+# ------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(OMX_JPEGENC_SW_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := $(omx_jpegenc_sw_defines)
+LOCAL_ARM_NEON := true
+
+LOCAL_C_INCLUDES := $(omx_jpegenc_sw_includes)
+
+LOCAL_SRC_FILES := $(omx_jpegenc_sw_src)
+
+LOCAL_MODULE           := libqomx_jpegenc_sw
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_SHARED_LIBRARY)
+
+# ------------------------------------------------------------------------------
+#     Host build of the encoder, used to run and benchmark the mm-jpeg path
+# ------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(OMX_JPEGENC_SW_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := $(omx_jpegenc_sw_defines) -msse2
+
+LOCAL_C_INCLUDES := $(omx_jpegenc_sw_includes)
+
+LOCAL_SRC_FILES := $(omx_jpegenc_sw_src)
+
+LOCAL_MODULE           := libqomx_jpegenc_sw
+LOCAL_SHARED_LIBRARIES := liblog
+LOCAL_LDLIBS := -lpthread
+
+include $(BUILD_HOST_SHARED_LIBRARY)
@@ -0,0 +1,895 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+/* Baseline jpeg encoder used by the software OMX jpeg component. The frame
+ * is split into horizontal stripes of MCU rows which are entropy coded in
+ * parallel, each into its own part of the destination buffer, and are then
+ * joined with restart markers. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "jpege_sw.h"
+
+#define JPEGE_MAX_SAMP 2
+#define JPEGE_MAX_RESTART_INTERVAL 0xFFFF
+
+/* natural order position of the zigzag index */
+static const uint8_t jpege_zigzag[64] = {
+   0,  1,  8, 16,  9,  2,  3, 10,
+  17, 24, 32, 25, 18, 11,  4,  5,
+  12, 19, 26, 33, 40, 48, 41, 34,
+  27, 20, 13,  6,  7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36,
+  29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46,
+  53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/* ITU T.81 annex K quantization tables, natural order */
+static const uint8_t jpege_std_luma_qt[64] = {
+  16,  11,  10,  16,  24,  40,  51,  61,
+  12,  12,  14,  19,  26,  58,  60,  55,
+  14,  13,  16,  24,  40,  57,  69,  56,
+  14,  17,  22,  29,  51,  87,  80,  62,
+  18,  22,  37,  56,  68, 109, 103,  77,
+  24,  35,  55,  64,  81, 104, 113,  92,
+  49,  64,  78,  87, 103, 121, 120, 101,
+  72,  92,  95,  98, 112, 100, 103,  99
+};
+
+static const uint8_t jpege_std_chroma_qt[64] = {
+  17, 18, 24, 47, 99, 99, 99, 99,
+  18, 21, 26, 66, 99, 99, 99, 99,
+  24, 26, 56, 99, 99, 99, 99, 99,
+  47, 66, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99
+};
+
+/* ITU T.81 annex K huffman tables */
+static const uint8_t jpege_dc_luma_bits[16] = {
+  0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0
+};
+static const uint8_t jpege_dc_chroma_bits[16] = {
+  0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0
+};
+static const uint8_t jpege_dc_vals[12] = {
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+
+static const uint8_t jpege_ac_luma_bits[16] = {
+  0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d
+};
+static const uint8_t jpege_ac_luma_vals[162] = {
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
+  0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+  0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+  0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+  0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16,
+  0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+  0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+  0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+  0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+  0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
+  0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
+  0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+  0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+  0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+  0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4,
+  0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+  0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+  0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+  0xf9, 0xfa
+};
+
+static const uint8_t jpege_ac_chroma_bits[16] = {
+  0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77
+};
+static const uint8_t jpege_ac_chroma_vals[162] = {
+  0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21,
+  0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+  0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+  0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+  0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34,
+  0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+  0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38,
+  0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+  0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+  0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+  0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+  0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+  0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96,
+  0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+  0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+  0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+  0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2,
+  0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+  0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9,
+  0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+  0xf9, 0xfa
+};
+
+/* AAN DCT output scale factors */
+static const float jpege_aan_scale[8] = {
+  1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+  1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+};
+
+/** jpege_huff_t: derived huffman code table
+*    @code: code of each symbol
+*    @size: code length of each symbol
+**/
+typedef struct {
+  uint16_t code[256];
+  uint8_t size[256];
+} jpege_huff_t;
+
+/** jpege_bitwriter_t: entropy coded segment writer
+*    @ptr: next output byte
+*    @end: end of the output area
+*    @acc: bit accumulator
+*    @bits: number of valid bits in acc
+*    @overflow: set if the output area is too small
+**/
+typedef struct {
+  uint8_t *ptr;
+  uint8_t *end;
+  uint64_t acc;
+  int32_t bits;
+  int32_t overflow;
+} jpege_bitwriter_t;
+
+/** jpege_slice_t: one stripe of MCU rows
+*    @start: output area of the stripe
+*    @size: size of the output area
+*    @len: encoded length, including the trailing restart marker
+*    @error: set if the output area overflowed
+**/
+typedef struct {
+  uint8_t *start;
+  uint32_t size;
+  uint32_t len;
+  int32_t error;
+} jpege_slice_t;
+
+/** jpege_ctx_t: state of one encode call
+*    @img: source image
+*    @enc_w, @enc_h: encoded image size
+*    @hs, @vs: luma sampling factors of the encoded image
+*    @mcus_x, @mcus_y: number of MCUs
+*    @y_row, @y_col: luma source byte offset of each encoded row/column
+*    @c_row, @c_col: chroma pair byte offset of each encoded row/column
+*    @y_fast, @c_fast: set if the tables are a plain copy of the source, so
+*       that full blocks can be loaded with the vector kernels
+*    @qrecip: quantization reciprocals with the DCT scaling folded in
+*    @qt: quantization tables in natural order
+*    @dc, @ac: huffman tables for luma and chroma
+*    @slices: stripe descriptors
+*    @num_slices: number of stripes
+*    @rows_per_slice: MCU rows of each stripe but the last one
+*    @next_slice: next stripe to be picked up by a worker
+*    @lock: protects next_slice
+**/
+typedef struct {
+  const jpege_sw_image_t *img;
+  uint32_t enc_w;
+  uint32_t enc_h;
+  uint32_t hs;
+  uint32_t vs;
+  uint32_t mcus_x;
+  uint32_t mcus_y;
+  uint32_t *y_row;
+  uint32_t *y_col;
+  uint32_t *c_row;
+  uint32_t *c_col;
+  int y_fast;
+  int c_fast;
+  float qrecip[2][64] __attribute__((aligned(16)));
+  uint8_t qt[2][64];
+  jpege_huff_t dc[2];
+  jpege_huff_t ac[2];
+  jpege_slice_t slices[JPEGE_SW_MAX_SLICES];
+  uint32_t num_slices;
+  uint32_t rows_per_slice;
+  uint32_t next_slice;
+  pthread_mutex_t lock;
+} jpege_ctx_t;
+
+/*==============================================================================
+* Function : jpege_build_huff
+* Parameters: bits, vals, nvals, huff
+* Return Value : None
+* Description: Derive the code table from the BITS/HUFFVAL lists (T.81 C.2)
+==============================================================================*/
+static void jpege_build_huff(const uint8_t *bits, const uint8_t *vals,
+  jpege_huff_t *huff)
+{
+  uint32_t code = 0;
+  int k = 0, l, i;
+
+  memset(huff, 0, sizeof(*huff));
+  for (l = 1; l <= 16; l++) {
+    for (i = 0; i < bits[l - 1]; i++, k++) {
+      huff->code[vals[k]] = (uint16_t)code;
+      huff->size[vals[k]] = (uint8_t)l;
+      code++;
+    }
+    code <<= 1;
+  }
+}
+
+/*==============================================================================
+* Function : jpege_build_quant
+* Parameters: ctx, quality
+* Return Value : None
+* Description: Scale the standard tables by the IJG quality formula and
+* compute the reciprocals used after the AAN DCT
+==============================================================================*/
+static void jpege_build_quant(jpege_ctx_t *ctx, uint32_t quality)
+{
+  const uint8_t *std[2] = { jpege_std_luma_qt, jpege_std_chroma_qt };
+  int scale, t, i;
+  long q;
+
+  if (quality < 1)
+    quality = 1;
+  if (quality > 100)
+    quality = 100;
+  scale = (quality < 50) ? (5000 / quality) : (200 - quality * 2);
+
+  for (t = 0; t < 2; t++) {
+    for (i = 0; i < 64; i++) {
+      q = ((long)std[t][i] * scale + 50) / 100;
+      if (q < 1)
+        q = 1;
+      if (q > 255)
+        q = 255;
+      ctx->qt[t][i] = (uint8_t)q;
+      ctx->qrecip[t][i] = 1.0f / ((float)q * jpege_aan_scale[i >> 3] *
+        jpege_aan_scale[i & 7] * 8.0f);
+    }
+  }
+}
+
+/*==============================================================================
+* Function : jpege_map
+* Parameters: u, off, len, out
+* Return Value : source coordinate
+* Description: Map an output coordinate to the nearest source coordinate
+* of the crop window
+==============================================================================*/
+static inline uint32_t jpege_map(uint32_t u, uint32_t off, uint32_t len,
+  uint32_t out)
+{
+  return off + (uint32_t)(((uint64_t)(2 * u + 1) * len) / (2 * out));
+}
+
+/*==============================================================================
+* Function : jpege_build_tables
+* Parameters: ctx, params
+* Return Value : 0 on success, -1 on failure
+* Description: Build the encoded row/column to source offset tables. Crop,
+* scaling and rotation all become table lookups, and the tables clamp to the
+* last row/column so the MCU padding replicates the image edge.
+==============================================================================*/
+static int jpege_build_tables(jpege_ctx_t *ctx, const jpege_sw_params_t *p,
+  uint32_t out_w, uint32_t out_h)
+{
+  const jpege_sw_image_t *img = ctx->img;
+  uint32_t pad_w = ctx->mcus_x * ctx->hs * 8;
+  uint32_t pad_h = ctx->mcus_y * ctx->vs * 8;
+  uint32_t cpad_w = ctx->mcus_x * 8;
+  uint32_t cpad_h = ctx->mcus_y * 8;
+  int swap = (p->rotation == 90) || (p->rotation == 270);
+  int flip_col = (p->rotation == 90) || (p->rotation == 180);
+  int flip_row = (p->rotation == 180) || (p->rotation == 270);
+  uint32_t i, e, u, s;
+
+  ctx->y_row = malloc((pad_h + pad_w + cpad_h + cpad_w) * sizeof(uint32_t));
+  if (NULL == ctx->y_row)
+    return -1;
+  ctx->y_col = ctx->y_row + pad_h;
+  ctx->c_row = ctx->y_col + pad_w;
+  ctx->c_col = ctx->c_row + cpad_h;
+
+  /* a column of the encoded image walks along source x, or along source y
+   * when rotated by 90/270. Rows are the other way around. */
+  for (i = 0; i < pad_w + cpad_w; i++) {
+    int chroma = (i >= pad_w);
+    e = chroma ? (i - pad_w) * ctx->hs : i;
+    if (e > ctx->enc_w - 1)
+      e = ctx->enc_w - 1;
+    if (!swap) {
+      u = flip_col ? out_w - 1 - e : e;
+      s = jpege_map(u, p->crop_x, p->crop_w, out_w);
+      if (chroma)
+        ctx->c_col[i - pad_w] = (s / img->h_sub) * 2;
+      else
+        ctx->y_col[i] = s;
+    } else {
+      u = flip_col ? out_h - 1 - e : e;
+      s = jpege_map(u, p->crop_y, p->crop_h, out_h);
+      if (chroma)
+        ctx->c_col[i - pad_w] = (s / img->v_sub) * img->cbcr_stride;
+      else
+        ctx->y_col[i] = s * img->y_stride;
+    }
+  }
+
+  for (i = 0; i < pad_h + cpad_h; i++) {
+    int chroma = (i >= pad_h);
+    e = chroma ? (i - pad_h) * ctx->vs : i;
+    if (e > ctx->enc_h - 1)
+      e = ctx->enc_h - 1;
+    if (!swap) {
+      u = flip_row ? out_h - 1 - e : e;
+      s = jpege_map(u, p->crop_y, p->crop_h, out_h);
+      if (chroma)
+        ctx->c_row[i - pad_h] = (s / img->v_sub) * img->cbcr_stride;
+      else
+        ctx->y_row[i] = s * img->y_stride;
+    } else {
+      u = flip_row ? out_w - 1 - e : e;
+      s = jpege_map(u, p->crop_x, p->crop_w, out_w);
+      if (chroma)
+        ctx->c_row[i - pad_h] = (s / img->h_sub) * 2;
+      else
+        ctx->y_row[i] = s;
+    }
+  }
+
+  ctx->y_fast = (p->rotation == 0) && (p->crop_w == out_w) &&
+    (p->crop_h == out_h);
+  ctx->c_fast = ctx->y_fast && (ctx->hs == img->h_sub) &&
+    (ctx->vs == img->v_sub) && (p->crop_x % img->h_sub == 0) &&
+    (p->crop_y % img->v_sub == 0);
+  return 0;
+}
+
+/*==============================================================================
+* Function : jpege_emit_bytes
+* Parameters: bw
+* Return Value : None
+* Description: Move all complete bytes from the accumulator to the output,
+* stuffing a zero after each 0xFF
+==============================================================================*/
+static void jpege_emit_bytes(jpege_bitwriter_t *bw)
+{
+  uint8_t byte;
+
+  while (bw->bits >= 8) {
+    bw->bits -= 8;
+    byte = (uint8_t)(bw->acc >> bw->bits);
+    if (bw->ptr + 2 > bw->end) {
+      bw->overflow = 1;
+      continue;
+    }
+    *bw->ptr++ = byte;
+    if (byte == 0xFF)
+      *bw->ptr++ = 0;
+  }
+}
+
+static inline void jpege_put_bits(jpege_bitwriter_t *bw, uint32_t code,
+  int size)
+{
+  bw->acc = (bw->acc << size) | code;
+  bw->bits += size;
+  if (bw->bits >= 32)
+    jpege_emit_bytes(bw);
+}
+
+/*==============================================================================
+* Function : jpege_flush_bits
+* Parameters: bw
+* Return Value : None
+* Description: Pad the last byte with 1 bits and flush the accumulator
+==============================================================================*/
+static void jpege_flush_bits(jpege_bitwriter_t *bw)
+{
+  int pad = (8 - (bw->bits & 7)) & 7;
+
+  if (pad)
+    jpege_put_bits(bw, (1 << pad) - 1, pad);
+  jpege_emit_bytes(bw);
+}
+
+static inline int jpege_nbits(int32_t v)
+{
+  return v ? 32 - __builtin_clz((uint32_t)v) : 0;
+}
+
+/*==============================================================================
+* Function : jpege_encode_block
+* Parameters: bw, coef, last_dc, dc, ac
+* Return Value : None
+* Description: Huffman code one quantized block (T.81 F.1.2)
+==============================================================================*/
+static void jpege_encode_block(jpege_bitwriter_t *bw, const int16_t *coef,
+  int32_t *last_dc, const jpege_huff_t *dc, const jpege_huff_t *ac)
+{
+  int32_t temp, temp2;
+  int nbits, k, r = 0, sym;
+
+  temp = temp2 = coef[0] - *last_dc;
+  *last_dc = coef[0];
+  if (temp < 0) {
+    temp = -temp;
+    temp2--;
+  }
+  nbits = jpege_nbits(temp);
+  jpege_put_bits(bw, dc->code[nbits], dc->size[nbits]);
+  if (nbits)
+    jpege_put_bits(bw, (uint32_t)temp2 & ((1u << nbits) - 1), nbits);
+
+  for (k = 1; k < 64; k++) {
+    temp = coef[jpege_zigzag[k]];
+    if (temp == 0) {
+      r++;
+      continue;
+    }
+    while (r > 15) {
+      jpege_put_bits(bw, ac->code[0xF0], ac->size[0xF0]);
+      r -= 16;
+    }
+    temp2 = temp;
+    if (temp < 0) {
+      temp = -temp;
+      temp2--;
+    }
+    nbits = jpege_nbits(temp);
+    sym = (r << 4) + nbits;
+    jpege_put_bits(bw, ac->code[sym], ac->size[sym]);
+    jpege_put_bits(bw, (uint32_t)temp2 & ((1u << nbits) - 1), nbits);
+    r = 0;
+  }
+  if (r > 0)
+    jpege_put_bits(bw, ac->code[0], ac->size[0]);
+}
+
+/*==============================================================================
+* Function : jpege_gather_luma
+* Parameters: ctx, ex, ey, blk
+* Return Value : None
+* Description: Load a luma block through the offset tables
+==============================================================================*/
+static void jpege_gather_luma(jpege_ctx_t *ctx, uint32_t ex, uint32_t ey,
+  float *blk)
+{
+  const uint8_t *y = ctx->img->y;
+  const uint32_t *col = ctx->y_col + ex;
+  const uint8_t *row;
+  int i, j;
+
+  for (i = 0; i < 8; i++) {
+    row = y + ctx->y_row[ey + i];
+    for (j = 0; j < 8; j++)
+      blk[i * 8 + j] = (float)((int)row[col[j]] - 128);
+  }
+}
+
+/*==============================================================================
+* Function : jpege_gather_chroma
+* Parameters: ctx, cx, cy, blk0, blk1
+* Return Value : None
+* Description: Load both chroma blocks through the offset tables
+==============================================================================*/
+static void jpege_gather_chroma(jpege_ctx_t *ctx, uint32_t cx, uint32_t cy,
+  float *blk0, float *blk1)
+{
+  const uint8_t *c = ctx->img->cbcr;
+  const uint32_t *col = ctx->c_col + cx;
+  const uint8_t *row, *p;
+  int i, j;
+
+  for (i = 0; i < 8; i++) {
+    row = c + ctx->c_row[cy + i];
+    for (j = 0; j < 8; j++) {
+      p = row + col[j];
+      blk0[i * 8 + j] = (float)((int)p[0] - 128);
+      blk1[i * 8 + j] = (float)((int)p[1] - 128);
+    }
+  }
+}
+
+/*==============================================================================
+* Function : jpege_encode_slice
+* Parameters: ctx, idx
+* Return Value : None
+* Description: Encode one stripe of MCU rows into its output area. All but
+* the last stripe end with a restart marker.
+==============================================================================*/
+static void jpege_encode_slice(jpege_ctx_t *ctx, uint32_t idx)
+{
+  const jpege_sw_image_t *img = ctx->img;
+  jpege_slice_t *slice = &ctx->slices[idx];
+  float blk[64] __attribute__((aligned(16)));
+  float cblk[2][64] __attribute__((aligned(16)));
+  int16_t coef[64] __attribute__((aligned(16)));
+  int32_t last_dc[3] = { 0, 0, 0 };
+  uint32_t c_w = (ctx->enc_w + ctx->hs - 1) / ctx->hs;
+  uint32_t c_h = (ctx->enc_h + ctx->vs - 1) / ctx->vs;
+  uint32_t my0 = idx * ctx->rows_per_slice;
+  uint32_t my1 = my0 + ctx->rows_per_slice;
+  uint32_t mx, my, bx, by, ex, ey, cx, cy;
+  int cb = img->cr_first ? 1 : 0;
+  jpege_bitwriter_t bw;
+
+  if (my1 > ctx->mcus_y)
+    my1 = ctx->mcus_y;
+
+  bw.ptr = slice->start;
+  bw.end = slice->start + slice->size;
+  bw.acc = 0;
+  bw.bits = 0;
+  bw.overflow = 0;
+
+  for (my = my0; my < my1 && !bw.overflow; my++) {
+    for (mx = 0; mx < ctx->mcus_x; mx++) {
+      for (by = 0; by < ctx->vs; by++) {
+        for (bx = 0; bx < ctx->hs; bx++) {
+          ex = (mx * ctx->hs + bx) * 8;
+          ey = (my * ctx->vs + by) * 8;
+          if (ctx->y_fast && (ex + 8 <= ctx->enc_w) &&
+            (ey + 8 <= ctx->enc_h)) {
+            jpege_sw_load_block(img->y + ctx->y_row[ey] + ctx->y_col[ex],
+              img->y_stride, blk);
+          } else {
+            jpege_gather_luma(ctx, ex, ey, blk);
+          }
+          jpege_sw_fdct_quant(blk, ctx->qrecip[0], coef);
+          jpege_encode_block(&bw, coef, &last_dc[0], &ctx->dc[0], &ctx->ac[0]);
+        }
+      }
+
+      cx = mx * 8;
+      cy = my * 8;
+      if (ctx->c_fast && (cx + 8 <= c_w) && (cy + 8 <= c_h)) {
+        jpege_sw_load_chroma_blocks(img->cbcr + ctx->c_row[cy] +
+          ctx->c_col[cx], img->cbcr_stride, cblk[0], cblk[1]);
+      } else {
+        jpege_gather_chroma(ctx, cx, cy, cblk[0], cblk[1]);
+      }
+      jpege_sw_fdct_quant(cblk[cb], ctx->qrecip[1], coef);
+      jpege_encode_block(&bw, coef, &last_dc[1], &ctx->dc[1], &ctx->ac[1]);
+      jpege_sw_fdct_quant(cblk[1 - cb], ctx->qrecip[1], coef);
+      jpege_encode_block(&bw, coef, &last_dc[2], &ctx->dc[1], &ctx->ac[1]);
+    }
+  }
+  jpege_flush_bits(&bw);
+
+  if (!bw.overflow && (idx + 1 < ctx->num_slices)) {
+    if (bw.ptr + 2 > bw.end) {
+      bw.overflow = 1;
+    } else {
+      *bw.ptr++ = 0xFF;
+      *bw.ptr++ = (uint8_t)(0xD0 + (idx & 7));
+    }
+  }
+  slice->error = bw.overflow;
+  slice->len = (uint32_t)(bw.ptr - slice->start);
+}
+
+/*==============================================================================
+* Function : jpege_slice_worker
+* Parameters: data
+* Return Value : NULL
+* Description: Encode stripes until none is left
+==============================================================================*/
+static void *jpege_slice_worker(void *data)
+{
+  jpege_ctx_t *ctx = (jpege_ctx_t *)data;
+  uint32_t idx;
+
+  while (1) {
+    pthread_mutex_lock(&ctx->lock);
+    idx = ctx->next_slice++;
+    pthread_mutex_unlock(&ctx->lock);
+    if (idx >= ctx->num_slices)
+      break;
+    jpege_encode_slice(ctx, idx);
+  }
+  return NULL;
+}
+
+/*==============================================================================
+* Function : jpege_encode_slices
+* Parameters: ctx, dst, size
+* Return Value : encoded length, 0 if the buffer is too small
+* Description: Split the output area between the stripes in proportion to
+* their MCU rows, encode them on up to one thread per cpu and join the
+* results
+==============================================================================*/
+static uint32_t jpege_encode_slices(jpege_ctx_t *ctx, uint8_t *dst,
+  uint32_t size)
+{
+  pthread_t tid[JPEGE_SW_MAX_SLICES];
+  uint32_t nthreads, started = 0, i, rows, off = 0, len = 0;
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+  for (i = 0; i < ctx->num_slices; i++) {
+    rows = ctx->mcus_y - i * ctx->rows_per_slice;
+    if (rows > ctx->rows_per_slice)
+      rows = ctx->rows_per_slice;
+    ctx->slices[i].start = dst + off;
+    ctx->slices[i].size = (i + 1 == ctx->num_slices) ? size - off :
+      (uint32_t)(((uint64_t)size * rows) / ctx->mcus_y);
+    off += ctx->slices[i].size;
+  }
+
+  nthreads = (ncpu > 1) ? (uint32_t)ncpu : 1;
+  if (nthreads > ctx->num_slices)
+    nthreads = ctx->num_slices;
+
+  ctx->next_slice = 0;
+  for (i = 1; i < nthreads; i++) {
+    if (pthread_create(&tid[started], NULL, jpege_slice_worker, ctx) == 0)
+      started++;
+  }
+  jpege_slice_worker(ctx);
+  for (i = 0; i < started; i++)
+    pthread_join(tid[i], NULL);
+
+  for (i = 0; i < ctx->num_slices; i++) {
+    if (ctx->slices[i].error)
+      return 0;
+    if (ctx->slices[i].start != dst + len)
+      memmove(dst + len, ctx->slices[i].start, ctx->slices[i].len);
+    len += ctx->slices[i].len;
+  }
+  return len;
+}
+
+/*==============================================================================
+* Function : jpege_write_headers
+* Parameters: ctx, app, app_len, dst, size
+* Return Value : header length, 0 if the buffer is too small
+* Description: Write SOI, application segment, DQT, SOF0, DHT, DRI and SOS
+==============================================================================*/
+static uint32_t jpege_write_headers(jpege_ctx_t *ctx, const uint8_t *app,
+  uint32_t app_len, uint8_t *dst, uint32_t size)
+{
+  static const uint8_t jfif[] = {
+    0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00,
+    0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+  };
+  const uint8_t *bits[4] = { jpege_dc_luma_bits, jpege_ac_luma_bits,
+    jpege_dc_chroma_bits, jpege_ac_chroma_bits };
+  const uint8_t *vals[4] = { jpege_dc_vals, jpege_ac_luma_vals,
+    jpege_dc_vals, jpege_ac_chroma_vals };
+  const uint8_t tc_th[4] = { 0x00, 0x10, 0x01, 0x11 };
+  uint32_t need, nvals[4], dht_len = 2, i, k;
+  uint32_t restart = ctx->rows_per_slice * ctx->mcus_x;
+  uint8_t *p = dst;
+
+  for (i = 0; i < 4; i++) {
+    for (k = 0, nvals[i] = 0; k < 16; k++)
+      nvals[i] += bits[i][k];
+    dht_len += 17 + nvals[i];
+  }
+  if (NULL == app) {
+    app = jfif;
+    app_len = sizeof(jfif);
+  }
+  need = 2 + app_len + 134 + 19 + 2 + dht_len + 6 + 14;
+  if (need > size)
+    return 0;
+
+  *p++ = 0xFF; *p++ = 0xD8;
+  memcpy(p, app, app_len);
+  p += app_len;
+
+  /* DQT */
+  *p++ = 0xFF; *p++ = 0xDB; *p++ = 0; *p++ = 132;
+  for (i = 0; i < 2; i++) {
+    *p++ = (uint8_t)i;
+    for (k = 0; k < 64; k++)
+      *p++ = ctx->qt[i][jpege_zigzag[k]];
+  }
+
+  /* SOF0 */
+  *p++ = 0xFF; *p++ = 0xC0; *p++ = 0; *p++ = 17;
+  *p++ = 8;
+  *p++ = (uint8_t)(ctx->enc_h >> 8); *p++ = (uint8_t)ctx->enc_h;
+  *p++ = (uint8_t)(ctx->enc_w >> 8); *p++ = (uint8_t)ctx->enc_w;
+  *p++ = 3;
+  *p++ = 1; *p++ = (uint8_t)((ctx->hs << 4) | ctx->vs); *p++ = 0;
+  *p++ = 2; *p++ = 0x11; *p++ = 1;
+  *p++ = 3; *p++ = 0x11; *p++ = 1;
+
+  /* DHT */
+  *p++ = 0xFF; *p++ = 0xC4;
+  *p++ = (uint8_t)(dht_len >> 8); *p++ = (uint8_t)dht_len;
+  for (i = 0; i < 4; i++) {
+    *p++ = tc_th[i];
+    memcpy(p, bits[i], 16);
+    p += 16;
+    memcpy(p, vals[i], nvals[i]);
+    p += nvals[i];
+  }
+
+  /* DRI */
+  if (ctx->num_slices > 1) {
+    *p++ = 0xFF; *p++ = 0xDD; *p++ = 0; *p++ = 4;
+    *p++ = (uint8_t)(restart >> 8); *p++ = (uint8_t)restart;
+  }
+
+  /* SOS */
+  *p++ = 0xFF; *p++ = 0xDA; *p++ = 0; *p++ = 12;
+  *p++ = 3;
+  *p++ = 1; *p++ = 0x00;
+  *p++ = 2; *p++ = 0x11;
+  *p++ = 3; *p++ = 0x11;
+  *p++ = 0; *p++ = 63; *p++ = 0;
+
+  return (uint32_t)(p - dst);
+}
+
+/*==============================================================================
+* Function : jpege_sw_normalize
+* Parameters: img, in, out
+* Return Value : None
+* Description: Fill in defaults and clamp the crop window to the frame
+==============================================================================*/
+static void jpege_sw_normalize(const jpege_sw_image_t *img,
+  const jpege_sw_params_t *in, jpege_sw_params_t *out)
+{
+  *out = *in;
+  if (out->crop_x >= img->width)
+    out->crop_x = 0;
+  if (out->crop_y >= img->height)
+    out->crop_y = 0;
+  if ((out->crop_w == 0) || (out->crop_x + out->crop_w > img->width))
+    out->crop_w = img->width - out->crop_x;
+  if ((out->crop_h == 0) || (out->crop_y + out->crop_h > img->height))
+    out->crop_h = img->height - out->crop_y;
+  if ((out->out_w == 0) || (out->out_h == 0)) {
+    out->out_w = out->crop_w;
+    out->out_h = out->crop_h;
+  }
+  out->rotation %= 360;
+}
+
+void jpege_sw_get_dims(const jpege_sw_image_t *img,
+  const jpege_sw_params_t *params, uint32_t *width, uint32_t *height)
+{
+  jpege_sw_params_t p;
+
+  jpege_sw_normalize(img, params, &p);
+  if ((p.rotation == 90) || (p.rotation == 270)) {
+    *width = p.out_h;
+    *height = p.out_w;
+  } else {
+    *width = p.out_w;
+    *height = p.out_h;
+  }
+}
+
+int jpege_sw_encode(const jpege_sw_image_t *img,
+  const jpege_sw_params_t *params,
+  const uint8_t *app, uint32_t app_len,
+  uint8_t *dst, uint32_t dst_size, uint32_t *out_len)
+{
+  jpege_ctx_t *ctx;
+  jpege_sw_params_t p;
+  uint32_t hdr_len, data_len, slices, max_rows;
+  long ncpu;
+  int rc = -1;
+
+  if (!img || !img->y || !img->cbcr || !img->width || !img->height ||
+    !params || !dst || !out_len ||
+    (img->h_sub < 1) || (img->h_sub > JPEGE_MAX_SAMP) ||
+    (img->v_sub < 1) || (img->v_sub > JPEGE_MAX_SAMP))
+    return -1;
+
+  jpege_sw_normalize(img, params, &p);
+  if ((p.rotation % 90) != 0)
+    return -1;
+
+  ctx = calloc(1, sizeof(*ctx));
+  if (NULL == ctx)
+    return -1;
+  ctx->img = img;
+  jpege_sw_get_dims(img, &p, &ctx->enc_w, &ctx->enc_h);
+  if ((ctx->enc_w > 0xFFFF) || (ctx->enc_h > 0xFFFF))
+    goto end;
+
+  /* chroma subsampling follows the rotation of the image */
+  if ((p.rotation == 90) || (p.rotation == 270)) {
+    ctx->hs = img->v_sub;
+    ctx->vs = img->h_sub;
+  } else {
+    ctx->hs = img->h_sub;
+    ctx->vs = img->v_sub;
+  }
+  ctx->mcus_x = (ctx->enc_w + ctx->hs * 8 - 1) / (ctx->hs * 8);
+  ctx->mcus_y = (ctx->enc_h + ctx->vs * 8 - 1) / (ctx->vs * 8);
+
+  slices = p.num_slices;
+  if (slices == 0) {
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    slices = (ncpu > 1) ? (uint32_t)ncpu : 1;
+  }
+  /* the restart interval is a 16 bit count of MCUs */
+  max_rows = JPEGE_MAX_RESTART_INTERVAL / ctx->mcus_x;
+  if ((max_rows > 0) && (slices < (ctx->mcus_y + max_rows - 1) / max_rows))
+    slices = (ctx->mcus_y + max_rows - 1) / max_rows;
+  if (slices > JPEGE_SW_MAX_SLICES)
+    slices = JPEGE_SW_MAX_SLICES;
+  if (slices > ctx->mcus_y)
+    slices = ctx->mcus_y;
+  ctx->rows_per_slice = (ctx->mcus_y + slices - 1) / slices;
+  ctx->num_slices = (ctx->mcus_y + ctx->rows_per_slice - 1) /
+    ctx->rows_per_slice;
+  if ((ctx->num_slices > 1) &&
+    (ctx->rows_per_slice * ctx->mcus_x > JPEGE_MAX_RESTART_INTERVAL))
+    goto end;
+
+  jpege_build_quant(ctx, p.quality);
+  jpege_build_huff(jpege_dc_luma_bits, jpege_dc_vals, &ctx->dc[0]);
+  jpege_build_huff(jpege_dc_chroma_bits, jpege_dc_vals, &ctx->dc[1]);
+  jpege_build_huff(jpege_ac_luma_bits, jpege_ac_luma_vals, &ctx->ac[0]);
+  jpege_build_huff(jpege_ac_chroma_bits, jpege_ac_chroma_vals, &ctx->ac[1]);
+  if (jpege_build_tables(ctx, &p, p.out_w, p.out_h) < 0)
+    goto end;
+  pthread_mutex_init(&ctx->lock, NULL);
+
+  hdr_len = jpege_write_headers(ctx, app, app_len, dst, dst_size);
+  if ((hdr_len == 0) || (hdr_len + 2 > dst_size))
+    goto free_tables;
+
+  data_len = jpege_encode_slices(ctx, dst + hdr_len, dst_size - hdr_len - 2);
+  if ((data_len == 0) && (ctx->num_slices > 1)) {
+    /* a stripe ran out of its share of the buffer, give the whole
+     * buffer to a single stripe */
+    ctx->num_slices = 1;
+    ctx->rows_per_slice = ctx->mcus_y;
+    hdr_len = jpege_write_headers(ctx, app, app_len, dst, dst_size);
+    data_len = jpege_encode_slices(ctx, dst + hdr_len,
+      dst_size - hdr_len - 2);
+  }
+  if (data_len == 0)
+    goto free_tables;
+
+  dst[hdr_len + data_len] = 0xFF;
+  dst[hdr_len + data_len + 1] = 0xD9;
+  *out_len = hdr_len + data_len + 2;
+  rc = 0;
+
+free_tables:
+  pthread_mutex_destroy(&ctx->lock);
+  free(ctx->y_row);
+end:
+  free(ctx);
+  return rc;
+}
@@ -0,0 +1,109 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+#ifndef JPEGE_SW_H
+#define JPEGE_SW_H
+
+#include <stdint.h>
+
+#define JPEGE_SW_MAX_SLICES 32
+
+/** jpege_sw_image_t: semi-planar YUV source image
+*    @y: first luma sample of the frame
+*    @cbcr: first chroma pair of the frame
+*    @width: frame width
+*    @height: frame height
+*    @y_stride: luma row stride in bytes
+*    @cbcr_stride: chroma row stride in bytes
+*    @h_sub: horizontal chroma subsampling (1 or 2)
+*    @v_sub: vertical chroma subsampling (1 or 2)
+*    @cr_first: 1 if Cr comes first in a chroma pair (NV21)
+**/
+typedef struct {
+  const uint8_t *y;
+  const uint8_t *cbcr;
+  uint32_t width;
+  uint32_t height;
+  uint32_t y_stride;
+  uint32_t cbcr_stride;
+  uint8_t h_sub;
+  uint8_t v_sub;
+  uint8_t cr_first;
+} jpege_sw_image_t;
+
+/** jpege_sw_params_t: encode parameters
+*    @crop_x, @crop_y, @crop_w, @crop_h: input crop, zero size means
+*       the full frame
+*    @out_w, @out_h: scaled output size before rotation, zero means
+*       the crop size
+*    @rotation: clockwise rotation, 0/90/180/270
+*    @quality: jpeg quality factor 1..100
+*    @num_slices: horizontal stripes encoded in parallel, separated by
+*       restart markers. 0 picks one per online cpu.
+**/
+typedef struct {
+  uint32_t crop_x;
+  uint32_t crop_y;
+  uint32_t crop_w;
+  uint32_t crop_h;
+  uint32_t out_w;
+  uint32_t out_h;
+  uint32_t rotation;
+  uint32_t quality;
+  uint32_t num_slices;
+} jpege_sw_params_t;
+
+/*==============================================================================
+* Function : jpege_sw_encode
+* Parameters: img, params, app, app_len, dst, dst_size, out_len
+* Return Value : 0 on success, -1 on failure
+* Description: Encode the image into a baseline JFIF/EXIF stream. If app is
+* not NULL, it is written as the application marker segment (including the
+* marker) instead of the default JFIF APP0.
+==============================================================================*/
+int jpege_sw_encode(const jpege_sw_image_t *img,
+  const jpege_sw_params_t *params,
+  const uint8_t *app, uint32_t app_len,
+  uint8_t *dst, uint32_t dst_size, uint32_t *out_len);
+
+/*==============================================================================
+* Function : jpege_sw_get_dims
+* Parameters: img, params, width, height
+* Return Value : None
+* Description: Get the dimension of the encoded image after crop, scaling
+* and rotation
+==============================================================================*/
+void jpege_sw_get_dims(const jpege_sw_image_t *img,
+  const jpege_sw_params_t *params, uint32_t *width, uint32_t *height);
+
+/* kernels, see jpege_sw_dct.c */
+void jpege_sw_load_block(const uint8_t *src, uint32_t stride, float *blk);
+void jpege_sw_load_chroma_blocks(const uint8_t *src, uint32_t stride,
+  float *blk0, float *blk1);
+void jpege_sw_fdct_quant(float *blk, const float *qrecip, int16_t *coef);
+
+#endif
@@ -0,0 +1,336 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+/* Pixel load, forward DCT and quantization kernels of the software jpeg
+ * encoder. The DCT is the AAN float transform with its output scaling folded
+ * into the quantization reciprocals. SSE2 and NEON versions work on four
+ * columns per vector; the scalar version is used on other targets. */
+
+#include <string.h>
+#include "jpege_sw.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define JPEGE_SW_SSE2
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define JPEGE_SW_NEON
+#endif
+
+#define C_0_382683433 0.382683433f
+#define C_0_541196100 0.541196100f
+#define C_0_707106781 0.707106781f
+#define C_1_306562965 1.306562965f
+
+/* one dimensional 8 point AAN forward DCT, in place on d0..d7 */
+#define JPEGE_FDCT_1D(T, ADD, SUB, MULC, d0, d1, d2, d3, d4, d5, d6, d7) \
+  do { \
+    T tmp0 = ADD(d0, d7), tmp7 = SUB(d0, d7); \
+    T tmp1 = ADD(d1, d6), tmp6 = SUB(d1, d6); \
+    T tmp2 = ADD(d2, d5), tmp5 = SUB(d2, d5); \
+    T tmp3 = ADD(d3, d4), tmp4 = SUB(d3, d4); \
+    T tmp10 = ADD(tmp0, tmp3), tmp13 = SUB(tmp0, tmp3); \
+    T tmp11 = ADD(tmp1, tmp2), tmp12 = SUB(tmp1, tmp2); \
+    T z1, z2, z3, z4, z5, z11, z13; \
+    d0 = ADD(tmp10, tmp11); \
+    d4 = SUB(tmp10, tmp11); \
+    z1 = MULC(ADD(tmp12, tmp13), C_0_707106781); \
+    d2 = ADD(tmp13, z1); \
+    d6 = SUB(tmp13, z1); \
+    tmp10 = ADD(tmp4, tmp5); \
+    tmp11 = ADD(tmp5, tmp6); \
+    tmp12 = ADD(tmp6, tmp7); \
+    z5 = MULC(SUB(tmp10, tmp12), C_0_382683433); \
+    z2 = ADD(MULC(tmp10, C_0_541196100), z5); \
+    z4 = ADD(MULC(tmp12, C_1_306562965), z5); \
+    z3 = MULC(tmp11, C_0_707106781); \
+    z11 = ADD(tmp7, z3); \
+    z13 = SUB(tmp7, z3); \
+    d5 = ADD(z13, z2); \
+    d3 = SUB(z13, z2); \
+    d1 = ADD(z11, z4); \
+    d7 = SUB(z11, z4); \
+  } while (0)
+
+#if defined(JPEGE_SW_SSE2)
+
+#define V_ADD(a, b) _mm_add_ps(a, b)
+#define V_SUB(a, b) _mm_sub_ps(a, b)
+#define V_MULC(a, c) _mm_mul_ps(a, _mm_set1_ps(c))
+
+static inline void jpege_sw_store_row(__m128i w, float *dst)
+{
+  /* sign extend the 8 level shifted samples to 32 bit and convert */
+  _mm_storeu_ps(dst,
+    _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16)));
+  _mm_storeu_ps(dst + 4,
+    _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(w, w), 16)));
+}
+
+void jpege_sw_load_block(const uint8_t *src, uint32_t stride, float *blk)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i level = _mm_set1_epi16(128);
+  int r;
+
+  for (r = 0; r < 8; r++, src += stride) {
+    __m128i p = _mm_loadl_epi64((const __m128i *)src);
+    jpege_sw_store_row(_mm_sub_epi16(_mm_unpacklo_epi8(p, zero), level),
+      blk + r * 8);
+  }
+}
+
+void jpege_sw_load_chroma_blocks(const uint8_t *src, uint32_t stride,
+  float *blk0, float *blk1)
+{
+  const __m128i mask = _mm_set1_epi16(0xFF);
+  const __m128i level = _mm_set1_epi16(128);
+  int r;
+
+  for (r = 0; r < 8; r++, src += stride) {
+    __m128i p = _mm_loadu_si128((const __m128i *)src);
+    jpege_sw_store_row(_mm_sub_epi16(_mm_and_si128(p, mask), level),
+      blk0 + r * 8);
+    jpege_sw_store_row(_mm_sub_epi16(_mm_srli_epi16(p, 8), level),
+      blk1 + r * 8);
+  }
+}
+
+/* transpose the 8x8 block held as lo/hi halves of 8 rows */
+static inline void jpege_sw_transpose(__m128 *lo, __m128 *hi)
+{
+  __m128 t;
+  int i;
+
+  _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+  _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+  _MM_TRANSPOSE4_PS(lo[4], lo[5], lo[6], lo[7]);
+  _MM_TRANSPOSE4_PS(hi[4], hi[5], hi[6], hi[7]);
+  for (i = 0; i < 4; i++) {
+    t = hi[i];
+    hi[i] = lo[i + 4];
+    lo[i + 4] = t;
+  }
+}
+
+void jpege_sw_fdct_quant(float *blk, const float *qrecip, int16_t *coef)
+{
+  __m128 lo[8], hi[8];
+  int r;
+
+  for (r = 0; r < 8; r++) {
+    lo[r] = _mm_loadu_ps(blk + r * 8);
+    hi[r] = _mm_loadu_ps(blk + r * 8 + 4);
+  }
+
+  /* columns */
+  JPEGE_FDCT_1D(__m128, V_ADD, V_SUB, V_MULC,
+    lo[0], lo[1], lo[2], lo[3], lo[4], lo[5], lo[6], lo[7]);
+  JPEGE_FDCT_1D(__m128, V_ADD, V_SUB, V_MULC,
+    hi[0], hi[1], hi[2], hi[3], hi[4], hi[5], hi[6], hi[7]);
+
+  /* rows */
+  jpege_sw_transpose(lo, hi);
+  JPEGE_FDCT_1D(__m128, V_ADD, V_SUB, V_MULC,
+    lo[0], lo[1], lo[2], lo[3], lo[4], lo[5], lo[6], lo[7]);
+  JPEGE_FDCT_1D(__m128, V_ADD, V_SUB, V_MULC,
+    hi[0], hi[1], hi[2], hi[3], hi[4], hi[5], hi[6], hi[7]);
+  jpege_sw_transpose(lo, hi);
+
+  /* quantize, rounding to nearest */
+  for (r = 0; r < 8; r++) {
+    __m128i a = _mm_cvtps_epi32(_mm_mul_ps(lo[r],
+      _mm_loadu_ps(qrecip + r * 8)));
+    __m128i b = _mm_cvtps_epi32(_mm_mul_ps(hi[r],
+      _mm_loadu_ps(qrecip + r * 8 + 4)));
+    _mm_storeu_si128((__m128i *)(coef + r * 8), _mm_packs_epi32(a, b));
+  }
+}
+
+#elif defined(JPEGE_SW_NEON)
+
+#define V_ADD(a, b) vaddq_f32(a, b)
+#define V_SUB(a, b) vsubq_f32(a, b)
+#define V_MULC(a, c) vmulq_n_f32(a, c)
+
+static inline void jpege_sw_store_row(int16x8_t w, float *dst)
+{
+  vst1q_f32(dst, vcvtq_f32_s32(vmovl_s16(vget_low_s16(w))));
+  vst1q_f32(dst + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(w))));
+}
+
+void jpege_sw_load_block(const uint8_t *src, uint32_t stride, float *blk)
+{
+  const int16x8_t level = vdupq_n_s16(128);
+  int r;
+
+  for (r = 0; r < 8; r++, src += stride) {
+    int16x8_t w = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src)));
+    jpege_sw_store_row(vsubq_s16(w, level), blk + r * 8);
+  }
+}
+
+void jpege_sw_load_chroma_blocks(const uint8_t *src, uint32_t stride,
+  float *blk0, float *blk1)
+{
+  const int16x8_t level = vdupq_n_s16(128);
+  int r;
+
+  for (r = 0; r < 8; r++, src += stride) {
+    uint8x8x2_t p = vld2_u8(src);
+    jpege_sw_store_row(vsubq_s16(
+      vreinterpretq_s16_u16(vmovl_u8(p.val[0])), level), blk0 + r * 8);
+    jpege_sw_store_row(vsubq_s16(
+      vreinterpretq_s16_u16(vmovl_u8(p.val[1])), level), blk1 + r * 8);
+  }
+}
+
+static inline void jpege_sw_transpose4(float32x4_t *r0, float32x4_t *r1,
+  float32x4_t *r2, float32x4_t *r3)
+{
+  float32x4x2_t t01 = vtrnq_f32(*r0, *r1);
+  float32x4x2_t t23 = vtrnq_f32(*r2, *r3);
+
+  *r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+  *r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+  *r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+  *r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+
+static inline void jpege_sw_transpose(float32x4_t *lo, float32x4_t *hi)
+{
+  float32x4_t t;
+  int i;
+
+  jpege_sw_transpose4(&lo[0], &lo[1], &lo[2], &lo[3]);
+  jpege_sw_transpose4(&hi[0], &hi[1], &hi[2], &hi[3]);
+  jpege_sw_transpose4(&lo[4], &lo[5], &lo[6], &lo[7]);
+  jpege_sw_transpose4(&hi[4], &hi[5], &hi[6], &hi[7]);
+  for (i = 0; i < 4; i++) {
+    t = hi[i];
+    hi[i] = lo[i + 4];
+    lo[i + 4] = t;
+  }
+}
+
+static inline int32x4_t jpege_sw_round(float32x4_t v)
+{
+#if defined(__aarch64__)
+  return vcvtnq_s32_f32(v);
+#else
+  /* round half away from zero, vcvtq truncates */
+  uint32x4_t neg = vcltq_f32(v, vdupq_n_f32(0.0f));
+  float32x4_t bias = vbslq_f32(neg, vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+  return vcvtq_s32_f32(vaddq_f32(v, bias));
+#endif
+}
+
+void jpege_sw_fdct_quant(float *blk, const float *qrecip, int16_t *coef)
+{
+  float32x4_t lo[8], hi[8];
+  int r;
+
+  for (r = 0; r < 8; r++) {
+    lo[r] = vld1q_f32(blk + r * 8);
+    hi[r] = vld1q_f32(blk + r * 8 + 4);
+  }
+
+  /* columns */
+  JPEGE_FDCT_1D(float32x4_t, V_ADD, V_SUB, V_MULC,
+    lo[0], lo[1], lo[2], lo[3], lo[4], lo[5], lo[6], lo[7]);
+  JPEGE_FDCT_1D(float32x4_t, V_ADD, V_SUB, V_MULC,
+    hi[0], hi[1], hi[2], hi[3], hi[4], hi[5], hi[6], hi[7]);
+
+  /* rows */
+  jpege_sw_transpose(lo, hi);
+  JPEGE_FDCT_1D(float32x4_t, V_ADD, V_SUB, V_MULC,
+    lo[0], lo[1], lo[2], lo[3], lo[4], lo[5], lo[6], lo[7]);
+  JPEGE_FDCT_1D(float32x4_t, V_ADD, V_SUB, V_MULC,
+    hi[0], hi[1], hi[2], hi[3], hi[4], hi[5], hi[6], hi[7]);
+  jpege_sw_transpose(lo, hi);
+
+  for (r = 0; r < 8; r++) {
+    int32x4_t a = jpege_sw_round(vmulq_f32(lo[r], vld1q_f32(qrecip + r * 8)));
+    int32x4_t b = jpege_sw_round(vmulq_f32(hi[r],
+      vld1q_f32(qrecip + r * 8 + 4)));
+    vst1q_s16(coef + r * 8, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+  }
+}
+
+#else
+
+#define S_ADD(a, b) ((a) + (b))
+#define S_SUB(a, b) ((a) - (b))
+#define S_MULC(a, c) ((a) * (c))
+
+void jpege_sw_load_block(const uint8_t *src, uint32_t stride, float *blk)
+{
+  int r, c;
+
+  for (r = 0; r < 8; r++, src += stride) {
+    for (c = 0; c < 8; c++) {
+      blk[r * 8 + c] = (float)((int)src[c] - 128);
+    }
+  }
+}
+
+void jpege_sw_load_chroma_blocks(const uint8_t *src, uint32_t stride,
+  float *blk0, float *blk1)
+{
+  int r, c;
+
+  for (r = 0; r < 8; r++, src += stride) {
+    for (c = 0; c < 8; c++) {
+      blk0[r * 8 + c] = (float)((int)src[2 * c] - 128);
+      blk1[r * 8 + c] = (float)((int)src[2 * c + 1] - 128);
+    }
+  }
+}
+
+void jpege_sw_fdct_quant(float *blk, const float *qrecip, int16_t *coef)
+{
+  float *p;
+  float v;
+  int i;
+
+  /* rows */
+  for (i = 0, p = blk; i < 8; i++, p += 8) {
+    JPEGE_FDCT_1D(float, S_ADD, S_SUB, S_MULC,
+      p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7]);
+  }
+  /* columns */
+  for (i = 0, p = blk; i < 8; i++, p++) {
+    JPEGE_FDCT_1D(float, S_ADD, S_SUB, S_MULC,
+      p[0], p[8], p[16], p[24], p[32], p[40], p[48], p[56]);
+  }
+  for (i = 0; i < 64; i++) {
+    v = blk[i] * qrecip[i];
+    coef[i] = (int16_t)(v < 0 ? (int)(v - 0.5f) : (int)(v + 0.5f));
+  }
+}
+
+#endif
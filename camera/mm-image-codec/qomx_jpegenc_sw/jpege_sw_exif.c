@@ -0,0 +1,358 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "jpege_sw_exif.h"
+
+#define TAG_EXIF_IFD_PTR   0x8769
+#define TAG_GPS_IFD_PTR    0x8825
+#define TAG_INTEROP_PTR    0xA005
+#define TAG_COMPRESSION    0x0103
+#define TAG_JPEG_IF_OFFSET 0x0201
+#define TAG_JPEG_IF_LENGTH 0x0202
+#define TAG_EXIF_VERSION   0x9000
+#define TAG_PIXEL_X_DIM    0xA002
+#define TAG_PIXEL_Y_DIM    0xA003
+
+#define EXIF_HDR_LEN 10 /* APP1 marker, length and "Exif\0\0" */
+
+typedef enum {
+  JPEGE_IFD_0,
+  JPEGE_IFD_EXIF,
+  JPEGE_IFD_GPS,
+  JPEGE_IFD_1,
+  JPEGE_IFD_MAX
+} jpege_ifd_t;
+
+/** jpege_exif_entry_t: one directory entry to be written
+*    @tag: 16 bit tag number
+*    @type: exif data type
+*    @count: number of elements
+*    @data: elements in host byte order
+**/
+typedef struct {
+  uint16_t tag;
+  uint16_t type;
+  uint32_t count;
+  const void *data;
+} jpege_exif_entry_t;
+
+/** jpege_exif_dir_t: entries of one IFD
+*    @entries: entry list sorted by tag
+*    @num: number of entries
+*    @offset: offset of the IFD from the TIFF header
+*    @size: size of the IFD including its value area
+**/
+typedef struct {
+  jpege_exif_entry_t *entries;
+  uint32_t num;
+  uint32_t offset;
+  uint32_t size;
+} jpege_exif_dir_t;
+
+static uint32_t jpege_exif_type_size(uint16_t type)
+{
+  switch (type) {
+  case EXIF_SHORT:
+    return 2;
+  case EXIF_LONG:
+  case EXIF_SLONG:
+    return 4;
+  case EXIF_RATIONAL:
+  case EXIF_SRATIONAL:
+    return 8;
+  default:
+    return 1;
+  }
+}
+
+static inline uint32_t jpege_exif_data_size(const jpege_exif_entry_t *e)
+{
+  return e->count * jpege_exif_type_size(e->type);
+}
+
+/*==============================================================================
+* Function : jpege_exif_classify
+* Parameters: tag_id
+* Return Value : IFD of the tag, JPEGE_IFD_MAX if it is written by the encoder
+* Description: Find the IFD of a qexif tag from its offset in the tag table
+==============================================================================*/
+static jpege_ifd_t jpege_exif_classify(exif_tag_id_t tag_id)
+{
+  uint32_t offset = tag_id >> 16;
+  uint16_t tag = (uint16_t)(tag_id & 0xFFFF);
+
+  if (offset <= GPS_DIFFERENTIAL)
+    return JPEGE_IFD_GPS;
+  if (offset <= GPS_IFD) {
+    if ((tag == TAG_EXIF_IFD_PTR) || (tag == TAG_GPS_IFD_PTR))
+      return JPEGE_IFD_MAX;
+    return JPEGE_IFD_0;
+  }
+  if (offset <= TN_COPYRIGHT) {
+    if ((tag == TAG_JPEG_IF_OFFSET) || (tag == TAG_JPEG_IF_LENGTH))
+      return JPEGE_IFD_MAX;
+    return JPEGE_IFD_1;
+  }
+  if (offset < EXIF_TAG_MAX_OFFSET) {
+    if (tag == TAG_INTEROP_PTR)
+      return JPEGE_IFD_MAX;
+    return JPEGE_IFD_EXIF;
+  }
+  return JPEGE_IFD_MAX;
+}
+
+/*==============================================================================
+* Function : jpege_exif_add
+* Parameters: dir, tag, type, count, data
+* Return Value : None
+* Description: Insert an entry keeping the directory sorted by tag. An
+* existing entry with the same tag is kept.
+==============================================================================*/
+static void jpege_exif_add(jpege_exif_dir_t *dir, uint16_t tag,
+  uint16_t type, uint32_t count, const void *data)
+{
+  uint32_t i = dir->num;
+
+  while ((i > 0) && (dir->entries[i - 1].tag >= tag)) {
+    if (dir->entries[i - 1].tag == tag)
+      return;
+    i--;
+  }
+  memmove(&dir->entries[i + 1], &dir->entries[i],
+    (dir->num - i) * sizeof(jpege_exif_entry_t));
+  dir->entries[i].tag = tag;
+  dir->entries[i].type = type;
+  dir->entries[i].count = count;
+  dir->entries[i].data = data;
+  dir->num++;
+}
+
+static inline int jpege_exif_has(jpege_exif_dir_t *dir, uint16_t tag)
+{
+  uint32_t i;
+
+  for (i = 0; i < dir->num; i++) {
+    if (dir->entries[i].tag == tag)
+      return 1;
+  }
+  return 0;
+}
+
+static uint32_t jpege_exif_dir_size(jpege_exif_dir_t *dir)
+{
+  uint32_t size = 2 + 12 * dir->num + 4, len, i;
+
+  for (i = 0; i < dir->num; i++) {
+    len = jpege_exif_data_size(&dir->entries[i]);
+    if (len > 4)
+      size += (len + 1) & ~1u;
+  }
+  return size;
+}
+
+static inline void jpege_put16(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+}
+
+static inline void jpege_put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+/*==============================================================================
+* Function : jpege_exif_put_value
+* Parameters: dst, e
+* Return Value : None
+* Description: Write the elements of an entry in big endian order
+==============================================================================*/
+static void jpege_exif_put_value(uint8_t *dst, const jpege_exif_entry_t *e)
+{
+  uint32_t i;
+
+  switch (e->type) {
+  case EXIF_SHORT:
+    for (i = 0; i < e->count; i++)
+      jpege_put16(dst + 2 * i, ((const uint16_t *)e->data)[i]);
+    break;
+  case EXIF_LONG:
+  case EXIF_SLONG:
+  case EXIF_RATIONAL:
+  case EXIF_SRATIONAL:
+    /* rationals are two 32 bit words */
+    for (i = 0; i < e->count * jpege_exif_type_size(e->type) / 4; i++)
+      jpege_put32(dst + 4 * i, ((const uint32_t *)e->data)[i]);
+    break;
+  default:
+    memcpy(dst, e->data, e->count);
+    break;
+  }
+}
+
+/*==============================================================================
+* Function : jpege_exif_write_dir
+* Parameters: tiff, dir, next
+* Return Value : None
+* Description: Write the IFD and its value area at dir->offset
+==============================================================================*/
+static void jpege_exif_write_dir(uint8_t *tiff, jpege_exif_dir_t *dir,
+  uint32_t next)
+{
+  uint8_t *p = tiff + dir->offset;
+  uint32_t data_off = dir->offset + 2 + 12 * dir->num + 4, len, i;
+  const jpege_exif_entry_t *e;
+
+  jpege_put16(p, dir->num);
+  p += 2;
+  for (i = 0; i < dir->num; i++, p += 12) {
+    e = &dir->entries[i];
+    len = jpege_exif_data_size(e);
+    jpege_put16(p, e->tag);
+    jpege_put16(p + 2, e->type);
+    jpege_put32(p + 4, e->count);
+    memset(p + 8, 0, 4);
+    if (len <= 4) {
+      jpege_exif_put_value(p + 8, e);
+    } else {
+      jpege_put32(p + 8, data_off);
+      jpege_exif_put_value(tiff + data_off, e);
+      if (len & 1)
+        tiff[data_off + len] = 0;
+      data_off += (len + 1) & ~1u;
+    }
+  }
+  jpege_put32(p, next);
+}
+
+int jpege_sw_exif_write(const QEXIF_INFO_DATA *tags, uint32_t num_tags,
+  uint32_t width, uint32_t height,
+  const uint8_t *thumb, uint32_t thumb_len,
+  uint8_t *dst, uint32_t dst_size, uint32_t *out_len)
+{
+  static const uint8_t exif_version[4] = { '0', '2', '2', '0' };
+  static const uint16_t jpeg_compression = 6;
+  jpege_exif_dir_t dir[JPEGE_IFD_MAX];
+  jpege_exif_entry_t *pool;
+  const exif_tag_entry_t *t;
+  uint32_t exif_off = 0, gps_off = 0, ifd1_off = 0, thumb_off = 0;
+  uint32_t tiff_len, i, max;
+  jpege_ifd_t ifd;
+  uint8_t *tiff;
+  int rc = -1;
+
+  /* every IFD can hold all client tags plus the ones added here */
+  max = num_tags + 4;
+  pool = calloc(JPEGE_IFD_MAX * max, sizeof(jpege_exif_entry_t));
+  if (NULL == pool)
+    return -1;
+  memset(dir, 0, sizeof(dir));
+  for (i = 0; i < JPEGE_IFD_MAX; i++)
+    dir[i].entries = pool + i * max;
+
+  for (i = 0; i < num_tags; i++) {
+    t = &tags[i].tag_entry;
+    ifd = jpege_exif_classify(tags[i].tag_id);
+    if ((ifd == JPEGE_IFD_MAX) || ((ifd == JPEGE_IFD_1) && !thumb))
+      continue;
+    /* single values live in the union, arrays and strings behind a ptr */
+    jpege_exif_add(&dir[ifd], (uint16_t)(tags[i].tag_id & 0xFFFF),
+      (uint16_t)t->type, t->count,
+      ((t->count > 1) || (t->type == EXIF_ASCII) ||
+       (t->type == EXIF_UNDEFINED)) ? (const void *)t->data._bytes :
+      (const void *)&t->data);
+  }
+
+  if (!jpege_exif_has(&dir[JPEGE_IFD_EXIF], TAG_EXIF_VERSION))
+    jpege_exif_add(&dir[JPEGE_IFD_EXIF], TAG_EXIF_VERSION, EXIF_UNDEFINED,
+      4, exif_version);
+  jpege_exif_add(&dir[JPEGE_IFD_EXIF], TAG_PIXEL_X_DIM, EXIF_LONG, 1, &width);
+  jpege_exif_add(&dir[JPEGE_IFD_EXIF], TAG_PIXEL_Y_DIM, EXIF_LONG, 1, &height);
+
+  /* pointer values are patched in once the layout is known */
+  jpege_exif_add(&dir[JPEGE_IFD_0], TAG_EXIF_IFD_PTR, EXIF_LONG, 1, &exif_off);
+  if (dir[JPEGE_IFD_GPS].num > 0)
+    jpege_exif_add(&dir[JPEGE_IFD_0], TAG_GPS_IFD_PTR, EXIF_LONG, 1, &gps_off);
+  if (thumb) {
+    jpege_exif_add(&dir[JPEGE_IFD_1], TAG_COMPRESSION, EXIF_SHORT, 1,
+      &jpeg_compression);
+    jpege_exif_add(&dir[JPEGE_IFD_1], TAG_JPEG_IF_OFFSET, EXIF_LONG, 1,
+      &thumb_off);
+    jpege_exif_add(&dir[JPEGE_IFD_1], TAG_JPEG_IF_LENGTH, EXIF_LONG, 1,
+      &thumb_len);
+  }
+
+  tiff_len = 8;
+  for (i = 0; i < JPEGE_IFD_MAX; i++) {
+    if ((dir[i].num == 0) && (i != JPEGE_IFD_0))
+      continue;
+    dir[i].offset = tiff_len;
+    dir[i].size = jpege_exif_dir_size(&dir[i]);
+    tiff_len += dir[i].size;
+  }
+  exif_off = dir[JPEGE_IFD_EXIF].offset;
+  gps_off = dir[JPEGE_IFD_GPS].offset;
+  ifd1_off = thumb ? dir[JPEGE_IFD_1].offset : 0;
+  thumb_off = tiff_len;
+  if (thumb)
+    tiff_len += thumb_len;
+
+  if ((tiff_len + EXIF_HDR_LEN - 2 > JPEGE_SW_EXIF_MAX_LEN) ||
+    (tiff_len + EXIF_HDR_LEN > dst_size))
+    goto end;
+
+  dst[0] = 0xFF;
+  dst[1] = 0xE1;
+  jpege_put16(dst + 2, tiff_len + EXIF_HDR_LEN - 2);
+  memcpy(dst + 4, "Exif\0\0", 6);
+  tiff = dst + EXIF_HDR_LEN;
+  tiff[0] = 'M';
+  tiff[1] = 'M';
+  jpege_put16(tiff + 2, 0x2A);
+  jpege_put32(tiff + 4, 8);
+
+  jpege_exif_write_dir(tiff, &dir[JPEGE_IFD_0], ifd1_off);
+  jpege_exif_write_dir(tiff, &dir[JPEGE_IFD_EXIF], 0);
+  if (dir[JPEGE_IFD_GPS].num > 0)
+    jpege_exif_write_dir(tiff, &dir[JPEGE_IFD_GPS], 0);
+  if (thumb) {
+    jpege_exif_write_dir(tiff, &dir[JPEGE_IFD_1], 0);
+    memcpy(tiff + thumb_off, thumb, thumb_len);
+  }
+
+  *out_len = tiff_len + EXIF_HDR_LEN;
+  rc = 0;
+
+end:
+  free(pool);
+  return rc;
+}
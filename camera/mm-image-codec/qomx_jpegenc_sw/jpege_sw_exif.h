@@ -0,0 +1,52 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+#ifndef JPEGE_SW_EXIF_H
+#define JPEGE_SW_EXIF_H
+
+#include <stdint.h>
+#include "QOMX_JpegExtensions.h"
+
+/* largest APP1 payload, the segment length is a 16 bit field */
+#define JPEGE_SW_EXIF_MAX_LEN 0xFFFF
+
+/*==============================================================================
+* Function : jpege_sw_exif_write
+* Parameters: tags, num_tags, width, height, thumb, thumb_len, dst, dst_size,
+*   out_len
+* Return Value : 0 on success, -1 if the segment does not fit
+* Description: Build the EXIF APP1 segment from the client tags. Tags are
+* sorted into IFD0, EXIF, GPS and thumbnail IFDs by their qexif tag offset.
+* Pixel dimensions and the EXIF version are added if the client did not
+* pass them, and the thumbnail is appended to IFD1 if thumb is not NULL.
+==============================================================================*/
+int jpege_sw_exif_write(const QEXIF_INFO_DATA *tags, uint32_t num_tags,
+  uint32_t width, uint32_t height,
+  const uint8_t *thumb, uint32_t thumb_len,
+  uint8_t *dst, uint32_t dst_size, uint32_t *out_len);
+
+#endif
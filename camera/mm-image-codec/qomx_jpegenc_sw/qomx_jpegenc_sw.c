@@ -0,0 +1,1207 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+#define LOG_NDEBUG 0
+#define LOG_NIDEBUG 0
+#define LOG_TAG "qomx_jpegenc_sw"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "qomx_jpegenc_sw.h"
+
+#define QOMX_SW_EXIF_BUF_LEN (JPEGE_SW_EXIF_MAX_LEN + 2)
+
+static const uint8_t qomx_sw_no_app[1];
+
+static void *qomx_sw_worker(void *data);
+
+/*==============================================================================
+* Function : qomx_sw_get_obj
+* Parameters: hComp
+* Return Value : component object, NULL if the handle is invalid
+* Description: Get the encoder object from the OMX handle
+==============================================================================*/
+static inline qomx_jpegenc_sw_t *qomx_sw_get_obj(OMX_HANDLETYPE hComp)
+{
+  OMX_COMPONENTTYPE *p_comp = (OMX_COMPONENTTYPE *)hComp;
+
+  if (NULL == p_comp)
+    return NULL;
+  return (qomx_jpegenc_sw_t *)p_comp->pComponentPrivate;
+}
+
+/*==============================================================================
+* Function : qomx_sw_map_format
+* Parameters: format, h_sub, v_sub, cr_first
+* Return Value : 0 on success, -1 for an unsupported format
+* Description: Map a semi-planar OMX color format to the chroma layout
+==============================================================================*/
+static int qomx_sw_map_format(OMX_U32 format, uint8_t *h_sub, uint8_t *v_sub,
+  uint8_t *cr_first)
+{
+  switch (format) {
+  case OMX_COLOR_FormatYUV420SemiPlanar:
+    *h_sub = 2; *v_sub = 2; *cr_first = 0;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYVU420SemiPlanar:
+    *h_sub = 2; *v_sub = 2; *cr_first = 1;
+    break;
+  case OMX_COLOR_FormatYUV422SemiPlanar:
+    *h_sub = 2; *v_sub = 1; *cr_first = 0;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYVU422SemiPlanar:
+    *h_sub = 2; *v_sub = 1; *cr_first = 1;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYUV422SemiPlanar_h1v2:
+    *h_sub = 1; *v_sub = 2; *cr_first = 0;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYVU422SemiPlanar_h1v2:
+    *h_sub = 1; *v_sub = 2; *cr_first = 1;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYUV444SemiPlanar:
+    *h_sub = 1; *v_sub = 1; *cr_first = 0;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYVU444SemiPlanar:
+    *h_sub = 1; *v_sub = 1; *cr_first = 1;
+    break;
+  default:
+    return -1;
+  }
+  return 0;
+}
+
+/*==============================================================================
+* Function : qomx_sw_fill_image
+* Parameters: p_port, p_buf, offset, width, height, img
+* Return Value : 0 on success, -1 if the frame does not fit the buffer
+* Description: Describe the semi-planar frame held by an input buffer
+==============================================================================*/
+static int qomx_sw_fill_image(qomx_sw_port_t *p_port,
+  OMX_BUFFERHEADERTYPE *p_buf, QOMX_YUV_FRAME_INFO *offset,
+  OMX_U32 width, OMX_U32 height, jpege_sw_image_t *img)
+{
+  uint32_t y_end, c_end, stride;
+
+  if (qomx_sw_map_format(p_port->def.format.image.eColorFormat,
+    &img->h_sub, &img->v_sub, &img->cr_first) < 0)
+    return -1;
+
+  stride = (uint32_t)p_port->def.format.image.nStride;
+  if (stride < width)
+    stride = width;
+  img->width = width;
+  img->height = height;
+  img->y_stride = stride;
+  img->cbcr_stride = stride * 2 / img->h_sub;
+
+  y_end = offset->yOffset + img->y_stride * height;
+  c_end = offset->cbcrStartOffset[0] + offset->cbcrOffset[0] +
+    img->cbcr_stride * ((height + img->v_sub - 1) / img->v_sub);
+  if ((0 == width) || (0 == height) ||
+    (y_end > p_buf->nAllocLen) || (c_end > p_buf->nAllocLen))
+    return -1;
+
+  img->y = p_buf->pBuffer + offset->yOffset;
+  img->cbcr = p_buf->pBuffer + offset->cbcrStartOffset[0] +
+    offset->cbcrOffset[0];
+  return 0;
+}
+
+/*==============================================================================
+* Function : qomx_sw_encode_thumbnail
+* Parameters: p_obj, p_buf, rotation, quality, out_len
+* Return Value : 0 on success, -1 if the thumbnail cannot be encoded
+* Description: Encode the thumbnail into the scratch buffer. The stream
+* carries no application segment since it is embedded in the exif.
+==============================================================================*/
+static int qomx_sw_encode_thumbnail(qomx_jpegenc_sw_t *p_obj,
+  OMX_BUFFERHEADERTYPE *p_buf, uint32_t rotation, uint32_t quality,
+  uint32_t *out_len)
+{
+  QOMX_THUMBNAIL_INFO *p_info = &p_obj->thumb_info;
+  jpege_sw_image_t img;
+  jpege_sw_params_t params;
+
+  if (qomx_sw_fill_image(&p_obj->port[QOMX_SW_PORT_THUMB], p_buf,
+    &p_info->tmbOffset, p_info->input_width, p_info->input_height,
+    &img) < 0)
+    return -1;
+
+  memset(&params, 0, sizeof(params));
+  params.crop_x = (uint32_t)p_info->crop_info.nLeft;
+  params.crop_y = (uint32_t)p_info->crop_info.nTop;
+  params.crop_w = p_info->crop_info.nWidth;
+  params.crop_h = p_info->crop_info.nHeight;
+  if (p_info->scaling_enabled) {
+    params.out_w = p_info->output_width;
+    params.out_h = p_info->output_height;
+  }
+  params.rotation = rotation;
+  params.quality = quality;
+  params.num_slices = 1;
+
+  return jpege_sw_encode(&img, &params, qomx_sw_no_app, 0, p_obj->thumb_buf,
+    JPEGE_SW_EXIF_MAX_LEN, out_len);
+}
+
+/*==============================================================================
+* Function : qomx_sw_encode
+* Parameters: p_obj, p_main, p_thumb, p_out, thumb_dropped
+* Return Value : OMX_ERRORTYPE
+* Description: Encode the main image with its exif and thumbnail into the
+* output buffer. Called from the worker thread without the lock, the
+* parameters cannot change while the component is executing.
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_encode(qomx_jpegenc_sw_t *p_obj,
+  OMX_BUFFERHEADERTYPE *p_main, OMX_BUFFERHEADERTYPE *p_thumb,
+  OMX_BUFFERHEADERTYPE *p_out, OMX_BOOL *thumb_dropped)
+{
+  qomx_sw_port_t *p_port = &p_obj->port[QOMX_SW_PORT_MAIN];
+  jpege_sw_image_t img;
+  jpege_sw_params_t params;
+  uint32_t rotation, width, height, thumb_len = 0, exif_len = 0, len = 0;
+
+  *thumb_dropped = OMX_FALSE;
+  if (qomx_sw_fill_image(p_port, p_main, &p_obj->main_offset,
+    p_port->def.format.image.nFrameWidth,
+    p_port->def.format.image.nFrameHeight, &img) < 0) {
+    ALOGE("%s:%d] Invalid main image", __func__, __LINE__);
+    return OMX_ErrorBadParameter;
+  }
+
+  rotation = (uint32_t)(((p_obj->rotation % 360) + 360) % 360);
+  memset(&params, 0, sizeof(params));
+  if (p_obj->in_crop.nWidth && p_obj->in_crop.nHeight) {
+    params.crop_x = (uint32_t)p_obj->in_crop.nLeft;
+    params.crop_y = (uint32_t)p_obj->in_crop.nTop;
+    params.crop_w = p_obj->in_crop.nWidth;
+    params.crop_h = p_obj->in_crop.nHeight;
+  }
+  if (p_obj->out_crop.nWidth && p_obj->out_crop.nHeight) {
+    params.out_w = p_obj->out_crop.nWidth;
+    params.out_h = p_obj->out_crop.nHeight;
+  }
+  params.rotation = rotation;
+  params.quality = p_obj->quality;
+  jpege_sw_get_dims(&img, &params, &width, &height);
+
+  if (p_thumb && (qomx_sw_encode_thumbnail(p_obj, p_thumb, rotation,
+    p_obj->quality, &thumb_len) < 0)) {
+    ALOGE("%s:%d] Thumbnail does not fit, dropping it", __func__, __LINE__);
+    *thumb_dropped = OMX_TRUE;
+    p_thumb = NULL;
+  }
+
+  if (jpege_sw_exif_write(p_obj->exif, p_obj->num_exif, width, height,
+    p_thumb ? p_obj->thumb_buf : NULL, thumb_len,
+    p_obj->exif_buf, QOMX_SW_EXIF_BUF_LEN, &exif_len) < 0) {
+    if (NULL == p_thumb) {
+      ALOGE("%s:%d] Exif does not fit", __func__, __LINE__);
+      return OMX_ErrorOverflow;
+    }
+    ALOGE("%s:%d] Exif with thumbnail does not fit, dropping thumbnail",
+      __func__, __LINE__);
+    *thumb_dropped = OMX_TRUE;
+    if (jpege_sw_exif_write(p_obj->exif, p_obj->num_exif, width, height,
+      NULL, 0, p_obj->exif_buf, QOMX_SW_EXIF_BUF_LEN, &exif_len) < 0)
+      return OMX_ErrorOverflow;
+  }
+
+  if (jpege_sw_encode(&img, &params, p_obj->exif_buf, exif_len,
+    p_out->pBuffer, p_out->nAllocLen, &len) < 0) {
+    ALOGE("%s:%d] Encode failed", __func__, __LINE__);
+    return OMX_ErrorOverflow;
+  }
+  p_out->nOffset = 0;
+  p_out->nFilledLen = len;
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_sw_dequeue
+* Parameters: p_port
+* Return Value : oldest queued buffer of the port
+* Description: Remove the oldest queued buffer. Must be called with the lock.
+==============================================================================*/
+static OMX_BUFFERHEADERTYPE *qomx_sw_dequeue(qomx_sw_port_t *p_port)
+{
+  OMX_BUFFERHEADERTYPE *p_buf;
+
+  if (0 == p_port->num_queued)
+    return NULL;
+  p_buf = p_port->queue[0];
+  p_port->num_queued--;
+  memmove(&p_port->queue[0], &p_port->queue[1],
+    p_port->num_queued * sizeof(p_port->queue[0]));
+  return p_buf;
+}
+
+/*==============================================================================
+* Function : qomx_sw_return_buffers
+* Parameters: p_obj, port_idx
+* Return Value : None
+* Description: Return all buffers queued on a port to the client. Must be
+* called with the lock, which is dropped around the callbacks.
+==============================================================================*/
+static void qomx_sw_return_buffers(qomx_jpegenc_sw_t *p_obj, OMX_U32 port_idx)
+{
+  OMX_BUFFERHEADERTYPE *p_buf;
+
+  while (NULL != (p_buf = qomx_sw_dequeue(&p_obj->port[port_idx]))) {
+    pthread_mutex_unlock(&p_obj->lock);
+    if (port_idx == QOMX_SW_PORT_OUT) {
+      p_buf->nFilledLen = 0;
+      p_obj->callbacks.FillBufferDone(&p_obj->omx_comp, p_obj->app_data,
+        p_buf);
+    } else {
+      p_obj->callbacks.EmptyBufferDone(&p_obj->omx_comp, p_obj->app_data,
+        p_buf);
+    }
+    pthread_mutex_lock(&p_obj->lock);
+  }
+}
+
+/*==============================================================================
+* Function : qomx_sw_state_change_ready
+* Parameters: p_obj
+* Return Value : OMX_TRUE if the pending state change can complete
+* Description: Loaded to Idle waits for the enabled ports to be populated
+* and Idle to Loaded waits for all buffers to be freed.
+==============================================================================*/
+static OMX_BOOL qomx_sw_state_change_ready(qomx_jpegenc_sw_t *p_obj)
+{
+  qomx_sw_port_t *p_port;
+  int i;
+
+  if (!p_obj->state_change_pending)
+    return OMX_FALSE;
+
+  for (i = 0; i < QOMX_SW_NUM_PORTS; i++) {
+    p_port = &p_obj->port[i];
+    if ((p_obj->state == OMX_StateLoaded) &&
+      (p_obj->target_state == OMX_StateIdle) && p_port->def.bEnabled &&
+      (p_port->num_bufs < p_port->def.nBufferCountActual))
+      return OMX_FALSE;
+    if ((p_obj->state == OMX_StateIdle) &&
+      (p_obj->target_state == OMX_StateLoaded) && (p_port->num_bufs > 0))
+      return OMX_FALSE;
+  }
+  return OMX_TRUE;
+}
+
+/*==============================================================================
+* Function : qomx_sw_job_ready
+* Parameters: p_obj
+* Return Value : OMX_TRUE if a frame can be encoded
+* Description: An encode needs the main image, an output buffer and the
+* thumbnail if the thumbnail port is enabled.
+==============================================================================*/
+static OMX_BOOL qomx_sw_job_ready(qomx_jpegenc_sw_t *p_obj)
+{
+  if ((p_obj->state != OMX_StateExecuting) || p_obj->state_change_pending)
+    return OMX_FALSE;
+  if ((0 == p_obj->port[QOMX_SW_PORT_MAIN].num_queued) ||
+    (0 == p_obj->port[QOMX_SW_PORT_OUT].num_queued))
+    return OMX_FALSE;
+  if (p_obj->port[QOMX_SW_PORT_THUMB].def.bEnabled &&
+    (0 == p_obj->port[QOMX_SW_PORT_THUMB].num_queued))
+    return OMX_FALSE;
+  return OMX_TRUE;
+}
+
+/*==============================================================================
+* Function : qomx_sw_worker
+* Parameters: data - component object
+* Return Value : NULL
+* Description: Completes state changes and encodes frames. State changes
+* are completed here rather than in SendCommand since the client waits for
+* the completion event while holding its own lock.
+==============================================================================*/
+static void *qomx_sw_worker(void *data)
+{
+  qomx_jpegenc_sw_t *p_obj = (qomx_jpegenc_sw_t *)data;
+  OMX_BUFFERHEADERTYPE *p_main, *p_thumb, *p_out;
+  OMX_BOOL thumb_dropped;
+  OMX_STATETYPE state;
+  OMX_ERRORTYPE rc;
+  int i;
+
+  pthread_mutex_lock(&p_obj->lock);
+  while (!p_obj->exit) {
+    if (qomx_sw_state_change_ready(p_obj)) {
+      if (p_obj->target_state == OMX_StateIdle) {
+        for (i = 0; i < QOMX_SW_NUM_PORTS; i++)
+          qomx_sw_return_buffers(p_obj, i);
+      }
+      p_obj->state = p_obj->target_state;
+      p_obj->state_change_pending = OMX_FALSE;
+      state = p_obj->state;
+      pthread_mutex_unlock(&p_obj->lock);
+      ALOGI("%s:%d] state %d", __func__, __LINE__, state);
+      p_obj->callbacks.EventHandler(&p_obj->omx_comp, p_obj->app_data,
+        OMX_EventCmdComplete, OMX_CommandStateSet, state, NULL);
+      pthread_mutex_lock(&p_obj->lock);
+      continue;
+    }
+
+    if (qomx_sw_job_ready(p_obj)) {
+      p_main = qomx_sw_dequeue(&p_obj->port[QOMX_SW_PORT_MAIN]);
+      p_out = qomx_sw_dequeue(&p_obj->port[QOMX_SW_PORT_OUT]);
+      p_thumb = p_obj->port[QOMX_SW_PORT_THUMB].def.bEnabled ?
+        qomx_sw_dequeue(&p_obj->port[QOMX_SW_PORT_THUMB]) : NULL;
+      pthread_mutex_unlock(&p_obj->lock);
+
+      rc = qomx_sw_encode(p_obj, p_main, p_thumb, p_out, &thumb_dropped);
+      if (thumb_dropped) {
+        p_obj->callbacks.EventHandler(&p_obj->omx_comp, p_obj->app_data,
+          (OMX_EVENTTYPE)OMX_EVENT_THUMBNAIL_DROPPED, 0, 0, NULL);
+      }
+      p_obj->callbacks.EmptyBufferDone(&p_obj->omx_comp, p_obj->app_data,
+        p_main);
+      if (p_thumb) {
+        p_obj->callbacks.EmptyBufferDone(&p_obj->omx_comp, p_obj->app_data,
+          p_thumb);
+      }
+      if (OMX_ErrorNone == rc) {
+        p_obj->callbacks.FillBufferDone(&p_obj->omx_comp, p_obj->app_data,
+          p_out);
+      } else {
+        p_obj->callbacks.EventHandler(&p_obj->omx_comp, p_obj->app_data,
+          OMX_EventError, rc, 0, NULL);
+      }
+      pthread_mutex_lock(&p_obj->lock);
+      continue;
+    }
+
+    pthread_cond_wait(&p_obj->cond, &p_obj->lock);
+  }
+  pthread_mutex_unlock(&p_obj->lock);
+  return NULL;
+}
+
+/*==============================================================================
+* Function : qomx_sw_get_component_version
+* Parameters: hComp, componentName, componentVersion, specVersion,
+*   componentUUID
+* Return Value : OMX_ERRORTYPE
+* Description: Get the component name and version
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_get_component_version(OMX_HANDLETYPE hComp,
+  OMX_STRING componentName, OMX_VERSIONTYPE *componentVersion,
+  OMX_VERSIONTYPE *specVersion, OMX_UUIDTYPE *componentUUID)
+{
+  if (!qomx_sw_get_obj(hComp) || !componentName || !componentVersion ||
+    !specVersion)
+    return OMX_ErrorBadParameter;
+
+  snprintf(componentName, OMX_MAX_STRINGNAME_SIZE, "%s", QOMX_SW_COMP_NAME);
+  componentVersion->nVersion = 1;
+  specVersion->nVersion = 0x00000101;
+  if (componentUUID)
+    memset(componentUUID, 0, sizeof(*componentUUID));
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_sw_send_command
+* Parameters: hComp, cmd, param1, cmdData
+* Return Value : OMX_ERRORTYPE
+* Description: State changes complete asynchronously from the worker
+* thread. Port enable, disable and flush complete before returning.
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_send_command(OMX_HANDLETYPE hComp,
+  OMX_COMMANDTYPE cmd, OMX_U32 param1, OMX_PTR cmdData __unused)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+  OMX_U32 first, last, i;
+
+  if (NULL == p_obj)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock(&p_obj->lock);
+  switch (cmd) {
+  case OMX_CommandStateSet:
+    if (p_obj->state_change_pending) {
+      pthread_mutex_unlock(&p_obj->lock);
+      return OMX_ErrorNotReady;
+    }
+    if (((OMX_STATETYPE)param1 == OMX_StateExecuting) &&
+      (p_obj->state != OMX_StateIdle)) {
+      pthread_mutex_unlock(&p_obj->lock);
+      return OMX_ErrorIncorrectStateTransition;
+    }
+    if (((OMX_STATETYPE)param1 == OMX_StateLoaded) &&
+      (p_obj->state != OMX_StateIdle)) {
+      pthread_mutex_unlock(&p_obj->lock);
+      return OMX_ErrorIncorrectStateTransition;
+    }
+    if (((OMX_STATETYPE)param1 != OMX_StateIdle) &&
+      ((OMX_STATETYPE)param1 != OMX_StateExecuting) &&
+      ((OMX_STATETYPE)param1 != OMX_StateLoaded)) {
+      pthread_mutex_unlock(&p_obj->lock);
+      return OMX_ErrorUnsupportedSetting;
+    }
+    p_obj->target_state = (OMX_STATETYPE)param1;
+    p_obj->state_change_pending = OMX_TRUE;
+    pthread_cond_signal(&p_obj->cond);
+    pthread_mutex_unlock(&p_obj->lock);
+    return OMX_ErrorNone;
+
+  case OMX_CommandPortEnable:
+  case OMX_CommandPortDisable:
+  case OMX_CommandFlush:
+    if ((param1 >= QOMX_SW_NUM_PORTS) && (param1 != OMX_ALL)) {
+      pthread_mutex_unlock(&p_obj->lock);
+      return OMX_ErrorBadPortIndex;
+    }
+    first = (param1 == OMX_ALL) ? 0 : param1;
+    last = (param1 == OMX_ALL) ? QOMX_SW_NUM_PORTS - 1 : param1;
+    for (i = first; i <= last; i++) {
+      if (cmd != OMX_CommandPortEnable)
+        qomx_sw_return_buffers(p_obj, i);
+      if (cmd != OMX_CommandFlush)
+        p_obj->port[i].def.bEnabled =
+          (cmd == OMX_CommandPortEnable) ? OMX_TRUE : OMX_FALSE;
+    }
+    pthread_cond_signal(&p_obj->cond);
+    pthread_mutex_unlock(&p_obj->lock);
+    for (i = first; i <= last; i++) {
+      p_obj->callbacks.EventHandler(&p_obj->omx_comp, p_obj->app_data,
+        OMX_EventCmdComplete, cmd, i, NULL);
+    }
+    return OMX_ErrorNone;
+
+  default:
+    pthread_mutex_unlock(&p_obj->lock);
+    return OMX_ErrorNotImplemented;
+  }
+}
+
+/*==============================================================================
+* Function : qomx_sw_get_parameter
+* Parameters: hComp, paramIndex, paramData
+* Return Value : OMX_ERRORTYPE
+* Description: Get the port definition or quality factor
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_get_parameter(OMX_HANDLETYPE hComp,
+  OMX_INDEXTYPE paramIndex, OMX_PTR paramData)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+  OMX_PARAM_PORTDEFINITIONTYPE *p_def;
+  OMX_ERRORTYPE rc = OMX_ErrorNone;
+
+  if (!p_obj || !paramData)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock(&p_obj->lock);
+  switch ((int)paramIndex) {
+  case OMX_IndexParamPortDefinition:
+    p_def = (OMX_PARAM_PORTDEFINITIONTYPE *)paramData;
+    if (p_def->nPortIndex >= QOMX_SW_NUM_PORTS) {
+      rc = OMX_ErrorBadPortIndex;
+      break;
+    }
+    *p_def = p_obj->port[p_def->nPortIndex].def;
+    break;
+  case OMX_IndexParamQFactor:
+    ((OMX_IMAGE_PARAM_QFACTORTYPE *)paramData)->nQFactor = p_obj->quality;
+    break;
+  case QOMX_IMAGE_EXT_THUMBNAIL:
+    *(QOMX_THUMBNAIL_INFO *)paramData = p_obj->thumb_info;
+    break;
+  case QOMX_IMAGE_EXT_BUFFER_OFFSET:
+    *(QOMX_YUV_FRAME_INFO *)paramData = p_obj->main_offset;
+    break;
+  default:
+    rc = OMX_ErrorUnsupportedIndex;
+    break;
+  }
+  pthread_mutex_unlock(&p_obj->lock);
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_sw_set_port_definition
+* Parameters: p_obj, p_def
+* Return Value : OMX_ERRORTYPE
+* Description: Update the writable fields of a port definition. Must be
+* called with the lock.
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_set_port_definition(qomx_jpegenc_sw_t *p_obj,
+  OMX_PARAM_PORTDEFINITIONTYPE *p_def)
+{
+  OMX_PARAM_PORTDEFINITIONTYPE *p_cur;
+  uint8_t h_sub, v_sub, cr_first;
+
+  if (p_def->nPortIndex >= QOMX_SW_NUM_PORTS)
+    return OMX_ErrorBadPortIndex;
+  p_cur = &p_obj->port[p_def->nPortIndex].def;
+  if ((p_obj->state != OMX_StateLoaded) && p_cur->bEnabled)
+    return OMX_ErrorIncorrectStateOperation;
+  if (p_def->nBufferCountActual > QOMX_SW_MAX_BUFFERS)
+    return OMX_ErrorBadParameter;
+  if ((p_def->nPortIndex != QOMX_SW_PORT_OUT) &&
+    (qomx_sw_map_format(p_def->format.image.eColorFormat,
+    &h_sub, &v_sub, &cr_first) < 0)) {
+    ALOGE("%s:%d] Unsupported color format %d", __func__, __LINE__,
+      p_def->format.image.eColorFormat);
+    return OMX_ErrorUnsupportedSetting;
+  }
+
+  p_cur->nBufferCountActual = p_def->nBufferCountActual;
+  p_cur->nBufferSize = p_def->nBufferSize;
+  p_cur->format.image.nFrameWidth = p_def->format.image.nFrameWidth;
+  p_cur->format.image.nFrameHeight = p_def->format.image.nFrameHeight;
+  p_cur->format.image.nStride = p_def->format.image.nStride;
+  p_cur->format.image.nSliceHeight = p_def->format.image.nSliceHeight;
+  if (p_def->nPortIndex != QOMX_SW_PORT_OUT)
+    p_cur->format.image.eColorFormat = p_def->format.image.eColorFormat;
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_sw_set_exif
+* Parameters: p_obj, p_info
+* Return Value : OMX_ERRORTYPE
+* Description: Keep a copy of the exif tag table. Tag values are
+* referenced, not copied, and must stay valid until the table is replaced
+* or the session ends.
+* Must be called with the lock.
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_set_exif(qomx_jpegenc_sw_t *p_obj,
+  QOMX_EXIF_INFO *p_info)
+{
+  QEXIF_INFO_DATA *p_exif = NULL;
+
+  if (p_info->numOfEntries > 0) {
+    if (NULL == p_info->exif_data)
+      return OMX_ErrorBadParameter;
+    p_exif = malloc(p_info->numOfEntries * sizeof(QEXIF_INFO_DATA));
+    if (NULL == p_exif)
+      return OMX_ErrorInsufficientResources;
+    memcpy(p_exif, p_info->exif_data,
+      p_info->numOfEntries * sizeof(QEXIF_INFO_DATA));
+  }
+  free(p_obj->exif);
+  p_obj->exif = p_exif;
+  p_obj->num_exif = p_info->numOfEntries;
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_sw_set_parameter
+* Parameters: hComp, paramIndex, paramData
+* Return Value : OMX_ERRORTYPE
+* Description: Set the port definitions, quality factor and the qcom
+* extension parameters
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_set_parameter(OMX_HANDLETYPE hComp,
+  OMX_INDEXTYPE paramIndex, OMX_PTR paramData)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+  OMX_U32 quality;
+  OMX_ERRORTYPE rc = OMX_ErrorNone;
+
+  if (!p_obj || !paramData)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock(&p_obj->lock);
+  switch ((int)paramIndex) {
+  case OMX_IndexParamPortDefinition:
+    rc = qomx_sw_set_port_definition(p_obj,
+      (OMX_PARAM_PORTDEFINITIONTYPE *)paramData);
+    break;
+  case OMX_IndexParamQFactor:
+    quality = ((OMX_IMAGE_PARAM_QFACTORTYPE *)paramData)->nQFactor;
+    if ((quality < 1) || (quality > 100)) {
+      rc = OMX_ErrorBadParameter;
+      break;
+    }
+    p_obj->quality = quality;
+    break;
+  case QOMX_IMAGE_EXT_EXIF:
+    rc = qomx_sw_set_exif(p_obj, (QOMX_EXIF_INFO *)paramData);
+    break;
+  case QOMX_IMAGE_EXT_THUMBNAIL:
+    p_obj->thumb_info = *(QOMX_THUMBNAIL_INFO *)paramData;
+    break;
+  case QOMX_IMAGE_EXT_BUFFER_OFFSET:
+    p_obj->main_offset = *(QOMX_YUV_FRAME_INFO *)paramData;
+    break;
+  case QOMX_IMAGE_EXT_ENCODING_MODE:
+    /* thumbnail and main image are always encoded serially */
+    break;
+  default:
+    rc = OMX_ErrorUnsupportedIndex;
+    break;
+  }
+  pthread_mutex_unlock(&p_obj->lock);
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_sw_get_config
+* Parameters: hComp, configIndex, configData
+* Return Value : OMX_ERRORTYPE
+* Description: Get the rotation or crop configuration
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_get_config(OMX_HANDLETYPE hComp,
+  OMX_INDEXTYPE configIndex, OMX_PTR configData)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+  OMX_ERRORTYPE rc = OMX_ErrorNone;
+
+  if (!p_obj || !configData)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock(&p_obj->lock);
+  switch (configIndex) {
+  case OMX_IndexConfigCommonRotate:
+    ((OMX_CONFIG_ROTATIONTYPE *)configData)->nRotation = p_obj->rotation;
+    break;
+  case OMX_IndexConfigCommonInputCrop:
+    *(OMX_CONFIG_RECTTYPE *)configData = p_obj->in_crop;
+    break;
+  case OMX_IndexConfigCommonOutputCrop:
+    *(OMX_CONFIG_RECTTYPE *)configData = p_obj->out_crop;
+    break;
+  default:
+    rc = OMX_ErrorUnsupportedIndex;
+    break;
+  }
+  pthread_mutex_unlock(&p_obj->lock);
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_sw_set_config
+* Parameters: hComp, configIndex, configData
+* Return Value : OMX_ERRORTYPE
+* Description: Set the rotation or crop configuration
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_set_config(OMX_HANDLETYPE hComp,
+  OMX_INDEXTYPE configIndex, OMX_PTR configData)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+  OMX_S32 rotation;
+  OMX_ERRORTYPE rc = OMX_ErrorNone;
+
+  if (!p_obj || !configData)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock(&p_obj->lock);
+  switch (configIndex) {
+  case OMX_IndexConfigCommonRotate:
+    rotation = ((OMX_CONFIG_ROTATIONTYPE *)configData)->nRotation;
+    if (rotation % 90) {
+      rc = OMX_ErrorBadParameter;
+      break;
+    }
+    p_obj->rotation = rotation;
+    break;
+  case OMX_IndexConfigCommonInputCrop:
+    p_obj->in_crop = *(OMX_CONFIG_RECTTYPE *)configData;
+    break;
+  case OMX_IndexConfigCommonOutputCrop:
+    p_obj->out_crop = *(OMX_CONFIG_RECTTYPE *)configData;
+    break;
+  default:
+    rc = OMX_ErrorUnsupportedIndex;
+    break;
+  }
+  pthread_mutex_unlock(&p_obj->lock);
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_sw_get_extension_index
+* Parameters: hComp, paramName, indexType
+* Return Value : OMX_ERRORTYPE
+* Description: Map the qcom extension names to their indexes
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_get_extension_index(OMX_HANDLETYPE hComp,
+  OMX_STRING paramName, OMX_INDEXTYPE *indexType)
+{
+  static const struct {
+    const char *name;
+    QOMX_IMAGE_EXT_INDEXTYPE index;
+  } ext[] = {
+    { QOMX_IMAGE_EXT_EXIF_NAME, QOMX_IMAGE_EXT_EXIF },
+    { QOMX_IMAGE_EXT_THUMBNAIL_NAME, QOMX_IMAGE_EXT_THUMBNAIL },
+    { QOMX_IMAGE_EXT_BUFFER_OFFSET_NAME, QOMX_IMAGE_EXT_BUFFER_OFFSET },
+    { QOMX_IMAGE_EXT_ENCODING_MODE_NAME, QOMX_IMAGE_EXT_ENCODING_MODE },
+  };
+  uint32_t i;
+
+  if (!qomx_sw_get_obj(hComp) || !paramName || !indexType)
+    return OMX_ErrorBadParameter;
+
+  for (i = 0; i < sizeof(ext) / sizeof(ext[0]); i++) {
+    if (!strncmp(paramName, ext[i].name, OMX_MAX_STRINGNAME_SIZE)) {
+      *indexType = (OMX_INDEXTYPE)ext[i].index;
+      return OMX_ErrorNone;
+    }
+  }
+  return OMX_ErrorUnsupportedIndex;
+}
+
+/*==============================================================================
+* Function : qomx_sw_get_state
+* Parameters: hComp, state
+* Return Value : OMX_ERRORTYPE
+* Description: Get the current state
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_get_state(OMX_HANDLETYPE hComp,
+  OMX_STATETYPE *state)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+
+  if (!p_obj || !state)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock(&p_obj->lock);
+  *state = p_obj->state;
+  pthread_mutex_unlock(&p_obj->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_sw_component_tunnel_request
+* Parameters: hComp, nPort, hTunneledComp, nTunneledPort, pTunnelSetup
+* Return Value : OMX_ErrorNotImplemented
+* Description: Tunneling is not supported
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_component_tunnel_request(
+  OMX_HANDLETYPE hComp __unused, OMX_U32 nPort __unused,
+  OMX_HANDLETYPE hTunneledComp __unused, OMX_U32 nTunneledPort __unused,
+  OMX_TUNNELSETUPTYPE *pTunnelSetup __unused)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+/*==============================================================================
+* Function : qomx_sw_add_buffer
+* Parameters: p_obj, bufferHdr, port, appPrivate, bytes, buffer, owned
+* Return Value : OMX_ERRORTYPE
+* Description: Create a buffer header on a port. pPlatformPrivate holds the
+* buffer memory if it was allocated by the component.
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_add_buffer(qomx_jpegenc_sw_t *p_obj,
+  OMX_BUFFERHEADERTYPE **bufferHdr, OMX_U32 port, OMX_PTR appPrivate,
+  OMX_U32 bytes, OMX_U8 *buffer, OMX_BOOL owned)
+{
+  qomx_sw_port_t *p_port;
+  OMX_BUFFERHEADERTYPE *p_buf;
+
+  if (!bufferHdr || !buffer || (port >= QOMX_SW_NUM_PORTS))
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock(&p_obj->lock);
+  p_port = &p_obj->port[port];
+  if (p_port->num_bufs >= QOMX_SW_MAX_BUFFERS) {
+    pthread_mutex_unlock(&p_obj->lock);
+    return OMX_ErrorInsufficientResources;
+  }
+  if ((p_obj->state != OMX_StateLoaded) && p_port->def.bEnabled) {
+    pthread_mutex_unlock(&p_obj->lock);
+    return OMX_ErrorIncorrectStateOperation;
+  }
+
+  p_buf = calloc(1, sizeof(OMX_BUFFERHEADERTYPE));
+  if (NULL == p_buf) {
+    pthread_mutex_unlock(&p_obj->lock);
+    return OMX_ErrorInsufficientResources;
+  }
+  p_buf->nSize = sizeof(OMX_BUFFERHEADERTYPE);
+  p_buf->nVersion.nVersion = 0x00000101;
+  p_buf->pBuffer = buffer;
+  p_buf->nAllocLen = bytes;
+  p_buf->pAppPrivate = appPrivate;
+  p_buf->pPlatformPrivate = owned ? buffer : NULL;
+  if (port == QOMX_SW_PORT_OUT)
+    p_buf->nOutputPortIndex = port;
+  else
+    p_buf->nInputPortIndex = port;
+
+  p_port->bufs[p_port->num_bufs++] = p_buf;
+  p_port->def.bPopulated =
+    (p_port->num_bufs >= p_port->def.nBufferCountActual) ?
+    OMX_TRUE : OMX_FALSE;
+  *bufferHdr = p_buf;
+  pthread_cond_signal(&p_obj->cond);
+  pthread_mutex_unlock(&p_obj->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_sw_use_buffer
+* Parameters: hComp, bufferHdr, port, appPrivate, bytes, buffer
+* Return Value : OMX_ERRORTYPE
+* Description: Use a client allocated buffer on a port
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_use_buffer(OMX_HANDLETYPE hComp,
+  OMX_BUFFERHEADERTYPE **bufferHdr, OMX_U32 port, OMX_PTR appPrivate,
+  OMX_U32 bytes, OMX_U8 *buffer)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+
+  if (NULL == p_obj)
+    return OMX_ErrorBadParameter;
+  return qomx_sw_add_buffer(p_obj, bufferHdr, port, appPrivate, bytes,
+    buffer, OMX_FALSE);
+}
+
+/*==============================================================================
+* Function : qomx_sw_allocate_buffer
+* Parameters: hComp, bufferHdr, port, appPrivate, bytes
+* Return Value : OMX_ERRORTYPE
+* Description: Allocate a buffer on a port
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_allocate_buffer(OMX_HANDLETYPE hComp,
+  OMX_BUFFERHEADERTYPE **bufferHdr, OMX_U32 port, OMX_PTR appPrivate,
+  OMX_U32 bytes)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+  OMX_U8 *buffer;
+  OMX_ERRORTYPE rc;
+
+  if ((NULL == p_obj) || (0 == bytes))
+    return OMX_ErrorBadParameter;
+
+  buffer = malloc(bytes);
+  if (NULL == buffer)
+    return OMX_ErrorInsufficientResources;
+  rc = qomx_sw_add_buffer(p_obj, bufferHdr, port, appPrivate, bytes,
+    buffer, OMX_TRUE);
+  if (OMX_ErrorNone != rc)
+    free(buffer);
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_sw_free_buffer
+* Parameters: hComp, port, buffer
+* Return Value : OMX_ERRORTYPE
+* Description: Free a buffer header and the memory allocated for it
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_free_buffer(OMX_HANDLETYPE hComp, OMX_U32 port,
+  OMX_BUFFERHEADERTYPE *buffer)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+  qomx_sw_port_t *p_port;
+  uint32_t i;
+
+  if (!p_obj || !buffer || (port >= QOMX_SW_NUM_PORTS))
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock(&p_obj->lock);
+  p_port = &p_obj->port[port];
+  for (i = 0; i < p_port->num_bufs; i++) {
+    if (p_port->bufs[i] == buffer)
+      break;
+  }
+  if (i == p_port->num_bufs) {
+    pthread_mutex_unlock(&p_obj->lock);
+    return OMX_ErrorBadParameter;
+  }
+  p_port->num_bufs--;
+  memmove(&p_port->bufs[i], &p_port->bufs[i + 1],
+    (p_port->num_bufs - i) * sizeof(p_port->bufs[0]));
+  p_port->def.bPopulated = OMX_FALSE;
+  free(buffer->pPlatformPrivate);
+  free(buffer);
+  pthread_cond_signal(&p_obj->cond);
+  pthread_mutex_unlock(&p_obj->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_sw_queue_buffer
+* Parameters: p_obj, port, buffer
+* Return Value : OMX_ERRORTYPE
+* Description: Queue a client buffer for encoding
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_queue_buffer(qomx_jpegenc_sw_t *p_obj,
+  OMX_U32 port, OMX_BUFFERHEADERTYPE *buffer)
+{
+  qomx_sw_port_t *p_port;
+
+  pthread_mutex_lock(&p_obj->lock);
+  if ((p_obj->state != OMX_StateExecuting) || p_obj->state_change_pending) {
+    pthread_mutex_unlock(&p_obj->lock);
+    return OMX_ErrorIncorrectStateOperation;
+  }
+  p_port = &p_obj->port[port];
+  if (!p_port->def.bEnabled || (p_port->num_queued >= QOMX_SW_MAX_BUFFERS)) {
+    pthread_mutex_unlock(&p_obj->lock);
+    return OMX_ErrorIncorrectStateOperation;
+  }
+  p_port->queue[p_port->num_queued++] = buffer;
+  pthread_cond_signal(&p_obj->cond);
+  pthread_mutex_unlock(&p_obj->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_sw_empty_this_buffer
+* Parameters: hComp, buffer
+* Return Value : OMX_ERRORTYPE
+* Description: Queue a main image or thumbnail input buffer
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_empty_this_buffer(OMX_HANDLETYPE hComp,
+  OMX_BUFFERHEADERTYPE *buffer)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+
+  if (!p_obj || !buffer || ((buffer->nInputPortIndex != QOMX_SW_PORT_MAIN) &&
+    (buffer->nInputPortIndex != QOMX_SW_PORT_THUMB)))
+    return OMX_ErrorBadParameter;
+  return qomx_sw_queue_buffer(p_obj, buffer->nInputPortIndex, buffer);
+}
+
+/*==============================================================================
+* Function : qomx_sw_fill_this_buffer
+* Parameters: hComp, buffer
+* Return Value : OMX_ERRORTYPE
+* Description: Queue an output buffer
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_fill_this_buffer(OMX_HANDLETYPE hComp,
+  OMX_BUFFERHEADERTYPE *buffer)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+
+  if (!p_obj || !buffer || (buffer->nOutputPortIndex != QOMX_SW_PORT_OUT))
+    return OMX_ErrorBadParameter;
+  return qomx_sw_queue_buffer(p_obj, QOMX_SW_PORT_OUT, buffer);
+}
+
+/*==============================================================================
+* Function : qomx_sw_set_callbacks
+* Parameters: hComp, callbacks, appData
+* Return Value : OMX_ERRORTYPE
+* Description: Set the client callbacks
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_set_callbacks(OMX_HANDLETYPE hComp,
+  OMX_CALLBACKTYPE *callbacks, OMX_PTR appData)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+
+  if (!p_obj || !callbacks || !callbacks->EventHandler ||
+    !callbacks->EmptyBufferDone || !callbacks->FillBufferDone)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock(&p_obj->lock);
+  p_obj->callbacks = *callbacks;
+  p_obj->app_data = appData;
+  pthread_mutex_unlock(&p_obj->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_sw_component_deinit
+* Parameters: hComp
+* Return Value : OMX_ERRORTYPE
+* Description: Stop the worker thread and free the component
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_component_deinit(OMX_HANDLETYPE hComp)
+{
+  qomx_jpegenc_sw_t *p_obj = qomx_sw_get_obj(hComp);
+  qomx_sw_port_t *p_port;
+  uint32_t i, j;
+
+  if (NULL == p_obj)
+    return OMX_ErrorBadParameter;
+
+  pthread_mutex_lock(&p_obj->lock);
+  p_obj->exit = OMX_TRUE;
+  pthread_cond_signal(&p_obj->cond);
+  pthread_mutex_unlock(&p_obj->lock);
+  pthread_join(p_obj->worker, NULL);
+
+  for (i = 0; i < QOMX_SW_NUM_PORTS; i++) {
+    p_port = &p_obj->port[i];
+    if (p_port->num_bufs > 0) {
+      ALOGE("%s:%d] port %d still has %d buffers", __func__, __LINE__,
+        i, p_port->num_bufs);
+    }
+    for (j = 0; j < p_port->num_bufs; j++) {
+      free(p_port->bufs[j]->pPlatformPrivate);
+      free(p_port->bufs[j]);
+    }
+  }
+  free(p_obj->exif);
+  free(p_obj->thumb_buf);
+  free(p_obj->exif_buf);
+  pthread_mutex_destroy(&p_obj->lock);
+  pthread_cond_destroy(&p_obj->cond);
+  free(p_obj);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_sw_use_egl_image
+* Parameters: hComp, bufferHdr, port, appPrivate, eglImage
+* Return Value : OMX_ErrorNotImplemented
+* Description: EGL images are not supported
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_use_egl_image(OMX_HANDLETYPE hComp __unused,
+  OMX_BUFFERHEADERTYPE **bufferHdr __unused, OMX_U32 port __unused,
+  OMX_PTR appPrivate __unused, void *eglImage __unused)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+/*==============================================================================
+* Function : qomx_sw_component_role_enum
+* Parameters: hComp, role, index
+* Return Value : OMX_ERRORTYPE
+* Description: The component has the jpeg image encoder role only
+==============================================================================*/
+static OMX_ERRORTYPE qomx_sw_component_role_enum(OMX_HANDLETYPE hComp,
+  OMX_U8 *role, OMX_U32 index)
+{
+  if (!qomx_sw_get_obj(hComp) || !role)
+    return OMX_ErrorBadParameter;
+  if (index > 0)
+    return OMX_ErrorNoMore;
+  snprintf((char *)role, OMX_MAX_STRINGNAME_SIZE, "%s", QOMX_SW_COMP_ROLE);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_sw_init_port
+* Parameters: p_obj, idx, dir, format
+* Return Value : None
+* Description: Set the default port definition
+==============================================================================*/
+static void qomx_sw_init_port(qomx_jpegenc_sw_t *p_obj, OMX_U32 idx,
+  OMX_DIRTYPE dir, OMX_U32 format)
+{
+  OMX_PARAM_PORTDEFINITIONTYPE *p_def = &p_obj->port[idx].def;
+
+  p_def->nSize = sizeof(OMX_PARAM_PORTDEFINITIONTYPE);
+  p_def->nVersion.nVersion = 0x00000101;
+  p_def->nPortIndex = idx;
+  p_def->eDir = dir;
+  p_def->nBufferCountMin = 1;
+  p_def->nBufferCountActual = 1;
+  p_def->bEnabled = OMX_TRUE;
+  p_def->bPopulated = OMX_FALSE;
+  p_def->eDomain = OMX_PortDomainImage;
+  p_def->format.image.eCompressionFormat = (dir == OMX_DirOutput) ?
+    OMX_IMAGE_CodingJPEG : OMX_IMAGE_CodingUnused;
+  p_def->format.image.eColorFormat = (OMX_COLOR_FORMATTYPE)format;
+  p_def->bBuffersContiguous = OMX_FALSE;
+  p_def->nBufferAlignment = 1;
+}
+
+/*==============================================================================
+* Function : getInstance
+* Parameters: None
+* Return Value : component object, NULL on failure
+* Description: Create a software jpeg encoder instance. Called by the OMX
+* core for every OMX_GetHandle.
+==============================================================================*/
+void *getInstance(void)
+{
+  qomx_jpegenc_sw_t *p_obj;
+
+  p_obj = calloc(1, sizeof(qomx_jpegenc_sw_t));
+  if (NULL == p_obj)
+    return NULL;
+
+  p_obj->thumb_buf = malloc(JPEGE_SW_EXIF_MAX_LEN);
+  p_obj->exif_buf = malloc(QOMX_SW_EXIF_BUF_LEN);
+  if (!p_obj->thumb_buf || !p_obj->exif_buf)
+    goto error;
+
+  p_obj->state = OMX_StateLoaded;
+  p_obj->quality = 85;
+  qomx_sw_init_port(p_obj, QOMX_SW_PORT_MAIN, OMX_DirInput,
+    OMX_COLOR_FormatYUV420SemiPlanar);
+  qomx_sw_init_port(p_obj, QOMX_SW_PORT_OUT, OMX_DirOutput,
+    OMX_COLOR_FormatUnused);
+  qomx_sw_init_port(p_obj, QOMX_SW_PORT_THUMB, OMX_DirInput,
+    OMX_COLOR_FormatYUV420SemiPlanar);
+
+  pthread_mutex_init(&p_obj->lock, NULL);
+  pthread_cond_init(&p_obj->cond, NULL);
+  if (pthread_create(&p_obj->worker, NULL, qomx_sw_worker, p_obj)) {
+    ALOGE("%s:%d] Cannot create worker thread", __func__, __LINE__);
+    pthread_mutex_destroy(&p_obj->lock);
+    pthread_cond_destroy(&p_obj->cond);
+    goto error;
+  }
+  return p_obj;
+
+error:
+  free(p_obj->thumb_buf);
+  free(p_obj->exif_buf);
+  free(p_obj);
+  return NULL;
+}
+
+/*==============================================================================
+* Function : create_component_fns
+* Parameters: aobj - object returned by getInstance
+* Return Value : OMX component handle
+* Description: Fill in the OMX component function table
+==============================================================================*/
+void *create_component_fns(OMX_PTR aobj)
+{
+  qomx_jpegenc_sw_t *p_obj = (qomx_jpegenc_sw_t *)aobj;
+  OMX_COMPONENTTYPE *p_comp;
+
+  if (NULL == p_obj)
+    return NULL;
+
+  p_comp = &p_obj->omx_comp;
+  p_comp->nSize = sizeof(OMX_COMPONENTTYPE);
+  p_comp->nVersion.nVersion = 0x00000101;
+  p_comp->pComponentPrivate = p_obj;
+  p_comp->GetComponentVersion = qomx_sw_get_component_version;
+  p_comp->SendCommand = qomx_sw_send_command;
+  p_comp->GetParameter = qomx_sw_get_parameter;
+  p_comp->SetParameter = qomx_sw_set_parameter;
+  p_comp->GetConfig = qomx_sw_get_config;
+  p_comp->SetConfig = qomx_sw_set_config;
+  p_comp->GetExtensionIndex = qomx_sw_get_extension_index;
+  p_comp->GetState = qomx_sw_get_state;
+  p_comp->ComponentTunnelRequest = qomx_sw_component_tunnel_request;
+  p_comp->UseBuffer = qomx_sw_use_buffer;
+  p_comp->AllocateBuffer = qomx_sw_allocate_buffer;
+  p_comp->FreeBuffer = qomx_sw_free_buffer;
+  p_comp->EmptyThisBuffer = qomx_sw_empty_this_buffer;
+  p_comp->FillThisBuffer = qomx_sw_fill_this_buffer;
+  p_comp->SetCallbacks = qomx_sw_set_callbacks;
+  p_comp->ComponentDeInit = qomx_sw_component_deinit;
+  p_comp->UseEGLImage = qomx_sw_use_egl_image;
+  p_comp->ComponentRoleEnum = qomx_sw_component_role_enum;
+  return p_comp;
+}
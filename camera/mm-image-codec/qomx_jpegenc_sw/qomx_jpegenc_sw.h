@@ -0,0 +1,113 @@
+/*Copyright (c) 2012, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+#ifndef QOMX_JPEGENC_SW_H
+#define QOMX_JPEGENC_SW_H
+
+#include <pthread.h>
+#include "OMX_Component.h"
+#include "QOMX_JpegExtensions.h"
+#include "jpege_sw.h"
+#include "jpege_sw_exif.h"
+
+#define QOMX_SW_COMP_NAME "OMX.qcom.image.jpeg.encoder.sw"
+#define QOMX_SW_COMP_ROLE "image_encoder.jpeg"
+
+#define QOMX_SW_PORT_MAIN 0
+#define QOMX_SW_PORT_OUT 1
+#define QOMX_SW_PORT_THUMB 2
+#define QOMX_SW_NUM_PORTS 3
+
+#define QOMX_SW_MAX_BUFFERS 32
+
+#ifndef __unused
+#define __unused __attribute__((__unused__))
+#endif
+
+/** qomx_sw_port_t: port of the software encoder
+*    @def: port definition
+*    @bufs: buffer headers allocated on the port
+*    @num_bufs: number of allocated buffers
+*    @queue: buffers queued by the client, oldest first
+*    @num_queued: number of queued buffers
+**/
+typedef struct {
+  OMX_PARAM_PORTDEFINITIONTYPE def;
+  OMX_BUFFERHEADERTYPE *bufs[QOMX_SW_MAX_BUFFERS];
+  uint32_t num_bufs;
+  OMX_BUFFERHEADERTYPE *queue[QOMX_SW_MAX_BUFFERS];
+  uint32_t num_queued;
+} qomx_sw_port_t;
+
+/** qomx_jpegenc_sw_t: software jpeg encoder component
+*    @omx_comp: OMX component handle given to the core
+*    @callbacks: client callbacks
+*    @app_data: client data passed back in the callbacks
+*    @lock: protects the state, ports and parameters
+*    @cond: wakes up the worker thread
+*    @worker: thread completing state changes and encoding
+*    @state: current OMX state
+*    @target_state: state of the pending state change
+*    @state_change_pending: a StateSet command is in progress
+*    @exit: worker thread exit request
+*    @port: main input, output and thumbnail input ports
+*    @main_offset: plane offsets of the main image
+*    @thumb_info: thumbnail scaling and plane offsets
+*    @quality: jpeg quality factor
+*    @rotation: clockwise rotation applied to the output
+*    @in_crop: input crop, zero width means the full frame
+*    @out_crop: scaled output size, zero width means no scaling
+*    @exif: copy of the client exif tags
+*    @num_exif: number of exif tags
+*    @thumb_buf: scratch buffer for the encoded thumbnail
+*    @exif_buf: scratch buffer for the APP1 segment
+**/
+typedef struct {
+  OMX_COMPONENTTYPE omx_comp;
+  OMX_CALLBACKTYPE callbacks;
+  OMX_PTR app_data;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t worker;
+  OMX_STATETYPE state;
+  OMX_STATETYPE target_state;
+  OMX_BOOL state_change_pending;
+  OMX_BOOL exit;
+  qomx_sw_port_t port[QOMX_SW_NUM_PORTS];
+  QOMX_YUV_FRAME_INFO main_offset;
+  QOMX_THUMBNAIL_INFO thumb_info;
+  OMX_U32 quality;
+  OMX_S32 rotation;
+  OMX_CONFIG_RECTTYPE in_crop;
+  OMX_CONFIG_RECTTYPE out_crop;
+  QEXIF_INFO_DATA *exif;
+  OMX_U32 num_exif;
+  uint8_t *thumb_buf;
+  uint8_t *exif_buf;
+} qomx_jpegenc_sw_t;
+
+#endif
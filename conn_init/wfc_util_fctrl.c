@@ -18,12 +18,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
 #include "wfc_util_log.h"
+#include "wfc_util_fctrl.h"
 
 /*
 static void wfc_util_printf(char *pSPointer, int length)
@@ -52,148 +54,6 @@ static void wfc_util_printf(char *pSPointer, int length)
 }
 */
 
-static void wfc_util_finsert_new_string(int fd, char **ppReadedBuff, char *pNewStringValue, char *pEndOfCfg)
-{
-	off_t sz_file;
-	int   sz_backupBuff = 0;
-	char *pReadBuff = NULL, *pBackupBuff = NULL;
-	char *pSPointer = NULL, *pETagPointer = NULL;
-
-	if( 0 == fd || NULL == pNewStringValue || 0 == strlen(pNewStringValue) ) {
-		wfc_util_log_error("wfc_util_finsert_new_string : unvalid parameters");
-		return;
-	}
-
-	if( NULL == ppReadedBuff) {
-		// TODO:
-		return;
-	} else {
-		pReadBuff = *ppReadedBuff;
-	}
-
-	/*
-	 * find END TAG string
-	 */
-	pETagPointer = strstr(pReadBuff, pEndOfCfg);
-	pSPointer = pETagPointer - 1;
-
-	/*
-	 * calcurate file size and size of the tail of file
-	 */
-	sz_file = lseek( fd,  0, SEEK_END );
-	sz_backupBuff = (int)sz_file - (pETagPointer - pReadBuff);
-
-	/*
-	 * prefare the buffer to store the tail of file
-	 */
-	pBackupBuff = malloc(sz_backupBuff);
-
-	if( NULL != pBackupBuff ) {
-		/*
-		 * copy the tail of file.
-		 */
-		memset( pBackupBuff, 0, sz_backupBuff );
-		memcpy( pBackupBuff, pETagPointer, sz_backupBuff );
-
-		/*
-		 * write new string.
-		 */
-		lseek( fd, (int)(pSPointer-pReadBuff), SEEK_SET );
-		write( fd, pNewStringValue, strlen(pNewStringValue));
-
-		/*
-		 * update pETagPointer.
-		 */
-		pETagPointer = pSPointer + strlen(pNewStringValue);
-
-		/*
-		 * write the tail of file.
-		 */
-		lseek( fd, (int)(pETagPointer-pReadBuff), SEEK_SET );
-		write( fd, pBackupBuff, sz_backupBuff );
-
-		ftruncate(fd, sz_file + strlen(pNewStringValue) - 1); /* we use "-1" becasue of "pSPointer = pETagPointer - 1"*/
-
-		free(pBackupBuff);
-
-		/*
-		 * make new *ppReadedBuff
-		 */
-		if( NULL != ppReadedBuff) {
-			// TODO:
-		}
-	} else {
-		wfc_util_log_error("wfc_util_finsert_new_string : can not malloc(%d)", sz_backupBuff);
-	}
-
-	return;
-}
-
-static void wfc_util_fupdate_string(int fd, char **ppReadedBuff,
-                                    char *pETagPointer, char *pSValuePointer, char *pNewValueString)
-{
-	off_t sz_file;
-	int   sz_newReadBuff = 0;
-	char *pReadBuff = NULL, *pNewReadBuff = NULL, *pCurReadBuff = NULL;
-
-	if( 0 == fd ) {
-		wfc_util_log_error("wfc_util_fupdate_string : unvalid parameters");
-		return;
-	}
-
-	if( NULL == ppReadedBuff) {
-		// TODO:
-		return;
-	} else {
-		pReadBuff = *ppReadedBuff;
-	}
-
-	/*
-	 * calcurate file size and new file size
-	 */
-	sz_file  = lseek( fd,  0, SEEK_END );
-	sz_newReadBuff = (int)sz_file - (int)(pETagPointer - pSValuePointer) + strlen(pNewValueString);
-
-	/*
-	 * prefare the buffer to read file
-	 */
-	pNewReadBuff = malloc(sz_newReadBuff);
-
-	if( NULL != pNewReadBuff ) {
-		/*
-		 * copy buffer
-		 */
-		memset( pNewReadBuff, 0, sz_file );
-		pCurReadBuff = pNewReadBuff;
-		memcpy( pNewReadBuff, pReadBuff, (int)(pSValuePointer-pReadBuff) );
-		pCurReadBuff += (int)(pSValuePointer-pReadBuff);
-
-		/*
-		 * copy new value string
-		 */
-		memcpy( pCurReadBuff, pNewValueString, strlen(pNewValueString));
-		pCurReadBuff += strlen(pNewValueString);
-
-		/*
-		 * copy the remained buffer
-		 */
-		memcpy( pCurReadBuff, pETagPointer, ((int)(sz_file) - (int)(pETagPointer - pReadBuff) + 1));
-
-		/*
-		 * write file and update the file size
-		 */
-		lseek( fd,  0, SEEK_SET );
-		write( fd, pNewReadBuff, sz_newReadBuff);
-		ftruncate(fd, sz_newReadBuff);
-
-		free(pNewReadBuff);
-	} else {
-		wfc_util_log_error("wfc_util_fupdate_string : can not malloc(%d)", (int)sz_newReadBuff);
-	}
-
-	return;
-}
-
 /*
  * wfc_util_fset_buffer
  *
@@ -327,120 +187,572 @@ int wfc_util_fget_buffer(char *pFileName, int positionStart, int lengthToRead, u
 }
 
 /*
- * wfc_util_fset_string
+ * wfc_util_fcfg
  *
- * The following format string will be added or updated to the file pFileName.
- * [pSTagString][pNewValueString][pETagString]
+ * The configuration file read by wfc_util_fcfg_open(). Every line of the form
+ * [pSTagString][value][pETagString] is indexed by its start tag, the text up to
+ * and including the first '=', so lookups do not rescan the file. Updates are
+ * only recorded and wfc_util_fcfg_commit() writes them all at once.
+ */
+typedef struct {
+	int   tagOffset;    /* offset of the start tag in pReadBuff, -1 for a new line */
+	int   tagLength;    /* length of the start tag */
+	int   valueOffset;  /* offset of the value in pReadBuff */
+	int   valueLength;  /* length of the value */
+	char *pNewTag;      /* start tag of a new line */
+	char *pNewValue;    /* value to write, NULL if it is unchanged */
+} wfc_util_fcfg_entry;
+
+struct wfc_util_fcfg {
+	char *pFileName;
+	char *pEndOfCfg;
+	char *pETagString;
+	char *pReadBuff;
+	int   sz_file;
+	int   endOfCfgOffset;   /* offset of the end of configuration tag, -1 if there is none */
+	wfc_util_fcfg_entry *pEntries;
+	int   numEntries;
+	int   maxEntries;
+	int   numUpdates;
+};
+
+static wfc_util_fcfg_entry *wfc_util_fcfg_add_entry(wfc_util_fcfg *pCfg)
+{
+	wfc_util_fcfg_entry *pEntries = NULL;
+	int maxEntries = 0;
+
+	if( pCfg->numEntries == pCfg->maxEntries ) {
+		maxEntries = pCfg->maxEntries ? (pCfg->maxEntries * 2) : 64;
+		pEntries = realloc(pCfg->pEntries, maxEntries * sizeof(wfc_util_fcfg_entry));
+		if( NULL == pEntries ) {
+			wfc_util_log_error("wfc_util_fcfg_add_entry : can not realloc(%d)", maxEntries);
+			return NULL;
+		}
+		pCfg->pEntries = pEntries;
+		pCfg->maxEntries = maxEntries;
+	}
+
+	pEntries = &pCfg->pEntries[pCfg->numEntries++];
+	memset(pEntries, 0, sizeof(wfc_util_fcfg_entry));
+	return pEntries;
+}
+
+/*
+ * index the tagged lines of pReadBuff and find the end of configuration tag
+ */
+static int wfc_util_fcfg_parse(wfc_util_fcfg *pCfg)
+{
+	char *pLine = pCfg->pReadBuff;
+	char *pEnd = pCfg->pReadBuff + pCfg->sz_file;
+	char *pEOL = NULL, *pSValuePointer = NULL, *pETagPointer = NULL;
+	wfc_util_fcfg_entry *pEntry = NULL;
+
+	while( pLine < pEnd ) {
+		pEOL = memchr(pLine, '\n', pEnd - pLine);
+		if( NULL == pEOL ) {
+			pEOL = pEnd;
+		}
+
+		if( 0 > pCfg->endOfCfgOffset &&
+		    0 == strncmp(pLine, pCfg->pEndOfCfg, strlen(pCfg->pEndOfCfg)) ) {
+			pCfg->endOfCfgOffset = (int)(pLine - pCfg->pReadBuff);
+		} else if( '#' != *pLine ) {
+			pSValuePointer = memchr(pLine, '=', pEOL - pLine);
+			if( NULL != pSValuePointer ) {
+				pSValuePointer++;
+				pETagPointer = strstr(pSValuePointer, pCfg->pETagString);
+				if( NULL == pETagPointer ) {
+					pETagPointer = pEnd;
+				}
+
+				pEntry = wfc_util_fcfg_add_entry(pCfg);
+				if( NULL == pEntry ) {
+					return -1;
+				}
+				pEntry->tagOffset   = (int)(pLine - pCfg->pReadBuff);
+				pEntry->tagLength   = (int)(pSValuePointer - pLine);
+				pEntry->valueOffset = (int)(pSValuePointer - pCfg->pReadBuff);
+				pEntry->valueLength = (int)(pETagPointer - pSValuePointer);
+			}
+		}
+
+		pLine = pEOL + 1;
+	}
+
+	return 0;
+}
+
+static wfc_util_fcfg_entry *wfc_util_fcfg_find(wfc_util_fcfg *pCfg, char *pSTagString)
+{
+	int i, tagLength = strlen(pSTagString);
+	wfc_util_fcfg_entry *pEntry = NULL;
+
+	for( i = 0; i < pCfg->numEntries; i++ ) {
+		pEntry = &pCfg->pEntries[i];
+		if( 0 <= pEntry->tagOffset ) {
+			if( tagLength == pEntry->tagLength &&
+			    0 == memcmp(pCfg->pReadBuff + pEntry->tagOffset, pSTagString, tagLength) ) {
+				return pEntry;
+			}
+		} else if( 0 == strcmp(pEntry->pNewTag, pSTagString) ) {
+			return pEntry;
+		}
+	}
+
+	return NULL;
+}
+
+static int wfc_util_fwrite_all(int fd, char *pBuff, int length)
+{
+	int written = 0, result;
+
+	while( written < length ) {
+		result = write(fd, pBuff + written, length - written);
+		if( 0 > result ) {
+			if( EINTR == errno ) {
+				continue;
+			}
+			return -1;
+		}
+		written += result;
+	}
+
+	return 0;
+}
+
+/*
+ * wfc_util_fwrite_atomic
  *
- * pFileName       : file name and path
- * pEndOfCfg       : tag string to notify the end of configuration file
+ * replace the content of pFileName with pBuff through a temporary file and
+ * rename(), so readers see either the old or the new file.
+ * If the temporary file can not get the owner of pFileName, pFileName is
+ * rewritten in place.
+ *
+ * return : it will return 0 if procedure is success
+ *          or will return -1 if not.
+ */
+static int wfc_util_fwrite_atomic(char *pFileName, char *pBuff, int length)
+{
+	char realFileName[PATH_MAX], tempFileName[PATH_MAX + 8];
+	char *pDirEnd = NULL;
+	struct stat st, tempSt;
+	int fd;
+
+	/* rename() would replace a symbolic link instead of its target */
+	if( NULL == realpath(pFileName, realFileName) ) {
+		wfc_util_log_error("Cannot resolve \"%s\": %s", pFileName, strerror(errno));
+		return -1;
+	}
+	if( stat(realFileName, &st) < 0 ) {
+		wfc_util_log_error("Cannot stat the file \"%s\": %s", realFileName, strerror(errno));
+		return -1;
+	}
+	snprintf(tempFileName, sizeof(tempFileName), "%s.tmp", realFileName);
+
+	fd = open(tempFileName, O_CREAT|O_TRUNC|O_WRONLY, st.st_mode & 07777);
+	if( fd >= 0 ) {
+		if( fstat(fd, &tempSt) < 0 ||
+		    ((tempSt.st_uid != st.st_uid || tempSt.st_gid != st.st_gid) &&
+		     fchown(fd, st.st_uid, st.st_gid) < 0) ||
+		    fchmod(fd, st.st_mode & 07777) < 0 ) {
+			wfc_util_log_error("wfc_util_fwrite_atomic : can not keep the owner of %s, rewrite it", realFileName);
+			close(fd);
+			unlink(tempFileName);
+			fd = -1;
+		}
+	} else {
+		wfc_util_log_error("Cannot create \"%s\": %s", tempFileName, strerror(errno));
+	}
+
+	if( fd < 0 ) {
+		fd = open(realFileName, O_TRUNC|O_WRONLY);
+		if( fd < 0 ) {
+			wfc_util_log_error("Cannot open \"%s\": %s", realFileName, strerror(errno));
+			return -1;
+		}
+		if( 0 > wfc_util_fwrite_all(fd, pBuff, length) || -1 == fsync(fd) ) {
+			wfc_util_log_error("Error writing \"%s\": %s", realFileName, strerror(errno));
+			close(fd);
+			return -1;
+		}
+		close(fd);
+		return 0;
+	}
+
+	if( 0 > wfc_util_fwrite_all(fd, pBuff, length) || -1 == fsync(fd) ) {
+		wfc_util_log_error("Error writing \"%s\": %s", tempFileName, strerror(errno));
+		close(fd);
+		unlink(tempFileName);
+		return -1;
+	}
+	close(fd);
+
+	if( rename(tempFileName, realFileName) < 0 ) {
+		wfc_util_log_error("Cannot rename \"%s\": %s", tempFileName, strerror(errno));
+		unlink(tempFileName);
+		return -1;
+	}
+
+	/*
+	 * make the rename itself durable
+	 */
+	pDirEnd = strrchr(realFileName, '/');
+	if( NULL != pDirEnd ) {
+		*(pDirEnd == realFileName ? pDirEnd + 1 : pDirEnd) = '\0';
+		fd = open(realFileName, O_RDONLY|O_DIRECTORY);
+		if( fd >= 0 ) {
+			fsync(fd);
+			close(fd);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * wfc_util_fcfg_open
+ *
+ * Read the file pFileName once and index its [pSTagString][value][pETagString] lines.
+ *
+ * pFileName   : file name and path
+ * pEndOfCfg   : tag string to notify the end of configuration file
+ * pETagString : tag string to notify the end of the value
+ *
+ * return : it will return the configuration to pass to the other wfc_util_fcfg functions
+ *          or will return NULL if the file can not be read.
+ */
+wfc_util_fcfg *wfc_util_fcfg_open(char *pFileName, char *pEndOfCfg, char *pETagString)
+{
+	int fd, result;
+	off_t sz_file;
+	wfc_util_fcfg *pCfg = NULL;
+
+	fd = open( pFileName, O_RDONLY );
+
+	if( fd < 0 ) {
+		wfc_util_log_error("wfc_util_fcfg_open : can not open file");
+		return NULL;
+	}
+
+	sz_file = lseek( fd, 0, SEEK_END );
+	if( 0 >= sz_file || lseek( fd, 0, SEEK_SET ) != 0 ) {
+		wfc_util_log_error("wfc_util_fcfg_open : can not get the size of %s", pFileName);
+		close( fd );
+		return NULL;
+	}
+
+	pCfg = calloc(1, sizeof(wfc_util_fcfg));
+	if( NULL != pCfg ) {
+		pCfg->pReadBuff = malloc(sz_file + 1); // null terminated
+	}
+	if( NULL == pCfg || NULL == pCfg->pReadBuff ) {
+		wfc_util_log_error("wfc_util_fcfg_open : can not malloc(%d)", (int)sz_file);
+		free(pCfg);
+		close( fd );
+		return NULL;
+	}
+
+	while( pCfg->sz_file < sz_file ) {
+		result = read( fd, pCfg->pReadBuff + pCfg->sz_file, sz_file - pCfg->sz_file );
+		if( 0 > result && EINTR == errno ) {
+			continue;
+		}
+		if( 0 >= result ) {
+			break;
+		}
+		pCfg->sz_file += result;
+	}
+	close( fd );
+	pCfg->pReadBuff[pCfg->sz_file] = '\0';
+
+	pCfg->pFileName = strdup(pFileName);
+	pCfg->pEndOfCfg = pEndOfCfg;
+	pCfg->pETagString = pETagString;
+	pCfg->endOfCfgOffset = -1;
+
+	if( pCfg->sz_file != sz_file || NULL == pCfg->pFileName || 0 > wfc_util_fcfg_parse(pCfg) ) {
+		wfc_util_log_error("wfc_util_fcfg_open : can not read %s", pFileName);
+		wfc_util_fcfg_close(pCfg);
+		return NULL;
+	}
+
+	return pCfg;
+}
+
+/*
+ * wfc_util_fcfg_get_string
+ *
+ * Read the value of pSTagString, including a value set but not committed yet.
+ *
+ * pCfg             : configuration from wfc_util_fcfg_open()
+ * pSTagString      : tag string to notify purpose of the value
+ * pValueStringBuff : string buffer to get string value
+ * stringBuffLength : the length of pValueStringBuff
+ *
+ * return : it will return the length of the stored string value if procedure is success
+ *          or will return 0 if not.
+ */
+int wfc_util_fcfg_get_string(wfc_util_fcfg *pCfg, char *pSTagString, char *pValueStringBuff, int stringBuffLength)
+{
+	wfc_util_fcfg_entry *pEntry = NULL;
+	char *pSValuePointer = NULL;
+	int valueLength;
+
+	pEntry = wfc_util_fcfg_find(pCfg, pSTagString);
+
+	if( NULL == pEntry ) {
+		wfc_util_log_error("wfc_util_fcfg_get_string : can not find Start TAG");
+		return 0;
+	}
+
+	if( NULL != pEntry->pNewValue ) {
+		pSValuePointer = pEntry->pNewValue;
+		valueLength = strlen(pEntry->pNewValue);
+	} else {
+		pSValuePointer = pCfg->pReadBuff + pEntry->valueOffset;
+		valueLength = pEntry->valueLength;
+	}
+
+	if( stringBuffLength < valueLength ) {
+		wfc_util_log_error("wfc_util_fcfg_get_string : not enough string value buffer(%d)", valueLength);
+		return 0;
+	}
+
+	memset( pValueStringBuff, 0, stringBuffLength );
+	memcpy( pValueStringBuff, pSValuePointer, valueLength );
+
+	return valueLength;
+}
+
+/*
+ * wfc_util_fcfg_set_string
+ *
+ * Set the value of pSTagString, or add a [pSTagString][pNewValueString][pETagString]
+ * line before the end of configuration tag. Nothing is written until wfc_util_fcfg_commit().
+ *
+ * pCfg            : configuration from wfc_util_fcfg_open()
  * pSTagString     : tag string to notify purpose of the value
- * pETagString     : tag string to notify the end of the value
  * pNewValueString : string to set for pSTagString
  *
  * return : void
  */
-void wfc_util_fset_string(char *pFileName, char *pEndOfCfg, char *pSTagString, char *pETagString, char *pNewValueString)
+void wfc_util_fcfg_set_string(wfc_util_fcfg *pCfg, char *pSTagString, char *pNewValueString)
 {
-	int fd;
-	off_t sz_file;
-	int   sz_NewValueBuff = 0;
-	char *pReadBuff = NULL, *pNewValueBuff = NULL;
-	char *pSPointer = NULL, *pETagPointer = NULL, *pSValuePointer = NULL;
+	wfc_util_fcfg_entry *pEntry = NULL;
+	char *pNewValue = NULL;
 
-	fd = open( pFileName, O_RDWR );
+	pEntry = wfc_util_fcfg_find(pCfg, pSTagString);
 
-	if( fd >= 0 ) {
-		/*
-		 * calcurate file size
-		 */
-		sz_file  = lseek( fd,  0, SEEK_END );
+	if( NULL != pEntry ) {
+		if( NULL != pEntry->pNewValue ) {
+			if( 0 == strcmp(pEntry->pNewValue, pNewValueString) ) {
+				return;
+			}
+		} else if( 0 <= pEntry->tagOffset &&
+		           (int)strlen(pNewValueString) == pEntry->valueLength &&
+		           0 == memcmp(pCfg->pReadBuff + pEntry->valueOffset, pNewValueString, pEntry->valueLength) ) {
+			return;
+		}
+	}
 
-		/*
-		 * prefare the buffer to read file
-		 */
-		if (sz_file > 0)
-			pReadBuff = malloc(sz_file + 1); // null terminated
+	pNewValue = strdup(pNewValueString);
+	if( NULL == pNewValue ) {
+		wfc_util_log_error("wfc_util_fcfg_set_string : can not malloc(%d)", (int)strlen(pNewValueString));
+		return;
+	}
 
-		if( NULL != pReadBuff ) {
-			/*
-			 * read file
-			 */
-			memset( pReadBuff, 0x00, sz_file + 1);
-			if(lseek(fd, 0, SEEK_SET) != 0) {
-				wfc_util_log_error("lseek failure");
+	if( NULL == pEntry ) {
+		pEntry = wfc_util_fcfg_add_entry(pCfg);
+		if( NULL != pEntry ) {
+			pEntry->tagOffset = -1;
+			pEntry->pNewTag = strdup(pSTagString);
+		}
+		if( NULL == pEntry || NULL == pEntry->pNewTag ) {
+			wfc_util_log_error("wfc_util_fcfg_set_string : can not add %s", pSTagString);
+			if( NULL != pEntry ) {
+				pCfg->numEntries--;
 			}
-			read( fd, pReadBuff, sz_file );
+			free(pNewValue);
+			return;
+		}
+	}
 
-			/* WBT fix, make sure it is terminated with \0 */
-			pReadBuff[sz_file] = '\0';
+	if( NULL == pEntry->pNewValue ) {
+		pCfg->numUpdates++;
+	}
+	free(pEntry->pNewValue);
+	pEntry->pNewValue = pNewValue;
 
-			/*
-			 * find TAG string
-			 */
-			pSPointer = strstr(pReadBuff, pSTagString);
+	return;
+}
 
-			if(NULL != pSPointer) {
-				/*
-				 * find END OF LINE string
-				 */
-				pETagPointer = strstr(pSPointer, pETagString);
-
-				if(NULL != pETagPointer) {
-					/*
-					 * write the new string value
-					 */
-					pSValuePointer = pSPointer+strlen(pSTagString);
-					if(strlen(pNewValueString) == (unsigned int)(pETagPointer-pSValuePointer)) {
-						lseek( fd, (int)(pSValuePointer-pReadBuff), SEEK_SET );
-						write( fd, pNewValueString, strlen(pNewValueString));
-					} else {
-						/*
-						 * insert with new length value string
-						 */
-						wfc_util_fupdate_string(fd, &pReadBuff, pETagPointer, pSValuePointer, pNewValueString);
-					}
-				} else {
-					wfc_util_log_error("wfc_util_fset_string : can not find End TAG");
-				}
-			} else {
-				/*
-				 * "\n""[Start TAG][String Value][End TAG]""\n"
-				 */
-				sz_NewValueBuff = strlen(pSTagString) +
-				                  strlen(pNewValueString) +
-				                  strlen(pETagString) +
-				                  2 + 1;
-				pNewValueBuff = malloc( sz_NewValueBuff);
-
-				if( NULL != pNewValueBuff ) {
-					/*
-					 * prefare the new string to insert
-					 */
-					memset( pNewValueBuff, 0, sz_NewValueBuff );
-					sprintf( pNewValueBuff, "%c%s%s%s%c", '\n', pSTagString, pNewValueString, pETagString,'\n' );
-
-					/*
-					 * insert new string to the file
-					 */
-					wfc_util_finsert_new_string(fd, &pReadBuff, pNewValueBuff, pEndOfCfg);
-
-					free( pNewValueBuff );
-				} else {
-					wfc_util_log_error("wfc_util_fset_string : can not malloc(%d)", (int)sz_file);
-				}
-			}
+/*
+ * copy pReadBuff up to insertOffset and append the new lines
+ */
+static char *wfc_util_fcfg_insert_lines(wfc_util_fcfg *pCfg, char *pNewBuff, char *pCurBuff, int *pReadOffset, int insertOffset)
+{
+	int i;
+	wfc_util_fcfg_entry *pEntry = NULL;
 
-			free(pReadBuff);
-		} else {
-			wfc_util_log_error("wfc_util_fset_string : can not malloc(%d)", (int)sz_file);
+	memcpy( pCurBuff, pCfg->pReadBuff + *pReadOffset, insertOffset - *pReadOffset );
+	pCurBuff += insertOffset - *pReadOffset;
+	*pReadOffset = insertOffset;
+
+	for( i = 0; i < pCfg->numEntries; i++ ) {
+		pEntry = &pCfg->pEntries[i];
+		if( 0 <= pEntry->tagOffset || NULL == pEntry->pNewValue ) {
+			continue;
+		}
+		if( pCurBuff > pNewBuff && '\n' != *(pCurBuff - 1) ) {
+			*pCurBuff++ = '\n';
 		}
+		pCurBuff += sprintf( pCurBuff, "%s%s%s", pEntry->pNewTag, pEntry->pNewValue, pCfg->pETagString );
+	}
 
-		if ( -1 == fsync( fd ) ) {
-			wfc_util_log_error("wfc_util_fset_string : fail to fsync()");
+	return pCurBuff;
+}
+
+/*
+ * wfc_util_fcfg_commit
+ *
+ * Write the values set since wfc_util_fcfg_open() back to the file in a single write,
+ * through a temporary file renamed over it. The file is not touched if no value changed.
+ *
+ * return : it will return 0 if procedure is success
+ *          or will return -1 if not.
+ */
+int wfc_util_fcfg_commit(wfc_util_fcfg *pCfg)
+{
+	int i, sz_newBuff, insertOffset, readOffset = 0, inserted = 0, result;
+	char *pNewBuff = NULL, *pCurBuff = NULL;
+	wfc_util_fcfg_entry *pEntry = NULL;
+
+	if( 0 == pCfg->numUpdates ) {
+		return 0;
+	}
+
+	/*
+	 * calcurate the new file size, with room for a new line in the last line
+	 * and the null termination of sprintf()
+	 */
+	sz_newBuff = pCfg->sz_file + 2;
+	for( i = 0; i < pCfg->numEntries; i++ ) {
+		pEntry = &pCfg->pEntries[i];
+		if( NULL == pEntry->pNewValue ) {
+			continue;
 		}
+		sz_newBuff += strlen(pEntry->pNewValue);
+		if( 0 > pEntry->tagOffset ) {
+			sz_newBuff += strlen(pEntry->pNewTag) + strlen(pCfg->pETagString);
+		}
+	}
 
-		close( fd );
+	pNewBuff = malloc(sz_newBuff);
+	if( NULL == pNewBuff ) {
+		wfc_util_log_error("wfc_util_fcfg_commit : can not malloc(%d)", sz_newBuff);
+		return -1;
+	}
+	pCurBuff = pNewBuff;
+
+	/*
+	 * new lines go right before the end of configuration tag, or at the end of file
+	 */
+	insertOffset = (0 <= pCfg->endOfCfgOffset) ? pCfg->endOfCfgOffset : pCfg->sz_file;
+
+	for( i = 0; i < pCfg->numEntries; i++ ) {
+		pEntry = &pCfg->pEntries[i];
+		if( 0 > pEntry->tagOffset || NULL == pEntry->pNewValue ) {
+			continue;
+		}
+
+		if( !inserted && pEntry->tagOffset >= insertOffset ) {
+			pCurBuff = wfc_util_fcfg_insert_lines(pCfg, pNewBuff, pCurBuff, &readOffset, insertOffset);
+			inserted = 1;
+		}
+
+		/*
+		 * copy up to the value and the new value string
+		 */
+		memcpy( pCurBuff, pCfg->pReadBuff + readOffset, pEntry->valueOffset - readOffset );
+		pCurBuff += pEntry->valueOffset - readOffset;
+		memcpy( pCurBuff, pEntry->pNewValue, strlen(pEntry->pNewValue) );
+		pCurBuff += strlen(pEntry->pNewValue);
+		readOffset = pEntry->valueOffset + pEntry->valueLength;
+	}
+
+	if( !inserted ) {
+		pCurBuff = wfc_util_fcfg_insert_lines(pCfg, pNewBuff, pCurBuff, &readOffset, insertOffset);
+	}
+
+	/*
+	 * copy the remained buffer
+	 */
+	memcpy( pCurBuff, pCfg->pReadBuff + readOffset, pCfg->sz_file - readOffset );
+	pCurBuff += pCfg->sz_file - readOffset;
+
+	result = wfc_util_fwrite_atomic(pCfg->pFileName, pNewBuff, (int)(pCurBuff - pNewBuff));
+
+	free(pNewBuff);
+
+	return result;
+}
+
+/*
+ * wfc_util_fcfg_close
+ *
+ * Free the configuration. Values not committed are dropped.
+ *
+ * return : void
+ */
+void wfc_util_fcfg_close(wfc_util_fcfg *pCfg)
+{
+	int i;
+
+	if( NULL == pCfg ) {
+		return;
+	}
+
+	for( i = 0; i < pCfg->numEntries; i++ ) {
+		free(pCfg->pEntries[i].pNewTag);
+		free(pCfg->pEntries[i].pNewValue);
+	}
+	free(pCfg->pEntries);
+	free(pCfg->pReadBuff);
+	free(pCfg->pFileName);
+	free(pCfg);
+
+	return;
+}
+
+/*
+ * wfc_util_fset_string
+ *
+ * The following format string will be added or updated to the file pFileName.
+ * [pSTagString][pNewValueString][pETagString]
+ * The file is read and written for every call, use wfc_util_fcfg_open() to update several values.
+ *
+ * pFileName       : file name and path
+ * pEndOfCfg       : tag string to notify the end of configuration file
+ * pSTagString     : tag string to notify purpose of the value
+ * pETagString     : tag string to notify the end of the value
+ * pNewValueString : string to set for pSTagString
+ *
+ * return : void
+ */
+void wfc_util_fset_string(char *pFileName, char *pEndOfCfg, char *pSTagString, char *pETagString, char *pNewValueString)
+{
+	wfc_util_fcfg *pCfg = NULL;
+
+	pCfg = wfc_util_fcfg_open(pFileName, pEndOfCfg, pETagString);
+
+	if( NULL != pCfg ) {
+		wfc_util_fcfg_set_string(pCfg, pSTagString, pNewValueString);
+
+		if( 0 > wfc_util_fcfg_commit(pCfg) ) {
+			wfc_util_log_error("wfc_util_fset_string : fail to write %s", pFileName);
+		}
+
+		wfc_util_fcfg_close(pCfg);
 	} else {
 		wfc_util_log_error("wfc_util_fset_string : can not open file");
 	}
@@ -453,6 +765,7 @@ void wfc_util_fset_string(char *pFileName, char *pEndOfCfg, char *pSTagString, c
  *
  * Read value from the following format string in the file pFileName.
  * [pSTagString][string value to read][pETagString]
+ * The file is read for every call, use wfc_util_fcfg_open() to read several values.
  *
  * pFileName        : file name and path
  * pEndOfCfg        : tag string to notify the end of configuration file
@@ -464,76 +777,18 @@ void wfc_util_fset_string(char *pFileName, char *pEndOfCfg, char *pSTagString, c
  * return : it will return the length of the stored string value if procedure is success
  *          or will return 0 if not.
  */
-int wfc_util_fget_string(char *pFileName, char *pEndOfCfg __attribute__((unused)), char *pSTagString,
+int wfc_util_fget_string(char *pFileName, char *pEndOfCfg, char *pSTagString,
 			 char *pETagString, char *pValueStringBuff, int stringBuffLength)
 {
 	int result = 0;
-	int fd;
-	off_t sz_file;
-	char *pReadBuff = NULL;
-	char *pSPointer = NULL, *pETagPointer = NULL, *pSValuePointer = NULL;
-
-	fd = open( pFileName, O_RDONLY );
-
-	if( fd >= 0 ) {
-		/*
-		 * calcurate file size
-		 */
-		sz_file  = lseek( fd,  0, SEEK_END );
-
-		/*
-		 * prefare the buffer to read file
-		 */
-		if (sz_file > 0)		// skip when value is 0
-			pReadBuff = malloc(sz_file + 1);
+	wfc_util_fcfg *pCfg = NULL;
 
-		if( NULL != pReadBuff ) {
-			/*
-			 * read file
-			 */
-			memset( pReadBuff, 0, sz_file + 1);
-			if(lseek(fd, 0, SEEK_SET) != 0) {
-				wfc_util_log_error("lseek failure");
-			}
-			read( fd, pReadBuff, sz_file );
+	pCfg = wfc_util_fcfg_open(pFileName, pEndOfCfg, pETagString);
 
-			/* WBT fix, make sure it is terminated with \0 */
-			pReadBuff[sz_file] = '\0';
+	if( NULL != pCfg ) {
+		result = wfc_util_fcfg_get_string(pCfg, pSTagString, pValueStringBuff, stringBuffLength);
 
-			/*
-			 * find TAG string
-			 */
-			pSPointer = strstr( pReadBuff, pSTagString );
-
-			if( NULL != pSPointer ) {
-				/*
-				 * find END OF LINE string
-				 */
-				pETagPointer = strstr(pSPointer, pETagString);
-
-				if( NULL != pETagPointer ) {
-					/*
-					 * read the string value
-					 */
-					pSValuePointer = pSPointer+strlen(pSTagString);
-					if( stringBuffLength >= (int)(pETagPointer-pSValuePointer) ) {
-						memset( pValueStringBuff, 0, stringBuffLength );
-						memcpy( pValueStringBuff, pSValuePointer, (int)(pETagPointer-pSValuePointer) );
-						result = (int)(pETagPointer-pSValuePointer);
-					} else {
-						wfc_util_log_error("wfc_util_fget_string : not enough string value buffer(%d)", (int)(pETagPointer-pSValuePointer));
-					}
-				} else {
-					wfc_util_log_error("wfc_util_fget_string : can not find End TAG");
-				}
-			} else {
-				wfc_util_log_error("wfc_util_fget_string : can not find Start TAG");
-			}
-			free(pReadBuff);
-		} else {
-			wfc_util_log_error("wfc_util_fget_string : can not malloc(%d)", (int)sz_file);
-		}
-		close( fd );
+		wfc_util_fcfg_close(pCfg);
 	} else {
 		wfc_util_log_error("wfc_util_fget_string : can not open file");
 	}
@@ -32,11 +32,74 @@ void wfc_util_fset_buffer(char *pFileName, int positionStart, unsigned char *pNe
  */
 extern int wfc_util_fget_buffer(char *pFileName, int positionStart, int lengthToRead, unsigned char *pValueBuff, int buffLength);
 
+/*
+ * wfc_util_fcfg
+ *
+ * configuration file made of [pSTagString][value][pETagString] lines,
+ * read once and written back once.
+ */
+typedef struct wfc_util_fcfg wfc_util_fcfg;
+
+/*
+ * wfc_util_fcfg_open
+ *
+ * Read the file pFileName once and index its [pSTagString][value][pETagString] lines.
+ *
+ * pFileName   : file name and path
+ * pEndOfCfg   : tag string to notify the end of configuration file
+ * pETagString : tag string to notify the end of the value
+ *
+ * return : it will return the configuration to pass to the other wfc_util_fcfg functions
+ *          or will return NULL if the file can not be read.
+ */
+extern wfc_util_fcfg *wfc_util_fcfg_open(char *pFileName, char *pEndOfCfg, char *pETagString);
+
+/*
+ * wfc_util_fcfg_get_string
+ *
+ * Read the value of pSTagString, including a value set but not committed yet.
+ *
+ * return : it will return the length of the stored string value if procedure is success
+ *          or will return 0 if not.
+ */
+extern int wfc_util_fcfg_get_string(wfc_util_fcfg *pCfg, char *pSTagString, char *pValueStringBuff, int stringBuffLength);
+
+/*
+ * wfc_util_fcfg_set_string
+ *
+ * Set the value of pSTagString, or add a [pSTagString][pNewValueString][pETagString]
+ * line before the end of configuration tag. Nothing is written until wfc_util_fcfg_commit().
+ *
+ * return : void
+ */
+extern void wfc_util_fcfg_set_string(wfc_util_fcfg *pCfg, char *pSTagString, char *pNewValueString);
+
+/*
+ * wfc_util_fcfg_commit
+ *
+ * Write the values set since wfc_util_fcfg_open() back to the file in a single write,
+ * through a temporary file renamed over it. The file is not touched if no value changed.
+ *
+ * return : it will return 0 if procedure is success
+ *          or will return -1 if not.
+ */
+extern int wfc_util_fcfg_commit(wfc_util_fcfg *pCfg);
+
+/*
+ * wfc_util_fcfg_close
+ *
+ * Free the configuration. Values not committed are dropped.
+ *
+ * return : void
+ */
+extern void wfc_util_fcfg_close(wfc_util_fcfg *pCfg);
+
 /*
  * wfc_util_fset_string
  *
  * The following format string will be added or updated to the file pFileName.
  * [pSTagString][pNewValueString][pETagString]
+ * The file is read and written for every call, use wfc_util_fcfg_open() to update several values.
  *
  * pFileName       : file name and path
  * pEndOfCfg       : tag string to notify the end of configuration file
@@ -53,6 +116,7 @@ extern void wfc_util_fset_string(char *pFileName, char *pEndOfCfg, char *pSTagSt
  *
  * Read value from the following format string in the file pFileName.
  * [pSTagString][string value to read][pETagString]
+ * The file is read for every call, use wfc_util_fcfg_open() to read several values.
  *
  * pFileName        : file name and path
  * pEndOfCfg        : tag string to notify the end of configuration file
@@ -212,25 +212,64 @@ static int wfc_util_qcom_is_default_mac(char *mac_add)
 	return 0;
 }
 
-static void wfc_util_qcom_write_mac(char *mac_add)
+/*
+ * wfc_util_qcom_open_config
+ *
+ * read the config file to batch its updates until wfc_util_qcom_close_config()
+ *
+ * return : the config or NULL if it can not be read.
+ */
+static wfc_util_fcfg *wfc_util_qcom_open_config(void)
+{
+	wfc_util_fcfg *pCfg = NULL;
+
+	pCfg = wfc_util_fcfg_open(WFC_UTIL_CFG_FILE_NAME,
+	                          WFC_UTIL_CFG_TAG_END_OF_CFG,
+	                          WFC_UTIL_CFG_TAG_END_OF_LINE);
+	if (NULL == pCfg) {
+		wfc_util_log_error("Fail to Read [%s]", WFC_UTIL_CFG_FILE_NAME);
+	}
+
+	return pCfg;
+}
+
+/*
+ * wfc_util_qcom_close_config
+ *
+ * write the updates of the config file at once if there is any
+ *
+ * return : it will return 0 if procedure is success
+ *          or will return -1 if not.
+ */
+static int wfc_util_qcom_close_config(wfc_util_fcfg *pCfg)
+{
+	int result;
+
+	result = wfc_util_fcfg_commit(pCfg);
+	if (0 > result) {
+		wfc_util_log_error("Fail to Write [%s]", WFC_UTIL_CFG_FILE_NAME);
+	}
+
+	wfc_util_fcfg_close(pCfg);
+
+	return result;
+}
+
+static void wfc_util_qcom_write_mac(wfc_util_fcfg *pCfg, char *mac_add)
 {
 	/*
 	 * Station Mode MAC Address
 	 */
-	wfc_util_fset_string(WFC_UTIL_CFG_FILE_NAME,
-	                     WFC_UTIL_CFG_TAG_END_OF_CFG,
-	                     WFC_UTIL_CFG_TAG_MAC_ADDRESS,
-	                     WFC_UTIL_CFG_TAG_END_OF_LINE,
-	                     mac_add);
+	wfc_util_fcfg_set_string(pCfg,
+	                         WFC_UTIL_CFG_TAG_MAC_ADDRESS,
+	                         mac_add);
 
 	/*
 	 * AP Mode MAC Address
 	 */
-	wfc_util_fset_string(WFC_UTIL_CFG_FILE_NAME,
-	                     WFC_UTIL_CFG_TAG_END_OF_CFG,
-	                     WFC_UTIL_CFG_TAG_AP_MAC_ADDRESS,
-	                     WFC_UTIL_CFG_TAG_END_OF_LINE,
-	                     mac_add);
+	wfc_util_fcfg_set_string(pCfg,
+	                         WFC_UTIL_CFG_TAG_AP_MAC_ADDRESS,
+	                         mac_add);
 
 	return;
 }
@@ -238,7 +277,7 @@ static void wfc_util_qcom_write_mac(char *mac_add)
 /*
  *  When OTA is enabled, power save mode and L2 roaming trigger should be off
  */
-static void wfc_util_qcom_write_ota_enable(void)
+static void wfc_util_qcom_write_ota_enable(wfc_util_fcfg *pCfg)
 {
 /*
  * write Beacon Mode Power Save off and L2 Roaming off
@@ -249,17 +288,13 @@ static void wfc_util_qcom_write_ota_enable(void)
 
 	char string_buff[5];
 
-	wfc_util_fset_string(WFC_UTIL_CFG_FILE_NAME,
-	                     WFC_UTIL_CFG_TAG_END_OF_CFG,
-	                     WFC_UTIL_CFG_TAG_IDLE_MODE_POWER_SAVE,
-	                     WFC_UTIL_CFG_TAG_END_OF_LINE,
-	                     PowerSaveOff);
+	wfc_util_fcfg_set_string(pCfg,
+	                         WFC_UTIL_CFG_TAG_IDLE_MODE_POWER_SAVE,
+	                         PowerSaveOff);
 
-	wfc_util_fset_string(WFC_UTIL_CFG_FILE_NAME,
-	                     WFC_UTIL_CFG_TAG_END_OF_CFG,
-	                     WFC_UTIL_CFG_TAG_POWER_SAVE,
-	                     WFC_UTIL_CFG_TAG_END_OF_LINE,
-	                     PowerSaveOff);
+	wfc_util_fcfg_set_string(pCfg,
+	                         WFC_UTIL_CFG_TAG_POWER_SAVE,
+	                         PowerSaveOff);
 
 /* We don't need to change this becasue the default value of WFC_UTIL_CFG_TAG_L2Roaming is 0.
 	wfc_util_fset_string(WFC_UTIL_CFG_FILE_NAME,
@@ -269,17 +304,13 @@ static void wfc_util_qcom_write_ota_enable(void)
 	                     L2RoamingOff);
 */
 
-	if(0 < wfc_util_fget_string(WFC_UTIL_CFG_FILE_NAME,
-	                            WFC_UTIL_CFG_TAG_END_OF_CFG,
-	                            WFC_UTIL_CFG_TAG_HEARTBEAT24,
-	                            WFC_UTIL_CFG_TAG_END_OF_LINE,
-	                            string_buff,
-	                            5)) {
-		wfc_util_fset_string(WFC_UTIL_CFG_FILE_NAME,
-		                     WFC_UTIL_CFG_TAG_END_OF_CFG,
-		                     WFC_UTIL_CFG_TAG_HEARTBEAT24,
-		                     WFC_UTIL_CFG_TAG_END_OF_LINE,
-		                     Heartbeat24);
+	if(0 < wfc_util_fcfg_get_string(pCfg,
+	                                WFC_UTIL_CFG_TAG_HEARTBEAT24,
+	                                string_buff,
+	                                5)) {
+		wfc_util_fcfg_set_string(pCfg,
+		                         WFC_UTIL_CFG_TAG_HEARTBEAT24,
+		                         Heartbeat24);
 	} else {
 		wfc_util_log_error("%s is not exist", WFC_UTIL_CFG_TAG_HEARTBEAT24);
 	}
@@ -290,7 +321,7 @@ static void wfc_util_qcom_write_ota_enable(void)
 /*
  *  When OTA is enabled, power save mode and L2 roaming trigger should be off
  */
-static void wfc_util_qcom_write_ota_disable(void)
+static void wfc_util_qcom_write_ota_disable(wfc_util_fcfg *pCfg)
 {
 /*
  * write Beacon Mode Power Save on and L2 Roaming on
@@ -301,17 +332,13 @@ static void wfc_util_qcom_write_ota_disable(void)
 
 	char string_buff[5];
 
-	wfc_util_fset_string(WFC_UTIL_CFG_FILE_NAME,
-	                     WFC_UTIL_CFG_TAG_END_OF_CFG,
-	                     WFC_UTIL_CFG_TAG_IDLE_MODE_POWER_SAVE,
-	                     WFC_UTIL_CFG_TAG_END_OF_LINE,
-	                     PowerSaveOff);
+	wfc_util_fcfg_set_string(pCfg,
+	                         WFC_UTIL_CFG_TAG_IDLE_MODE_POWER_SAVE,
+	                         PowerSaveOff);
 
-	wfc_util_fset_string(WFC_UTIL_CFG_FILE_NAME,
-	                     WFC_UTIL_CFG_TAG_END_OF_CFG,
-	                     WFC_UTIL_CFG_TAG_POWER_SAVE,
-	                     WFC_UTIL_CFG_TAG_END_OF_LINE,
-	                     PowerSaveOff);
+	wfc_util_fcfg_set_string(pCfg,
+	                         WFC_UTIL_CFG_TAG_POWER_SAVE,
+	                         PowerSaveOff);
 
 /* We don't need to change this becasue the default value of WFC_UTIL_CFG_TAG_L2Roaming is 0.
 	wfc_util_fset_string(WFC_UTIL_CFG_FILE_NAME,
@@ -321,17 +348,13 @@ static void wfc_util_qcom_write_ota_disable(void)
 	                     L2RoamingOff);
 */
 
-	if(0 < wfc_util_fget_string(WFC_UTIL_CFG_FILE_NAME,
-	                            WFC_UTIL_CFG_TAG_END_OF_CFG,
-	                            WFC_UTIL_CFG_TAG_HEARTBEAT24,
-	                            WFC_UTIL_CFG_TAG_END_OF_LINE,
-	                            string_buff,
-	                            5)) {
-		wfc_util_fset_string(WFC_UTIL_CFG_FILE_NAME,
-		                     WFC_UTIL_CFG_TAG_END_OF_CFG,
-		                     WFC_UTIL_CFG_TAG_HEARTBEAT24,
-		                     WFC_UTIL_CFG_TAG_END_OF_LINE,
-		                     Heartbeat24);
+	if(0 < wfc_util_fcfg_get_string(pCfg,
+	                                WFC_UTIL_CFG_TAG_HEARTBEAT24,
+	                                string_buff,
+	                                5)) {
+		wfc_util_fcfg_set_string(pCfg,
+		                         WFC_UTIL_CFG_TAG_HEARTBEAT24,
+		                         Heartbeat24);
 	} else {
 		wfc_util_log_error("%s is not exist", WFC_UTIL_CFG_TAG_HEARTBEAT24);
 	}
@@ -436,7 +459,7 @@ static void wfc_util_qcom_reset_mac_to_bin(void)
 	return;
 }
 
-static int wfc_util_qcom_write_mac_process(unsigned char *nv_mac_addr, char *mac_add_buff)
+static int wfc_util_qcom_write_mac_process(wfc_util_fcfg *pCfg, unsigned char *nv_mac_addr, char *mac_add_buff)
 {
 	char nv_mac_add_buff[WFC_UTIL_CFG_LENGHT_MAC_STRING+1];
 	int  is_default_nv_mac = 0;
@@ -475,7 +498,7 @@ static int wfc_util_qcom_write_mac_process(unsigned char *nv_mac_addr, char *mac
 		/*
 		 * Update MAC address
 		 */
-		wfc_util_qcom_write_mac(nv_mac_add_buff);
+		wfc_util_qcom_write_mac(pCfg, nv_mac_add_buff);
 
 #ifdef WFC_UTIL_FEATURE_DO_NOT_WRITE_MAC_TO_BIN
 		/*
@@ -502,7 +525,7 @@ static int wfc_util_qcom_write_mac_process(unsigned char *nv_mac_addr, char *mac
 	return 0;
 }
 
-static void wfc_util_qcom_create_random_mac(void)
+static void wfc_util_qcom_create_random_mac(wfc_util_fcfg *pCfg)
 {
 	unsigned char random_mac_addr[WFC_UTIL_CFG_LENGHT_MAC];
 	char mac_add_buff[WFC_UTIL_CFG_LENGHT_MAC_STRING+1];
@@ -513,7 +536,7 @@ static void wfc_util_qcom_create_random_mac(void)
 
 	wfc_util_htoa(random_mac_addr, WFC_UTIL_CFG_LENGHT_MAC, mac_add_buff, WFC_UTIL_CFG_LENGHT_MAC_STRING+1);
 
-	wfc_util_qcom_write_mac(mac_add_buff);
+	wfc_util_qcom_write_mac(pCfg, mac_add_buff);
 
 #ifdef WFC_UTIL_FEATURE_DO_NOT_WRITE_MAC_TO_BIN
 	wfc_util_qcom_reset_mac_to_bin();
@@ -535,6 +558,7 @@ static void wfc_util_qcom_create_random_mac(void)
 int wfc_util_qcom_check_config(unsigned char *nv_mac_addr)
 {
 	char mac_add_buff[WFC_UTIL_CFG_LENGHT_MAC_STRING+1];
+	wfc_util_fcfg *pCfg = NULL;
 
 	/* make sure driver config file exists */
 	if(0 > wfc_util_ffile_check_copy(WFC_UTIL_CFG_FILE_NAME,
@@ -571,21 +595,28 @@ int wfc_util_qcom_check_config(unsigned char *nv_mac_addr)
 	}
 #endif /* WFC_UTIL_FEAUTRE_COPY_NV_BIN */
 
+	/*
+	 * Read config file once, the updates below are written at once
+	 */
+	pCfg = wfc_util_qcom_open_config();
+	if (NULL == pCfg) {
+		/* the MAC update is best effort, as is writing it back below */
+		return 0;
+	}
+
 	/*
 	 * Read MAC address from config file
 	 */
-	if(0 < wfc_util_fget_string(WFC_UTIL_CFG_FILE_NAME,
-	                        WFC_UTIL_CFG_TAG_END_OF_CFG,
-	                        WFC_UTIL_CFG_TAG_MAC_ADDRESS,
-	                        WFC_UTIL_CFG_TAG_END_OF_LINE,
-	                        mac_add_buff,
-	                        WFC_UTIL_CFG_LENGHT_MAC_STRING+1)) {
+	if(0 < wfc_util_fcfg_get_string(pCfg,
+	                                WFC_UTIL_CFG_TAG_MAC_ADDRESS,
+	                                mac_add_buff,
+	                                WFC_UTIL_CFG_LENGHT_MAC_STRING+1)) {
 		wfc_util_log_info("%s%s", WFC_UTIL_CFG_TAG_MAC_ADDRESS, mac_add_buff);
 
 		/*
 		 * Write nv mac address
 		 */
-		if (1 != wfc_util_qcom_write_mac_process(nv_mac_addr, mac_add_buff)) {
+		if (1 != wfc_util_qcom_write_mac_process(pCfg, nv_mac_addr, mac_add_buff)) {
 			/*
 			 * Check whether this is default mac address or not
 			 */
@@ -593,7 +624,7 @@ int wfc_util_qcom_check_config(unsigned char *nv_mac_addr)
 				/*
 				 * Create random MAC address
 				 */
-				wfc_util_qcom_create_random_mac();
+				wfc_util_qcom_create_random_mac(pCfg);
 			}
 		}
 	} else {
@@ -604,14 +635,16 @@ int wfc_util_qcom_check_config(unsigned char *nv_mac_addr)
 		/*
 		 * Write nv mac address
 		 */
-		if (1 != wfc_util_qcom_write_mac_process(nv_mac_addr, mac_add_buff)) {
+		if (1 != wfc_util_qcom_write_mac_process(pCfg, nv_mac_addr, mac_add_buff)) {
 			/*
 			 * Create random MAC address
 			 */
-			wfc_util_qcom_create_random_mac();
+			wfc_util_qcom_create_random_mac(pCfg);
 		}
 	}
 
+	wfc_util_qcom_close_config(pCfg);
+
 	return 0;
 }
 
@@ -624,7 +657,13 @@ int wfc_util_qcom_check_config(unsigned char *nv_mac_addr)
  */
 void wfc_util_qcom_reset_mac(void)
 {
-	wfc_util_qcom_write_mac("000000000000");
+	wfc_util_fcfg *pCfg = NULL;
+
+	pCfg = wfc_util_qcom_open_config();
+	if (NULL != pCfg) {
+		wfc_util_qcom_write_mac(pCfg, "000000000000");
+		wfc_util_qcom_close_config(pCfg);
+	}
 
 	wfc_util_qcom_reset_mac_to_bin();
 
@@ -640,7 +679,13 @@ void wfc_util_qcom_reset_mac(void)
  */
 int wfc_util_qcom_ota_enable(void)
 {
-	wfc_util_qcom_write_ota_enable();
+	wfc_util_fcfg *pCfg = NULL;
+
+	pCfg = wfc_util_qcom_open_config();
+	if (NULL != pCfg) {
+		wfc_util_qcom_write_ota_enable(pCfg);
+		wfc_util_qcom_close_config(pCfg);
+	}
 	return 1;
 }
 
@@ -653,7 +698,13 @@ int wfc_util_qcom_ota_enable(void)
  */
 int wfc_util_qcom_ota_disable(void)
 {
-	wfc_util_qcom_write_ota_disable();
+	wfc_util_fcfg *pCfg = NULL;
+
+	pCfg = wfc_util_qcom_open_config();
+	if (NULL != pCfg) {
+		wfc_util_qcom_write_ota_disable(pCfg);
+		wfc_util_qcom_close_config(pCfg);
+	}
 	return 1;
 }
 
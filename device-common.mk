@@ -193,6 +193,9 @@ PRODUCT_PACKAGES += \
     android.hardware.power@1.0-impl \
     power.flo
 
+PRODUCT_COPY_FILES += \
+    device/asus/flo/configs/power-flo.conf:$(TARGET_COPY_OUT_VENDOR)/etc/power_flo.conf
+
 # Ramdisk
 PRODUCT_PACKAGES += \
     fstab.flo \
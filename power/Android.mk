@@ -24,3 +24,12 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE := power.flo
 LOCAL_PROPRIETARY_MODULE := true
 include $(BUILD_SHARED_LIBRARY)
+
+# Replays power hints against the HAL with stand-in sysfs files and boost socket
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := test/power_flo_replay.c
+LOCAL_SHARED_LIBRARIES := libdl
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE := power_flo_replay
+LOCAL_PROPRIETARY_MODULE := true
+include $(BUILD_EXECUTABLE)
@@ -25,11 +25,18 @@
 #include <sys/poll.h>
 #include <pthread.h>
 #include <linux/netlink.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
 
 #define LOG_TAG "PowerHAL"
 #include <utils/Log.h>
+#include <cutils/properties.h>
 
 #include <hardware/hardware.h>
 #include <hardware/power.h>
@@ -40,19 +47,72 @@
 #define MAX_LENGTH         50
 #define BOOST_SOCKET       "/dev/socket/pb"
 
+/* Default profile frequency limits, overridden by POWER_CONFIG_PATH */
 #define POWERSAVE_MIN_FREQ 384000
 #define POWERSAVE_MAX_FREQ 1026000
 #define BIAS_PERF_MIN_FREQ 1134000
 #define NORMAL_MAX_FREQ 1512000
 
+/* Profile limits and boost table, see configs/power-flo.conf */
+#define POWER_CONFIG_PATH "/vendor/etc/power_flo.conf"
+
 #define MAX_FREQ_LIMIT_PATH "/sys/kernel/cpufreq_limit/limited_max_freq"
 #define MIN_FREQ_LIMIT_PATH "/sys/kernel/cpufreq_limit/limited_min_freq"
 
+/*
+ * Environment variable with a directory prefixed to all the paths above, so
+ * the HAL can run against stand-in files and boost socket off-device.
+ */
+#define POWER_ROOT_ENV "POWER_FLO_ROOT"
+
+/* Touch boosts requested within this window of the last one sent are dropped */
+#define BOOST_WINDOW_PROP "persist.power.boost_window_ms"
+#define BOOST_WINDOW_DEFAULT_MS 100
+
+/* When set, the telemetry is logged each time the screen turns off */
+#define DUMP_STATS_PROP "debug.power.dump_stats"
+#define STATS_DUMP_SIZE 4096
+
+/* Commands understood by the boost daemon on BOOST_SOCKET */
+#define BOOST_CMD_TOUCH 1
+#define BOOST_CMD_SYNC_ON 2
+#define BOOST_CMD_SYNC_OFF 3
+#define BOOST_CMD_ENC_ON 5
+#define BOOST_CMD_ENC_OFF 6
+
+/*
+ * A sysfs file kept open across writes, with the last value written to it
+ * so that unchanged values are not written again.
+ */
+struct sysfs_node {
+    const char *name;
+    char path[PATH_MAX];    /* name under the root prefix */
+    int fd;
+    int value;
+    bool value_valid;
+};
+
+static struct sysfs_node min_freq_node = { MIN_FREQ_LIMIT_PATH, "", -1, 0, false };
+static struct sysfs_node max_freq_node = { MAX_FREQ_LIMIT_PATH, "", -1, 0, false };
+static char config_path[PATH_MAX];
+static const char *root_prefix = "";
+
 static int client_sockfd;
 static struct sockaddr_un client_addr;
 static int last_state = -1;
 
+/* Protects the profile and the frequency boost table */
 static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t boost_cond;
+static pthread_once_t setup_once = PTHREAD_ONCE_INIT;
+
+/* Boost state, protected by boost_lock */
+static pthread_mutex_t boost_lock = PTHREAD_MUTEX_INITIALIZER;
+static pid_t boost_client;
+static int sync_thread_cmd = -1;
+static int enc_boost_cmd = -1;
+static int64_t boost_window_ns = BOOST_WINDOW_DEFAULT_MS * 1000000LL;
+static int64_t touch_boost_expiry_ns;
 
 enum {
     PROFILE_POWER_SAVE = 0,
@@ -65,6 +125,111 @@ enum {
 
 static int current_power_profile = PROFILE_BALANCED;
 
+static const char *profile_names[PROFILE_MAX] = {
+    "power_save",
+    "balanced",
+    "high_performance",
+    "bias_power",
+    "bias_performance",
+};
+
+struct freq_limits {
+    int min_freq;
+    int max_freq;
+};
+
+static struct freq_limits profile_limits[PROFILE_MAX] = {
+    [PROFILE_POWER_SAVE]       = { POWERSAVE_MIN_FREQ, POWERSAVE_MAX_FREQ },
+    [PROFILE_BALANCED]         = { POWERSAVE_MIN_FREQ, NORMAL_MAX_FREQ },
+    [PROFILE_HIGH_PERFORMANCE] = { NORMAL_MAX_FREQ, NORMAL_MAX_FREQ },
+    [PROFILE_BIAS_POWER]       = { POWERSAVE_MIN_FREQ, POWERSAVE_MAX_FREQ },
+    [PROFILE_BIAS_PERFORMANCE] = { BIAS_PERF_MIN_FREQ, NORMAL_MAX_FREQ },
+};
+
+enum {
+    FREQ_BOOST_LAUNCH = 0,
+    FREQ_BOOST_CPU_BOOST,
+    FREQ_BOOST_INTERACTION,
+    FREQ_BOOST_MAX
+};
+
+/* What a hint does to its boost when the boost is already active */
+enum {
+    STACKING_RESTART = 0,   /* the duration starts over */
+    STACKING_KEEP,          /* nothing, the boost expires as planned */
+};
+
+/*
+ * A minimum frequency held for some time after a hint. The effective minimum
+ * is the highest floor of the active boosts, within the profile limits.
+ * A boost with no floor is disabled.
+ */
+struct freq_boost {
+    const char *name;
+    int min_freq;
+    int duration_ms;
+    int stacking;
+    int64_t expiry_ns;      /* CLOCK_MONOTONIC, 0 when not active */
+    int64_t start_ns;       /* when the boost became active */
+};
+
+static struct freq_boost freq_boosts[FREQ_BOOST_MAX] = {
+    [FREQ_BOOST_LAUNCH]      = { "launch", 0, 2000, STACKING_RESTART, 0, 0 },
+    [FREQ_BOOST_CPU_BOOST]   = { "cpu_boost", 0, 500, STACKING_RESTART, 0, 0 },
+    [FREQ_BOOST_INTERACTION] = { "interaction", 0, 100, STACKING_RESTART, 0, 0 },
+};
+
+#define HIST_BUCKETS 16
+#define MAX_FREQ_STATES 16
+
+/* Counts of values in power of 2 buckets: [0, 2), [2, 4), [4, 8)... */
+struct histogram {
+    uint64_t buckets[HIST_BUCKETS];
+    uint64_t count;
+    int64_t sum;
+    int64_t max;
+};
+
+enum {
+    STAT_HINT_LAUNCH = 0,
+    STAT_HINT_CPU_BOOST,
+    STAT_HINT_INTERACTION,
+    STAT_HINT_VIDEO_ENCODE,
+    STAT_HINT_SET_PROFILE,
+    STAT_HINT_OTHER,
+    STAT_HINT_MAX
+};
+
+static const char *stat_hint_names[STAT_HINT_MAX] = {
+    "launch",
+    "cpu_boost",
+    "interaction",
+    "video_encode",
+    "set_profile",
+    "other",
+};
+
+/* Telemetry, protected by stats_lock and dumped by format_stats() */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+    uint64_t hints[STAT_HINT_MAX];
+    uint64_t hints_skipped;         /* in power save mode */
+    uint64_t boost_cmds_sent;
+    uint64_t boost_cmds_dropped;    /* coalesced or state unchanged */
+    uint64_t sysfs_writes;
+    uint64_t sysfs_writes_skipped;  /* value unchanged */
+    uint64_t sysfs_errors;
+    struct histogram sysfs_write_us;
+    struct histogram boost_residency_ms[FREQ_BOOST_MAX];
+    /* Time spent at each minimum frequency applied */
+    int min_freqs[MAX_FREQ_STATES];
+    int64_t min_freq_ns[MAX_FREQ_STATES];
+    int num_min_freqs;
+    int min_freq;                   /* applied, 0 before the first write */
+    int max_freq;
+    int64_t min_freq_since_ns;
+} stats;
+
 static void socket_init()
 {
     if (!client_sockfd) {
@@ -75,100 +240,515 @@ static void socket_init()
         }
         memset(&client_addr, 0, sizeof(struct sockaddr_un));
         client_addr.sun_family = AF_UNIX;
-        snprintf(client_addr.sun_path, UNIX_PATH_MAX, BOOST_SOCKET);
+        snprintf(client_addr.sun_path, UNIX_PATH_MAX, "%s%s", root_prefix, BOOST_SOCKET);
     }
 }
 
-static int sysfs_write(const char *path, char *s)
+static int64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void hist_add(struct histogram *h, int64_t value)
+{
+    int bucket = 0;
+
+    while (bucket < HIST_BUCKETS - 1 && value >= (2LL << bucket))
+        bucket++;
+    h->buckets[bucket]++;
+    h->count++;
+    h->sum += value;
+    if (value > h->max)
+        h->max = value;
+}
+
+static void stats_count(uint64_t *counter)
+{
+    pthread_mutex_lock(&stats_lock);
+    (*counter)++;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+static void stats_count_hint(power_hint_t hint)
+{
+    int stat;
+
+    switch (hint) {
+    case POWER_HINT_LAUNCH:
+        stat = STAT_HINT_LAUNCH;
+        break;
+    case POWER_HINT_CPU_BOOST:
+        stat = STAT_HINT_CPU_BOOST;
+        break;
+    case POWER_HINT_INTERACTION:
+        stat = STAT_HINT_INTERACTION;
+        break;
+    case POWER_HINT_VIDEO_ENCODE:
+        stat = STAT_HINT_VIDEO_ENCODE;
+        break;
+    case POWER_HINT_SET_PROFILE:
+        stat = STAT_HINT_SET_PROFILE;
+        break;
+    default:
+        stat = STAT_HINT_OTHER;
+        break;
+    }
+    stats_count(&stats.hints[stat]);
+}
+
+static void stats_boost_ended(int id, int64_t residency_ns)
+{
+    pthread_mutex_lock(&stats_lock);
+    hist_add(&stats.boost_residency_ms[id], residency_ns / 1000000);
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/* Accounts the time spent at the previous limits, then records the new ones */
+static void stats_limits_applied(int min_freq, int max_freq, int64_t now)
+{
+    int i;
+
+    pthread_mutex_lock(&stats_lock);
+    if (stats.min_freq != min_freq) {
+        for (i = 0; i < stats.num_min_freqs; i++) {
+            if (stats.min_freqs[i] == stats.min_freq)
+                stats.min_freq_ns[i] += now - stats.min_freq_since_ns;
+        }
+        for (i = 0; i < stats.num_min_freqs && stats.min_freqs[i] != min_freq; i++)
+            ;
+        if (i == stats.num_min_freqs && i < MAX_FREQ_STATES) {
+            stats.min_freqs[i] = min_freq;
+            stats.num_min_freqs++;
+        }
+        stats.min_freq = min_freq;
+        stats.min_freq_since_ns = now;
+    }
+    stats.max_freq = max_freq;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/* Text buffer the telemetry is formatted into before it is written out */
+struct dump_buf {
+    char text[STATS_DUMP_SIZE];
+    size_t len;
+};
+
+static void dump_printf(struct dump_buf *buf, const char *fmt, ...)
+        __attribute__((format(printf, 2, 3)));
+
+static void dump_printf(struct dump_buf *buf, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if (buf->len >= sizeof(buf->text) - 1)
+        return;
+    va_start(ap, fmt);
+    n = vsnprintf(buf->text + buf->len, sizeof(buf->text) - buf->len, fmt, ap);
+    va_end(ap);
+    if (n > 0)
+        buf->len += n;
+    if (buf->len >= sizeof(buf->text))
+        buf->len = sizeof(buf->text) - 1;
+}
+
+static void dump_histogram(struct dump_buf *buf, const char *name, const char *unit,
+                           const struct histogram *h)
+{
+    int i;
+
+    dump_printf(buf, "%s: count %llu", name, (unsigned long long)h->count);
+    if (h->count) {
+        dump_printf(buf, " avg %lld %s max %lld %s\n ", (long long)(h->sum / h->count),
+                    unit, (long long)h->max, unit);
+        for (i = 0; i < HIST_BUCKETS; i++) {
+            if (h->buckets[i])
+                dump_printf(buf, " <%lld:%llu", 2LL << i, (unsigned long long)h->buckets[i]);
+        }
+    }
+    dump_printf(buf, "\n");
+}
+
+/* Formats the telemetry as text into buf */
+static void format_stats(struct dump_buf *buf)
+{
+    int64_t now = now_ns();
+    int i;
+
+    pthread_mutex_lock(&stats_lock);
+    dump_printf(buf, "hints:");
+    for (i = 0; i < STAT_HINT_MAX; i++)
+        dump_printf(buf, " %s %llu", stat_hint_names[i], (unsigned long long)stats.hints[i]);
+    dump_printf(buf, ", skipped in power save %llu\n", (unsigned long long)stats.hints_skipped);
+    dump_printf(buf, "boost daemon commands: sent %llu dropped %llu\n",
+                (unsigned long long)stats.boost_cmds_sent,
+                (unsigned long long)stats.boost_cmds_dropped);
+    dump_printf(buf, "sysfs writes: %llu skipped %llu errors %llu\n",
+                (unsigned long long)stats.sysfs_writes,
+                (unsigned long long)stats.sysfs_writes_skipped,
+                (unsigned long long)stats.sysfs_errors);
+    dump_histogram(buf, "sysfs write latency", "us", &stats.sysfs_write_us);
+    for (i = 0; i < FREQ_BOOST_MAX; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "boost %s residency", freq_boosts[i].name);
+        dump_histogram(buf, name, "ms", &stats.boost_residency_ms[i]);
+    }
+    dump_printf(buf, "applied limits: min %d max %d\n", stats.min_freq, stats.max_freq);
+    dump_printf(buf, "time at min freq:");
+    for (i = 0; i < stats.num_min_freqs; i++) {
+        int64_t ns = stats.min_freq_ns[i];
+        if (stats.min_freqs[i] == stats.min_freq)
+            ns += now - stats.min_freq_since_ns;
+        dump_printf(buf, " %d:%lldms", stats.min_freqs[i], (long long)(ns / 1000000));
+    }
+    dump_printf(buf, "\n");
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/*
+ * Writes the telemetry as text to fd. Exported so that a debug tool or test
+ * harness that loads the HAL can dump it on demand; on the device the same
+ * text goes to logcat, see power_log_stats().
+ */
+void power_dump_stats(int fd)
+{
+    struct dump_buf buf = { .len = 0 };
+    size_t off = 0;
+    ssize_t n;
+
+    format_stats(&buf);
+    while (off < buf.len) {
+        n = write(fd, buf.text + off, buf.len - off);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        off += n;
+    }
+}
+
+/* Logs the telemetry line by line, when DUMP_STATS_PROP is set */
+static void power_log_stats(void)
+{
+    struct dump_buf buf = { .len = 0 };
+    char *line, *save;
+
+    if (!property_get_bool(DUMP_STATS_PROP, false))
+        return;
+
+    format_stats(&buf);
+    for (line = strtok_r(buf.text, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+        ALOGI("stats: %s", line);
+}
+
+/*
+ * Writes value to the node unless it already holds it. The file is opened on
+ * first use and kept open; it is reopened on the next write after an error.
+ */
+static int sysfs_write_int(struct sysfs_node *node, int value)
 {
     char buf[80];
     int len;
-    int fd = open(path, O_WRONLY);
 
-    if (fd < 0) {
-        strerror_r(errno, buf, sizeof(buf));
-        ALOGE("Error opening %s: %s\n", path, buf);
-        return -1;
+    int64_t start;
+
+    if (node->value_valid && node->value == value) {
+        stats_count(&stats.sysfs_writes_skipped);
+        return 0;
+    }
+
+    start = now_ns();
+    if (node->fd < 0) {
+        node->fd = open(node->path, O_WRONLY | O_CLOEXEC);
+        if (node->fd < 0) {
+            strerror_r(errno, buf, sizeof(buf));
+            ALOGE("Error opening %s: %s\n", node->path, buf);
+            stats_count(&stats.sysfs_errors);
+            return -1;
+        }
     }
 
-    len = write(fd, s, strlen(s));
+    /* The newline ends the value for readers of a regular stand-in file */
+    snprintf(buf, sizeof(buf), "%d\n", value);
+    len = pwrite(node->fd, buf, strlen(buf), 0);
     if (len < 0) {
         strerror_r(errno, buf, sizeof(buf));
-        ALOGE("Error writing to %s: %s\n", path, buf);
+        ALOGE("Error writing to %s: %s\n", node->path, buf);
+        close(node->fd);
+        node->fd = -1;
+        node->value_valid = false;
+        stats_count(&stats.sysfs_errors);
         return -1;
     }
 
-    close(fd);
+    pthread_mutex_lock(&stats_lock);
+    stats.sysfs_writes++;
+    hist_add(&stats.sysfs_write_us, (now_ns() - start) / 1000);
+    pthread_mutex_unlock(&stats_lock);
+
+    node->value = value;
+    node->value_valid = true;
     return 0;
 }
 
-static int sysfs_write_int(char *path, int value)
+/*
+ * Reads POWER_CONFIG_PATH. It is made of sections like:
+ *
+ *   [profile_<name>]       [boost_<name>]
+ *   min_freq  <kHz>        min_freq  <kHz>
+ *   max_freq  <kHz>        duration  <ms>
+ *                          stacking  restart|keep
+ *
+ * Anything not in the file keeps its default.
+ */
+static void load_power_config()
 {
-    char buf[80];
-    snprintf(buf, 80, "%d", value);
-    return sysfs_write(path, buf);
+    FILE *f = fopen(config_path, "r");
+    char line[128], name[64], key[32], value[32];
+    struct freq_limits *limits = NULL;
+    struct freq_boost *boost = NULL;
+    int i;
+
+    if (!f) {
+        ALOGI("%s: no %s, using defaults", __func__, config_path);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, " [%63[^]]]", name) == 1) {
+            limits = NULL;
+            boost = NULL;
+            for (i = 0; i < PROFILE_MAX; i++) {
+                if (!strncmp(name, "profile_", 8) &&
+                        !strcmp(name + 8, profile_names[i]))
+                    limits = &profile_limits[i];
+            }
+            for (i = 0; i < FREQ_BOOST_MAX; i++) {
+                if (!strncmp(name, "boost_", 6) &&
+                        !strcmp(name + 6, freq_boosts[i].name))
+                    boost = &freq_boosts[i];
+            }
+            if (!limits && !boost)
+                ALOGW("%s: unknown section [%s]", __func__, name);
+            continue;
+        }
+        if (sscanf(line, " %31s %31s", key, value) != 2 || key[0] == '#')
+            continue;
+
+        if (limits && !strcmp(key, "min_freq")) {
+            limits->min_freq = atoi(value);
+        } else if (limits && !strcmp(key, "max_freq")) {
+            limits->max_freq = atoi(value);
+        } else if (boost && !strcmp(key, "min_freq")) {
+            boost->min_freq = atoi(value);
+        } else if (boost && !strcmp(key, "duration")) {
+            boost->duration_ms = atoi(value);
+        } else if (boost && !strcmp(key, "stacking")) {
+            if (!strcmp(value, "restart"))
+                boost->stacking = STACKING_RESTART;
+            else if (!strcmp(value, "keep"))
+                boost->stacking = STACKING_KEEP;
+            else
+                ALOGE("%s: invalid stacking %s for boost %s", __func__, value,
+                        boost->name);
+        } else {
+            ALOGW("%s: ignoring %s", __func__, key);
+        }
+    }
+    fclose(f);
+
+    for (i = 0; i < FREQ_BOOST_MAX; i++) {
+        if (freq_boosts[i].min_freq > 0)
+            ALOGI("%s: boost %s to %d kHz for %d ms", __func__, freq_boosts[i].name,
+                    freq_boosts[i].min_freq, freq_boosts[i].duration_ms);
+    }
 }
 
-static void power_init(__attribute__((unused)) struct power_module *module)
+/*
+ * Expires the boosts that are over and writes the frequency limits of the
+ * profile raised by the active boosts, with profile_lock held. Returns when
+ * the next boost expires, or 0 if none is active.
+ */
+static int64_t apply_freq_limits_locked(int64_t now)
 {
-    ALOGI("%s", __func__);
-    socket_init();
+    struct freq_limits *limits = &profile_limits[current_power_profile];
+    int min_freq = limits->min_freq;
+    int64_t next_expiry = 0;
+    int i;
+
+    for (i = 0; i < FREQ_BOOST_MAX; i++) {
+        struct freq_boost *boost = &freq_boosts[i];
+        if (!boost->expiry_ns)
+            continue;
+        if (boost->expiry_ns <= now) {
+            ALOGV("%s: boost %s expired", __func__, boost->name);
+            stats_boost_ended(i, boost->expiry_ns - boost->start_ns);
+            boost->expiry_ns = 0;
+            continue;
+        }
+        /* Power save mode does not take boosts, they only expire */
+        if (current_power_profile != PROFILE_POWER_SAVE && boost->min_freq > min_freq)
+            min_freq = boost->min_freq;
+        if (!next_expiry || boost->expiry_ns < next_expiry)
+            next_expiry = boost->expiry_ns;
+    }
+    if (min_freq > limits->max_freq)
+        min_freq = limits->max_freq;
+
+    sysfs_write_int(&min_freq_node, min_freq);
+    sysfs_write_int(&max_freq_node, limits->max_freq);
+    stats_limits_applied(min_freq, limits->max_freq, now);
+    return next_expiry;
 }
 
-static void sync_thread(int off)
+/* Applies boosts as hints start them, and drops them when they expire */
+static void *boost_thread(__attribute__((unused)) void *arg)
 {
-    int rc;
-    pid_t client;
-    char data[MAX_LENGTH];
+    struct timespec deadline;
+    int64_t next_expiry;
+
+    pthread_mutex_lock(&profile_lock);
+    for (;;) {
+        next_expiry = apply_freq_limits_locked(now_ns());
+        if (!next_expiry) {
+            pthread_cond_wait(&boost_cond, &profile_lock);
+        } else {
+            deadline.tv_sec = next_expiry / 1000000000LL;
+            deadline.tv_nsec = next_expiry % 1000000000LL;
+            pthread_cond_timedwait(&boost_cond, &profile_lock, &deadline);
+        }
+    }
+    return NULL;
+}
 
-    if (client_sockfd < 0) {
-        ALOGE("%s: boost socket not created", __func__);
-        return;
+/* Resolves the paths under the root prefix, loads the config and starts the boost thread */
+static void power_setup()
+{
+    const char *root = getenv(POWER_ROOT_ENV);
+    pthread_condattr_t attr;
+    pthread_t thread;
+
+    if (root) {
+        ALOGI("%s: using root %s", __func__, root);
+        root_prefix = root;
     }
+    snprintf(min_freq_node.path, sizeof(min_freq_node.path), "%s%s", root_prefix,
+            min_freq_node.name);
+    snprintf(max_freq_node.path, sizeof(max_freq_node.path), "%s%s", root_prefix,
+            max_freq_node.name);
+    snprintf(config_path, sizeof(config_path), "%s%s", root_prefix, POWER_CONFIG_PATH);
 
-    client = getpid();
+    load_power_config();
 
-    if (!off) {
-        snprintf(data, MAX_LENGTH, "2:%d", client);
-        rc = sendto(client_sockfd, data, strlen(data), 0,
-            (const struct sockaddr *)&client_addr, sizeof(struct sockaddr_un));
-    } else {
-        snprintf(data, MAX_LENGTH, "3:%d", client);
-        rc = sendto(client_sockfd, data, strlen(data), 0,
-            (const struct sockaddr *)&client_addr, sizeof(struct sockaddr_un));
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&boost_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&thread, NULL, boost_thread, NULL)) {
+        ALOGE("%s: failed to create boost thread", __func__);
+        return;
     }
+    pthread_detach(thread);
+}
 
-    if (rc < 0) {
-        ALOGE("%s: failed to send: %s", __func__, strerror(errno));
+/*
+ * Starts or restarts a frequency boost for duration_ms, or for the duration
+ * of its table entry if duration_ms is negative. A duration of 0 ends the boost.
+ */
+static void freq_boost(int id, int duration_ms)
+{
+    struct freq_boost *boost = &freq_boosts[id];
+    int64_t now = now_ns();
+
+    pthread_mutex_lock(&profile_lock);
+    if (boost->min_freq <= 0) {
+        pthread_mutex_unlock(&profile_lock);
+        return;
     }
+    if (duration_ms < 0)
+        duration_ms = boost->duration_ms;
+
+    if (duration_ms == 0) {
+        if (boost->expiry_ns)
+            stats_boost_ended(id, now - boost->start_ns);
+        boost->expiry_ns = 0;
+    } else if (!boost->expiry_ns) {
+        boost->start_ns = now;
+        boost->expiry_ns = now + duration_ms * 1000000LL;
+    } else if (boost->stacking == STACKING_RESTART) {
+        boost->expiry_ns = now + duration_ms * 1000000LL;
+    }
+    ALOGV("%s: %s for %d ms", __func__, boost->name, duration_ms);
+    pthread_cond_signal(&boost_cond);
+    pthread_mutex_unlock(&profile_lock);
 }
 
-static void enc_boost(int off)
+static void power_init(__attribute__((unused)) struct power_module *module)
+{
+    ALOGI("%s", __func__);
+    pthread_once(&setup_once, power_setup);
+    socket_init();
+
+    pthread_mutex_lock(&boost_lock);
+    boost_client = getpid();
+    boost_window_ns = property_get_int32(BOOST_WINDOW_PROP,
+            BOOST_WINDOW_DEFAULT_MS) * 1000000LL;
+    pthread_mutex_unlock(&boost_lock);
+}
+
+/* Sends a command for this process to the boost daemon, with boost_lock held */
+static int send_boost_cmd(const char *caller, int cmd)
 {
     int rc;
-    pid_t client;
     char data[MAX_LENGTH];
 
     if (client_sockfd < 0) {
-        ALOGE("%s: boost socket not created", __func__);
-        return;
+        ALOGE("%s: boost socket not created", caller);
+        return -1;
     }
 
-    client = getpid();
+    if (!boost_client)
+        boost_client = getpid();
 
-    if (!off) {
-        snprintf(data, MAX_LENGTH, "5:%d", client);
-        rc = sendto(client_sockfd, data, strlen(data), 0,
-            (const struct sockaddr *)&client_addr, sizeof(struct sockaddr_un));
-    } else {
-        snprintf(data, MAX_LENGTH, "6:%d", client);
-        rc = sendto(client_sockfd, data, strlen(data), 0,
-            (const struct sockaddr *)&client_addr, sizeof(struct sockaddr_un));
+    snprintf(data, MAX_LENGTH, "%d:%d", cmd, boost_client);
+    rc = sendto(client_sockfd, data, strlen(data), 0,
+        (const struct sockaddr *)&client_addr, sizeof(struct sockaddr_un));
+    if (rc < 0) {
+        ALOGE("%s: failed to send: %s", caller, strerror(errno));
+        return -1;
     }
+    stats_count(&stats.boost_cmds_sent);
+    return 0;
+}
 
-    if (rc < 0) {
-        ALOGE("%s: failed to send: %s", __func__, strerror(errno));
+/*
+ * Sends a command that switches a boost on or off, unless the boost is
+ * already in that state. A failed send is retried on the next request.
+ */
+static void send_boost_state(const char *caller, int *state, int cmd)
+{
+    pthread_mutex_lock(&boost_lock);
+    if (*state != cmd) {
+        *state = send_boost_cmd(caller, cmd) ? -1 : cmd;
+    } else {
+        stats_count(&stats.boost_cmds_dropped);
     }
+    pthread_mutex_unlock(&boost_lock);
+}
+
+static void sync_thread(int off)
+{
+    send_boost_state(__func__, &sync_thread_cmd,
+            off ? BOOST_CMD_SYNC_OFF : BOOST_CMD_SYNC_ON);
+}
+
+static void enc_boost(int off)
+{
+    send_boost_state(__func__, &enc_boost_cmd,
+            off ? BOOST_CMD_ENC_OFF : BOOST_CMD_ENC_ON);
 }
 
 static void process_video_encode_hint(void *metadata)
@@ -195,29 +775,30 @@ static void process_video_encode_hint(void *metadata)
     }
 }
 
+/*
+ * Touch boosts are timed by the boost daemon. Requests that arrive while the
+ * last one sent is still in its window are coalesced into it.
+ */
 static void touch_boost()
 {
-    int rc;
-    pid_t client;
-    char data[MAX_LENGTH];
+    int64_t now = now_ns();
 
-    if (client_sockfd < 0) {
-        ALOGE("%s: boost socket not created", __func__);
-        return;
-    }
-
-    client = getpid();
-
-    snprintf(data, MAX_LENGTH, "1:%d", client);
-    rc = sendto(client_sockfd, data, strlen(data), 0,
-        (const struct sockaddr *)&client_addr, sizeof(struct sockaddr_un));
-    if (rc < 0) {
-        ALOGE("%s: failed to send: %s", __func__, strerror(errno));
+    pthread_mutex_lock(&boost_lock);
+    if (now >= touch_boost_expiry_ns) {
+        if (!send_boost_cmd(__func__, BOOST_CMD_TOUCH))
+            touch_boost_expiry_ns = now + boost_window_ns;
+    } else {
+        ALOGV("%s: coalesced, %lld ms left", __func__,
+                (long long)(touch_boost_expiry_ns - now) / 1000000);
+        stats_count(&stats.boost_cmds_dropped);
     }
+    pthread_mutex_unlock(&boost_lock);
 }
 
 static void power_set_interactive(__attribute__((unused)) struct power_module *module, int on)
 {
+    pthread_once(&setup_once, power_setup);
+
     if (last_state == on)
         return;
 
@@ -229,40 +810,20 @@ static void power_set_interactive(__attribute__((unused)) struct power_module *m
         touch_boost();
     } else {
         sync_thread(1);
+        power_log_stats();
     }
 }
 
 static void set_power_profile(int profile) {
-    int min_freq = POWERSAVE_MIN_FREQ;
-    int max_freq = NORMAL_MAX_FREQ;
-
     ALOGV("%s: profile=%d", __func__, profile);
 
-    switch (profile) {
-    case PROFILE_HIGH_PERFORMANCE:
-        min_freq = NORMAL_MAX_FREQ;
-        max_freq = NORMAL_MAX_FREQ;
-        break;
-    case PROFILE_BIAS_PERFORMANCE:
-        min_freq = BIAS_PERF_MIN_FREQ;
-        max_freq = NORMAL_MAX_FREQ;
-        break;
-    case PROFILE_BIAS_POWER:
-        min_freq = POWERSAVE_MIN_FREQ;
-        max_freq = POWERSAVE_MAX_FREQ;
-        break;
-    case PROFILE_POWER_SAVE:
-        min_freq = POWERSAVE_MIN_FREQ;
-        max_freq = POWERSAVE_MAX_FREQ;
-        break;
-    default:
-        break;
+    if (profile < 0 || profile >= PROFILE_MAX) {
+        ALOGE("%s: unknown profile %d", __func__, profile);
+        return;
     }
 
-    sysfs_write_int(MIN_FREQ_LIMIT_PATH, min_freq);
-    sysfs_write_int(MAX_FREQ_LIMIT_PATH, max_freq);
-
     current_power_profile = profile;
+    apply_freq_limits_locked(now_ns());
 
     ALOGD("%s: set power profile mode: %d", __func__, current_power_profile);
 }
@@ -270,6 +831,9 @@ static void set_power_profile(int profile) {
 static void power_hint( __attribute__((unused)) struct power_module *module,
                       power_hint_t hint, void *data)
 {
+    pthread_once(&setup_once, power_setup);
+    stats_count_hint(hint);
+
     if (hint == POWER_HINT_SET_PROFILE) {
         pthread_mutex_lock(&profile_lock);
         set_power_profile(*(int32_t *)data);
@@ -278,15 +842,33 @@ static void power_hint( __attribute__((unused)) struct power_module *module,
     }
 
     // Skip other hints in powersave mode
-    if (current_power_profile == PROFILE_POWER_SAVE)
+    if (current_power_profile == PROFILE_POWER_SAVE) {
+        stats_count(&stats.hints_skipped);
         return;
+    }
 
     switch (hint) {
         case POWER_HINT_LAUNCH:
+            ALOGV("POWER_HINT_LAUNCH");
+            /* The hint ends the launch boost early with 0 */
+            if (data && !*(int32_t *)data) {
+                freq_boost(FREQ_BOOST_LAUNCH, 0);
+                break;
+            }
+            freq_boost(FREQ_BOOST_LAUNCH, -1);
+            touch_boost();
+            break;
         case POWER_HINT_CPU_BOOST:
-            ALOGV("POWER_HINT_INTERACTION");
+            ALOGV("POWER_HINT_CPU_BOOST");
+            /* The hint may carry its duration in us */
+            freq_boost(FREQ_BOOST_CPU_BOOST, (data && *(int32_t *)data > 0) ?
+                    (*(int32_t *)data + 999) / 1000 : -1);
             touch_boost();
             break;
+        case POWER_HINT_INTERACTION:
+            ALOGV("POWER_HINT_INTERACTION");
+            freq_boost(FREQ_BOOST_INTERACTION, -1);
+            break;
         case POWER_HINT_VIDEO_ENCODE:
             process_video_encode_hint(data);
             break;
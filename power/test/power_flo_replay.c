@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays a script of power hints against the flo power HAL, with the
+ * cpufreq_limit files and the boost daemon socket replaced by stand-ins under
+ * a scratch root directory, then dumps the HAL telemetry.
+ *
+ * Script lines are "<ms> <action> [value]", <ms> being the time since the
+ * start of the replay:
+ *
+ *   launch 1|0          POWER_HINT_LAUNCH
+ *   cpu_boost [us]      POWER_HINT_CPU_BOOST, with an optional duration
+ *   interaction         POWER_HINT_INTERACTION
+ *   video_encode 1|0    POWER_HINT_VIDEO_ENCODE
+ *   profile <n>         POWER_HINT_SET_PROFILE
+ *   interactive 1|0     setInteractive()
+ *   dump                dump the telemetry
+ */
+#include <dlfcn.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hardware/hardware.h>
+#include <hardware/power.h>
+
+#define DEFAULT_HAL_PATH "/vendor/lib/hw/power.flo.so"
+#define ROOT_ENV "POWER_FLO_ROOT"
+#define MAX_CALLS 65536
+#define MAX_DAEMON_CMDS 16
+
+static int daemon_cmds[MAX_DAEMON_CMDS];
+static bool verbose;
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int make_dirs(const char *root, const char *dir)
+{
+    char path[PATH_MAX];
+    char *p;
+
+    snprintf(path, sizeof(path), "%s/%s", root, dir);
+    for (p = path + strlen(root) + 1; *p; p++) {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        if (mkdir(path, 0755) && errno != EEXIST)
+            return -1;
+        *p = '/';
+    }
+    if (mkdir(path, 0755) && errno != EEXIST)
+        return -1;
+    return 0;
+}
+
+static int copy_file(const char *from, const char *to)
+{
+    char buf[4096];
+    size_t len;
+    FILE *in = fopen(from, "r");
+    FILE *out = fopen(to, "w");
+
+    if (!in || !out) {
+        if (in)
+            fclose(in);
+        if (out)
+            fclose(out);
+        return -1;
+    }
+    while ((len = fread(buf, 1, sizeof(buf), in)) > 0)
+        fwrite(buf, 1, len, out);
+    fclose(in);
+    fclose(out);
+    return 0;
+}
+
+/* Stand-in for the boost daemon: counts the commands it receives */
+static void *daemon_thread(void *arg)
+{
+    int fd = *(int *)arg;
+    char msg[64];
+    int cmd, pid;
+    ssize_t len;
+
+    for (;;) {
+        len = recv(fd, msg, sizeof(msg) - 1, 0);
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        msg[len] = '\0';
+        if (sscanf(msg, "%d:%d", &cmd, &pid) == 2 && cmd >= 0 && cmd < MAX_DAEMON_CMDS)
+            __atomic_fetch_add(&daemon_cmds[cmd], 1, __ATOMIC_RELAXED);
+        if (verbose)
+            printf("%lld boost daemon: %s\n", (long long)(now_ns() / 1000000), msg);
+    }
+    return NULL;
+}
+
+static int start_daemon(const char *root)
+{
+    static int fd;
+    struct sockaddr_un addr;
+    pthread_t thread;
+
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/dev/socket/pb", root);
+    unlink(addr.sun_path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        fprintf(stderr, "bind(%s): %s\n", addr.sun_path, strerror(errno));
+        return -1;
+    }
+    if (pthread_create(&thread, NULL, daemon_thread, &fd))
+        return -1;
+    pthread_detach(thread);
+    return 0;
+}
+
+static void print_file(const char *root, const char *name)
+{
+    char path[PATH_MAX], value[32] = "";
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/sys/kernel/cpufreq_limit/%s", root, name);
+    f = fopen(path, "r");
+    if (f) {
+        if (!fgets(value, sizeof(value), f))
+            value[0] = '\0';
+        fclose(f);
+    }
+    value[strcspn(value, "\n")] = '\0';
+    printf("%s: %s\n", name, value);
+}
+
+static int compare_int64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [-l hal.so] [-r root] [-c config] [-n loops] [-v] script\n"
+            "  -l  power HAL library (default %s)\n"
+            "  -r  scratch root directory (default: a new one under $TMPDIR)\n"
+            "  -c  power_flo.conf to install under the root\n"
+            "  -n  replay the script this many times (default 1)\n"
+            "  -v  print the commands the boost daemon receives\n",
+            name, DEFAULT_HAL_PATH);
+}
+
+int main(int argc, char **argv)
+{
+    const char *lib_path = DEFAULT_HAL_PATH;
+    const char *config = NULL;
+    char root[PATH_MAX / 2] = "";
+    char path[PATH_MAX], line[128], action[32];
+    static int64_t call_ns[MAX_CALLS];
+    int num_calls = 0, loops = 1, loop, opt, i;
+    int64_t start, loop_ms = 0;
+    power_module_t *module;
+    void (*dump_stats)(int);
+    void *lib;
+    FILE *script;
+
+    while ((opt = getopt(argc, argv, "l:r:c:n:vh")) != -1) {
+        switch (opt) {
+        case 'l':
+            lib_path = optarg;
+            break;
+        case 'r':
+            snprintf(root, sizeof(root), "%s", optarg);
+            break;
+        case 'c':
+            config = optarg;
+            break;
+        case 'n':
+            loops = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc - 1 || loops < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!root[0]) {
+        const char *tmp = getenv("TMPDIR");
+        snprintf(root, sizeof(root), "%s/power_flo.XXXXXX", tmp ? tmp : "/data/local/tmp");
+        if (!mkdtemp(root)) {
+            fprintf(stderr, "mkdtemp(%s): %s\n", root, strerror(errno));
+            return 1;
+        }
+    }
+    if (make_dirs(root, "sys/kernel/cpufreq_limit") || make_dirs(root, "dev/socket") ||
+            make_dirs(root, "vendor/etc")) {
+        fprintf(stderr, "cannot populate %s: %s\n", root, strerror(errno));
+        return 1;
+    }
+    for (i = 0; i < 2; i++) {
+        FILE *f;
+        snprintf(path, sizeof(path), "%s/sys/kernel/cpufreq_limit/%s", root,
+                i ? "limited_max_freq" : "limited_min_freq");
+        f = fopen(path, "a");
+        if (!f) {
+            fprintf(stderr, "cannot create %s: %s\n", path, strerror(errno));
+            return 1;
+        }
+        fclose(f);
+    }
+    snprintf(path, sizeof(path), "%s/vendor/etc/power_flo.conf", root);
+    if (config && copy_file(config, path)) {
+        fprintf(stderr, "cannot copy %s to %s\n", config, path);
+        return 1;
+    }
+    if (start_daemon(root))
+        return 1;
+    printf("root: %s\n", root);
+
+    setenv(ROOT_ENV, root, 1);
+    lib = dlopen(lib_path, RTLD_NOW);
+    if (!lib) {
+        fprintf(stderr, "dlopen(%s): %s\n", lib_path, dlerror());
+        return 1;
+    }
+    module = (power_module_t *)dlsym(lib, HAL_MODULE_INFO_SYM_AS_STR);
+    dump_stats = (void (*)(int))dlsym(lib, "power_dump_stats");
+    if (!module) {
+        fprintf(stderr, "dlsym(%s): %s\n", HAL_MODULE_INFO_SYM_AS_STR, dlerror());
+        return 1;
+    }
+    module->init(module);
+
+    script = strcmp(argv[optind], "-") ? fopen(argv[optind], "r") : stdin;
+    if (!script) {
+        fprintf(stderr, "cannot open %s\n", argv[optind]);
+        return 1;
+    }
+
+    start = now_ns();
+    for (loop = 0; loop < loops; loop++) {
+        int64_t ms = 0;
+        rewind(script);
+        while (fgets(line, sizeof(line), script)) {
+            long long at;
+            int value = -1, fields;
+            int64_t wait, call_start;
+
+            fields = sscanf(line, "%lld %31s %d", &at, action, &value);
+            if (fields < 2 || line[0] == '#')
+                continue;
+            ms = at;
+            wait = start + (loop_ms + ms) * 1000000LL - now_ns();
+            if (wait > 0)
+                usleep(wait / 1000);
+
+            call_start = now_ns();
+            if (!strcmp(action, "launch")) {
+                module->powerHint(module, POWER_HINT_LAUNCH, fields > 2 ? &value : NULL);
+            } else if (!strcmp(action, "cpu_boost")) {
+                module->powerHint(module, POWER_HINT_CPU_BOOST, fields > 2 ? &value : NULL);
+            } else if (!strcmp(action, "interaction")) {
+                module->powerHint(module, POWER_HINT_INTERACTION, NULL);
+            } else if (!strcmp(action, "video_encode")) {
+                module->powerHint(module, POWER_HINT_VIDEO_ENCODE,
+                        value ? "state=1" : "state=0");
+            } else if (!strcmp(action, "profile")) {
+                module->powerHint(module, POWER_HINT_SET_PROFILE, &value);
+            } else if (!strcmp(action, "interactive")) {
+                module->setInteractive(module, value);
+            } else if (!strcmp(action, "dump")) {
+                fflush(stdout);
+                if (dump_stats)
+                    dump_stats(STDOUT_FILENO);
+                continue;
+            } else {
+                fprintf(stderr, "unknown action: %s", line);
+                continue;
+            }
+            if (num_calls < MAX_CALLS)
+                call_ns[num_calls++] = now_ns() - call_start;
+        }
+        loop_ms += ms;
+    }
+
+    printf("replayed %d calls in %lld ms\n", num_calls,
+            (long long)((now_ns() - start) / 1000000));
+    if (num_calls) {
+        qsort(call_ns, num_calls, sizeof(call_ns[0]), compare_int64);
+        printf("call latency (us): p50 %.1f p99 %.1f max %.1f\n",
+                call_ns[num_calls / 2] / 1000.0, call_ns[num_calls * 99 / 100] / 1000.0,
+                call_ns[num_calls - 1] / 1000.0);
+    }
+    printf("boost daemon commands:");
+    for (i = 0; i < MAX_DAEMON_CMDS; i++) {
+        if (daemon_cmds[i])
+            printf(" %d:%d", i, daemon_cmds[i]);
+    }
+    printf("\n");
+    print_file(root, "limited_min_freq");
+    print_file(root, "limited_max_freq");
+    fflush(stdout);
+    if (dump_stats)
+        dump_stats(STDOUT_FILENO);
+    else
+        printf("no power_dump_stats in %s\n", lib_path);
+
+    fflush(stdout);
+    /* The HAL boost thread never exits */
+    _exit(0);
+}
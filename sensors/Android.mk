@@ -28,6 +28,7 @@ LOCAL_CFLAGS := -DLOG_TAG=\"MultiHal\"
 LOCAL_SRC_FILES := \
     multihal.cpp \
     SensorEventQueue.cpp \
+    SoftBatcher.cpp \
 
 LOCAL_SHARED_LIBRARIES := \
     libcutils \
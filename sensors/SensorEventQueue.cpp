@@ -18,74 +18,121 @@
 #include <algorithm>
 #include <pthread.h>
 #include <cutils/log.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "SensorEventQueue.h"
 
-SensorEventQueue::SensorEventQueue(int capacity) {
-    mCapacity = capacity;
+FutexSignal::FutexSignal() : mSeq(0), mWaiters(0) {
+}
+
+int FutexSignal::prepareWait() {
+    // Sequentially consistent, so either this waiter sees the condition change or wake() sees
+    // the waiter.
+    mWaiters.fetch_add(1);
+    return mSeq.load();
+}
+
+void FutexSignal::wait(int token, int64_t timeout_ns) {
+    if (timeout_ns < 0) {
+        while (mSeq.load() == token) {
+            syscall(__NR_futex, reinterpret_cast<int*>(&mSeq), FUTEX_WAIT_PRIVATE, token,
+                    NULL, NULL, 0);
+        }
+    } else if (mSeq.load() == token) {
+        struct timespec ts;
+        ts.tv_sec = timeout_ns / 1000000000LL;
+        ts.tv_nsec = timeout_ns % 1000000000LL;
+        syscall(__NR_futex, reinterpret_cast<int*>(&mSeq), FUTEX_WAIT_PRIVATE, token,
+                &ts, NULL, 0);
+    }
+    mWaiters.fetch_sub(1);
+}
+
+void FutexSignal::cancelWait() {
+    mWaiters.fetch_sub(1);
+}
+
+void FutexSignal::wake() {
+    if (mWaiters.load() == 0) {
+        return;
+    }
+    mSeq.fetch_add(1);
+    syscall(__NR_futex, reinterpret_cast<int*>(&mSeq), FUTEX_WAKE_PRIVATE, INT_MAX,
+            NULL, NULL, 0);
+}
 
-    mStart = 0;
-    mSize = 0;
+SensorEventQueue::SensorEventQueue(int capacity) : mWritePos(0), mReadPos(0) {
+    mCapacity = capacity;
     mData = new sensors_event_t[mCapacity];
-    pthread_cond_init(&mSpaceAvailableCondition, NULL);
 }
 
 SensorEventQueue::~SensorEventQueue() {
     delete[] mData;
     mData = NULL;
-    pthread_cond_destroy(&mSpaceAvailableCondition);
 }
 
 int SensorEventQueue::getWritableRegion(int requestedLength, sensors_event_t** out) {
-    if (mSize == mCapacity || requestedLength <= 0) {
+    int size = getSize();
+    if (size == mCapacity || requestedLength <= 0) {
         *out = NULL;
         return 0;
     }
     // Start writing after the last readable record.
-    int firstWritable = (mStart + mSize) % mCapacity;
-
-    int lastWritable = firstWritable + requestedLength - 1;
+    int firstWritable = mWritePos.load(std::memory_order_relaxed) % mCapacity;
 
+    int length = std::min(requestedLength, mCapacity - size);
     // Don't go past the end of the data array.
-    if (lastWritable > mCapacity - 1) {
-        lastWritable = mCapacity - 1;
-    }
-    // Don't go into the readable region.
-    if (firstWritable < mStart && lastWritable >= mStart) {
-        lastWritable = mStart - 1;
-    }
+    length = std::min(length, mCapacity - firstWritable);
     *out = &mData[firstWritable];
-    return lastWritable - firstWritable + 1;
+    return length;
 }
 
 void SensorEventQueue::markAsWritten(int count) {
-    mSize += count;
+    int pos = mWritePos.load(std::memory_order_relaxed);
+    // Publishes the records written to the region.
+    mWritePos.store((pos + count) % (2 * mCapacity));
 }
 
 int SensorEventQueue::getSize() {
-    return mSize;
+    return (mWritePos.load() - mReadPos.load() + 2 * mCapacity) % (2 * mCapacity);
 }
 
 sensors_event_t* SensorEventQueue::peek() {
-    if (mSize == 0) return NULL;
-    return &mData[mStart];
+    if (getSize() == 0) return NULL;
+    return &mData[mReadPos.load(std::memory_order_relaxed) % mCapacity];
 }
 
-void SensorEventQueue::dequeue() {
-    if (mSize == 0) return;
-    if (mSize == mCapacity) {
-        pthread_cond_broadcast(&mSpaceAvailableCondition);
-    }
-    mSize--;
-    mStart = (mStart + 1) % mCapacity;
+int SensorEventQueue::getReadableRegion(sensors_event_t** out) {
+    int size = getSize();
+    int firstReadable = mReadPos.load(std::memory_order_relaxed) % mCapacity;
+    *out = &mData[firstReadable];
+    // Don't go past the end of the data array.
+    return std::min(size, mCapacity - firstReadable);
+}
+
+void SensorEventQueue::dequeue(int count) {
+    int pos = mReadPos.load(std::memory_order_relaxed);
+    count = std::min(count, getSize());
+    if (count <= 0) return;
+    mReadPos.store((pos + count) % (2 * mCapacity));
+    mSpaceAvailable.wake();
 }
 
 // returns true if it waited, or false if it was a no-op.
-bool SensorEventQueue::waitForSpace(pthread_mutex_t* mutex) {
+bool SensorEventQueue::waitForSpace() {
     bool waited = false;
-    while (mSize == mCapacity) {
+    while (getSize() == mCapacity) {
+        int token = mSpaceAvailable.prepareWait();
+        if (getSize() < mCapacity) {
+            mSpaceAvailable.cancelWait();
+            break;
+        }
         waited = true;
-        pthread_cond_wait(&mSpaceAvailableCondition, mutex);
+        mSpaceAvailable.wait(token);
     }
     return waited;
 }
@@ -19,6 +19,33 @@
 
 #include <hardware/sensors.h>
 #include <pthread.h>
+#include <atomic>
+
+/*
+ * Futex based wakeup for one side of a lock free queue. A thread that finds nothing to do calls
+ * prepareWait(), checks its condition again, then either cancelWait() or wait(). The other side
+ * changes the condition and calls wake(), which is a single atomic load when nobody is parked.
+ */
+class FutexSignal {
+    std::atomic<int> mSeq;
+    std::atomic<int> mWaiters;
+
+public:
+    FutexSignal();
+
+    // Registers the caller as a waiter. Returns the token to pass to wait().
+    int prepareWait();
+
+    // Blocks until wake() is called after the prepareWait() that returned token. If timeout_ns
+    // is not negative, returns after at most that long; it may also return early.
+    void wait(int token, int64_t timeout_ns = -1);
+
+    // Unregisters a waiter that found its condition true after prepareWait().
+    void cancelWait();
+
+    // Wakes all registered waiters.
+    void wake();
+};
 
 /*
  * Fixed-size circular queue, with an API developed around the sensor HAL poll() method.
@@ -27,15 +54,18 @@
  * write to, instead of using an intermediate buffer and a memcpy.
  *
  * Thread safety:
- * Reading can be done safely after grabbing the mutex lock, while poll() writing in a separate
- * thread without a mutex lock. But there can only be one writer at a time.
+ * Lock free with a single writer and a single reader. The writer uses getWritableRegion(),
+ * markAsWritten() and waitForSpace(); the reader uses peek() and dequeue(). getSize() may be
+ * called from either side.
  */
 class SensorEventQueue {
     int mCapacity;
-    int mStart; // start of readable region
-    int mSize; // number of readable items
     sensors_event_t* mData;
-    pthread_cond_t mSpaceAvailableCondition;
+    // Positions of the writer and the reader, counted modulo 2 * mCapacity so a full queue
+    // can be told from an empty one. Each is only advanced by its own side.
+    std::atomic<int> mWritePos;
+    std::atomic<int> mReadPos;
+    FutexSignal mSpaceAvailable;
 
 public:
     explicit SensorEventQueue(int capacity);
@@ -45,32 +75,38 @@ public:
     // writable space, it will return a region of at least one. Because it must return
     // a pointer to a contiguous region, it may return smaller regions as we approach the end of
     // the data array.
-    // Only call while holding the lock.
+    // Only call from the writer.
     // The region is not marked internally in any way. Subsequent calls may return overlapping
     // regions. This class expects there to be exactly one writer at a time.
     int getWritableRegion(int requestedLength, sensors_event_t** out);
 
     // After writing to the region returned by getWritableRegion(), call this to indicate how
-    // many records were actually written.
+    // many records were actually written. The records become visible to the reader.
     // This increases size() by count.
-    // Only call while holding the lock.
+    // Only call from the writer.
     void markAsWritten(int count);
 
     // Gets the number of readable records.
-    // Only call while holding the lock.
     int getSize();
 
     // Returns pointer to the first readable record, or NULL if size() is zero.
-    // Only call this while holding the lock.
+    // Only call from the reader.
     sensors_event_t* peek();
 
-    // This will decrease the size by one, freeing up the oldest readable event's slot for writing.
-    // Only call while holding the lock.
-    void dequeue();
+    // Returns the number of readable records that are contiguous in the data array, starting
+    // with the oldest one, and points out at it. Returns zero if size() is zero.
+    // Only call from the reader.
+    int getReadableRegion(sensors_event_t** out);
+
+    // This will decrease the size by count, freeing up the oldest readable events' slots for
+    // writing. Wakes the writer if it is waiting for space.
+    // Only call from the reader.
+    void dequeue(int count = 1);
 
     // Blocks until space is available. No-op if there is already space.
     // Returns true if it had to wait.
-    bool waitForSpace(pthread_mutex_t* mutex);
+    // Only call from the writer.
+    bool waitForSpace();
 };
 
 #endif // SENSOREVENTQUEUE_H_
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <hardware/sensors.h>
+#include <algorithm>
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+#include <cutils/log.h>
+
+#include "SoftBatcher.h"
+
+SoftBatcher::SoftBatcher(SensorEventQueue* queue) : mQueue(queue), mPendingCount(0) {
+    pthread_mutex_init(&mLock, NULL);
+}
+
+SoftBatcher::~SoftBatcher() {
+    for (size_t i = 0; i < mFifos.size(); i++) {
+        delete mFifos[i];
+    }
+    pthread_mutex_destroy(&mLock);
+}
+
+// Only call while holding the lock.
+SoftBatcher::Fifo* SoftBatcher::findFifo(int localHandle) {
+    for (size_t i = 0; i < mFifos.size(); i++) {
+        if (mFifos[i]->localHandle == localHandle) {
+            return mFifos[i];
+        }
+    }
+    return NULL;
+}
+
+void SoftBatcher::batch(int localHandle, int64_t periodNs, int64_t timeoutNs) {
+    pthread_mutex_lock(&mLock);
+    Fifo* fifo = findFifo(localHandle);
+    if (fifo == NULL && timeoutNs > 0) {
+        fifo = new Fifo();
+        fifo->localHandle = localHandle;
+        mFifos.push_back(fifo);
+    }
+    if (fifo != NULL) {
+        fifo->periodNs = std::max(periodNs, (int64_t) 1);
+        fifo->timeoutNs = timeoutNs;
+        // Enough events to cover the latency, so a full FIFO is published about when it is due.
+        int64_t maxEvents = timeoutNs / fifo->periodNs + 1;
+        fifo->maxEvents = (int) std::min(maxEvents, (int64_t) SOFT_BATCH_MAX_EVENTS);
+        fifo->events.reserve(fifo->maxEvents);
+        ALOGV("soft batching handle %d period %" PRId64 " timeout %" PRId64 " fifo %d",
+                localHandle, periodNs, timeoutNs, fifo->maxEvents);
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+int SoftBatcher::flush(int localHandle) {
+    int written = -1;
+    pthread_mutex_lock(&mLock);
+    Fifo* fifo = findFifo(localHandle);
+    if (fifo != NULL) {
+        this->publish(fifo);
+        sensors_event_t flushComplete;
+        memset(&flushComplete, 0, sizeof(flushComplete));
+        flushComplete.version = META_DATA_VERSION;
+        flushComplete.type = SENSOR_TYPE_META_DATA;
+        flushComplete.meta_data.what = META_DATA_FLUSH_COMPLETE;
+        flushComplete.meta_data.sensor = fifo->localHandle;
+        mPending.push_back(flushComplete);
+        written = this->drainLocked();
+    }
+    pthread_mutex_unlock(&mLock);
+    return written;
+}
+
+void SoftBatcher::stop(int localHandle) {
+    pthread_mutex_lock(&mLock);
+    Fifo* fifo = findFifo(localHandle);
+    if (fifo != NULL) {
+        fifo->events.clear();
+        fifo->timeoutNs = 0;
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+// Returns true if the staged events of the FIFO must be published now. The check uses event
+// timestamps: if the next event, one period after the newest, would make the oldest one late,
+// the FIFO is due.
+bool SoftBatcher::isDue(const Fifo* fifo, bool force) {
+    if (fifo->events.empty()) {
+        return false;
+    }
+    if (force || fifo->timeoutNs == 0 || (int) fifo->events.size() >= fifo->maxEvents) {
+        return true;
+    }
+    return fifo->events.front().timestamp + fifo->timeoutNs <=
+            fifo->events.back().timestamp + fifo->periodNs;
+}
+
+// Moves the staged events of the FIFO to the pending events. Only call while holding the lock.
+void SoftBatcher::publish(Fifo* fifo) {
+    mPending.insert(mPending.end(), fifo->events.begin(), fifo->events.end());
+    fifo->events.clear();
+}
+
+// Copies pending events to the queue until it is full. Returns the number of events copied. Only
+// call while holding the lock.
+int SoftBatcher::drainLocked() {
+    int count = (int) mPending.size();
+    int written = 0;
+    while (written < count) {
+        sensors_event_t* region;
+        int length = mQueue->getWritableRegion(count - written, &region);
+        if (length == 0) {
+            break;
+        }
+        memcpy(region, mPending.data() + written, length * sizeof(sensors_event_t));
+        mQueue->markAsWritten(length);
+        written += length;
+    }
+    mPending.erase(mPending.begin(), mPending.begin() + written);
+    mPendingCount.store((int) mPending.size());
+    return written;
+}
+
+int SoftBatcher::drain() {
+    if (mPendingCount.load() == 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&mLock);
+    int written = this->drainLocked();
+    pthread_mutex_unlock(&mLock);
+    return written;
+}
+
+int SoftBatcher::process(const sensors_event_t* events, int count) {
+    pthread_mutex_lock(&mLock);
+
+    // Move events of batched sensors to their FIFOs, and the rest to the pending events. Meta
+    // data events are never batched.
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        Fifo* fifo = (mFifos.empty() || events[i].type == SENSOR_TYPE_META_DATA) ?
+                NULL : findFifo(events[i].sensor);
+        if (fifo != NULL && fifo->timeoutNs > 0) {
+            fifo->events.push_back(events[i]);
+            continue;
+        }
+        mPending.push_back(events[i]);
+        kept++;
+    }
+
+    // The multihal poll() is woken up for the kept events anyway, send every staged event along.
+    bool force = kept > 0;
+    for (size_t i = 0; i < mFifos.size();) {
+        Fifo* fifo = mFifos[i];
+        if (this->isDue(fifo, force)) {
+            this->publish(fifo);
+        }
+        if (fifo->timeoutNs == 0 && fifo->events.empty()) {
+            // Batching was stopped and everything is delivered.
+            delete fifo;
+            mFifos.erase(mFifos.begin() + i);
+        } else {
+            i++;
+        }
+    }
+    int written = this->drainLocked();
+
+    pthread_mutex_unlock(&mLock);
+    return written;
+}
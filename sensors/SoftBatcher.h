@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SOFTBATCHER_H_
+#define SOFTBATCHER_H_
+
+#include <hardware/sensors.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+
+#include "SensorEventQueue.h"
+
+// Largest software FIFO of a sensor, advertised as its fifoMaxEventCount.
+static const int SOFT_BATCH_MAX_EVENTS = 1000;
+
+/*
+ * Batching for a sub-HAL that has no hardware FIFO (API below 1.1). The sub-HAL's writer thread
+ * polls into a buffer of its own and hands the events to process(), which stages events of
+ * batched sensors in per-sensor FIFOs and writes the rest to the queue. A FIFO is published when
+ * its oldest event would otherwise exceed the max report latency, when it holds as many events
+ * as the latency covers, or when other events wake up the multihal poll() anyway. flush()
+ * publishes the FIFO right away, followed by the flush complete event, so that it does not wait
+ * for the sub-HAL to return more events.
+ *
+ * Published events that do not fit in the queue are kept pending, in order, and moved to the
+ * queue by drain() as the multihal poll() makes space. Nothing blocks on the queue while holding
+ * the lock, so batch(), flush() and stop() never wait for the multihal poll().
+ *
+ * Thread safety:
+ * All writes to the queue are made while holding the lock, which makes the lock holder its
+ * single writer. batch(), flush(), stop() and drain() may be called from any thread, process()
+ * is only called from the writer thread of the sub-HAL. The multihal poll() only takes the lock
+ * to drain pending events.
+ */
+class SoftBatcher {
+    struct Fifo {
+        int localHandle;
+        int64_t periodNs;
+        int64_t timeoutNs; // max report latency, 0 once batching is stopped
+        int maxEvents;
+        std::vector<sensors_event_t> events;
+    };
+
+    pthread_mutex_t mLock;
+    SensorEventQueue* mQueue;
+    std::vector<Fifo*> mFifos;
+    // Published events waiting for space in the queue, oldest first.
+    std::vector<sensors_event_t> mPending;
+    // Size of mPending, read without the lock.
+    std::atomic<int> mPendingCount;
+
+    Fifo* findFifo(int localHandle);
+    bool isDue(const Fifo* fifo, bool force);
+    void publish(Fifo* fifo);
+    int drainLocked();
+
+public:
+    explicit SoftBatcher(SensorEventQueue* queue);
+    ~SoftBatcher();
+
+    // Starts batching the sensor, or updates its period and max report latency. A timeout of 0
+    // stops batching once the staged events are published.
+    void batch(int localHandle, int64_t periodNs, int64_t timeoutNs);
+
+    // Publishes the staged events of the sensor followed by a flush complete event. Returns the
+    // number of events made readable, or -1 if the sensor is not batched.
+    int flush(int localHandle);
+
+    // Drops the staged events of a sensor that was deactivated.
+    void stop(int localHandle);
+
+    // Takes count events polled from the sub-HAL, stages the ones of batched sensors, writes the
+    // rest to the queue and publishes the FIFOs that are due. Returns the number of events made
+    // readable.
+    int process(const sensors_event_t* events, int count);
+
+    // Returns the number of published events that did not fit in the queue yet.
+    int getPendingCount() {
+        return mPendingCount.load();
+    }
+
+    // Moves pending events to the queue, as many as fit. Returns the number of events moved.
+    int drain();
+};
+
+#endif // SOFTBATCHER_H_
@@ -15,93 +15,131 @@
  */
 
 #include "SensorEventQueue.h"
+#include "SoftBatcher.h"
 #include "multihal.h"
 
 #define LOG_NDEBUG 1
 #include <cutils/log.h>
 #include <cutils/atomic.h>
+#include <cutils/properties.h>
 #include <hardware/sensors.h>
 
 #include <vector>
 #include <string>
 #include <fstream>
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <deque>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <dirent.h>
 #include <dlfcn.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <math.h>
 #include <poll.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 
 static pthread_mutex_t init_modules_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t init_sensors_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-// This mutex is shared by all queues
-static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-// Used to pause the multihal poll(). Broadcasted by sub-polling tasks if waiting_for_data.
-static pthread_cond_t data_available_cond = PTHREAD_COND_INITIALIZER;
-bool waiting_for_data = false;
-
 /*
  * Vector of sub modules, whose indexes are referred to in this file as module_index.
  */
 static std::vector<hw_module_t *> *sub_hw_modules = NULL;
 
+/*
+ * Sensor list and sensor count of each sub module, parallel to sub_hw_modules.
+ * Queried once, when the module is loaded.
+ */
+static std::vector<std::pair<const sensor_t*, int> > *sub_hw_sensors = NULL;
+
 /*
  * Map to retrieve the API version of each sub_hw_module.
  */
 static std::unordered_map<hw_module_t *, int> *sub_hw_versions = NULL;
 
 /*
- * Comparable class that globally identifies a sensor, by module index and local handle.
+ * Globally identifies a sensor, by module index and local handle.
  * A module index is the module's index in sub_hw_modules.
  * A local handle is the handle the sub-module assigns to a sensor.
  */
 struct FullHandle {
     int moduleIndex;
     int localHandle;
+};
 
-    bool operator<(const FullHandle &that) const {
-        if (moduleIndex < that.moduleIndex) {
-            return true;
-        }
-        if (moduleIndex > that.moduleIndex) {
-            return false;
-        }
-        return localHandle < that.localHandle;
-    }
-
-    bool operator==(const FullHandle &that) const {
-        return moduleIndex == that.moduleIndex && localHandle == that.localHandle;
-    }
+/*
+ * Translates the local handles of one sub-module to global handles. Local handles are usually
+ * small and close together, so they index an array directly. A module that spreads its handles
+ * wider falls back to a sorted list.
+ */
+struct ModuleHandleTable {
+    int base; // smallest local handle
+    std::vector<int> dense; // global handle of local handle base + i, -1 if unused
+    std::vector<std::pair<int, int> > sparse; // sorted (local, global) pairs if dense is empty
 };
 
-std::map<int, FullHandle> global_to_full;
-std::map<FullHandle, int> full_to_global;
-int next_global_handle = 1;
+// Widest spread of local handles that is translated through an array.
+static const int MAX_DENSE_HANDLE_SPAN = 1024;
+
+/*
+ * Handle tables, built by lazy_init_sensors_list() and read-only afterwards.
+ * global_to_full is indexed by global handle; global handles are assigned from 1 without gaps.
+ * module_handle_tables is indexed by module index.
+ */
+static std::vector<FullHandle> global_to_full(1, FullHandle{-1, -1});
+static std::vector<ModuleHandleTable> module_handle_tables;
 
 static int assign_global_handle(int module_index, int local_handle) {
-    int global_handle = next_global_handle++;
+    int global_handle = (int) global_to_full.size();
     FullHandle full_handle;
     full_handle.moduleIndex = module_index;
     full_handle.localHandle = local_handle;
-    full_to_global[full_handle] = global_handle;
-    global_to_full[global_handle] = full_handle;
+    global_to_full.push_back(full_handle);
     return global_handle;
 }
 
+// Builds the table of a module from its (local handle, global handle) pairs.
+static void add_module_handle_table(std::vector<std::pair<int, int> > handles) {
+    ModuleHandleTable table;
+    table.base = 0;
+    std::sort(handles.begin(), handles.end());
+    if (!handles.empty()) {
+        int64_t span = (int64_t) handles.back().first - handles.front().first + 1;
+        if (span <= MAX_DENSE_HANDLE_SPAN) {
+            table.base = handles.front().first;
+            table.dense.assign(span, -1);
+            for (size_t i = 0; i < handles.size(); i++) {
+                table.dense[handles[i].first - table.base] = handles[i].second;
+            }
+        } else {
+            ALOGW("Module %zu local handles span %" PRId64 ", using sorted lookup",
+                    module_handle_tables.size(), span);
+            table.sparse = handles;
+        }
+    }
+    module_handle_tables.push_back(table);
+}
+
+static bool is_valid_global_handle(int global_handle) {
+    if (global_handle <= 0 || global_handle >= (int) global_to_full.size()) {
+        ALOGW("Unknown global_handle %d", global_handle);
+        return false;
+    }
+    return true;
+}
+
 // Returns the local handle, or -1 if it does not exist.
 static int get_local_handle(int global_handle) {
-    if (global_to_full.count(global_handle) == 0) {
-        ALOGW("Unknown global_handle %d", global_handle);
+    if (!is_valid_global_handle(global_handle)) {
         return -1;
     }
     return global_to_full[global_handle].localHandle;
@@ -110,26 +148,34 @@ static int get_local_handle(int global_handle) {
 // Returns the sub_hw_modules index of the module that contains the sensor associates with this
 // global_handle, or -1 if that global_handle does not exist.
 static int get_module_index(int global_handle) {
-    if (global_to_full.count(global_handle) == 0) {
-        ALOGW("Unknown global_handle %d", global_handle);
+    if (!is_valid_global_handle(global_handle)) {
         return -1;
     }
-    FullHandle f = global_to_full[global_handle];
+    const FullHandle& f = global_to_full[global_handle];
     ALOGV("FullHandle for global_handle %d: moduleIndex %d, localHandle %d",
             global_handle, f.moduleIndex, f.localHandle);
     return f.moduleIndex;
 }
 
-// Returns the global handle for this full_handle, or -1 if the full_handle is unknown.
-static int get_global_handle(FullHandle* full_handle) {
-    int global_handle = -1;
-    if (full_to_global.count(*full_handle)) {
-        global_handle = full_to_global[*full_handle];
-    } else {
-        ALOGW("Unknown FullHandle: moduleIndex %d, localHandle %d",
-            full_handle->moduleIndex, full_handle->localHandle);
+// Returns the global handle for this module's local handle, or -1 if it is unknown.
+static inline int get_global_handle(int module_index, int local_handle) {
+    if (module_index >= 0 && module_index < (int) module_handle_tables.size()) {
+        const ModuleHandleTable& table = module_handle_tables[module_index];
+        if (!table.dense.empty()) {
+            unsigned int i = (unsigned int) local_handle - (unsigned int) table.base;
+            if (i < table.dense.size() && table.dense[i] >= 0) {
+                return table.dense[i];
+            }
+        } else {
+            std::vector<std::pair<int, int> >::const_iterator it = std::lower_bound(
+                    table.sparse.begin(), table.sparse.end(), std::make_pair(local_handle, INT_MIN));
+            if (it != table.sparse.end() && it->first == local_handle) {
+                return it->second;
+            }
+        }
     }
-    return global_handle;
+    ALOGW("Unknown FullHandle: moduleIndex %d, localHandle %d", module_index, local_handle);
+    return -1;
 }
 
 static const int SENSOR_EVENT_QUEUE_CAPACITY = 36;
@@ -137,6 +183,12 @@ static const int SENSOR_EVENT_QUEUE_CAPACITY = 36;
 struct TaskContext {
   sensors_poll_device_t* device;
   SensorEventQueue* queue;
+  // Software batching of a sub-HAL below API 1.1, NULL for the others. It makes all the writes to
+  // the queue, the sub-HAL polls into buffer instead.
+  SoftBatcher* batcher;
+  sensors_event_t* buffer;
+  // Wakes the multihal poll() when it is parked waiting for data. Shared by all sub-HALs.
+  FutexSignal* dataAvailable;
 };
 
 void *writerTask(void* ptr) {
@@ -144,16 +196,19 @@ void *writerTask(void* ptr) {
     TaskContext* ctx = (TaskContext*)ptr;
     sensors_poll_device_t* device = ctx->device;
     SensorEventQueue* queue = ctx->queue;
+    SoftBatcher* batcher = ctx->batcher;
     sensors_event_t* buffer;
     int eventsPolled;
     while (1) {
-        pthread_mutex_lock(&queue_mutex);
-        if (queue->waitForSpace(&queue_mutex)) {
-            ALOGV("writerTask waited for space");
+        int bufferSize = SENSOR_EVENT_QUEUE_CAPACITY;
+        if (batcher != NULL) {
+            buffer = ctx->buffer;
+        } else {
+            if (queue->waitForSpace()) {
+                ALOGV("writerTask waited for space");
+            }
+            bufferSize = queue->getWritableRegion(SENSOR_EVENT_QUEUE_CAPACITY, &buffer);
         }
-        int bufferSize = queue->getWritableRegion(SENSOR_EVENT_QUEUE_CAPACITY, &buffer);
-        // Do blocking poll outside of lock
-        pthread_mutex_unlock(&queue_mutex);
 
         ALOGV("writerTask before poll() - bufferSize = %d", bufferSize);
         eventsPolled = device->poll(device, buffer, bufferSize);
@@ -165,14 +220,24 @@ void *writerTask(void* ptr) {
             }
             continue;
         }
-        pthread_mutex_lock(&queue_mutex);
-        queue->markAsWritten(eventsPolled);
-        ALOGV("writerTask wrote %d events", eventsPolled);
-        if (waiting_for_data) {
-            ALOGV("writerTask - broadcast data_available_cond");
-            pthread_cond_broadcast(&data_available_cond);
+        if (batcher != NULL) {
+            eventsPolled = batcher->process(buffer, eventsPolled);
+            // Published events the queue had no room for are kept pending. Wait for poll() to
+            // make room before polling the sub-HAL again, the lock is not held meanwhile.
+            while (batcher->getPendingCount() > 0) {
+                ctx->dataAvailable->wake();
+                queue->waitForSpace();
+                eventsPolled += batcher->drain();
+            }
+            if (eventsPolled == 0) {
+                // Everything was staged, nothing to wake up for.
+                continue;
+            }
+        } else {
+            queue->markAsWritten(eventsPolled);
         }
-        pthread_mutex_unlock(&queue_mutex);
+        ALOGV("writerTask wrote %d events", eventsPolled);
+        ctx->dataAvailable->wake();
     }
     // never actually returns
     return NULL;
@@ -207,14 +272,28 @@ struct sensors_poll_context_t {
 
     std::vector<hw_device_t*> sub_hw_devices;
     std::vector<SensorEventQueue*> queues;
+    // Software batching of each sub-HAL, parallel to queues. NULL from API 1.1.
+    std::vector<SoftBatcher*> batchers;
     std::vector<pthread_t> threads;
-    int nextReadIndex;
+    // Newest timestamp delivered from each queue, parallel to queues. Only used by poll().
+    std::vector<int64_t> lastTimestamps;
+    // Number of enabled sensors of each sub-HAL, parallel to queues.
+    std::deque<std::atomic<int>> activeCounts;
+    // Enabled global handles, protected by activeLock.
+    std::unordered_set<int> enabledHandles;
+    pthread_mutex_t activeLock;
+    FutexSignal dataAvailable;
+    int64_t maxMergeLatencyNs;
+
+    int readable_count();
+    void update_active_count(int handle, int enabled);
+    int merge_events(sensors_event_t* data, int maxReads, int* seen, int64_t* wait_ns);
 
     sensors_poll_device_t* get_v0_device_by_handle(int global_handle);
     sensors_poll_device_1_t* get_v1_device_by_handle(int global_handle);
     int get_device_version_by_handle(int global_handle);
 
-    void copy_event_remap_handle(sensors_event_t* src, sensors_event_t* dest, int sub_index);
+    int remap_event_handles(sensors_event_t* events, int count, int sub_index);
 };
 
 void sensors_poll_context_t::addSubHwDevice(struct hw_device_t* sub_hw_device) {
@@ -223,10 +302,21 @@ void sensors_poll_context_t::addSubHwDevice(struct hw_device_t* sub_hw_device) {
 
     SensorEventQueue *queue = new SensorEventQueue(SENSOR_EVENT_QUEUE_CAPACITY);
     this->queues.push_back(queue);
+    this->lastTimestamps.push_back(INT64_MIN);
+    this->activeCounts.emplace_back(0);
+    SoftBatcher *batcher = NULL;
+    if (sub_hw_device->version < SENSORS_DEVICE_API_VERSION_1_1) {
+        batcher = new SoftBatcher(queue);
+    }
+    this->batchers.push_back(batcher);
 
     TaskContext* taskContext = new TaskContext();
     taskContext->device = (sensors_poll_device_t*) sub_hw_device;
     taskContext->queue = queue;
+    taskContext->batcher = batcher;
+    taskContext->buffer = batcher != NULL ?
+            new sensors_event_t[SENSOR_EVENT_QUEUE_CAPACITY] : NULL;
+    taskContext->dataAvailable = &this->dataAvailable;
 
     pthread_t writerThread;
     pthread_create(&writerThread, NULL, writerTask, taskContext);
@@ -283,6 +373,14 @@ const char *apiNumToStr(int version) {
     }
 }
 
+// Returns true if the sensor can be batched by the multihal when its sub-HAL cannot: continuous
+// and non wake-up, so delaying its events does not change what the framework expects.
+static bool is_soft_batchable(int handle) {
+    const sensor_t& sensor = global_sensors_list[handle - 1];
+    return (sensor.flags & SENSOR_FLAG_WAKE_UP) == 0 &&
+            (sensor.flags & REPORTING_MODE_MASK) == SENSOR_FLAG_CONTINUOUS_MODE;
+}
+
 int sensors_poll_context_t::activate(int handle, int enabled) {
     int retval = -EINVAL;
     ALOGV("activate");
@@ -290,6 +388,12 @@ int sensors_poll_context_t::activate(int handle, int enabled) {
     sensors_poll_device_t* v0 = this->get_v0_device_by_handle(handle);
     if (local_handle >= 0 && v0) {
         retval = v0->activate(v0, local_handle, enabled);
+        if (retval == 0) {
+            this->update_active_count(handle, enabled);
+        }
+        if (!enabled && !halIsAPILevelCompliant(this, handle, SENSORS_DEVICE_API_VERSION_1_1)) {
+            this->batchers[get_module_index(handle)]->stop(local_handle);
+        }
     } else {
         ALOGE("IGNORING activate(enable %d) call to non-API-compliant sensor handle=%d !",
                 enabled, handle);
@@ -298,6 +402,19 @@ int sensors_poll_context_t::activate(int handle, int enabled) {
     return retval;
 }
 
+// Counts the sensors a sub-HAL has enabled, so that merge_events() does not wait for a sub-HAL
+// that cannot produce events.
+void sensors_poll_context_t::update_active_count(int handle, int enabled) {
+    pthread_mutex_lock(&this->activeLock);
+    bool changed = enabled ? this->enabledHandles.insert(handle).second :
+            this->enabledHandles.erase(handle) > 0;
+    if (changed) {
+        this->activeCounts[get_module_index(handle)].fetch_add(enabled ? 1 : -1,
+                std::memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&this->activeLock);
+}
+
 int sensors_poll_context_t::setDelay(int handle, int64_t ns) {
     int retval = -EINVAL;
     ALOGV("setDelay");
@@ -312,65 +429,159 @@ int sensors_poll_context_t::setDelay(int handle, int64_t ns) {
     return retval;
 }
 
-void sensors_poll_context_t::copy_event_remap_handle(sensors_event_t* dest, sensors_event_t* src,
+// Rewrites the handles of events copied from a sub-HAL in one pass, and drops events with a
+// handle that does not translate. Returns the number of events kept at the start of events.
+int sensors_poll_context_t::remap_event_handles(sensors_event_t* events, int count,
         int sub_index) {
-    memcpy(dest, src, sizeof(struct sensors_event_t));
-    // A normal event's "sensor" field is a local handle. Convert it to a global handle.
-    // A meta-data event must have its sensor set to 0, but it has a nested event
-    // with a local handle that needs to be converted to a global handle.
-    FullHandle full_handle;
-    full_handle.moduleIndex = sub_index;
-
-    // If it's a metadata event, rewrite the inner payload, not the sensor field.
-    // If the event's sensor field is unregistered for any reason, rewrite the sensor field
-    // with a -1, instead of writing an incorrect but plausible sensor number, because
-    // get_global_handle() returns -1 for unknown FullHandles.
-    if (dest->type == SENSOR_TYPE_META_DATA) {
-        full_handle.localHandle = dest->meta_data.sensor;
-        dest->meta_data.sensor = get_global_handle(&full_handle);
-    } else {
-        full_handle.localHandle = dest->sensor;
-        dest->sensor = get_global_handle(&full_handle);
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        sensors_event_t* event = &events[i];
+        // A normal event's "sensor" field is a local handle. Convert it to a global handle.
+        // A meta-data event must have its sensor set to 0, but it has a nested event
+        // with a local handle that needs to be converted to a global handle.
+        int* handle = (event->type == SENSOR_TYPE_META_DATA) ?
+                &event->meta_data.sensor : &event->sensor;
+        *handle = get_global_handle(sub_index, *handle);
+        if (*handle == -1) {
+            // Bad handle, do not pass corrupted event upstream !
+            ALOGW("Dropping bad local handle event packet on the floor");
+            continue;
+        }
+        if (kept != i) {
+            events[kept] = *event;
+        }
+        kept++;
+    }
+    return kept;
+}
+
+// Returns the number of events readable from all sub-HAL queues.
+int sensors_poll_context_t::readable_count() {
+    int count = 0;
+    for (size_t i = 0; i < this->queues.size(); i++) {
+        count += this->queues[i]->getSize();
+    }
+    return count;
+}
+
+/*
+ * Merges the queue heads into data by timestamp. Each step picks the queue with the oldest head
+ * and copies its run of events up to the oldest head of the other queues in one go.
+ *
+ * With a merge latency, an event is also held back while a queue that is empty has delivered
+ * nothing newer, in case that queue's next event is older. It is released once it is
+ * maxMergeLatencyNs old. Only the queues of sub-HALs with an enabled sensor that delivered an
+ * event within the merge latency are waited for, the others cannot hold anything back.
+ *
+ * Returns the number of events written. seen is set to the number of readable events found by
+ * the last scan of the queues, and wait_ns to how long until a held back event is released, or
+ * -1 if none is.
+ */
+int sensors_poll_context_t::merge_events(sensors_event_t* data, int maxReads, int* seen,
+        int64_t* wait_ns) {
+    int queueCount = (int) this->queues.size();
+    int eventsRead = 0;
+    int64_t now = 0;
+
+    if (this->maxMergeLatencyNs > 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_BOOTTIME, &ts);
+        now = ts.tv_sec * 1000000000LL + ts.tv_nsec;
     }
+    *wait_ns = -1;
+    while (eventsRead < maxReads) {
+        int oldest = -1;
+        int64_t oldestTimestamp = 0;
+        int64_t nextTimestamp = INT64_MAX;
+        int64_t idleTimestamp = INT64_MAX;
+        *seen = 0;
+        for (int i = 0; i < queueCount; i++) {
+            sensors_event_t* head;
+            int count = this->queues[i]->getSize();
+            if (count == 0) {
+                if (this->maxMergeLatencyNs <= 0) {
+                    continue;
+                }
+                if (this->activeCounts[i].load(std::memory_order_relaxed) == 0) {
+                    // Forget the last sensor's events, they say nothing about the next ones.
+                    this->lastTimestamps[i] = INT64_MIN;
+                } else if (this->lastTimestamps[i] >= now - this->maxMergeLatencyNs) {
+                    idleTimestamp = std::min(idleTimestamp, this->lastTimestamps[i]);
+                }
+                continue;
+            }
+            *seen += count;
+            this->queues[i]->getReadableRegion(&head);
+            if (oldest < 0 || head->timestamp < oldestTimestamp) {
+                if (oldest >= 0) {
+                    nextTimestamp = std::min(nextTimestamp, oldestTimestamp);
+                }
+                oldest = i;
+                oldestTimestamp = head->timestamp;
+            } else {
+                nextTimestamp = std::min(nextTimestamp, head->timestamp);
+            }
+        }
+        if (oldest < 0) {
+            break;
+        }
+
+        int64_t bound = nextTimestamp;
+        if (this->maxMergeLatencyNs > 0 && idleTimestamp < bound) {
+            int64_t released = std::max(idleTimestamp, now - this->maxMergeLatencyNs);
+            if (oldestTimestamp > released) {
+                *wait_ns = oldestTimestamp - released;
+                break;
+            }
+            bound = std::min(bound, released);
+        }
+
+        sensors_event_t* events;
+        int count = std::min(this->queues[oldest]->getReadableRegion(&events),
+                maxReads - eventsRead);
+        int run = 1;
+        while (run < count && events[run].timestamp <= bound) {
+            run++;
+        }
+        // Copy the run out in one go and free the slots for the writer before remapping.
+        memcpy(&data[eventsRead], events, run * sizeof(sensors_event_t));
+        this->queues[oldest]->dequeue(run);
+        for (int i = 0; i < run; i++) {
+            this->lastTimestamps[oldest] =
+                    std::max(this->lastTimestamps[oldest], data[eventsRead + i].timestamp);
+        }
+        eventsRead += this->remap_event_handles(&data[eventsRead], run, oldest);
+    }
+    return eventsRead;
 }
 
 int sensors_poll_context_t::poll(sensors_event_t *data, int maxReads) {
     ALOGV("poll");
-    int empties = 0;
-    int queueCount = 0;
     int eventsRead = 0;
 
-    pthread_mutex_lock(&queue_mutex);
-    queueCount = (int)this->queues.size();
     while (eventsRead == 0) {
-        while (empties < queueCount && eventsRead < maxReads) {
-            SensorEventQueue* queue = this->queues.at(this->nextReadIndex);
-            sensors_event_t* event = queue->peek();
-            if (event == NULL) {
-                empties++;
-            } else {
-                empties = 0;
-                this->copy_event_remap_handle(&data[eventsRead], event, nextReadIndex);
-                if (data[eventsRead].sensor == -1) {
-                    // Bad handle, do not pass corrupted event upstream !
-                    ALOGW("Dropping bad local handle event packet on the floor");
-                } else {
-                    eventsRead++;
-                }
-                queue->dequeue();
+        int seen = 0;
+        int64_t wait_ns = -1;
+        // Events flushed while their queue was full are left for whoever makes room, which is
+        // this thread if the sub-HAL's writer is blocked in the sub-HAL.
+        for (size_t i = 0; i < this->batchers.size(); i++) {
+            if (this->batchers[i] != NULL) {
+                this->batchers[i]->drain();
             }
-            this->nextReadIndex = (this->nextReadIndex + 1) % queueCount;
         }
+        eventsRead = this->merge_events(data, maxReads, &seen, &wait_ns);
         if (eventsRead == 0) {
-            // The queues have been scanned and none contain data, so wait.
-            ALOGV("poll stopping to wait for data");
-            waiting_for_data = true;
-            pthread_cond_wait(&data_available_cond, &queue_mutex);
-            waiting_for_data = false;
-            empties = 0;
+            // Nothing could be delivered, so wait. Check again after registering as a waiter,
+            // a writer may have published events since the queues were scanned.
+            int token = this->dataAvailable.prepareWait();
+            if (this->readable_count() != seen) {
+                this->dataAvailable.cancelWait();
+            } else {
+                ALOGV("poll stopping to wait for data, timeout %" PRId64, wait_ns);
+                this->dataAvailable.wait(token, wait_ns);
+            }
         }
     }
-    pthread_mutex_unlock(&queue_mutex);
     ALOGV("poll returning %d events.", eventsRead);
 
     return eventsRead;
@@ -394,22 +605,33 @@ int sensors_poll_context_t::batch(int handle, int flags, int64_t period_ns, int6
                 return -EINVAL;
             }
 
+            // A non-zero timeout is batched in software, when the sensor allows it.
+            bool soft_batchable = is_soft_batchable(handle);
+            if (flags & SENSORS_BATCH_DRY_RUN) {
+                return (timeout == 0 || soft_batchable) ? 0 : -EINVAL;
+            }
+
             // The HAL should silently clamp period_ns. Here it is assumed
             // that maxDelay and minDelay are set properly
-            int sub_index = get_module_index(handle);
-            int maxDelay = global_sensors_list[sub_index].maxDelay;
-            int minDelay = global_sensors_list[sub_index].minDelay;
+            const sensor_t& sensor = global_sensors_list[handle - 1];
+            int64_t minDelay = (int64_t) sensor.minDelay * 1000;
+            int64_t maxDelay = (int64_t) sensor.maxDelay * 1000;
             if (period_ns < minDelay) {
                 period_ns = minDelay;
-            } else if (period_ns > maxDelay) {
+            } else if (maxDelay > 0 && period_ns > maxDelay) {
                 period_ns = maxDelay;
             }
 
-            retval = v1->setDelay((sensors_poll_device_t*)v1, handle, period_ns);
+            retval = v1->setDelay((sensors_poll_device_t*)v1, local_handle, period_ns);
 
             // Batch should only fail for internal errors
             if (retval < 0) {
                 ALOGE("setDelay() returned %d", retval);
+            } else if (soft_batchable) {
+                this->batchers[get_module_index(handle)]->batch(local_handle, period_ns,
+                        timeout);
+            } else if (timeout > 0) {
+                retval = -EINVAL;
             }
         }
     } else {
@@ -428,10 +650,18 @@ int sensors_poll_context_t::flush(int handle) {
         if (halIsAPILevelCompliant(this, handle, SENSORS_DEVICE_API_VERSION_1_1)) {
             retval = v1->flush(v1, local_handle);
         } else {
-            // FIXME: for now sensorservice allows -EINVAL as return value
-            // for non-oneshot sensors. This may change in future and flush()
-            // will need to generate META_DATA_FLUSH_COMPLETE events.
-            retval = -EINVAL;
+            // Only sensors batched in software have a FIFO to flush. For the others
+            // sensorservice allows -EINVAL as return value for non-oneshot sensors.
+            int written = this->batchers[get_module_index(handle)]->flush(local_handle);
+            if (written >= 0) {
+                // The sub-HAL may have nothing else to return, deliver the flush now.
+                if (written > 0) {
+                    this->dataAvailable.wake();
+                }
+                retval = 0;
+            } else {
+                retval = -EINVAL;
+            }
         }
     } else {
         ALOGE("IGNORING flush() call to non-API-compliant sensor handle=%d !", handle);
@@ -467,6 +697,7 @@ int sensors_poll_context_t::close() {
         int retval = dev->close(dev);
         ALOGV("retval %d", retval);
     }
+    pthread_mutex_destroy(&this->activeLock);
     return 0;
 }
 
@@ -532,8 +763,12 @@ static bool starts_with(const char* s, const char* prefix) {
  * The vector must not be null.
  */
 static void get_so_paths(std::vector<std::string> *so_paths) {
-    const std::vector<const char *> config_path_list(
+    std::vector<const char *> config_path_list(
             { MULTI_HAL_CONFIG_FILE_PATH, DEPRECATED_MULTI_HAL_CONFIG_FILE_PATH });
+    const char *override_path = getenv(MULTI_HAL_CONFIG_FILE_ENV);
+    if (override_path != NULL) {
+        config_path_list.assign(1, override_path);
+    }
 
     std::ifstream stream;
     const char *path = nullptr;
@@ -563,6 +798,72 @@ static void get_so_paths(std::vector<std::string> *so_paths) {
     }
 }
 
+/*
+ * Runs task on its own thread for each element of args, and waits for all of them.
+ * Sub-HALs do not depend on each other, and some are slow to load or open.
+ */
+template <typename T>
+static void run_concurrently(std::vector<T>& args, void* (*task)(void*)) {
+    std::vector<pthread_t> threads(args.size());
+    std::vector<bool> started(args.size(), false);
+    for (size_t i = 0; i < args.size(); i++) {
+        // The last one runs on this thread, which would only wait otherwise.
+        if (i + 1 < args.size()) {
+            started[i] = pthread_create(&threads[i], NULL, task, &args[i]) == 0;
+        }
+        if (!started[i]) {
+            task(&args[i]);
+        }
+    }
+    for (size_t i = 0; i < args.size(); i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+struct SubHalLoad {
+    std::string path;
+    hw_module_t* module; // NULL if the library could not be loaded
+    const sensor_t* sensors;
+    int sensorCount;
+};
+
+// dlopens one sub-HAL library and reads its module symbol and sensor list.
+static void* load_sub_hal(void* ptr) {
+    SubHalLoad* load = (SubHalLoad*) ptr;
+    const char* path = load->path.c_str();
+    const char* sym = HAL_MODULE_INFO_SYM_AS_STR;
+    load->module = NULL;
+    dlerror(); // clear any old errors
+    void* lib_handle = dlopen(path, RTLD_LAZY);
+    if (lib_handle == NULL) {
+        ALOGW("dlerror(): %s", dlerror());
+        return NULL;
+    }
+    ALOGI("Loaded library from %s", path);
+    ALOGV("Opening symbol \"%s\"", sym);
+    // clear old errors
+    dlerror();
+    struct hw_module_t* module = (hw_module_t*) dlsym(lib_handle, sym);
+    const char* error;
+    if ((error = dlerror()) != NULL) {
+        ALOGW("Error calling dlsym: %s", error);
+    } else if (module == NULL) {
+        ALOGW("module == NULL");
+    } else {
+        ALOGV("Loaded symbols from \"%s\"", sym);
+        struct sensors_module_t *sensors_module = (struct sensors_module_t*) module;
+        load->sensorCount = sensors_module->get_sensors_list(sensors_module, &load->sensors);
+        if (load->sensorCount < 0) {
+            load->sensorCount = 0;
+        }
+        ALOGV("%s has %d sensors", path, load->sensorCount);
+        load->module = module;
+    }
+    return NULL;
+}
+
 /*
  * Ensures that the sub-module array is initialized.
  * This can be first called from get_sensors_list or from open_sensors.
@@ -576,30 +877,22 @@ static void lazy_init_modules() {
     std::vector<std::string> *so_paths = new std::vector<std::string>();
     get_so_paths(so_paths);
 
-    // dlopen the module files and cache their module symbols in sub_hw_modules
+    // dlopen the module files concurrently. Modules keep the order of the config file, as it
+    // decides the module indexes and so the global handles.
+    std::vector<SubHalLoad> loads(so_paths->size());
+    for (size_t i = 0; i < so_paths->size(); i++) {
+        loads[i].path = so_paths->at(i);
+    }
+    delete so_paths;
+    run_concurrently(loads, load_sub_hal);
+
+    // cache the module symbols in sub_hw_modules, and their sensors in sub_hw_sensors
     sub_hw_modules = new std::vector<hw_module_t *>();
-    dlerror(); // clear any old errors
-    const char* sym = HAL_MODULE_INFO_SYM_AS_STR;
-    for (std::vector<std::string>::iterator it = so_paths->begin(); it != so_paths->end(); it++) {
-        const char* path = it->c_str();
-        void* lib_handle = dlopen(path, RTLD_LAZY);
-        if (lib_handle == NULL) {
-            ALOGW("dlerror(): %s", dlerror());
-        } else {
-            ALOGI("Loaded library from %s", path);
-            ALOGV("Opening symbol \"%s\"", sym);
-            // clear old errors
-            dlerror();
-            struct hw_module_t* module = (hw_module_t*) dlsym(lib_handle, sym);
-            const char* error;
-            if ((error = dlerror()) != NULL) {
-                ALOGW("Error calling dlsym: %s", error);
-            } else if (module == NULL) {
-                ALOGW("module == NULL");
-            } else {
-                ALOGV("Loaded symbols from \"%s\"", sym);
-                sub_hw_modules->push_back(module);
-            }
+    sub_hw_sensors = new std::vector<std::pair<const sensor_t*, int> >();
+    for (size_t i = 0; i < loads.size(); i++) {
+        if (loads[i].module != NULL) {
+            sub_hw_modules->push_back(loads[i].module);
+            sub_hw_sensors->push_back(std::make_pair(loads[i].sensors, loads[i].sensorCount));
         }
     }
     pthread_mutex_unlock(&init_modules_mutex);
@@ -619,6 +912,14 @@ static void fix_sensor_flags(int version, sensor_t& sensor) {
             sensor.flags = new_flags;
         }
     }
+    if (version < SENSORS_DEVICE_API_VERSION_1_1) {
+        // Advertise the software FIFO, sensorservice does not batch a sensor without one.
+        if ((sensor.flags & SENSOR_FLAG_WAKE_UP) == 0 &&
+                (sensor.flags & REPORTING_MODE_MASK) == SENSOR_FLAG_CONTINUOUS_MODE &&
+                sensor.fifoMaxEventCount == 0) {
+            sensor.fifoMaxEventCount = SOFT_BATCH_MAX_EVENTS;
+        }
+    }
 }
 
 /*
@@ -637,15 +938,14 @@ static void lazy_init_sensors_list() {
     ALOGV("lazy_init_sensors_list needs to do work");
     lazy_init_modules();
 
-    // Count all the sensors, then allocate an array of blanks.
+    // Count all the sensors from the lists cached at load time, then allocate an array of blanks.
     global_sensors_count = 0;
-    const struct sensor_t *subhal_sensors_list;
-    for (std::vector<hw_module_t*>::iterator it = sub_hw_modules->begin();
-            it != sub_hw_modules->end(); it++) {
-        struct sensors_module_t *module = (struct sensors_module_t*) *it;
-        global_sensors_count += module->get_sensors_list(module, &subhal_sensors_list);
-        ALOGV("increased global_sensors_count to %d", global_sensors_count);
+    for (size_t i = 0; i < sub_hw_sensors->size(); i++) {
+        global_sensors_count += sub_hw_sensors->at(i).second;
     }
+    ALOGV("global_sensors_count is %d", global_sensors_count);
+    global_to_full.reserve(global_sensors_count + 1);
+    module_handle_tables.reserve(sub_hw_modules->size());
 
     // The global_sensors_list is full of consts.
     // Manipulate this non-const list, and point the const one to it when we're done.
@@ -657,12 +957,12 @@ static void lazy_init_sensors_list() {
 
     for (std::vector<hw_module_t*>::iterator it = sub_hw_modules->begin();
             it != sub_hw_modules->end(); it++) {
-        hw_module_t *hw_module = *it;
         ALOGV("examine one module");
-        // Read the sub-module's sensor list.
-        struct sensors_module_t *module = (struct sensors_module_t*) hw_module;
-        int module_sensor_count = module->get_sensors_list(module, &subhal_sensors_list);
+        const struct sensor_t *subhal_sensors_list = sub_hw_sensors->at(module_index).first;
+        int module_sensor_count = sub_hw_sensors->at(module_index).second;
         ALOGV("the module has %d sensors", module_sensor_count);
+        std::vector<std::pair<int, int> > module_handles;
+        module_handles.reserve(module_sensor_count);
 
         // Copy the HAL's sensor list into global_sensors_list,
         // with the handle changed to be a global handle.
@@ -675,6 +975,7 @@ static void lazy_init_sensors_list() {
 
             // Overwrite the global version's handle with a global handle.
             int global_handle = assign_global_handle(module_index, local_handle);
+            module_handles.push_back(std::make_pair(local_handle, global_handle));
 
             mutable_sensor_list[mutable_sensor_index].handle = global_handle;
             ALOGV("module_index %d, local_handle %d, global_handle %d",
@@ -685,6 +986,7 @@ static void lazy_init_sensors_list() {
 
             mutable_sensor_index++;
         }
+        add_module_handle_table(module_handles);
         module_index++;
     }
     // Set the const static global_sensors_list to the mutable one allocated by this function.
@@ -732,6 +1034,21 @@ struct sensors_module_t *get_multi_hal_module_info() {
     return (&HAL_MODULE_INFO_SYM);
 }
 
+struct SubHalOpen {
+    hw_module_t* module;
+    const char* name;
+    struct hw_device_t* device;
+    int result;
+};
+
+// Opens the device of one sub-HAL.
+static void* open_sub_hal(void* ptr) {
+    SubHalOpen* open = (SubHalOpen*) ptr;
+    open->device = NULL;
+    open->result = open->module->methods->open(open->module, open->name, &open->device);
+    return NULL;
+}
+
 static int open_sensors(const struct hw_module_t* hw_module, const char* name,
         struct hw_device_t** hw_device_out) {
     ALOGV("open_sensors begin...");
@@ -752,20 +1069,25 @@ static int open_sensors(const struct hw_module_t* hw_module, const char* name,
     dev->proxy_device.flush = device__flush;
     dev->proxy_device.inject_sensor_data = device__inject_sensor_data;
 
-    dev->nextReadIndex = 0;
+    dev->maxMergeLatencyNs = property_get_int64(MULTI_HAL_MERGE_LATENCY_PROPERTY, 0) * 1000;
+    pthread_mutex_init(&dev->activeLock, NULL);
 
     sub_hw_versions = new std::unordered_map<hw_module_t *, int>();
-    // Open() the subhal modules. Remember their devices in a vector parallel to sub_hw_modules.
-    for (std::vector<hw_module_t*>::iterator it = sub_hw_modules->begin();
-            it != sub_hw_modules->end(); it++) {
-        sensors_module_t *sensors_module = (sensors_module_t*) *it;
-        struct hw_device_t* sub_hw_device;
-        int sub_open_result = sensors_module->common.methods->open(*it, name, &sub_hw_device);
-        if (!sub_open_result) {
+    // Open() the subhal modules concurrently, then remember their devices in a vector parallel
+    // to sub_hw_modules.
+    std::vector<SubHalOpen> opens(sub_hw_modules->size());
+    for (size_t i = 0; i < opens.size(); i++) {
+        opens[i].module = sub_hw_modules->at(i);
+        opens[i].name = name;
+    }
+    run_concurrently(opens, open_sub_hal);
+    for (size_t i = 0; i < opens.size(); i++) {
+        if (!opens[i].result) {
+            struct hw_device_t* sub_hw_device = opens[i].device;
             ALOGV("This HAL reports API level : %s",
                     apiNumToStr(sub_hw_device->version));
             dev->addSubHwDevice(sub_hw_device);
-            sub_hw_versions->insert(std::make_pair(*it, sub_hw_device->version));
+            sub_hw_versions->insert(std::make_pair(opens[i].module, sub_hw_device->version));
         }
     }
 
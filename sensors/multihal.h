@@ -24,6 +24,14 @@ static const char* MULTI_HAL_CONFIG_FILE_PATH = "/vendor/etc/sensors/_hals.conf"
 // Depracated because system partition HAL config file does not satisfy treble requirements.
 static const char* DEPRECATED_MULTI_HAL_CONFIG_FILE_PATH = "/system/etc/sensors/_hals.conf";
 
+// Environment variable naming a config file to read instead of the ones above, so that the
+// multihal can be run with test sub-HALs, e.g. by multihal_bench.
+static const char* MULTI_HAL_CONFIG_FILE_ENV = "MULTI_HAL_CONFIG_FILE";
+
+// How long poll() may hold back events so that events of other sub-HALs with older timestamps
+// can be delivered first, in microseconds. 0, the default, only orders the events at hand.
+static const char* MULTI_HAL_MERGE_LATENCY_PROPERTY = "persist.vendor.sensors.merge_latency_us";
+
 struct sensors_module_t *get_multi_hal_module_info(void);
 
 #endif // HARDWARE_LIBHARDWARE_MODULES_SENSORS_MULTIHAL_H_
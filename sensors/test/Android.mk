@@ -0,0 +1,51 @@
+#
+# Copyright (C) 2016 The Android Open-Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+LOCAL_PATH := $(call my-dir)
+
+# Synthetic sub-HAL, listed in a multihal config to measure the multihal without sensors.
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors.fake
+LOCAL_MODULE_TAGS := optional
+LOCAL_PROPRIETARY_MODULE := true
+
+LOCAL_CFLAGS := -DLOG_TAG=\"FakeSensors\"
+
+LOCAL_SRC_FILES := \
+    FakeSensorsHal.cpp \
+
+LOCAL_SHARED_LIBRARIES := \
+    libdl \
+    liblog \
+
+include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := multihal_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_PROPRIETARY_MODULE := true
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+
+LOCAL_SRC_FILES := \
+    multihal_bench.cpp \
+
+LOCAL_SHARED_LIBRARIES := \
+    libdl \
+
+include $(BUILD_EXECUTABLE)
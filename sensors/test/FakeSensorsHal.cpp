@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FakeSensorsHal.h"
+
+#include <hardware/sensors.h>
+#include <cutils/log.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+struct FakeSensor {
+    int handle;
+    int type;
+    int64_t minPeriodNs;
+    int jitterUs;
+    std::string name;
+    // Below only used while holding fake_device_t::lock.
+    bool active;
+    bool flushPending;
+    int64_t periodNs;
+    int64_t nextNs; // CLOCK_MONOTONIC time of the next sample
+};
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static int device_version = SENSORS_DEVICE_API_VERSION_1_3;
+static std::vector<FakeSensor> fake_sensors;
+static std::vector<sensor_t> fake_sensors_list;
+
+static int64_t now_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void add_fake_sensor(int handle, int type, double rate_hz, int jitter_us) {
+    FakeSensor sensor;
+    sensor.handle = handle;
+    sensor.type = type;
+    sensor.minPeriodNs = (int64_t) (1e9 / rate_hz);
+    sensor.jitterUs = jitter_us;
+    sensor.name = "Fake sensor " + std::to_string(handle);
+    sensor.active = false;
+    sensor.flushPending = false;
+    sensor.periodNs = sensor.minPeriodNs;
+    sensor.nextNs = 0;
+    fake_sensors.push_back(sensor);
+}
+
+/*
+ * Reads the config file next to this library, see FakeSensorsHal.h.
+ */
+static void load_config() {
+    Dl_info info;
+    std::string path;
+    if (dladdr((void*) &load_config, &info) && info.dli_fname != NULL) {
+        path = std::string(info.dli_fname) + FAKE_SENSORS_CONFIG_SUFFIX;
+    }
+
+    std::ifstream stream(path.c_str());
+    std::string line;
+    while (stream && std::getline(stream, line)) {
+        std::istringstream words(line);
+        std::string key;
+        if (!(words >> key) || key[0] == '#') {
+            continue;
+        }
+        if (key == "version") {
+            int major, minor;
+            char dot;
+            if (words >> major >> dot >> minor) {
+                device_version = HARDWARE_DEVICE_API_VERSION(major, minor);
+                continue;
+            }
+        } else if (key == "sensor") {
+            int handle, type;
+            double rate_hz;
+            int jitter_us = 0;
+            if (words >> handle >> type >> rate_hz && handle > 0 && rate_hz > 0) {
+                words >> jitter_us;
+                add_fake_sensor(handle, type, rate_hz, std::max(jitter_us, 0));
+                continue;
+            }
+        }
+        ALOGW("Ignoring line '%s' of %s", line.c_str(), path.c_str());
+    }
+    if (fake_sensors.empty()) {
+        ALOGV("No sensor in '%s', using the default one", path.c_str());
+        add_fake_sensor(1, SENSOR_TYPE_ACCELEROMETER, 200, 0);
+    }
+
+    // Names are only pointed to once fake_sensors does not grow anymore.
+    for (size_t i = 0; i < fake_sensors.size(); i++) {
+        const FakeSensor& fake = fake_sensors[i];
+        sensor_t sensor;
+        memset(&sensor, 0, sizeof(sensor));
+        sensor.name = fake.name.c_str();
+        sensor.vendor = "AOSP";
+        sensor.version = 1;
+        sensor.handle = fake.handle;
+        sensor.type = fake.type;
+        sensor.maxRange = 1000.0f;
+        sensor.resolution = 0.001f;
+        sensor.power = 0.1f;
+        sensor.minDelay = (int32_t) (fake.minPeriodNs / 1000);
+        sensor.maxDelay = 1000000;
+        sensor.flags = SENSOR_FLAG_CONTINUOUS_MODE;
+        fake_sensors_list.push_back(sensor);
+    }
+    ALOGI("Fake sensors HAL: %zu sensors, API %x", fake_sensors.size(), device_version);
+}
+
+struct fake_device_t {
+    sensors_poll_device_1 device; // must be first
+    pthread_mutex_t lock;
+    pthread_cond_t changed; // on CLOCK_MONOTONIC
+};
+
+static FakeSensor* find_fake_sensor(int handle) {
+    for (size_t i = 0; i < fake_sensors.size(); i++) {
+        if (fake_sensors[i].handle == handle) {
+            return &fake_sensors[i];
+        }
+    }
+    return NULL;
+}
+
+static int fake__activate(struct sensors_poll_device_t *dev, int handle, int enabled) {
+    fake_device_t* fake = (fake_device_t*) dev;
+    FakeSensor* sensor = find_fake_sensor(handle);
+    if (sensor == NULL) {
+        return -EINVAL;
+    }
+    pthread_mutex_lock(&fake->lock);
+    if (enabled && !sensor->active) {
+        sensor->nextNs = now_ns(CLOCK_MONOTONIC) + sensor->periodNs;
+    }
+    sensor->active = enabled != 0;
+    pthread_cond_signal(&fake->changed);
+    pthread_mutex_unlock(&fake->lock);
+    return 0;
+}
+
+static int fake__setDelay(struct sensors_poll_device_t *dev, int handle, int64_t ns) {
+    fake_device_t* fake = (fake_device_t*) dev;
+    FakeSensor* sensor = find_fake_sensor(handle);
+    if (sensor == NULL) {
+        return -EINVAL;
+    }
+    pthread_mutex_lock(&fake->lock);
+    sensor->periodNs = std::max(ns, sensor->minPeriodNs);
+    if (sensor->active) {
+        sensor->nextNs = std::min(sensor->nextNs, now_ns(CLOCK_MONOTONIC) + sensor->periodNs);
+    }
+    pthread_cond_signal(&fake->changed);
+    pthread_mutex_unlock(&fake->lock);
+    return 0;
+}
+
+static int fake__batch(struct sensors_poll_device_1 *dev, int handle, int flags,
+        int64_t period_ns, int64_t timeout) {
+    // There is no FIFO, fifoMaxEventCount is 0 so the timeout is always 0.
+    if (flags & SENSORS_BATCH_DRY_RUN) {
+        return find_fake_sensor(handle) != NULL && timeout == 0 ? 0 : -EINVAL;
+    }
+    return fake__setDelay((sensors_poll_device_t*) dev, handle, period_ns);
+}
+
+static int fake__flush(struct sensors_poll_device_1 *dev, int handle) {
+    fake_device_t* fake = (fake_device_t*) dev;
+    FakeSensor* sensor = find_fake_sensor(handle);
+    if (sensor == NULL) {
+        return -EINVAL;
+    }
+    pthread_mutex_lock(&fake->lock);
+    int retval = -EINVAL;
+    if (sensor->active) {
+        sensor->flushPending = true;
+        pthread_cond_signal(&fake->changed);
+        retval = 0;
+    }
+    pthread_mutex_unlock(&fake->lock);
+    return retval;
+}
+
+/*
+ * Blocks until a sample of an active sensor is due, then returns all the due samples. A sensor
+ * that fell behind, e.g. because the multihal queue was full, skips the samples it missed.
+ */
+static int fake__poll(struct sensors_poll_device_t *dev, sensors_event_t* data, int count) {
+    fake_device_t* fake = (fake_device_t*) dev;
+    int written = 0;
+    int jitter_us = 0;
+
+    pthread_mutex_lock(&fake->lock);
+    while (written == 0) {
+        int64_t now = now_ns(CLOCK_MONOTONIC);
+        int64_t boot_offset = now_ns(CLOCK_BOOTTIME) - now;
+        int64_t next = INT64_MAX;
+        for (size_t i = 0; i < fake_sensors.size() && written < count; i++) {
+            FakeSensor* sensor = &fake_sensors[i];
+            if (sensor->flushPending) {
+                sensors_event_t* event = &data[written++];
+                memset(event, 0, sizeof(*event));
+                event->version = META_DATA_VERSION;
+                event->type = SENSOR_TYPE_META_DATA;
+                event->meta_data.what = META_DATA_FLUSH_COMPLETE;
+                event->meta_data.sensor = sensor->handle;
+                sensor->flushPending = false;
+            }
+            if (!sensor->active) {
+                continue;
+            }
+            if (now - sensor->nextNs > 16 * sensor->periodNs) {
+                sensor->nextNs = now;
+            }
+            while (sensor->nextNs <= now && written < count) {
+                sensors_event_t* event = &data[written++];
+                memset(event, 0, sizeof(*event));
+                event->version = sizeof(sensors_event_t);
+                event->sensor = sensor->handle;
+                event->type = sensor->type;
+                event->timestamp = sensor->nextNs + boot_offset;
+                event->data[0] = (float) (sensor->nextNs % 1000000) / 1000000.0f;
+                sensor->nextNs += sensor->periodNs;
+                jitter_us = std::max(jitter_us, sensor->jitterUs);
+            }
+            next = std::min(next, sensor->nextNs);
+        }
+        if (written > 0) {
+            break;
+        }
+        if (next == INT64_MAX) {
+            pthread_cond_wait(&fake->changed, &fake->lock);
+        } else {
+            struct timespec deadline;
+            deadline.tv_sec = next / 1000000000LL;
+            deadline.tv_nsec = next % 1000000000LL;
+            pthread_cond_timedwait(&fake->changed, &fake->lock, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&fake->lock);
+
+    if (jitter_us > 0) {
+        usleep(rand() % (jitter_us + 1));
+    }
+    int64_t enqueue_time = now_ns(CLOCK_BOOTTIME);
+    for (int i = 0; i < written; i++) {
+        if (data[i].type != SENSOR_TYPE_META_DATA) {
+            data[i].u64.data[FAKE_SENSORS_ENQUEUE_TIME_INDEX] = enqueue_time;
+        }
+    }
+    return written;
+}
+
+static int fake__close(struct hw_device_t *dev) {
+    fake_device_t* fake = (fake_device_t*) dev;
+    pthread_cond_destroy(&fake->changed);
+    pthread_mutex_destroy(&fake->lock);
+    delete fake;
+    return 0;
+}
+
+static int fake__get_sensors_list(struct sensors_module_t* module,
+        struct sensor_t const** list) {
+    pthread_once(&init_once, load_config);
+    *list = fake_sensors_list.data();
+    return (int) fake_sensors_list.size();
+}
+
+static int open_fake_sensors(const struct hw_module_t* module, const char* name,
+        struct hw_device_t** device) {
+    pthread_once(&init_once, load_config);
+
+    fake_device_t* fake = new fake_device_t();
+    memset(&fake->device, 0, sizeof(fake->device));
+    pthread_mutex_init(&fake->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&fake->changed, &attr);
+    pthread_condattr_destroy(&attr);
+
+    fake->device.common.tag = HARDWARE_DEVICE_TAG;
+    fake->device.common.version = device_version;
+    fake->device.common.module = const_cast<hw_module_t*>(module);
+    fake->device.common.close = fake__close;
+    fake->device.activate = fake__activate;
+    fake->device.setDelay = fake__setDelay;
+    fake->device.poll = fake__poll;
+    if (device_version >= SENSORS_DEVICE_API_VERSION_1_1) {
+        fake->device.batch = fake__batch;
+        fake->device.flush = fake__flush;
+    }
+
+    *device = &fake->device.common;
+    return 0;
+}
+
+static struct hw_module_methods_t fake_sensors_module_methods = {
+    .open = open_fake_sensors
+};
+
+struct sensors_module_t HAL_MODULE_INFO_SYM = {
+    .common = {
+        .tag = HARDWARE_MODULE_TAG,
+        .version_major = 1,
+        .version_minor = 0,
+        .id = SENSORS_HARDWARE_MODULE_ID,
+        .name = "Fake Sensor Module",
+        .author = "The Android Open Source Project",
+        .methods = &fake_sensors_module_methods,
+        .dso = NULL,
+        .reserved = {0},
+    },
+    .get_sensors_list = fake__get_sensors_list
+};
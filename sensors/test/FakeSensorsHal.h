@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FAKE_SENSORS_HAL_H_
+#define FAKE_SENSORS_HAL_H_
+
+/*
+ * A synthetic sensors HAL to load as a multihal sub-HAL, for measuring the multihal without
+ * sensor hardware.
+ *
+ * The module reads its config from a file named like the library plus ".conf", e.g.
+ * /data/local/tmp/sensors.fake.so.conf. Copies of the library under other names make several
+ * sub-HALs with their own config. Lines are:
+ *
+ *   # comment
+ *   version <major>.<minor>                    API version of the device, 1.3 by default
+ *   sensor <handle> <type> <rate_hz> [jitter_us]
+ *
+ * A sensor samples at the requested period, bounded by its rate, and poll() returns after up to
+ * jitter_us of random delay. Without a config file the module has an accelerometer at 200Hz.
+ */
+
+// Index in u64.data of the CLOCK_BOOTTIME time at which poll() returned the event to the
+// multihal, i.e. when it was enqueued.
+static const int FAKE_SENSORS_ENQUEUE_TIME_INDEX = 7;
+
+static const char* FAKE_SENSORS_CONFIG_SUFFIX = ".conf";
+
+#endif // FAKE_SENSORS_HAL_H_
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Opens the multihal like sensorservice does, activates its sensors and measures how events
+ * flow through it: events/s, poll() wakeups, the latency from a sub-HAL returning an event to
+ * the multihal poll() returning it, and the context switches of the process.
+ *
+ * The enqueue latency needs sub-HALs that stamp their events, like sensors.fake. For example,
+ * with two fake sub-HALs:
+ *
+ *   echo /data/local/tmp/sensors.fake.so > /data/local/tmp/hals.conf
+ *   echo /data/local/tmp/sensors.fake2.so >> /data/local/tmp/hals.conf
+ *   printf 'version 1.0\nsensor 1 1 200 500\n' > /data/local/tmp/sensors.fake2.so.conf
+ *   multihal_bench -c /data/local/tmp/hals.conf -d 10
+ *
+ * poll() not returning for the stall timeout fails the run. To check software batching with
+ * FIFOs larger than the multihal queue, and flush complete events of a sub-HAL left without
+ * active sensors, batch a fast sensor of a 1.0 sub-HAL and flush it at the end:
+ *
+ *   printf 'version 1.0\nsensor 1 1 500\n' > /data/local/tmp/sensors.fake.so.conf
+ *   multihal_bench -c /data/local/tmp/hals.conf -s 1 -b 1000 -f
+ */
+
+#include "FakeSensorsHal.h"
+#include "multihal.h"
+
+#include <hardware/sensors.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char* DEFAULT_MULTI_HAL_PATH = "/vendor/lib/hw/sensors.msm8960.so";
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// CLOCK_BOOTTIME time poll() last returned, watched by stallWatchdog().
+static std::atomic<int64_t> last_poll_ns(0);
+static int64_t stall_timeout_ns;
+
+static void* stallWatchdog(void*) {
+    while (1) {
+        sleep(1);
+        int64_t stalled_ns = now_ns() - last_poll_ns.load();
+        if (stalled_ns > stall_timeout_ns) {
+            fprintf(stderr, "FAIL: poll() did not return for %" PRId64 " ms\n",
+                    stalled_ns / 1000000);
+            _exit(2);
+        }
+    }
+    return NULL;
+}
+
+static int poll_device(sensors_poll_device_1_t* device, sensors_event_t* buffer, int size) {
+    int n = device->poll(&device->v0, buffer, size);
+    last_poll_ns.store(now_ns());
+    return n;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -l <path>   multihal library (default %s)\n"
+            "  -c <path>   sub-HAL list to use instead of %s\n"
+            "  -s <handle> sensor to activate, may be repeated (default: all)\n"
+            "  -p <us>     sampling period (default: the sensor's minDelay)\n"
+            "  -b <ms>     max report latency passed to batch() (default 0)\n"
+            "  -w <s>      warmup before measuring (default 1)\n"
+            "  -d <s>      measurement duration (default 5)\n"
+            "  -f          flush then deactivate each sensor at the end, and check that its flush\n"
+            "              complete event is returned\n"
+            "  -t <s>      fail if poll() does not return for this long (default 5, at least\n"
+            "              twice the max report latency)\n",
+            name, DEFAULT_MULTI_HAL_PATH, MULTI_HAL_CONFIG_FILE_PATH);
+}
+
+// Prints the percentiles of the latencies, which are sorted in place.
+static void print_latencies(const char* label, std::vector<int64_t>& latencies) {
+    if (latencies.empty()) {
+        printf("%s: no samples\n", label);
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    size_t n = latencies.size();
+    const double percentiles[] = { 50, 90, 99, 99.9 };
+    printf("%s (us):", label);
+    for (double p : percentiles) {
+        size_t i = std::min(n - 1, (size_t) (p / 100 * n));
+        printf(" p%g %.1f", p, latencies[i] / 1000.0);
+    }
+    printf(" max %.1f (%zu samples)\n", latencies[n - 1] / 1000.0, n);
+}
+
+int main(int argc, char** argv) {
+    const char* lib_path = DEFAULT_MULTI_HAL_PATH;
+    std::vector<int> handles;
+    int64_t period_ns = -1;
+    int64_t timeout_ns = 0;
+    int warmup_s = 1;
+    int duration_s = 5;
+    bool flush = false;
+    int stall_s = 5;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "l:c:s:p:b:w:d:ft:h")) != -1) {
+        switch (opt) {
+        case 'l':
+            lib_path = optarg;
+            break;
+        case 'c':
+            setenv(MULTI_HAL_CONFIG_FILE_ENV, optarg, 1);
+            break;
+        case 's':
+            handles.push_back(atoi(optarg));
+            break;
+        case 'p':
+            period_ns = atoll(optarg) * 1000;
+            break;
+        case 'b':
+            timeout_ns = atoll(optarg) * 1000000;
+            break;
+        case 'w':
+            warmup_s = atoi(optarg);
+            break;
+        case 'd':
+            duration_s = atoi(optarg);
+            break;
+        case 'f':
+            flush = true;
+            break;
+        case 't':
+            stall_s = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (duration_s <= 0 || warmup_s < 0 || timeout_ns < 0 || stall_s <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    void* lib = dlopen(lib_path, RTLD_NOW);
+    if (lib == NULL) {
+        fprintf(stderr, "dlopen(%s): %s\n", lib_path, dlerror());
+        return 1;
+    }
+    sensors_module_t* module = (sensors_module_t*) dlsym(lib, HAL_MODULE_INFO_SYM_AS_STR);
+    if (module == NULL) {
+        fprintf(stderr, "dlsym(%s): %s\n", HAL_MODULE_INFO_SYM_AS_STR, dlerror());
+        return 1;
+    }
+    hw_device_t* hw_device;
+    int err = module->common.methods->open(&module->common, SENSORS_HARDWARE_POLL, &hw_device);
+    if (err) {
+        fprintf(stderr, "open(): %s\n", strerror(-err));
+        return 1;
+    }
+    sensors_poll_device_1_t* device = (sensors_poll_device_1_t*) hw_device;
+
+    sensor_t const* list;
+    int count = module->get_sensors_list(module, &list);
+    if (handles.empty()) {
+        for (int i = 0; i < count; i++) {
+            handles.push_back(list[i].handle);
+        }
+    }
+    for (int handle : handles) {
+        const sensor_t* sensor = NULL;
+        for (int i = 0; i < count; i++) {
+            if (list[i].handle == handle) {
+                sensor = &list[i];
+            }
+        }
+        if (sensor == NULL) {
+            fprintf(stderr, "No sensor with handle %d\n", handle);
+            return 1;
+        }
+        int64_t period = period_ns >= 0 ? period_ns : (int64_t) sensor->minDelay * 1000;
+        err = device->batch(device, handle, 0, period, timeout_ns);
+        if (err == 0) {
+            err = device->activate(&device->v0, handle, 1);
+        }
+        if (err) {
+            fprintf(stderr, "Cannot activate sensor %d: %s\n", handle, strerror(-err));
+            return 1;
+        }
+        printf("sensor %d: %s, period %" PRId64 " us\n", handle, sensor->name, period / 1000);
+    }
+
+    stall_timeout_ns = std::max((int64_t) (stall_s * 1000000000LL), 2 * timeout_ns);
+    last_poll_ns.store(now_ns());
+    pthread_t watchdog;
+    pthread_create(&watchdog, NULL, stallWatchdog, NULL);
+
+    static const int BUFFER_SIZE = 256;
+    sensors_event_t buffer[BUFFER_SIZE];
+    int64_t start = now_ns();
+    while (now_ns() - start < warmup_s * 1000000000LL) {
+        poll_device(device, buffer, BUFFER_SIZE);
+    }
+
+    std::vector<int64_t> enqueue_latencies;
+    std::vector<int64_t> timestamp_latencies;
+    int64_t events = 0;
+    int64_t polls = 0;
+    struct rusage usage_start, usage_end;
+    getrusage(RUSAGE_SELF, &usage_start);
+    start = now_ns();
+    int64_t end = start + duration_s * 1000000000LL;
+    int64_t now = start;
+    while (now < end) {
+        int n = poll_device(device, buffer, BUFFER_SIZE);
+        now = now_ns();
+        polls++;
+        for (int i = 0; i < n; i++) {
+            const sensors_event_t* event = &buffer[i];
+            if (event->type == SENSOR_TYPE_META_DATA) {
+                continue;
+            }
+            events++;
+            timestamp_latencies.push_back(now - event->timestamp);
+            int64_t enqueue_time = event->u64.data[FAKE_SENSORS_ENQUEUE_TIME_INDEX];
+            if (enqueue_time > 0 && enqueue_time <= now) {
+                enqueue_latencies.push_back(now - enqueue_time);
+            }
+        }
+    }
+    getrusage(RUSAGE_SELF, &usage_end);
+    double elapsed_s = (now - start) / 1e9;
+
+    std::vector<int> flushing;
+    for (int handle : handles) {
+        if (flush && device->flush(device, handle) == 0) {
+            flushing.push_back(handle);
+        }
+        device->activate(&device->v0, handle, 0);
+    }
+    // Sensors without a FIFO may reject the flush, the others must complete it.
+    while (!flushing.empty()) {
+        int n = poll_device(device, buffer, BUFFER_SIZE);
+        for (int i = 0; i < n; i++) {
+            const sensors_event_t* event = &buffer[i];
+            if (event->type == SENSOR_TYPE_META_DATA &&
+                    event->meta_data.what == META_DATA_FLUSH_COMPLETE) {
+                flushing.erase(std::remove(flushing.begin(), flushing.end(),
+                        event->meta_data.sensor), flushing.end());
+            }
+        }
+    }
+    if (flush) {
+        printf("flush complete events: all received\n");
+    }
+
+    long voluntary = usage_end.ru_nvcsw - usage_start.ru_nvcsw;
+    long involuntary = usage_end.ru_nivcsw - usage_start.ru_nivcsw;
+    printf("events: %" PRId64 " in %.2f s, %.1f events/s\n", events, elapsed_s,
+            events / elapsed_s);
+    printf("poll() returns: %" PRId64 ", %.1f/s, %.2f events each\n", polls, polls / elapsed_s,
+            polls ? (double) events / polls : 0.0);
+    print_latencies("enqueue to poll() latency", enqueue_latencies);
+    print_latencies("timestamp to poll() latency", timestamp_latencies);
+    printf("context switches: %ld voluntary (%.1f/s), %ld involuntary (%.1f/s)\n",
+            voluntary, voluntary / elapsed_s, involuntary, involuntary / elapsed_s);
+
+    // The multihal writer threads never exit, do not wait for them.
+    fflush(stdout);
+    _exit(0);
+}